@@ -0,0 +1,278 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/utility/stream_reader.h>
+#include <nop/utility/stream_writer.h>
+
+//
+// Compile-time benchmark for the encodings of large aggregates, similar to
+// generated schemas. This translation unit instantiates the encodings of a
+// structure with 128 members, a table with 64 entries, and a tuple with 32
+// elements. `make compile-bench` reports the time taken to compile it, which
+// is dominated by the expansion of the members of each aggregate; the program
+// itself only checks that each value is written and read back.
+//
+
+namespace {
+
+struct Wide {
+  std::uint32_t m0;
+  std::int64_t m1;
+  float m2;
+  std::string m3;
+  std::uint32_t m4;
+  std::int64_t m5;
+  float m6;
+  std::string m7;
+  std::uint32_t m8;
+  std::int64_t m9;
+  float m10;
+  std::string m11;
+  std::uint32_t m12;
+  std::int64_t m13;
+  float m14;
+  std::string m15;
+  std::uint32_t m16;
+  std::int64_t m17;
+  float m18;
+  std::string m19;
+  std::uint32_t m20;
+  std::int64_t m21;
+  float m22;
+  std::string m23;
+  std::uint32_t m24;
+  std::int64_t m25;
+  float m26;
+  std::string m27;
+  std::uint32_t m28;
+  std::int64_t m29;
+  float m30;
+  std::string m31;
+  std::uint32_t m32;
+  std::int64_t m33;
+  float m34;
+  std::string m35;
+  std::uint32_t m36;
+  std::int64_t m37;
+  float m38;
+  std::string m39;
+  std::uint32_t m40;
+  std::int64_t m41;
+  float m42;
+  std::string m43;
+  std::uint32_t m44;
+  std::int64_t m45;
+  float m46;
+  std::string m47;
+  std::uint32_t m48;
+  std::int64_t m49;
+  float m50;
+  std::string m51;
+  std::uint32_t m52;
+  std::int64_t m53;
+  float m54;
+  std::string m55;
+  std::uint32_t m56;
+  std::int64_t m57;
+  float m58;
+  std::string m59;
+  std::uint32_t m60;
+  std::int64_t m61;
+  float m62;
+  std::string m63;
+  std::uint32_t m64;
+  std::int64_t m65;
+  float m66;
+  std::string m67;
+  std::uint32_t m68;
+  std::int64_t m69;
+  float m70;
+  std::string m71;
+  std::uint32_t m72;
+  std::int64_t m73;
+  float m74;
+  std::string m75;
+  std::uint32_t m76;
+  std::int64_t m77;
+  float m78;
+  std::string m79;
+  std::uint32_t m80;
+  std::int64_t m81;
+  float m82;
+  std::string m83;
+  std::uint32_t m84;
+  std::int64_t m85;
+  float m86;
+  std::string m87;
+  std::uint32_t m88;
+  std::int64_t m89;
+  float m90;
+  std::string m91;
+  std::uint32_t m92;
+  std::int64_t m93;
+  float m94;
+  std::string m95;
+  std::uint32_t m96;
+  std::int64_t m97;
+  float m98;
+  std::string m99;
+  std::uint32_t m100;
+  std::int64_t m101;
+  float m102;
+  std::string m103;
+  std::uint32_t m104;
+  std::int64_t m105;
+  float m106;
+  std::string m107;
+  std::uint32_t m108;
+  std::int64_t m109;
+  float m110;
+  std::string m111;
+  std::uint32_t m112;
+  std::int64_t m113;
+  float m114;
+  std::string m115;
+  std::uint32_t m116;
+  std::int64_t m117;
+  float m118;
+  std::string m119;
+  std::uint32_t m120;
+  std::int64_t m121;
+  float m122;
+  std::string m123;
+  std::uint32_t m124;
+  std::int64_t m125;
+  float m126;
+  std::string m127;
+  NOP_STRUCTURE(Wide, m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12,
+                m13, m14, m15, m16, m17, m18, m19, m20, m21, m22, m23, m24, m25,
+                m26, m27, m28, m29, m30, m31, m32, m33, m34, m35, m36, m37, m38,
+                m39, m40, m41, m42, m43, m44, m45, m46, m47, m48, m49, m50, m51,
+                m52, m53, m54, m55, m56, m57, m58, m59, m60, m61, m62, m63, m64,
+                m65, m66, m67, m68, m69, m70, m71, m72, m73, m74, m75, m76, m77,
+                m78, m79, m80, m81, m82, m83, m84, m85, m86, m87, m88, m89, m90,
+                m91, m92, m93, m94, m95, m96, m97, m98, m99, m100, m101, m102,
+                m103, m104, m105, m106, m107, m108, m109, m110, m111, m112,
+                m113, m114, m115, m116, m117, m118, m119, m120, m121, m122,
+                m123, m124, m125, m126, m127);
+};
+
+struct Sparse {
+  nop::Entry<std::uint32_t, 0> e0;
+  nop::Entry<std::int64_t, 1> e1;
+  nop::Entry<float, 2> e2;
+  nop::Entry<std::string, 3> e3;
+  nop::Entry<std::uint32_t, 4> e4;
+  nop::Entry<std::int64_t, 5> e5;
+  nop::Entry<float, 6> e6;
+  nop::Entry<std::string, 7> e7;
+  nop::Entry<std::uint32_t, 8> e8;
+  nop::Entry<std::int64_t, 9> e9;
+  nop::Entry<float, 10> e10;
+  nop::Entry<std::string, 11> e11;
+  nop::Entry<std::uint32_t, 12> e12;
+  nop::Entry<std::int64_t, 13> e13;
+  nop::Entry<float, 14> e14;
+  nop::Entry<std::string, 15> e15;
+  nop::Entry<std::uint32_t, 16> e16;
+  nop::Entry<std::int64_t, 17> e17;
+  nop::Entry<float, 18> e18;
+  nop::Entry<std::string, 19> e19;
+  nop::Entry<std::uint32_t, 20> e20;
+  nop::Entry<std::int64_t, 21> e21;
+  nop::Entry<float, 22> e22;
+  nop::Entry<std::string, 23> e23;
+  nop::Entry<std::uint32_t, 24> e24;
+  nop::Entry<std::int64_t, 25> e25;
+  nop::Entry<float, 26> e26;
+  nop::Entry<std::string, 27> e27;
+  nop::Entry<std::uint32_t, 28> e28;
+  nop::Entry<std::int64_t, 29> e29;
+  nop::Entry<float, 30> e30;
+  nop::Entry<std::string, 31> e31;
+  nop::Entry<std::uint32_t, 32> e32;
+  nop::Entry<std::int64_t, 33> e33;
+  nop::Entry<float, 34> e34;
+  nop::Entry<std::string, 35> e35;
+  nop::Entry<std::uint32_t, 36> e36;
+  nop::Entry<std::int64_t, 37> e37;
+  nop::Entry<float, 38> e38;
+  nop::Entry<std::string, 39> e39;
+  nop::Entry<std::uint32_t, 40> e40;
+  nop::Entry<std::int64_t, 41> e41;
+  nop::Entry<float, 42> e42;
+  nop::Entry<std::string, 43> e43;
+  nop::Entry<std::uint32_t, 44> e44;
+  nop::Entry<std::int64_t, 45> e45;
+  nop::Entry<float, 46> e46;
+  nop::Entry<std::string, 47> e47;
+  nop::Entry<std::uint32_t, 48> e48;
+  nop::Entry<std::int64_t, 49> e49;
+  nop::Entry<float, 50> e50;
+  nop::Entry<std::string, 51> e51;
+  nop::Entry<std::uint32_t, 52> e52;
+  nop::Entry<std::int64_t, 53> e53;
+  nop::Entry<float, 54> e54;
+  nop::Entry<std::string, 55> e55;
+  nop::Entry<std::uint32_t, 56> e56;
+  nop::Entry<std::int64_t, 57> e57;
+  nop::Entry<float, 58> e58;
+  nop::Entry<std::string, 59> e59;
+  nop::Entry<std::uint32_t, 60> e60;
+  nop::Entry<std::int64_t, 61> e61;
+  nop::Entry<float, 62> e62;
+  nop::Entry<std::string, 63> e63;
+  NOP_TABLE_NS("Sparse", Sparse, e0, e1, e2, e3, e4, e5, e6, e7, e8, e9, e10,
+               e11, e12, e13, e14, e15, e16, e17, e18, e19, e20, e21, e22, e23,
+               e24, e25, e26, e27, e28, e29, e30, e31, e32, e33, e34, e35, e36,
+               e37, e38, e39, e40, e41, e42, e43, e44, e45, e46, e47, e48, e49,
+               e50, e51, e52, e53, e54, e55, e56, e57, e58, e59, e60, e61, e62,
+               e63);
+};
+
+using Long = std::tuple<
+    std::uint32_t, std::int64_t, float, std::string, std::uint32_t,
+    std::int64_t, float, std::string, std::uint32_t, std::int64_t, float,
+    std::string, std::uint32_t, std::int64_t, float, std::string, std::uint32_t,
+    std::int64_t, float, std::string, std::uint32_t, std::int64_t, float,
+    std::string, std::uint32_t, std::int64_t, float, std::string, std::uint32_t,
+    std::int64_t, float, std::string>;
+
+template <typename T>
+bool RoundTrip(const T& value) {
+  nop::Serializer<nop::StreamWriter<std::stringstream>> serializer;
+  if (!serializer.Write(value))
+    return false;
+
+  nop::Deserializer<nop::StreamReader<std::stringstream>> deserializer{
+      serializer.writer().stream().str()};
+  T decoded;
+  return static_cast<bool>(deserializer.Read(&decoded));
+}
+
+}  // anonymous namespace
+
+int main() {
+  const bool success =
+      RoundTrip(Wide{}) && RoundTrip(Sparse{}) && RoundTrip(Long{});
+  return success ? 0 : 1;
+}
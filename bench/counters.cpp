@@ -0,0 +1,164 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "counters.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace nop_bench {
+namespace {
+
+bool allocation_counters_enabled = false;
+
+// Allocations by the current thread while allocation counters are enabled.
+thread_local std::uint64_t allocations = 0;
+thread_local std::uint64_t allocated_bytes = 0;
+
+struct PerfCounter {
+  const char* name;
+  std::uint32_t type;
+  std::uint64_t config;
+  int fd;
+};
+
+constexpr std::uint64_t CacheConfig(std::uint64_t cache, std::uint64_t op,
+                                    std::uint64_t result) {
+  return cache | (op << 8) | (result << 16);
+}
+
+PerfCounter perf_counters[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1},
+    {"L1d-misses", PERF_TYPE_HW_CACHE,
+     CacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                 PERF_COUNT_HW_CACHE_RESULT_MISS),
+     -1},
+    {"LLC-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1},
+};
+
+// Opens the counters of the calling thread, which counts in user space only.
+void OpenPerfCounters() {
+  for (PerfCounter& counter : perf_counters) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counter.type;
+    attr.config = counter.config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    counter.fd = static_cast<int>(
+        syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    if (counter.fd < 0) {
+      std::fprintf(stderr, "perf counter %s is not available: %s\n",
+                   counter.name, std::strerror(errno));
+    }
+  }
+}
+
+std::uint64_t ReadPerfCounter(const PerfCounter& counter) {
+  std::uint64_t value = 0;
+  if (read(counter.fd, &value, sizeof(value)) != sizeof(value))
+    return 0;
+  return value;
+}
+
+void CountAllocation(std::size_t size) {
+  if (allocation_counters_enabled) {
+    allocations++;
+    allocated_bytes += size;
+  }
+}
+
+void* Allocate(std::size_t size) {
+  CountAllocation(size);
+  if (void* pointer = std::malloc(size == 0 ? 1 : size))
+    return pointer;
+  throw std::bad_alloc{};
+}
+
+}  // anonymous namespace
+
+void ParseCounterFlags(int* argc, char** argv) {
+  int count = 1;
+  for (int i = 1; i < *argc; i++) {
+    if (std::strcmp(argv[i], "--perf_counters") == 0)
+      OpenPerfCounters();
+    else if (std::strcmp(argv[i], "--allocation_counters") == 0)
+      allocation_counters_enabled = true;
+    else
+      argv[count++] = argv[i];
+  }
+  *argc = count;
+}
+
+CounterScope::CounterScope(benchmark::State& state)
+    : state_{state},
+      allocations_start_{allocations},
+      allocated_bytes_start_{allocated_bytes} {
+  for (const PerfCounter& counter : perf_counters) {
+    perf_start_.push_back(counter.fd >= 0 ? ReadPerfCounter(counter) : 0);
+  }
+}
+
+CounterScope::~CounterScope() {
+  // Read everything before reporting, which allocates.
+  const std::uint64_t allocation_count = allocations - allocations_start_;
+  const std::uint64_t allocation_bytes =
+      allocated_bytes - allocated_bytes_start_;
+  std::vector<std::uint64_t> perf_end;
+  for (const PerfCounter& counter : perf_counters)
+    perf_end.push_back(counter.fd >= 0 ? ReadPerfCounter(counter) : 0);
+
+  using benchmark::Counter;
+  for (std::size_t i = 0; i < perf_end.size(); i++) {
+    if (perf_counters[i].fd >= 0) {
+      state_.counters[perf_counters[i].name] =
+          Counter(static_cast<double>(perf_end[i] - perf_start_[i]),
+                  Counter::kAvgIterations);
+    }
+  }
+
+  if (allocation_counters_enabled) {
+    state_.counters["allocs"] = Counter(static_cast<double>(allocation_count),
+                                        Counter::kAvgIterations);
+    state_.counters["alloc-bytes"] = Counter(
+        static_cast<double>(allocation_bytes), Counter::kAvgIterations);
+  }
+}
+
+}  // namespace nop_bench
+
+// Replacements of the global allocation functions that count allocations.
+// The other forms of operator new and delete call these.
+void* operator new(std::size_t size) { return nop_bench::Allocate(size); }
+void* operator new[](std::size_t size) { return nop_bench::Allocate(size); }
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t /*size*/) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void* pointer, std::size_t /*size*/) noexcept {
+  std::free(pointer);
+}
@@ -0,0 +1,62 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBNOP_BENCH_COUNTERS_H_
+#define LIBNOP_BENCH_COUNTERS_H_
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace nop_bench {
+
+//
+// Optional counters reported alongside the time of each benchmark:
+//
+//   --perf_counters         Linux perf_event counters of the benchmark thread:
+//                           cycles, instructions, branch-misses, L1d read
+//                           misses, and LLC misses, per iteration.
+//   --allocation_counters   Heap allocations and bytes allocated per iteration
+//                           by the benchmark thread, counted by replacing the
+//                           global operator new.
+//
+// Counters that the kernel does not allow, for example because of
+// perf_event_paranoid, are reported as missing once and skipped.
+//
+
+// Enables the counters selected by the flags above and removes the flags from
+// the arguments, before they are passed to benchmark::Initialize().
+void ParseCounterFlags(int* argc, char** argv);
+
+// Measures the enabled counters over its lifetime and reports them to |state|
+// as averages per iteration. Construct it just before the benchmark loop.
+class CounterScope {
+ public:
+  explicit CounterScope(benchmark::State& state);
+  ~CounterScope();
+
+  CounterScope(const CounterScope&) = delete;
+  void operator=(const CounterScope&) = delete;
+
+ private:
+  benchmark::State& state_;
+  std::vector<std::uint64_t> perf_start_;
+  std::uint64_t allocations_start_;
+  std::uint64_t allocated_bytes_start_;
+};
+
+}  // namespace nop_bench
+
+#endif  // LIBNOP_BENCH_COUNTERS_H_
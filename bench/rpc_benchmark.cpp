@@ -0,0 +1,737 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nop/rpc/epoll_method_server.h>
+#include <nop/rpc/interface.h>
+#include <nop/rpc/pipelined_method_receiver.h>
+#include <nop/rpc/pipelined_method_sender.h>
+#include <nop/rpc/simple_method_receiver.h>
+#include <nop/rpc/simple_method_sender.h>
+#include <nop/serializer.h>
+#include <nop/utility/buffered_fd_reader.h>
+#include <nop/utility/buffered_fd_writer.h>
+#include <nop/utility/spsc_ring.h>
+
+//
+// RPC load generator that measures the throughput and latency of remote
+// interface invocations over each transport. Every case drives an Echo method
+// that returns its payload from a number of client connections, each on its
+// own thread, and reports invocations per second, payload bytes per second,
+// and the p50/p99/p999 round trip latency of the invocations of all
+// connections.
+//
+// Transports:
+//   pipe        A pair of pipes per connection.
+//   socketpair  A Unix domain stream socket pair per connection.
+//   tcp         A TCP connection over the loopback interface, with Nagle's
+//               algorithm disabled.
+//   ring        A pair of SpscRings per connection, in shared memory.
+//
+// Modes:
+//   simple      SimpleMethodSender and SimpleMethodReceiver, one invocation in
+//               flight per connection and one server thread per connection.
+//   pipelined   PipelinedMethodSender and PipelinedMethodReceiver, up to
+//               --depth invocations in flight per connection and one server
+//               thread per connection.
+//   epoll       PipelinedMethodSender clients served by one EpollMethodServer
+//               thread for all connections. Only socket transports apply.
+//
+// Flags take comma-separated lists and every combination is run:
+//
+//   rpc_benchmark --transports=socketpair,ring --modes=simple,pipelined
+//       --connections=1,4 --depths=1,16 --payloads=64,4096 --calls=5000
+//
+// The depth is limited so that the invocations in flight fit in the kernel
+// buffers of the fd transports; otherwise a client blocked writing
+// invocations and a server blocked writing replies would wait for each other.
+// The effective depth is printed with the results.
+//
+
+using nop::BindInterface;
+using nop::BufferedFdReader;
+using nop::BufferedFdWriter;
+using nop::Deserializer;
+using nop::EpollMethodServer;
+using nop::ErrorStatus;
+using nop::Interface;
+using nop::MakePipelinedMethodSender;
+using nop::MakeSimpleMethodSender;
+using nop::PipelinedMethodReceiver;
+using nop::Serializer;
+using nop::SimpleMethodReceiver;
+using nop::SpscRing;
+using nop::SpscRingReader;
+using nop::SpscRingWriter;
+using nop::Status;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Payload = std::vector<std::uint8_t>;
+
+// Limit on the payload bytes in flight per connection in the pipelined modes.
+enum : std::size_t { kMaxInflightBytes = 32 * 1024 };
+
+struct EchoInterface : Interface<EchoInterface> {
+  NOP_INTERFACE("io.github.eieio.libnop.bench.Echo");
+  NOP_METHOD(Echo, Payload(const Payload&));
+  NOP_INTERFACE_API(Echo);
+};
+
+auto BindEcho() {
+  return BindInterface(EchoInterface::Echo::Bind(
+      [](const Payload& payload) { return payload; }));
+}
+
+using EchoDispatcher = decltype(BindEcho());
+
+//
+// Transports.
+//
+
+Status<void> FlushWriter(BufferedFdWriter* writer) { return writer->Flush(); }
+
+Status<void> FlushWriter(SpscRingWriter* writer) {
+  writer->Flush();
+  return {};
+}
+
+// Reader that flushes the writer of the same endpoint before reading, so that
+// invocations and replies buffered by the writer are sent before either side
+// waits for the other. Flushing an empty writer does nothing.
+template <typename Reader, typename Writer>
+class FlushingReader {
+ public:
+  FlushingReader(Reader* reader, Writer* writer)
+      : reader_{reader}, writer_{writer} {}
+
+  Status<void> Ensure(std::size_t size) { return reader_->Ensure(size); }
+
+  Status<void> Read(std::uint8_t* byte) {
+    auto status = FlushWriter(writer_);
+    if (!status)
+      return status;
+    return reader_->Read(byte);
+  }
+
+  template <typename T>
+  Status<void> Read(T* begin, T* end) {
+    auto status = FlushWriter(writer_);
+    if (!status)
+      return status;
+    return reader_->Read(begin, end);
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    auto status = FlushWriter(writer_);
+    if (!status)
+      return status;
+    return reader_->Skip(padding_bytes);
+  }
+
+ private:
+  Reader* reader_;
+  Writer* writer_;
+};
+
+// One end of a connection: a writer for outgoing values and a reader for
+// incoming values, with the serializer and deserializer that use them.
+template <typename Writer, typename Reader>
+struct Endpoint {
+  using SerializerType = Serializer<Writer*>;
+  using DeserializerType = Deserializer<FlushingReader<Reader, Writer>>;
+
+  template <typename WriterArg, typename ReaderArg>
+  Endpoint(WriterArg writer_arg, ReaderArg reader_arg)
+      : writer{writer_arg}, reader{reader_arg} {}
+
+  Writer writer;
+  Reader reader;
+  SerializerType serializer{&writer};
+  DeserializerType deserializer{&reader, &writer};
+};
+
+using FdEndpoint = Endpoint<BufferedFdWriter, BufferedFdReader>;
+using RingEndpoint = Endpoint<SpscRingWriter, SpscRingReader>;
+
+// The rings of one connection over the ring transport.
+struct RingPair {
+  SpscRing requests;
+  SpscRing replies;
+};
+
+// The fds of both ends of a connection over an fd transport. The socket
+// transports use a duplicate of each socket for writing, so that the reader
+// and writer of each end own their fds.
+struct FdPair {
+  int client_read{-1};
+  int client_write{-1};
+  int server_read{-1};
+  int server_write{-1};
+};
+
+// Creates a listening TCP socket on an ephemeral loopback port.
+int ListenTcp() {
+  const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+      ::listen(fd, 64) < 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+Status<void> ConnectTcp(int listen_fd, int* client_fd, int* server_fd) {
+  sockaddr_in address = {};
+  socklen_t length = sizeof(address);
+  if (::getsockname(listen_fd, reinterpret_cast<sockaddr*>(&address),
+                    &length) < 0) {
+    return ErrorStatus::IOError;
+  }
+
+  *client_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (*client_fd < 0)
+    return ErrorStatus::IOError;
+  if (::connect(*client_fd, reinterpret_cast<sockaddr*>(&address), length) <
+      0) {
+    ::close(*client_fd);
+    return ErrorStatus::IOError;
+  }
+
+  *server_fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+  if (*server_fd < 0) {
+    ::close(*client_fd);
+    return ErrorStatus::IOError;
+  }
+
+  const int enable = 1;
+  ::setsockopt(*client_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  ::setsockopt(*server_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  return {};
+}
+
+// Connects a client to a server over the given fd transport. |listen_fd| is
+// the listening socket of the tcp transport.
+Status<FdPair> ConnectFds(const std::string& transport, int listen_fd) {
+  FdPair fds;
+  if (transport == "pipe") {
+    int requests[2];
+    int replies[2];
+    if (::pipe2(requests, O_CLOEXEC) < 0)
+      return ErrorStatus::IOError;
+    if (::pipe2(replies, O_CLOEXEC) < 0) {
+      ::close(requests[0]);
+      ::close(requests[1]);
+      return ErrorStatus::IOError;
+    }
+    fds.client_read = replies[0];
+    fds.client_write = requests[1];
+    fds.server_read = requests[0];
+    fds.server_write = replies[1];
+    return fds;
+  }
+
+  int client_fd;
+  int server_fd;
+  if (transport == "socketpair") {
+    int sockets[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) < 0)
+      return ErrorStatus::IOError;
+    client_fd = sockets[0];
+    server_fd = sockets[1];
+  } else {
+    auto status = ConnectTcp(listen_fd, &client_fd, &server_fd);
+    if (!status)
+      return status.error();
+  }
+
+  fds.client_read = client_fd;
+  fds.client_write = ::dup(client_fd);
+  fds.server_read = server_fd;
+  fds.server_write = ::dup(server_fd);
+  return fds;
+}
+
+//
+// Clients and servers.
+//
+
+struct Case {
+  std::string transport;
+  std::string mode;
+  std::size_t connections;
+  std::size_t depth;
+  std::size_t payload;
+};
+
+struct Options {
+  std::vector<std::string> transports{"pipe", "socketpair", "tcp", "ring"};
+  std::vector<std::string> modes{"simple", "pipelined", "epoll"};
+  std::vector<std::size_t> connections{1, 4};
+  std::vector<std::size_t> depths{16};
+  std::vector<std::size_t> payloads{64, 4096};
+  std::size_t calls{5000};
+  std::size_t warmup{500};
+  std::size_t ring_size{1 << 20};
+};
+
+// The measurements of one client connection.
+struct ClientResult {
+  std::vector<std::uint64_t> latencies;
+  Clock::time_point start;
+  Clock::time_point end;
+  Status<void> status;
+};
+
+std::uint64_t Nanoseconds(Clock::duration duration) {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+// Invokes Echo one invocation at a time, recording the latency of each
+// invocation after the warmup.
+template <typename EndpointType>
+void RunSimpleClient(EndpointType* endpoint, const Payload& payload,
+                     const Options& options, ClientResult* result) {
+  auto sender =
+      MakeSimpleMethodSender(&endpoint->serializer, &endpoint->deserializer);
+  const std::size_t total = options.warmup + options.calls;
+  result->latencies.reserve(options.calls);
+
+  for (std::size_t i = 0; i < total; i++) {
+    if (i == options.warmup)
+      result->start = Clock::now();
+
+    const Clock::time_point start = Clock::now();
+    auto status = EchoInterface::Echo::Invoke(&sender, payload);
+    if (!status) {
+      result->status = status.error();
+      return;
+    } else if (status.get().size() != payload.size()) {
+      result->status = ErrorStatus::ProtocolError;
+      return;
+    }
+
+    if (i >= options.warmup)
+      result->latencies.push_back(Nanoseconds(Clock::now() - start));
+  }
+  result->end = Clock::now();
+}
+
+// Invokes Echo keeping up to |depth| invocations in flight, recording the
+// latency of each invocation after the warmup from the time it is written
+// until its reply is received.
+template <typename EndpointType>
+void RunPipelinedClient(EndpointType* endpoint, const Payload& payload,
+                        std::size_t depth, const Options& options,
+                        ClientResult* result) {
+  auto sender = MakePipelinedMethodSender(&endpoint->serializer,
+                                          &endpoint->deserializer);
+  const std::size_t total = options.warmup + options.calls;
+  result->latencies.reserve(options.calls);
+
+  std::size_t sent = 0;
+  std::size_t received = 0;
+  while (received < total) {
+    while (sent < total && sender.pending() < depth) {
+      if (sent == options.warmup)
+        result->start = Clock::now();
+
+      const Clock::time_point start = Clock::now();
+      const bool measured = sent >= options.warmup;
+      auto completion = [&, start, measured](Status<Payload> reply) {
+        received++;
+        if (!reply)
+          result->status = reply.error();
+        else if (reply.get().size() != payload.size())
+          result->status = ErrorStatus::ProtocolError;
+        else if (measured)
+          result->latencies.push_back(Nanoseconds(Clock::now() - start));
+      };
+      auto status =
+          EchoInterface::Echo::InvokeAsync(&sender, completion, payload);
+      if (!status) {
+        result->status = status.error();
+        return;
+      }
+      sent++;
+    }
+
+    auto status = sender.ReceiveReturn();
+    if (!status || !result->status) {
+      if (result->status)
+        result->status = status.error();
+      return;
+    }
+  }
+  result->end = Clock::now();
+}
+
+// Serves invocations from the endpoint until reading fails, which happens
+// when the client closes the connection.
+template <template <typename...> class Receiver, typename EndpointType>
+void Serve(EndpointType* endpoint) {
+  const EchoDispatcher dispatcher = BindEcho();
+  Receiver<typename EndpointType::SerializerType,
+           typename EndpointType::DeserializerType>
+      receiver{&endpoint->serializer, &endpoint->deserializer};
+  while (dispatcher(&receiver)) {
+  }
+}
+
+template <template <typename...> class Receiver, typename EndpointType>
+std::vector<std::thread> StartServers(
+    const std::vector<std::unique_ptr<EndpointType>>& servers) {
+  std::vector<std::thread> threads;
+  for (const auto& server : servers)
+    threads.emplace_back(Serve<Receiver, EndpointType>, server.get());
+  return threads;
+}
+
+template <typename EndpointType>
+std::vector<std::thread> StartServers(
+    const Case& c, const std::vector<std::unique_ptr<EndpointType>>& servers) {
+  if (c.mode == "simple")
+    return StartServers<SimpleMethodReceiver>(servers);
+  else
+    return StartServers<PipelinedMethodReceiver>(servers);
+}
+
+// Runs every client connection on its own thread until it completes its
+// invocations.
+template <typename EndpointType>
+std::vector<ClientResult> RunClients(
+    const Case& c, const Options& options,
+    const std::vector<std::unique_ptr<EndpointType>>& clients) {
+  const Payload payload(c.payload, 0x5a);
+  std::vector<ClientResult> results(clients.size());
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < clients.size(); i++) {
+    threads.emplace_back([&, i] {
+      if (c.mode == "simple") {
+        RunSimpleClient(clients[i].get(), payload, options, &results[i]);
+      } else {
+        RunPipelinedClient(clients[i].get(), payload, c.depth, options,
+                           &results[i]);
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  return results;
+}
+
+std::vector<ClientResult> RunFdCase(const Case& c, const Options& options) {
+  std::vector<std::unique_ptr<FdEndpoint>> clients;
+  std::vector<std::unique_ptr<FdEndpoint>> servers;
+  std::vector<int> server_sockets;
+
+  const int listen_fd = c.transport == "tcp" ? ListenTcp() : -1;
+  if (c.transport == "tcp" && listen_fd < 0)
+    return {ClientResult{{}, {}, {}, ErrorStatus::IOError}};
+
+  for (std::size_t i = 0; i < c.connections; i++) {
+    auto status = ConnectFds(c.transport, listen_fd);
+    if (!status)
+      return {ClientResult{{}, {}, {}, status.error()}};
+
+    const FdPair& fds = status.get();
+    clients.emplace_back(new FdEndpoint{fds.client_write, fds.client_read});
+    if (c.mode == "epoll") {
+      ::close(fds.server_write);
+      server_sockets.push_back(fds.server_read);
+    } else {
+      servers.emplace_back(new FdEndpoint{fds.server_write, fds.server_read});
+    }
+  }
+  if (listen_fd >= 0)
+    ::close(listen_fd);
+
+  if (c.mode != "epoll") {
+    std::vector<std::thread> threads = StartServers(c, servers);
+    std::vector<ClientResult> results = RunClients(c, options, clients);
+
+    // Closing the clients ends the servers.
+    clients.clear();
+    for (auto& thread : threads)
+      thread.join();
+    return results;
+  }
+
+  EpollMethodServer<EchoDispatcher, PipelinedMethodReceiver> server{
+      BindEcho()};
+  for (const int fd : server_sockets) {
+    auto status = server.AddConnection(fd);
+    if (!status)
+      return {ClientResult{{}, {}, {}, status.error()}};
+  }
+
+  std::atomic<bool> stop{false};
+  std::thread thread{[&] {
+    while (!stop.load(std::memory_order_relaxed))
+      server.Poll(10);
+  }};
+  std::vector<ClientResult> results = RunClients(c, options, clients);
+  clients.clear();
+  stop.store(true, std::memory_order_relaxed);
+  thread.join();
+  return results;
+}
+
+std::vector<ClientResult> RunRingCase(const Case& c, const Options& options) {
+  std::vector<std::unique_ptr<RingPair>> rings;
+  std::vector<std::unique_ptr<RingEndpoint>> clients;
+  std::vector<std::unique_ptr<RingEndpoint>> servers;
+
+  for (std::size_t i = 0; i < c.connections; i++) {
+    std::unique_ptr<RingPair> pair{new RingPair};
+    auto status = pair->requests.Create(options.ring_size);
+    if (status)
+      status = pair->replies.Create(options.ring_size);
+    if (!status)
+      return {ClientResult{{}, {}, {}, status.error()}};
+
+    clients.emplace_back(new RingEndpoint{&pair->requests, &pair->replies});
+    servers.emplace_back(new RingEndpoint{&pair->replies, &pair->requests});
+    rings.push_back(std::move(pair));
+  }
+
+  std::vector<std::thread> threads = StartServers(c, servers);
+  std::vector<ClientResult> results = RunClients(c, options, clients);
+
+  // Closing the request rings ends the servers.
+  clients.clear();
+  for (const auto& pair : rings)
+    pair->requests.Close();
+  for (auto& thread : threads)
+    thread.join();
+  return results;
+}
+
+//
+// Reporting.
+//
+
+std::uint64_t Percentile(const std::vector<std::uint64_t>& sorted,
+                         double fraction) {
+  if (sorted.empty())
+    return 0;
+  const std::size_t index = static_cast<std::size_t>(fraction * sorted.size());
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+void PrintHeader() {
+  std::printf("%-11s %-9s %5s %5s %8s %12s %10s %9s %9s %9s\n", "transport",
+              "mode", "conns", "depth", "payload", "calls/s", "MB/s",
+              "p50(us)", "p99(us)", "p999(us)");
+}
+
+// Prints the results of a case, or the first error of its connections.
+void PrintResults(const Case& c, const std::vector<ClientResult>& results) {
+  std::printf("%-11s %-9s %5zu %5zu %8zu ", c.transport.c_str(),
+              c.mode.c_str(), c.connections, c.depth, c.payload);
+  for (const ClientResult& result : results) {
+    if (!result.status) {
+      std::printf("error: %s\n", result.status.GetErrorMessage());
+      return;
+    }
+  }
+
+  std::vector<std::uint64_t> latencies;
+  Clock::time_point start = results.front().start;
+  Clock::time_point end = results.front().end;
+  for (const ClientResult& result : results) {
+    latencies.insert(latencies.end(), result.latencies.begin(),
+                     result.latencies.end());
+    start = std::min(start, result.start);
+    end = std::max(end, result.end);
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  const double seconds = std::chrono::duration<double>(end - start).count();
+  const double calls_per_second = latencies.size() / seconds;
+  std::printf("%12.0f %10.2f %9.2f %9.2f %9.2f\n", calls_per_second,
+              calls_per_second * c.payload / 1e6,
+              Percentile(latencies, 0.5) / 1e3,
+              Percentile(latencies, 0.99) / 1e3,
+              Percentile(latencies, 0.999) / 1e3);
+}
+
+void RunCase(const Case& c, const Options& options) {
+  std::vector<ClientResult> results;
+  if (c.transport == "ring")
+    results = RunRingCase(c, options);
+  else
+    results = RunFdCase(c, options);
+  PrintResults(c, results);
+  std::fflush(stdout);
+}
+
+//
+// Flags.
+//
+
+std::vector<std::string> SplitList(const std::string& list) {
+  std::vector<std::string> items;
+  std::istringstream stream{list};
+  std::string item;
+  while (std::getline(stream, item, ','))
+    items.push_back(item);
+  return items;
+}
+
+bool ParseSizes(const std::string& list, std::vector<std::size_t>* sizes) {
+  sizes->clear();
+  for (const std::string& item : SplitList(list)) {
+    char* end;
+    const unsigned long long value = std::strtoull(item.c_str(), &end, 10);
+    if (item.empty() || *end != '\0')
+      return false;
+    sizes->push_back(static_cast<std::size_t>(value));
+  }
+  return !sizes->empty();
+}
+
+bool ParseSize(const std::string& value, std::size_t* size) {
+  std::vector<std::size_t> sizes;
+  if (!ParseSizes(value, &sizes) || sizes.size() != 1)
+    return false;
+  *size = sizes.front();
+  return true;
+}
+
+bool ParseFlags(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const std::size_t equals = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos)
+      return false;
+
+    const std::string name = arg.substr(2, equals - 2);
+    const std::string value = arg.substr(equals + 1);
+    bool valid;
+    if (name == "transports") {
+      options->transports = SplitList(value);
+      valid = !options->transports.empty();
+      for (const std::string& transport : options->transports) {
+        valid = valid && (transport == "pipe" || transport == "socketpair" ||
+                          transport == "tcp" || transport == "ring");
+      }
+    } else if (name == "modes") {
+      options->modes = SplitList(value);
+      valid = !options->modes.empty();
+      for (const std::string& mode : options->modes) {
+        valid = valid && (mode == "simple" || mode == "pipelined" ||
+                          mode == "epoll");
+      }
+    } else if (name == "connections") {
+      valid = ParseSizes(value, &options->connections);
+    } else if (name == "depths") {
+      valid = ParseSizes(value, &options->depths);
+    } else if (name == "payloads") {
+      valid = ParseSizes(value, &options->payloads);
+    } else if (name == "calls") {
+      valid = ParseSize(value, &options->calls);
+    } else if (name == "warmup") {
+      valid = ParseSize(value, &options->warmup);
+    } else if (name == "ring_size") {
+      valid = ParseSize(value, &options->ring_size);
+    } else {
+      valid = false;
+    }
+
+    if (!valid)
+      return false;
+  }
+
+  return options->calls > 0 &&
+         std::find(options->connections.begin(), options->connections.end(),
+                   0u) == options->connections.end();
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  // Writers detect the peer closing through EPIPE.
+  signal(SIGPIPE, SIG_IGN);
+
+  Options options;
+  if (!ParseFlags(argc, argv, &options)) {
+    std::fprintf(stderr,
+                 "Usage: %s [--transports=pipe,socketpair,tcp,ring] "
+                 "[--modes=simple,pipelined,epoll] [--connections=N,...] "
+                 "[--depths=N,...] [--payloads=N,...] [--calls=N] "
+                 "[--warmup=N] [--ring_size=N]\n",
+                 argv[0]);
+    return 1;
+  }
+
+  PrintHeader();
+  for (const std::string& transport : options.transports) {
+    for (const std::string& mode : options.modes) {
+      // EpollMethodServer serves bidirectional stream sockets.
+      if (mode == "epoll" && (transport == "pipe" || transport == "ring"))
+        continue;
+
+      for (const std::size_t connections : options.connections) {
+        for (const std::size_t payload : options.payloads) {
+          std::vector<std::size_t> depths = options.depths;
+          if (mode == "simple")
+            depths = {1};
+
+          // Depths above the limit run once at the limit.
+          const std::size_t limit =
+              std::max<std::size_t>(1, kMaxInflightBytes / (payload + 1));
+          std::size_t previous = 0;
+          for (std::size_t depth : depths) {
+            depth = std::max<std::size_t>(1, std::min(depth, limit));
+            if (depth != previous)
+              RunCase({transport, mode, connections, depth, payload}, options);
+            previous = depth;
+          }
+        }
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,614 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/types/optional.h>
+#include <nop/types/variant.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/buffer_writer.h>
+#include <nop/utility/endian.h>
+#include <nop/utility/fd_reader.h>
+#include <nop/utility/fd_writer.h>
+#include <nop/utility/fixed_width_writer.h>
+#include <nop/utility/json_transcoder.h>
+#include <nop/utility/pedantic_buffer_reader.h>
+#include <nop/utility/pedantic_buffer_writer.h>
+#include <nop/utility/stream_reader.h>
+#include <nop/utility/stream_writer.h>
+#include <nop/utility/trusted_buffer_reader.h>
+
+#include "counters.h"
+
+//
+// Measures the throughput of encoding and decoding each of the built-in
+// encodings over buffer, stream, and pipe readers and writers. Each benchmark
+// is named <Encode|Decode>/<Transport>/<Value> and reports bytes per second in
+// addition to the time per operation. The ByteOrder/<Little|Swapped>/<Type>
+// benchmarks compare copying packed values in host order with the byte swapping
+// that big-endian hosts add. The <Encode|Decode>/FixedWidth/<Value> benchmarks
+// use the buffer transport with integers written at their full width by
+// FixedWidthWriter. The Encode/Pedantic/<Value> benchmarks encode with every
+// write bounds checked, which bounded values reserve in one check. The
+// Decode/<Pedantic|Trusted>/<Value> benchmarks compare decoding untrusted
+// input, with every read bounds checked, against decoding input from a trusted
+// peer. The Json/Buffer/<Value> benchmarks transcode the encoding to JSON
+// without decoding it. The Large value is a wide message with a rarely present
+// diagnostics payload whose encoding is outlined; see nop::IsOutlined. Use the
+// standard Google Benchmark flags to select benchmarks and output formats;
+// `make bench` writes JSON results to $(OUT)/bench.json for comparison between
+// revisions. Pass --perf_counters or --allocation_counters to also report
+// hardware counters or heap allocations per operation; see counters.h.
+//
+
+using nop::BufferReader;
+using nop::BufferWriter;
+using nop::Deserializer;
+using nop::Entry;
+using nop::Optional;
+using nop::FdReader;
+using nop::FdWriter;
+using nop::FixedWidthWriter;
+using nop::PedanticBufferReader;
+using nop::PedanticBufferWriter;
+using nop::Serializer;
+using nop::Status;
+using nop::StreamReader;
+using nop::StreamWriter;
+using nop::TrustedBufferReader;
+using nop::Variant;
+
+namespace {
+
+//
+// Values to encode and decode.
+//
+
+struct Point {
+  float x;
+  float y;
+  float z;
+  NOP_STRUCTURE(Point, x, y, z);
+};
+
+struct Shape {
+  std::uint32_t id;
+  std::string name;
+  std::vector<Point> points;
+  std::map<std::string, std::int64_t> attributes;
+  NOP_STRUCTURE(Shape, id, name, points, attributes);
+};
+
+struct Scene {
+  std::string title;
+  std::vector<Shape> shapes;
+  NOP_STRUCTURE(Scene, title, shapes);
+};
+
+struct Record {
+  Entry<std::uint64_t, 0> id;
+  Entry<std::string, 1> name;
+  Entry<std::vector<std::uint32_t>, 2> values;
+  Entry<Point, 3> location;
+  NOP_TABLE(Record, id, name, values, location);
+};
+
+// Rarely present payload with a large encoder, which is outlined.
+struct Diagnostics {
+  std::string component;
+  std::vector<std::string> messages;
+  std::map<std::string, std::string> context;
+  std::vector<std::uint64_t> timestamps;
+  NOP_STRUCTURE(Diagnostics, component, messages, context, timestamps);
+};
+
+}  // anonymous namespace
+
+namespace nop {
+
+template <>
+struct IsOutlined<Diagnostics> : std::true_type {};
+
+}  // namespace nop
+
+namespace {
+
+struct Sample {
+  std::uint64_t timestamp;
+  std::int32_t value;
+  std::uint8_t quality;
+  NOP_STRUCTURE(Sample, timestamp, value, quality);
+};
+
+struct Telemetry {
+  std::uint64_t sequence;
+  std::uint32_t source;
+  std::string host;
+  std::string service;
+  Point position;
+  Point velocity;
+  std::int64_t offset;
+  std::uint16_t flags;
+  double temperature;
+  double pressure;
+  std::vector<Sample> samples;
+  std::vector<std::uint32_t> counters;
+  Optional<Sample> last_alarm;
+  std::vector<Diagnostics> diagnostics;
+  NOP_STRUCTURE(Telemetry, sequence, source, host, service, position, velocity,
+                offset, flags, temperature, pressure, samples, counters,
+                last_alarm, diagnostics);
+};
+
+using Integer = std::uint64_t;
+using String = std::string;
+using IntegralVector = std::vector<std::uint32_t>;
+using StringVector = std::vector<std::string>;
+using Map = std::map<std::uint32_t, std::string>;
+using VariantType = Variant<std::uint32_t, std::string, Point>;
+using Table = Record;
+using Nested = Scene;
+using Large = Telemetry;
+
+template <typename T>
+T MakeValue();
+
+template <>
+Integer MakeValue<Integer>() {
+  return 0x0123456789abcdefull;
+}
+
+template <>
+String MakeValue<String>() {
+  return std::string(256, 'x');
+}
+
+template <>
+IntegralVector MakeValue<IntegralVector>() {
+  IntegralVector value(1024);
+  for (std::size_t i = 0; i < value.size(); i++)
+    value[i] = static_cast<std::uint32_t>(i * 2654435761u);
+  return value;
+}
+
+template <>
+StringVector MakeValue<StringVector>() {
+  return StringVector(64, std::string(16, 'y'));
+}
+
+template <>
+Map MakeValue<Map>() {
+  Map value;
+  for (std::uint32_t i = 0; i < 64; i++)
+    value.emplace(i * 1000, std::to_string(i));
+  return value;
+}
+
+template <>
+VariantType MakeValue<VariantType>() {
+  return VariantType{Point{1.0f, 2.0f, 3.0f}};
+}
+
+template <>
+Table MakeValue<Table>() {
+  Table value;
+  value.id = 1u << 30;
+  value.name = std::string(32, 'z');
+  value.values = std::vector<std::uint32_t>(64, 0xffff);
+  value.location = Point{1.0f, 2.0f, 3.0f};
+  return value;
+}
+
+template <>
+Nested MakeValue<Nested>() {
+  Shape shape{1, "shape", std::vector<Point>(16, Point{1.0f, 2.0f, 3.0f}),
+              {{"color", 0xff00ff}, {"layer", 3}}};
+  return {"scene", std::vector<Shape>(16, shape)};
+}
+
+template <>
+Large MakeValue<Large>() {
+  Large value;
+  value.sequence = 1ull << 40;
+  value.source = 7;
+  value.host = "host-0001";
+  value.service = "telemetry";
+  value.position = Point{1.0f, 2.0f, 3.0f};
+  value.velocity = Point{0.5f, 0.0f, -0.5f};
+  value.offset = -1000;
+  value.flags = 0x8001;
+  value.temperature = 21.5;
+  value.pressure = 1013.25;
+  value.samples = std::vector<Sample>(8, Sample{1ull << 33, -42, 3});
+  value.counters = std::vector<std::uint32_t>(16, 1u << 20);
+  return value;
+}
+
+// Returns the encoding of |value|.
+template <typename T>
+std::string Encode(const T& value) {
+  Serializer<StreamWriter<std::stringstream>> serializer;
+  serializer.Write(value);
+  return serializer.writer().stream().str();
+}
+
+// Returns the encoding of |value| with integers written at their full width.
+template <typename T>
+std::string EncodeFixedWidth(const T& value) {
+  StreamWriter<std::stringstream> stream_writer;
+  FixedWidthWriter<decltype(stream_writer)> writer{&stream_writer};
+  Serializer<decltype(writer)*> serializer{&writer};
+  serializer.Write(value);
+  return stream_writer.stream().str();
+}
+
+// Creates a pipe, aborting on failure.
+void MakePipe(int (&fds)[2]) {
+  if (pipe(fds) != 0) {
+    perror("pipe");
+    abort();
+  }
+}
+
+//
+// Encoders wrap a serializer and reset the output before each write, so that
+// the output does not grow across iterations.
+//
+
+template <typename Writer>
+class BufferEncoder {
+ public:
+  explicit BufferEncoder(std::size_t size) : buffer_(size) {}
+
+  template <typename T>
+  Status<void> Write(const T& value) {
+    Serializer<Writer> serializer{buffer_.data(), buffer_.size()};
+    return serializer.Write(value);
+  }
+
+ private:
+  std::vector<std::uint8_t> buffer_;
+};
+
+class FixedWidthEncoder {
+ public:
+  // Integers are written at their full width, so the output may be larger
+  // than the compact encoding used to size the buffer.
+  explicit FixedWidthEncoder(std::size_t size) : buffer_(size * 9 + 16) {}
+
+  template <typename T>
+  Status<void> Write(const T& value) {
+    BufferWriter buffer_writer{buffer_.data(), buffer_.size()};
+    FixedWidthWriter<BufferWriter> writer{&buffer_writer};
+    Serializer<decltype(writer)*> serializer{&writer};
+    return serializer.Write(value);
+  }
+
+ private:
+  std::vector<std::uint8_t> buffer_;
+};
+
+class StreamEncoder {
+ public:
+  explicit StreamEncoder(std::size_t /*size*/) {}
+
+  template <typename T>
+  Status<void> Write(const T& value) {
+    serializer_.writer().stream().seekp(0);
+    return serializer_.Write(value);
+  }
+
+ private:
+  Serializer<StreamWriter<std::stringstream>> serializer_;
+};
+
+// Writes to a pipe that is drained by another thread.
+class PipeEncoder {
+ public:
+  explicit PipeEncoder(std::size_t size) : PipeEncoder{size, Pipe{}} {}
+
+  ~PipeEncoder() {
+    serializer_.writer().Clear();
+    thread_.join();
+  }
+
+  template <typename T>
+  Status<void> Write(const T& value) {
+    return serializer_.Write(value);
+  }
+
+ private:
+  struct Pipe {
+    Pipe() { MakePipe(fds); }
+    int fds[2];
+  };
+
+  PipeEncoder(std::size_t size, Pipe pipe)
+      : serializer_{pipe.fds[1]}, thread_{[size, fd = pipe.fds[0]] {
+          std::vector<std::uint8_t> buffer(std::max<std::size_t>(size, 4096));
+          while (true) {
+            const ssize_t ret = read(fd, buffer.data(), buffer.size());
+            if (ret == 0 || (ret < 0 && errno != EINTR))
+              break;
+          }
+          close(fd);
+        }} {}
+
+  Serializer<FdWriter> serializer_;
+  std::thread thread_;
+};
+
+//
+// Decoders wrap a deserializer that reads the given encoding once per read.
+//
+
+template <typename Reader>
+class BufferDecoder {
+ public:
+  explicit BufferDecoder(const std::string& encoding) : encoding_{encoding} {}
+
+  template <typename T>
+  Status<void> Read(T* value) {
+    Deserializer<Reader> deserializer{encoding_.data(), encoding_.size()};
+    return deserializer.Read(value);
+  }
+
+ private:
+  std::string encoding_;
+};
+
+class StreamDecoder {
+ public:
+  explicit StreamDecoder(const std::string& encoding)
+      : deserializer_{encoding} {}
+
+  template <typename T>
+  Status<void> Read(T* value) {
+    deserializer_.reader().stream().clear();
+    deserializer_.reader().stream().seekg(0);
+    return deserializer_.Read(value);
+  }
+
+ private:
+  Deserializer<StreamReader<std::stringstream>> deserializer_;
+};
+
+// Reads from a pipe that is filled with copies of the encoding by another
+// thread.
+class PipeDecoder {
+ public:
+  explicit PipeDecoder(const std::string& encoding)
+      : PipeDecoder{encoding, Pipe{}} {}
+
+  ~PipeDecoder() {
+    deserializer_.reader().Clear();
+    thread_.join();
+  }
+
+  template <typename T>
+  Status<void> Read(T* value) {
+    return deserializer_.Read(value);
+  }
+
+ private:
+  struct Pipe {
+    Pipe() { MakePipe(fds); }
+    int fds[2];
+  };
+
+  PipeDecoder(const std::string& encoding, Pipe pipe)
+      : deserializer_{pipe.fds[0]}, thread_{[encoding, fd = pipe.fds[1]] {
+          // Writing fails with EPIPE once the reader closes its end.
+          bool done = false;
+          while (!done) {
+            const char* data = encoding.data();
+            std::size_t size = encoding.size();
+            while (size > 0) {
+              const ssize_t ret = write(fd, data, size);
+              if (ret > 0) {
+                data += ret;
+                size -= ret;
+              } else if (errno != EINTR) {
+                done = true;
+                break;
+              }
+            }
+          }
+          close(fd);
+        }} {}
+
+  Deserializer<FdReader> deserializer_;
+  std::thread thread_;
+};
+
+//
+// Benchmarks.
+//
+
+template <typename Encoder, typename T>
+void EncodeBenchmark(benchmark::State& state) {
+  const T value = MakeValue<T>();
+  const std::size_t size = Encode(value).size();
+  Encoder encoder{size};
+
+  nop_bench::CounterScope counters{state};
+  for (auto _ : state) {
+    auto status = encoder.Write(value);
+    if (!status) {
+      state.SkipWithError(status.GetErrorMessage());
+      break;
+    }
+  }
+
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<std::int64_t>(size));
+}
+
+template <typename Decoder, typename T, bool FixedWidth = false>
+void DecodeBenchmark(benchmark::State& state) {
+  const T source = MakeValue<T>();
+  const std::string encoding =
+      FixedWidth ? EncodeFixedWidth(source) : Encode(source);
+  Decoder decoder{encoding};
+  T value;
+
+  nop_bench::CounterScope counters{state};
+  for (auto _ : state) {
+    auto status = decoder.Read(&value);
+    if (!status) {
+      state.SkipWithError(status.GetErrorMessage());
+      break;
+    }
+    benchmark::DoNotOptimize(value);
+  }
+
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<std::int64_t>(encoding.size()));
+}
+
+// Measures transcoding the encoding of a value to JSON.
+template <typename T>
+void JsonBenchmark(benchmark::State& state) {
+  const std::string encoding = Encode(MakeValue<T>());
+
+  // Escaping and base64 expand the output by at most six times the input.
+  std::vector<std::uint8_t> output(6 * encoding.size() + 64);
+
+  nop_bench::CounterScope counters{state};
+  for (auto _ : state) {
+    BufferReader reader{encoding.data(), encoding.size()};
+    BufferWriter writer{output.data(), output.size()};
+    auto status = nop::TranscodeToJson(&reader, &writer);
+    if (!status) {
+      state.SkipWithError(status.GetErrorMessage());
+      break;
+    }
+    benchmark::DoNotOptimize(output.data());
+  }
+
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<std::int64_t>(encoding.size()));
+}
+
+// Measures copying packed values out of a container in each byte order:
+// little-endian hosts copy BIN payloads as is, while big-endian hosts also
+// reverse the bytes of each multi-byte value.
+template <typename T, bool Swap>
+void ByteOrderBenchmark(benchmark::State& state) {
+  std::vector<T> source(1024);
+  for (std::size_t i = 0; i < source.size(); i++)
+    source[i] = static_cast<T>(i * 0x9e3779b97f4a7c15ull);
+  std::vector<T> target(source.size());
+
+  nop_bench::CounterScope counters{state};
+  for (auto _ : state) {
+    std::copy(source.begin(), source.end(), target.begin());
+    if (Swap)
+      nop::SwapBytes(target.data(), target.data() + target.size());
+    benchmark::DoNotOptimize(target.data());
+    benchmark::ClobberMemory();
+  }
+
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<std::int64_t>(sizeof(T) * source.size()));
+}
+
+template <typename T>
+void RegisterByteOrderBenchmarks(const std::string& name) {
+  benchmark::RegisterBenchmark(("ByteOrder/Little/" + name).c_str(),
+                               &ByteOrderBenchmark<T, false>);
+  benchmark::RegisterBenchmark(("ByteOrder/Swapped/" + name).c_str(),
+                               &ByteOrderBenchmark<T, true>);
+}
+
+template <typename T>
+void RegisterBenchmarks(const std::string& name) {
+  benchmark::RegisterBenchmark(
+      ("Encode/Buffer/" + name).c_str(),
+      &EncodeBenchmark<BufferEncoder<BufferWriter>, T>);
+  benchmark::RegisterBenchmark(
+      ("Encode/Pedantic/" + name).c_str(),
+      &EncodeBenchmark<BufferEncoder<PedanticBufferWriter>, T>);
+  benchmark::RegisterBenchmark(("Encode/Stream/" + name).c_str(),
+                               &EncodeBenchmark<StreamEncoder, T>);
+  benchmark::RegisterBenchmark(("Encode/Pipe/" + name).c_str(),
+                               &EncodeBenchmark<PipeEncoder, T>);
+  benchmark::RegisterBenchmark(
+      ("Decode/Buffer/" + name).c_str(),
+      &DecodeBenchmark<BufferDecoder<BufferReader>, T>);
+  benchmark::RegisterBenchmark(
+      ("Decode/Pedantic/" + name).c_str(),
+      &DecodeBenchmark<BufferDecoder<PedanticBufferReader>, T>);
+  benchmark::RegisterBenchmark(
+      ("Decode/Trusted/" + name).c_str(),
+      &DecodeBenchmark<BufferDecoder<TrustedBufferReader>, T>);
+  benchmark::RegisterBenchmark(("Decode/Stream/" + name).c_str(),
+                               &DecodeBenchmark<StreamDecoder, T>);
+  benchmark::RegisterBenchmark(("Decode/Pipe/" + name).c_str(),
+                               &DecodeBenchmark<PipeDecoder, T>);
+  benchmark::RegisterBenchmark(("Json/Buffer/" + name).c_str(),
+                               &JsonBenchmark<T>);
+  benchmark::RegisterBenchmark(("Encode/FixedWidth/" + name).c_str(),
+                               &EncodeBenchmark<FixedWidthEncoder, T>);
+  benchmark::RegisterBenchmark(
+      ("Decode/FixedWidth/" + name).c_str(),
+      &DecodeBenchmark<BufferDecoder<BufferReader>, T, true>);
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  // Pipe writers detect the reader closing through EPIPE.
+  signal(SIGPIPE, SIG_IGN);
+
+  nop_bench::ParseCounterFlags(&argc, argv);
+
+  RegisterBenchmarks<Integer>("Integer");
+  RegisterBenchmarks<String>("String");
+  RegisterBenchmarks<IntegralVector>("IntegralVector");
+  RegisterBenchmarks<StringVector>("StringVector");
+  RegisterBenchmarks<Map>("Map");
+  RegisterBenchmarks<VariantType>("Variant");
+  RegisterBenchmarks<Table>("Table");
+  RegisterBenchmarks<Nested>("Nested");
+  RegisterBenchmarks<Large>("Large");
+  RegisterByteOrderBenchmarks<std::uint16_t>("U16");
+  RegisterByteOrderBenchmarks<std::uint32_t>("U32");
+  RegisterByteOrderBenchmarks<std::uint64_t>("U64");
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
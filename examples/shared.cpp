@@ -27,6 +27,7 @@
 #include <nop/traits/is_fungible.h>
 #include <nop/utility/buffer_reader.h>
 #include <nop/utility/buffer_writer.h>
+#include <nop/utility/c_abi.h>
 #include <nop/value.h>
 
 namespace {
@@ -82,6 +83,14 @@ static_assert(nop::IsFungible<Polyhedron, CPolyhedron>::value, "");
 
 }  // anonymous namespace
 
+// Export the C ABI functions for reading and writing encoded values in place,
+// without copying them into C structures. These let python select individual
+// triangles and vertices of a serialized Polyhedron instead of deserializing
+// the whole payload. See nop/utility/c_abi.h.
+NOP_C_ABI(nop);
+NOP_C_ABI_STRUCTURE(triangle, Triangle);
+NOP_C_ABI_STRUCTURE(vec3, Vec3);
+
 // Fills the given buffer with a pre-defined Polyhedron.
 extern "C" ssize_t GetSerializedPolyhedron(void* buffer, size_t buffer_size) {
   nop::Serializer<nop::BufferWriter> serializer{buffer, buffer_size};
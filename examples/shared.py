@@ -42,6 +42,10 @@ class Triangle(Structure):
 class PolyhedronBase(Structure):
   _fields_ = (('size', c_size_t),)
 
+# View of encoded bytes in a buffer, passed to the C ABI functions.
+class NopView(Structure):
+  _fields_ = (('data', c_void_p), ('size', c_size_t))
+
 # Builds a Polyhedron given either a list of Triangles or a capacity to reserve.
 #
 # This is equivalent to the following C header struct + dynamic array idiom:
@@ -96,6 +100,34 @@ def LoadProtocolLibrary():
   DeserializePolyhedron.argtypes = (POINTER(PolyhedronBase), c_void_p, c_size_t)
   DeserializePolyhedron.restype = c_ssize_t
 
+  # Functions for reading encoded values in place.
+  for name in ('nop_element', 'triangle_member', 'vec3_member'):
+    function = getattr(ProtocolLibrary, name)
+    function.argtypes = (NopView, c_size_t, POINTER(NopView))
+    function.restype = c_int
+
+  ProtocolLibrary.nop_read_float.argtypes = (NopView, POINTER(c_float))
+  ProtocolLibrary.nop_read_float.restype = c_int
+
+# Reads one coordinate of a vertex of a triangle of a serialized Polyhedron
+# without deserializing the rest of the payload.
+def ReadCoordinate(payload_buffer, count, triangle, vertex, coordinate):
+  value = NopView(cast(payload_buffer, c_void_p), count)
+  element = NopView()
+  result = c_float()
+
+  status = ProtocolLibrary.nop_element(value, triangle, byref(element))
+  if status == 0:
+    status = ProtocolLibrary.triangle_member(element, vertex, byref(element))
+  if status == 0:
+    status = ProtocolLibrary.vec3_member(element, coordinate, byref(element))
+  if status == 0:
+    status = ProtocolLibrary.nop_read_float(element, byref(result))
+
+  if status < 0:
+    raise ValueError('Error: %d' % -status)
+  return result.value
+
 def main():
   LoadProtocolLibrary()
 
@@ -138,5 +170,8 @@ def main():
   else:
     print 'Error:', -count
 
+  # Read the z coordinate of the second vertex of the third triangle in place.
+  print 'z:', ReadCoordinate(payload_buffer, len(payload_buffer), 2, 1, 2)
+
 if __name__ == '__main__':
   main()
@@ -18,6 +18,7 @@
 #define LIBNOP_INCLUDE_NOP_BASE_ARRAY_H_
 
 #include <array>
+#include <type_traits>
 
 #include <nop/base/encoding.h>
 #include <nop/base/utility.h>
@@ -25,7 +26,7 @@
 namespace nop {
 
 //
-// std::array<T, N> and T[N] encoding format for non-integral types:
+// std::array<T, N> and T[N] encoding format for non-packable types:
 //
 // +-----+---------+-----//-----+
 // | ARY | INT64:N | N ELEMENTS |
@@ -33,7 +34,8 @@ namespace nop {
 //
 // Elements must be valid encodings of type T.
 //
-// std::array<T, N> and T[N] encoding format for integral types:
+// std::array<T, N> and T[N] encoding format for packable (integral, float, and
+// double) types:
 //
 // +-----+---------+---//----+
 // | BIN | INT64:L | L BYTES |
@@ -41,12 +43,16 @@ namespace nop {
 //
 // Where L = N * sizeof(T).
 //
-// Elements are stored as direct little-endian representation of the integral
-// value, each element is sizeof(T) bytes in size.
+// Elements are stored as direct little-endian representation of the value,
+// each element is sizeof(T) bytes in size. Floating point elements are IEEE 754
+// single or double precision values.
+//
+// Arrays of floating point and enum flags types also accept the ARY format when
+// reading, which older versions of the library used for these types.
 //
 
 template <typename T, std::size_t Length>
-struct Encoding<std::array<T, Length>, EnableIfNotIntegral<T>>
+struct Encoding<std::array<T, Length>, EnableIfNotPackable<T>>
     : EncodingIO<std::array<T, Length>> {
   using Type = std::array<T, Length>;
 
@@ -55,12 +61,8 @@ struct Encoding<std::array<T, Length>, EnableIfNotIntegral<T>>
   }
 
   static constexpr std::size_t Size(const Type& value) {
-    std::size_t element_size_sum = 0;
-    for (std::size_t i=0; i < Length; i++)
-      element_size_sum += Encoding<T>::Size(value[i]);
-
     return BaseEncodingSize(Prefix(value)) + Encoding<SizeType>::Size(Length) +
-           element_size_sum;
+           ElementsEncodingSize<T>(value);
   }
 
   static constexpr bool Match(EncodingByte prefix) {
@@ -72,12 +74,12 @@ struct Encoding<std::array<T, Length>, EnableIfNotIntegral<T>>
                                              const Type& value,
                                              Writer* writer) {
     auto status = Encoding<SizeType>::Write(Length, writer);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
     for (SizeType i = 0; i < Length; i++) {
       status = Encoding<T>::Write(value[i], writer);
-      if (!status)
+      if (NOP_UNLIKELY(!status))
         return status;
     }
 
@@ -89,14 +91,14 @@ struct Encoding<std::array<T, Length>, EnableIfNotIntegral<T>>
                                             Type* value, Reader* reader) {
     SizeType size = 0;
     auto status = Encoding<SizeType>::Read(&size, reader);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
     else if (size != Length)
       return ErrorStatus::InvalidContainerLength;
 
     for (SizeType i = 0; i < Length; i++) {
       status = Encoding<T>::Read(&(*value)[i], reader);
-      if (!status)
+      if (NOP_UNLIKELY(!status))
         return status;
     }
 
@@ -105,7 +107,7 @@ struct Encoding<std::array<T, Length>, EnableIfNotIntegral<T>>
 };
 
 template <typename T, std::size_t Length>
-struct Encoding<T[Length], EnableIfNotIntegral<T>> : EncodingIO<T[Length]> {
+struct Encoding<T[Length], EnableIfNotPackable<T>> : EncodingIO<T[Length]> {
   using Type = T[Length];
 
   static constexpr EncodingByte Prefix(const Type& /*value*/) {
@@ -113,12 +115,8 @@ struct Encoding<T[Length], EnableIfNotIntegral<T>> : EncodingIO<T[Length]> {
   }
 
   static constexpr std::size_t Size(const Type& value) {
-    std::size_t element_size_sum = 0;
-    for (std::size_t i=0; i < Length; i++)
-      element_size_sum += Encoding<T>::Size(value[i]);
-
     return BaseEncodingSize(Prefix(value)) + Encoding<SizeType>::Size(Length) +
-           element_size_sum;
+           ElementsEncodingSize<T>(value);
   }
 
   static constexpr bool Match(EncodingByte prefix) {
@@ -130,12 +128,12 @@ struct Encoding<T[Length], EnableIfNotIntegral<T>> : EncodingIO<T[Length]> {
                                              const Type& value,
                                              Writer* writer) {
     auto status = Encoding<SizeType>::Write(Length, writer);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
     for (SizeType i = 0; i < Length; i++) {
       status = Encoding<T>::Write(value[i], writer);
-      if (!status)
+      if (NOP_UNLIKELY(!status))
         return status;
     }
 
@@ -147,14 +145,14 @@ struct Encoding<T[Length], EnableIfNotIntegral<T>> : EncodingIO<T[Length]> {
                                             Type* value, Reader* reader) {
     SizeType size = 0;
     auto status = Encoding<SizeType>::Read(&size, reader);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
     else if (size != Length)
       return ErrorStatus::InvalidContainerLength;
 
     for (SizeType i = 0; i < Length; i++) {
       status = Encoding<T>::Read(&(*value)[i], reader);
-      if (!status)
+      if (NOP_UNLIKELY(!status))
         return status;
     }
 
@@ -163,7 +161,7 @@ struct Encoding<T[Length], EnableIfNotIntegral<T>> : EncodingIO<T[Length]> {
 };
 
 template <typename T, std::size_t Length>
-struct Encoding<std::array<T, Length>, EnableIfIntegral<T>>
+struct Encoding<std::array<T, Length>, EnableIfPackable<T>>
     : EncodingIO<std::array<T, Length>> {
   using Type = std::array<T, Length>;
 
@@ -178,7 +176,8 @@ struct Encoding<std::array<T, Length>, EnableIfIntegral<T>>
   }
 
   static constexpr bool Match(EncodingByte prefix) {
-    return prefix == EncodingByte::Binary;
+    return prefix == EncodingByte::Binary ||
+           (HasLegacyArrayFormat<T>::value && prefix == EncodingByte::Array);
   }
 
   template <typename Writer>
@@ -186,28 +185,47 @@ struct Encoding<std::array<T, Length>, EnableIfIntegral<T>>
                                              const Type& value,
                                              Writer* writer) {
     auto status = Encoding<SizeType>::Write(Length * sizeof(T), writer);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
-    return writer->Write(value.begin(), value.end());
+    return WritePacked(&value[0], &value[Length], writer);
   }
 
   template <typename Reader>
-  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
-                                            Type* value, Reader* reader) {
+  static constexpr Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                            Reader* reader) {
     SizeType size = 0;
     auto status = Encoding<SizeType>::Read(&size, reader);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
+    else if (prefix == EncodingByte::Array)
+      return ReadElements(size, value, reader);
     else if (size != Length * sizeof(T))
       return ErrorStatus::InvalidContainerLength;
 
-    return reader->Read(&(*value)[0], &(*value)[Length]);
+    return ReadPacked(&(*value)[0], &(*value)[Length], reader);
+  }
+
+ private:
+  // Reads |size| individually encoded elements of the legacy ARY format.
+  template <typename Reader>
+  static constexpr Status<void> ReadElements(SizeType size, Type* value,
+                                             Reader* reader) {
+    if (size != Length)
+      return ErrorStatus::InvalidContainerLength;
+
+    for (SizeType i = 0; i < Length; i++) {
+      auto status = Encoding<T>::Read(&(*value)[i], reader);
+      if (NOP_UNLIKELY(!status))
+        return status;
+    }
+
+    return {};
   }
 };
 
 template <typename T, std::size_t Length>
-struct Encoding<T[Length], EnableIfIntegral<T>> : EncodingIO<T[Length]> {
+struct Encoding<T[Length], EnableIfPackable<T>> : EncodingIO<T[Length]> {
   using Type = T[Length];
 
   static constexpr EncodingByte Prefix(const Type& /*value*/) {
@@ -221,7 +239,8 @@ struct Encoding<T[Length], EnableIfIntegral<T>> : EncodingIO<T[Length]> {
   }
 
   static constexpr bool Match(EncodingByte prefix) {
-    return prefix == EncodingByte::Binary;
+    return prefix == EncodingByte::Binary ||
+           (HasLegacyArrayFormat<T>::value && prefix == EncodingByte::Array);
   }
 
   template <typename Writer>
@@ -229,26 +248,98 @@ struct Encoding<T[Length], EnableIfIntegral<T>> : EncodingIO<T[Length]> {
                                              const Type& value,
                                              Writer* writer) {
     auto status = Encoding<SizeType>::Write(Length * sizeof(T), writer);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
-    return writer->Write(&value[0], &value[Length]);
+    return WritePacked(&value[0], &value[Length], writer);
   }
 
   template <typename Reader>
-  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
-                                            Type* value, Reader* reader) {
+  static constexpr Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                            Reader* reader) {
     SizeType size = 0;
     auto status = Encoding<SizeType>::Read(&size, reader);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
+    else if (prefix == EncodingByte::Array)
+      return ReadElements(size, value, reader);
     else if (size != Length * sizeof(T))
       return ErrorStatus::InvalidContainerLength;
 
-    return reader->Read(&(*value)[0], &(*value)[Length]);
+    return ReadPacked(&(*value)[0], &(*value)[Length], reader);
+  }
+
+ private:
+  // Reads |size| individually encoded elements of the legacy ARY format.
+  template <typename Reader>
+  static constexpr Status<void> ReadElements(SizeType size, Type* value,
+                                             Reader* reader) {
+    if (size != Length)
+      return ErrorStatus::InvalidContainerLength;
+
+    for (SizeType i = 0; i < Length; i++) {
+      auto status = Encoding<T>::Read(&(*value)[i], reader);
+      if (NOP_UNLIKELY(!status))
+        return status;
+    }
+
+    return {};
   }
 };
 
+// Arrays of packable types always have a fixed encoding size, while arrays of
+// other types have a fixed encoding size when their elements do.
+template <typename T, std::size_t Length>
+struct FixedEncodingSize<std::array<T, Length>, EnableIfPackable<T>>
+    : std::true_type {
+  enum : std::size_t {
+    Size = BaseEncodingSize(EncodingByte::Binary) +
+           Encoding<SizeType>::Size(Length * sizeof(T)) + Length * sizeof(T)
+  };
+};
+template <typename T, std::size_t Length>
+struct FixedEncodingSize<std::array<T, Length>, EnableIfNotPackable<T>>
+    : FixedEncodingSize<T> {
+  enum : std::size_t {
+    Size = FixedEncodingSize<T>::value
+               ? BaseEncodingSize(EncodingByte::Array) +
+                     Encoding<SizeType>::Size(Length) +
+                     Length * FixedEncodingSize<T>::Size
+               : 0
+  };
+};
+template <typename T, std::size_t Length>
+struct FixedEncodingSize<T[Length]> : FixedEncodingSize<std::array<T, Length>> {
+};
+
+// Arrays of packable types are bounded by their binary encoding or, for
+// floating point and enum flags types, the legacy array format. Arrays of
+// other types are bounded when their elements are.
+template <typename T, std::size_t Length>
+struct MaxEncodingSize<std::array<T, Length>, EnableIfPackable<T>>
+    : std::true_type {
+  enum : std::size_t {
+    Size = BaseEncodingSize(EncodingByte::Binary) +
+           MaxEncodingSize<SizeType>::Size +
+           Length * (HasLegacyArrayFormat<T>::value
+                         ? std::size_t{MaxEncodingSize<T>::Size}
+                         : sizeof(T))
+  };
+};
+template <typename T, std::size_t Length>
+struct MaxEncodingSize<std::array<T, Length>, EnableIfNotPackable<T>>
+    : MaxEncodingSize<T> {
+  enum : std::size_t {
+    Size = MaxEncodingSize<T>::value
+               ? BaseEncodingSize(EncodingByte::Array) +
+                     MaxEncodingSize<SizeType>::Size +
+                     Length * MaxEncodingSize<T>::Size
+               : 0
+  };
+};
+template <typename T, std::size_t Length>
+struct MaxEncodingSize<T[Length]> : MaxEncodingSize<std::array<T, Length>> {};
+
 }  // namespace nop
 
 #endif  // LIBNOP_INCLUDE_NOP_BASE_ARRAY_H_
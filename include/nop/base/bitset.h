@@ -0,0 +1,279 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_BITSET_H_
+#define LIBNOP_INCLUDE_NOP_BASE_BITSET_H_
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/utility.h>
+
+namespace nop {
+
+//
+// std::vector<bool> and std::bitset<N> encoding format:
+//
+// +-----+---------+-------------+----//-----+
+// | BIN | INT64:L | U8:PAD_BITS | L-1 BYTES |
+// +-----+---------+-------------+----//-----+
+//
+// Where L = 1 + ceil(N / 8) and PAD_BITS = 8 * (L - 1) - N, the number of
+// unused bits in the last byte, which must be zero.
+//
+// Bit i of the sequence is bit (i % 8) of byte (i / 8), so that the bytes are
+// the little-endian representation of the bits packed into 64-bit words.
+//
+
+// Converts between sequences of bits and their packed encoding, 64 bits at a
+// time.
+struct BitPacking {
+  // Bytes of packed bits are converted in chunks of this size.
+  enum : std::size_t { kChunkBytes = 512 };
+
+  static constexpr SizeType PackedSize(std::size_t bit_count) {
+    return 1 + (bit_count + 7) / 8;
+  }
+
+  // Writes the payload of |bit_count| bits. |GetBit(i)| returns bit i.
+  template <typename Writer, typename GetBit>
+  static Status<void> Write(std::size_t bit_count, GetBit get_bit,
+                            Writer* writer) {
+    const SizeType size = PackedSize(bit_count);
+    auto status = Encoding<SizeType>::Write(size, writer);
+    if (!status)
+      return status;
+
+    status = writer->Write(
+        static_cast<std::uint8_t>(8 * (size - 1) - bit_count));
+    if (!status)
+      return status;
+
+    std::uint8_t chunk[kChunkBytes];
+    for (std::size_t bit = 0; bit < bit_count;) {
+      const std::size_t chunk_bits = std::min(bit_count - bit, kChunkBytes * 8);
+      for (std::size_t offset = 0; offset < chunk_bits; offset += 64) {
+        const std::size_t word_bits = std::min<std::size_t>(chunk_bits - offset,
+                                                            64);
+        std::uint64_t word = 0;
+        for (std::size_t i = 0; i < word_bits; i++)
+          word |= static_cast<std::uint64_t>(get_bit(bit + offset + i)) << i;
+        StoreWord(word, &chunk[offset / 8]);
+      }
+
+      const std::size_t chunk_bytes = (chunk_bits + 7) / 8;
+      status = writer->Write(&chunk[0], &chunk[chunk_bytes]);
+      if (!status)
+        return status;
+
+      bit += chunk_bits;
+    }
+
+    return {};
+  }
+
+  // Reads the number of padding bits of a payload of |size| bytes and returns
+  // the number of bits in |*bit_count|.
+  template <typename Reader>
+  static Status<void> ReadBitCount(SizeType size, std::size_t* bit_count,
+                                   Reader* reader) {
+    if (size == 0)
+      return ErrorStatus::InvalidContainerLength;
+
+    std::uint8_t pad_bits = 0;
+    auto status = reader->Read(&pad_bits);
+    if (!status)
+      return status;
+    else if (pad_bits > 7 || (size == 1 && pad_bits != 0))
+      return ErrorStatus::InvalidContainerLength;
+
+    *bit_count = 8 * (size - 1) - pad_bits;
+    return {};
+  }
+
+  // Reads |bit_count| bits following the bit count. |SetBit(i, value)| sets
+  // bit i.
+  template <typename Reader, typename SetBit>
+  static Status<void> Read(std::size_t bit_count, SetBit set_bit,
+                           Reader* reader) {
+    std::uint8_t chunk[kChunkBytes + 8];
+    for (std::size_t bit = 0; bit < bit_count;) {
+      const std::size_t chunk_bits = std::min(bit_count - bit, kChunkBytes * 8);
+      const std::size_t chunk_bytes = (chunk_bits + 7) / 8;
+      auto status = reader->Read(&chunk[0], &chunk[chunk_bytes]);
+      if (!status)
+        return status;
+
+      // The last word of the chunk may be partial.
+      std::fill(&chunk[chunk_bytes], &chunk[chunk_bytes + 8], 0);
+      for (std::size_t offset = 0; offset < chunk_bits; offset += 64) {
+        const std::size_t word_bits = std::min<std::size_t>(chunk_bits - offset,
+                                                            64);
+        const std::uint64_t word = LoadWord(&chunk[offset / 8]);
+        if (bit + offset + word_bits == bit_count && word_bits < 64 &&
+            (word >> word_bits) != 0) {
+          return ErrorStatus::InvalidContainerLength;
+        }
+
+        for (std::size_t i = 0; i < word_bits; i++)
+          set_bit(bit + offset + i, ((word >> i) & 1) != 0);
+      }
+
+      bit += chunk_bits;
+    }
+
+    return {};
+  }
+
+ private:
+  static void StoreWord(std::uint64_t word, std::uint8_t* bytes) {
+    for (std::size_t i = 0; i < 8; i++)
+      bytes[i] = static_cast<std::uint8_t>(word >> (8 * i));
+  }
+
+  static std::uint64_t LoadWord(const std::uint8_t* bytes) {
+    std::uint64_t word = 0;
+    for (std::size_t i = 0; i < 8; i++)
+      word |= static_cast<std::uint64_t>(bytes[i]) << (8 * i);
+    return word;
+  }
+};
+
+template <typename Allocator>
+struct Encoding<std::vector<bool, Allocator>>
+    : EncodingIO<std::vector<bool, Allocator>> {
+  using Type = std::vector<bool, Allocator>;
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::Binary;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    const SizeType size = BitPacking::PackedSize(value.size());
+    return BaseEncodingSize(Prefix(value)) + Encoding<SizeType>::Size(size) +
+           size;
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Binary;
+  }
+
+  template <typename Writer>
+  static Status<void> WritePayload(EncodingByte /*prefix*/, const Type& value,
+                                   Writer* writer) {
+    return BitPacking::Write(
+        value.size(), [&value](std::size_t i) { return value[i]; }, writer);
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte /*prefix*/, Type* value,
+                                  Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    // Make sure the reader has enough data to fulfill the requested size as a
+    // defense against abusive or erroneous sizes.
+    status = reader->Ensure(size);
+    if (!status)
+      return status;
+
+    std::size_t bit_count = 0;
+    status = BitPacking::ReadBitCount(size, &bit_count, reader);
+    if (!status)
+      return status;
+
+    value->resize(bit_count);
+    return BitPacking::Read(
+        bit_count, [value](std::size_t i, bool bit) { (*value)[i] = bit; },
+        reader);
+  }
+};
+
+template <std::size_t Bits>
+struct Encoding<std::bitset<Bits>> : EncodingIO<std::bitset<Bits>> {
+  using Type = std::bitset<Bits>;
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::Binary;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    return BaseEncodingSize(Prefix(value)) +
+           Encoding<SizeType>::Size(BitPacking::PackedSize(Bits)) +
+           BitPacking::PackedSize(Bits);
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Binary;
+  }
+
+  template <typename Writer>
+  static Status<void> WritePayload(EncodingByte /*prefix*/, const Type& value,
+                                   Writer* writer) {
+    return BitPacking::Write(
+        Bits, [&value](std::size_t i) { return value[i]; }, writer);
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte /*prefix*/, Type* value,
+                                  Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+    else if (size != BitPacking::PackedSize(Bits))
+      return ErrorStatus::InvalidContainerLength;
+
+    std::size_t bit_count = 0;
+    status = BitPacking::ReadBitCount(size, &bit_count, reader);
+    if (!status)
+      return status;
+    else if (bit_count != Bits)
+      return ErrorStatus::InvalidContainerLength;
+
+    return BitPacking::Read(
+        Bits, [value](std::size_t i, bool bit) { value->set(i, bit); },
+        reader);
+  }
+};
+
+template <std::size_t Bits>
+struct FixedEncodingSize<std::bitset<Bits>> : std::true_type {
+  enum : std::size_t {
+    Size = BaseEncodingSize(EncodingByte::Binary) +
+           Encoding<SizeType>::Size(BitPacking::PackedSize(Bits)) +
+           BitPacking::PackedSize(Bits)
+  };
+};
+
+template <std::size_t Bits>
+struct MaxEncodingSize<std::bitset<Bits>> : std::true_type {
+  enum : std::size_t {
+    Size = BaseEncodingSize(EncodingByte::Binary) +
+           MaxEncodingSize<SizeType>::Size + BitPacking::PackedSize(Bits)
+  };
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_BITSET_H_
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_CANONICAL_H_
+#define LIBNOP_INCLUDE_NOP_BASE_CANONICAL_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/utility.h>
+#include <nop/types/handle.h>
+
+namespace nop {
+
+//
+// Canonical encoding.
+//
+// The encoding of a value is deterministic except for unordered containers,
+// which write their elements in hash table iteration order, so equal values may
+// have different encodings. Writers that produce the canonical encoding of each
+// value, suitable for hashing and comparing encodings, define a nested type
+// named Canonical:
+//
+//   class SomeWriter {
+//    public:
+//     using Canonical = void;
+//     ...
+//   };
+//
+// Unordered containers then write their elements in the lexicographic order of
+// the encoding of each element (or key/value pair), and sets of integral types
+// in increasing order of their elements. This does not change the encoded size
+// of any value, nor the format of the output, which reads as usual.
+//
+// Integers already use their smallest encoding, and tables and structures
+// write their members in a fixed order. Writers that change the encoding of
+// values, such as with Patch(), string interning, or fixed-width integers,
+// must not be combined with this mode. See CanonicalWriter.
+//
+template <typename Writer>
+using CanonicalTest = typename Writer::Canonical;
+
+// Evaluates to true if Writer produces the canonical encoding.
+template <typename Writer>
+using IsCanonicalWriter = IsDetected<CanonicalTest, Writer>;
+
+// Base class for writer wrappers that pass the Canonical property of the
+// underlying Writer through.
+template <typename Writer, typename Enabled = void>
+struct CanonicalWriterBase {};
+
+template <typename Writer>
+struct CanonicalWriterBase<Writer,
+                           std::enable_if_t<IsCanonicalWriter<Writer>::value>> {
+  using Canonical = void;
+};
+
+// Writer that collects the encodings of the elements of an unordered container
+// in a single buffer, recording where each one starts. Encodings of nested
+// unordered containers are sorted as well. Handles are pushed to the
+// underlying writer as they are encountered.
+template <typename Writer>
+class CanonicalElementWriter {
+ public:
+  using Canonical = void;
+
+  explicit CanonicalElementWriter(Writer* writer) : writer_{writer} {}
+
+  Status<void> Prepare(std::size_t /*size*/) { return {}; }
+
+  Status<void> Write(std::uint8_t byte) {
+    data_.push_back(byte);
+    return {};
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(begin);
+    data_.insert(data_.end(), bytes, bytes + (end - begin) * sizeof(T));
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    data_.insert(data_.end(), padding_bytes, padding_value);
+    return {};
+  }
+
+  template <typename HandleType>
+  Status<HandleReference> PushHandle(const HandleType& handle) {
+    return writer_->PushHandle(handle);
+  }
+
+  // Marks the start of the next element.
+  void BeginElement() { offsets_.push_back(data_.size()); }
+
+  // Writes the collected elements to the underlying writer in the order of
+  // their encodings.
+  Status<void> WriteSorted() {
+    const std::size_t count = offsets_.size();
+    offsets_.push_back(data_.size());
+
+    std::vector<std::size_t> order(count);
+    for (std::size_t i = 0; i < count; i++)
+      order[i] = i;
+
+    const std::uint8_t* data = data_.data();
+    const std::vector<std::size_t>& offsets = offsets_;
+    std::sort(order.begin(), order.end(),
+              [data, &offsets](std::size_t a, std::size_t b) {
+                return std::lexicographical_compare(
+                    data + offsets[a], data + offsets[a + 1],
+                    data + offsets[b], data + offsets[b + 1]);
+              });
+
+    for (std::size_t index : order) {
+      auto status =
+          writer_->Write(data + offsets[index], data + offsets[index + 1]);
+      if (!status)
+        return status;
+    }
+    return {};
+  }
+
+ private:
+  Writer* writer_;
+  std::vector<std::uint8_t> data_;
+  std::vector<std::size_t> offsets_;
+};
+
+// Writes the elements of the unordered container |value| with
+// |write_element|, which is invoked with each element and a writer pointer, in
+// the canonical order described above.
+template <typename Container, typename WriteElement, typename Writer>
+Status<void> WriteCanonicalElements(const Container& value,
+                                    WriteElement write_element,
+                                    Writer* writer) {
+  CanonicalElementWriter<Writer> element_writer{writer};
+  for (const auto& element : value) {
+    element_writer.BeginElement();
+    auto status = write_element(element, &element_writer);
+    if (!status)
+      return status;
+  }
+  return element_writer.WriteSorted();
+}
+
+// Writes the integers in the unordered container |value| as packed values in
+// increasing order.
+template <typename T, typename Container, typename Writer>
+Status<void> WriteCanonicalPacked(const Container& value, Writer* writer) {
+  std::vector<T> elements(value.begin(), value.end());
+  std::sort(elements.begin(), elements.end());
+  return WritePacked(elements.data(), elements.data() + elements.size(),
+                     writer);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_CANONICAL_H_
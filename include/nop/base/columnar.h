@@ -0,0 +1,352 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_COLUMNAR_H_
+#define LIBNOP_INCLUDE_NOP_BASE_COLUMNAR_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+#include <nop/base/encoding.h>
+#include <nop/base/members.h>
+#include <nop/base/utility.h>
+#include <nop/types/columnar.h>
+#include <nop/utility/endian.h>
+
+namespace nop {
+
+//
+// Columnar<T> encoding format:
+//
+// +-----+---------+-----//----+
+// | STC | INT64:M | M COLUMNS |
+// +-----+---------+-----//----+
+//
+// Where M is the number of members of T. Column i holds member i of each of the
+// N rows in the same format as std::vector of the member type:
+//
+// +-----+---------+---//----+
+// | BIN | INT64:L | L BYTES |
+// +-----+---------+---//----+
+//
+// for packable (integral, float, double and raw structure) members, where
+// L = N * sizeof(member), and
+//
+// +-----+---------+-----//-----+
+// | ARY | INT64:N | N ELEMENTS |
+// +-----+---------+-----//-----+
+//
+// for other members. Every column must have the same number of rows.
+//
+
+template <typename T, typename Allocator>
+struct Encoding<Columnar<T, Allocator>> : EncodingIO<Columnar<T, Allocator>> {
+  using Type = Columnar<T, Allocator>;
+
+  static_assert(HasMemberList<T>::value,
+                "Columnar elements must be structures with a member list.");
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::Structure;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    return BaseEncodingSize(Prefix(value)) + Encoding<SizeType>::Size(Count) +
+           Size(value, Index<Count>{});
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Structure;
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte /*prefix*/,
+                                             const Type& value,
+                                             Writer* writer) {
+    auto status = Encoding<SizeType>::Write(Count, writer);
+    if (!status)
+      return status;
+    else
+      return WriteColumns(value, writer, Index<Count>{});
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
+                                            Type* value, Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+    else if (size != Count)
+      return ErrorStatus::InvalidMemberCount;
+    else
+      return ReadColumns(value, reader, Index<Count>{});
+  }
+
+ private:
+  using MemberList = typename MemberListTraits<T>::MemberList;
+
+  enum : std::size_t { Count = MemberList::Count };
+  static_assert(Count > 0, "Columnar elements must have at least one member.");
+
+  template <std::size_t Index>
+  using PointerAt = typename MemberList::template At<Index>;
+
+  template <typename Pointer>
+  using IsPackedColumn = IsPackable<typename Pointer::Type>;
+
+  // Packed columns are gathered into and scattered from a small buffer to
+  // read and write them in large blocks.
+  enum : std::size_t { kChunkBytes = 1024 };
+
+  template <typename Pointer>
+  static constexpr std::size_t ChunkLength() {
+    return std::max<std::size_t>(kChunkBytes / sizeof(typename Pointer::Type),
+                                 1);
+  }
+
+  static constexpr std::size_t Size(const Type& /*value*/, Index<0>) {
+    return 0;
+  }
+
+  template <std::size_t index>
+  static constexpr std::size_t Size(const Type& value, Index<index>) {
+    using Pointer = PointerAt<index - 1>;
+    return Size(value, Index<index - 1>{}) +
+           ColumnSize<Pointer>(value, IsPackedColumn<Pointer>{});
+  }
+
+  template <typename Pointer>
+  static constexpr std::size_t ColumnSize(const Type& value, std::true_type) {
+    const SizeType length_bytes =
+        value.size() * sizeof(typename Pointer::Type);
+    return BaseEncodingSize(EncodingByte::Binary) +
+           Encoding<SizeType>::Size(length_bytes) + length_bytes;
+  }
+
+  template <typename Pointer>
+  static constexpr std::size_t ColumnSize(const Type& value, std::false_type) {
+    return BaseEncodingSize(EncodingByte::Array) +
+           Encoding<SizeType>::Size(value.size()) +
+           ElementsSize<Pointer>(
+               value,
+               std::integral_constant<
+                   bool, FixedEncodingSize<typename Pointer::Type>::value>{});
+  }
+
+  template <typename Pointer>
+  static constexpr std::size_t ElementsSize(const Type& value,
+                                            std::true_type) {
+    return value.size() * FixedEncodingSize<typename Pointer::Type>::Size;
+  }
+
+  template <typename Pointer>
+  static constexpr std::size_t ElementsSize(const Type& value,
+                                            std::false_type) {
+    std::size_t size = 0;
+    for (const T& row : value)
+      size += Pointer::Size(row);
+    return size;
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WriteColumns(const Type& /*value*/,
+                                             Writer* /*writer*/, Index<0>) {
+    return {};
+  }
+
+  template <std::size_t index, typename Writer>
+  static constexpr Status<void> WriteColumns(const Type& value, Writer* writer,
+                                             Index<index>) {
+    using Pointer = PointerAt<index - 1>;
+    auto status = WriteColumns(value, writer, Index<index - 1>{});
+    if (!status)
+      return status;
+    else
+      return WriteColumn<Pointer>(value, writer, IsPackedColumn<Pointer>{});
+  }
+
+  template <typename Pointer, typename Writer>
+  static Status<void> WriteColumn(const Type& value, Writer* writer,
+                                  std::true_type) {
+    using MemberType = typename Pointer::Type;
+    auto status =
+        writer->Write(static_cast<std::uint8_t>(EncodingByte::Binary));
+    if (!status)
+      return status;
+
+    status = Encoding<SizeType>::Write(value.size() * sizeof(MemberType),
+                                       writer);
+    if (!status)
+      return status;
+
+    MemberType chunk[ChunkLength<Pointer>()];
+    for (std::size_t row = 0; row < value.size();) {
+      const std::size_t count =
+          std::min(ChunkLength<Pointer>(), value.size() - row);
+      for (std::size_t i = 0; i < count; i++)
+        chunk[i] = Pointer::Resolve(value[row + i]);
+      ToLittleEndian(&chunk[0], &chunk[count]);
+
+      status = writer->Write(&chunk[0], &chunk[count]);
+      if (!status)
+        return status;
+
+      row += count;
+    }
+    return {};
+  }
+
+  template <typename Pointer, typename Writer>
+  static Status<void> WriteColumn(const Type& value, Writer* writer,
+                                  std::false_type) {
+    auto status = writer->Write(static_cast<std::uint8_t>(EncodingByte::Array));
+    if (!status)
+      return status;
+
+    status = Encoding<SizeType>::Write(value.size(), writer);
+    if (!status)
+      return status;
+
+    for (const T& row : value) {
+      status = Pointer::Write(row, writer, MemberList{});
+      if (!status)
+        return status;
+    }
+    return {};
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadColumns(Type* /*value*/,
+                                            Reader* /*reader*/, Index<0>) {
+    return {};
+  }
+
+  template <std::size_t index, typename Reader>
+  static constexpr Status<void> ReadColumns(Type* value, Reader* reader,
+                                            Index<index>) {
+    using Pointer = PointerAt<index - 1>;
+    auto status = ReadColumns(value, reader, Index<index - 1>{});
+    if (!status)
+      return status;
+    else
+      return ReadColumn<Pointer>(value, reader, index == 1,
+                                 IsPackedColumn<Pointer>{});
+  }
+
+  // Reads the prefix of a column and checks that it is |expected|.
+  template <typename Reader>
+  static Status<void> ReadColumnPrefix(EncodingByte expected, Reader* reader) {
+    std::uint8_t prefix = 0;
+    auto status = reader->Read(&prefix);
+    if (!status)
+      return status;
+    else if (static_cast<EncodingByte>(prefix) != expected)
+      return ErrorStatus::UnexpectedEncodingType;
+    else
+      return {};
+  }
+
+  // Reads a packed column. The first column determines the number of rows,
+  // which every following column must match.
+  template <typename Pointer, typename Reader>
+  static Status<void> ReadColumn(Type* value, Reader* reader, bool first,
+                                 std::true_type) {
+    using MemberType = typename Pointer::Type;
+    auto status = ReadColumnPrefix(EncodingByte::Binary, reader);
+    if (!status)
+      return status;
+
+    SizeType size = 0;
+    status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+    else if (size % sizeof(MemberType) != 0)
+      return ErrorStatus::InvalidContainerLength;
+
+    const SizeType length = size / sizeof(MemberType);
+    if (first) {
+      // Make sure the reader has enough data to fulfill the requested size as
+      // a defense against abusive or erroneous column sizes.
+      status = reader->Ensure(size);
+      if (!status)
+        return status;
+
+      value->resize(length);
+    } else if (length != value->size()) {
+      return ErrorStatus::InvalidContainerLength;
+    }
+
+    MemberType chunk[ChunkLength<Pointer>()];
+    for (std::size_t row = 0; row < length;) {
+      const std::size_t count = std::min(ChunkLength<Pointer>(), length - row);
+      status = reader->Read(&chunk[0], &chunk[count]);
+      if (!status)
+        return status;
+      FromLittleEndian(&chunk[0], &chunk[count]);
+
+      for (std::size_t i = 0; i < count; i++)
+        *Pointer::Resolve(&(*value)[row + i]) = chunk[i];
+
+      row += count;
+    }
+    return {};
+  }
+
+  template <typename Pointer, typename Reader>
+  static Status<void> ReadColumn(Type* value, Reader* reader, bool first,
+                                 std::false_type) {
+    auto status = ReadColumnPrefix(EncodingByte::Array, reader);
+    if (!status)
+      return status;
+
+    SizeType length = 0;
+    status = Encoding<SizeType>::Read(&length, reader);
+    if (!status)
+      return status;
+
+    if (first) {
+      // Rows are added as they are read, reusing existing rows, so that an
+      // abusive column length cannot allocate more rows than the input holds.
+      value->rows().reserve(ReserveCount(length, reader));
+      for (SizeType row = 0; row < length; row++) {
+        if (row == value->size())
+          value->emplace_back();
+
+        status = Pointer::Read(&(*value)[row], reader, MemberList{});
+        if (!status)
+          return status;
+      }
+      value->resize(length);
+      return {};
+    } else if (length != value->size()) {
+      return ErrorStatus::InvalidContainerLength;
+    }
+
+    for (T& row : value->rows()) {
+      status = Pointer::Read(&row, reader, MemberList{});
+      if (!status)
+        return status;
+    }
+    return {};
+  }
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_COLUMNAR_H_
@@ -0,0 +1,337 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_DELTA_H_
+#define LIBNOP_INCLUDE_NOP_BASE_DELTA_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <set>
+#include <type_traits>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/set.h>
+#include <nop/base/utility.h>
+#include <nop/base/vector.h>
+#include <nop/types/delta.h>
+
+namespace nop {
+
+//
+// Delta<Container> encoding format:
+//
+// +-----+------------+---------+---//----+
+// | EXT | INT64:CODE | INT64:L | L BYTES |
+// +-----+------------+---------+---//----+
+//
+// The L bytes hold the number of elements N followed by N differences, each
+// a little-endian base-128 varint: seven bits per byte, with the high bit set
+// on every byte but the last. The first difference is from zero. CODE selects
+// how the differences are represented:
+//
+//   1: Non-decreasing elements; each difference is the unsigned value of the
+//      element minus the previous element.
+//   2: Any order; each difference is the signed value of the element minus
+//      the previous element, zigzag encoded so that small negative
+//      differences are also small: 0, -1, 1, -2, 2 ... map to 0, 1, 2, 3, 4.
+//
+// Differences are computed modulo 2^B, where B is the width of the element
+// type, and may not exceed the range of B bits.
+//
+// Reading also accepts the regular encoding of Container.
+//
+
+// Inserts decoded elements into the container of a Delta.
+template <typename Container>
+class DeltaInserter;
+
+template <typename T, typename Allocator>
+class DeltaInserter<std::vector<T, Allocator>> {
+ public:
+  using Type = std::vector<T, Allocator>;
+
+  DeltaInserter(Type* value, std::size_t count) : value_{value} {
+    value_->clear();
+    value_->reserve(count);
+  }
+
+  void Insert(T element) { value_->push_back(element); }
+  void Finish() {}
+
+ private:
+  Type* value_;
+};
+
+template <typename T, typename Compare, typename Allocator>
+class DeltaInserter<std::set<T, Compare, Allocator>> {
+ public:
+  using Type = std::set<T, Compare, Allocator>;
+
+  DeltaInserter(Type* value, std::size_t /*count*/)
+      : value_{value}, position_{value->begin()} {}
+
+  void Insert(T element) { MergeOrderedElement(element, &position_, value_); }
+  void Finish() { value_->erase(position_, value_->end()); }
+
+ private:
+  Type* value_;
+  typename Type::iterator position_;
+};
+
+template <typename Container>
+struct Encoding<Delta<Container>> : EncodingIO<Delta<Container>> {
+  using Type = Delta<Container>;
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::Extension;
+  }
+
+  static std::size_t Size(const Type& value) {
+    const Layout layout = GetLayout(value);
+    return BaseEncodingSize(Prefix(value)) +
+           Encoding<SizeType>::Size(layout.code) +
+           Encoding<SizeType>::Size(layout.size) + layout.size;
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Extension ||
+           Encoding<Container>::Match(prefix);
+  }
+
+  template <typename Writer>
+  static Status<void> WritePayload(EncodingByte /*prefix*/, const Type& value,
+                                   Writer* writer) {
+    const Layout layout = GetLayout(value);
+    auto status = Encoding<SizeType>::Write(layout.code, writer);
+    if (!status)
+      return status;
+
+    status = Encoding<SizeType>::Write(layout.size, writer);
+    if (!status)
+      return status;
+
+    // Varints are gathered in a small buffer to write them in large blocks.
+    std::uint8_t buffer[kBufferSize];
+    std::uint8_t* output = PutVarint(buffer, value.size());
+    Unsigned previous = 0;
+    for (const T element : value) {
+      if (output > buffer + kBufferSize - kMaxVarintSize) {
+        status = writer->Write(buffer, output);
+        if (!status)
+          return status;
+        output = buffer;
+      }
+
+      const Unsigned difference = static_cast<Unsigned>(element) - previous;
+      output = PutVarint(output, layout.code == kZigZag ? ZigZag(difference)
+                                                        : difference);
+      previous = static_cast<Unsigned>(element);
+    }
+
+    return writer->Write(buffer, output);
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                  Reader* reader) {
+    if (prefix != EncodingByte::Extension)
+      return Encoding<Container>::ReadPayload(prefix, &value->get(), reader);
+
+    SizeType code = 0;
+    auto status = Encoding<SizeType>::Read(&code, reader);
+    if (!status)
+      return status;
+    else if (code != kAscending && code != kZigZag)
+      return ErrorStatus::UnexpectedEncodingType;
+
+    SizeType size = 0;
+    status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    // Make sure the reader has enough data to fulfill the requested size as a
+    // defense against abusive or erroneous sizes.
+    status = reader->Ensure(size);
+    if (!status)
+      return status;
+
+    return ReadElements(code == kZigZag, size, value, reader,
+                        IsContiguousReader<Reader>{});
+  }
+
+ private:
+  using T = typename Container::value_type;
+  using Unsigned = std::make_unsigned_t<T>;
+
+  enum : SizeType { kAscending = 1, kZigZag = 2 };
+  enum : std::size_t { kMaxVarintSize = 10, kBufferSize = 1024 };
+
+  // The representation and encoded size of the differences of a container.
+  struct Layout {
+    SizeType code;
+    SizeType size;
+  };
+
+  static Layout GetLayout(const Type& value) {
+    std::size_t ascending_size = VarintSize(value.size());
+    std::size_t zigzag_size = ascending_size;
+    bool ascending = true;
+
+    Unsigned previous = 0;
+    bool first = true;
+    for (const T element : value) {
+      const Unsigned difference = static_cast<Unsigned>(element) - previous;
+      ascending = ascending && (first || element >= static_cast<T>(previous));
+      ascending_size += VarintSize(difference);
+      zigzag_size += VarintSize(ZigZag(difference));
+      previous = static_cast<Unsigned>(element);
+      first = false;
+    }
+
+    if (ascending && ascending_size <= zigzag_size)
+      return {kAscending, ascending_size};
+    else
+      return {kZigZag, zigzag_size};
+  }
+
+  static Unsigned ZigZag(Unsigned difference) {
+    const Unsigned sign =
+        difference >> (std::numeric_limits<Unsigned>::digits - 1);
+    return static_cast<Unsigned>(difference << 1) ^
+           static_cast<Unsigned>(Unsigned{0} - sign);
+  }
+
+  static Unsigned UnZigZag(Unsigned value) {
+    return static_cast<Unsigned>(value >> 1) ^
+           static_cast<Unsigned>(Unsigned{0} - (value & 1));
+  }
+
+  static std::size_t VarintSize(std::uint64_t value) {
+    std::size_t size = 1;
+    while (value >= 0x80) {
+      value >>= 7;
+      size++;
+    }
+    return size;
+  }
+
+  static std::uint8_t* PutVarint(std::uint8_t* output, std::uint64_t value) {
+    while (value >= 0x80) {
+      *output++ = static_cast<std::uint8_t>(value | 0x80);
+      value >>= 7;
+    }
+    *output++ = static_cast<std::uint8_t>(value);
+    return output;
+  }
+
+  static bool GetVarint(const std::uint8_t** input, const std::uint8_t* end,
+                        std::uint64_t* value) {
+    std::uint64_t result = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (*input == end)
+        return false;
+
+      const std::uint8_t byte = *(*input)++;
+      result |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        *value = result;
+        return shift < 63 || byte <= 1;
+      }
+    }
+    return false;
+  }
+
+  template <typename Reader>
+  static Status<void> ReadElements(bool zigzag, SizeType size, Type* value,
+                                   Reader* reader, std::true_type) {
+    auto data = reader->Borrow(size);
+    if (!data)
+      return data.error();
+
+    return Decode(zigzag, data.get(), size, value);
+  }
+
+  template <typename Reader>
+  static Status<void> ReadElements(bool zigzag, SizeType size, Type* value,
+                                   Reader* reader, std::false_type) {
+    std::vector<std::uint8_t> data(size);
+    auto status = reader->Read(data.data(), data.data() + size);
+    if (!status)
+      return status;
+
+    return Decode(zigzag, data.data(), size, value);
+  }
+
+  static Status<void> Decode(bool zigzag, const std::uint8_t* data,
+                             std::size_t size, Type* value) {
+    const std::uint8_t* input = data;
+    const std::uint8_t* const end = data + size;
+
+    // Every element takes at least one byte, which bounds the count before
+    // any storage is reserved for it.
+    std::uint64_t count = 0;
+    if (!GetVarint(&input, end, &count) ||
+        count > static_cast<std::uint64_t>(end - input)) {
+      return ErrorStatus::InvalidContainerLength;
+    }
+
+    const std::uint64_t max = std::numeric_limits<Unsigned>::max();
+    DeltaInserter<Container> inserter{&value->get(),
+                                      static_cast<std::size_t>(count)};
+    Unsigned previous = 0;
+    for (std::uint64_t i = 0; i < count;) {
+      // Dense runs of one-byte differences are decoded eight at a time.
+      if (count - i >= 8 && end - input >= 8) {
+        std::uint64_t word;
+        std::memcpy(&word, input, sizeof(word));
+        if ((word & 0x8080808080808080ull) == 0) {
+          for (std::size_t j = 0; j < 8; j++) {
+            const Unsigned difference = input[j];
+            previous += zigzag ? UnZigZag(difference) : difference;
+            inserter.Insert(static_cast<T>(previous));
+          }
+          input += 8;
+          i += 8;
+          continue;
+        }
+      }
+
+      std::uint64_t difference = 0;
+      if (!GetVarint(&input, end, &difference) || difference > max)
+        return ErrorStatus::InvalidContainerLength;
+
+      const Unsigned delta = static_cast<Unsigned>(difference);
+      previous += zigzag ? UnZigZag(delta) : delta;
+      inserter.Insert(static_cast<T>(previous));
+      i++;
+    }
+    inserter.Finish();
+
+    if (input != end)
+      return ErrorStatus::InvalidContainerLength;
+    else
+      return {};
+  }
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_DELTA_H_
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_DEQUE_H_
+#define LIBNOP_INCLUDE_NOP_BASE_DEQUE_H_
+
+#include <deque>
+#include <type_traits>
+
+#include <nop/base/encoding.h>
+#include <nop/base/utility.h>
+
+namespace nop {
+
+//
+// std::deque<T> encoding format for non-packable types:
+//
+// +-----+---------+-----//-----+
+// | ARY | INT64:N | N ELEMENTS |
+// +-----+---------+-----//-----+
+//
+// Elements must be valid encodings of type T.
+//
+// std::deque<T> encoding format for packable (integral, float, and double)
+// types:
+//
+// +-----+---------+---//----+
+// | BIN | INT64:L | L BYTES |
+// +-----+---------+---//----+
+//
+// Where L = N * sizeof(T).
+//
+// The formats are the same as std::vector<T>, and the two are fungible. The
+// elements of a deque of packable types are stored in fixed-size blocks, each
+// of which is written and read with a single bulk operation.
+//
+// Deques of floating point and enum flags types also accept the ARY format
+// when reading, which older versions of the library used for these types.
+//
+
+// Calls |function| with the bounds of each run of consecutive elements of the
+// segmented container |value| that are contiguous in memory, in order.
+template <typename Container, typename Function>
+Status<void> ForEachContiguousRun(Container&& value, Function&& function) {
+  auto iterator = value.begin();
+  const auto end = value.end();
+  while (iterator != end) {
+    auto* first = &*iterator;
+    auto* last = first + 1;
+    for (++iterator; iterator != end && &*iterator == last; ++iterator)
+      ++last;
+
+    auto status = function(first, last);
+    if (!status)
+      return status;
+  }
+
+  return {};
+}
+
+// Specialization for non-packable types.
+template <typename T, typename Allocator>
+struct Encoding<std::deque<T, Allocator>, EnableIfNotPackable<T>>
+    : EncodingIO<std::deque<T, Allocator>> {
+  using Type = std::deque<T, Allocator>;
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::Array;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    return BaseEncodingSize(Prefix(value)) +
+           Encoding<SizeType>::Size(value.size()) +
+           ElementsEncodingSize<T>(value);
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Array;
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte /*prefix*/,
+                                             const Type& value,
+                                             Writer* writer) {
+    auto status = Encoding<SizeType>::Write(value.size(), writer);
+    if (!status)
+      return status;
+
+    for (const T& element : value) {
+      status = Encoding<T>::Write(element, writer);
+      if (!status)
+        return status;
+    }
+
+    return {};
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
+                                            Type* value, Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    // Elements already in the deque are decoded into in place and any extra
+    // elements are appended.
+    return ReadSequenceElements<T>(size, value, reader);
+  }
+};
+
+// Specialization for packable types.
+template <typename T, typename Allocator>
+struct Encoding<std::deque<T, Allocator>, EnableIfPackable<T>>
+    : EncodingIO<std::deque<T, Allocator>> {
+  using Type = std::deque<T, Allocator>;
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::Binary;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    const SizeType size = value.size() * sizeof(T);
+    return BaseEncodingSize(Prefix(value)) + Encoding<SizeType>::Size(size) +
+           size;
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Binary ||
+           (HasLegacyArrayFormat<T>::value && prefix == EncodingByte::Array);
+  }
+
+  template <typename Writer>
+  static Status<void> WritePayload(EncodingByte /*prefix*/, const Type& value,
+                                   Writer* writer) {
+    const SizeType length = value.size();
+    const SizeType length_bytes = length * sizeof(T);
+    auto status = Encoding<SizeType>::Write(length_bytes, writer);
+    if (!status)
+      return status;
+
+    return ForEachContiguousRun(value, [writer](const T* begin, const T* end) {
+      return WritePacked(begin, end, writer);
+    });
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                  Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    if (prefix == EncodingByte::Array)
+      return ReadElements(size, value, reader);
+
+    if (size % sizeof(T) != 0)
+      return ErrorStatus::InvalidContainerLength;
+
+    const SizeType length = size / sizeof(T);
+
+    // Make sure the reader has enough data to fulfill the requested size as a
+    // defense against abusive or erroneous binary container sizes.
+    status = reader->Ensure(length);
+    if (!status)
+      return status;
+
+    value->resize(length);
+    return ForEachContiguousRun(*value, [reader](T* begin, T* end) {
+      return ReadPacked(begin, end, reader);
+    });
+  }
+
+ private:
+  // Reads |size| individually encoded elements of the legacy ARY format.
+  template <typename Reader>
+  static Status<void> ReadElements(SizeType size, Type* value,
+                                   Reader* reader) {
+    value->clear();
+    for (SizeType i = 0; i < size; i++) {
+      T element;
+      auto status = Encoding<T>::Read(&element, reader);
+      if (!status)
+        return status;
+
+      value->push_back(element);
+    }
+
+    return {};
+  }
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_DEQUE_H_
@@ -0,0 +1,807 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_DIFF_H_
+#define LIBNOP_INCLUDE_NOP_BASE_DIFF_H_
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/members.h>
+#include <nop/base/table.h>
+#include <nop/base/utility.h>
+#include <nop/table.h>
+#include <nop/types/detail/logical_buffer.h>
+#include <nop/utility/bounded_reader.h>
+#include <nop/utility/bounded_writer.h>
+
+namespace nop {
+
+//
+// Diffs of tables and structures, for sending successive snapshots of a large
+// value when only a small part of it changes between snapshots. WriteDiff()
+// compares the previous and current snapshots and writes only what changed;
+// ReadDiff() applies the diff in place onto the previous snapshot held by the
+// reader.
+//
+// Table diff format:
+//
+// +-----+---------+---------+------------+---------+-----------+---------+
+// | EXT | INT64:7 | INT64:L | INT64:HASH | INT64:N | N ENTRIES | INT64:M |
+// +-----+---------+---------+------------+---------+-----------+---------+
+//
+// +-------------+---------+
+// | M INT64:IDs | PADDING |
+// +-------------+---------+
+//
+// The N entries have the same format as the entries of the table encoding,
+// but hold only the entries that were added or changed, and VALUE is a diff.
+// The M ids are the tombstones of the entries that were removed. Entries with
+// ids the reader does not know are skipped, and unknown tombstones ignored.
+//
+// Structure diff format:
+//
+// +-----+---------+---------+---------+-------------------------+---------+
+// | EXT | INT64:8 | INT64:L | INT64:N | N (INT64:INDEX | VALUE) | PADDING |
+// +-----+---------+---------+---------+-------------------------+---------+
+//
+// The N members are the members that changed, by increasing index in the
+// member list, and VALUE is a diff.
+//
+// The diff of a value that is not a table or structure, or of a table entry
+// that was added, is the regular encoding of its current value, which the
+// reader decodes over the previous value. Likewise, reading the diff of a table
+// or structure also accepts its regular encoding, so that a full snapshot may
+// be sent in place of a diff, for example to a new subscriber. L is the number
+// of bytes following it, which may include padding when the encoded size of a
+// value is overestimated.
+//
+// Values are compared with operator==, so the types of table entries and
+// structure members must be equality comparable unless they are tables,
+// structures, or arrays or vectors of those.
+//
+// Example:
+//
+//   nop::VectorWriter writer;
+//   auto status = nop::WriteDiff(previous_state, state, &writer);
+//   previous_state = state;
+//   ...
+//   nop::BufferReader reader{data, size};
+//   status = nop::ReadDiff(&subscriber_state, &reader);
+//
+
+// Diff operations for values of type T.
+template <typename T, typename Enabled = void>
+struct DiffEncoding;
+
+// Compares values that are diffed as a whole with operator==. Arrays, vectors,
+// and logical buffers compare element by element, so that their elements may
+// be tables or structures without operator==.
+template <typename T>
+bool DiffEqual(const T& a, const T& b) {
+  return a == b;
+}
+
+template <typename T, std::size_t Length>
+bool DiffEqual(const T (&a)[Length], const T (&b)[Length]) {
+  for (std::size_t i = 0; i < Length; i++) {
+    if (!DiffEncoding<T>::Equal(a[i], b[i]))
+      return false;
+  }
+  return true;
+}
+
+template <typename T, typename Allocator>
+bool DiffEqual(const std::vector<T, Allocator>& a,
+               const std::vector<T, Allocator>& b) {
+  if (a.size() != b.size())
+    return false;
+
+  for (std::size_t i = 0; i < a.size(); i++) {
+    if (!DiffEncoding<T>::Equal(a[i], b[i]))
+      return false;
+  }
+  return true;
+}
+
+template <typename BufferType, typename SizeType, bool IsUnbounded>
+bool DiffEqual(const LogicalBuffer<BufferType, SizeType, IsUnbounded>& a,
+               const LogicalBuffer<BufferType, SizeType, IsUnbounded>& b) {
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+// By default, values are compared with DiffEqual() and the diff is the regular
+// encoding of the current value.
+template <typename T, typename Enabled>
+struct DiffEncoding {
+  static bool Equal(const T& a, const T& b) { return DiffEqual(a, b); }
+
+  static std::size_t Size(const T& /*previous*/, const T& current) {
+    return Encoding<T>::Size(current);
+  }
+
+  template <typename Writer>
+  static Status<void> Write(const T& /*previous*/, const T& current,
+                            Writer* writer) {
+    return Encoding<T>::Write(current, writer);
+  }
+
+  template <typename Reader>
+  static Status<void> Read(T* value, Reader* reader) {
+    return Encoding<T>::Read(value, reader);
+  }
+};
+
+// Evaluates to true if values of type T are diffed member by member or entry
+// by entry, rather than as a whole.
+template <typename T>
+using IsDiffAggregate = std::integral_constant<
+    bool, HasEntryList<T>::value ||
+              (HasMemberList<T>::value && !IsRawStructure<T>::value)>;
+
+// Common implementation of the table and structure diffs, which are
+// extensions with the given code. Derived provides PayloadSize(),
+// WritePayload(), and ReadPayload() for the bytes following L.
+template <typename T, SizeType Code, typename Derived>
+struct DiffExtension {
+  enum : SizeType { kCode = Code };
+
+  static std::size_t Size(const T& previous, const T& current) {
+    const std::size_t size = Derived::PayloadSize(previous, current);
+    return BaseEncodingSize(EncodingByte::Extension) +
+           Encoding<SizeType>::Size(Code) + Encoding<SizeType>::Size(size) +
+           size;
+  }
+
+  template <typename Writer>
+  static Status<void> Write(const T& previous, const T& current,
+                            Writer* writer) {
+    auto status =
+        writer->Write(static_cast<std::uint8_t>(EncodingByte::Extension));
+    if (!status)
+      return status;
+
+    status = Encoding<SizeType>::Write(Code, writer);
+    if (!status)
+      return status;
+
+    const SizeType size = Derived::PayloadSize(previous, current);
+    status = Encoding<SizeType>::Write(size, writer);
+    if (!status)
+      return status;
+
+    // Pad out the payload in case the size of a value is overestimated, as
+    // table entries do.
+    BoundedWriterScope<Writer> scope{writer, size};
+    status = scope.status();
+    if (!status)
+      return status;
+
+    status = Derived::WritePayload(previous, current, scope.writer());
+    if (!status)
+      return status;
+
+    return scope.WritePadding();
+  }
+
+  template <typename Reader>
+  static Status<void> Read(T* value, Reader* reader) {
+    std::uint8_t prefix_byte = 0;
+    auto status = reader->Read(&prefix_byte);
+    if (!status)
+      return status;
+
+    // A regular encoding replaces the value in full.
+    const EncodingByte prefix = static_cast<EncodingByte>(prefix_byte);
+    if (prefix != EncodingByte::Extension) {
+      if (Encoding<T>::Match(prefix))
+        return Encoding<T>::ReadPayload(prefix, value, reader);
+      else
+        return ErrorStatus::UnexpectedEncodingType;
+    }
+
+    SizeType code = 0;
+    status = Encoding<SizeType>::Read(&code, reader);
+    if (!status)
+      return status;
+    else if (code != Code)
+      return ErrorStatus::UnexpectedEncodingType;
+
+    SizeType size = 0;
+    status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    BoundedReaderScope<Reader> scope{reader, size};
+    status = scope.status();
+    if (!status)
+      return status;
+
+    status = Derived::ReadPayload(value, scope.reader());
+    if (!status)
+      return status;
+
+    return scope.ReadPadding();
+  }
+};
+
+template <typename Table>
+struct DiffEncoding<Table, EnableIfHasEntryList<Table>>
+    : DiffExtension<Table, 7, DiffEncoding<Table>> {
+  static bool Equal(const Table& a, const Table& b) {
+    return Equal(a, b, Index<Count>{});
+  }
+
+ private:
+  friend struct DiffExtension<Table, 7, DiffEncoding<Table>>;
+
+  enum : std::size_t { Count = EntryListTraits<Table>::EntryList::Count };
+
+  // Set of entries indexed by position in the entry list.
+  using EntrySet = std::bitset<Count>;
+
+  template <std::size_t Index>
+  using PointerAt =
+      typename EntryListTraits<Table>::EntryList::template At<Index>;
+
+  template <typename>
+  struct EntryIndexFor;
+  template <std::size_t... Is>
+  struct EntryIndexFor<std::index_sequence<Is...>> {
+    using Type = EntryIdIndex<PointerAt<Is>::Type::Id...>;
+  };
+
+  // Index mapping the id of each entry to its position in the entry list.
+  using EntryIndex =
+      typename EntryIndexFor<std::make_index_sequence<Count>>::Type;
+
+  // The entries that were added or changed and the entries that were removed.
+  struct Changes {
+    EntrySet changed;
+    EntrySet removed;
+  };
+
+  template <typename T, std::uint64_t Id>
+  static bool EntryEqual(const Entry<T, Id, ActiveEntry>& a,
+                         const Entry<T, Id, ActiveEntry>& b) {
+    if (a.empty() || b.empty())
+      return a.empty() == b.empty();
+    else
+      return DiffEncoding<T>::Equal(a.get(), b.get());
+  }
+
+  template <typename T, std::uint64_t Id>
+  static bool EntryEqual(const Entry<T, Id, DeletedEntry>& /*a*/,
+                         const Entry<T, Id, DeletedEntry>& /*b*/) {
+    return true;
+  }
+
+  static bool Equal(const Table& /*a*/, const Table& /*b*/, Index<0>) {
+    return true;
+  }
+
+  template <std::size_t index>
+  static bool Equal(const Table& a, const Table& b, Index<index>) {
+    using Pointer = PointerAt<index - 1>;
+    return Equal(a, b, Index<index - 1>{}) &&
+           EntryEqual(Pointer::Resolve(a), Pointer::Resolve(b));
+  }
+
+  static void FindChanges(const Table& /*previous*/, const Table& /*current*/,
+                          Changes* /*changes*/, Index<0>) {}
+
+  template <std::size_t index>
+  static void FindChanges(const Table& previous, const Table& current,
+                          Changes* changes, Index<index>) {
+    FindChanges(previous, current, changes, Index<index - 1>{});
+
+    using Pointer = PointerAt<index - 1>;
+    const auto& previous_entry = Pointer::Resolve(previous);
+    const auto& current_entry = Pointer::Resolve(current);
+    if (current_entry && !EntryEqual(previous_entry, current_entry))
+      changes->changed.set(index - 1);
+    else if (previous_entry && !current_entry)
+      changes->removed.set(index - 1);
+  }
+
+  static Changes FindChanges(const Table& previous, const Table& current) {
+    Changes changes;
+    FindChanges(previous, current, &changes, Index<Count>{});
+    return changes;
+  }
+
+  // Returns the size of the diff of an added or changed entry value.
+  template <typename T, std::uint64_t Id>
+  static std::size_t ValueSize(const Entry<T, Id, ActiveEntry>& previous,
+                               const Entry<T, Id, ActiveEntry>& current) {
+    if (previous)
+      return DiffEncoding<T>::Size(previous.get(), current.get());
+    else
+      return Encoding<T>::Size(current.get());
+  }
+
+  template <typename T, std::uint64_t Id>
+  static std::size_t ValueSize(const Entry<T, Id, DeletedEntry>& /*previous*/,
+                               const Entry<T, Id, DeletedEntry>& /*current*/) {
+    return 0;
+  }
+
+  static std::size_t ChangesSize(const Table& /*previous*/,
+                                 const Table& /*current*/,
+                                 const Changes& /*changes*/, Index<0>) {
+    return 0;
+  }
+
+  template <std::size_t index>
+  static std::size_t ChangesSize(const Table& previous, const Table& current,
+                                 const Changes& changes, Index<index>) {
+    using Pointer = PointerAt<index - 1>;
+    const std::size_t size =
+        ChangesSize(previous, current, changes, Index<index - 1>{});
+    const std::uint64_t id = Pointer::Type::Id;
+
+    if (changes.changed[index - 1]) {
+      const std::size_t value_size =
+          ValueSize(Pointer::Resolve(previous), Pointer::Resolve(current));
+      return size + Encoding<std::uint64_t>::Size(id) +
+             Encoding<SizeType>::Size(value_size) + value_size;
+    } else if (changes.removed[index - 1]) {
+      return size + Encoding<std::uint64_t>::Size(id);
+    } else {
+      return size;
+    }
+  }
+
+  static std::size_t PayloadSize(const Table& previous, const Table& current) {
+    const Changes changes = FindChanges(previous, current);
+    return Encoding<std::uint64_t>::Size(
+               EntryListTraits<Table>::EntryList::Hash) +
+           Encoding<SizeType>::Size(changes.changed.count()) +
+           Encoding<SizeType>::Size(changes.removed.count()) +
+           ChangesSize(previous, current, changes, Index<Count>{});
+  }
+
+  template <typename T, std::uint64_t Id, typename Writer>
+  static Status<void> WriteValue(const Entry<T, Id, ActiveEntry>& previous,
+                                 const Entry<T, Id, ActiveEntry>& current,
+                                 Writer* writer) {
+    const SizeType size = ValueSize(previous, current);
+    auto status = Encoding<SizeType>::Write(size, writer);
+    if (!status)
+      return status;
+
+    BoundedWriterScope<Writer> scope{writer, size};
+    status = scope.status();
+    if (!status)
+      return status;
+
+    if (previous)
+      status = DiffEncoding<T>::Write(previous.get(), current.get(),
+                                      scope.writer());
+    else
+      status = Encoding<T>::Write(current.get(), scope.writer());
+    if (!status)
+      return status;
+
+    return scope.WritePadding();
+  }
+
+  template <typename T, std::uint64_t Id, typename Writer>
+  static Status<void> WriteValue(
+      const Entry<T, Id, DeletedEntry>& /*previous*/,
+      const Entry<T, Id, DeletedEntry>& /*current*/, Writer* /*writer*/) {
+    return {};
+  }
+
+  template <typename Writer>
+  static Status<void> WriteChanged(const Table& /*previous*/,
+                                   const Table& /*current*/,
+                                   const Changes& /*changes*/,
+                                   Writer* /*writer*/, Index<0>) {
+    return {};
+  }
+
+  template <std::size_t index, typename Writer>
+  static Status<void> WriteChanged(const Table& previous, const Table& current,
+                                   const Changes& changes, Writer* writer,
+                                   Index<index>) {
+    auto status =
+        WriteChanged(previous, current, changes, writer, Index<index - 1>{});
+    if (!status || !changes.changed[index - 1])
+      return status;
+
+    using Pointer = PointerAt<index - 1>;
+    status = Encoding<std::uint64_t>::Write(Pointer::Type::Id, writer);
+    if (!status)
+      return status;
+
+    return WriteValue(Pointer::Resolve(previous), Pointer::Resolve(current),
+                      writer);
+  }
+
+  template <typename Writer>
+  static Status<void> WriteRemoved(const Changes& /*changes*/,
+                                   Writer* /*writer*/, Index<0>) {
+    return {};
+  }
+
+  template <std::size_t index, typename Writer>
+  static Status<void> WriteRemoved(const Changes& changes, Writer* writer,
+                                   Index<index>) {
+    auto status = WriteRemoved(changes, writer, Index<index - 1>{});
+    if (!status || !changes.removed[index - 1])
+      return status;
+
+    return Encoding<std::uint64_t>::Write(PointerAt<index - 1>::Type::Id,
+                                          writer);
+  }
+
+  template <typename Writer>
+  static Status<void> WritePayload(const Table& previous, const Table& current,
+                                   Writer* writer) {
+    const Changes changes = FindChanges(previous, current);
+    auto status = Encoding<std::uint64_t>::Write(
+        EntryListTraits<Table>::EntryList::Hash, writer);
+    if (!status)
+      return status;
+
+    status = Encoding<SizeType>::Write(changes.changed.count(), writer);
+    if (!status)
+      return status;
+
+    status = WriteChanged(previous, current, changes, writer, Index<Count>{});
+    if (!status)
+      return status;
+
+    status = Encoding<SizeType>::Write(changes.removed.count(), writer);
+    if (!status)
+      return status;
+
+    return WriteRemoved(changes, writer, Index<Count>{});
+  }
+
+  template <typename T, std::uint64_t Id, typename Reader>
+  static Status<void> ReadValue(Entry<T, Id, ActiveEntry>* entry,
+                                Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    // Added entries are read onto a default value.
+    if (entry->empty())
+      *entry = T{};
+
+    BoundedReaderScope<Reader> scope{reader, size};
+    status = scope.status();
+    if (!status)
+      return status;
+
+    status = DiffEncoding<T>::Read(&entry->get(), scope.reader());
+    if (!status)
+      return status;
+
+    return scope.ReadPadding();
+  }
+
+  template <typename T, std::uint64_t Id, typename Reader>
+  static Status<void> ReadValue(Entry<T, Id, DeletedEntry>* /*entry*/,
+                                Reader* reader) {
+    return SkipEntry(reader);
+  }
+
+  template <typename Reader, std::size_t index>
+  static Status<void> ReadValueAt(Table* value, Reader* reader) {
+    return ReadValue(PointerAt<index>::Resolve(value), reader);
+  }
+
+  // Skips over the binary container for an entry.
+  template <typename Reader>
+  static Status<void> SkipEntry(Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    return reader->Skip(size);
+  }
+
+  template <typename Reader>
+  static Status<void> SkipUnknownValue(Table* /*value*/, Reader* reader) {
+    return SkipEntry(reader);
+  }
+
+  template <std::size_t index>
+  static void ClearAt(Table* value) {
+    PointerAt<index>::Resolve(value)->clear();
+  }
+
+  template <typename Reader, std::size_t... Is>
+  static Status<void> ReadChanged(Table* value, Reader* reader,
+                                  std::index_sequence<Is...>) {
+    using Function = Status<void> (*)(Table*, Reader*);
+    static constexpr Function functions[] = {&ReadValueAt<Reader, Is>...,
+                                             &SkipUnknownValue<Reader>};
+
+    SizeType count = 0;
+    auto status = Encoding<SizeType>::Read(&count, reader);
+    if (!status)
+      return status;
+
+    EntrySet seen;
+    for (SizeType i = 0; i < count; i++) {
+      std::uint64_t id = 0;
+      status = Encoding<std::uint64_t>::Read(&id, reader);
+      if (!status)
+        return status;
+
+      const std::size_t index = EntryIndex::Find(id);
+      if (index < Count) {
+        if (seen[index])
+          return ErrorStatus::DuplicateTableEntry;
+        seen.set(index);
+      }
+
+      status = functions[index](value, reader);
+      if (!status)
+        return status;
+    }
+    return {};
+  }
+
+  template <typename Reader, std::size_t... Is>
+  static Status<void> ReadRemoved(Table* value, Reader* reader,
+                                  std::index_sequence<Is...>) {
+    using Function = void (*)(Table*);
+    static constexpr Function functions[] = {&ClearAt<Is>...};
+
+    SizeType count = 0;
+    auto status = Encoding<SizeType>::Read(&count, reader);
+    if (!status)
+      return status;
+
+    for (SizeType i = 0; i < count; i++) {
+      std::uint64_t id = 0;
+      status = Encoding<std::uint64_t>::Read(&id, reader);
+      if (!status)
+        return status;
+
+      const std::size_t index = EntryIndex::Find(id);
+      if (index < Count)
+        functions[index](value);
+    }
+    return {};
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(Table* value, Reader* reader) {
+    std::uint64_t hash = 0;
+    auto status = Encoding<std::uint64_t>::Read(&hash, reader);
+    if (!status)
+      return status;
+    else if (hash != EntryListTraits<Table>::EntryList::Hash)
+      return ErrorStatus::InvalidTableHash;
+
+    status = ReadChanged(value, reader, std::make_index_sequence<Count>{});
+    if (!status)
+      return status;
+
+    return ReadRemoved(value, reader, std::make_index_sequence<Count>{});
+  }
+};
+
+template <typename T>
+struct DiffEncoding<T, EnableIfStructure<T>>
+    : DiffExtension<T, 8, DiffEncoding<T>> {
+  static bool Equal(const T& a, const T& b) {
+    return Equal(a, b, Index<Count>{});
+  }
+
+ private:
+  friend struct DiffExtension<T, 8, DiffEncoding<T>>;
+
+  using MemberList = typename MemberListTraits<T>::MemberList;
+  enum : std::size_t { Count = MemberList::Count };
+
+  // Set of members indexed by position in the member list.
+  using MemberSet = std::bitset<Count>;
+
+  template <std::size_t Index>
+  using PointerAt = typename MemberList::template At<Index>;
+
+  template <std::size_t index>
+  static bool MemberEqual(const T& a, const T& b) {
+    using Pointer = PointerAt<index>;
+    using Type = typename Pointer::Type;
+    return DiffEncoding<Type>::Equal(Pointer::Resolve(a), Pointer::Resolve(b));
+  }
+
+  static bool Equal(const T& /*a*/, const T& /*b*/, Index<0>) { return true; }
+
+  template <std::size_t index>
+  static bool Equal(const T& a, const T& b, Index<index>) {
+    return Equal(a, b, Index<index - 1>{}) && MemberEqual<index - 1>(a, b);
+  }
+
+  static void FindChanges(const T& /*previous*/, const T& /*current*/,
+                          MemberSet* /*changed*/, Index<0>) {}
+
+  template <std::size_t index>
+  static void FindChanges(const T& previous, const T& current,
+                          MemberSet* changed, Index<index>) {
+    FindChanges(previous, current, changed, Index<index - 1>{});
+    if (!MemberEqual<index - 1>(previous, current))
+      changed->set(index - 1);
+  }
+
+  static MemberSet FindChanges(const T& previous, const T& current) {
+    MemberSet changed;
+    FindChanges(previous, current, &changed, Index<Count>{});
+    return changed;
+  }
+
+  static std::size_t ChangesSize(const T& /*previous*/, const T& /*current*/,
+                                 const MemberSet& /*changed*/, Index<0>) {
+    return 0;
+  }
+
+  template <std::size_t index>
+  static std::size_t ChangesSize(const T& previous, const T& current,
+                                 const MemberSet& changed, Index<index>) {
+    using Pointer = PointerAt<index - 1>;
+    using Type = typename Pointer::Type;
+    const std::size_t size =
+        ChangesSize(previous, current, changed, Index<index - 1>{});
+    if (!changed[index - 1])
+      return size;
+
+    return size + Encoding<SizeType>::Size(index - 1) +
+           DiffEncoding<Type>::Size(Pointer::Resolve(previous),
+                                    Pointer::Resolve(current));
+  }
+
+  static std::size_t PayloadSize(const T& previous, const T& current) {
+    const MemberSet changed = FindChanges(previous, current);
+    return Encoding<SizeType>::Size(changed.count()) +
+           ChangesSize(previous, current, changed, Index<Count>{});
+  }
+
+  template <typename Writer>
+  static Status<void> WriteChanged(const T& /*previous*/,
+                                   const T& /*current*/,
+                                   const MemberSet& /*changed*/,
+                                   Writer* /*writer*/, Index<0>) {
+    return {};
+  }
+
+  template <std::size_t index, typename Writer>
+  static Status<void> WriteChanged(const T& previous, const T& current,
+                                   const MemberSet& changed, Writer* writer,
+                                   Index<index>) {
+    auto status =
+        WriteChanged(previous, current, changed, writer, Index<index - 1>{});
+    if (!status || !changed[index - 1])
+      return status;
+
+    status = Encoding<SizeType>::Write(index - 1, writer);
+    if (!status)
+      return status;
+
+    using Pointer = PointerAt<index - 1>;
+    using Type = typename Pointer::Type;
+    return DiffEncoding<Type>::Write(Pointer::Resolve(previous),
+                                     Pointer::Resolve(current), writer);
+  }
+
+  template <typename Writer>
+  static Status<void> WritePayload(const T& previous, const T& current,
+                                   Writer* writer) {
+    const MemberSet changed = FindChanges(previous, current);
+    auto status = Encoding<SizeType>::Write(changed.count(), writer);
+    if (!status)
+      return status;
+
+    return WriteChanged(previous, current, changed, writer, Index<Count>{});
+  }
+
+  // Members that are tables or structures apply their diffs in place; other
+  // members are read through their member pointers, which also handles
+  // logical buffers.
+  template <typename Reader, std::size_t index>
+  static Status<void> ReadMember(T* value, Reader* reader, std::true_type) {
+    using Pointer = PointerAt<index>;
+    using Type = typename Pointer::Type;
+    return DiffEncoding<Type>::Read(Pointer::Resolve(value), reader);
+  }
+
+  template <typename Reader, std::size_t index>
+  static Status<void> ReadMember(T* value, Reader* reader, std::false_type) {
+    return PointerAt<index>::Read(value, reader, MemberList{});
+  }
+
+  template <typename Reader, std::size_t index>
+  static Status<void> ReadMemberAt(T* value, Reader* reader) {
+    using Type = typename PointerAt<index>::Type;
+    return ReadMember<Reader, index>(value, reader, IsDiffAggregate<Type>{});
+  }
+
+  template <typename Reader, std::size_t... Is>
+  static Status<void> ReadChanged(T* value, Reader* reader,
+                                  std::index_sequence<Is...>) {
+    using Function = Status<void> (*)(T*, Reader*);
+    static constexpr Function functions[] = {&ReadMemberAt<Reader, Is>...};
+
+    SizeType count = 0;
+    auto status = Encoding<SizeType>::Read(&count, reader);
+    if (!status)
+      return status;
+    else if (count > Count)
+      return ErrorStatus::InvalidMemberCount;
+
+    for (SizeType i = 0; i < count; i++) {
+      SizeType index = 0;
+      status = Encoding<SizeType>::Read(&index, reader);
+      if (!status)
+        return status;
+      else if (index >= Count)
+        return ErrorStatus::InvalidMemberCount;
+
+      status = functions[index](value, reader);
+      if (!status)
+        return status;
+    }
+    return {};
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(T* value, Reader* reader) {
+    return ReadChanged(value, reader, std::make_index_sequence<Count>{});
+  }
+};
+
+// Returns the size of the diff from |previous| to |current|.
+template <typename T>
+std::size_t GetDiffSize(const T& previous, const T& current) {
+  return DiffEncoding<T>::Size(previous, current);
+}
+
+// Writes the diff from |previous| to |current|, which ReadDiff() applies to a
+// copy of |previous| to make it equal to |current|.
+template <typename T, typename Writer>
+Status<void> WriteDiff(const T& previous, const T& current, Writer* writer) {
+  auto status = writer->Prepare(GetDiffSize(previous, current));
+  if (!status)
+    return status;
+
+  return DiffEncoding<T>::Write(previous, current, writer);
+}
+
+// Applies a diff written by WriteDiff() to |value| in place. The regular
+// encoding of T is also accepted and replaces |value|.
+template <typename T, typename Reader>
+Status<void> ReadDiff(T* value, Reader* reader) {
+  return DiffEncoding<T>::Read(value, reader);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_DIFF_H_
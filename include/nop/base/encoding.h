@@ -19,15 +19,21 @@
 
 #include <errno.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <type_traits>
 #include <vector>
 
 #include <nop/base/encoding_byte.h>
 #include <nop/base/utility.h>
+#include <nop/types/handle.h>
 #include <nop/status.h>
+#include <nop/traits/is_detected.h>
+#include <nop/utility/compiler.h>
+#include <nop/utility/endian.h>
 
 namespace nop {
 
@@ -97,6 +103,259 @@ struct Encoding {
                 "include the appropriate encoder header.");
 };
 
+namespace detail {
+
+enum : std::size_t { kByteSwapBufferSize = 1024 };
+
+template <typename T, typename Writer>
+constexpr Status<void> WritePacked(const T* begin, const T* end,
+                                   Writer* writer, std::false_type) {
+  return writer->Write(begin, end);
+}
+
+template <typename T, typename Writer>
+Status<void> WritePacked(const T* begin, const T* end, Writer* writer,
+                         std::true_type) {
+  T buffer[kByteSwapBufferSize / sizeof(T)];
+  while (begin != end) {
+    const std::size_t count = std::min<std::size_t>(
+        end - begin, kByteSwapBufferSize / sizeof(T));
+    std::copy(begin, begin + count, buffer);
+    SwapBytes(buffer, buffer + count);
+
+    auto status = writer->Write(buffer, buffer + count);
+    if (NOP_UNLIKELY(!status))
+      return status;
+
+    begin += count;
+  }
+  return {};
+}
+
+template <typename T, typename Reader>
+constexpr Status<void> ReadPacked(T* begin, T* end, Reader* reader,
+                                  std::false_type) {
+  return reader->Read(begin, end);
+}
+
+template <typename T, typename Reader>
+Status<void> ReadPacked(T* begin, T* end, Reader* reader, std::true_type) {
+  auto status = reader->Read(begin, end);
+  if (NOP_UNLIKELY(!status))
+    return status;
+
+  SwapBytes(begin, end);
+  return {};
+}
+
+}  // namespace detail
+
+// Writes the packable values in the range [begin, end) in their little-endian
+// representation. Values are copied directly on little-endian hosts and
+// converted through a small buffer otherwise.
+template <typename T, typename Writer>
+constexpr Status<void> WritePacked(const T* begin, const T* end,
+                                   Writer* writer) {
+  return detail::WritePacked(begin, end, writer, IsByteSwapped<T>{});
+}
+
+// Reads the little-endian representation of the packable values in the range
+// [begin, end), converting them to host endianness in place.
+template <typename T, typename Reader>
+constexpr Status<void> ReadPacked(T* begin, T* end, Reader* reader) {
+  return detail::ReadPacked(begin, end, reader, IsByteSwapped<T>{});
+}
+
+// Test expression for writers that write every integer at the full width of
+// its type, with the widest prefix the type allows, rather than with the
+// smallest prefix that holds its value. This is still a valid encoding, since
+// every integer type accepts the wider prefixes up to its own width, and trades
+// size for encoding integers without branching on their values. Writers opt in
+// by defining a nested type named FixedWidthIntegers:
+//
+//   class SomeWriter {
+//    public:
+//     using FixedWidthIntegers = void;
+//     ...
+//   };
+//
+// Since Encoding<T>::Size() assumes the smallest prefix, such writers should
+// also define SkipPrepare. See FixedWidthWriter.
+template <typename Writer>
+using FixedWidthIntegersTest = typename Writer::FixedWidthIntegers;
+
+// Evaluates to true if Writer writes integers at their full width.
+template <typename Writer>
+using IsFixedWidthWriter = IsDetected<FixedWidthIntegersTest, Writer>;
+
+// Full width encoding of integral type T, as the integer Type following the
+// given Prefix. Enums use the encoding of their underlying type. Other types,
+// including bool and char, which have no choice of width, are false.
+template <typename T, typename Enabled = void>
+struct FixedWidthInteger : std::false_type {};
+
+template <typename Integer, EncodingByte Prefix_>
+struct FixedWidthIntegerAs : std::true_type {
+  using Type = Integer;
+  static constexpr EncodingByte Prefix = Prefix_;
+};
+
+template <>
+struct FixedWidthInteger<std::uint8_t>
+    : FixedWidthIntegerAs<std::uint8_t, EncodingByte::U8> {};
+template <>
+struct FixedWidthInteger<std::int8_t>
+    : FixedWidthIntegerAs<std::int8_t, EncodingByte::I8> {};
+template <>
+struct FixedWidthInteger<std::uint16_t>
+    : FixedWidthIntegerAs<std::uint16_t, EncodingByte::U16> {};
+template <>
+struct FixedWidthInteger<std::int16_t>
+    : FixedWidthIntegerAs<std::int16_t, EncodingByte::I16> {};
+template <>
+struct FixedWidthInteger<std::uint32_t>
+    : FixedWidthIntegerAs<std::uint32_t, EncodingByte::U32> {};
+template <>
+struct FixedWidthInteger<std::int32_t>
+    : FixedWidthIntegerAs<std::int32_t, EncodingByte::I32> {};
+template <>
+struct FixedWidthInteger<std::uint64_t>
+    : FixedWidthIntegerAs<std::uint64_t, EncodingByte::U64> {};
+template <>
+struct FixedWidthInteger<std::int64_t>
+    : FixedWidthIntegerAs<std::int64_t, EncodingByte::I64> {};
+
+template <typename T>
+struct FixedWidthInteger<T, std::enable_if_t<std::is_enum<T>::value>>
+    : FixedWidthInteger<std::underlying_type_t<T>> {};
+
+// Test expression for readers of input from trusted peers, such as processes
+// built from the same source, whose encodings are known to have the shape of
+// the types read. Reading through such readers elides the checks of that
+// shape: prefixes are not matched against the type read, and the member counts
+// of structures and the hashes of tables are not compared with the expected
+// values. Readers opt in by defining a nested type named TrustedEncoding:
+//
+//   class SomeReader {
+//    public:
+//     using TrustedEncoding = void;
+//     ...
+//   };
+//
+// The reader remains responsible for bounds checking, so that malformed input
+// still cannot cause reads outside of it. See TrustedBufferReader.
+template <typename Reader>
+using TrustedEncodingTest = typename Reader::TrustedEncoding;
+
+// Evaluates to true if Reader reads input with a trusted encoding shape.
+template <typename Reader>
+using IsTrustedReader = IsDetected<TrustedEncodingTest, Reader>;
+
+// Trait indicating whether the encoded size of type T is bounded; see the
+// definition below.
+template <typename T, typename Enabled = void>
+struct MaxEncodingSize;
+
+// Test expression for writers over contiguous output that let encodings store
+// values directly into the output, instead of making a Write() call for each
+// prefix and payload. Writers opt in by defining a pair of methods:
+//
+//   class SomeWriter {
+//    public:
+//     // Returns a pointer to at least |size| bytes of output at the current
+//     // position, or an error if the output cannot hold them. The pointer is
+//     // valid until the next call on the writer.
+//     Status<std::uint8_t*> Reserve(std::size_t size);
+//
+//     // Advances past the first |size| bytes of the last reservation, which
+//     // have been stored.
+//     void Commit(std::size_t size);
+//     ...
+//   };
+//
+// Values with a small bounded encoding size are then encoded straight into a
+// reservation of their maximum size, so that the output is checked once per
+// value instead of once per write. Values are written with Write() when the
+// writer lacks these methods or the reservation fails, such as near the end of
+// a fixed-size buffer that has room for the actual encoding but not for the
+// maximum.
+template <typename Writer>
+using ReserveTest =
+    decltype(std::declval<Writer&>().Reserve(std::size_t{}).get(),
+             std::declval<Writer&>().Commit(std::size_t{}));
+
+// Evaluates to true if Writer supports reserved writes.
+template <typename Writer>
+using IsReservingWriter = IsDetected<ReserveTest, Writer>;
+
+// Largest encoding size staged on the stack or in reserved output.
+constexpr std::size_t kMaxStagedSize = 256;
+
+// Test expression for writers that must see each value written, such as
+// ConstexprBufferWriter, which cannot stage in a constant expression, or
+// BufferWriter, which does not check limits on Write(). These opt out of
+// staged and reserved writes by defining a nested type named SkipStaging:
+//
+//   class SomeWriter {
+//    public:
+//     using SkipStaging = void;
+//     ...
+//   };
+//
+template <typename Writer>
+using SkipStagingTest = typename Writer::SkipStaging;
+
+// Evaluates to true if Writer opts out of staged and reserved writes.
+template <typename Writer>
+using IsSkipStagingWriter = IsDetected<SkipStagingTest, Writer>;
+
+// Evaluates to true if values of type T are encoded directly into output
+// reserved from Writer.
+template <typename T, typename Writer>
+using IsReserved = std::integral_constant<
+    bool, MaxEncodingSize<T>::value &&
+              static_cast<std::size_t>(MaxEncodingSize<T>::Size) <=
+                  kMaxStagedSize &&
+              IsReservingWriter<Writer>::value &&
+              !IsSkipStagingWriter<Writer>::value>;
+
+// Test expression for writers and readers that collect an EncodingProfile of
+// the values passing through them, such as ProfilingWriter and
+// ProfilingReader. EncodingIO reports the start and end of each value to the
+// profile returned by profiler(); for other writers and readers the hook is
+// compiled out entirely.
+template <typename WriterOrReader>
+using ProfilerTest = decltype(std::declval<WriterOrReader&>().profiler());
+
+// Evaluates to true if Writer or Reader collects an EncodingProfile.
+template <typename WriterOrReader>
+using IsProfiling = IsDetected<ProfilerTest, WriterOrReader>;
+
+template <typename WriterOrReader, typename Return = Status<void>>
+using EnableIfProfiling =
+    std::enable_if_t<IsProfiling<WriterOrReader>::value, Return>;
+template <typename WriterOrReader, typename Return = Status<void>>
+using EnableIfNotProfiling =
+    std::enable_if_t<!IsProfiling<WriterOrReader>::value, Return>;
+
+// Trait that routes the encoding of type T through functions that are kept
+// out of line and optimized for size. Specialize this trait for large types
+// that are rarely present in messages, such as diagnostic or error payloads,
+// so that their encoders are not inlined into the loops encoding and decoding
+// the types that contain them. This applies wherever T is encoded as a value of
+// its own, such as a member, element, or table entry; wrappers that share the
+// prefix of T, such as Optional<T>, still encode the payload inline:
+//
+//   template <>
+//   struct IsOutlined<Diagnostics> : std::true_type {};
+//
+template <typename T, typename Enabled = void>
+struct IsOutlined : std::false_type {};
+
+// Writes |value| to |writer| through a StagingWriter; see the definition below.
+template <typename T, typename Writer>
+Status<void> WriteStaged(const T& value, Writer* writer);
+
 // Implements general IO for encoding types. May also be mixed-in with an
 // Encoding<T> specialization to provide uniform access to Read/Write through
 // the specilization itself.
@@ -111,43 +370,154 @@ struct Encoding {
 template <typename T>
 struct EncodingIO {
   template <typename Writer>
-  static constexpr Status<void> Write(const T& value, Writer* writer) {
-    EncodingByte prefix = Encoding<T>::Prefix(value);
-    auto status = writer->Write(static_cast<std::uint8_t>(prefix));
-    if (!status)
-      return status;
-    else
-      return Encoding<T>::WritePayload(prefix, value, writer);
+  static constexpr EnableIfNotProfiling<Writer> Write(const T& value,
+                                                      Writer* writer) {
+    return Write(value, writer, IsOutlined<T>{},
+                 And<IsFixedWidthWriter<Writer>, FixedWidthInteger<T>>{},
+                 IsReserved<T, Writer>{});
+  }
+
+  template <typename Reader>
+  static constexpr EnableIfNotProfiling<Reader> Read(T* value, Reader* reader) {
+    return ReadValue(value, reader, IsOutlined<T>{});
+  }
+
+  // Attributes the bytes of the value to T in the profile of the writer.
+  template <typename Writer>
+  static EnableIfProfiling<Writer> Write(const T& value, Writer* writer) {
+    auto* profile = writer->profiler();
+    profile->template Begin<T>();
+    auto status = Write(value, writer, IsOutlined<T>{},
+                        And<IsFixedWidthWriter<Writer>, FixedWidthInteger<T>>{},
+                        IsReserved<T, Writer>{});
+    profile->End();
+    return status;
+  }
+
+  template <typename Reader>
+  static EnableIfProfiling<Reader> Read(T* value, Reader* reader) {
+    auto* profile = reader->profiler();
+    profile->template Begin<T>();
+    auto status = ReadValue(value, reader, IsOutlined<T>{});
+    profile->End();
+    return status;
+  }
+
+  // Reads the rest of a value whose prefix the caller has already read from
+  // |reader|, exactly as Read() does after reading the prefix itself.
+  template <typename Reader>
+  static constexpr EnableIfNotProfiling<Reader> ReadFollowing(
+      EncodingByte prefix, T* value, Reader* reader) {
+    return ReadRest(prefix, value, reader, IsOutlined<T>{});
+  }
+
+  template <typename Reader>
+  static EnableIfProfiling<Reader> ReadFollowing(EncodingByte prefix, T* value,
+                                                 Reader* reader) {
+    auto* profile = reader->profiler();
+    profile->template Begin<T>();
+    auto status = ReadRest(prefix, value, reader, IsOutlined<T>{});
+    profile->End();
+    return status;
   }
 
+ private:
   template <typename Reader>
-  static constexpr Status<void> Read(T* value, Reader* reader) {
+  static constexpr Status<void> ReadValue(T* value, Reader* reader,
+                                          std::false_type /*outlined*/) {
     std::uint8_t prefix_byte = 0;
     auto status = reader->Read(&prefix_byte);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
-    const EncodingByte prefix = static_cast<EncodingByte>(prefix_byte);
-    if (Encoding<T>::Match(prefix))
+    return ReadRest(static_cast<EncodingByte>(prefix_byte), value, reader,
+                    std::false_type{});
+  }
+
+  // Keeps the decoders of outlined types out of line; see IsOutlined.
+  template <typename Reader>
+  NOP_NOINLINE NOP_COLD static constexpr Status<void> ReadValue(
+      T* value, Reader* reader, std::true_type /*outlined*/) {
+    return ReadValue(value, reader, std::false_type{});
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadRest(EncodingByte prefix, T* value,
+                                         Reader* reader,
+                                         std::false_type /*outlined*/) {
+    if (NOP_LIKELY(IsTrustedReader<Reader>::value ||
+                   Encoding<T>::Match(prefix)))
       return Encoding<T>::ReadPayload(prefix, value, reader);
     else
       return ErrorStatus::UnexpectedEncodingType;
   }
 
+  template <typename Reader>
+  NOP_NOINLINE NOP_COLD static constexpr Status<void> ReadRest(
+      EncodingByte prefix, T* value, Reader* reader,
+      std::true_type /*outlined*/) {
+    return ReadRest(prefix, value, reader, std::false_type{});
+  }
+
+  // Keeps the encoders of outlined types out of line; see IsOutlined.
+  template <typename Writer, typename FixedWidth, typename Reserved>
+  NOP_NOINLINE NOP_COLD static constexpr Status<void> Write(
+      const T& value, Writer* writer, std::true_type /*outlined*/, FixedWidth,
+      Reserved) {
+    return Write(value, writer, std::false_type{}, FixedWidth{}, Reserved{});
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> Write(const T& value, Writer* writer,
+                                      std::false_type /*outlined*/,
+                                      std::false_type /*fixed_width*/,
+                                      std::false_type /*reserved*/) {
+    EncodingByte prefix = Encoding<T>::Prefix(value);
+    auto status = writer->Write(static_cast<std::uint8_t>(prefix));
+    if (NOP_UNLIKELY(!status))
+      return status;
+    else
+      return Encoding<T>::WritePayload(prefix, value, writer);
+  }
+
+  // Stores bounded values directly into output reserved from the writer.
+  template <typename Writer>
+  static Status<void> Write(const T& value, Writer* writer,
+                            std::false_type /*outlined*/,
+                            std::false_type /*fixed_width*/,
+                            std::true_type /*reserved*/) {
+    return WriteStaged(value, writer);
+  }
+
+  // Writes the prefix and the full width of the integer in a single write.
+  template <typename Writer, typename Reserved>
+  static Status<void> Write(const T& value, Writer* writer,
+                            std::false_type /*outlined*/,
+                            std::true_type /*fixed_width*/, Reserved) {
+    using Integer = typename FixedWidthInteger<T>::Type;
+    Integer integer = static_cast<Integer>(value);
+    ToLittleEndian(&integer, &integer + 1);
+
+    std::uint8_t bytes[1 + sizeof(Integer)];
+    bytes[0] = static_cast<std::uint8_t>(FixedWidthInteger<T>::Prefix);
+    std::memcpy(&bytes[1], &integer, sizeof(Integer));
+    return writer->Write(&bytes[0], &bytes[1 + sizeof(Integer)]);
+  }
+
  protected:
   template <typename As, typename From, typename Writer,
             typename Enabled = EnableIfArithmetic<As, From>>
   static constexpr Status<void> WriteAs(From value, Writer* writer) {
     As temp = static_cast<As>(value);
-    return writer->Write(&temp, &temp + 1);
+    return WritePacked(&temp, &temp + 1, writer);
   }
 
   template <typename As, typename From, typename Reader,
             typename Enabled = EnableIfArithmetic<As, From>>
   static constexpr Status<void> ReadAs(From* value, Reader* reader) {
     As temp = 0;
-    auto status = reader->Read(&temp, &temp + 1);
-    if (!status)
+    auto status = ReadPacked(&temp, &temp + 1, reader);
+    if (NOP_UNLIKELY(!status))
       return status;
 
     *value = static_cast<From>(temp);
@@ -943,7 +1313,7 @@ struct Encoding<T,
                                             Reader* reader) {
     BaseType base_value = 0;
     auto status = Encoding<BaseType>::ReadPayload(prefix, &base_value, reader);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
     *value = base_value;
@@ -958,6 +1328,519 @@ struct Encoding<T, std::enable_if_t<std::is_same<T, int>::value &&
                                     sizeof(int) == sizeof(std::int32_t)>>
     : Encoding<std::int32_t> {};
 
+//
+// Fixed encoding sizes. Some types encode to the same number of bytes for every
+// value of the type, for example floating point types, arrays of integral
+// types, and structures composed only of such types. Container encodings use
+// this property to compute the encoded size of their elements without visiting
+// each element.
+//
+// Integral types and enums are not included: the encoded size of an integer
+// depends on its value.
+//
+
+// Trait indicating whether every value of type T has the same encoded size.
+// Specializations for fixed-size types are true and define the encoded size in
+// bytes as Size.
+template <typename T, typename Enabled = void>
+struct FixedEncodingSize : std::false_type {
+  enum : std::size_t { Size = 0 };
+};
+
+template <>
+struct FixedEncodingSize<bool> : std::true_type {
+  enum : std::size_t { Size = BaseEncodingSize(EncodingByte::True) };
+};
+
+template <>
+struct FixedEncodingSize<float> : std::true_type {
+  enum : std::size_t { Size = BaseEncodingSize(EncodingByte::F32) };
+};
+
+template <>
+struct FixedEncodingSize<double> : std::true_type {
+  enum : std::size_t { Size = BaseEncodingSize(EncodingByte::F64) };
+};
+
+// Sums the fixed encoding sizes of Types.
+template <typename... Types>
+struct FixedEncodingSizeSum : std::integral_constant<std::size_t, 0> {};
+template <typename First, typename... Rest>
+struct FixedEncodingSizeSum<First, Rest...>
+    : std::integral_constant<std::size_t,
+                             FixedEncodingSize<First>::Size +
+                                 FixedEncodingSizeSum<Rest...>::value> {};
+
+// Fixed encoding size of formats that consist of a prefix, a count, and one
+// encoding of each of Types, such as structures and tuples. The size is fixed
+// when every one of Types has a fixed encoding size.
+template <typename... Types>
+struct FixedAggregateEncodingSize
+    : std::integral_constant<bool, And<FixedEncodingSize<Types>...>::value> {
+  enum : std::size_t {
+    Size = And<FixedEncodingSize<Types>...>::value
+               ? 1 + Encoding<SizeType>::Size(sizeof...(Types)) +
+                     FixedEncodingSizeSum<Types...>::value
+               : 0
+  };
+};
+
+// Returns the sum of the encoded sizes of the elements of |value|, which have
+// type T. When T has a fixed encoding size the sum is computed without visiting
+// the elements.
+template <typename T, typename Container>
+constexpr std::enable_if_t<FixedEncodingSize<T>::value, std::size_t>
+ElementsEncodingSize(const Container& value) {
+  return value.size() * FixedEncodingSize<T>::Size;
+}
+template <typename T, typename Container>
+constexpr std::enable_if_t<!FixedEncodingSize<T>::value, std::size_t>
+ElementsEncodingSize(const Container& value) {
+  std::size_t size = 0;
+  for (const auto& element : value)
+    size += Encoding<T>::Size(element);
+  return size;
+}
+template <typename T, std::size_t Length>
+constexpr std::enable_if_t<FixedEncodingSize<T>::value, std::size_t>
+ElementsEncodingSize(const T (&/*value*/)[Length]) {
+  return Length * FixedEncodingSize<T>::Size;
+}
+template <typename T, std::size_t Length>
+constexpr std::enable_if_t<!FixedEncodingSize<T>::value, std::size_t>
+ElementsEncodingSize(const T (&value)[Length]) {
+  std::size_t size = 0;
+  for (std::size_t i = 0; i < Length; i++)
+    size += Encoding<T>::Size(value[i]);
+  return size;
+}
+
+//
+// Maximum encoding sizes. Some types have an upper bound on the size of their
+// encoding, for example integral types, enums, and structures and arrays
+// composed only of such types. The bound covers every form accepted when
+// reading the type, including integers encoded wider than necessary and the
+// legacy formats of floating point arrays, so that a reader holding at least
+// this many bytes can decode any value of the type without further bounds
+// checks.
+//
+
+// Trait indicating whether the encoded size of type T is bounded.
+// Specializations for bounded types are true and define the largest encoded
+// size in bytes as Size.
+template <typename T, typename Enabled>
+struct MaxEncodingSize : std::false_type {
+  enum : std::size_t { Size = 0 };
+};
+
+template <typename T>
+struct MaxEncodingSize<T, std::enable_if_t<std::is_integral<T>::value>>
+    : std::true_type {
+  enum : std::size_t {
+    Size = std::is_same<T, bool>::value ? BaseEncodingSize(EncodingByte::True)
+                                        : 1 + sizeof(T)
+  };
+};
+
+template <>
+struct MaxEncodingSize<float> : std::true_type {
+  enum : std::size_t { Size = BaseEncodingSize(EncodingByte::F32) };
+};
+
+template <>
+struct MaxEncodingSize<double> : std::true_type {
+  enum : std::size_t { Size = BaseEncodingSize(EncodingByte::F64) };
+};
+
+template <typename T>
+struct MaxEncodingSize<T, std::enable_if_t<std::is_enum<T>::value>>
+    : MaxEncodingSize<std::underlying_type_t<T>> {};
+
+// Sums the maximum encoding sizes of Types.
+template <typename... Types>
+struct MaxEncodingSizeSum : std::integral_constant<std::size_t, 0> {};
+template <typename First, typename... Rest>
+struct MaxEncodingSizeSum<First, Rest...>
+    : std::integral_constant<std::size_t,
+                             MaxEncodingSize<First>::Size +
+                                 MaxEncodingSizeSum<Rest...>::value> {};
+
+// Largest of the maximum encoding sizes of Types, for formats that hold one of
+// several alternatives, such as variants and optionals.
+template <typename... Types>
+struct MaxEncodingSizeLargest : std::integral_constant<std::size_t, 0> {};
+template <typename First, typename... Rest>
+struct MaxEncodingSizeLargest<First, Rest...>
+    : std::integral_constant<
+          std::size_t,
+          (std::size_t{MaxEncodingSize<First>::Size} >
+                   MaxEncodingSizeLargest<Rest...>::value
+               ? std::size_t{MaxEncodingSize<First>::Size}
+               : MaxEncodingSizeLargest<Rest...>::value)> {};
+
+// Maximum encoding size of formats that consist of a prefix, a count, and one
+// encoding of each of Types, such as structures and tuples. The size is bounded
+// when every one of Types has a bounded encoding size.
+template <typename... Types>
+struct MaxAggregateEncodingSize
+    : std::integral_constant<bool, And<MaxEncodingSize<Types>...>::value> {
+  enum : std::size_t {
+    Size = And<MaxEncodingSize<Types>...>::value
+               ? 1 + MaxEncodingSize<SizeType>::Size +
+                     MaxEncodingSizeSum<Types...>::value
+               : 0
+  };
+};
+
+// Public compile-time upper bound on the encoded size of type T, suitable for
+// sizing buffers that are never allocated at runtime. MaxEncodedSize<T>::value
+// is defined only for types with a bounded encoding size, so that using it with
+// an unbounded type such as std::string is a compile-time error.
+//
+// Example:
+//
+//   std::uint8_t buffer[nop::MaxEncodedSize<Sample>::value];
+//   nop::Serializer<nop::BufferWriter> serializer{buffer, sizeof(buffer)};
+//   serializer.Write(sample);
+//
+template <typename T, typename Enabled = void>
+struct MaxEncodedSize {};
+template <typename T>
+struct MaxEncodedSize<T, std::enable_if_t<MaxEncodingSize<T>::value>>
+    : std::integral_constant<std::size_t, MaxEncodingSize<T>::Size> {};
+
+//
+// Overestimated sizes. Encoding<T>::Size() of a few types, such as handles,
+// whose references are not known until they are pushed to the writer, is only
+// an upper bound on the size written. Writers that need exact sizes measure
+// such types with a dry run through CountingWriter instead; see
+// nop/utility/counting_writer.h. Types are overestimated when they are flagged
+// themselves or contain flagged types: the arguments of class templates are
+// searched here, and structures, tables, and value wrappers search their
+// members where they are defined.
+//
+
+// Trait indicating whether Encoding<T>::Size() may overestimate the size of
+// values of type T.
+template <typename T, typename Enabled = void>
+struct IsSizeOverestimated;
+
+namespace detail {
+
+template <typename T>
+std::false_type SearchOverestimated(const T*);
+template <template <typename...> class C, typename... Args>
+Or<std::false_type, IsSizeOverestimated<std::remove_cv_t<Args>>...>
+SearchOverestimated(const C<Args...>*);
+template <template <typename, std::size_t> class C, typename T,
+          std::size_t Length>
+IsSizeOverestimated<std::remove_cv_t<T>> SearchOverestimated(
+    const C<T, Length>*);
+template <typename T, std::size_t Length>
+IsSizeOverestimated<std::remove_cv_t<T>> SearchOverestimated(
+    const T (*)[Length]);
+
+}  // namespace detail
+
+template <typename T, typename Enabled>
+struct IsSizeOverestimated
+    : decltype(detail::SearchOverestimated(
+          static_cast<const std::remove_reference_t<T>*>(nullptr))) {};
+
+// Readers may provide a remaining() method returning the number of bytes left
+// in the input, which containers use to reserve storage before reading their
+// elements.
+template <typename Reader>
+using RemainingTest = decltype(std::declval<const Reader&>().remaining());
+
+// Returns the number of elements to reserve before reading a container with
+// |count| elements from |reader|. Since every element encodes to at least one
+// byte, the bytes remaining in the reader bound the number of elements that may
+// actually be read, which prevents abusive counts from causing very large
+// allocations. Returns zero when the reader does not report the bytes left.
+template <typename Reader>
+constexpr std::enable_if_t<IsDetected<RemainingTest, Reader>::value,
+                           std::size_t>
+ReserveCount(std::size_t count, const Reader* reader) {
+  return count < reader->remaining() ? count : reader->remaining();
+}
+template <typename Reader>
+constexpr std::enable_if_t<!IsDetected<RemainingTest, Reader>::value,
+                           std::size_t>
+ReserveCount(std::size_t /*count*/, const Reader* /*reader*/) {
+  return 0;
+}
+
+// Containers decode their elements in place: each new element is constructed
+// directly in the storage of the container and then decoded into, rather than
+// decoded into a temporary that is moved into the container. Element types
+// that are not default constructible may provide a decode constructor taking
+// DecodeTag, which containers use to construct the elements they decode into.
+// The decode constructor only needs to leave the value in a state that can be
+// assigned by decoding.
+//
+// Decoding into a value that already holds data always reuses it; there is no
+// separate mode. Sequence containers decode into their existing elements and
+// then append or erase elements to match the encoding, maps decode into the
+// values of nodes whose keys appear again and erase the others, and strings,
+// engaged Optionals and table entries are decoded over in place. Decoding
+// structurally similar messages into one reused value therefore keeps the
+// storage of its elements, nodes and strings; maps only allocate a scratch key
+// per decode when their keys own storage, and unordered maps of more than 64
+// entries a list of their nodes. The result is the same as decoding into a
+// fresh value, except that a failed decode may leave the destination
+// partially updated.
+//
+// Example:
+//
+//   class Account {
+//    public:
+//     explicit Account(std::string owner);
+//     explicit Account(nop::DecodeTag) {}
+//     ...
+//    private:
+//     std::string owner_;
+//     NOP_STRUCTURE(Account, owner_);
+//   };
+//
+struct DecodeTag {};
+
+// Evaluates to true if T has a decode constructor.
+template <typename T>
+using IsDecodeConstructible = std::is_constructible<T, DecodeTag>;
+
+// Calls |emplace| with the constructor arguments of an element of type T to
+// decode into: DecodeTag for types with a decode constructor, or none.
+template <typename T, typename Emplace>
+decltype(auto) EmplaceForDecode(Emplace&& emplace, std::true_type) {
+  return std::forward<Emplace>(emplace)(DecodeTag{});
+}
+template <typename T, typename Emplace>
+decltype(auto) EmplaceForDecode(Emplace&& emplace, std::false_type) {
+  return std::forward<Emplace>(emplace)();
+}
+template <typename T, typename Emplace>
+decltype(auto) EmplaceForDecode(Emplace&& emplace) {
+  return EmplaceForDecode<T>(std::forward<Emplace>(emplace),
+                             IsDecodeConstructible<T>{});
+}
+
+// Returns a value of type T to decode into, for containers that cannot
+// decode into their own storage, such as sets, whose elements are immutable.
+template <typename T>
+T MakeForDecode() {
+  return EmplaceForDecode<T>([](auto... args) { return T(args...); });
+}
+
+// Appends an element to decode into to the sequence container |value|.
+template <typename Container>
+void EmplaceBackForDecode(Container* value) {
+  EmplaceForDecode<typename Container::value_type>(
+      [value](auto... args) { value->emplace_back(args...); });
+}
+
+// Reads |size| individually encoded elements of type T into the sequence
+// container |value|. The elements already in the container are decoded into in
+// place, keeping any storage they own, before new elements are appended and
+// any elements left over are erased. This way decoding into a container reused
+// across structurally similar messages does not allocate. When decoding fails
+// the container holds only the elements decoded before the failure.
+template <typename T, typename Container, typename Reader>
+Status<void> ReadSequenceElements(SizeType size, Container* value,
+                                  Reader* reader) {
+  SizeType count = 0;
+  auto position = value->begin();
+  for (; count < size && position != value->end(); ++count, ++position) {
+    auto status = Encoding<T>::Read(&*position, reader);
+    if (NOP_UNLIKELY(!status)) {
+      value->erase(position, value->end());
+      return status;
+    }
+  }
+  value->erase(position, value->end());
+
+  for (; count < size; count++) {
+    EmplaceBackForDecode(value);
+    auto status = Encoding<T>::Read(&value->back(), reader);
+    if (NOP_UNLIKELY(!status)) {
+      value->pop_back();
+      return status;
+    }
+  }
+  return {};
+}
+
+// Readers over a contiguous input may provide a Borrow() method returning a
+// pointer to the next bytes of the input, along with remaining(). Borrowing
+// zero bytes returns the current position without advancing.
+template <typename Reader>
+using BorrowTest = decltype(std::declval<Reader&>().Borrow(std::size_t{}));
+
+// Evaluates to true if Reader exposes its input as contiguous memory.
+template <typename Reader>
+using IsContiguousReader =
+    And<IsDetected<RemainingTest, Reader>, IsDetected<BorrowTest, Reader>>;
+
+// Reader over a run of contiguous input that is known to hold at least as many
+// bytes as the value being read may use, as established by MaxEncodingSize.
+// Reads are not bounds checked. Encodings use this reader to decode bounded
+// values after checking the bytes remaining in the original reader once.
+class UncheckedReader {
+ public:
+  explicit constexpr UncheckedReader(const std::uint8_t* data) : data_{data} {}
+
+  constexpr Status<void> Ensure(std::size_t /*size*/) { return {}; }
+
+  Status<void> Read(std::uint8_t* byte) {
+    *byte = data_[index_++];
+    return {};
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Read(T* begin, T* end) {
+    const std::size_t length_bytes = (end - begin) * sizeof(T);
+    std::memcpy(begin, &data_[index_], length_bytes);
+    index_ += length_bytes;
+    return {};
+  }
+
+  constexpr Status<void> Skip(std::size_t padding_bytes) {
+    index_ += padding_bytes;
+    return {};
+  }
+
+  // Returns the number of bytes read.
+  constexpr std::size_t size() const { return index_; }
+
+ private:
+  const std::uint8_t* data_;
+  std::size_t index_{0};
+};
+
+// UncheckedReader that also passes on the trust of the original reader in the
+// shape of the encoding.
+class TrustedUncheckedReader : public UncheckedReader {
+ public:
+  using TrustedEncoding = void;
+  using UncheckedReader::UncheckedReader;
+};
+
+// Selects the unchecked reader type for bounded values read from Reader.
+template <typename Reader>
+using UncheckedReaderFor =
+    std::conditional_t<IsTrustedReader<Reader>::value, TrustedUncheckedReader,
+                       UncheckedReader>;
+
+//
+// Staged writes. Aggregates with a small bounded encoding size, such as
+// structures of integers, stage their encoding in a local buffer through
+// StagingWriter, which does not check limits, and emit it to the writer with a
+// single Write() call. This replaces a call, and usually a limit check, per
+// prefix and payload with one for the whole aggregate. Writers that support
+// reserved writes are staged into directly, without the local buffer. Writers
+// that define SkipStaging opt out; see SkipStagingTest.
+
+// Evaluates to true if values of type T are staged before writing to Writer.
+template <typename T, typename Writer>
+using IsStaged = std::integral_constant<
+    bool, MaxEncodingSize<T>::value &&
+              static_cast<std::size_t>(MaxEncodingSize<T>::Size) <=
+                  kMaxStagedSize &&
+              !IsSkipStagingWriter<Writer>::value>;
+
+// Base of StagingWriter that keeps the integer width of the underlying writer.
+template <typename Writer, typename Enabled = void>
+struct StagingWriterBase {};
+template <typename Writer>
+struct StagingWriterBase<Writer,
+                         std::enable_if_t<IsFixedWidthWriter<Writer>::value>> {
+  using FixedWidthIntegers = void;
+};
+
+// Writer into a buffer that is known to hold at least as many bytes as the
+// value being written may use, as established by MaxEncodingSize. Writes are
+// not bounds checked. Handles are pushed to the underlying writer.
+template <typename Writer>
+class StagingWriter : public StagingWriterBase<Writer> {
+ public:
+  using SkipStaging = void;
+
+  StagingWriter(std::uint8_t* data, Writer* writer)
+      : data_{data}, writer_{writer} {}
+
+  Status<void> Prepare(std::size_t /*size*/) { return {}; }
+
+  Status<void> Write(std::uint8_t byte) {
+    data_[index_++] = byte;
+    return {};
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    const std::size_t length_bytes = (end - begin) * sizeof(T);
+    std::memcpy(&data_[index_], begin, length_bytes);
+    index_ += length_bytes;
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    std::memset(&data_[index_], padding_value, padding_bytes);
+    index_ += padding_bytes;
+    return {};
+  }
+
+  template <typename HandleType>
+  Status<HandleReference> PushHandle(const HandleType& handle) {
+    return writer_->PushHandle(handle);
+  }
+
+  // Returns the number of bytes written.
+  std::size_t size() const { return index_; }
+
+ private:
+  std::uint8_t* data_;
+  Writer* writer_;
+  std::size_t index_{0};
+};
+
+// Writes |value| to |writer| through a StagingWriter over a buffer on the
+// stack, with a single write of the result.
+template <typename T, typename Writer>
+Status<void> WriteStaged(const T& value, Writer* writer,
+                         std::false_type /*reserving*/) {
+  std::uint8_t buffer[MaxEncodingSize<T>::Size] = {};
+  StagingWriter<Writer> staging_writer{buffer, writer};
+  auto status = EncodingIO<T>::Write(value, &staging_writer);
+  if (NOP_UNLIKELY(!status))
+    return status;
+
+  return writer->Write(buffer, buffer + staging_writer.size());
+}
+
+// Writes |value| to |writer| through a StagingWriter over output reserved
+// from the writer, falling back to the stack when the reservation fails.
+template <typename T, typename Writer>
+Status<void> WriteStaged(const T& value, Writer* writer,
+                         std::true_type /*reserving*/) {
+  auto data = writer->Reserve(MaxEncodingSize<T>::Size);
+  if (!data)
+    return WriteStaged(value, writer, std::false_type{});
+
+  StagingWriter<Writer> staging_writer{data.get(), writer};
+  auto status = EncodingIO<T>::Write(value, &staging_writer);
+  if (NOP_UNLIKELY(!status))
+    return status;
+
+  writer->Commit(staging_writer.size());
+  return {};
+}
+
+template <typename T, typename Writer>
+Status<void> WriteStaged(const T& value, Writer* writer) {
+  return WriteStaged(value, writer, IsReservingWriter<Writer>{});
+}
+
 }  // namespace nop
 
 #endif  // LIBNOP_INCLUDE_NOP_BASE_ENCODING_H_
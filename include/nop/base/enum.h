@@ -51,7 +51,7 @@ struct Encoding<T, EnableIfEnum<T>> : EncodingIO<T> {
   static constexpr Status<void> WritePayload(EncodingByte prefix,
                                              const T& value, Writer* writer) {
     return Encoding<IntegerType>::WritePayload(
-        prefix, reinterpret_cast<const IntegerType&>(value), writer);
+        prefix, static_cast<IntegerType>(value), writer);
   }
 
   template <typename Reader>
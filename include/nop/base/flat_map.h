@@ -0,0 +1,315 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_FLAT_MAP_H_
+#define LIBNOP_INCLUDE_NOP_BASE_FLAT_MAP_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+#include <nop/base/encoding.h>
+#include <nop/base/map.h>
+#include <nop/base/utility.h>
+#include <nop/types/flat_map.h>
+
+namespace nop {
+
+//
+// FlatMap<Key, T> encoding format is the same as std::map<Key, T>:
+//
+// +-----+---------+--------//---------+
+// | MAP | INT64:N | N KEY/VALUE PAIRS |
+// +-----+---------+--------//---------+
+//
+// FlatSet<Key> encoding format is the same as std::set<Key>. For non-integral
+// types:
+//
+// +-----+---------+-----//-----+
+// | ARY | INT64:N | N ELEMENTS |
+// +-----+---------+-----//-----+
+//
+// For integral types:
+//
+// +-----+---------+---//----+
+// | BIN | INT64:L | L BYTES |
+// +-----+---------+---//----+
+//
+// Where L = N * sizeof(Key).
+//
+// Elements are decoded in place over the elements already in the container and
+// appended in the order they arrive. The order is checked as the elements are
+// read; only input that is not in strictly increasing key order, such as the
+// output of an unordered container, is sorted afterwards.
+//
+
+// Finishes decoding |container| into the flat container |value|, sorting the
+// elements if they did not arrive in order. On error the container is emptied
+// but keeps its storage.
+template <typename Type, typename Container>
+void ReplaceFlatContainer(const Status<void>& status, bool sorted,
+                          Container&& container, Type* value) {
+  if (!status) {
+    container.clear();
+    value->replace(std::move(container));
+  } else if (sorted) {
+    value->replace(std::move(container));
+  } else {
+    *value = Type{std::move(container), value->key_comp()};
+  }
+}
+
+// Truncates |container| to at most |size| elements without requiring the
+// elements to be default constructible.
+template <typename Container>
+void TruncateFlatContainer(std::size_t size, Container* container) {
+  if (container->size() > size)
+    container->erase(container->begin() + size, container->end());
+}
+
+template <typename Key, typename T, typename Compare>
+struct Encoding<FlatMap<Key, T, Compare>>
+    : EncodingIO<FlatMap<Key, T, Compare>> {
+  using Type = FlatMap<Key, T, Compare>;
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::Map;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    return BaseEncodingSize(Prefix(value)) +
+           Encoding<SizeType>::Size(value.size()) +
+           EntriesEncodingSize<Key, T>(value);
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Map;
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte /*prefix*/,
+                                             const Type& value,
+                                             Writer* writer) {
+    auto status = Encoding<SizeType>::Write(value.size(), writer);
+    if (!status)
+      return status;
+
+    for (const auto& element : value) {
+      status = Encoding<Key>::Write(element.first, writer);
+      if (!status)
+        return status;
+
+      status = Encoding<T>::Write(element.second, writer);
+      if (!status)
+        return status;
+    }
+
+    return {};
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
+                                            Type* value, Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    auto container = value->extract();
+    bool sorted = true;
+    status = ReadEntries(size, &container, value->value_comp(), &sorted,
+                         reader);
+    ReplaceFlatContainer(status, sorted, std::move(container), value);
+    return status;
+  }
+
+ private:
+  template <typename Container, typename Less, typename Reader>
+  static constexpr Status<void> ReadEntries(SizeType size,
+                                            Container* container,
+                                            const Less& less, bool* sorted,
+                                            Reader* reader) {
+    TruncateFlatContainer(size, container);
+    container->reserve(ReserveCount(size, reader));
+
+    for (SizeType i = 0; i < size; i++) {
+      if (i == container->size())
+        container->emplace_back();
+
+      auto& element = (*container)[i];
+      auto status = Encoding<Key>::Read(&element.first, reader);
+      if (!status)
+        return status;
+
+      status = Encoding<T>::Read(&element.second, reader);
+      if (!status)
+        return status;
+
+      if (i > 0 && !less((*container)[i - 1], element))
+        *sorted = false;
+    }
+
+    return {};
+  }
+};
+
+// Specialization for sets of non-integral types.
+template <typename Key, typename Compare>
+struct Encoding<FlatSet<Key, Compare>, EnableIfNotIntegral<Key>>
+    : EncodingIO<FlatSet<Key, Compare>> {
+  using Type = FlatSet<Key, Compare>;
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::Array;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    return BaseEncodingSize(Prefix(value)) +
+           Encoding<SizeType>::Size(value.size()) +
+           ElementsEncodingSize<Key>(value);
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Array;
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte /*prefix*/,
+                                             const Type& value,
+                                             Writer* writer) {
+    auto status = Encoding<SizeType>::Write(value.size(), writer);
+    if (!status)
+      return status;
+
+    for (const Key& element : value) {
+      status = Encoding<Key>::Write(element, writer);
+      if (!status)
+        return status;
+    }
+
+    return {};
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
+                                            Type* value, Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    auto container = value->extract();
+    bool sorted = true;
+    status = ReadElements(size, &container, value->value_comp(), &sorted,
+                          reader);
+    ReplaceFlatContainer(status, sorted, std::move(container), value);
+    return status;
+  }
+
+ private:
+  template <typename Container, typename Reader>
+  static constexpr Status<void> ReadElements(SizeType size,
+                                             Container* container,
+                                             const Compare& less, bool* sorted,
+                                             Reader* reader) {
+    TruncateFlatContainer(size, container);
+    container->reserve(ReserveCount(size, reader));
+
+    for (SizeType i = 0; i < size; i++) {
+      if (i == container->size())
+        container->emplace_back();
+
+      auto status = Encoding<Key>::Read(&(*container)[i], reader);
+      if (!status)
+        return status;
+
+      if (i > 0 && !less((*container)[i - 1], (*container)[i]))
+        *sorted = false;
+    }
+
+    return {};
+  }
+};
+
+// Specialization for sets of integral types. The elements are read directly
+// into the underlying vector.
+template <typename Key, typename Compare>
+struct Encoding<FlatSet<Key, Compare>, EnableIfIntegral<Key>>
+    : EncodingIO<FlatSet<Key, Compare>> {
+  using Type = FlatSet<Key, Compare>;
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::Binary;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    const SizeType size = value.size() * sizeof(Key);
+    return BaseEncodingSize(Prefix(value)) + Encoding<SizeType>::Size(size) +
+           size;
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Binary;
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte /*prefix*/,
+                                             const Type& value,
+                                             Writer* writer) {
+    const auto& container = value.container();
+    auto status =
+        Encoding<SizeType>::Write(container.size() * sizeof(Key), writer);
+    if (!status)
+      return status;
+
+    return WritePacked(container.data(), container.data() + container.size(),
+                       writer);
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
+                                            Type* value, Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+    else if (size % sizeof(Key) != 0)
+      return ErrorStatus::InvalidContainerLength;
+
+    // Make sure the reader has enough data to fulfill the requested size as a
+    // defense against abusive or erroneous binary container sizes.
+    status = reader->Ensure(size);
+    if (!status)
+      return status;
+
+    const SizeType length = size / sizeof(Key);
+    auto container = value->extract();
+    container.resize(length);
+    status = ReadPacked(container.data(), container.data() + length, reader);
+
+    const Compare less = value->value_comp();
+    const bool sorted =
+        std::adjacent_find(container.begin(), container.end(),
+                           [&less](Key a, Key b) { return !less(a, b); }) ==
+        container.end();
+    ReplaceFlatContainer(status, sorted, std::move(container), value);
+    return status;
+  }
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_FLAT_MAP_H_
@@ -17,6 +17,9 @@
 #ifndef LIBNOP_INCLUDE_NOP_BASE_HANDLE_H_
 #define LIBNOP_INCLUDE_NOP_BASE_HANDLE_H_
 
+#include <cstddef>
+#include <utility>
+
 #include <nop/base/encoding.h>
 #include <nop/types/handle.h>
 
@@ -91,6 +94,30 @@ struct Encoding<Handle<Policy>> : EncodingIO<Handle<Policy>> {
   }
 };
 
+// Test expression for writers that can predict the handle references they
+// assign. Such writers define a method that returns, without side effects, a
+// reference no smaller than the one PushHandle() would return for |handle|
+// after |pending| more non-empty handles have been pushed:
+//
+//   class SomeWriter {
+//    public:
+//     template <typename HandleType>
+//     HandleReference PeekHandleReference(const HandleType& handle,
+//                                         std::size_t pending) const;
+//     ...
+//   };
+//
+// Since larger non-negative references never encode to fewer bytes, sizes
+// measured with such predictions are never smaller than the sizes written.
+template <typename Writer, typename HandleType>
+using PeekHandleReferenceTest =
+    decltype(std::declval<const Writer&>().PeekHandleReference(
+        std::declval<const HandleType&>(), std::size_t{}));
+
+// Handle sizes are overestimated; see Encoding<Handle<Policy>>::Size().
+template <typename Policy>
+struct IsSizeOverestimated<Handle<Policy>> : std::true_type {};
+
 }  // namespace nop
 
 #endif  // LIBNOP_INCLUDE_NOP_BASE_HANDLE_H_
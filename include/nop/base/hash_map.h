@@ -0,0 +1,107 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_HASH_MAP_H_
+#define LIBNOP_INCLUDE_NOP_BASE_HASH_MAP_H_
+
+#include <cstddef>
+#include <utility>
+
+#include <nop/base/encoding.h>
+#include <nop/base/map.h>
+#include <nop/types/hash_map.h>
+
+namespace nop {
+
+//
+// HashMap<Key, T> encoding format is the same as std::unordered_map<Key, T>:
+//
+// +-----+---------+--------//---------+
+// | MAP | INT64:N | N KEY/VALUE PAIRS |
+// +-----+---------+--------//---------+
+//
+
+template <typename Key, typename T, typename Hash, typename KeyEqual>
+struct Encoding<HashMap<Key, T, Hash, KeyEqual>>
+    : EncodingIO<HashMap<Key, T, Hash, KeyEqual>> {
+  using Type = HashMap<Key, T, Hash, KeyEqual>;
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::Map;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    return BaseEncodingSize(Prefix(value)) +
+           Encoding<SizeType>::Size(value.size()) +
+           EntriesEncodingSize<Key, T>(value);
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Map;
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte /*prefix*/,
+                                             const Type& value,
+                                             Writer* writer) {
+    auto status = Encoding<SizeType>::Write(value.size(), writer);
+    if (!status)
+      return status;
+
+    return WriteUnorderedEntries<Key, T>(value, writer);
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
+                                            Type* value, Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    // Size the slots for the encoded count once, as far as the bytes remaining
+    // in the reader allow, instead of rehashing as the map grows.
+    value->clear();
+    value->reserve(ReserveCount(size, reader));
+    for (SizeType i = 0; i < size; i++) {
+      Key key = MakeForDecode<Key>();
+      status = Encoding<Key>::Read(&key, reader);
+      if (!status)
+        return status;
+
+      // Decode the value in place in its slot, as for std::unordered_map.
+      auto result = EmplaceForDecode<T>([&](auto... args) {
+        return value->try_emplace(key, args...);
+      });
+      if (!result.second) {
+        T discarded = MakeForDecode<T>();
+        status = Encoding<T>::Read(&discarded, reader);
+      } else {
+        status = Encoding<T>::Read(&result.first->second, reader);
+        if (!status)
+          value->erase(key);
+      }
+      if (!status)
+        return status;
+    }
+
+    return {};
+  }
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_HASH_MAP_H_
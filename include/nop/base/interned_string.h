@@ -0,0 +1,208 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_INTERNED_STRING_H_
+#define LIBNOP_INCLUDE_NOP_BASE_INTERNED_STRING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include <nop/base/encoding.h>
+#include <nop/traits/is_detected.h>
+
+namespace nop {
+
+//
+// Interned string encoding formats:
+//
+// +-----+---------+---------+-------------+---//----+
+// | EXT | INT64:3 | INT64:L | INT64:INDEX | N BYTES |
+// +-----+---------+---------+-------------+---//----+
+//
+// +-----+---------+---------+-------------+
+// | EXT | INT64:4 | INT64:L | INT64:INDEX |
+// +-----+---------+---------+-------------+
+//
+// Writers that keep a table of the strings written in a message, such as
+// InterningWriter, write the first occurrence of a string as a definition
+// (extension code 3) holding a message-scoped INDEX followed by the N bytes of
+// the string, and each following occurrence as a reference (extension code 4)
+// to the INDEX of its definition. L is the number of bytes following it in
+// both formats. Readers that keep the matching table, such as InterningReader,
+// resolve references to the strings defined earlier in the message; other
+// readers fail with ErrorStatus::UnexpectedEncodingType.
+//
+// Definitions carry their index so that a reference to a definition that was
+// skipped, such as one in an unknown table entry, is reported as an error
+// rather than resolved to the wrong string.
+//
+
+// Result of looking up a string in the table of an interning writer.
+enum class InternResult {
+  None,   // Not interned: write the string in full.
+  Added,  // Added to the table: write a definition.
+  Found,  // Already defined: write a reference.
+};
+
+// Interning writers provide a method to look up a string, adding it to their
+// table if possible:
+//
+//   InternResult InternString(const void* data, std::size_t size,
+//                             std::uint64_t* index);
+template <typename Writer>
+using InternStringTest = decltype(std::declval<Writer&>().InternString(
+    std::declval<const void*>(), std::size_t{},
+    std::declval<std::uint64_t*>()));
+
+// Evaluates to true if Writer keeps a table of interned strings.
+template <typename Writer>
+using IsInterningWriter = IsDetected<InternStringTest, Writer>;
+
+// Interning readers provide methods to define the string at an index, which
+// returns storage of the given size for the string that remains valid until
+// the table is reset, and to find the string defined at an index:
+//
+//   Status<std::string*> DefineString(std::uint64_t index, std::size_t size);
+//   Status<const std::string*> FindString(std::uint64_t index) const;
+template <typename Reader>
+using DefineStringTest = decltype(std::declval<Reader&>().DefineString(
+    std::uint64_t{}, std::size_t{}));
+
+// Evaluates to true if Reader keeps a table of interned strings.
+template <typename Reader>
+using IsInterningReader = IsDetected<DefineStringTest, Reader>;
+
+// Reads and writes the interned string formats on behalf of the string
+// encodings.
+struct InternedString {
+  enum : SizeType { kDefinition = 3, kReference = 4 };
+
+  // Writes the |size| bytes at |data| using the table of |writer|. Returns
+  // false in |interned| if the string is not interned, in which case nothing
+  // is written.
+  template <typename Writer>
+  static Status<void> Write(const void* data, std::size_t size,
+                            Writer* writer, bool* interned) {
+    std::uint64_t index = 0;
+    const InternResult result = writer->InternString(data, size, &index);
+    *interned = result != InternResult::None;
+    if (result == InternResult::None)
+      return {};
+
+    auto status =
+        writer->Write(static_cast<std::uint8_t>(EncodingByte::Extension));
+    if (!status)
+      return status;
+
+    const bool definition = result == InternResult::Added;
+    status = Encoding<SizeType>::Write(definition ? kDefinition : kReference,
+                                       writer);
+    if (!status)
+      return status;
+
+    const std::size_t index_size = Encoding<SizeType>::Size(index);
+    status = Encoding<SizeType>::Write(
+        index_size + (definition ? size : 0), writer);
+    if (!status)
+      return status;
+
+    status = Encoding<SizeType>::Write(index, writer);
+    if (!status || !definition)
+      return status;
+
+    const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+    return writer->Write(bytes, bytes + size);
+  }
+
+  // Reads the payload of an interned string, following the EXT prefix, and
+  // returns the string from the table of |reader|.
+  template <typename Reader>
+  static Status<const std::string*> Read(Reader* reader) {
+    return Read(reader, IsInterningReader<Reader>{});
+  }
+
+  // Reads the payload of an interned string definition, given its extension
+  // code and size, into the table of |reader|. Used to keep the table complete
+  // when skipping values.
+  template <typename Reader>
+  static Status<const std::string*> ReadPayload(SizeType code, SizeType size,
+                                                Reader* reader) {
+    SizeType index = 0;
+    auto status = Encoding<SizeType>::Read(&index, reader);
+    if (!status)
+      return status.error();
+
+    const std::size_t index_size = Encoding<SizeType>::Size(index);
+    if (code == kReference) {
+      if (size != index_size)
+        return ErrorStatus::InvalidStringLength;
+      else
+        return reader->FindString(index);
+    } else if (code != kDefinition) {
+      return ErrorStatus::UnexpectedEncodingType;
+    } else if (size < index_size) {
+      return ErrorStatus::InvalidStringLength;
+    }
+
+    // Make sure the reader has enough data to fulfill the requested size as a
+    // defense against abusive or erroneous string sizes.
+    const SizeType length = size - index_size;
+    status = reader->Ensure(length);
+    if (!status)
+      return status.error();
+
+    auto storage = reader->DefineString(index, length);
+    if (!storage)
+      return storage.error();
+
+    std::string* string = storage.get();
+    status = reader->Read(&(*string)[0], &(*string)[length]);
+    if (!status)
+      return status.error();
+    else
+      return string;
+  }
+
+ private:
+  template <typename Reader>
+  static Status<const std::string*> Read(Reader* /*reader*/,
+                                         std::false_type) {
+    return ErrorStatus::UnexpectedEncodingType;
+  }
+
+  template <typename Reader>
+  static Status<const std::string*> Read(Reader* reader, std::true_type) {
+    SizeType code = 0;
+    auto status = Encoding<SizeType>::Read(&code, reader);
+    if (!status)
+      return status.error();
+    else if (code != kDefinition && code != kReference)
+      return ErrorStatus::UnexpectedEncodingType;
+
+    SizeType size = 0;
+    status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status.error();
+    else
+      return ReadPayload(code, size, reader);
+  }
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_INTERNED_STRING_H_
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_LAZY_H_
+#define LIBNOP_INCLUDE_NOP_BASE_LAZY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include <nop/base/encoding.h>
+#include <nop/base/members.h>
+#include <nop/base/skip.h>
+#include <nop/base/table.h>
+#include <nop/table.h>
+#include <nop/utility/bounded_reader.h>
+
+namespace nop {
+
+//
+// Lazy access to a single member of an encoded structure or a single entry of
+// an encoded table, without decoding the rest of the value. The members
+// preceding the selected member are skipped with SkipValue(), and the entries
+// of a table other than the selected entry are skipped using their sizes.
+//
+// SeekMember() and SeekEntry() position the reader at the encoding of the
+// selected member or entry value; these may be chained to select a path
+// through nested values. ReadMember() and ReadEntry() seek and then decode the
+// selected member or entry. In every case the reader is left inside the
+// enclosing value, so the reader should not be used to read the values that
+// follow the enclosing value.
+//
+// Example of reading one member of a nested structure:
+//
+//   struct Header {
+//     std::uint32_t route;
+//     ...
+//     NOP_STRUCTURE(Header, route, ...);
+//   };
+//
+//   struct Message {
+//     std::string name;
+//     Header header;
+//     ...
+//     NOP_STRUCTURE(Message, name, header, ...);
+//   };
+//
+//   nop::BufferReader reader{buffer, size};
+//   std::uint32_t route;
+//   auto status = nop::SeekMember<Message, 1>(&reader);
+//   if (status)
+//     status = nop::ReadMember<Header, 0>(&route, &reader);
+//
+
+// The type of the member of structure T with the given index.
+template <typename T, std::size_t Index>
+using MemberTypeAt = typename MemberListTraits<
+    T>::MemberList::template At<Index>::Type;
+
+template <typename Table, std::uint64_t Id, std::size_t... Is>
+constexpr std::size_t EntryIndexOf(std::index_sequence<Is...>) {
+  const std::uint64_t ids[] = {
+      EntryListTraits<Table>::EntryList::template At<Is>::Type::Id..., Id};
+  std::size_t index = 0;
+  while (ids[index] != Id)
+    index++;
+  return index;
+}
+
+// Returns the index of the entry of Table with the given id, or the number of
+// entries if there is no such entry.
+template <typename Table, std::uint64_t Id>
+constexpr std::size_t EntryIndexOf() {
+  return EntryIndexOf<Table, Id>(
+      std::make_index_sequence<EntryListTraits<Table>::EntryList::Count>{});
+}
+
+// The Entry type of the entry of Table with the given id.
+template <typename Table, std::uint64_t Id>
+using EntryTypeFor = typename EntryListTraits<
+    Table>::EntryList::template At<EntryIndexOf<Table, Id>()>::Type;
+
+// Positions |reader| at the encoding of the member of structure T with the
+// given runtime |index|, for callers that select members dynamically. Returns
+// ErrorStatus::InvalidMemberCount if T has no member with the given index.
+template <typename T, typename Reader>
+Status<void> SeekMember(std::size_t index, Reader* reader) {
+  static_assert(HasMemberList<T>::value,
+                "SeekMember requires a structure with a member list.");
+  static_assert(!IsRawStructure<T>::value,
+                "SeekMember does not support raw structures.");
+
+  if (index >= MemberListTraits<T>::MemberList::Count)
+    return ErrorStatus::InvalidMemberCount;
+
+  std::uint8_t prefix_byte = 0;
+  auto status = reader->Read(&prefix_byte);
+  if (!status)
+    return status;
+  else if (static_cast<EncodingByte>(prefix_byte) != EncodingByte::Structure)
+    return ErrorStatus::UnexpectedEncodingType;
+
+  SizeType count = 0;
+  status = Encoding<SizeType>::Read(&count, reader);
+  if (!status)
+    return status;
+  else if (count != MemberListTraits<T>::MemberList::Count)
+    return ErrorStatus::InvalidMemberCount;
+
+  for (std::size_t i = 0; i < index; i++) {
+    status = SkipValue(reader);
+    if (!status)
+      return status;
+  }
+
+  return {};
+}
+
+// Positions |reader| at the encoding of the member of structure T with the
+// given index.
+template <typename T, std::size_t Index, typename Reader>
+Status<void> SeekMember(Reader* reader) {
+  static_assert(HasMemberList<T>::value,
+                "SeekMember requires a structure with a member list.");
+  static_assert(Index < MemberListTraits<T>::MemberList::Count,
+                "Member index out of range.");
+  return SeekMember<T>(Index, reader);
+}
+
+// Reads the member of structure T with the given index into |value| without
+// decoding the other members.
+template <typename T, std::size_t Index, typename Reader>
+Status<void> ReadMember(MemberTypeAt<T, Index>* value, Reader* reader) {
+  auto status = SeekMember<T, Index>(reader);
+  if (!status)
+    return status;
+
+  return Encoding<MemberTypeAt<T, Index>>::Read(value, reader);
+}
+
+// Positions |reader| at the encoding of the value of the entry of Table with
+// the given id and stores the size of the entry in |size|. Returns true if the
+// entry is present or false if the reader reached the end of the table without
+// finding the entry.
+template <typename Table, std::uint64_t Id, typename Reader>
+Status<bool> SeekEntry(Reader* reader, SizeType* size) {
+  static_assert(HasEntryList<Table>::value,
+                "SeekEntry requires a table with an entry list.");
+  static_assert(EntryIndexOf<Table, Id>() <
+                    EntryListTraits<Table>::EntryList::Count,
+                "The table has no entry with the given id.");
+
+  std::uint8_t prefix_byte = 0;
+  auto status = reader->Read(&prefix_byte);
+  if (!status)
+    return status.error();
+  else if (static_cast<EncodingByte>(prefix_byte) != EncodingByte::Table)
+    return ErrorStatus::UnexpectedEncodingType;
+
+  std::uint64_t hash = 0;
+  status = Encoding<std::uint64_t>::Read(&hash, reader);
+  if (!status)
+    return status.error();
+  else if (hash != EntryListTraits<Table>::EntryList::Hash)
+    return ErrorStatus::InvalidTableHash;
+
+  SizeType count = 0;
+  status = Encoding<SizeType>::Read(&count, reader);
+  if (!status)
+    return status.error();
+
+  for (SizeType i = 0; i < count; i++) {
+    std::uint64_t id = 0;
+    status = Encoding<std::uint64_t>::Read(&id, reader);
+    if (!status)
+      return status.error();
+
+    // Entry values are wrapped in a sized binary container, which is only
+    // unwrapped for the selected entry.
+    status = Encoding<SizeType>::Read(size, reader);
+    if (!status)
+      return status.error();
+    else if (id == Id)
+      return true;
+
+    status = SkipValueCommon::SkipBytes(*size, reader);
+    if (!status)
+      return status.error();
+  }
+
+  return false;
+}
+
+template <typename Table, std::uint64_t Id, typename Reader>
+Status<bool> SeekEntry(Reader* reader) {
+  SizeType size = 0;
+  return SeekEntry<Table, Id>(reader, &size);
+}
+
+// Reads the entry of Table with the given id into |entry| without decoding the
+// other entries. The entry is left empty if it is not present in the table.
+template <typename Table, std::uint64_t Id, typename T, typename Reader>
+Status<void> ReadEntry(Entry<T, Id>* entry, Reader* reader) {
+  static_assert(std::is_same<EntryTypeFor<Table, Id>, Entry<T, Id>>::value,
+                "The entry type does not match the table entry with the given "
+                "id.");
+
+  entry->clear();
+  SizeType size = 0;
+  auto status = SeekEntry<Table, Id>(reader, &size);
+  if (!status)
+    return status.error();
+  else if (!status.get())
+    return {};
+
+  // Catch invalid sizes while decoding inside the binary container, as when
+  // reading the whole table.
+  *entry = T{};
+  BoundedReaderScope<Reader> scope{reader, size};
+  auto read_status = scope.status();
+  if (!read_status)
+    return read_status;
+
+  read_status = Encoding<T>::Read(&entry->get(), scope.reader());
+  if (!read_status)
+    return read_status;
+
+  return scope.ReadPadding();
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_LAZY_H_
@@ -18,8 +18,9 @@
 #ifndef LIBNOP_INCLUDE_NOP_BASE_LIST_H_
 #define LIBNOP_INCLUDE_NOP_BASE_LIST_H_
 
-#include <numeric>
+#include <algorithm>
 #include <list>
+#include <type_traits>
 
 #include <nop/base/encoding.h>
 #include <nop/base/utility.h>
@@ -27,7 +28,7 @@
 namespace nop {
 
 //
-// std::list<T> encoding format for non-integral types:
+// std::list<T> encoding format for non-packable types:
 //
 // +-----+---------+-----//-----+
 // | ARY | INT64:N | N ELEMENTS |
@@ -35,7 +36,8 @@ namespace nop {
 //
 // Elements must be valid encodings of type T.
 //
-// std::list<T> encoding format for integral types:
+// std::list<T> encoding format for packable (integral, float, and double)
+// types:
 //
 // +-----+---------+---//----+
 // | BIN | INT64:L | L BYTES |
@@ -43,13 +45,19 @@ namespace nop {
 //
 // Where L = N * sizeof(T).
 //
-// Elements are stored as direct little-endian representation of the integral
-// value; each element is sizeof(T) bytes in size.
+// Elements are stored as direct little-endian representation of the value;
+// each element is sizeof(T) bytes in size. Floating point elements are IEEE 754
+// single or double precision values. Since list nodes are not contiguous, the
+// elements are copied through a small buffer in batches, each of which is
+// written or read with a single bulk operation.
+//
+// Lists of floating point and enum flags types also accept the ARY format when
+// reading, which older versions of the library used for these types.
 //
 
-// Specialization for non-integral types.
+// Specialization for non-packable types.
 template <typename T, typename Allocator>
-struct Encoding<std::list<T, Allocator>, EnableIfNotIntegral<T>>
+struct Encoding<std::list<T, Allocator>, EnableIfNotPackable<T>>
     : EncodingIO<std::list<T, Allocator>> {
   using Type = std::list<T, Allocator>;
 
@@ -60,10 +68,7 @@ struct Encoding<std::list<T, Allocator>, EnableIfNotIntegral<T>>
   static constexpr std::size_t Size(const Type& value) {
     return BaseEncodingSize(Prefix(value)) +
            Encoding<SizeType>::Size(value.size()) +
-           std::accumulate(value.cbegin(), value.cend(), 0U,
-                           [](const std::size_t& sum, const T& element) {
-                             return sum + Encoding<T>::Size(element);
-                           });
+           ElementsEncodingSize<T>(value);
   }
 
   static constexpr bool Match(EncodingByte prefix) {
@@ -95,24 +100,15 @@ struct Encoding<std::list<T, Allocator>, EnableIfNotIntegral<T>>
     if (!status)
       return status;
 
-    // Clear the list to make sure elements are inserted in the correct order.
-    value->clear();
-    for (SizeType i = 0; i < size; i++) {
-      T element;
-      status = Encoding<T>::Read(&element, reader);
-      if (!status)
-        return status;
-
-      value->push_back(std::move(element));
-    }
-
-    return {};
+    // Elements already in the list are decoded into in place and any extra
+    // elements are appended.
+    return ReadSequenceElements<T>(size, value, reader);
   }
 };
 
-// Specialization for integral types.
+// Specialization for packable types.
 template <typename T, typename Allocator>
-struct Encoding<std::list<T, Allocator>, EnableIfIntegral<T>>
+struct Encoding<std::list<T, Allocator>, EnableIfPackable<T>>
     : EncodingIO<std::list<T, Allocator>> {
   using Type = std::list<T, Allocator>;
 
@@ -127,7 +123,8 @@ struct Encoding<std::list<T, Allocator>, EnableIfIntegral<T>>
   }
 
   static constexpr bool Match(EncodingByte prefix) {
-    return prefix == EncodingByte::Binary;
+    return prefix == EncodingByte::Binary ||
+           (HasLegacyArrayFormat<T>::value && prefix == EncodingByte::Array);
   }
 
   template <typename Writer>
@@ -140,23 +137,34 @@ struct Encoding<std::list<T, Allocator>, EnableIfIntegral<T>>
     if (!status)
       return status;
 
+    // Gather the elements into batches so that each is written with a single
+    // bulk operation, rather than one write per element.
+    T batch[kBatchLength];
+    std::size_t count = 0;
     for (const T& element : value) {
-      status = writer->Write(&element, &element + 1);
-      if (!status)
-        return status;
+      batch[count++] = element;
+      if (count == kBatchLength) {
+        status = WritePacked(batch, batch + count, writer);
+        if (!status)
+          return status;
+        count = 0;
+      }
     }
 
-    return {};
+    return WritePacked(batch, batch + count, writer);
   }
 
   template <typename Reader>
-  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
-                                            Type* value, Reader* reader) {
+  static constexpr Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                            Reader* reader) {
     SizeType size = 0;
     auto status = Encoding<SizeType>::Read(&size, reader);
     if (!status)
       return status;
 
+    if (prefix == EncodingByte::Array)
+      return ReadElements(size, value, reader);
+
     if (size % sizeof(T) != 0)
       return ErrorStatus::InvalidContainerLength;
 
@@ -169,14 +177,41 @@ struct Encoding<std::list<T, Allocator>, EnableIfIntegral<T>>
       return status;
 
     // Clear the list to make sure elements are inserted in the correct order.
+    // Elements are read in batches with a single bulk operation each.
+    value->clear();
+    T batch[kBatchLength];
+    for (SizeType remaining = length; remaining > 0;) {
+      const std::size_t count =
+          std::min<SizeType>(remaining, SizeType{kBatchLength});
+      status = ReadPacked(batch, batch + count, reader);
+      if (!status)
+        return status;
+
+      value->insert(value->end(), batch, batch + count);
+      remaining -= count;
+    }
+
+    return {};
+  }
+
+ private:
+  enum : std::size_t { kBatchBytes = 1024 };
+  enum : std::size_t {
+    kBatchLength = sizeof(T) < kBatchBytes ? kBatchBytes / sizeof(T) : 1
+  };
+
+  // Reads |size| individually encoded elements of the legacy ARY format.
+  template <typename Reader>
+  static constexpr Status<void> ReadElements(SizeType size, Type* value,
+                                             Reader* reader) {
     value->clear();
-    for (SizeType i = 0; i < length; i++) {
+    for (SizeType i = 0; i < size; i++) {
       T element;
-      status = reader->Read(&element, &element + 1);
+      auto status = Encoding<T>::Read(&element, reader);
       if (!status)
         return status;
 
-      value->push_back(std::move(element));
+      value->push_back(element);
     }
 
     return {};
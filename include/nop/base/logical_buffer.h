@@ -79,13 +79,13 @@
 
 namespace nop {
 
-// Encoding type that handles non-integral element types. Logical buffers of
-// non-integral element types are encoded the same as non-integral arrays using
+// Encoding type that handles non-packable element types. Logical buffers of
+// non-packable element types are encoded the same as non-packable arrays using
 // the ARRAY encoding.
 template <typename BufferType, typename SizeType, bool IsUnbounded>
 struct Encoding<
     LogicalBuffer<BufferType, SizeType, IsUnbounded>,
-    EnableIfNotIntegral<typename ArrayTraits<BufferType>::ElementType>>
+    EnableIfNotPackable<typename ArrayTraits<BufferType>::ElementType>>
     : EncodingIO<LogicalBuffer<BufferType, SizeType, IsUnbounded>> {
   using Type = LogicalBuffer<BufferType, SizeType, IsUnbounded>;
   using ValueType = std::remove_const_t<typename Type::ValueType>;
@@ -150,12 +150,13 @@ struct Encoding<
   }
 };
 
-// Encoding type that handles integral element types. Logical buffers of
-// integral element types are encoded the same as arrays with integral elements
-// using the BINARY encoding.
+// Encoding type that handles packable (integral, float, and double) element
+// types. Logical buffers of packable element types are encoded the same as
+// arrays with packable elements using the BINARY encoding. Logical buffers of
+// floating point types also accept the legacy ARRAY encoding when reading.
 template <typename BufferType, typename SizeType, bool IsUnbounded>
 struct Encoding<LogicalBuffer<BufferType, SizeType, IsUnbounded>,
-                EnableIfIntegral<typename ArrayTraits<BufferType>::ElementType>>
+                EnableIfPackable<typename ArrayTraits<BufferType>::ElementType>>
     : EncodingIO<LogicalBuffer<BufferType, SizeType, IsUnbounded>> {
   using Type = LogicalBuffer<BufferType, SizeType, IsUnbounded>;
   using ValueType = std::remove_const_t<typename Type::ValueType>;
@@ -172,7 +173,9 @@ struct Encoding<LogicalBuffer<BufferType, SizeType, IsUnbounded>,
   }
 
   static constexpr bool Match(EncodingByte prefix) {
-    return prefix == EncodingByte::Binary;
+    return prefix == EncodingByte::Binary ||
+           (std::is_floating_point<ValueType>::value &&
+            prefix == EncodingByte::Array);
   }
 
   template <typename Writer>
@@ -187,16 +190,18 @@ struct Encoding<LogicalBuffer<BufferType, SizeType, IsUnbounded>,
     if (!status)
       return status;
 
-    return writer->Write(value.begin(), value.end());
+    return WritePacked(value.begin(), value.end(), writer);
   }
 
   template <typename Reader>
-  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
-                                            Type* value, Reader* reader) {
+  static constexpr Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                            Reader* reader) {
     SizeType size_bytes = 0;
     auto status = Encoding<SizeType>::Read(&size_bytes, reader);
     if (!status) {
       return status;
+    } else if (prefix == EncodingByte::Array) {
+      return ReadElements(size_bytes, value, reader);
     } else if ((!IsUnbounded && size_bytes > Length * sizeof(ValueType)) ||
                size_bytes % sizeof(ValueType) != 0) {
       return ErrorStatus::InvalidContainerLength;
@@ -204,10 +209,51 @@ struct Encoding<LogicalBuffer<BufferType, SizeType, IsUnbounded>,
 
     const SizeType size = size_bytes / sizeof(ValueType);
     value->size() = size;
-    return reader->Read(value->begin(), value->end());
+    return ReadPacked(value->begin(), value->end(), reader);
+  }
+
+ private:
+  // Reads |size| individually encoded elements of the legacy ARRAY format.
+  template <typename Reader>
+  static constexpr Status<void> ReadElements(SizeType size, Type* value,
+                                             Reader* reader) {
+    if (!IsUnbounded && size > Length)
+      return ErrorStatus::InvalidContainerLength;
+
+    for (SizeType i = 0; i < size; i++) {
+      auto status = Encoding<ValueType>::Read(&(*value)[i], reader);
+      if (!status)
+        return status;
+    }
+
+    value->size() = size;
+    return {};
   }
 };
 
+// Bounded logical buffers are bounded by the capacity of the underlying
+// array, the same as arrays of the element type. Unbounded logical buffers may
+// hold any number of elements.
+template <typename BufferType, typename SizeType, bool IsUnbounded>
+struct MaxEncodingSize<LogicalBuffer<BufferType, SizeType, IsUnbounded>>
+    : std::integral_constant<
+          bool, !IsUnbounded && MaxEncodingSize<std::remove_const_t<
+                                    typename ArrayTraits<BufferType>::
+                                        ElementType>>::value> {
+  using ValueType =
+      std::remove_const_t<typename ArrayTraits<BufferType>::ElementType>;
+  enum : std::size_t {
+    Length = ArrayTraits<BufferType>::Length,
+    ElementSize = IsPackable<ValueType>::value &&
+                          !std::is_floating_point<ValueType>::value
+                      ? sizeof(ValueType)
+                      : std::size_t{MaxEncodingSize<ValueType>::Size},
+    Size = !IsUnbounded && MaxEncodingSize<ValueType>::value
+               ? 1 + MaxEncodingSize<SizeType>::Size + Length * ElementSize
+               : 0
+  };
+};
+
 }  // namespace nop
 
 #endif  //  LIBNOP_INCLUDE_NOP_BASE_LOGICAL_BUFFER_H_
@@ -17,10 +17,16 @@
 #ifndef LIBNOP_INCLUDE_NOP_BASE_MAP_H_
 #define LIBNOP_INCLUDE_NOP_BASE_MAP_H_
 
+#include <algorithm>
+#include <functional>
 #include <map>
-#include <numeric>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include <nop/base/canonical.h>
 #include <nop/base/encoding.h>
 
 namespace nop {
@@ -33,8 +39,93 @@ namespace nop {
 // +-----+---------+--------//---------+
 //
 // Each pair must be a valid encoding of Key followed by a valid encoding of T.
+// Unordered maps write their pairs in iteration order, or in the order of their
+// encodings for canonical writers (see nop/base/canonical.h). Writers never
+// repeat a key; when reading, a key that appears more than once keeps its first
+// value, whether the map is decoded into fresh or merged into existing nodes.
 //
 
+// Returns the sum of the encoded sizes of the entries of map |value|. When both
+// Key and T have fixed encoding sizes the sum is computed without visiting the
+// entries.
+template <typename Key, typename T, typename Map>
+constexpr std::enable_if_t<
+    FixedEncodingSize<Key>::value && FixedEncodingSize<T>::value, std::size_t>
+EntriesEncodingSize(const Map& value) {
+  return value.size() *
+         (static_cast<std::size_t>(FixedEncodingSize<Key>::Size) +
+          static_cast<std::size_t>(FixedEncodingSize<T>::Size));
+}
+template <typename Key, typename T, typename Map>
+constexpr std::enable_if_t<
+    !(FixedEncodingSize<Key>::value && FixedEncodingSize<T>::value),
+    std::size_t>
+EntriesEncodingSize(const Map& value) {
+  std::size_t size = 0;
+  for (const auto& element : value)
+    size += Encoding<Key>::Size(element.first) +
+            Encoding<T>::Size(element.second);
+  return size;
+}
+
+// Writes a key/value pair of a map with Key and T.
+template <typename Key, typename T>
+struct MapEntryWriter {
+  template <typename Element, typename Writer>
+  Status<void> operator()(const Element& element, Writer* writer) const {
+    auto status = Encoding<Key>::Write(element.first, writer);
+    if (!status)
+      return status;
+
+    return Encoding<T>::Write(element.second, writer);
+  }
+};
+
+// Writes the entries of the unordered map |value| in iteration order.
+template <typename Key, typename T, typename Map, typename Writer>
+Status<void> WriteUnorderedEntries(const Map& value, Writer* writer,
+                                   std::false_type /*canonical*/) {
+  for (const auto& element : value) {
+    auto status = MapEntryWriter<Key, T>{}(element, writer);
+    if (!status)
+      return status;
+  }
+  return {};
+}
+
+// Writes the entries of the unordered map |value| in canonical order.
+template <typename Key, typename T, typename Map, typename Writer>
+Status<void> WriteUnorderedEntries(const Map& value, Writer* writer,
+                                   std::true_type /*canonical*/) {
+  return WriteCanonicalElements(value, MapEntryWriter<Key, T>{}, writer);
+}
+
+template <typename Key, typename T, typename Map, typename Writer>
+Status<void> WriteUnorderedEntries(const Map& value, Writer* writer) {
+  return WriteUnorderedEntries<Key, T>(value, writer,
+                                       IsCanonicalWriter<Writer>{});
+}
+
+// Evaluates to true if Key takes an allocator that may be converted from the
+// allocator of a map, as strings and other containers do.
+template <typename Key, typename Allocator>
+using KeyAllocatorTest = decltype(
+    Key(typename Key::allocator_type(std::declval<const Allocator&>())));
+
+// Returns a scratch key to decode the keys of a map with |allocator| into.
+// Keys that take an allocator are given the allocator of the map, so that they
+// allocate from the same source as the nodes they are moved into.
+template <typename Key, typename Allocator>
+std::enable_if_t<IsDetected<KeyAllocatorTest, Key, Allocator>::value, Key>
+MakeKeyForDecode(const Allocator& allocator) {
+  return Key(typename Key::allocator_type(allocator));
+}
+template <typename Key, typename Allocator>
+std::enable_if_t<!IsDetected<KeyAllocatorTest, Key, Allocator>::value, Key>
+MakeKeyForDecode(const Allocator& /*allocator*/) {
+  return MakeForDecode<Key>();
+}
+
 template <typename Key, typename T, typename Compare, typename Allocator>
 struct Encoding<std::map<Key, T, Compare, Allocator>>
     : EncodingIO<std::map<Key, T, Compare, Allocator>> {
@@ -47,12 +138,7 @@ struct Encoding<std::map<Key, T, Compare, Allocator>>
   static constexpr std::size_t Size(const Type& value) {
     return BaseEncodingSize(Prefix(value)) +
            Encoding<SizeType>::Size(value.size()) +
-           std::accumulate(
-               value.cbegin(), value.cend(), 0U,
-               [](const std::size_t& sum, const std::pair<Key, T>& element) {
-                 return sum + Encoding<Key>::Size(element.first) +
-                        Encoding<T>::Size(element.second);
-               });
+           EntriesEncodingSize<Key, T>(value);
   }
 
   static constexpr bool Match(EncodingByte prefix) {
@@ -67,7 +153,7 @@ struct Encoding<std::map<Key, T, Compare, Allocator>>
     if (!status)
       return status;
 
-    for (const std::pair<Key, T>& element : value) {
+    for (const auto& element : value) {
       status = Encoding<Key>::Write(element.first, writer);
       if (!status)
         return status;
@@ -88,22 +174,67 @@ struct Encoding<std::map<Key, T, Compare, Allocator>>
     if (!status)
       return status;
 
-    value->clear();
+    // Merge the entries into the existing nodes in a single pass. Writers emit
+    // the entries of ordered maps in key order, so each new entry is inserted
+    // with a hint at the merge position in amortized constant time, and the
+    // values of nodes whose keys appear again are decoded in place, keeping
+    // their storage. Nodes whose keys do not appear are erased. Entries that
+    // are out of order are still inserted correctly, only without the benefit
+    // of the hint. Keys are decoded into a scratch key, which is moved into
+    // new nodes; keys of existing nodes reuse the storage of the scratch key.
+    const auto less = value->key_comp();
+    auto position = value->begin();
+    Key key = MakeKeyForDecode<Key>(value->get_allocator());
     for (SizeType i = 0; i < size; i++) {
-      std::pair<Key, T> element;
-      status = Encoding<Key>::Read(&element.first, reader);
+      status = Encoding<Key>::Read(&key, reader);
       if (!status)
         return status;
 
-      status = Encoding<T>::Read(&element.second, reader);
-      if (!status)
-        return status;
+      while (position != value->end() && less(position->first, key))
+        position = value->erase(position);
+
+      if (position != value->end() && !less(key, position->first)) {
+        status = Encoding<T>::Read(&position->second, reader);
+        if (!status)
+          return status;
 
-      value->emplace(std::move(element));
+        ++position;
+      } else {
+        status = ReadNewEntry(std::move(key), position, value, reader);
+        if (!status)
+          return status;
+      }
     }
 
+    value->erase(position, value->end());
     return {};
   }
+
+ private:
+  // Inserts a node for |key| with the hint |position| and decodes its value in
+  // place. The node is removed again if decoding fails. The value of a key
+  // that is already present out of order is decoded and discarded, keeping the
+  // first value as when inserting decoded entries.
+  template <typename Reader>
+  static Status<void> ReadNewEntry(Key&& key,
+                                   typename Type::const_iterator position,
+                                   Type* value, Reader* reader) {
+    const std::size_t size = value->size();
+    auto entry = EmplaceForDecode<T>([&](auto... args) {
+      return value->emplace_hint(position, std::piecewise_construct,
+                                 std::forward_as_tuple(std::move(key)),
+                                 std::forward_as_tuple(args...));
+    });
+    if (value->size() == size) {
+      T discarded = MakeForDecode<T>();
+      return Encoding<T>::Read(&discarded, reader);
+    }
+
+    auto status = Encoding<T>::Read(&entry->second, reader);
+    if (!status)
+      value->erase(entry);
+    return status;
+  }
 };
 
 template <typename Key, typename T, typename Hash, typename KeyEqual,
@@ -119,12 +250,7 @@ struct Encoding<std::unordered_map<Key, T, Hash, KeyEqual, Allocator>>
   static constexpr std::size_t Size(const Type& value) {
     return BaseEncodingSize(Prefix(value)) +
            Encoding<SizeType>::Size(value.size()) +
-           std::accumulate(
-               value.cbegin(), value.cend(), 0U,
-               [](const std::size_t& sum, const std::pair<Key, T>& element) {
-                 return sum + Encoding<Key>::Size(element.first) +
-                        Encoding<T>::Size(element.second);
-               });
+           EntriesEncodingSize<Key, T>(value);
   }
 
   static constexpr bool Match(EncodingByte prefix) {
@@ -139,17 +265,7 @@ struct Encoding<std::unordered_map<Key, T, Hash, KeyEqual, Allocator>>
     if (!status)
       return status;
 
-    for (const std::pair<Key, T>& element : value) {
-      status = Encoding<Key>::Write(element.first, writer);
-      if (!status)
-        return status;
-
-      status = Encoding<T>::Write(element.second, writer);
-      if (!status)
-        return status;
-    }
-
-    return {};
+    return WriteUnorderedEntries<Key, T>(value, writer);
   }
 
   template <typename Reader>
@@ -160,22 +276,123 @@ struct Encoding<std::unordered_map<Key, T, Hash, KeyEqual, Allocator>>
     if (!status)
       return status;
 
-    value->clear();
+    // An empty map, the common case for a fresh destination, only needs the
+    // new entries inserted.
+    if (value->empty()) {
+      value->reserve(ReserveCount(size, reader));
+      return ReadEntries(size, value, nullptr, nullptr, reader);
+    }
+
+    // Otherwise merge the entries into the existing nodes, as for ordered maps
+    // above: the values of nodes whose keys appear again are decoded in place,
+    // keeping their storage, and nodes whose keys do not appear are erased,
+    // also when decoding fails. Since the entries are in no particular order,
+    // the existing nodes are listed by address, and each is marked as its key
+    // appears. The list is kept on the stack for maps of up to kInlineNodes
+    // entries, so that merging into them does not allocate; larger maps pay
+    // one allocation for the list.
+    NodeMark inline_nodes[kInlineNodes];
+    std::vector<NodeMark> heap_nodes;
+    NodeMark* nodes = inline_nodes;
+    if (value->size() > kInlineNodes) {
+      heap_nodes.resize(value->size());
+      nodes = heap_nodes.data();
+    }
+
+    NodeMark* const nodes_end = nodes + value->size();
+    std::transform(value->begin(), value->end(), nodes,
+                   [](const Entry& entry) { return NodeMark{&entry, false}; });
+    std::sort(nodes, nodes_end, NodeLess);
+
+    status = ReadEntries(size, value, nodes, nodes_end, reader);
+    for (const NodeMark* node = nodes; node != nodes_end; ++node) {
+      if (!node->marked) {
+        const auto* entry = static_cast<const Entry*>(node->node);
+        value->erase(value->find(entry->first));
+      }
+    }
+    return status;
+  }
+
+ private:
+  using Entry = typename Type::value_type;
+
+  enum : std::size_t { kInlineNodes = 64 };
+
+  // Address of a node of the map, with a mark for whether its key appeared.
+  struct NodeMark {
+    const void* node;
+    bool marked;
+  };
+
+  static bool NodeLess(const NodeMark& a, const NodeMark& b) {
+    return std::less<const void*>{}(a.node, b.node);
+  }
+
+  // Reads |size| entries into |value|, merging them into the existing nodes
+  // listed in [nodes, nodes_end), sorted by address, if |nodes| is not null.
+  template <typename Reader>
+  static Status<void> ReadEntries(SizeType size, Type* value, NodeMark* nodes,
+                                  NodeMark* nodes_end, Reader* reader) {
+    Key key = MakeKeyForDecode<Key>(value->get_allocator());
     for (SizeType i = 0; i < size; i++) {
-      std::pair<Key, T> element;
-      status = Encoding<Key>::Read(&element.first, reader);
+      auto status = Encoding<Key>::Read(&key, reader);
       if (!status)
         return status;
 
-      status = Encoding<T>::Read(&element.second, reader);
+      auto entry = nodes ? value->find(key) : value->end();
+      if (entry == value->end())
+        status = ReadNewEntry(std::move(key), value, reader);
+      else if (MarkNode(&*entry, nodes, nodes_end))
+        status = Encoding<T>::Read(&entry->second, reader);
+      else
+        status = ReadDiscardedValue(reader);
       if (!status)
         return status;
-
-      value->emplace(std::move(element));
     }
 
     return {};
   }
+
+  // Marks the existing node |entry| as appearing. Returns false if it already
+  // appeared, or if it is not an existing node but one inserted while reading.
+  static bool MarkNode(const Entry* entry, NodeMark* nodes,
+                       NodeMark* nodes_end) {
+    const NodeMark node{entry, false};
+    NodeMark* position = std::lower_bound(nodes, nodes_end, node, NodeLess);
+    if (position == nodes_end || position->node != node.node ||
+        position->marked) {
+      return false;
+    }
+
+    position->marked = true;
+    return true;
+  }
+
+  // Inserts a node for |key| and decodes its value in place, as for ordered
+  // maps above.
+  template <typename Reader>
+  static Status<void> ReadNewEntry(Key&& key, Type* value, Reader* reader) {
+    auto result = EmplaceForDecode<T>([&](auto... args) {
+      return value->emplace(std::piecewise_construct,
+                            std::forward_as_tuple(std::move(key)),
+                            std::forward_as_tuple(args...));
+    });
+    if (!result.second)
+      return ReadDiscardedValue(reader);
+
+    auto status = Encoding<T>::Read(&result.first->second, reader);
+    if (!status)
+      value->erase(result.first);
+    return status;
+  }
+
+  // Decodes and discards the value of a duplicate key.
+  template <typename Reader>
+  static Status<void> ReadDiscardedValue(Reader* reader) {
+    T discarded = MakeForDecode<T>();
+    return Encoding<T>::Read(&discarded, reader);
+  }
 };
 
 }  // namespace nop
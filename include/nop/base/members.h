@@ -34,90 +34,305 @@ namespace nop {
 // Members must be valid encodings of their member type.
 //
 
+// Enable if T is a user-defined structure that is encoded member by member.
+template <typename T, typename ReturnType = void>
+using EnableIfStructure =
+    std::enable_if_t<HasMemberList<T>::value && !IsRawStructure<T>::value,
+                     ReturnType>;
+
+// Enable if T is a user-defined structure annotated with NOP_RAW_STRUCTURE.
+template <typename T, typename ReturnType = void>
+using EnableIfRawStructure =
+    std::enable_if_t<HasMemberList<T>::value && IsRawStructure<T>::value,
+                     ReturnType>;
+
 template <typename T>
-struct Encoding<T, EnableIfHasMemberList<T>> : EncodingIO<T> {
+struct Encoding<T, EnableIfStructure<T>> : EncodingIO<T> {
   static constexpr EncodingByte Prefix(const T& /*value*/) {
     return EncodingByte::Structure;
   }
 
   static constexpr std::size_t Size(const T& value) {
     return BaseEncodingSize(Prefix(value)) + Encoding<SizeType>::Size(Count) +
-           Size(value, Index<Count>{});
+           Size(value, Indices{});
   }
 
   static constexpr bool Match(EncodingByte prefix) {
     return prefix == EncodingByte::Structure;
   }
 
+  // Small bounded structures are staged and written in one call; see
+  // StagingWriter.
+  template <typename Writer>
+  static constexpr Status<void> Write(const T& value, Writer* writer) {
+    return Write(value, writer, IsStaged<T, Writer>{});
+  }
+
   template <typename Writer>
   static constexpr Status<void> WritePayload(EncodingByte /*prefix*/,
                                              const T& value, Writer* writer) {
     auto status = Encoding<SizeType>::Write(Count, writer);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
     else
-      return WriteMembers(value, writer, Index<Count>{});
+      return WriteMembers(value, writer, Indices{});
   }
 
   template <typename Reader>
   static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/, T* value,
                                             Reader* reader) {
+    return ReadPayload(value, reader, IsHoisted<Reader>{});
+  }
+
+ private:
+  enum : std::size_t { Count = MemberListTraits<T>::MemberList::Count };
+
+  // Structures with a bounded encoding size read from contiguous input check
+  // the bytes remaining once and then read all of their members without
+  // further bounds checks.
+  template <typename Reader>
+  using IsHoisted = And<MaxEncodingSize<T>, IsContiguousReader<Reader>>;
+
+  template <typename Writer>
+  static constexpr Status<void> Write(const T& value, Writer* writer,
+                                      std::false_type) {
+    return EncodingIO<T>::Write(value, writer);
+  }
+
+  template <typename Writer>
+  static Status<void> Write(const T& value, Writer* writer, std::true_type) {
+    return WriteStaged(value, writer);
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(T* value, Reader* reader,
+                                            std::false_type) {
     SizeType size = 0;
     auto status = Encoding<SizeType>::Read(&size, reader);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
-    else if (size != Count)
+    else if (!IsTrustedReader<Reader>::value && size != Count)
       return ErrorStatus::InvalidMemberCount;
     else
-      return ReadMembers(value, reader, Index<Count>{});
+      return ReadMembers(value, reader, Indices{});
   }
 
- private:
-  enum : std::size_t { Count = MemberListTraits<T>::MemberList::Count };
+  template <typename Reader>
+  static Status<void> ReadPayload(T* value, Reader* reader, std::true_type) {
+    // The prefix has already been read.
+    const std::size_t max_size = MaxEncodingSize<T>::Size - 1;
+    if (reader->remaining() < max_size)
+      return ReadPayload(value, reader, std::false_type{});
+
+    auto data = reader->Borrow(0);
+    if (!data)
+      return data.error();
+
+    UncheckedReaderFor<Reader> unchecked_reader{data.get()};
+    auto status = ReadPayload(value, &unchecked_reader, std::false_type{});
+    if (NOP_UNLIKELY(!status))
+      return status;
+
+    return reader->Skip(unchecked_reader.size());
+  }
 
   using MemberList = typename MemberListTraits<T>::MemberList;
 
   template <std::size_t Index>
   using PointerAt = typename MemberList::template At<Index>;
 
-  static constexpr std::size_t Size(const T& /*value*/, Index<0>) { return 0; }
+  using Indices = std::make_index_sequence<Count>;
 
-  template <std::size_t index>
-  static constexpr std::size_t Size(const T& value, Index<index>) {
-    return Size(value, Index<index - 1>{}) + PointerAt<index - 1>::Size(value);
+  static constexpr std::size_t Size(const T& /*value*/, std::index_sequence<>) {
+    return 0;
+  }
+
+  template <std::size_t... Is>
+  static constexpr std::size_t Size(const T& value,
+                                    std::index_sequence<Is...>) {
+    return SumSizes({std::size_t{0}, PointerAt<Is>::Size(value)...});
   }
 
   template <typename Writer>
   static constexpr Status<void> WriteMembers(const T& /*value*/,
-                                             Writer* /*writer*/, Index<0>) {
+                                             Writer* /*writer*/,
+                                             std::index_sequence<>) {
     return {};
   }
 
-  template <std::size_t index, typename Writer>
+  template <typename Writer, std::size_t... Is>
   static constexpr Status<void> WriteMembers(const T& value, Writer* writer,
-                                             Index<index>) {
-    auto status = WriteMembers(value, writer, Index<index - 1>{});
-    if (!status)
-      return status;
-    else
-      return PointerAt<index - 1>::Write(value, writer, MemberList{});
+                                             std::index_sequence<Is...>) {
+    Status<void> status;
+    NOP_EXPAND_STATUS(status,
+                      PointerAt<Is>::Write(value, writer, MemberList{}));
+    return status;
   }
 
   template <typename Reader>
   static constexpr Status<void> ReadMembers(T* /*value*/, Reader* /*reader*/,
-                                            Index<0>) {
+                                            std::index_sequence<>) {
     return {};
   }
 
-  template <std::size_t index, typename Reader>
+  template <typename Reader, std::size_t... Is>
   static constexpr Status<void> ReadMembers(T* value, Reader* reader,
-                                            Index<index>) {
-    auto status = ReadMembers(value, reader, Index<index - 1>{});
-    if (!status)
+                                            std::index_sequence<Is...>) {
+    Status<void> status;
+    NOP_EXPAND_STATUS(status, PointerAt<Is>::Read(value, reader, MemberList{}));
+    return status;
+  }
+};
+
+// Structures have a fixed encoding size when all of their members do.
+template <typename MemberListType>
+struct FixedMemberListEncodingSize;
+template <typename... MemberPointers>
+struct FixedMemberListEncodingSize<MemberList<MemberPointers...>>
+    : FixedAggregateEncodingSize<typename MemberPointers::Type...> {};
+
+template <typename T>
+struct FixedEncodingSize<T, EnableIfStructure<T>>
+    : FixedMemberListEncodingSize<typename MemberListTraits<T>::MemberList> {};
+
+// Structures have a bounded encoding size when all of their members do.
+template <typename MemberListType>
+struct MaxMemberListEncodingSize;
+template <typename... MemberPointers>
+struct MaxMemberListEncodingSize<MemberList<MemberPointers...>>
+    : MaxAggregateEncodingSize<typename MemberPointers::Type...> {};
+
+template <typename T>
+struct MaxEncodingSize<T, EnableIfStructure<T>>
+    : MaxMemberListEncodingSize<typename MemberListTraits<T>::MemberList> {};
+
+// Structures overestimate their size when any of their members do.
+template <typename MemberListType>
+struct OverestimatedMemberList;
+template <typename... MemberPointers>
+struct OverestimatedMemberList<MemberList<MemberPointers...>>
+    : Or<std::false_type, IsSizeOverestimated<std::remove_cv_t<
+                              typename MemberPointers::Type>>...> {};
+
+template <typename T>
+struct IsSizeOverestimated<T, EnableIfHasMemberList<T>>
+    : OverestimatedMemberList<typename MemberListTraits<T>::MemberList> {};
+
+//
+// Raw structure T encoding format:
+//
+// +-----+---------+---//----+
+// | BIN | INT64:L | L BYTES |
+// +-----+---------+---//----+
+//
+// Where L = sizeof(T).
+//
+// The bytes are the direct representation of the structure in memory, which
+// holds each member in host byte order. Raw structures are only supported on
+// little-endian hosts, where this matches the byte order of the other
+// encodings.
+//
+
+// Determines whether T may be a member of a raw structure: packable types,
+// including other raw structures, and arrays of packable types.
+template <typename T, typename = void>
+struct IsRawMember : IsPackable<T> {};
+template <typename T>
+struct IsRawMember<T, std::enable_if_t<ArrayTraits<T>::value>>
+    : IsRawMember<std::remove_cv_t<typename ArrayTraits<T>::ElementType>> {};
+
+// Sums the sizes of Types.
+template <typename... Types>
+struct SizeOfSum : std::integral_constant<std::size_t, 0> {};
+template <typename First, typename... Rest>
+struct SizeOfSum<First, Rest...>
+    : std::integral_constant<std::size_t,
+                             sizeof(First) + SizeOfSum<Rest...>::value> {};
+
+// Checks the requirements of raw structures on the members of MemberList.
+template <typename MemberListType>
+struct RawMemberListTraits;
+template <typename... MemberPointers>
+struct RawMemberListTraits<MemberList<MemberPointers...>> {
+  enum : bool {
+    IsValid = And<IsRawMember<typename MemberPointers::Type>...>::value
+  };
+  enum : std::size_t {
+    Size = SizeOfSum<typename MemberPointers::Type...>::value
+  };
+};
+
+template <typename T>
+struct Encoding<T, EnableIfRawStructure<T>> : EncodingIO<T> {
+ private:
+  using Traits = RawMemberListTraits<typename MemberListTraits<T>::MemberList>;
+
+ public:
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Raw structures must be trivially copyable.");
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && \
+    __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  static_assert(sizeof(T) != sizeof(T),
+                "Raw structures are only supported on little-endian hosts.");
+#endif
+  static_assert(Traits::IsValid,
+                "Raw structure members must be integral, float, or double "
+                "types, raw structures, or arrays of these.");
+  static_assert(Traits::Size == sizeof(T),
+                "Raw structure members must cover the structure without "
+                "padding.");
+
+  static constexpr EncodingByte Prefix(const T& /*value*/) {
+    return EncodingByte::Binary;
+  }
+
+  static constexpr std::size_t Size(const T& value) {
+    return BaseEncodingSize(Prefix(value)) +
+           Encoding<SizeType>::Size(sizeof(T)) + sizeof(T);
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Binary;
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte /*prefix*/,
+                                             const T& value, Writer* writer) {
+    auto status = Encoding<SizeType>::Write(sizeof(T), writer);
+    if (NOP_UNLIKELY(!status))
       return status;
     else
-      return PointerAt<index - 1>::Read(value, reader, MemberList{});
+      return writer->Write(&value, &value + 1);
   }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/, T* value,
+                                            Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (NOP_UNLIKELY(!status))
+      return status;
+    else if (size != sizeof(T))
+      return ErrorStatus::InvalidContainerLength;
+    else
+      return reader->Read(value, value + 1);
+  }
+};
+
+template <typename T>
+struct FixedEncodingSize<T, EnableIfRawStructure<T>> : std::true_type {
+  enum : std::size_t {
+    Size = BaseEncodingSize(EncodingByte::Binary) +
+           Encoding<SizeType>::Size(sizeof(T)) + sizeof(T)
+  };
+};
+
+template <typename T>
+struct MaxEncodingSize<T, EnableIfRawStructure<T>> : std::true_type {
+  enum : std::size_t {
+    Size = BaseEncodingSize(EncodingByte::Binary) +
+           MaxEncodingSize<SizeType>::Size + sizeof(T)
+  };
 };
 
 }  // namespace nop
@@ -17,6 +17,9 @@
 #ifndef LIBNOP_INCLUDE_NOP_BASE_OPTIONAL_H_
 #define LIBNOP_INCLUDE_NOP_BASE_OPTIONAL_H_
 
+#include <algorithm>
+#include <cstddef>
+
 #include <nop/base/encoding.h>
 #include <nop/types/optional.h>
 
@@ -71,8 +74,11 @@ struct Encoding<Optional<T>> : EncodingIO<Optional<T>> {
                                   Reader* reader) {
     if (prefix == EncodingByte::Nil) {
       value->clear();
+    } else if (!value->empty()) {
+      // Decode into the existing value in place, keeping its storage.
+      return Encoding<T>::ReadPayload(prefix, &value->get(), reader);
     } else {
-      T temp;
+      T temp = MakeForDecode<T>();
       auto status = Encoding<T>::ReadPayload(prefix, &temp, reader);
       if (!status)
         return status;
@@ -84,6 +90,18 @@ struct Encoding<Optional<T>> : EncodingIO<Optional<T>> {
   }
 };
 
+// Optionals are bounded when the element type is bounded. Empty optionals are
+// encoded as NIL.
+template <typename T>
+struct MaxEncodingSize<Optional<T>> : MaxEncodingSize<T> {
+  enum : std::size_t {
+    Size = MaxEncodingSize<T>::value
+               ? std::max<std::size_t>(BaseEncodingSize(EncodingByte::Nil),
+                                       MaxEncodingSize<T>::Size)
+               : 0
+  };
+};
+
 }  // namespace nop
 
 #endif  // LIBNOP_INCLUDE_NOP_BASE_OPTIONAL_H_
@@ -89,6 +89,14 @@ struct Encoding<std::pair<T, U>> : EncodingIO<std::pair<T, U>> {
   using Second = std::remove_cv_t<std::remove_reference_t<U>>;
 };
 
+// Pairs have a fixed encoding size when both of their elements do.
+template <typename T, typename U>
+struct FixedEncodingSize<std::pair<T, U>> : FixedAggregateEncodingSize<T, U> {};
+
+// Pairs have a bounded encoding size when both of their elements do.
+template <typename T, typename U>
+struct MaxEncodingSize<std::pair<T, U>> : MaxAggregateEncodingSize<T, U> {};
+
 }  // namespace nop
 
 #endif  // LIBNOP_INCLUDE_NOP_BASE_PAIR_H_
@@ -0,0 +1,354 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_POINTER_H_
+#define LIBNOP_INCLUDE_NOP_BASE_POINTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include <nop/base/encoding.h>
+#include <nop/base/interned_string.h>
+#include <nop/traits/is_detected.h>
+#include <nop/utility/bounded_reader.h>
+#include <nop/utility/endian.h>
+
+namespace nop {
+
+//
+// std::unique_ptr<T> and std::shared_ptr<T> encoding formats:
+//
+// Null pointer:
+//
+// +-----+
+// | NIL |
+// +-----+
+//
+// Non-null pointer:
+//
+// +---//----+
+// | ELEMENT |
+// +---//----+
+//
+// Element must be a valid encoding of type T. These are the same formats as
+// Optional<T>, so that a pointer may be read as an optional and vice versa.
+//
+// Shared objects written through a writer that keeps a table of the objects in
+// a message, such as InterningWriter over a writer that supports Patch(), use
+// the following formats instead:
+//
+// +-----+---------+-------------+-------------+---//----+
+// | EXT | INT64:5 | U32:L       | INT64:INDEX | ELEMENT |
+// +-----+---------+-------------+-------------+---//----+
+//
+// +-----+---------+---------+-------------+
+// | EXT | INT64:6 | INT64:L | INT64:INDEX |
+// +-----+---------+---------+-------------+
+//
+// The first occurrence of each distinct object is written as a definition
+// (extension code 5) holding a message-scoped INDEX followed by the encoding of
+// the object. Each following shared_ptr to the same object, including those
+// nested within the object itself, is written as a reference (extension code
+// 6) to its INDEX. L is the number of bytes following it in both formats.
+// Readers that keep the matching table, such as InterningReader, construct
+// each object once and resolve references to it, reconstructing the shared
+// graph; other readers fail with ErrorStatus::UnexpectedEncodingType.
+//
+// Objects are identified by address and static type T: the encoding of an
+// object is that of T, not of any type derived from T. Since the sizes of
+// values are computed without regard to sharing, the graph must not have
+// cycles. The definition of an object skipped by the reader is not rebuilt, so
+// later references to it fail with ErrorStatus::ProtocolError.
+//
+
+// Returns a value that uniquely identifies type T, to check that shared
+// objects are referenced with the type they were defined with.
+template <typename T>
+const void* ObjectTypeId() {
+  static const char id = 0;
+  return &id;
+}
+
+// Writers that keep a table of shared objects provide a method to look up an
+// object, adding it to the table if possible:
+//
+//   InternResult InternObject(std::shared_ptr<const void> object,
+//                             const void* type, std::uint64_t* index);
+template <typename Writer>
+using InternObjectTest = decltype(std::declval<Writer&>().InternObject(
+    std::declval<std::shared_ptr<const void>>(), std::declval<const void*>(),
+    std::declval<std::uint64_t*>()));
+
+// Evaluates to true if Writer keeps a table of shared objects.
+template <typename Writer>
+using IsObjectInterningWriter = IsDetected<InternObjectTest, Writer>;
+
+// Readers that keep a table of shared objects provide methods to define the
+// object at an index and to find the object defined at an index, which must
+// have the same type as the definition:
+//
+//   Status<void> DefineObject(std::uint64_t index,
+//                             std::shared_ptr<void> object,
+//                             const void* type);
+//   Status<std::shared_ptr<void>> FindObject(std::uint64_t index,
+//                                            const void* type) const;
+template <typename Reader>
+using DefineObjectTest = decltype(std::declval<Reader&>().DefineObject(
+    std::uint64_t{}, std::declval<std::shared_ptr<void>>(),
+    std::declval<const void*>()));
+
+// Evaluates to true if Reader keeps a table of shared objects.
+template <typename Reader>
+using IsObjectInterningReader = IsDetected<DefineObjectTest, Reader>;
+
+// Common implementation of the pointer encodings. Pointer is the pointer type
+// and T the type of object it points to, without const qualification.
+template <typename Pointer, typename T>
+struct PointerEncoding : EncodingIO<Pointer> {
+  using Type = Pointer;
+
+  static constexpr EncodingByte Prefix(const Type& value) {
+    return value ? Encoding<T>::Prefix(*value) : EncodingByte::Nil;
+  }
+
+  static std::size_t Size(const Type& value) {
+    return value ? Encoding<T>::Size(*value)
+                 : BaseEncodingSize(EncodingByte::Nil);
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Nil || Encoding<T>::Match(prefix);
+  }
+
+  template <typename Writer>
+  static Status<void> WritePayload(EncodingByte prefix, const Type& value,
+                                   Writer* writer) {
+    if (value)
+      return Encoding<T>::WritePayload(prefix, *value, writer);
+    else
+      return {};
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                  Reader* reader) {
+    if (prefix == EncodingByte::Nil) {
+      value->reset();
+      return {};
+    }
+
+    // Decode into a new object, rather than the one currently pointed to,
+    // which may be shared with other owners.
+    std::unique_ptr<T> object{
+        EmplaceForDecode<T>([](auto... args) { return new T(args...); })};
+    auto status = Encoding<T>::ReadPayload(prefix, object.get(), reader);
+    if (!status)
+      return status;
+
+    *value = Pointer{object.release()};
+    return {};
+  }
+};
+
+template <typename T, typename Deleter>
+struct Encoding<std::unique_ptr<T, Deleter>>
+    : PointerEncoding<std::unique_ptr<T, Deleter>, std::remove_const_t<T>> {};
+
+template <typename T>
+struct Encoding<std::shared_ptr<T>>
+    : PointerEncoding<std::shared_ptr<T>, std::remove_const_t<T>> {
+  using Type = std::shared_ptr<T>;
+  using Base = PointerEncoding<Type, std::remove_const_t<T>>;
+
+  enum : SizeType { kDefinition = 5, kReference = 6 };
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return Base::Match(prefix) || prefix == EncodingByte::Extension;
+  }
+
+  template <typename Writer>
+  static Status<void> Write(const Type& value, Writer* writer) {
+    return Write(value, writer, IsObjectInterningWriter<Writer>{});
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                  Reader* reader) {
+    return ReadPayload(prefix, value, reader,
+                       IsObjectInterningReader<Reader>{});
+  }
+
+ private:
+  using U = std::remove_const_t<T>;
+
+  template <typename Writer>
+  static Status<void> Write(const Type& value, Writer* writer,
+                            std::false_type) {
+    return EncodingIO<Type>::Write(value, writer);
+  }
+
+  template <typename Writer>
+  static Status<void> Write(const Type& value, Writer* writer,
+                            std::true_type) {
+    if (!value)
+      return EncodingIO<Type>::Write(value, writer);
+
+    std::uint64_t index = 0;
+    const InternResult result =
+        writer->InternObject(value, ObjectTypeId<U>(), &index);
+    if (result == InternResult::None)
+      return EncodingIO<Type>::Write(value, writer);
+
+    auto status =
+        writer->Write(static_cast<std::uint8_t>(EncodingByte::Extension));
+    if (!status)
+      return status;
+    else if (result == InternResult::Found)
+      return WriteReference(index, writer);
+    else
+      return WriteDefinition(*value, index, writer);
+  }
+
+  template <typename Writer>
+  static Status<void> WriteReference(std::uint64_t index, Writer* writer) {
+    auto status = Encoding<SizeType>::Write(kReference, writer);
+    if (!status)
+      return status;
+
+    status = Encoding<SizeType>::Write(Encoding<SizeType>::Size(index), writer);
+    if (!status)
+      return status;
+
+    return Encoding<SizeType>::Write(index, writer);
+  }
+
+  // Writes a definition in a single pass, patching the size of the payload
+  // into a fixed-width U32 slot after writing the object, as tables do.
+  template <typename Writer>
+  static Status<void> WriteDefinition(const T& object, std::uint64_t index,
+                                      Writer* writer) {
+    auto status = Encoding<SizeType>::Write(kDefinition, writer);
+    if (!status)
+      return status;
+
+    status = writer->Write(static_cast<std::uint8_t>(EncodingByte::U32));
+    if (!status)
+      return status;
+
+    const std::size_t position = writer->size();
+    status = writer->Skip(sizeof(std::uint32_t));
+    if (!status)
+      return status;
+
+    status = Encoding<SizeType>::Write(index, writer);
+    if (!status)
+      return status;
+
+    status = Encoding<U>::Write(object, writer);
+    if (!status)
+      return status;
+
+    const std::size_t size = writer->size() - position - sizeof(std::uint32_t);
+    if (size > std::numeric_limits<std::uint32_t>::max())
+      return ErrorStatus::WriteLimitReached;
+
+    std::uint32_t size_bytes = static_cast<std::uint32_t>(size);
+    ToLittleEndian(&size_bytes, &size_bytes + 1);
+    return writer->Patch(position, &size_bytes, &size_bytes + 1);
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                  Reader* reader, std::false_type) {
+    if (prefix == EncodingByte::Extension && !Encoding<U>::Match(prefix))
+      return ErrorStatus::UnexpectedEncodingType;
+    else
+      return Base::ReadPayload(prefix, value, reader);
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                  Reader* reader, std::true_type) {
+    if (prefix != EncodingByte::Extension)
+      return Base::ReadPayload(prefix, value, reader);
+
+    SizeType code = 0;
+    auto status = Encoding<SizeType>::Read(&code, reader);
+    if (!status)
+      return status;
+    else if (code != kDefinition && code != kReference)
+      return ErrorStatus::UnexpectedEncodingType;
+
+    SizeType size = 0;
+    status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    SizeType index = 0;
+    status = Encoding<SizeType>::Read(&index, reader);
+    if (!status)
+      return status;
+
+    const std::size_t index_size = Encoding<SizeType>::Size(index);
+    if (code == kReference) {
+      if (size != index_size)
+        return ErrorStatus::InvalidContainerLength;
+
+      auto object = reader->FindObject(index, ObjectTypeId<U>());
+      if (!object)
+        return object.error();
+
+      *value = std::static_pointer_cast<U>(object.take());
+      return {};
+    } else if (size < index_size) {
+      return ErrorStatus::InvalidContainerLength;
+    }
+
+    // The object is added to the table before it is read, so that references
+    // to it from within resolve.
+    std::shared_ptr<U> object = EmplaceForDecode<U>(
+        [](auto... args) { return std::make_shared<U>(args...); });
+    status = reader->DefineObject(index, object, ObjectTypeId<U>());
+    if (!status)
+      return status;
+
+    // Read the object within the size of the definition, so that it is parsed
+    // the same as by readers that skip the definition by its size.
+    const std::size_t object_size = size - index_size;
+    BoundedReaderScope<Reader> scope{reader, object_size};
+    status = scope.status();
+    if (!status)
+      return status;
+
+    const std::size_t begin = scope.reader()->size();
+    status = Encoding<U>::Read(object.get(), scope.reader());
+    if (!status)
+      return status;
+    else if (scope.reader()->size() - begin != object_size)
+      return ErrorStatus::InvalidContainerLength;
+
+    *value = std::move(object);
+    return {};
+  }
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_POINTER_H_
@@ -0,0 +1,223 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_PRE_ENCODED_H_
+#define LIBNOP_INCLUDE_NOP_BASE_PRE_ENCODED_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/skip.h>
+#include <nop/base/utility.h>
+#include <nop/types/pre_encoded.h>
+#include <nop/utility/vector_writer.h>
+
+namespace nop {
+
+//
+// PreEncoded and Cached<T> have no format of their own: PreEncoded is the
+// encoding of the value it holds and Cached<T> is the encoding of T.
+//
+
+// Reader that records the bytes of a value as it is skipped, starting with a
+// prefix that has already been read from the underlying reader.
+template <typename Reader>
+class CapturingReader {
+ public:
+  CapturingReader(Reader* reader, EncodingByte prefix,
+                  std::vector<std::uint8_t>* data)
+      : reader_{reader}, prefix_{prefix}, data_{data} {
+    data_->clear();
+  }
+
+  Status<void> Ensure(std::size_t size) {
+    return pending_ ? Status<void>{} : reader_->Ensure(size);
+  }
+
+  Status<void> Read(std::uint8_t* byte) {
+    if (pending_) {
+      pending_ = false;
+      *byte = static_cast<std::uint8_t>(prefix_);
+    } else {
+      auto status = reader_->Read(byte);
+      if (!status)
+        return status;
+    }
+
+    data_->push_back(*byte);
+    return {};
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Read(T* begin, T* end) {
+    auto status = reader_->Read(begin, end);
+    if (!status)
+      return status;
+
+    const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(begin);
+    data_->insert(data_->end(), bytes, bytes + (end - begin) * sizeof(T));
+    return {};
+  }
+
+  // Skipped bytes are read into the capture, after checking that the
+  // underlying reader has them so that a bad length does not allocate.
+  Status<void> Skip(std::size_t padding_bytes) {
+    auto status = reader_->Ensure(padding_bytes);
+    if (!status)
+      return status;
+
+    const std::size_t size = data_->size();
+    data_->resize(size + padding_bytes);
+    return reader_->Read(data_->data() + size, data_->data() + data_->size());
+  }
+
+ private:
+  Reader* reader_;
+  EncodingByte prefix_;
+  std::vector<std::uint8_t>* data_;
+  bool pending_{true};
+};
+
+template <>
+struct Encoding<PreEncoded> : EncodingIO<PreEncoded> {
+  using Type = PreEncoded;
+
+  static EncodingByte Prefix(const Type& value) {
+    return static_cast<EncodingByte>(value.data()[0]);
+  }
+
+  static std::size_t Size(const Type& value) { return value.size(); }
+
+  // Any value may be captured; invalid prefixes are rejected while reading.
+  static constexpr bool Match(EncodingByte /*prefix*/) { return true; }
+
+  template <typename Writer>
+  static Status<void> Write(const Type& value, Writer* writer) {
+    return writer->Write(value.data(), value.data() + value.size());
+  }
+
+  template <typename Writer>
+  static Status<void> WritePayload(EncodingByte /*prefix*/, const Type& value,
+                                   Writer* writer) {
+    return writer->Write(value.data() + 1, value.data() + value.size());
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                  Reader* reader) {
+    std::vector<std::uint8_t> data = value->take();
+    CapturingReader<Reader> capturing_reader{reader, prefix, &data};
+    auto status = SkipValue(&capturing_reader);
+    if (!status)
+      return status;
+
+    *value = PreEncoded{std::move(data)};
+    return {};
+  }
+};
+
+template <typename T>
+struct Encoding<Cached<T>> : EncodingIO<Cached<T>> {
+  using Type = Cached<T>;
+
+  static constexpr EncodingByte Prefix(const Type& value) {
+    return value.cached() ? static_cast<EncodingByte>(value.encoded_[0])
+                          : Encoding<T>::Prefix(value.get());
+  }
+
+  static std::size_t Size(const Type& value) {
+    return value.cached() ? value.encoded_.size()
+                          : Encoding<T>::Size(value.get());
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return Encoding<T>::Match(prefix);
+  }
+
+  template <typename Writer>
+  static Status<void> Write(const Type& value, Writer* writer) {
+    auto status = FillCache(value);
+    if (!status)
+      return status;
+
+    const std::vector<std::uint8_t>& encoded = value.encoded_;
+    return writer->Write(encoded.data(), encoded.data() + encoded.size());
+  }
+
+  template <typename Writer>
+  static Status<void> WritePayload(EncodingByte /*prefix*/, const Type& value,
+                                   Writer* writer) {
+    auto status = FillCache(value);
+    if (!status)
+      return status;
+
+    const std::vector<std::uint8_t>& encoded = value.encoded_;
+    return writer->Write(encoded.data() + 1, encoded.data() + encoded.size());
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                  Reader* reader) {
+    return Encoding<T>::ReadPayload(prefix, &value->get(), reader);
+  }
+
+  // Encodes the value into its cache, unless it is already cached.
+  static Status<void> FillCache(const Type& value) {
+    if (value.cached())
+      return {};
+
+    VectorWriter writer{std::move(value.encoded_)};
+    auto status = writer.Prepare(Encoding<T>::Size(value.get()));
+    if (!status)
+      return status;
+
+    status = Encoding<T>::Write(value.get(), &writer);
+    if (!status)
+      return status;
+
+    value.encoded_ = writer.take();
+    return {};
+  }
+};
+
+// Returns the encoding of |value| as a PreEncoded buffer.
+template <typename T>
+Status<PreEncoded> PreEncode(const T& value) {
+  VectorWriter writer;
+  auto status = writer.Prepare(Encoding<T>::Size(value));
+  if (!status)
+    return status.error();
+
+  status = Encoding<T>::Write(value, &writer);
+  if (!status)
+    return status.error();
+
+  return PreEncoded{writer.take()};
+}
+
+// Fills the cache of |value| ahead of writing it, so that concurrent writes of
+// the value only read the cache.
+template <typename T>
+Status<void> FillCache(const Cached<T>& value) {
+  return Encoding<Cached<T>>::FillCache(value);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_PRE_ENCODED_H_
@@ -17,10 +17,14 @@
 #ifndef LIBNOP_INCLUDE_NOP_BASE_SERIALIZER_H_
 #define LIBNOP_INCLUDE_NOP_BASE_SERIALIZER_H_
 
+#include <limits>
 #include <memory>
+#include <type_traits>
 
 #include <nop/base/encoding.h>
+#include <nop/utility/counting_writer.h>
 #include <nop/status.h>
+#include <nop/traits/is_detected.h>
 
 namespace nop {
 
@@ -43,25 +47,250 @@ namespace nop {
 //   Serializer<Writer> serializer{&stream_writer};
 //   auto status = serializer.Write(data_type);
 //
+// Several values may be written with one call, which prepares the writer once
+// for their combined size and encodes them back-to-back, the same as separate
+// calls would. The values are read back with separate calls or with one call
+// taking a pointer to each value:
+//
+//   auto status = serializer.Write(header, payload);
+//   ...
+//   auto status = deserializer.Read(&header, &payload);
+//
 // Which specialization to use depends on the situation and whether the writer
 // or reader will be used in different contexts or only for serialization /
 // deserialization tasks.
 //
 
+// Test expression for writers that opt out of preparing for each value.
+// Serializer normally calls Prepare() with the encoded size of each value
+// before writing it, which requires computing the size of the value up front.
+// Writers that have no use for the size, such as writers that grow on demand or
+// write through to the output, may define a nested type named SkipPrepare to
+// avoid this cost:
+//
+//   class SomeWriter {
+//    public:
+//     using SkipPrepare = void;
+//     ...
+//   };
+//
+template <typename Writer>
+using SkipPrepareTest = typename Writer::SkipPrepare;
+
+// Evaluates to true if Writer opts out of preparing for each value.
+template <typename Writer>
+using IsSkipPrepareWriter = IsDetected<SkipPrepareTest, Writer>;
+
+// Test expression for writers that prepare for the exact size of values whose
+// Encoding<T>::Size() may overestimate it, such as values with handles; see
+// IsSizeOverestimated. Such values are measured with a dry run through
+// CountingWriter, which costs an extra encoding pass, in return for tighter
+// reservations. Writers opt in by defining a nested type named ExactPrepare:
+//
+//   class SomeWriter {
+//    public:
+//     using ExactPrepare = void;
+//     ...
+//   };
+//
+template <typename Writer>
+using ExactPrepareTest = typename Writer::ExactPrepare;
+
+// Evaluates to true if Writer prepares for exact sizes.
+template <typename Writer>
+using IsExactPrepareWriter = IsDetected<ExactPrepareTest, Writer>;
+
 // Implementation of Write method common to all Serializer specializations.
 struct SerializerCommon {
-  template <typename T, typename Writer>
-  static constexpr Status<void> Write(const T& value, Writer* writer) {
-    // Determine how much space to prepare the writer for.
-    const std::size_t size_bytes = Encoding<T>::Size(value);
-
+  // Writes |values| back-to-back, preparing the writer once for all of them.
+  template <typename Writer, typename... Ts>
+  static constexpr Status<void> Write(Writer* writer, const Ts&... values) {
     // Prepare the writer for the serialized data.
-    auto status = writer->Prepare(size_bytes);
+    auto status = Prepare(writer, IsSkipPrepareWriter<Writer>{}, values...);
     if (!status)
       return status;
 
     // Serialize the data to the writer.
-    return Encoding<T>::Write(value, writer);
+    return WriteValues(writer, values...);
+  }
+
+  // Returns the combined encoded size of |values| in bytes.
+  static constexpr std::size_t Size() { return 0; }
+
+  template <typename T, typename... Ts>
+  static constexpr std::size_t Size(const T& value, const Ts&... values) {
+    return Encoding<T>::Size(value) + Size(values...);
+  }
+
+ private:
+  template <typename Writer, typename... Ts>
+  static constexpr Status<void> Prepare(Writer* writer, std::false_type,
+                                        const Ts&... values) {
+    return PrepareSize(writer, IsExactPrepareWriter<Writer>{}, values...);
+  }
+
+  template <typename Writer, typename... Ts>
+  static constexpr Status<void> Prepare(Writer* /*writer*/, std::true_type,
+                                        const Ts&... /*values*/) {
+    return {};
+  }
+
+  template <typename Writer, typename... Ts>
+  static constexpr Status<void> PrepareSize(Writer* writer, std::false_type,
+                                            const Ts&... values) {
+    // Determine how much space to prepare the writer for.
+    const std::size_t size_bytes = Size(values...);
+    return writer->Prepare(size_bytes);
+  }
+
+  template <typename Writer, typename... Ts>
+  static Status<void> PrepareSize(Writer* writer, std::true_type,
+                                  const Ts&... values) {
+    std::size_t size_bytes = 0;
+    auto status = ExactSize(writer, &size_bytes, values...);
+    if (!status)
+      return status;
+
+    return writer->Prepare(size_bytes);
+  }
+
+  // Accumulates the sizes of |values| into |size|, measuring exactly the
+  // values whose size Encoding<T>::Size() may overestimate.
+  template <typename Writer>
+  static Status<void> ExactSize(const Writer* /*writer*/,
+                                std::size_t* /*size*/) {
+    return {};
+  }
+
+  template <typename Writer, typename T, typename... Ts>
+  static Status<void> ExactSize(const Writer* writer, std::size_t* size,
+                                const T& value, const Ts&... values) {
+    if (IsSizeOverestimated<T>::value) {
+      auto size_status = ExactEncodingSize(value, writer);
+      if (!size_status)
+        return size_status.error();
+
+      *size += size_status.get();
+    } else {
+      *size += Encoding<T>::Size(value);
+    }
+
+    return ExactSize(writer, size, values...);
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WriteValues(Writer* /*writer*/) {
+    return {};
+  }
+
+  template <typename Writer, typename T, typename... Ts>
+  static constexpr Status<void> WriteValues(Writer* writer, const T& value,
+                                            const Ts&... values) {
+    auto status = Encoding<T>::Write(value, writer);
+    if (!status)
+      return status;
+
+    return WriteValues(writer, values...);
+  }
+};
+
+// Implementation of Read method common to all Deserializer specializations.
+struct DeserializerCommon {
+  // Reads |values| in order, stopping at the first error.
+  template <typename Reader>
+  static constexpr Status<void> Read(Reader* /*reader*/) {
+    return {};
+  }
+
+  template <typename Reader, typename T, typename... Ts>
+  static constexpr Status<void> Read(Reader* reader, T* value, Ts*... values) {
+    auto status = Encoding<T>::Read(value, reader);
+    if (!status)
+      return status;
+
+    return Read(reader, values...);
+  }
+
+  // Appends up to |max_count| values read from |reader| to |values|, stopping
+  // at the end of the input. Each value is decoded in place after it is
+  // appended. Returns the number of values appended, or the error that stopped
+  // reading, in which case the values read before the error remain.
+  template <typename Reader, typename T, typename Allocator>
+  static Status<std::size_t> ReadBatch(Reader* reader,
+                                       std::vector<T, Allocator>* values,
+                                       std::size_t max_count) {
+    const std::size_t initial_size = values->size();
+    std::size_t count = 0;
+    while (count < max_count) {
+      const std::size_t before = RemainingBytes(reader);
+      EmplaceBackForDecode(values);
+      auto status = ReadNext(&values->back(), reader, IsEmptyReader<Reader>{});
+      if (!status || !status.get()) {
+        values->pop_back();
+        if (!status)
+          return status.error();
+        else
+          break;
+      }
+
+      // Reserve room for the rest of the input after the first value, assuming
+      // that the values that follow encode to the same size.
+      const std::size_t after = RemainingBytes(reader);
+      if (count++ == 0 && before > after) {
+        const std::size_t estimate = after / (before - after);
+        values->reserve(initial_size + 1 + std::min(estimate, max_count - 1));
+      }
+    }
+
+    return count;
+  }
+
+ private:
+  template <typename Reader>
+  using EmptyTest = decltype(std::declval<const Reader&>().empty());
+
+  template <typename Reader>
+  using IsEmptyReader = IsDetected<EmptyTest, Reader>;
+
+  // Returns the number of bytes left in |reader|, or zero if it does not say.
+  template <typename Reader>
+  static std::size_t RemainingBytes(const Reader* reader) {
+    return ReserveCount(std::numeric_limits<std::size_t>::max(), reader);
+  }
+
+  // Reads the next value, returning false instead if |reader| is at the end of
+  // the input.
+  template <typename T, typename Reader>
+  static Status<bool> ReadNext(T* value, Reader* reader, std::true_type) {
+    if (reader->empty())
+      return false;
+
+    auto status = Encoding<T>::Read(value, reader);
+    if (!status)
+      return status.error();
+    else
+      return true;
+  }
+
+  // Readers that cannot tell when they are empty are at the end of the input
+  // when there is not a single byte left to read.
+  template <typename T, typename Reader>
+  static Status<bool> ReadNext(T* value, Reader* reader, std::false_type) {
+    std::uint8_t prefix_byte = 0;
+    auto status = reader->Ensure(1);
+    if (status)
+      status = reader->Read(&prefix_byte);
+    if (status.error() == ErrorStatus::ReadLimitReached)
+      return false;
+    else if (!status)
+      return status.error();
+
+    const EncodingByte prefix = static_cast<EncodingByte>(prefix_byte);
+    status = EncodingIO<T>::ReadFollowing(prefix, value, reader);
+    if (!status)
+      return status.error();
+    else
+      return true;
   }
 };
 
@@ -75,17 +304,18 @@ class Serializer {
   constexpr Serializer(Serializer&&) = default;
   constexpr Serializer& operator=(Serializer&&) = default;
 
-  // Returns the encoded size of |value| in bytes. This may be an over estimate
-  // but must never be an under esitmate.
-  template <typename T>
-  constexpr std::size_t GetSize(const T& value) {
-    return Encoding<T>::Size(value);
+  // Returns the encoded size of |values| in bytes. This may be an over
+  // estimate but must never be an under esitmate.
+  template <typename T, typename... Ts>
+  constexpr std::size_t GetSize(const T& value, const Ts&... values) {
+    return SerializerCommon::Size(value, values...);
   }
 
-  // Serializes |value| to the Writer.
-  template <typename T>
-  constexpr Status<void> Write(const T& value) {
-    return SerializerCommon::Write(value, &writer_);
+  // Serializes |values| to the Writer back-to-back, preparing the writer once
+  // for all of them.
+  template <typename T, typename... Ts>
+  constexpr Status<void> Write(const T& value, const Ts&... values) {
+    return SerializerCommon::Write(&writer_, value, values...);
   }
 
   constexpr const Writer& writer() const { return writer_; }
@@ -108,17 +338,18 @@ class Serializer<Writer*> {
   constexpr Serializer(const Serializer&) = default;
   constexpr Serializer& operator=(const Serializer&) = default;
 
-  // Returns the encoded size of |value| in bytes. This may be an over estimate
-  // but must never be an under esitmate.
-  template <typename T>
-  constexpr std::size_t GetSize(const T& value) {
-    return Encoding<T>::Size(value);
+  // Returns the encoded size of |values| in bytes. This may be an over
+  // estimate but must never be an under esitmate.
+  template <typename T, typename... Ts>
+  constexpr std::size_t GetSize(const T& value, const Ts&... values) {
+    return SerializerCommon::Size(value, values...);
   }
 
-  // Serializes |value| to the Writer.
-  template <typename T>
-  constexpr Status<void> Write(const T& value) {
-    return SerializerCommon::Write(value, writer_);
+  // Serializes |values| to the Writer back-to-back, preparing the writer once
+  // for all of them.
+  template <typename T, typename... Ts>
+  constexpr Status<void> Write(const T& value, const Ts&... values) {
+    return SerializerCommon::Write(writer_, value, values...);
   }
 
   constexpr const Writer& writer() const { return *writer_; }
@@ -138,17 +369,18 @@ class Serializer<std::unique_ptr<Writer>> {
   constexpr Serializer(Serializer&&) = default;
   constexpr Serializer& operator=(Serializer&&) = default;
 
-  // Returns the encoded size of |value| in bytes. This may be an over estimate
-  // but must never be an under esitmate.
-  template <typename T>
-  constexpr std::size_t GetSize(const T& value) {
-    return Encoding<T>::Size(value);
+  // Returns the encoded size of |values| in bytes. This may be an over
+  // estimate but must never be an under esitmate.
+  template <typename T, typename... Ts>
+  constexpr std::size_t GetSize(const T& value, const Ts&... values) {
+    return SerializerCommon::Size(value, values...);
   }
 
-  // Serializes |value| to the Writer.
-  template <typename T>
-  constexpr Status<void> Write(const T& value) {
-    return SerializerCommon::Write(value, writer_.get());
+  // Serializes |values| to the Writer back-to-back, preparing the writer once
+  // for all of them.
+  template <typename T, typename... Ts>
+  constexpr Status<void> Write(const T& value, const Ts&... values) {
+    return SerializerCommon::Write(writer_.get(), value, values...);
   }
 
   constexpr const Writer& writer() const { return *writer_; }
@@ -172,10 +404,19 @@ class Deserializer {
   constexpr Deserializer(Deserializer&&) = default;
   constexpr Deserializer& operator=(Deserializer&&) = default;
 
-  // Deserializes the data from the reader.
-  template <typename T>
-  constexpr Status<void> Read(T* value) {
-    return Encoding<T>::Read(value, &reader_);
+  // Deserializes |values| from the reader in order.
+  template <typename T, typename... Ts>
+  constexpr Status<void> Read(T* value, Ts*... values) {
+    return DeserializerCommon::Read(&reader_, value, values...);
+  }
+
+  // Appends up to |max_count| values read from the reader to |values|,
+  // stopping at the end of the input. Returns the number of values appended.
+  template <typename T, typename Allocator>
+  Status<std::size_t> ReadBatch(
+      std::vector<T, Allocator>* values,
+      std::size_t max_count = std::numeric_limits<std::size_t>::max()) {
+    return DeserializerCommon::ReadBatch(&reader_, values, max_count);
   }
 
   constexpr const Reader& reader() const { return reader_; }
@@ -198,10 +439,19 @@ class Deserializer<Reader*> {
   constexpr Deserializer(const Deserializer&) = default;
   constexpr Deserializer& operator=(const Deserializer&) = default;
 
-  // Deserializes the data from the reader.
-  template <typename T>
-  constexpr Status<void> Read(T* value) {
-    return Encoding<T>::Read(value, reader_);
+  // Deserializes |values| from the reader in order.
+  template <typename T, typename... Ts>
+  constexpr Status<void> Read(T* value, Ts*... values) {
+    return DeserializerCommon::Read(reader_, value, values...);
+  }
+
+  // Appends up to |max_count| values read from the reader to |values|,
+  // stopping at the end of the input. Returns the number of values appended.
+  template <typename T, typename Allocator>
+  Status<std::size_t> ReadBatch(
+      std::vector<T, Allocator>* values,
+      std::size_t max_count = std::numeric_limits<std::size_t>::max()) {
+    return DeserializerCommon::ReadBatch(reader_, values, max_count);
   }
 
   constexpr const Reader& reader() const { return *reader_; }
@@ -221,10 +471,19 @@ class Deserializer<std::unique_ptr<Reader>> {
   constexpr Deserializer(Deserializer&&) = default;
   constexpr Deserializer& operator=(Deserializer&&) = default;
 
-  // Deserializes the data from the reader.
-  template <typename T>
-  constexpr Status<void> Read(T* value) {
-    return Encoding<T>::Read(value, reader_.get());
+  // Deserializes |values| from the reader in order.
+  template <typename T, typename... Ts>
+  constexpr Status<void> Read(T* value, Ts*... values) {
+    return DeserializerCommon::Read(reader_.get(), value, values...);
+  }
+
+  // Appends up to |max_count| values read from the reader to |values|,
+  // stopping at the end of the input. Returns the number of values appended.
+  template <typename T, typename Allocator>
+  Status<std::size_t> ReadBatch(
+      std::vector<T, Allocator>* values,
+      std::size_t max_count = std::numeric_limits<std::size_t>::max()) {
+    return DeserializerCommon::ReadBatch(reader_.get(), values, max_count);
   }
 
   constexpr const Reader& reader() const { return *reader_; }
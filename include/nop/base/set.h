@@ -18,10 +18,11 @@
 #ifndef LIBNOP_INCLUDE_NOP_BASE_SET_H_
 #define LIBNOP_INCLUDE_NOP_BASE_SET_H_
 
-#include <numeric>
 #include <set>
 #include <unordered_set>
+#include <utility>
 
+#include <nop/base/canonical.h>
 #include <nop/base/encoding.h>
 #include <nop/base/utility.h>
 
@@ -47,12 +48,35 @@ namespace nop {
 // Elements are stored as direct little-endian representation of the integral
 // value; each element is sizeof(T) bytes in size.
 //
+// Unordered sets write their elements in iteration order, or in a canonical
+// order for canonical writers (see nop/base/canonical.h): integral elements in
+// increasing order and other elements in the order of their encodings.
+//
+
+// Merges |element| into the ordered set |value| at the merge position
+// |*position|, erasing the existing elements that precede it. Writers emit the
+// elements of ordered sets in order, so new elements are inserted with a hint
+// at the merge position in amortized constant time, and existing nodes equal to
+// incoming elements are kept instead of reallocated. Elements that are out of
+// order are still inserted correctly, only without the benefit of the hint.
+template <typename Set, typename T>
+void MergeOrderedElement(T&& element, typename Set::iterator* position,
+                         Set* value) {
+  const auto less = value->key_comp();
+  while (*position != value->end() && less(**position, element))
+    *position = value->erase(*position);
+
+  if (*position != value->end() && !less(element, **position))
+    ++*position;
+  else
+    value->emplace_hint(*position, std::forward<T>(element));
+}
 
 // Specialization for set of non-integral types.
-template <typename T, typename Allocator>
-struct Encoding<std::set<T, Allocator>, EnableIfNotIntegral<T>>
-    : EncodingIO<std::set<T, Allocator>> {
-  using Type = std::set<T, Allocator>;
+template <typename T, typename Compare, typename Allocator>
+struct Encoding<std::set<T, Compare, Allocator>, EnableIfNotIntegral<T>>
+    : EncodingIO<std::set<T, Compare, Allocator>> {
+  using Type = std::set<T, Compare, Allocator>;
 
   static constexpr EncodingByte Prefix(const Type& /*value*/) {
     return EncodingByte::Array;
@@ -61,10 +85,7 @@ struct Encoding<std::set<T, Allocator>, EnableIfNotIntegral<T>>
   static constexpr std::size_t Size(const Type& value) {
     return BaseEncodingSize(Prefix(value)) +
            Encoding<SizeType>::Size(value.size()) +
-           std::accumulate(value.cbegin(), value.cend(), 0U,
-                           [](const std::size_t& sum, const T& element) {
-                             return sum + Encoding<T>::Size(element);
-                           });
+           ElementsEncodingSize<T>(value);
   }
 
   static constexpr bool Match(EncodingByte prefix) {
@@ -96,25 +117,26 @@ struct Encoding<std::set<T, Allocator>, EnableIfNotIntegral<T>>
     if (!status)
       return status;
 
-    value->clear();
+    auto position = value->begin();
     for (SizeType i = 0; i < size; i++) {
-      T element;
+      T element = MakeForDecode<T>();
       status = Encoding<T>::Read(&element, reader);
       if (!status)
         return status;
 
-      value->insert(std::move(element));
+      MergeOrderedElement(std::move(element), &position, value);
     }
 
+    value->erase(position, value->end());
     return {};
   }
 };
 
 // Specialization for set of integral types.
-template <typename T, typename Allocator>
-struct Encoding<std::set<T, Allocator>, EnableIfIntegral<T>>
-    : EncodingIO<std::set<T, Allocator>> {
-  using Type = std::set<T, Allocator>;
+template <typename T, typename Compare, typename Allocator>
+struct Encoding<std::set<T, Compare, Allocator>, EnableIfIntegral<T>>
+    : EncodingIO<std::set<T, Compare, Allocator>> {
+  using Type = std::set<T, Compare, Allocator>;
 
   static constexpr EncodingByte Prefix(const Type& /*value*/) {
     return EncodingByte::Binary;
@@ -141,7 +163,7 @@ struct Encoding<std::set<T, Allocator>, EnableIfIntegral<T>>
       return status;
 
     for (const T& element : value) {
-      status = writer->Write(&element, &element + 1);
+      status = WritePacked(&element, &element + 1, writer);
       if (!status)
         return status;
     }
@@ -168,16 +190,17 @@ struct Encoding<std::set<T, Allocator>, EnableIfIntegral<T>>
     if (!status)
       return status;
 
-    value->clear();
+    auto position = value->begin();
     for (SizeType i = 0; i < length; i++) {
       T element;
-      status = reader->Read(&element, &element + 1);
+      status = ReadPacked(&element, &element + 1, reader);
       if (!status)
         return status;
 
-      value->insert(std::move(element));
+      MergeOrderedElement(element, &position, value);
     }
 
+    value->erase(position, value->end());
     return {};
   }
 };
@@ -195,10 +218,7 @@ struct Encoding<std::unordered_set<T, Hash, KeyEqual, Allocator>, EnableIfNotInt
   static constexpr std::size_t Size(const Type& value) {
     return BaseEncodingSize(Prefix(value)) +
            Encoding<SizeType>::Size(value.size()) +
-           std::accumulate(value.cbegin(), value.cend(), 0U,
-                           [](const std::size_t& sum, const T& element) {
-                             return sum + Encoding<T>::Size(element);
-                           });
+           ElementsEncodingSize<T>(value);
   }
 
   static constexpr bool Match(EncodingByte prefix) {
@@ -213,13 +233,7 @@ struct Encoding<std::unordered_set<T, Hash, KeyEqual, Allocator>, EnableIfNotInt
     if (!status)
       return status;
 
-    for (const T& element : value) {
-      status = Encoding<T>::Write(element, writer);
-      if (!status)
-        return status;
-    }
-
-    return {};
+    return WriteElements(value, writer, IsCanonicalWriter<Writer>{});
   }
 
   template <typename Reader>
@@ -231,8 +245,9 @@ struct Encoding<std::unordered_set<T, Hash, KeyEqual, Allocator>, EnableIfNotInt
       return status;
 
     value->clear();
+    value->reserve(ReserveCount(size, reader));
     for (SizeType i = 0; i < size; i++) {
-      T element;
+      T element = MakeForDecode<T>();
       status = Encoding<T>::Read(&element, reader);
       if (!status)
         return status;
@@ -242,6 +257,31 @@ struct Encoding<std::unordered_set<T, Hash, KeyEqual, Allocator>, EnableIfNotInt
 
     return {};
   }
+
+ private:
+  struct ElementWriter {
+    template <typename Writer>
+    Status<void> operator()(const T& element, Writer* writer) const {
+      return Encoding<T>::Write(element, writer);
+    }
+  };
+
+  template <typename Writer>
+  static Status<void> WriteElements(const Type& value, Writer* writer,
+                                    std::false_type /*canonical*/) {
+    for (const T& element : value) {
+      auto status = Encoding<T>::Write(element, writer);
+      if (!status)
+        return status;
+    }
+    return {};
+  }
+
+  template <typename Writer>
+  static Status<void> WriteElements(const Type& value, Writer* writer,
+                                    std::true_type /*canonical*/) {
+    return WriteCanonicalElements(value, ElementWriter{}, writer);
+  }
 };
 
 // Specialization for unordered_set of integral types.
@@ -274,13 +314,7 @@ struct Encoding<std::unordered_set<T, Hash, KeyEqual, Allocator>, EnableIfIntegr
     if (!status)
       return status;
 
-    for (const T& element : value) {
-      status = writer->Write(&element, &element + 1);
-      if (!status)
-        return status;
-    }
-
-    return {};
+    return WriteElements(value, writer, IsCanonicalWriter<Writer>{});
   }
 
   template <typename Reader>
@@ -303,9 +337,10 @@ struct Encoding<std::unordered_set<T, Hash, KeyEqual, Allocator>, EnableIfIntegr
       return status;
 
     value->clear();
+    value->reserve(ReserveCount(length, reader));
     for (SizeType i = 0; i < length; i++) {
       T element;
-      status = reader->Read(&element, &element + 1);
+      status = ReadPacked(&element, &element + 1, reader);
       if (!status)
         return status;
 
@@ -314,6 +349,24 @@ struct Encoding<std::unordered_set<T, Hash, KeyEqual, Allocator>, EnableIfIntegr
 
     return {};
   }
+
+ private:
+  template <typename Writer>
+  static Status<void> WriteElements(const Type& value, Writer* writer,
+                                    std::false_type /*canonical*/) {
+    for (const T& element : value) {
+      auto status = WritePacked(&element, &element + 1, writer);
+      if (!status)
+        return status;
+    }
+    return {};
+  }
+
+  template <typename Writer>
+  static Status<void> WriteElements(const Type& value, Writer* writer,
+                                    std::true_type /*canonical*/) {
+    return WriteCanonicalPacked<T>(value, writer);
+  }
 };
 
 }  // namespace nop
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_SHARED_BLOB_H_
+#define LIBNOP_INCLUDE_NOP_BASE_SHARED_BLOB_H_
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/handle.h>
+#include <nop/traits/is_detected.h>
+#include <nop/types/file_handle.h>
+#include <nop/types/shared_blob.h>
+
+namespace nop {
+
+//
+// SharedBlob encoding formats:
+//
+// Inline blobs:
+// +-----+---------+-----//-----+
+// | BIN | INT64:N | N BYTES    |
+// +-----+---------+-----//-----+
+//
+// Shared blobs:
+// +-----+---+-----+------+-----------+--------------+--------------+
+// | ARY | 3 | HND | TYPE | INT64:REF | INT64:OFFSET | INT64:LENGTH |
+// +-----+---+-----+------+-----------+--------------+--------------+
+//
+// The inline format is the same as std::vector<std::uint8_t>, so an inline
+// blob may be read as a byte vector and the reverse. The handle of a shared
+// blob refers to a shared memory segment of at least OFFSET + LENGTH bytes.
+//
+// Only blobs allocated locally are written in the shared format. Blobs mapped
+// from another process have no handle and are written inline, which copies
+// their bytes when they are forwarded.
+//
+
+template <typename Writer>
+using PushFileHandleTest = decltype(std::declval<Writer&>()
+                                        .template PushHandle<FileHandle>(
+                                            std::declval<const FileHandle&>()));
+
+template <typename Reader>
+using GetFileHandleTest =
+    decltype(std::declval<Reader&>().template GetHandle<FileHandle>(
+        std::declval<HandleReference>()));
+
+template <>
+struct Encoding<SharedBlob> : EncodingIO<SharedBlob> {
+  using Type = SharedBlob;
+
+  enum : SizeType { kSharedMemberCount = 3 };
+
+  static EncodingByte Prefix(const Type& value) {
+    return value.handle() ? EncodingByte::Array : EncodingByte::Binary;
+  }
+
+  static std::size_t Size(const Type& value) {
+    if (value.handle()) {
+      return BaseEncodingSize(EncodingByte::Array) +
+             Encoding<SizeType>::Size(kSharedMemberCount) +
+             Encoding<FileHandle>::Size(value.handle()) +
+             Encoding<std::uint64_t>::Size(value.offset()) +
+             Encoding<std::uint64_t>::Size(value.size());
+    } else {
+      return BaseEncodingSize(EncodingByte::Binary) +
+             Encoding<SizeType>::Size(value.size()) + value.size();
+    }
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Binary || prefix == EncodingByte::Array;
+  }
+
+  template <typename Writer>
+  static Status<void> WritePayload(EncodingByte prefix, const Type& value,
+                                   Writer* writer) {
+    if (prefix == EncodingByte::Array) {
+      return WriteShared(value, writer,
+                         IsDetected<PushFileHandleTest, Writer>{});
+    }
+
+    auto status = Encoding<SizeType>::Write(value.size(), writer);
+    if (!status)
+      return status;
+
+    return writer->Write(value.begin(), value.end());
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                  Reader* reader) {
+    if (prefix == EncodingByte::Array) {
+      return ReadShared(value, reader,
+                        IsDetected<GetFileHandleTest, Reader>{});
+    }
+
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    // Make sure the reader has enough data to fulfill the requested size as a
+    // defense against abusive or erroneous sizes.
+    status = reader->Ensure(size);
+    if (!status)
+      return status;
+
+    std::vector<std::uint8_t> data(size);
+    status = reader->Read(data.data(), data.data() + size);
+    if (!status)
+      return status;
+
+    *value = SharedBlob{std::move(data)};
+    return {};
+  }
+
+ private:
+  // Shared blobs require a writer that supports handles.
+  template <typename Writer>
+  static Status<void> WriteShared(const Type& /*value*/, Writer* /*writer*/,
+                                  std::false_type) {
+    return ErrorStatus::UnexpectedHandleType;
+  }
+
+  template <typename Writer>
+  static Status<void> WriteShared(const Type& value, Writer* writer,
+                                  std::true_type) {
+    auto status = Encoding<SizeType>::Write(kSharedMemberCount, writer);
+    if (!status)
+      return status;
+
+    status = Encoding<FileHandle>::Write(value.handle(), writer);
+    if (!status)
+      return status;
+
+    status = Encoding<std::uint64_t>::Write(value.offset(), writer);
+    if (!status)
+      return status;
+
+    return Encoding<std::uint64_t>::Write(value.size(), writer);
+  }
+
+  template <typename Reader>
+  static Status<void> ReadShared(Type* /*value*/, Reader* /*reader*/,
+                                 std::false_type) {
+    return ErrorStatus::UnexpectedHandleType;
+  }
+
+  template <typename Reader>
+  static Status<void> ReadShared(Type* value, Reader* reader, std::true_type) {
+    SizeType count = 0;
+    auto status = Encoding<SizeType>::Read(&count, reader);
+    if (!status)
+      return status;
+    else if (count != kSharedMemberCount)
+      return ErrorStatus::InvalidMemberCount;
+
+    FileHandle handle;
+    status = Encoding<FileHandle>::Read(&handle, reader);
+    if (!status)
+      return status;
+
+    // The blob owns the received handle from here on.
+    UniqueFileHandle unique_handle{handle.get()};
+
+    std::uint64_t offset = 0;
+    status = Encoding<std::uint64_t>::Read(&offset, reader);
+    if (!status)
+      return status;
+
+    std::uint64_t size = 0;
+    status = Encoding<std::uint64_t>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    auto blob = SharedBlob::Map(std::move(unique_handle), offset, size);
+    if (!blob)
+      return blob.error();
+
+    *value = blob.take();
+    return {};
+  }
+};
+
+// The handles of shared blobs are overestimated like other handles.
+template <>
+struct IsSizeOverestimated<SharedBlob> : std::true_type {};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_SHARED_BLOB_H_
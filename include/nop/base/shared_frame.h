@@ -0,0 +1,122 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_SHARED_FRAME_H_
+#define LIBNOP_INCLUDE_NOP_BASE_SHARED_FRAME_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/pre_encoded.h>
+#include <nop/base/skip.h>
+#include <nop/types/shared_frame.h>
+#include <nop/utility/vector_writer.h>
+
+namespace nop {
+
+//
+// SharedFrame has no format of its own: it is the encoding of the value it
+// holds, like PreEncoded.
+//
+
+// Writers may provide a method to take a reference to a frame instead of
+// copying its bytes:
+//
+//   Status<void> WriteFrame(const SharedFrame& frame);
+template <typename Writer>
+using WriteFrameTest = decltype(
+    std::declval<Writer&>().WriteFrame(std::declval<const SharedFrame&>()));
+
+// Evaluates to true if Writer writes frames without copying them.
+template <typename Writer>
+using IsFrameWriter = IsDetected<WriteFrameTest, Writer>;
+
+template <>
+struct Encoding<SharedFrame> : EncodingIO<SharedFrame> {
+  using Type = SharedFrame;
+
+  static EncodingByte Prefix(const Type& value) {
+    return static_cast<EncodingByte>(value.data()[0]);
+  }
+
+  static std::size_t Size(const Type& value) { return value.size(); }
+
+  // Any value may be captured; invalid prefixes are rejected while reading.
+  static constexpr bool Match(EncodingByte /*prefix*/) { return true; }
+
+  template <typename Writer>
+  static Status<void> Write(const Type& value, Writer* writer) {
+    return WriteFrame(value, writer, IsFrameWriter<Writer>{});
+  }
+
+  template <typename Writer>
+  static Status<void> WritePayload(EncodingByte /*prefix*/, const Type& value,
+                                   Writer* writer) {
+    return writer->Write(value.data() + 1, value.data() + value.size());
+  }
+
+  // Other frames may share the bytes of |value|, so the capture always goes
+  // to a new buffer.
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                  Reader* reader) {
+    std::vector<std::uint8_t> data;
+    CapturingReader<Reader> capturing_reader{reader, prefix, &data};
+    auto status = SkipValue(&capturing_reader);
+    if (!status)
+      return status;
+
+    *value = SharedFrame{std::move(data)};
+    return {};
+  }
+
+ private:
+  template <typename Writer>
+  static Status<void> WriteFrame(const Type& value, Writer* writer,
+                                 std::true_type /*frame_writer*/) {
+    return writer->WriteFrame(value);
+  }
+
+  template <typename Writer>
+  static Status<void> WriteFrame(const Type& value, Writer* writer,
+                                 std::false_type /*frame_writer*/) {
+    return writer->Write(value.data(), value.data() + value.size());
+  }
+};
+
+// Encodes |value| once into a frame that may be written to any number of
+// channels.
+template <typename T>
+Status<SharedFrame> EncodeFrame(const T& value) {
+  VectorWriter writer;
+  auto status = writer.Prepare(Encoding<T>::Size(value));
+  if (!status)
+    return status.error();
+
+  status = Encoding<T>::Write(value, &writer);
+  if (!status)
+    return status.error();
+
+  return SharedFrame{writer.take()};
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_SHARED_FRAME_H_
@@ -0,0 +1,306 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_SKIP_H_
+#define LIBNOP_INCLUDE_NOP_BASE_SKIP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include <nop/base/encoding.h>
+#include <nop/base/interned_string.h>
+#include <nop/status.h>
+#include <nop/utility/pedantic_buffer_reader.h>
+
+namespace nop {
+
+//
+// Schema-less skipping of encoded values. SkipValue() advances a reader past
+// one encoded value of any type using only the prefixes in the input, without
+// knowing the C++ type of the value. This supports forwarding or filtering
+// messages without materializing them, or ignoring values that a reader does
+// not understand.
+//
+// Payloads are skipped with the reader's Skip() method wherever their size is
+// known from the prefix: numbers, strings, binary containers, extensions, and
+// table entries are jumped over in one step without examining their bytes.
+// Only arrays, maps, structures, and variants require scanning their elements.
+//
+// Nested values are tracked with a single count of values left to skip rather
+// than by recursion, so deeply nested input cannot exhaust the stack.
+//
+
+// Implementation details of SkipValue.
+struct SkipValueCommon {
+  template <typename Reader>
+  static Status<void> ReadPrefix(EncodingByte* prefix, Reader* reader) {
+    std::uint8_t prefix_byte = 0;
+    auto status = reader->Read(&prefix_byte);
+    if (!status)
+      return status;
+
+    *prefix = static_cast<EncodingByte>(prefix_byte);
+    return {};
+  }
+
+  // Skips an integer of any class, such as a handle type or error code.
+  template <typename Reader>
+  static Status<void> SkipInteger(Reader* reader) {
+    EncodingByte prefix;
+    auto status = ReadPrefix(&prefix, reader);
+    if (!status)
+      return status;
+
+    if (prefix <= EncodingByte::PositiveFixIntMax ||
+        prefix >= EncodingByte::NegativeFixIntMin) {
+      return {};
+    } else if (prefix >= EncodingByte::U8 && prefix <= EncodingByte::I64) {
+      return SkipBytes(BaseEncodingSize(prefix) - 1, reader);
+    } else {
+      return ErrorStatus::UnexpectedEncodingType;
+    }
+  }
+
+  template <typename Reader>
+  static Status<void> SkipBytes(SizeType size, Reader* reader) {
+    if (size > std::numeric_limits<std::size_t>::max())
+      return ErrorStatus::ReadLimitReached;
+
+    auto status = reader->Ensure(static_cast<std::size_t>(size));
+    if (!status)
+      return status;
+
+    return reader->Skip(static_cast<std::size_t>(size));
+  }
+
+  // Skips a sized payload, such as the contents of a string.
+  template <typename Reader>
+  static Status<void> SkipPayload(Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    return SkipBytes(size, reader);
+  }
+
+  // Skips an extension: the code is followed by a sized payload.
+  template <typename Reader>
+  static Status<void> SkipExtension(Reader* reader) {
+    return SkipExtension(reader, IsInterningReader<Reader>{});
+  }
+
+  template <typename Reader>
+  static Status<void> SkipExtension(Reader* reader, std::false_type) {
+    auto status = SkipInteger(reader);
+    if (!status)
+      return status;
+
+    return SkipPayload(reader);
+  }
+
+  // Interned string definitions are read into the table of interning readers,
+  // so that references to them following the skipped value resolve.
+  template <typename Reader>
+  static Status<void> SkipExtension(Reader* reader, std::true_type) {
+    SizeType code = 0;
+    auto status = Encoding<SizeType>::Read(&code, reader);
+    if (!status)
+      return status;
+
+    SizeType size = 0;
+    status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+    else if (code != InternedString::kDefinition)
+      return SkipBytes(size, reader);
+
+    auto string = InternedString::ReadPayload(code, size, reader);
+    if (!string)
+      return string.error();
+    else
+      return {};
+  }
+
+  // Skips the entries of a table, which are sized so that they do not need to
+  // be scanned.
+  template <typename Reader>
+  static Status<void> SkipTable(Reader* reader) {
+    std::uint64_t hash = 0;
+    auto status = Encoding<std::uint64_t>::Read(&hash, reader);
+    if (!status)
+      return status;
+
+    SizeType count = 0;
+    status = Encoding<SizeType>::Read(&count, reader);
+    if (!status)
+      return status;
+
+    for (SizeType i = 0; i < count; i++) {
+      std::uint64_t id = 0;
+      status = Encoding<std::uint64_t>::Read(&id, reader);
+      if (!status)
+        return status;
+
+      status = SkipPayload(reader);
+      if (!status)
+        return status;
+    }
+
+    return {};
+  }
+
+  // Adds the elements of a container to the count of values to skip.
+  // Containers must have at least one byte of input per element.
+  template <typename Reader>
+  static Status<void> AddElements(SizeType* pending, SizeType multiplier,
+                                  Reader* reader) {
+    SizeType count = 0;
+    auto status = Encoding<SizeType>::Read(&count, reader);
+    if (!status)
+      return status;
+
+    const SizeType max = std::numeric_limits<SizeType>::max();
+    if (count > max / multiplier || count * multiplier > max - *pending)
+      return ErrorStatus::InvalidContainerLength;
+
+    count *= multiplier;
+    if (count > std::numeric_limits<std::size_t>::max())
+      return ErrorStatus::ReadLimitReached;
+
+    status = reader->Ensure(static_cast<std::size_t>(count));
+    if (!status)
+      return status;
+
+    *pending += count;
+    return {};
+  }
+
+  // Skips the payload following |prefix|, adding any nested values that
+  // remain to be skipped to |pending|.
+  template <typename Reader>
+  static Status<void> SkipPayloadOf(EncodingByte prefix, SizeType* pending,
+                                    Reader* reader) {
+    switch (prefix) {
+      case EncodingByte::U8:
+      case EncodingByte::I8:
+      case EncodingByte::U16:
+      case EncodingByte::I16:
+      case EncodingByte::U32:
+      case EncodingByte::I32:
+      case EncodingByte::F32:
+      case EncodingByte::U64:
+      case EncodingByte::I64:
+      case EncodingByte::F64:
+        return SkipBytes(BaseEncodingSize(prefix) - 1, reader);
+
+      case EncodingByte::Binary:
+      case EncodingByte::String:
+        return SkipPayload(reader);
+
+      case EncodingByte::Array:
+      case EncodingByte::Structure:
+        return AddElements(pending, 1, reader);
+
+      case EncodingByte::Map:
+        return AddElements(pending, 2, reader);
+
+      case EncodingByte::Variant: {
+        // The index is followed by the value, or nil when empty.
+        auto status = SkipInteger(reader);
+        if (status)
+          ++*pending;
+        return status;
+      }
+
+      case EncodingByte::Handle: {
+        auto status = SkipInteger(reader);
+        if (!status)
+          return status;
+
+        return SkipInteger(reader);
+      }
+
+      case EncodingByte::Error:
+        return SkipInteger(reader);
+
+      case EncodingByte::Table:
+        return SkipTable(reader);
+
+      case EncodingByte::Extension:
+        return SkipExtension(reader);
+
+      case EncodingByte::Nil:
+        return {};
+
+      default:
+        if (prefix > EncodingByte::PositiveFixIntMax &&
+            prefix < EncodingByte::NegativeFixIntMin) {
+          return ErrorStatus::UnexpectedEncodingType;
+        } else {
+          return {};
+        }
+    }
+  }
+};
+
+// Advances |reader| past the payload of a value whose prefix has already been
+// read.
+template <typename Reader>
+Status<void> SkipValuePayload(EncodingByte prefix, Reader* reader) {
+  using Common = SkipValueCommon;
+
+  SizeType pending = 0;
+  auto status = Common::SkipPayloadOf(prefix, &pending, reader);
+  while (status && pending > 0) {
+    pending--;
+
+    status = Common::ReadPrefix(&prefix, reader);
+    if (status)
+      status = Common::SkipPayloadOf(prefix, &pending, reader);
+  }
+
+  return status;
+}
+
+// Advances |reader| past the next encoded value.
+template <typename Reader>
+Status<void> SkipValue(Reader* reader) {
+  EncodingByte prefix;
+  auto status = SkipValueCommon::ReadPrefix(&prefix, reader);
+  if (!status)
+    return status;
+
+  return SkipValuePayload(prefix, reader);
+}
+
+// Returns the encoded length of the value at the start of |data|, which may
+// be followed by other data. Returns ErrorStatus::ReadLimitReached if the
+// value is not complete within |size| bytes.
+inline Status<std::size_t> EncodedLength(const void* data, std::size_t size) {
+  PedanticBufferReader reader{data, size};
+  auto status = SkipValue(&reader);
+  if (!status)
+    return status.error();
+
+  return size - reader.remaining();
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_SKIP_H_
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_SLOT_H_
+#define LIBNOP_INCLUDE_NOP_BASE_SLOT_H_
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include <nop/base/encoding.h>
+#include <nop/base/enum.h>
+#include <nop/traits/is_detected.h>
+#include <nop/types/slot.h>
+
+namespace nop {
+
+//
+// Slot<T> encoding format matches the full width encoding of integral type T:
+// the widest prefix of T followed by all sizeof(T) bytes of the value.
+//
+// +-----+---------+
+// | INT | PAYLOAD |
+// +-----+---------+
+//
+// Writers that track the positions of slots, such as the writer of
+// MessageTemplate, define a RecordSlot() method, which is called with the
+// prefix of each slot just before its payload is written.
+//
+
+// Test expression for writers that record the positions of slots.
+template <typename Writer>
+using RecordSlotTest =
+    decltype(std::declval<Writer&>().RecordSlot(EncodingByte{}));
+
+// Evaluates to true if Writer records the positions of slots.
+template <typename Writer>
+using IsSlotRecordingWriter = IsDetected<RecordSlotTest, Writer>;
+
+template <typename T>
+struct Encoding<Slot<T>> : EncodingIO<Slot<T>> {
+  static_assert(FixedWidthInteger<T>::value,
+                "Slot<T> requires a sized integer or enum type T.");
+
+  using Type = Slot<T>;
+  using Integer = typename FixedWidthInteger<T>::Type;
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return FixedWidthInteger<T>::Prefix;
+  }
+
+  static constexpr std::size_t Size(const Type& /*value*/) {
+    return 1 + sizeof(Integer);
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return Encoding<T>::Match(prefix);
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte prefix,
+                                             const Type& value,
+                                             Writer* writer) {
+    auto status =
+        RecordSlot(prefix, writer, IsSlotRecordingWriter<Writer>{});
+    if (!status)
+      return status;
+
+    return EncodingIO<Type>::template WriteAs<Integer>(
+        static_cast<Integer>(value.get()), writer);
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                            Reader* reader) {
+    return Encoding<T>::ReadPayload(prefix, &value->get(), reader);
+  }
+
+ private:
+  template <typename Writer>
+  static constexpr Status<void> RecordSlot(EncodingByte prefix, Writer* writer,
+                                           std::true_type) {
+    return writer->RecordSlot(prefix);
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> RecordSlot(EncodingByte /*prefix*/,
+                                           Writer* /*writer*/,
+                                           std::false_type) {
+    return {};
+  }
+};
+
+template <typename T>
+struct FixedEncodingSize<Slot<T>> : std::true_type {
+  enum : std::size_t { Size = 1 + sizeof(T) };
+};
+
+template <typename T>
+struct MaxEncodingSize<Slot<T>> : std::true_type {
+  enum : std::size_t { Size = 1 + sizeof(T) };
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_SLOT_H_
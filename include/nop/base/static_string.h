@@ -0,0 +1,94 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_STATIC_STRING_H_
+#define LIBNOP_INCLUDE_NOP_BASE_STATIC_STRING_H_
+
+#include <cstddef>
+
+#include <nop/base/encoding.h>
+#include <nop/types/static_string.h>
+
+namespace nop {
+
+//
+// BasicStaticString<CharType, Capacity> encoding format is the same as
+// std::basic_string:
+//
+// +-----+---------+---//----+
+// | STR | INT64:N | N BYTES |
+// +-----+---------+---//----+
+//
+
+template <typename CharType, std::size_t Capacity>
+struct Encoding<BasicStaticString<CharType, Capacity>>
+    : EncodingIO<BasicStaticString<CharType, Capacity>> {
+  using Type = BasicStaticString<CharType, Capacity>;
+  enum : std::size_t { CharSize = sizeof(CharType) };
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::String;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    const std::size_t length_bytes = value.length() * CharSize;
+    return BaseEncodingSize(Prefix(value)) +
+           Encoding<SizeType>::Size(length_bytes) + length_bytes;
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::String;
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte /*prefix*/,
+                                             const Type& value,
+                                             Writer* writer) {
+    auto status = Encoding<SizeType>::Write(value.length() * CharSize, writer);
+    if (!status)
+      return status;
+
+    return writer->Write(value.begin(), value.end());
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
+                                            Type* value, Reader* reader) {
+    SizeType length_bytes = 0;
+    auto status = Encoding<SizeType>::Read(&length_bytes, reader);
+    if (!status)
+      return status;
+    else if (length_bytes % CharSize != 0 || length_bytes / CharSize > Capacity)
+      return ErrorStatus::InvalidStringLength;
+
+    const SizeType size = length_bytes / CharSize;
+    value->resize(size);
+    return reader->Read(value->begin(), value->end());
+  }
+};
+
+// Static strings are bounded by their capacity.
+template <typename CharType, std::size_t Capacity>
+struct MaxEncodingSize<BasicStaticString<CharType, Capacity>> : std::true_type {
+  enum : std::size_t {
+    Size = BaseEncodingSize(EncodingByte::String) +
+           MaxEncodingSize<SizeType>::Size + Capacity * sizeof(CharType)
+  };
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_STATIC_STRING_H_
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_STATIC_VECTOR_H_
+#define LIBNOP_INCLUDE_NOP_BASE_STATIC_VECTOR_H_
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+#include <nop/base/array.h>
+#include <nop/base/encoding.h>
+#include <nop/base/utility.h>
+#include <nop/types/static_vector.h>
+
+namespace nop {
+
+//
+// StaticVector<T, Capacity> and SmallVector<T, Capacity> encoding formats are
+// the same as std::vector<T>:
+//
+// +-----+---------+-----//-----+
+// | ARY | INT64:N | N ELEMENTS |
+// +-----+---------+-----//-----+
+//
+// For packable (integral, float, and double) types:
+//
+// +-----+---------+---//----+
+// | BIN | INT64:L | L BYTES |
+// +-----+---------+---//----+
+//
+// Where L = N * sizeof(T).
+//
+// Vectors of floating point and enum flags types also accept the ARY format
+// when reading.
+// Elements already in the vector are decoded in place, so that nested elements
+// keep their storage across messages.
+//
+
+// Reads |size| individually encoded elements of type T into |value|, decoding
+// over the elements already in the vector before appending new ones. Only
+// reserves as many elements as could fit in the bytes remaining in the reader,
+// to prevent abuse from very large size values.
+template <typename T, typename Type, typename Reader>
+constexpr Status<void> ReadVectorElements(SizeType size, Type* value,
+                                          Reader* reader) {
+  if (value->size() > size)
+    value->resize(size);
+  value->reserve(ReserveCount(size, reader));
+
+  for (SizeType i = 0; i < size; i++) {
+    if (i == value->size())
+      EmplaceBackForDecode(value);
+
+    auto status = Encoding<T>::Read(&(*value)[i], reader);
+    if (!status)
+      return status;
+  }
+
+  return {};
+}
+
+// Common encoding for vectors with inline storage holding at most MaxLength
+// elements of type T.
+template <typename Type, typename T, std::size_t MaxLength,
+          typename Enabled = void>
+struct InlineVectorEncoding;
+
+// Specialization for non-packable types.
+template <typename Type, typename T, std::size_t MaxLength>
+struct InlineVectorEncoding<Type, T, MaxLength, EnableIfNotPackable<T>>
+    : EncodingIO<Type> {
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::Array;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    return BaseEncodingSize(Prefix(value)) +
+           Encoding<SizeType>::Size(value.size()) +
+           ElementsEncodingSize<T>(value);
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Array;
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte /*prefix*/,
+                                             const Type& value,
+                                             Writer* writer) {
+    auto status = Encoding<SizeType>::Write(value.size(), writer);
+    if (!status)
+      return status;
+
+    for (const T& element : value) {
+      status = Encoding<T>::Write(element, writer);
+      if (!status)
+        return status;
+    }
+
+    return {};
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
+                                            Type* value, Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+    else if (size > MaxLength)
+      return ErrorStatus::InvalidContainerLength;
+
+    return ReadVectorElements<T>(size, value, reader);
+  }
+};
+
+// Specialization for packable types.
+template <typename Type, typename T, std::size_t MaxLength>
+struct InlineVectorEncoding<Type, T, MaxLength, EnableIfPackable<T>>
+    : EncodingIO<Type> {
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::Binary;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    const SizeType size = value.size() * sizeof(T);
+    return BaseEncodingSize(Prefix(value)) + Encoding<SizeType>::Size(size) +
+           size;
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Binary ||
+           (HasLegacyArrayFormat<T>::value && prefix == EncodingByte::Array);
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte /*prefix*/,
+                                             const Type& value,
+                                             Writer* writer) {
+    const SizeType length = value.size();
+    auto status = Encoding<SizeType>::Write(length * sizeof(T), writer);
+    if (!status)
+      return status;
+
+    return WritePacked(value.data(), value.data() + length, writer);
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                            Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status) {
+      return status;
+    } else if (prefix == EncodingByte::Array) {
+      if (size > MaxLength)
+        return ErrorStatus::InvalidContainerLength;
+
+      return ReadVectorElements<T>(size, value, reader);
+    } else if (size % sizeof(T) != 0 || size / sizeof(T) > MaxLength) {
+      return ErrorStatus::InvalidContainerLength;
+    }
+
+    // Make sure the reader has enough data to fulfill the requested size as a
+    // defense against abusive or erroneous vector sizes.
+    status = reader->Ensure(size);
+    if (!status)
+      return status;
+
+    const SizeType length = size / sizeof(T);
+    value->resize(length);
+    return ReadPacked(value->data(), value->data() + length, reader);
+  }
+};
+
+template <typename T, std::size_t Capacity>
+struct Encoding<StaticVector<T, Capacity>>
+    : InlineVectorEncoding<StaticVector<T, Capacity>, T, Capacity> {};
+
+template <typename T, std::size_t Capacity>
+struct Encoding<SmallVector<T, Capacity>>
+    : InlineVectorEncoding<SmallVector<T, Capacity>, T,
+                           std::numeric_limits<std::size_t>::max()> {};
+
+// Static vectors are bounded by their capacity, the same as arrays of the
+// element type.
+template <typename T, std::size_t Capacity>
+struct MaxEncodingSize<StaticVector<T, Capacity>>
+    : MaxEncodingSize<std::array<T, Capacity>> {};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_STATIC_VECTOR_H_
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_STREAMING_PAYLOAD_H_
+#define LIBNOP_INCLUDE_NOP_BASE_STREAMING_PAYLOAD_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/utility.h>
+#include <nop/types/streaming_payload.h>
+
+namespace nop {
+
+//
+// StreamingBinary encoding format:
+//
+// +-----+---------+---//----+
+// | BIN | INT64:N | N BYTES |
+// +-----+---------+---//----+
+//
+// StreamingString encoding format:
+//
+// +-----+---------+---//----+
+// | STR | INT64:N | N BYTES |
+// +-----+---------+---//----+
+//
+// These are the same formats as std::vector<std::uint8_t> and std::string. The
+// bytes are produced by the source of the payload while it is written and
+// passed to the sink of the payload while it is read, in chunks of at most the
+// chunk size of the payload.
+//
+
+template <EncodingByte PayloadPrefix>
+struct Encoding<StreamingPayload<PayloadPrefix>>
+    : EncodingIO<StreamingPayload<PayloadPrefix>> {
+  using Type = StreamingPayload<PayloadPrefix>;
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return PayloadPrefix;
+  }
+
+  static std::size_t Size(const Type& value) {
+    return BaseEncodingSize(PayloadPrefix) +
+           Encoding<SizeType>::Size(value.size()) + value.size();
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == PayloadPrefix;
+  }
+
+  template <typename Writer>
+  static Status<void> WritePayload(EncodingByte /*prefix*/, const Type& value,
+                                   Writer* writer) {
+    if (value.size() > 0 && !value.source())
+      return ErrorStatus::InvalidContainerLength;
+
+    auto status = Encoding<SizeType>::Write(value.size(), writer);
+    if (!status)
+      return status;
+
+    return WriteChunks(value, writer, IsReservingChunks<Writer>{});
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte /*prefix*/, Type* value,
+                                  Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    // Make sure the reader has enough data to fulfill the requested size as a
+    // defense against abusive or erroneous sizes.
+    status = reader->Ensure(size);
+    if (!status)
+      return status;
+
+    value->set_size(size);
+    if (!value->sink())
+      return reader->Skip(size);
+    else
+      return ReadChunks(value, reader, IsContiguousReader<Reader>{});
+  }
+
+ private:
+  // Chunks are filled directly in the output of writers that support reserved
+  // writes, unless they opt out of them.
+  template <typename Writer>
+  using IsReservingChunks =
+      std::integral_constant<bool, IsReservingWriter<Writer>::value &&
+                                       !IsSkipStagingWriter<Writer>::value>;
+
+  static std::size_t ChunkSize(const Type& value, std::uint64_t remaining) {
+    return static_cast<std::size_t>(
+        std::min<std::uint64_t>(remaining, value.chunk_size()));
+  }
+
+  // Fills chunks of the payload in a buffer and writes them to the writer.
+  template <typename Writer>
+  static Status<void> WriteChunks(const Type& value, Writer* writer,
+                                  std::false_type /*reserving*/) {
+    std::vector<std::uint8_t> buffer(ChunkSize(value, value.size()));
+    for (std::uint64_t remaining = value.size(); remaining > 0;) {
+      const std::size_t chunk_size = ChunkSize(value, remaining);
+      auto status = WriteBufferedChunk(value, chunk_size, &buffer, writer);
+      if (!status)
+        return status;
+
+      remaining -= chunk_size;
+    }
+    return {};
+  }
+
+  // Fills chunks of the payload directly in output reserved from the writer,
+  // falling back to a buffer when a reservation fails.
+  template <typename Writer>
+  static Status<void> WriteChunks(const Type& value, Writer* writer,
+                                  std::true_type /*reserving*/) {
+    std::vector<std::uint8_t> buffer;
+    for (std::uint64_t remaining = value.size(); remaining > 0;) {
+      const std::size_t chunk_size = ChunkSize(value, remaining);
+      auto reservation = writer->Reserve(chunk_size);
+      if (reservation) {
+        auto status = value.source()(reservation.get(), chunk_size);
+        if (!status)
+          return status;
+
+        writer->Commit(chunk_size);
+      } else {
+        auto status = WriteBufferedChunk(value, chunk_size, &buffer, writer);
+        if (!status)
+          return status;
+      }
+
+      remaining -= chunk_size;
+    }
+    return {};
+  }
+
+  template <typename Writer>
+  static Status<void> WriteBufferedChunk(const Type& value,
+                                         std::size_t chunk_size,
+                                         std::vector<std::uint8_t>* buffer,
+                                         Writer* writer) {
+    buffer->resize(chunk_size);
+    auto status = value.source()(buffer->data(), chunk_size);
+    if (!status)
+      return status;
+
+    return writer->Write(buffer->data(), buffer->data() + chunk_size);
+  }
+
+  // Reads chunks of the payload into a buffer and passes them to the sink.
+  template <typename Reader>
+  static Status<void> ReadChunks(Type* value, Reader* reader,
+                                 std::false_type /*contiguous*/) {
+    std::vector<std::uint8_t> buffer(ChunkSize(*value, value->size()));
+    for (std::uint64_t remaining = value->size(); remaining > 0;) {
+      const std::size_t chunk_size = ChunkSize(*value, remaining);
+      auto status = reader->Read(buffer.data(), buffer.data() + chunk_size);
+      if (!status)
+        return status;
+
+      status = value->sink()(buffer.data(), chunk_size);
+      if (!status)
+        return status;
+
+      remaining -= chunk_size;
+    }
+    return {};
+  }
+
+  // Passes chunks of the payload to the sink directly from the input.
+  template <typename Reader>
+  static Status<void> ReadChunks(Type* value, Reader* reader,
+                                 std::true_type /*contiguous*/) {
+    for (std::uint64_t remaining = value->size(); remaining > 0;) {
+      const std::size_t chunk_size = ChunkSize(*value, remaining);
+      auto data = reader->Borrow(chunk_size);
+      if (!data)
+        return data.error();
+
+      auto status = value->sink()(data.get(), chunk_size);
+      if (!status)
+        return status;
+
+      remaining -= chunk_size;
+    }
+    return {};
+  }
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_STREAMING_PAYLOAD_H_
@@ -18,8 +18,10 @@
 #define LIBNOP_INCLUDE_NOP_BASE_STRING_H_
 
 #include <string>
+#include <type_traits>
 
 #include <nop/base/encoding.h>
+#include <nop/base/interned_string.h>
 
 namespace nop {
 
@@ -30,6 +32,9 @@ namespace nop {
 // | STR | INT64:N | N BYTES |
 // +-----+---------+---//----+
 //
+// Writers and readers that keep a table of interned strings also write and
+// read the interned string formats described in nop/base/interned_string.h.
+//
 
 template <typename CharType, typename Traits, typename Allocator>
 struct Encoding<std::basic_string<CharType, Traits, Allocator>>
@@ -48,7 +53,13 @@ struct Encoding<std::basic_string<CharType, Traits, Allocator>>
   }
 
   static constexpr bool Match(EncodingByte prefix) {
-    return prefix == EncodingByte::String;
+    return prefix == EncodingByte::String ||
+           prefix == EncodingByte::Extension;
+  }
+
+  template <typename Writer>
+  static Status<void> Write(const Type& value, Writer* writer) {
+    return Write(value, writer, IsInterningWriter<Writer>{});
   }
 
   template <typename Writer>
@@ -58,18 +69,21 @@ struct Encoding<std::basic_string<CharType, Traits, Allocator>>
     const std::size_t length = value.length();
     const std::size_t length_bytes = length * CharSize;
     auto status = Encoding<SizeType>::Write(length_bytes, writer);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
     return writer->Write(&value[0], &value[length]);
   }
 
   template <typename Reader>
-  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
-                                            Type* value, Reader* reader) {
+  static Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                  Reader* reader) {
+    if (prefix == EncodingByte::Extension)
+      return ReadInterned(value, reader);
+
     SizeType length_bytes = 0;
     auto status = Encoding<SizeType>::Read(&length_bytes, reader);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
     else if (length_bytes % CharSize != 0)
       return ErrorStatus::InvalidStringLength;
@@ -79,12 +93,46 @@ struct Encoding<std::basic_string<CharType, Traits, Allocator>>
     // Make sure the reader has enough data to fulfill the requested size as a
     // defense against abusive or erroneous string sizes.
     status = reader->Ensure(size);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
     value->resize(size);
     return reader->Read(&(*value)[0], &(*value)[size]);
   }
+
+ private:
+  template <typename Writer>
+  static Status<void> Write(const Type& value, Writer* writer,
+                            std::false_type) {
+    return EncodingIO<Type>::Write(value, writer);
+  }
+
+  template <typename Writer>
+  static Status<void> Write(const Type& value, Writer* writer,
+                            std::true_type) {
+    bool interned = false;
+    auto status = InternedString::Write(value.data(), value.length() * CharSize,
+                                        writer, &interned);
+    if (!status || interned)
+      return status;
+    else
+      return EncodingIO<Type>::Write(value, writer);
+  }
+
+  template <typename Reader>
+  static Status<void> ReadInterned(Type* value, Reader* reader) {
+    auto status = InternedString::Read(reader);
+    if (NOP_UNLIKELY(!status))
+      return status.error();
+
+    const std::string& string = *status.get();
+    if (string.size() % CharSize != 0)
+      return ErrorStatus::InvalidStringLength;
+
+    const CharType* data = reinterpret_cast<const CharType*>(string.data());
+    value->assign(data, data + string.size() / CharSize);
+    return {};
+  }
 };
 
 }  // namespace nop
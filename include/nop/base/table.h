@@ -17,12 +17,23 @@
 #ifndef LIBNOP_INCLUDE_NOP_BASE_TABLE_H_
 #define LIBNOP_INCLUDE_NOP_BASE_TABLE_H_
 
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
 #include <nop/base/encoding.h>
 #include <nop/base/members.h>
 #include <nop/base/utility.h>
 #include <nop/table.h>
 #include <nop/utility/bounded_reader.h>
 #include <nop/utility/bounded_writer.h>
+#include <nop/utility/counting_writer.h>
+#include <nop/utility/endian.h>
 
 namespace nop {
 
@@ -59,6 +70,117 @@ namespace nop {
 // reading data from newer table definitions.
 //
 
+// Writers that support overwriting data they have already written may provide a
+// Patch() method with the same signature as Write(), preceded by the offset to
+// overwrite, along with a size() method returning the number of bytes written.
+// Table entries are then written in a single pass: a fixed-width size slot is
+// reserved, the value is written, and the slot is patched with the exact size.
+// This avoids computing the encoded size of each entry, which is repeated for
+// every level of nested tables, and avoids padding entries whose size is
+// overestimated. Since the size slot may be larger than the size computed by
+// Encoding<T>::Size(), such writers must accept more data than requested by
+// Prepare().
+template <typename Writer>
+using PatchTest = decltype(std::declval<Writer&>().Patch(
+    std::size_t{}, std::declval<const std::uint8_t*>(),
+    std::declval<const std::uint8_t*>()));
+
+// Evaluates to true if Writer supports patching previously written data.
+template <typename Writer>
+using IsPatchWriter = IsDetected<PatchTest, Writer>;
+
+// Returns the largest of Ids or zero if Ids is empty.
+template <std::uint64_t... Ids>
+constexpr std::uint64_t MaxEntryId() {
+  const std::uint64_t ids[sizeof...(Ids) + 1] = {Ids..., 0};
+  std::uint64_t max_id = 0;
+  for (std::size_t i = 0; i < sizeof...(Ids); i++)
+    max_id = std::max(max_id, ids[i]);
+  return max_id;
+}
+
+// Compile-time index that maps each of Ids to its position in the parameter
+// pack. Tables usually number their entries sequentially from zero, with a few
+// gaps left by deleted entries; when the ids are this compact the index is a
+// lookup table indexed directly by id. Otherwise the index is a sorted array of
+// ids that is searched with a binary search.
+template <std::uint64_t... Ids>
+class EntryIdIndex {
+ public:
+  enum : std::size_t { Count = sizeof...(Ids) };
+  enum : std::uint64_t { MaxId = MaxEntryId<Ids...>() };
+
+  using IsDense = std::integral_constant<bool, (MaxId < 2 * Count + 8)>;
+
+  // Returns the index of |id| in Ids or Count if it is not one of Ids.
+  static std::size_t Find(std::uint64_t id) { return Find(id, IsDense{}); }
+
+ private:
+  static_assert(Count < 0xffff, "Too many table entries.");
+
+  using IndexType =
+      std::conditional_t<(Count < 0xff), std::uint8_t, std::uint16_t>;
+
+  enum : std::size_t { DenseSize = IsDense::value ? MaxId + 1 : 1 };
+
+  // Dense table entries hold the index of the id plus one, leaving zero to
+  // mark unused ids.
+  struct DenseTable {
+    IndexType slots[DenseSize];
+  };
+
+  // Table of ids and their indices, sorted by id.
+  struct SortedTable {
+    std::uint64_t ids[Count + 1];
+    IndexType indices[Count + 1];
+  };
+
+  static std::size_t Find(std::uint64_t id, std::true_type) {
+    static constexpr DenseTable table = BuildDenseTable();
+    if (id < DenseSize && table.slots[id] != 0)
+      return table.slots[id] - 1;
+    else
+      return Count;
+  }
+
+  static std::size_t Find(std::uint64_t id, std::false_type) {
+    static constexpr SortedTable table = BuildSortedTable();
+    const std::uint64_t* end = table.ids + Count;
+    const std::uint64_t* entry = std::lower_bound(table.ids, end, id);
+    if (entry != end && *entry == id)
+      return table.indices[entry - table.ids];
+    else
+      return Count;
+  }
+
+  static constexpr DenseTable BuildDenseTable() {
+    const std::uint64_t ids[Count + 1] = {Ids..., 0};
+
+    DenseTable table{};
+    for (std::size_t i = 0; i < Count; i++)
+      table.slots[ids[i]] = static_cast<IndexType>(i + 1);
+
+    return table;
+  }
+
+  static constexpr SortedTable BuildSortedTable() {
+    const std::uint64_t ids[Count + 1] = {Ids..., 0};
+
+    SortedTable table{};
+    for (std::size_t i = 0; i < Count; i++) {
+      std::size_t j = i;
+      for (; j > 0 && table.ids[j - 1] > ids[i]; j--) {
+        table.ids[j] = table.ids[j - 1];
+        table.indices[j] = table.indices[j - 1];
+      }
+      table.ids[j] = ids[i];
+      table.indices[j] = static_cast<IndexType>(i);
+    }
+
+    return table;
+  }
+};
+
 template <typename Table>
 struct Encoding<Table, EnableIfHasEntryList<Table>> : EncodingIO<Table> {
   static constexpr EncodingByte Prefix(const Table& /*value*/) {
@@ -69,8 +191,8 @@ struct Encoding<Table, EnableIfHasEntryList<Table>> : EncodingIO<Table> {
     return BaseEncodingSize(Prefix(value)) +
            Encoding<std::uint64_t>::Size(
                EntryListTraits<Table>::EntryList::Hash) +
-           Encoding<SizeType>::Size(ActiveEntryCount(value, Index<Count>{})) +
-           Size(value, Index<Count>{});
+           Encoding<SizeType>::Size(ActiveEntryCount(value, Indices{})) +
+           Size(value, Indices{});
   }
 
   static constexpr bool Match(EncodingByte prefix) {
@@ -83,57 +205,61 @@ struct Encoding<Table, EnableIfHasEntryList<Table>> : EncodingIO<Table> {
                                              Writer* writer) {
     auto status = Encoding<std::uint64_t>::Write(
         EntryListTraits<Table>::EntryList::Hash, writer);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
-    status = Encoding<SizeType>::Write(ActiveEntryCount(value, Index<Count>{}),
-                                       writer);
-    if (!status)
+    status =
+        Encoding<SizeType>::Write(ActiveEntryCount(value, Indices{}), writer);
+    if (NOP_UNLIKELY(!status))
       return status;
 
-    return WriteEntries(value, writer, Index<Count>{});
+    return WriteEntries(value, writer, Indices{});
   }
 
   template <typename Reader>
   static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
                                             Table* value, Reader* reader) {
-    // Clear entries so that we can detect whether there are duplicate entries
-    // for the same id during deserialization.
-    ClearEntries(value, Index<Count>{});
-
     std::uint64_t hash = 0;
     auto status = Encoding<std::uint64_t>::Read(&hash, reader);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
-    else if (hash != EntryListTraits<Table>::EntryList::Hash)
+    else if (!IsTrustedReader<Reader>::value &&
+             hash != EntryListTraits<Table>::EntryList::Hash)
       return ErrorStatus::InvalidTableHash;
 
     SizeType count = 0;
     status = Encoding<SizeType>::Read(&count, reader);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
-    return ReadEntries(value, count, reader);
+    // Entries are decoded into the existing storage of the table, so that
+    // strings, vectors, and other containers keep their capacity when a
+    // long-lived table is read repeatedly. Entries absent from the encoding
+    // are cleared afterwards. The set of entries seen so far is tracked to
+    // detect duplicate entries for the same id.
+    EntrySet seen;
+    status = ReadEntries(value, count, &seen, reader);
+    ClearEntries(value, seen, Indices{});
+    return status;
   }
 
  private:
   enum : std::size_t { Count = EntryListTraits<Table>::EntryList::Count };
 
+  // Set of entries indexed by position in the entry list.
+  using EntrySet = std::bitset<Count>;
+
   template <std::size_t Index>
   using PointerAt =
       typename EntryListTraits<Table>::EntryList::template At<Index>;
 
-  static constexpr std::size_t ActiveEntryCount(const Table& /*value*/,
-                                                Index<0>) {
-    return 0;
-  }
+  using Indices = std::make_index_sequence<Count>;
 
-  template <std::size_t index>
+  template <std::size_t... Is>
   static constexpr std::size_t ActiveEntryCount(const Table& value,
-                                                Index<index>) {
-    using Pointer = PointerAt<index - 1>;
-    const std::size_t count = Pointer::Resolve(value) ? 1 : 0;
-    return ActiveEntryCount(value, Index<index - 1>{}) + count;
+                                                std::index_sequence<Is...>) {
+    return SumSizes({std::size_t{0},
+                     std::size_t{PointerAt<Is>::Resolve(value) ? 1u : 0u}...});
   }
 
   template <typename T, std::uint64_t Id>
@@ -153,22 +279,18 @@ struct Encoding<Table, EnableIfHasEntryList<Table>> : EncodingIO<Table> {
     return 0;
   }
 
-  static constexpr std::size_t Size(const Table& /*value*/, Index<0>) {
-    return 0;
-  }
-
-  template <std::size_t index>
-  static constexpr std::size_t Size(const Table& value, Index<index>) {
-    using Pointer = PointerAt<index - 1>;
-    return Size(value, Index<index - 1>{}) + Size(Pointer::Resolve(value));
+  template <std::size_t... Is>
+  static constexpr std::size_t Size(const Table& value,
+                                    std::index_sequence<Is...>) {
+    return SumSizes({std::size_t{0}, Size(PointerAt<Is>::Resolve(value))...});
   }
 
-  static void ClearEntries(Table* /*value*/, Index<0>) {}
-
-  template <std::size_t index>
-  static void ClearEntries(Table* value, Index<index>) {
-    ClearEntries(value, Index<index - 1>{});
-    PointerAt<index - 1>::Resolve(value)->clear();
+  // Clears the entries that are not in |seen|.
+  template <std::size_t... Is>
+  static void ClearEntries(Table* value, const EntrySet& seen,
+                           std::index_sequence<Is...>) {
+    (void)std::initializer_list<bool>{
+        (!seen[Is] && (PointerAt<Is>::Resolve(value)->clear(), true))...};
   }
 
   template <typename T, std::uint64_t Id, typename Writer>
@@ -176,29 +298,11 @@ struct Encoding<Table, EnableIfHasEntryList<Table>> : EncodingIO<Table> {
       const Entry<T, Id, ActiveEntry>& entry, Writer* writer) {
     if (entry) {
       auto status = Encoding<std::uint64_t>::Write(Id, writer);
-      if (!status)
-        return status;
-
-      const SizeType size = Encoding<T>::Size(entry.get());
-      status = Encoding<SizeType>::Write(size, writer);
-      if (!status)
-        return status;
-
-      // Use a BoundedWriter to track the number of bytes written. Since a few
-      // encodings overestimate their size, the remaining bytes must be padded
-      // out to match the size written above. This is a tradeoff that
-      // potentially increases the encoding size to avoid unnecessary dynamic
-      // memory allocation during encoding; some size savings could be made by
-      // encoding the entry to a temporary buffer and then writing the exact
-      // size for the binary container. However, overestimation is rare and
-      // small, making the savings not worth the expense of the temporary
-      // buffer.
-      BoundedWriter<Writer> bounded_writer{writer, size};
-      status = Encoding<T>::Write(entry.get(), &bounded_writer);
-      if (!status)
+      if (NOP_UNLIKELY(!status))
         return status;
 
-      return bounded_writer.WritePadding();
+      return WriteEntryValue(entry.get(), writer, IsPatchWriter<Writer>{},
+                             IsSizeOverestimated<T>{});
     } else {
       return {};
     }
@@ -210,50 +314,119 @@ struct Encoding<Table, EnableIfHasEntryList<Table>> : EncodingIO<Table> {
     return {};
   }
 
-  template <typename Writer>
-  static constexpr Status<void> WriteEntries(const Table& /*value*/,
-                                             Writer* /*writer*/, Index<0>) {
-    return {};
+  // Writes the size and value of an entry in two passes, first computing the
+  // size of the value.
+  template <typename T, typename Writer>
+  static constexpr Status<void> WriteEntryValue(const T& value, Writer* writer,
+                                                std::false_type,
+                                                std::false_type) {
+    return WriteSizedEntryValue(value, Encoding<T>::Size(value), writer);
   }
 
-  template <std::size_t index, typename Writer>
-  static constexpr Status<void> WriteEntries(const Table& value, Writer* writer,
-                                             Index<index>) {
-    auto status = WriteEntries(value, writer, Index<index - 1>{});
-    if (!status)
+  // As above, measuring the size of values whose size Encoding<T>::Size() may
+  // overestimate with a dry run.
+  template <typename T, typename Writer>
+  static Status<void> WriteEntryValue(const T& value, Writer* writer,
+                                      std::false_type, std::true_type) {
+    auto size_status = ExactEncodingSize(value, writer);
+    if (!size_status)
+      return size_status.error();
+
+    return WriteSizedEntryValue(value, size_status.get(), writer);
+  }
+
+  // Writes the entry value with the given size.
+  template <typename T, typename Writer>
+  static constexpr Status<void> WriteSizedEntryValue(const T& value,
+                                                     SizeType size,
+                                                     Writer* writer) {
+    auto status = Encoding<SizeType>::Write(size, writer);
+    if (NOP_UNLIKELY(!status))
+      return status;
+
+    // Use a BoundedWriter to track the number of bytes written. Values whose
+    // size Encoding<T>::Size() may overestimate are measured exactly with a
+    // dry run above, except when handle references cannot be predicted, so
+    // the remaining bytes, if any, must be padded out to match the size
+    // written above.
+    //
+    // Entries of nested tables narrow the limit of the enclosing BoundedWriter
+    // rather than wrapping it again.
+    BoundedWriterScope<Writer> scope{writer, size};
+    status = scope.status();
+    if (NOP_UNLIKELY(!status))
+      return status;
+
+    status = Encoding<T>::Write(value, scope.writer());
+    if (NOP_UNLIKELY(!status))
+      return status;
+
+    return scope.WritePadding();
+  }
+
+  // Writes the size and value of an entry in a single pass, patching the exact
+  // size of the value into a fixed-width U32 slot after writing the value.
+  template <typename T, typename Writer, typename Overestimated>
+  static Status<void> WriteEntryValue(const T& value, Writer* writer,
+                                      std::true_type, Overestimated) {
+    auto status = writer->Write(static_cast<std::uint8_t>(EncodingByte::U32));
+    if (NOP_UNLIKELY(!status))
+      return status;
+
+    const std::size_t position = writer->size();
+    status = writer->Skip(sizeof(std::uint32_t));
+    if (NOP_UNLIKELY(!status))
+      return status;
+
+    status = Encoding<T>::Write(value, writer);
+    if (NOP_UNLIKELY(!status))
       return status;
 
-    using Pointer = PointerAt<index - 1>;
-    return WriteEntry(Pointer::Resolve(value), writer);
+    const std::size_t size = writer->size() - position - sizeof(std::uint32_t);
+    if (size > std::numeric_limits<std::uint32_t>::max())
+      return ErrorStatus::WriteLimitReached;
+
+    std::uint32_t size_bytes = static_cast<std::uint32_t>(size);
+    ToLittleEndian(&size_bytes, &size_bytes + 1);
+    return writer->Patch(position, &size_bytes, &size_bytes + 1);
+  }
+
+  template <typename Writer, std::size_t... Is>
+  static constexpr Status<void> WriteEntries(const Table& value, Writer* writer,
+                                             std::index_sequence<Is...>) {
+    Status<void> status;
+    NOP_EXPAND_STATUS(status,
+                      WriteEntry(PointerAt<Is>::Resolve(value), writer));
+    return status;
   }
 
   template <typename T, std::uint64_t Id, typename Reader>
   static constexpr Status<void> ReadEntry(Entry<T, Id, ActiveEntry>* entry,
                                           Reader* reader) {
-    // At the beginning of reading the table the destination entries are
-    // cleared. If an entry is not cleared here then more than one entry for
-    // the same id was written in violation of the table protocol.
-    if (entry->empty()) {
-      SizeType size = 0;
-      auto status = Encoding<SizeType>::Read(&size, reader);
-      if (!status)
-        return status;
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (NOP_UNLIKELY(!status))
+      return status;
 
-      // Default construct the entry;
+    // Default construct the entry if it is empty, otherwise decode over the
+    // existing value.
+    if (entry->empty())
       *entry = T{};
 
-      // Use a BoundedReader to handle any padding that might follow the
-      // value and catch invalid sizes while decoding inside the binary
-      // container.
-      BoundedReader<Reader> bounded_reader{reader, size};
-      status = Encoding<T>::Read(&entry->get(), &bounded_reader);
-      if (!status)
-        return status;
+    // Use a BoundedReader to handle any padding that might follow the value
+    // and catch invalid sizes while decoding inside the binary container.
+    // Entries of nested tables narrow the limit of the enclosing BoundedReader
+    // rather than wrapping it again.
+    BoundedReaderScope<Reader> scope{reader, size};
+    status = scope.status();
+    if (NOP_UNLIKELY(!status))
+      return status;
 
-      return bounded_reader.ReadPadding();
-    } else {
-      return ErrorStatus::DuplicateTableEntry;
-    }
+    status = Encoding<T>::Read(&entry->get(), scope.reader());
+    if (NOP_UNLIKELY(!status))
+      return status;
+
+    return scope.ReadPadding();
   }
 
   // Skips over the binary container for an entry.
@@ -261,7 +434,7 @@ struct Encoding<Table, EnableIfHasEntryList<Table>> : EncodingIO<Table> {
   static constexpr Status<void> SkipEntry(Reader* reader) {
     SizeType size = 0;
     auto status = Encoding<SizeType>::Read(&size, reader);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
     return reader->Skip(size);
@@ -273,41 +446,82 @@ struct Encoding<Table, EnableIfHasEntryList<Table>> : EncodingIO<Table> {
     return SkipEntry(reader);
   }
 
-  template <typename Reader>
-  static constexpr Status<void> ReadEntryForId(Table* /*value*/,
-                                               std::uint64_t /*id*/,
-                                               Reader* reader, Index<0>) {
-    return SkipEntry(reader);
+  template <typename>
+  struct EntryIndexFor;
+  template <std::size_t... Is>
+  struct EntryIndexFor<std::index_sequence<Is...>> {
+    using Type = EntryIdIndex<PointerAt<Is>::Type::Id...>;
+  };
+
+  // Index mapping the id of each entry to its position in the entry list.
+  using EntryIndex = typename EntryIndexFor<Indices>::Type;
+
+  // Reads the entry with the given id through a table of functions indexed by
+  // entry position. The extra trailing function skips unknown ids. More than
+  // one entry for the same id violates the table protocol.
+  template <typename Reader, std::size_t... Is>
+  static Status<void> ReadEntryForId(Table* value, std::uint64_t id,
+                                     EntrySet* seen, Reader* reader,
+                                     std::index_sequence<Is...>) {
+    using Function = Status<void> (*)(Table*, Reader*);
+    static constexpr Function functions[] = {&ReadEntryAt<Reader, Is>...,
+                                             &SkipUnknownEntry<Reader>};
+
+    const std::size_t index = EntryIndex::Find(id);
+    if (index < Count) {
+      if ((*seen)[index])
+        return ErrorStatus::DuplicateTableEntry;
+      seen->set(index);
+    }
+
+    return functions[index](value, reader);
   }
 
   template <typename Reader, std::size_t index>
-  static constexpr Status<void> ReadEntryForId(Table* value, std::uint64_t id,
-                                               Reader* reader, Index<index>) {
-    using Pointer = PointerAt<index - 1>;
-    using Type = typename Pointer::Type;
-    if (Type::Id == id)
-      return ReadEntry(Pointer::Resolve(value), reader);
-    else
-      return ReadEntryForId(value, id, reader, Index<index - 1>{});
+  static Status<void> ReadEntryAt(Table* value, Reader* reader) {
+    return ReadEntry(PointerAt<index>::Resolve(value), reader);
+  }
+
+  template <typename Reader>
+  static Status<void> SkipUnknownEntry(Table* /*value*/, Reader* reader) {
+    return SkipEntry(reader);
   }
 
   template <typename Reader>
   static constexpr Status<void> ReadEntries(Table* value, SizeType count,
-                                            Reader* reader) {
+                                            EntrySet* seen, Reader* reader) {
     for (SizeType i = 0; i < count; i++) {
       std::uint64_t id = 0;
       auto status = Encoding<std::uint64_t>::Read(&id, reader);
-      if (!status)
+      if (NOP_UNLIKELY(!status))
         return status;
 
-      status = ReadEntryForId(value, id, reader, Index<Count>{});
-      if (!status)
+      status = ReadEntryForId(value, id, seen, reader, Indices{});
+      if (NOP_UNLIKELY(!status))
         return status;
     }
     return {};
   }
 };
 
+// Tables overestimate their size when any of their active entries do.
+template <typename T, std::uint64_t Id>
+struct IsSizeOverestimated<Entry<T, Id, ActiveEntry>>
+    : IsSizeOverestimated<std::remove_cv_t<T>> {};
+template <typename T, std::uint64_t Id>
+struct IsSizeOverestimated<Entry<T, Id, DeletedEntry>> : std::false_type {};
+
+template <typename EntryListType>
+struct OverestimatedEntryList;
+template <typename HashValue, typename... MemberPointers>
+struct OverestimatedEntryList<EntryList<HashValue, MemberPointers...>>
+    : Or<std::false_type,
+         IsSizeOverestimated<typename MemberPointers::Type>...> {};
+
+template <typename Table>
+struct IsSizeOverestimated<Table, EnableIfHasEntryList<Table>>
+    : OverestimatedEntryList<typename EntryListTraits<Table>::EntryList> {};
+
 }  // namespace nop
 
 #endif  // LIBNOP_INCLUDE_NOP_BASE_TABLE_H_
@@ -19,6 +19,7 @@
 
 #include <tuple>
 #include <type_traits>
+#include <utility>
 
 #include <nop/base/encoding.h>
 #include <nop/base/utility.h>
@@ -45,7 +46,7 @@ struct Encoding<std::tuple<Types...>> : EncodingIO<std::tuple<Types...>> {
   static constexpr std::size_t Size(const Type& value) {
     return BaseEncodingSize(Prefix(value)) +
            Encoding<SizeType>::Size(sizeof...(Types)) +
-           Size(value, Index<sizeof...(Types)>{});
+           Size(value, Indices{});
   }
 
   static constexpr bool Match(EncodingByte prefix) {
@@ -59,7 +60,7 @@ struct Encoding<std::tuple<Types...>> : EncodingIO<std::tuple<Types...>> {
     if (!status)
       return status;
     else
-      return WriteElements(value, writer, Index<sizeof...(Types)>{});
+      return WriteElements(value, writer, Indices{});
   }
 
   template <typename Reader>
@@ -72,7 +73,7 @@ struct Encoding<std::tuple<Types...>> : EncodingIO<std::tuple<Types...>> {
     else if (size != sizeof...(Types))
       return ErrorStatus::InvalidContainerLength;
     else
-      return ReadElements(value, reader, Index<sizeof...(Types)>{});
+      return ReadElements(value, reader, Indices{});
   }
 
  private:
@@ -80,54 +81,63 @@ struct Encoding<std::tuple<Types...>> : EncodingIO<std::tuple<Types...>> {
   using ElementType = std::remove_cv_t<
       std::remove_reference_t<std::tuple_element_t<Index, Type>>>;
 
-  // Terminates template recursion.
-  static constexpr std::size_t Size(const Type& /*value*/, Index<0>) {
+  using Indices = std::index_sequence_for<Types...>;
+
+  static constexpr std::size_t Size(const Type& /*value*/,
+                                    std::index_sequence<>) {
     return 0;
   }
 
-  // Recursively determines the size of all tuple elements.
-  template <std::size_t index>
-  static constexpr std::size_t Size(const Type& value, Index<index>) {
-    return Size(value, Index<index - 1>{}) +
-           Encoding<ElementType<index - 1>>::Size(std::get<index - 1>(value));
+  template <std::size_t... Is>
+  static constexpr std::size_t Size(const Type& value,
+                                    std::index_sequence<Is...>) {
+    return SumSizes({std::size_t{0},
+                     Encoding<ElementType<Is>>::Size(std::get<Is>(value))...});
   }
 
-  // Terminates template recursion.
   template <typename Writer>
-  static constexpr Status<void> WriteElements(const Type& /*value*/, Writer* /*writer*/,
-                                    Index<0>) {
+  static constexpr Status<void> WriteElements(const Type& /*value*/,
+                                              Writer* /*writer*/,
+                                              std::index_sequence<>) {
     return {};
   }
 
-  // Recursively writes tuple elements to the writer.
-  template <std::size_t index, typename Writer>
+  template <typename Writer, std::size_t... Is>
   static constexpr Status<void> WriteElements(const Type& value, Writer* writer,
-                                    Index<index>) {
-    auto status = WriteElements(value, writer, Index<index - 1>{});
-    if (!status)
-      return status;
-
-    return Encoding<ElementType<index - 1>>::Write(std::get<index - 1>(value),
-                                                   writer);
+                                              std::index_sequence<Is...>) {
+    Status<void> status;
+    NOP_EXPAND_STATUS(
+        status, Encoding<ElementType<Is>>::Write(std::get<Is>(value), writer));
+    return status;
   }
 
   template <typename Reader>
-  static constexpr Status<void> ReadElements(Type* /*value*/, Reader* /*reader*/,
-                                   Index<0>) {
+  static constexpr Status<void> ReadElements(Type* /*value*/,
+                                             Reader* /*reader*/,
+                                             std::index_sequence<>) {
     return {};
   }
 
-  template <std::size_t index, typename Reader>
-  static constexpr Status<void> ReadElements(Type* value, Reader* reader, Index<index>) {
-    auto status = ReadElements(value, reader, Index<index - 1>{});
-    if (!status)
-      return status;
-
-    return Encoding<ElementType<index - 1>>::Read(&std::get<index - 1>(*value),
-                                                  reader);
+  template <typename Reader, std::size_t... Is>
+  static constexpr Status<void> ReadElements(Type* value, Reader* reader,
+                                             std::index_sequence<Is...>) {
+    Status<void> status;
+    NOP_EXPAND_STATUS(
+        status, Encoding<ElementType<Is>>::Read(&std::get<Is>(*value), reader));
+    return status;
   }
 };
 
+// Tuples have a fixed encoding size when all of their elements do.
+template <typename... Types>
+struct FixedEncodingSize<std::tuple<Types...>>
+    : FixedAggregateEncodingSize<Types...> {};
+
+// Tuples have a bounded encoding size when all of their elements do.
+template <typename... Types>
+struct MaxEncodingSize<std::tuple<Types...>>
+    : MaxAggregateEncodingSize<Types...> {};
+
 }  // namespace nop
 
 #endif  //  LIBNOP_INCLUDE_NOP_BASE_TUPLE_H_
@@ -18,7 +18,9 @@
 #define LIBNOP_INCLUDE_NOP_BASE_UTILITY_H_
 
 #include <cstddef>
+#include <initializer_list>
 #include <type_traits>
+#include <utility>
 
 #include <nop/traits/is_template_base_of.h>
 #include <nop/traits/void.h>
@@ -29,6 +31,49 @@ namespace nop {
 template <std::size_t>
 struct Index {};
 
+//
+// Parameter pack expansion.
+//
+// Aggregates with many members, such as structures, tables, and tuples, expand
+// their members from a std::index_sequence into a single flat expression
+// rather than recursing through Index<N> overloads, which instantiate a chain
+// of N nested templates per type and leave deep call chains for the optimizer
+// to flatten. Fold expressions are used when the compiler supports them, and
+// an equivalent array expansion otherwise.
+//
+#if defined(__cpp_fold_expressions) && __cpp_fold_expressions >= 201603L
+#define NOP_HAS_FOLD_EXPRESSIONS 1
+#else
+#define NOP_HAS_FOLD_EXPRESSIONS 0
+#endif
+
+// Evaluates the Status<void> expression given as the variadic argument, which
+// names an unexpanded parameter pack, for each element of the pack in order.
+// Each result is assigned to |status|, stopping at the first error. Usable in
+// constexpr functions. Functions expanding empty packs should provide separate
+// overloads for std::index_sequence<>, which leave their parameters unused.
+#if NOP_HAS_FOLD_EXPRESSIONS
+#define NOP_EXPAND_STATUS(status, ...) \
+  (void)(... && ((status) = (__VA_ARGS__)))
+#else
+#define NOP_EXPAND_STATUS(status, ...)                                       \
+  do {                                                                       \
+    bool nop_expand_ok = true;                                               \
+    (void)std::initializer_list<bool>{                                       \
+        (nop_expand_ok = nop_expand_ok && ((status) = (__VA_ARGS__)))...};   \
+    (void)nop_expand_ok;                                                     \
+  } while (false)
+#endif
+
+// Returns the sum of |sizes|, typically the expansion of a parameter pack with
+// a leading zero for empty packs.
+constexpr std::size_t SumSizes(std::initializer_list<std::size_t> sizes) {
+  std::size_t sum = 0;
+  for (std::size_t size : sizes)
+    sum += size;
+  return sum;
+}
+
 // Passthrough type.
 template <typename T>
 using Identity = T;
@@ -53,6 +98,68 @@ struct IsArithmetic<First, Rest...>
     : std::integral_constant<bool, IsArithmetic<First>::value &&
                                        IsArithmetic<Rest...>::value> {};
 
+// Determines whether type T has a nested type named NOP__RAW_STRUCTURE, which
+// is defined by NOP_RAW_STRUCTURE.
+template <typename T, typename = void>
+struct IsRawStructure {
+ private:
+  template <typename U>
+  static constexpr bool Test(const typename U::NOP__RAW_STRUCTURE*) {
+    return true;
+  }
+  template <typename U>
+  static constexpr bool Test(...) {
+    return false;
+  }
+
+ public:
+  enum : bool { value = Test<T>(0) };
+};
+
+// Evaluates to the traits type defined by NOP_ENUM_FLAGS() for the given type
+// T. This type alias uses ADL to find the traits type for type T in the
+// namespace type T is defined in.
+template <typename T>
+using EnumFlagsTraits = decltype(NOP__GetEnumFlagsTraits(std::declval<T*>()));
+
+// Evaluates to std::true_type if the given type T has been tagged as an enum
+// flags type by NOP_ENUM_FLAGS() or std::false_type otherwise.
+template <typename, typename = void>
+struct IsEnumFlags : std::false_type {};
+template <typename T>
+struct IsEnumFlags<T, Void<typename EnumFlagsTraits<T>::Type>>
+    : std::true_type {};
+
+// Enable if type T is tagged as an enum flags type.
+template <typename T>
+using EnableIfEnumFlags = typename std::enable_if<IsEnumFlags<T>::value>::type;
+
+// Evaluates to true for value wrappers that are stored exactly like their
+// wrapped arithmetic or enum member, which makes them packable. Specialized
+// for value wrappers in nop/types/detail/member_pointer.h.
+template <typename T, typename = void>
+struct IsPackedValueWrapper : std::false_type {};
+
+// Trait to determine if all types in a parameter pack are stored as their
+// direct little-endian representation in packed BINARY containers: integral
+// types, the IEEE 754 floating point types float and double, raw structures,
+// enum types, which are stored as their underlying integral type, and value
+// wrappers with the same representation as their arithmetic or enum member.
+template <typename...>
+struct IsPackable;
+template <typename T>
+struct IsPackable<T>
+    : std::integral_constant<bool, std::is_integral<T>::value ||
+                                       std::is_same<T, float>::value ||
+                                       std::is_same<T, double>::value ||
+                                       IsRawStructure<T>::value ||
+                                       std::is_enum<T>::value ||
+                                       IsPackedValueWrapper<T>::value> {};
+template <typename First, typename... Rest>
+struct IsPackable<First, Rest...>
+    : std::integral_constant<bool, IsPackable<First>::value &&
+                                       IsPackable<Rest...>::value> {};
+
 // Enable if every entry of Types is an integral type.
 template <typename... Types>
 using EnableIfIntegral =
@@ -63,6 +170,35 @@ template <typename... Types>
 using EnableIfNotIntegral =
     typename std::enable_if<!IsIntegral<Types...>::value>::type;
 
+// Enable if every entry of Types is a packable type.
+template <typename... Types>
+using EnableIfPackable =
+    typename std::enable_if<IsPackable<Types...>::value>::type;
+
+// Enable if any entry of Types is not a packable type.
+template <typename... Types>
+using EnableIfNotPackable =
+    typename std::enable_if<!IsPackable<Types...>::value>::type;
+
+// Evaluates to true for packable types whose containers older versions of the
+// library encoded as ARRAY containers of individually encoded elements:
+// floating point types, enum types, and packed value wrappers. Containers of
+// these types accept both formats when reading.
+template <typename T>
+struct HasLegacyArrayFormat
+    : std::integral_constant<bool, std::is_floating_point<T>::value ||
+                                       std::is_enum<T>::value ||
+                                       IsPackedValueWrapper<T>::value> {};
+
+// Enable if T may be copied directly between memory and readers or writers:
+// arithmetic types, raw structures, enum types, and packed value wrappers.
+template <typename T>
+using EnableIfBitwiseCopyable =
+    typename std::enable_if<std::is_arithmetic<T>::value ||
+                            IsRawStructure<T>::value ||
+                            std::is_enum<T>::value ||
+                            IsPackedValueWrapper<T>::value>::type;
+
 // Enable if every entry of Types is an arithmetic type.
 template <typename... Types>
 using EnableIfArithmetic =
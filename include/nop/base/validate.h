@@ -0,0 +1,473 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_VALIDATE_H_
+#define LIBNOP_INCLUDE_NOP_BASE_VALIDATE_H_
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <nop/base/array.h>
+#include <nop/base/encoding.h>
+#include <nop/base/map.h>
+#include <nop/base/members.h>
+#include <nop/base/optional.h>
+#include <nop/base/pair.h>
+#include <nop/base/skip.h>
+#include <nop/base/table.h>
+#include <nop/base/tuple.h>
+#include <nop/base/utility.h>
+#include <nop/base/variant.h>
+#include <nop/base/vector.h>
+#include <nop/table.h>
+#include <nop/utility/bounded_reader.h>
+
+namespace nop {
+
+//
+// Validation of untrusted input against a type. Validate<T>() walks the
+// encoding of one value of type T and checks it the way reading a T would:
+// prefixes are matched with Encoding<T>::Match(), container lengths are checked
+// against the input remaining, and member counts, table hashes, duplicate
+// table entries, fixed array lengths, and variant indices are checked against
+// T. No values are constructed and nothing is allocated, and payloads whose
+// contents do not need checking, such as strings and packed arrays, are
+// skipped in one step.
+//
+// Structures, tables, variants, optionals, pairs, tuples, arrays, vectors, and
+// maps are validated element by element. Other types are validated by matching
+// their prefix and skipping the rest of the value with SkipValuePayload(),
+// which checks that it is well formed but not, for example, the capacity of a
+// StaticString.
+//
+// Untrusted input must be validated through a reader that checks the bounds of
+// every read, such as PedanticBufferReader. Input accepted by Validate<T>()
+// from a contiguous buffer may then be decoded with UncheckedReader, which
+// skips those checks.
+//
+// Example:
+//
+//   nop::PedanticBufferReader reader{data, size};
+//   auto status = nop::Validate<Message>(&reader);
+//   if (!status)
+//     return status;  // Reject the buffer.
+//
+//   Message message;
+//   nop::UncheckedReader unchecked_reader{data};
+//   nop::Deserializer<nop::UncheckedReader*> deserializer{&unchecked_reader};
+//   status = deserializer.Read(&message);
+//
+
+// Validation of the payloads of values of type T. The default validates the
+// value by its prefixes alone.
+template <typename T, typename Enabled = void>
+struct ValidateEncoding {
+  template <typename Reader>
+  static Status<void> ValidatePayload(EncodingByte prefix, Reader* reader) {
+    return SkipValuePayload(prefix, reader);
+  }
+};
+
+// Validates the next value in |reader| as an encoding of type T and advances
+// the reader past it.
+template <typename T, typename Reader>
+Status<void> Validate(Reader* reader) {
+  EncodingByte prefix;
+  auto status = SkipValueCommon::ReadPrefix(&prefix, reader);
+  if (!status)
+    return status;
+  else if (!Encoding<T>::Match(prefix))
+    return ErrorStatus::UnexpectedEncodingType;
+  else
+    return ValidateEncoding<T>::ValidatePayload(prefix, reader);
+}
+
+// Implementation details of the ValidateEncoding specializations.
+struct ValidateCommon {
+  // Reads a container length and checks that the reader has at least one byte
+  // for each element.
+  template <typename Reader>
+  static Status<void> ReadCount(SizeType* count, Reader* reader) {
+    auto status = Encoding<SizeType>::Read(count, reader);
+    if (!status)
+      return status;
+    else if (*count > std::numeric_limits<std::size_t>::max())
+      return ErrorStatus::ReadLimitReached;
+    else
+      return reader->Ensure(static_cast<std::size_t>(*count));
+  }
+
+  // Reads a container length that must equal |expected|.
+  template <typename Reader>
+  static Status<void> ReadCount(SizeType expected, ErrorStatus error,
+                                Reader* reader) {
+    SizeType count = 0;
+    auto status = Encoding<SizeType>::Read(&count, reader);
+    if (!status)
+      return status;
+    else if (count != expected)
+      return error;
+    else
+      return {};
+  }
+
+  template <typename T, typename Reader>
+  static Status<void> ValidateElements(SizeType count, Reader* reader) {
+    for (SizeType i = 0; i < count; i++) {
+      auto status = Validate<T>(reader);
+      if (!status)
+        return status;
+    }
+    return {};
+  }
+
+  // Validates the payload of an array of T: individually encoded elements, or
+  // a binary container of packed elements for packable types.
+  template <typename T, typename Reader>
+  static Status<void> ValidateArray(EncodingByte prefix, Reader* reader) {
+    SizeType count = 0;
+    auto status = ReadCount(&count, reader);
+    if (!status)
+      return status;
+    else if (prefix == EncodingByte::Array)
+      return ValidateElements<T>(count, reader);
+    else if (count % sizeof(T) != 0)
+      return ErrorStatus::InvalidContainerLength;
+    else
+      return reader->Skip(static_cast<std::size_t>(count));
+  }
+
+  // Validates the payload of an array of exactly Length elements of T.
+  template <typename T, std::size_t Length, typename Reader>
+  static Status<void> ValidateArray(EncodingByte prefix, Reader* reader) {
+    const SizeType length =
+        prefix == EncodingByte::Array ? Length : Length * sizeof(T);
+    auto status =
+        ReadCount(length, ErrorStatus::InvalidContainerLength, reader);
+    if (!status)
+      return status;
+    else if (prefix == EncodingByte::Array)
+      return ValidateElements<T>(Length, reader);
+    else
+      return SkipValueCommon::SkipBytes(length, reader);
+  }
+};
+
+template <typename T, typename Allocator>
+struct ValidateEncoding<std::vector<T, Allocator>,
+                        std::enable_if_t<!std::is_same<T, bool>::value>> {
+  template <typename Reader>
+  static Status<void> ValidatePayload(EncodingByte prefix, Reader* reader) {
+    return ValidateCommon::ValidateArray<T>(prefix, reader);
+  }
+};
+
+template <typename T, std::size_t Length>
+struct ValidateEncoding<std::array<T, Length>> {
+  template <typename Reader>
+  static Status<void> ValidatePayload(EncodingByte prefix, Reader* reader) {
+    return ValidateCommon::ValidateArray<T, Length>(prefix, reader);
+  }
+};
+
+template <typename T, std::size_t Length>
+struct ValidateEncoding<T[Length]> : ValidateEncoding<std::array<T, Length>> {
+};
+
+template <typename T>
+struct ValidateEncoding<Optional<T>> {
+  template <typename Reader>
+  static Status<void> ValidatePayload(EncodingByte prefix, Reader* reader) {
+    if (prefix == EncodingByte::Nil)
+      return {};
+    else
+      return ValidateEncoding<T>::ValidatePayload(prefix, reader);
+  }
+};
+
+template <typename T, typename U>
+struct ValidateEncoding<std::pair<T, U>> {
+  template <typename Reader>
+  static Status<void> ValidatePayload(EncodingByte /*prefix*/,
+                                      Reader* reader) {
+    auto status =
+        ValidateCommon::ReadCount(2u, ErrorStatus::InvalidContainerLength,
+                                  reader);
+    if (!status)
+      return status;
+
+    status = Validate<std::remove_cv_t<std::remove_reference_t<T>>>(reader);
+    if (!status)
+      return status;
+
+    return Validate<std::remove_cv_t<std::remove_reference_t<U>>>(reader);
+  }
+};
+
+template <typename... Types>
+struct ValidateEncoding<std::tuple<Types...>> {
+  template <typename Reader>
+  static Status<void> ValidatePayload(EncodingByte /*prefix*/,
+                                      Reader* reader) {
+    Status<void> status = ValidateCommon::ReadCount(
+        sizeof...(Types), ErrorStatus::InvalidContainerLength, reader);
+    if (!status)
+      return status;
+
+    NOP_EXPAND_STATUS(status, Validate<std::decay_t<Types>>(reader));
+    return status;
+  }
+};
+
+template <>
+struct ValidateEncoding<std::tuple<>> {
+  template <typename Reader>
+  static Status<void> ValidatePayload(EncodingByte /*prefix*/,
+                                      Reader* reader) {
+    return ValidateCommon::ReadCount(0u, ErrorStatus::InvalidContainerLength,
+                                     reader);
+  }
+};
+
+// Validates the entries of maps, which alternate keys and values.
+template <typename Key, typename T>
+struct ValidateMapEncoding {
+  template <typename Reader>
+  static Status<void> ValidatePayload(EncodingByte /*prefix*/,
+                                      Reader* reader) {
+    SizeType count = 0;
+    auto status = ValidateCommon::ReadCount(&count, reader);
+    if (!status)
+      return status;
+
+    for (SizeType i = 0; i < count; i++) {
+      status = Validate<Key>(reader);
+      if (!status)
+        return status;
+
+      status = Validate<T>(reader);
+      if (!status)
+        return status;
+    }
+    return {};
+  }
+};
+
+template <typename Key, typename T, typename Compare, typename Allocator>
+struct ValidateEncoding<std::map<Key, T, Compare, Allocator>>
+    : ValidateMapEncoding<Key, T> {};
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+struct ValidateEncoding<std::unordered_map<Key, T, Hash, KeyEqual, Allocator>>
+    : ValidateMapEncoding<Key, T> {};
+
+template <typename... Ts>
+struct ValidateEncoding<Variant<Ts...>> {
+  template <typename Reader>
+  static Status<void> ValidatePayload(EncodingByte /*prefix*/,
+                                      Reader* reader) {
+    std::int32_t type = 0;
+    auto status = Encoding<std::int32_t>::Read(&type, reader);
+    if (!status) {
+      return status;
+    } else if (type < Variant<Ts...>::kEmptyIndex ||
+               type >= static_cast<std::int32_t>(sizeof...(Ts))) {
+      return ErrorStatus::UnexpectedVariantType;
+    }
+
+    // The empty variant is encoded as nil and precedes the elements.
+    using Function = Status<void> (*)(Reader*);
+    static constexpr Function functions[] = {&Validate<EmptyVariant, Reader>,
+                                             &Validate<Ts, Reader>...};
+    return functions[type + 1](reader);
+  }
+};
+
+template <typename T>
+struct ValidateEncoding<T, EnableIfStructure<T>> {
+  template <typename Reader>
+  static Status<void> ValidatePayload(EncodingByte /*prefix*/,
+                                      Reader* reader) {
+    auto status = ValidateCommon::ReadCount(
+        Count, ErrorStatus::InvalidMemberCount, reader);
+    if (!status)
+      return status;
+
+    return ValidateMembers(reader, std::make_index_sequence<Count>{});
+  }
+
+ private:
+  using MemberList = typename MemberListTraits<T>::MemberList;
+  enum : std::size_t { Count = MemberList::Count };
+
+  template <std::size_t Index>
+  using MemberType = typename MemberList::template At<Index>::Type;
+
+  template <typename Reader>
+  static Status<void> ValidateMembers(Reader* /*reader*/,
+                                      std::index_sequence<>) {
+    return {};
+  }
+
+  template <typename Reader, std::size_t... Is>
+  static Status<void> ValidateMembers(Reader* reader,
+                                      std::index_sequence<Is...>) {
+    Status<void> status;
+    NOP_EXPAND_STATUS(status, Validate<MemberType<Is>>(reader));
+    return status;
+  }
+};
+
+template <typename T>
+struct ValidateEncoding<T, EnableIfRawStructure<T>> {
+  template <typename Reader>
+  static Status<void> ValidatePayload(EncodingByte /*prefix*/,
+                                      Reader* reader) {
+    auto status = ValidateCommon::ReadCount(
+        sizeof(T), ErrorStatus::InvalidContainerLength, reader);
+    if (!status)
+      return status;
+
+    return SkipValueCommon::SkipBytes(sizeof(T), reader);
+  }
+};
+
+template <typename Table>
+struct ValidateEncoding<Table, EnableIfHasEntryList<Table>> {
+  template <typename Reader>
+  static Status<void> ValidatePayload(EncodingByte /*prefix*/,
+                                      Reader* reader) {
+    std::uint64_t hash = 0;
+    auto status = Encoding<std::uint64_t>::Read(&hash, reader);
+    if (!status)
+      return status;
+    else if (hash != EntryList::Hash)
+      return ErrorStatus::InvalidTableHash;
+
+    SizeType count = 0;
+    status = ValidateCommon::ReadCount(&count, reader);
+    if (!status)
+      return status;
+
+    EntrySet seen;
+    for (SizeType i = 0; i < count; i++) {
+      std::uint64_t id = 0;
+      status = Encoding<std::uint64_t>::Read(&id, reader);
+      if (!status)
+        return status;
+
+      status = ValidateEntryForId(id, &seen, reader, Indices{});
+      if (!status)
+        return status;
+    }
+    return {};
+  }
+
+ private:
+  using EntryList = typename EntryListTraits<Table>::EntryList;
+  enum : std::size_t { Count = EntryList::Count };
+
+  // Set of entries indexed by position in the entry list.
+  using EntrySet = std::bitset<Count>;
+
+  template <std::size_t Index>
+  using EntryAt = typename EntryList::template At<Index>::Type;
+
+  using Indices = std::make_index_sequence<Count>;
+
+  template <typename>
+  struct EntryIndexFor;
+  template <std::size_t... Is>
+  struct EntryIndexFor<std::index_sequence<Is...>> {
+    using Type = EntryIdIndex<EntryAt<Is>::Id...>;
+  };
+
+  // Index mapping the id of each entry to its position in the entry list.
+  using EntryIndex = typename EntryIndexFor<Indices>::Type;
+
+  // Validates the entry with the given id through a table of functions
+  // indexed by entry position, as reading the table does. The extra trailing
+  // function skips unknown ids.
+  template <typename Reader, std::size_t... Is>
+  static Status<void> ValidateEntryForId(std::uint64_t id, EntrySet* seen,
+                                         Reader* reader,
+                                         std::index_sequence<Is...>) {
+    using Function = Status<void> (*)(Reader*);
+    static constexpr Function functions[] = {
+        &ValidateEntryAt<Reader, Is>..., &SkipEntry<Reader>};
+
+    const std::size_t index = EntryIndex::Find(id);
+    if (index < Count) {
+      if ((*seen)[index])
+        return ErrorStatus::DuplicateTableEntry;
+      seen->set(index);
+    }
+
+    return functions[index](reader);
+  }
+
+  template <typename Reader, std::size_t Index>
+  static Status<void> ValidateEntryAt(Reader* reader) {
+    return ValidateEntry(static_cast<EntryAt<Index>*>(nullptr), reader);
+  }
+
+  template <typename T, std::uint64_t Id, typename Reader>
+  static Status<void> ValidateEntry(Entry<T, Id, ActiveEntry>* /*entry*/,
+                                    Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    // The value must fit within the binary container of the entry, which may
+    // also hold padding.
+    BoundedReaderScope<Reader> scope{reader, size};
+    status = scope.status();
+    if (!status)
+      return status;
+
+    status = Validate<T>(scope.reader());
+    if (!status)
+      return status;
+
+    return scope.ReadPadding();
+  }
+
+  template <typename T, std::uint64_t Id, typename Reader>
+  static Status<void> ValidateEntry(Entry<T, Id, DeletedEntry>* /*entry*/,
+                                    Reader* reader) {
+    return SkipEntry(reader);
+  }
+
+  template <typename Reader>
+  static Status<void> SkipEntry(Reader* reader) {
+    return SkipValueCommon::SkipPayload(reader);
+  }
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_VALIDATE_H_
@@ -65,6 +65,21 @@ struct Encoding<T, EnableIfIsValueWrapper<T>> : EncodingIO<T> {
   }
 };
 
+// Value wrappers have the same fixed encoding size as the wrapped type.
+template <typename T>
+struct FixedEncodingSize<T, EnableIfIsValueWrapper<T>>
+    : FixedEncodingSize<typename ValueWrapperTraits<T>::Pointer::Type> {};
+
+// Value wrappers have the same maximum encoding size as the wrapped type.
+template <typename T>
+struct MaxEncodingSize<T, EnableIfIsValueWrapper<T>>
+    : MaxEncodingSize<typename ValueWrapperTraits<T>::Pointer::Type> {};
+
+// Value wrappers overestimate their size when the wrapped type does.
+template <typename T>
+struct IsSizeOverestimated<T, EnableIfIsValueWrapper<T>>
+    : IsSizeOverestimated<typename ValueWrapperTraits<T>::Pointer::Type> {};
+
 }  // namespace nop
 
 #endif  // LIBNOP_INCLUDE_NOP_BASE_VALUE_H_
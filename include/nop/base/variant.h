@@ -120,7 +120,11 @@ struct Encoding<Variant<Ts...>> : EncodingIO<Variant<Ts...>> {
       return ErrorStatus::UnexpectedVariantType;
     }
 
-    value->Become(type);
+    // Decode into the active element in place when it already has the incoming
+    // type, so that long-lived variants keep the storage of their elements
+    // across messages. Otherwise replace it with a default-constructed element.
+    if (value->index() != type)
+      value->Become(type);
 
     return value->Visit([reader](auto&& element) {
       using Element = typename std::decay<decltype(element)>::type;
@@ -129,6 +133,25 @@ struct Encoding<Variant<Ts...>> : EncodingIO<Variant<Ts...>> {
   }
 };
 
+template <>
+struct MaxEncodingSize<EmptyVariant> : std::true_type {
+  enum : std::size_t { Size = BaseEncodingSize(EncodingByte::Nil) };
+};
+
+// Variants are bounded when every element type is bounded. The element may
+// also be the empty variant.
+template <typename... Ts>
+struct MaxEncodingSize<Variant<Ts...>>
+    : std::integral_constant<bool, And<MaxEncodingSize<Ts>...>::value> {
+  enum : std::size_t {
+    Size = And<MaxEncodingSize<Ts>...>::value
+               ? BaseEncodingSize(EncodingByte::Variant) +
+                     MaxEncodingSize<std::int32_t>::Size +
+                     MaxEncodingSizeLargest<EmptyVariant, Ts...>::value
+               : 0
+  };
+};
+
 }  // namespace nop
 
 #endif  // LIBNOP_INCLUDE_NOP_BASE_VARIANT_H_
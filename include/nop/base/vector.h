@@ -17,7 +17,7 @@
 #ifndef LIBNOP_INCLUDE_NOP_BASE_VECTOR_H_
 #define LIBNOP_INCLUDE_NOP_BASE_VECTOR_H_
 
-#include <numeric>
+#include <type_traits>
 #include <vector>
 
 #include <nop/base/encoding.h>
@@ -26,7 +26,7 @@
 namespace nop {
 
 //
-// std::vector<T> encoding format for non-integral types:
+// std::vector<T> encoding format for non-packable types:
 //
 // +-----+---------+-----//-----+
 // | ARY | INT64:N | N ELEMENTS |
@@ -34,7 +34,8 @@ namespace nop {
 //
 // Elements must be valid encodings of type T.
 //
-// std::vector<T> encoding format for integral types:
+// std::vector<T> encoding format for packable (integral, float, and double)
+// types:
 //
 // +-----+---------+---//----+
 // | BIN | INT64:L | L BYTES |
@@ -42,13 +43,19 @@ namespace nop {
 //
 // Where L = N * sizeof(T).
 //
-// Elements are stored as direct little-endian representation of the integral
-// value; each element is sizeof(T) bytes in size.
+// Elements are stored as direct little-endian representation of the value;
+// each element is sizeof(T) bytes in size. Floating point elements are IEEE 754
+// single or double precision values.
+//
+// Vectors of floating point and enum flags types also accept the ARY format
+// when reading, which older versions of the library used for these types.
+//
+// std::vector<bool> uses the bit-packed format in nop/base/bitset.h.
 //
 
-// Specialization for non-integral types.
+// Specialization for non-packable types.
 template <typename T, typename Allocator>
-struct Encoding<std::vector<T, Allocator>, EnableIfNotIntegral<T>>
+struct Encoding<std::vector<T, Allocator>, EnableIfNotPackable<T>>
     : EncodingIO<std::vector<T, Allocator>> {
   using Type = std::vector<T, Allocator>;
 
@@ -59,10 +66,7 @@ struct Encoding<std::vector<T, Allocator>, EnableIfNotIntegral<T>>
   static constexpr std::size_t Size(const Type& value) {
     return BaseEncodingSize(Prefix(value)) +
            Encoding<SizeType>::Size(value.size()) +
-           std::accumulate(value.cbegin(), value.cend(), 0U,
-                           [](const std::size_t& sum, const T& element) {
-                             return sum + Encoding<T>::Size(element);
-                           });
+           ElementsEncodingSize<T>(value);
   }
 
   static constexpr bool Match(EncodingByte prefix) {
@@ -74,12 +78,12 @@ struct Encoding<std::vector<T, Allocator>, EnableIfNotIntegral<T>>
                                              const Type& value,
                                              Writer* writer) {
     auto status = Encoding<SizeType>::Write(value.size(), writer);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
     for (const T& element : value) {
       status = Encoding<T>::Write(element, writer);
-      if (!status)
+      if (NOP_UNLIKELY(!status))
         return status;
     }
 
@@ -91,31 +95,55 @@ struct Encoding<std::vector<T, Allocator>, EnableIfNotIntegral<T>>
                                             Type* value, Reader* reader) {
     SizeType size = 0;
     auto status = Encoding<SizeType>::Read(&size, reader);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
-    // Clear the vector to make sure elements are inserted at the correct
-    // indices. Intentionally avoid calling reserve() to prevent abuse from very
-    // large size values. Regardless of the size specified in the encoding the
-    // bytes remaining in the reader provide a natural upper limit to the number
-    // of allocations.
-    value->clear();
-    for (SizeType i = 0; i < size; i++) {
-      T element;
-      status = Encoding<T>::Read(&element, reader);
-      if (!status)
-        return status;
+    // Elements already in the vector are decoded into in place and any extra
+    // elements are appended. Only reserve as many elements as could fit in the
+    // bytes remaining in the reader, to prevent abuse from very large size
+    // values.
+    value->reserve(ReserveCount(size, reader));
+    return ReadElements(size, value, reader, IsHoisted<Reader>{});
+  }
 
-      value->push_back(std::move(element));
-    }
+ private:
+  // Vectors of elements with a bounded encoding size read from contiguous
+  // input check the bytes remaining once for all of the elements, and then
+  // read them straight from the input without further bounds checks.
+  template <typename Reader>
+  using IsHoisted = And<MaxEncodingSize<T>, IsContiguousReader<Reader>>;
 
-    return {};
+  template <typename Reader>
+  static constexpr Status<void> ReadElements(SizeType size, Type* value,
+                                             Reader* reader, std::false_type) {
+    return ReadSequenceElements<T>(size, value, reader);
+  }
+
+  template <typename Reader>
+  static Status<void> ReadElements(SizeType size, Type* value, Reader* reader,
+                                   std::true_type) {
+    if (reader->remaining() / MaxEncodingSize<T>::Size < size)
+      return ReadElements(size, value, reader, std::false_type{});
+
+    auto data = reader->Borrow(0);
+    if (!data)
+      return data.error();
+
+    UncheckedReaderFor<Reader> unchecked_reader{data.get()};
+    auto status = ReadElements(size, value, &unchecked_reader,
+                               std::false_type{});
+    if (NOP_UNLIKELY(!status))
+      return status;
+
+    return reader->Skip(unchecked_reader.size());
   }
 };
 
-// Specialization for integral types.
+// Specialization for packable types, except for bool, which is bit-packed.
 template <typename T, typename Allocator>
-struct Encoding<std::vector<T, Allocator>, EnableIfIntegral<T>>
+struct Encoding<std::vector<T, Allocator>,
+                std::enable_if_t<IsPackable<T>::value &&
+                                 !std::is_same<T, bool>::value>>
     : EncodingIO<std::vector<T, Allocator>> {
   using Type = std::vector<T, Allocator>;
 
@@ -130,7 +158,8 @@ struct Encoding<std::vector<T, Allocator>, EnableIfIntegral<T>>
   }
 
   static constexpr bool Match(EncodingByte prefix) {
-    return prefix == EncodingByte::Binary;
+    return prefix == EncodingByte::Binary ||
+           (HasLegacyArrayFormat<T>::value && prefix == EncodingByte::Array);
   }
 
   template <typename Writer>
@@ -140,20 +169,23 @@ struct Encoding<std::vector<T, Allocator>, EnableIfIntegral<T>>
     const SizeType length = value.size();
     const SizeType length_bytes = length * sizeof(T);
     auto status = Encoding<SizeType>::Write(length_bytes, writer);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
-    return writer->Write(&value[0], &value[length]);
+    return WritePacked(&value[0], &value[length], writer);
   }
 
   template <typename Reader>
-  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
-                                            Type* value, Reader* reader) {
+  static constexpr Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                            Reader* reader) {
     SizeType size = 0;
     auto status = Encoding<SizeType>::Read(&size, reader);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
+    if (prefix == EncodingByte::Array)
+      return ReadElements(size, value, reader);
+
     if (size % sizeof(T) != 0)
       return ErrorStatus::InvalidContainerLength;
 
@@ -162,11 +194,29 @@ struct Encoding<std::vector<T, Allocator>, EnableIfIntegral<T>>
     // Make sure the reader has enough data to fulfill the requested size as a
     // defense against abusive or erroneous vector sizes.
     status = reader->Ensure(length);
-    if (!status)
+    if (NOP_UNLIKELY(!status))
       return status;
 
     value->resize(length);
-    return reader->Read(&(*value)[0], &(*value)[length]);
+    return ReadPacked(&(*value)[0], &(*value)[length], reader);
+  }
+
+ private:
+  // Reads |size| individually encoded elements of the legacy ARY format.
+  template <typename Reader>
+  static constexpr Status<void> ReadElements(SizeType size, Type* value,
+                                             Reader* reader) {
+    value->clear();
+    for (SizeType i = 0; i < size; i++) {
+      T element;
+      auto status = Encoding<T>::Read(&element, reader);
+      if (NOP_UNLIKELY(!status))
+        return status;
+
+      value->push_back(element);
+    }
+
+    return {};
   }
 };
 
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_BASE_VIEW_H_
+#define LIBNOP_INCLUDE_NOP_BASE_VIEW_H_
+
+#include <type_traits>
+
+#include <nop/base/encoding.h>
+#include <nop/base/interned_string.h>
+#include <nop/types/view.h>
+
+namespace nop {
+
+//
+// BasicStringView<CharType> encoding format:
+//
+// +-----+---------+---//----+
+// | STR | INT64:N | N BYTES |
+// +-----+---------+---//----+
+//
+// ArrayView<T> encoding format:
+//
+// +-----+---------+---//----+
+// | BIN | INT64:N | N BYTES |
+// +-----+---------+---//----+
+//
+// These are the same formats as std::basic_string and std::vector with
+// integral elements. Deserializing a view requires a reader that implements
+// Borrow(size), which returns a pointer to the next |size| bytes of the input.
+//
+// String views also read the interned string formats described in
+// nop/base/interned_string.h from readers that keep a table of interned
+// strings. These views refer to the table, so that repeated strings share the
+// single copy made when the string is defined.
+//
+
+template <typename CharType>
+struct Encoding<BasicStringView<CharType>>
+    : EncodingIO<BasicStringView<CharType>> {
+  using Type = BasicStringView<CharType>;
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::String;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    return BaseEncodingSize(Prefix(value)) +
+           Encoding<SizeType>::Size(value.size()) + value.size();
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::String ||
+           prefix == EncodingByte::Extension;
+  }
+
+  template <typename Writer>
+  static Status<void> Write(const Type& value, Writer* writer) {
+    return Write(value, writer, IsInterningWriter<Writer>{});
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte /*prefix*/,
+                                             const Type& value,
+                                             Writer* writer) {
+    auto status = Encoding<SizeType>::Write(value.size(), writer);
+    if (!status)
+      return status;
+
+    return writer->Write(value.begin(), value.end());
+  }
+
+  template <typename Reader>
+  static Status<void> ReadPayload(EncodingByte prefix, Type* value,
+                                  Reader* reader) {
+    if (prefix == EncodingByte::Extension) {
+      auto string = InternedString::Read(reader);
+      if (!string)
+        return string.error();
+
+      *value = Type{reinterpret_cast<const CharType*>(string.get()->data()),
+                    string.get()->size()};
+      return {};
+    }
+
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    auto data = reader->Borrow(size);
+    if (!data)
+      return data.error();
+
+    *value = Type{reinterpret_cast<const CharType*>(data.get()), size};
+    return {};
+  }
+
+ private:
+  template <typename Writer>
+  static Status<void> Write(const Type& value, Writer* writer,
+                            std::false_type) {
+    return EncodingIO<Type>::Write(value, writer);
+  }
+
+  template <typename Writer>
+  static Status<void> Write(const Type& value, Writer* writer,
+                            std::true_type) {
+    bool interned = false;
+    auto status =
+        InternedString::Write(value.data(), value.size(), writer, &interned);
+    if (!status || interned)
+      return status;
+    else
+      return EncodingIO<Type>::Write(value, writer);
+  }
+};
+
+template <typename T>
+struct Encoding<ArrayView<T>> : EncodingIO<ArrayView<T>> {
+  using Type = ArrayView<T>;
+
+  static constexpr EncodingByte Prefix(const Type& /*value*/) {
+    return EncodingByte::Binary;
+  }
+
+  static constexpr std::size_t Size(const Type& value) {
+    return BaseEncodingSize(Prefix(value)) +
+           Encoding<SizeType>::Size(value.size()) + value.size();
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return prefix == EncodingByte::Binary;
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte /*prefix*/,
+                                             const Type& value,
+                                             Writer* writer) {
+    auto status = Encoding<SizeType>::Write(value.size(), writer);
+    if (!status)
+      return status;
+
+    return writer->Write(value.begin(), value.end());
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(EncodingByte /*prefix*/,
+                                            Type* value, Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status;
+
+    auto data = reader->Borrow(size);
+    if (!data)
+      return data.error();
+
+    *value = Type{reinterpret_cast<const T*>(data.get()), size};
+    return {};
+  }
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_BASE_VIEW_H_
@@ -0,0 +1,310 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_RPC_COROUTINE_H_
+#define LIBNOP_INCLUDE_NOP_RPC_COROUTINE_H_
+
+// Coroutine support requires C++20. In earlier language modes this header only
+// defines the traits used by interface.h, and NOP_HAS_COROUTINES is zero.
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define NOP_HAS_COROUTINES 1
+#else
+#define NOP_HAS_COROUTINES 0
+#endif
+
+#include <type_traits>
+#include <utility>
+
+#if NOP_HAS_COROUTINES
+#include <coroutine>
+#include <exception>
+#include <optional>
+#endif
+
+#include <nop/status.h>
+#include <nop/traits/void.h>
+
+namespace nop {
+
+#if NOP_HAS_COROUTINES
+
+//
+// Coroutine support for remote interfaces.
+//
+// Task<T> is the coroutine type of interface method handlers that complete
+// asynchronously: a handler bound with InterfaceMethod::Bind() may return
+// Task<Return> instead of Return, in which case the receiver sends the return
+// value when the task completes instead of when the handler returns. On the
+// calling side InterfaceMethod::InvokeAsync() without a completion returns an
+// awaitable that resumes the awaiting coroutine with the Status<Return> of the
+// method when the sender receives the return value.
+//
+// Example:
+//
+//   nop::Task<int> OnSum(int a, int b) {
+//     co_await SomethingSlow();
+//     co_return a + b;
+//   }
+//
+//   nop::Task<void> Client(Sender* sender) {
+//     nop::Status<int> sum = co_await MyInterface::Sum::InvokeAsync(sender, 1,
+//                                                                   2);
+//     ...
+//   }
+//
+//   nop::Spawn(Client(&sender));
+//   while (sender.pending() != 0)
+//     sender.ReceiveReturn();  // Resumes Client() when the sum arrives.
+//
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+// Promise state common to every Task type. Tasks start suspended and resume
+// the coroutine awaiting them, if any, when they finish.
+struct TaskPromiseBase {
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> handle) const noexcept {
+      return handle.promise().continuation;
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() const noexcept { std::terminate(); }
+
+  std::coroutine_handle<> continuation{std::noop_coroutine()};
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+  Task<T> get_return_object();
+  void return_value(T value) { result.emplace(std::move(value)); }
+  T take() { return std::move(*result); }
+
+  std::optional<T> result;
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+  Task<void> get_return_object();
+  void return_void() const noexcept {}
+  void take() const noexcept {}
+};
+
+// Coroutine type that starts immediately and destroys itself when it finishes.
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+template <typename T>
+DetachedTask RunDetached(Task<T> task) {
+  co_await task;
+}
+
+}  // namespace detail
+
+// Task is a lazily started coroutine that produces a value of type T. The
+// coroutine runs when the task is awaited, and the awaiting coroutine resumes
+// with the value when the coroutine finishes. Tasks are move-only and destroy
+// the coroutine when they are destroyed.
+template <typename T>
+class Task {
+ public:
+  using promise_type = detail::TaskPromise<T>;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  Task(Task&& other) noexcept : handle_{std::exchange(other.handle_, {})} {}
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      if (handle_)
+        handle_.destroy();
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+
+  ~Task() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  bool await_ready() const noexcept { return false; }
+
+  std::coroutine_handle<> await_suspend(
+      std::coroutine_handle<> continuation) noexcept {
+    handle_.promise().continuation = continuation;
+    return handle_;
+  }
+
+  T await_resume() { return handle_.promise().take(); }
+
+ private:
+  friend promise_type;
+
+  explicit Task(Handle handle) : handle_{handle} {}
+
+  Handle handle_;
+};
+
+template <typename T>
+Task<T> detail::TaskPromise<T>::get_return_object() {
+  return Task<T>{Task<T>::Handle::from_promise(*this)};
+}
+
+inline Task<void> detail::TaskPromise<void>::get_return_object() {
+  return Task<void>{Task<void>::Handle::from_promise(*this)};
+}
+
+// Runs the given task without waiting for it. The task runs until its first
+// suspension point before this function returns and is destroyed when it
+// finishes.
+template <typename T>
+void Spawn(Task<T> task) {
+  detail::RunDetached(std::move(task));
+}
+
+// Awaitable returned by InterfaceMethod::InvokeAsync() when called without a
+// completion. Awaiting it writes the invocation with |send| and suspends the
+// awaiting coroutine until the sender completes the invocation, or resumes it
+// immediately with the error if the invocation cannot be written.
+template <typename Return, typename Send>
+class MethodAwaiter {
+ public:
+  explicit MethodAwaiter(Send send) : send_{std::move(send)} {}
+
+  bool await_ready() const noexcept { return false; }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    auto status = send_([this, handle](Status<Return> result) {
+      result_ = std::move(result);
+      handle.resume();
+    });
+    if (!status) {
+      result_ = status.error();
+      return false;
+    }
+    return true;
+  }
+
+  Status<Return> await_resume() { return std::move(result_); }
+
+ private:
+  Send send_;
+  Status<Return> result_;
+};
+
+template <typename Return, typename Send>
+MethodAwaiter<Return, Send> MakeMethodAwaiter(Send send) {
+  return MethodAwaiter<Return, Send>{std::move(send)};
+}
+
+// Sends the return value of an invocation after the dispatch that read it has
+// returned. Receivers that tag return values with a request id, such as
+// PipelinedMethodReceiver, have the id of the invocation recorded when it is
+// dispatched, since other invocations may be read before the return value is
+// sent.
+template <typename Receiver, typename Enable = void>
+struct DeferredReturn {
+  explicit DeferredReturn(Receiver* receiver) : receiver{receiver} {}
+
+  template <typename Return>
+  Status<void> operator()(const Return& return_value) const {
+    return receiver->SendReturn(return_value);
+  }
+
+  Receiver* receiver;
+};
+
+template <typename Receiver>
+struct DeferredReturn<Receiver,
+                      Void<decltype(std::declval<Receiver&>().request_id())>> {
+  using RequestId =
+      std::decay_t<decltype(std::declval<Receiver&>().request_id())>;
+
+  explicit DeferredReturn(Receiver* receiver)
+      : receiver{receiver}, request_id{receiver->request_id()} {}
+
+  template <typename Return>
+  Status<void> operator()(const Return& return_value) const {
+    return receiver->SendReturn(request_id, return_value);
+  }
+
+  Receiver* receiver;
+  RequestId request_id;
+};
+
+// Runs the task returned by |start| and sends its value with |reply| when it
+// completes. The start function object, which owns the arguments of the
+// invocation, lives in the coroutine frame until the task finishes.
+template <typename Reply, typename Start>
+detail::DetachedTask RespondAsync(Reply reply, std::false_type /*one_way*/,
+                                  Start start) {
+  auto return_value = co_await start();
+  reply(return_value);
+}
+
+// Runs the task returned by |start| for a one-way method, which has nothing to
+// send back.
+template <typename Reply, typename Start>
+detail::DetachedTask RespondAsync(Reply /*reply*/, std::true_type /*one_way*/,
+                                  Start start) {
+  co_await start();
+}
+
+#endif  // NOP_HAS_COROUTINES
+
+// Evaluates to the value type produced by a handler returning T: the type
+// awaited from a Task, or T itself for handlers that complete synchronously.
+template <typename T>
+struct AwaitedReturn {
+  using Type = T;
+};
+
+#if NOP_HAS_COROUTINES
+template <typename T>
+struct AwaitedReturn<Task<T>> {
+  using Type = T;
+};
+#endif
+
+// Evaluates to the given signature with the return type replaced by the type
+// it produces, for checking handlers against interface method signatures.
+template <typename Signature>
+struct AwaitedSignature;
+
+template <typename Return, typename... Args>
+struct AwaitedSignature<Return(Args...)> {
+  using Type = typename AwaitedReturn<Return>::Type(Args...);
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_RPC_COROUTINE_H_
@@ -0,0 +1,528 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_RPC_EPOLL_METHOD_SERVER_H_
+#define LIBNOP_INCLUDE_NOP_RPC_EPOLL_METHOD_SERVER_H_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <nop/rpc/simple_method_receiver.h>
+#include <nop/serializer.h>
+#include <nop/status.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/frame_scanner.h>
+#include <nop/utility/vector_writer.h>
+
+namespace nop {
+
+// EpollMethodServer serves remote interface invocations from many stream
+// socket connections on a single thread. Connections are non-blocking and
+// multiplexed with epoll. Input from each connection is accumulated in a
+// per-connection buffer and framed with FrameScanner; each complete invocation
+// is decoded from the buffer with BufferReader and dispatched with the given
+// dispatch table, which is usually created by BindInterface(). Replies are
+// encoded with VectorWriter and written back to the connection, waiting for
+// the socket to become writable when it is full.
+//
+// The Receiver template determines the format of invocations and replies, for
+// example SimpleMethodReceiver or PipelinedMethodReceiver, and provides the
+// number of top-level values that make up each invocation.
+//
+// Connections are closed when the peer closes them, when they send input that
+// fails to frame or dispatch, or when a single invocation grows larger than
+// the maximum invocation size. The server owns the connections and listening
+// sockets added to it and closes them when it is destroyed.
+//
+// By default invocations are dispatched on the polling thread. SetExecutor()
+// hands each invocation to an executor instead, such as WorkStealingExecutor,
+// so that expensive handlers run concurrently. The replies of each connection
+// are still written in the order of its invocations. The dispatch table must
+// be safe to call from several threads at once in this case.
+//
+// Example:
+//
+//   auto dispatcher = nop::BindInterface(MyInterface::Sum::Bind(OnSum));
+//   nop::EpollMethodServer<decltype(dispatcher)> server{dispatcher};
+//   server.Listen(listen_fd);
+//   while (true)
+//     server.Poll();
+//
+template <typename Dispatcher,
+          template <typename...> class Receiver = SimpleMethodReceiver>
+class EpollMethodServer {
+ public:
+  using SerializerType = Serializer<VectorWriter>;
+  using DeserializerType = Deserializer<BufferReader>;
+  using ReceiverType = Receiver<SerializerType, DeserializerType>;
+
+  enum : std::size_t {
+    kDefaultMaxInvocationSize = 1 << 20,
+    kReadSize = 4096,
+    kMaxEvents = 64,
+  };
+
+  explicit EpollMethodServer(
+      Dispatcher dispatcher,
+      std::size_t max_invocation_size = kDefaultMaxInvocationSize)
+      : shared_{std::make_shared<Shared>(std::move(dispatcher))},
+        max_invocation_size_{max_invocation_size},
+        epoll_fd_{::epoll_create1(EPOLL_CLOEXEC)} {
+    const int event_fd = shared_->event_fd;
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = kCompletionId;
+    if (epoll_fd_ >= 0 &&
+        (event_fd < 0 ||
+         ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd, &event) < 0)) {
+      ::close(epoll_fd_);
+      epoll_fd_ = -1;
+    }
+  }
+
+  EpollMethodServer(const EpollMethodServer&) = delete;
+  EpollMethodServer& operator=(const EpollMethodServer&) = delete;
+
+  ~EpollMethodServer() {
+    for (auto& connection : connections_)
+      ::close(connection.second.fd);
+    if (epoll_fd_ >= 0)
+      ::close(epoll_fd_);
+  }
+
+  // Dispatches invocations with the given executor, which must outlive the
+  // server and provide Submit(std::function<void()> task, std::size_t hint).
+  // The hint identifies the connection the invocation came from. The executor
+  // should be set before connections are added.
+  template <typename Executor>
+  void SetExecutor(Executor* executor) {
+    executor_ = [executor](std::function<void()> task, std::size_t hint) {
+      executor->Submit(std::move(task), hint);
+    };
+  }
+
+  // Adds a connected stream socket to the server, which takes ownership of it
+  // and makes it non-blocking. The socket is closed if it cannot be added.
+  Status<void> AddConnection(int fd) { return Add(fd, false); }
+
+  // Adds a listening socket to the server, which takes ownership of it and
+  // adds the connections it accepts. The socket is closed if it cannot be
+  // added.
+  Status<void> Listen(int fd) { return Add(fd, true); }
+
+  // Closes the given connection or listening socket.
+  void RemoveConnection(int fd) {
+    for (auto& connection : connections_) {
+      if (connection.second.fd == fd) {
+        Close(connection.first);
+        return;
+      }
+    }
+  }
+
+  // Waits up to |timeout_ms| milliseconds for activity on the connections,
+  // or indefinitely when it is negative, and handles the activity. Returns
+  // the number of invocations dispatched, or completed by the executor when
+  // one is set.
+  Status<std::size_t> Poll(int timeout_ms = -1) {
+    if (epoll_fd_ < 0)
+      return ErrorStatus::IOError;
+
+    epoll_event events[kMaxEvents];
+    const int count = ::epoll_wait(epoll_fd_, events, kMaxEvents, timeout_ms);
+    if (count < 0) {
+      if (errno == EINTR)
+        return 0;
+      else
+        return ErrorStatus::IOError;
+    }
+
+    std::size_t dispatched = 0;
+    for (int i = 0; i < count; i++) {
+      const std::uint64_t id = events[i].data.u64;
+      if (id == kCompletionId) {
+        dispatched += Complete();
+        continue;
+      }
+
+      auto search = connections_.find(id);
+      if (search == connections_.end())
+        continue;
+
+      Connection& connection = search->second;
+      if (connection.listening) {
+        Accept(connection.fd);
+        continue;
+      }
+
+      Status<void> status;
+      if (events[i].events & EPOLLOUT)
+        status = Flush(id, &connection);
+
+      if (status && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+        auto receive_status = Receive(id, &connection);
+        if (receive_status)
+          dispatched += receive_status.get();
+        else
+          status = receive_status.error();
+      }
+
+      if (!status)
+        Close(id);
+    }
+
+    return dispatched;
+  }
+
+  // Returns the number of open connections, not counting listening sockets.
+  std::size_t connections() const {
+    std::size_t count = 0;
+    for (const auto& connection : connections_) {
+      if (!connection.second.listening)
+        count++;
+    }
+    return count;
+  }
+
+  const Dispatcher& dispatcher() const { return shared_->dispatcher; }
+  Dispatcher& dispatcher() { return shared_->dispatcher; }
+
+ private:
+  // The epoll id of the eventfd that signals completed invocations.
+  enum : std::uint64_t { kCompletionId = 0 };
+
+  // A reply produced by an invocation dispatched on the executor.
+  struct Completion {
+    std::uint64_t connection;
+    std::uint64_t sequence;
+    Status<void> status;
+    std::vector<std::uint8_t> reply;
+  };
+
+  // State shared with invocations running on the executor, which may complete
+  // after the server is destroyed.
+  struct Shared {
+    explicit Shared(Dispatcher dispatcher)
+        : dispatcher{std::move(dispatcher)},
+          event_fd{::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)} {}
+    ~Shared() {
+      if (event_fd >= 0)
+        ::close(event_fd);
+    }
+
+    Dispatcher dispatcher;
+    int event_fd;
+    std::mutex mutex;
+    std::vector<Completion> completions;
+  };
+
+  struct Connection {
+    int fd;
+    bool listening{false};
+
+    // Input that has not been dispatched yet, starting with the invocation
+    // being framed, and the scanner state of the next value in it.
+    std::vector<std::uint8_t> input;
+    std::size_t scanned{0};
+    std::size_t values{0};
+    FrameScanner scanner;
+
+    // Replies that have not been written yet.
+    std::vector<std::uint8_t> output;
+    bool waiting_writable{false};
+
+    // The sequence numbers of the next invocation handed to the executor and
+    // of the next reply to write, and the replies that completed ahead of it.
+    std::uint64_t next_sequence{0};
+    std::uint64_t next_reply{0};
+    std::map<std::uint64_t, std::vector<std::uint8_t>> ready;
+  };
+
+  Status<void> Add(int fd, bool listening) {
+    const int flags = ::fcntl(fd, F_GETFL);
+    if (epoll_fd_ < 0 || flags < 0 ||
+        ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+      ::close(fd);
+      return ErrorStatus::IOError;
+    }
+
+    // Connections are identified by an id that is never reused, rather than
+    // by descriptor, so that replies completed after a connection closes are
+    // not written to a new connection that reuses its descriptor.
+    const std::uint64_t id = ++last_id_;
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = id;
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+      ::close(fd);
+      return ErrorStatus::IOError;
+    }
+
+    Connection& connection = connections_[id];
+    connection.fd = fd;
+    connection.listening = listening;
+    return {};
+  }
+
+  void Close(std::uint64_t id) {
+    auto search = connections_.find(id);
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, search->second.fd, nullptr);
+    ::close(search->second.fd);
+    connections_.erase(search);
+  }
+
+  // Accepts the pending connections on the given listening socket.
+  void Accept(int listen_fd) {
+    while (true) {
+      const int fd = ::accept4(listen_fd, nullptr, nullptr,
+                               SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd >= 0)
+        Add(fd, false);
+      else if (errno != EINTR)
+        break;
+    }
+  }
+
+  // Reads the available input from the connection and dispatches the complete
+  // invocations in it. Returns the number of invocations dispatched.
+  Status<std::size_t> Receive(std::uint64_t id, Connection* connection) {
+    std::vector<std::uint8_t>& input = connection->input;
+    const std::size_t size = input.size();
+    input.resize(size + kReadSize);
+
+    ssize_t ret;
+    do {
+      ret = ::read(connection->fd, &input[size], kReadSize);
+    } while (ret < 0 && errno == EINTR);
+
+    input.resize(size + (ret > 0 ? static_cast<std::size_t>(ret) : 0));
+    if (ret == 0)
+      return ErrorStatus::ReadLimitReached;
+    else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return 0;
+    else if (ret < 0)
+      return ErrorStatus::IOError;
+
+    auto status = Process(id, connection);
+    if (!status)
+      return status;
+
+    auto flush_status = Flush(id, connection);
+    if (!flush_status)
+      return flush_status.error();
+
+    return status;
+  }
+
+  // Frames and dispatches the complete invocations in the input buffer,
+  // leaving any partial invocation in the buffer. Returns the number of
+  // invocations dispatched on this thread.
+  Status<std::size_t> Process(std::uint64_t id, Connection* connection) {
+    std::vector<std::uint8_t>& input = connection->input;
+    std::size_t begin = 0;
+    std::size_t dispatched = 0;
+
+    while (connection->scanned < input.size()) {
+      auto status = connection->scanner.Scan(
+          &input[connection->scanned], input.size() - connection->scanned);
+      if (!status)
+        return status.error();
+
+      connection->scanned += status.get();
+      if (!connection->scanner.complete())
+        break;
+
+      connection->scanner.Reset();
+      if (++connection->values < ReceiverType::InvocationValues)
+        continue;
+
+      if (executor_) {
+        Submit(id, connection, &input[begin], connection->scanned - begin);
+      } else {
+        auto dispatch_status = Dispatch(&input[begin],
+                                        connection->scanned - begin,
+                                        &connection->output);
+        if (!dispatch_status)
+          return dispatch_status.error();
+        dispatched++;
+      }
+
+      connection->values = 0;
+      begin = connection->scanned;
+    }
+
+    input.erase(input.begin(), input.begin() + begin);
+    connection->scanned -= begin;
+
+    if (input.size() > max_invocation_size_)
+      return ErrorStatus::ReadLimitReached;
+    else
+      return dispatched;
+  }
+
+  // Dispatches the invocation in the given buffer and appends the reply, if
+  // any, to |output|.
+  Status<void> Dispatch(const std::uint8_t* data, std::size_t size,
+                        std::vector<std::uint8_t>* output) {
+    DeserializerType deserializer{data, size};
+    ReceiverType receiver{&serializer_, &deserializer};
+
+    auto status = shared_->dispatcher(&receiver);
+    const VectorWriter& writer = serializer_.writer();
+    output->insert(output->end(), writer.data(), writer.data() + writer.size());
+    serializer_.writer().reset();
+    return status;
+  }
+
+  // Hands a copy of the invocation in the given buffer to the executor, which
+  // dispatches it and queues the reply for Complete().
+  void Submit(std::uint64_t id, Connection* connection,
+              const std::uint8_t* data, std::size_t size) {
+    std::shared_ptr<Shared> shared = shared_;
+    const std::uint64_t sequence = connection->next_sequence++;
+    std::vector<std::uint8_t> invocation{data, data + size};
+
+    auto task = [shared, id, sequence, invocation] {
+      SerializerType serializer;
+      DeserializerType deserializer{invocation.data(), invocation.size()};
+      ReceiverType receiver{&serializer, &deserializer};
+      Completion completion{id, sequence, shared->dispatcher(&receiver),
+                            serializer.writer().take()};
+
+      {
+        std::lock_guard<std::mutex> lock{shared->mutex};
+        shared->completions.push_back(std::move(completion));
+      }
+
+      const std::uint64_t value = 1;
+      ssize_t ret;
+      do {
+        ret = ::write(shared->event_fd, &value, sizeof(value));
+      } while (ret < 0 && errno == EINTR);
+    };
+
+    executor_(std::move(task), static_cast<std::size_t>(id));
+  }
+
+  // Writes the replies of the invocations completed by the executor, in the
+  // order of the invocations of each connection. Returns the number of
+  // invocations completed.
+  std::size_t Complete() {
+    std::uint64_t value;
+    while (::read(shared_->event_fd, &value, sizeof(value)) < 0 &&
+           errno == EINTR) {
+    }
+
+    std::vector<Completion> completions;
+    {
+      std::lock_guard<std::mutex> lock{shared_->mutex};
+      std::swap(completions, shared_->completions);
+    }
+
+    for (Completion& completion : completions) {
+      auto search = connections_.find(completion.connection);
+      if (search == connections_.end())
+        continue;
+
+      Connection& connection = search->second;
+      if (!completion.status) {
+        Close(completion.connection);
+        continue;
+      }
+
+      connection.ready.emplace(completion.sequence,
+                               std::move(completion.reply));
+      auto next = connection.ready.begin();
+      for (; next != connection.ready.end() &&
+             next->first == connection.next_reply;
+           next = connection.ready.erase(next)) {
+        connection.output.insert(connection.output.end(),
+                                 next->second.begin(), next->second.end());
+        connection.next_reply++;
+      }
+    }
+
+    for (const Completion& completion : completions) {
+      auto search = connections_.find(completion.connection);
+      if (search != connections_.end() &&
+          !Flush(completion.connection, &search->second)) {
+        Close(completion.connection);
+      }
+    }
+
+    return completions.size();
+  }
+
+  // Writes as much of the pending replies as the socket accepts, waiting for
+  // the socket to become writable when replies remain.
+  Status<void> Flush(std::uint64_t id, Connection* connection) {
+    const int fd = connection->fd;
+    std::vector<std::uint8_t>& output = connection->output;
+    std::size_t offset = 0;
+
+    while (offset < output.size()) {
+      const ssize_t ret = ::send(fd, &output[offset], output.size() - offset,
+                                 MSG_NOSIGNAL);
+      if (ret > 0)
+        offset += static_cast<std::size_t>(ret);
+      else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+      else if (ret == 0 || errno != EINTR)
+        return ErrorStatus::IOError;
+    }
+
+    output.erase(output.begin(), output.begin() + offset);
+
+    const bool waiting_writable = !output.empty();
+    if (waiting_writable != connection->waiting_writable) {
+      epoll_event event = {};
+      event.events = waiting_writable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+      event.data.u64 = id;
+      if (::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) < 0)
+        return ErrorStatus::IOError;
+      connection->waiting_writable = waiting_writable;
+    }
+
+    return {};
+  }
+
+  std::shared_ptr<Shared> shared_;
+  std::size_t max_invocation_size_;
+  int epoll_fd_;
+  std::uint64_t last_id_{kCompletionId};
+  std::unordered_map<std::uint64_t, Connection> connections_;
+  SerializerType serializer_;
+  std::function<void(std::function<void()>, std::size_t)> executor_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_RPC_EPOLL_METHOD_SERVER_H_
@@ -0,0 +1,384 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_RPC_INSTRUMENTED_BINDINGS_H_
+#define LIBNOP_INCLUDE_NOP_RPC_INSTRUMENTED_BINDINGS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <utility>
+
+#include <nop/base/encoding.h>
+#include <nop/status.h>
+
+namespace nop {
+
+//
+// Instrumentation for dispatch tables created by BindInterface().
+//
+// InstrumentedBindings wraps a dispatch table and records, for each bound
+// method, the number of calls and failed dispatches, histograms of the time
+// spent decoding the arguments, running the handler, and encoding the return
+// value, and the total encoded size of the arguments and return values. The
+// statistics are pulled with stats(), which may be called from any thread
+// while other threads dispatch.
+//
+// Each dispatching thread accumulates into one of a fixed number of stripes of
+// relaxed atomic counters, so recording costs a few uncontended atomic adds
+// and three clock reads per call; stats() sums the stripes.
+//
+// Handlers that complete asynchronously, by returning Task<T>, are timed up to
+// the point they first suspend and their return values are not counted.
+//
+// Example:
+//
+//   auto dispatcher = nop::Instrument(nop::BindInterface(
+//       MyInterface::Sum::Bind(OnSum), MyInterface::Log::Bind(OnLog)));
+//   while (dispatcher(&receiver)) {}
+//
+//   nop::MethodStats sum = dispatcher.stats(MyInterface::Sum::Selector);
+//   printf("%llu calls, %llu ns mean handler time\n", sum.calls,
+//          sum.handler.mean());
+//
+
+// Histogram of durations in nanoseconds with power-of-two buckets: bucket 0
+// counts durations under 1ns and bucket i durations in [2^(i-1), 2^i) ns. The
+// last bucket also counts everything longer.
+struct LatencyHistogram {
+  enum : std::size_t { BucketCount = 40 };
+
+  std::uint64_t buckets[BucketCount] = {};
+  std::uint64_t count{0};
+  std::uint64_t total_ns{0};
+
+  // Returns the bucket that counts the given duration.
+  static std::size_t Bucket(std::uint64_t ns) {
+    std::size_t bucket = 0;
+    while (ns != 0 && bucket < BucketCount - 1) {
+      ns >>= 1;
+      bucket++;
+    }
+    return bucket;
+  }
+
+  // Returns the upper bound of the given bucket in nanoseconds.
+  static std::uint64_t UpperBound(std::size_t bucket) {
+    return std::uint64_t{1} << bucket;
+  }
+
+  std::uint64_t mean() const { return count ? total_ns / count : 0; }
+
+  // Returns the upper bound of the bucket that contains the given fraction of
+  // the durations, for example 0.99 for the 99th percentile.
+  std::uint64_t Percentile(double fraction) const {
+    const auto target = static_cast<std::uint64_t>(fraction * count);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < BucketCount; i++) {
+      seen += buckets[i];
+      if (seen > target || seen == count)
+        return UpperBound(i);
+    }
+    return 0;
+  }
+};
+
+// Statistics of one bound method, or of invocations that matched none.
+struct MethodStats {
+  // The number of dispatches and the number of them that returned an error.
+  std::uint64_t calls{0};
+  std::uint64_t errors{0};
+
+  // The encoded size in bytes of the arguments and return values, excluding
+  // the method selector and any framing added by the receiver.
+  std::uint64_t request_bytes{0};
+  std::uint64_t response_bytes{0};
+
+  LatencyHistogram decode;
+  LatencyHistogram handler;
+  LatencyHistogram encode;
+};
+
+namespace detail {
+
+// Returns the counter stripe of the calling thread. Threads are assigned
+// stripes in turn the first time they dispatch.
+inline std::size_t InstrumentationStripe() {
+  static std::atomic<std::size_t> next{0};
+  static thread_local const std::size_t stripe =
+      next.fetch_add(1, std::memory_order_relaxed);
+  return stripe;
+}
+
+struct AtomicHistogram {
+  std::atomic<std::uint64_t> buckets[LatencyHistogram::BucketCount] = {};
+  std::atomic<std::uint64_t> count{0};
+  std::atomic<std::uint64_t> total_ns{0};
+
+  void Record(std::uint64_t ns) {
+    buckets[LatencyHistogram::Bucket(ns)].fetch_add(1,
+                                                    std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    total_ns.fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  void AddTo(LatencyHistogram* histogram) const {
+    for (std::size_t i = 0; i < LatencyHistogram::BucketCount; i++)
+      histogram->buckets[i] += buckets[i].load(std::memory_order_relaxed);
+    histogram->count += count.load(std::memory_order_relaxed);
+    histogram->total_ns += total_ns.load(std::memory_order_relaxed);
+  }
+
+  void Reset() {
+    for (auto& bucket : buckets)
+      bucket.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    total_ns.store(0, std::memory_order_relaxed);
+  }
+};
+
+// The counters of one method in one stripe. Counters span many cache lines, so
+// threads in different stripes rarely share a line.
+struct MethodCounters {
+  std::atomic<std::uint64_t> calls{0};
+  std::atomic<std::uint64_t> errors{0};
+  std::atomic<std::uint64_t> request_bytes{0};
+  std::atomic<std::uint64_t> response_bytes{0};
+  AtomicHistogram decode;
+  AtomicHistogram handler;
+  AtomicHistogram encode;
+
+  void AddTo(MethodStats* stats) const {
+    stats->calls += calls.load(std::memory_order_relaxed);
+    stats->errors += errors.load(std::memory_order_relaxed);
+    stats->request_bytes += request_bytes.load(std::memory_order_relaxed);
+    stats->response_bytes += response_bytes.load(std::memory_order_relaxed);
+    decode.AddTo(&stats->decode);
+    handler.AddTo(&stats->handler);
+    encode.AddTo(&stats->encode);
+  }
+
+  void Reset() {
+    calls.store(0, std::memory_order_relaxed);
+    errors.store(0, std::memory_order_relaxed);
+    request_bytes.store(0, std::memory_order_relaxed);
+    response_bytes.store(0, std::memory_order_relaxed);
+    decode.Reset();
+    handler.Reset();
+    encode.Reset();
+  }
+};
+
+// Receiver wrapper that times each step of a dispatch and measures the values
+// passing through it. Only the steps of one dispatch are timed, so a new
+// instance is used for each invocation.
+template <typename Receiver>
+class InstrumentedReceiver {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  InstrumentedReceiver(Receiver* receiver, MethodCounters* counters)
+      : receiver_{receiver}, counters_{counters} {}
+
+  template <typename... Args>
+  Status<void> GetArgs(std::tuple<Args...>* args) {
+    const auto start = Clock::now();
+    auto status = receiver_->GetArgs(args);
+    decoded_ = Clock::now();
+    counters_->decode.Record(Elapsed(start, decoded_));
+    if (status) {
+      counters_->request_bytes.fetch_add(
+          Encoding<std::tuple<Args...>>::Size(*args),
+          std::memory_order_relaxed);
+    }
+    return status;
+  }
+
+  template <typename Return>
+  Status<void> SendReturn(const Return& return_value) {
+    RecordHandler();
+    return Encode(return_value,
+                  [&] { return receiver_->SendReturn(return_value); });
+  }
+
+  template <typename RequestId, typename Return>
+  Status<void> SendReturn(RequestId request_id, const Return& return_value) {
+    RecordHandler();
+    return Encode(return_value, [&] {
+      return receiver_->SendReturn(request_id, return_value);
+    });
+  }
+
+  template <typename R = Receiver>
+  auto request_id() const -> decltype(std::declval<const R&>().request_id()) {
+    return receiver_->request_id();
+  }
+
+  template <typename R = Receiver>
+  auto serializer() -> decltype(std::declval<R&>().serializer()) {
+    return receiver_->serializer();
+  }
+
+  template <typename R = Receiver>
+  auto deserializer() -> decltype(std::declval<R&>().deserializer()) {
+    return receiver_->deserializer();
+  }
+
+  // Records the handler time of methods that do not send a return value once
+  // dispatch finishes.
+  void Finish() { RecordHandler(); }
+
+ private:
+  static std::uint64_t Elapsed(Clock::time_point start, Clock::time_point end) {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count());
+  }
+
+  void RecordHandler() {
+    if (decoded_ != Clock::time_point{} && !handled_) {
+      handled_ = true;
+      counters_->handler.Record(Elapsed(decoded_, Clock::now()));
+    }
+  }
+
+  template <typename Return, typename Send>
+  Status<void> Encode(const Return& return_value, Send send) {
+    const auto start = Clock::now();
+    auto status = send();
+    counters_->encode.Record(Elapsed(start, Clock::now()));
+    if (status) {
+      counters_->response_bytes.fetch_add(Encoding<Return>::Size(return_value),
+                                          std::memory_order_relaxed);
+    }
+    return status;
+  }
+
+  Receiver* receiver_;
+  MethodCounters* counters_;
+  Clock::time_point decoded_{};
+  bool handled_{false};
+};
+
+}  // namespace detail
+
+// Wraps a dispatch table created by BindInterface() and records statistics of
+// each dispatch. Instances are dispatched the same way as the wrapped table.
+template <typename Bindings>
+class InstrumentedBindings {
+ public:
+  using MethodSelector = typename Bindings::MethodSelector;
+
+  // The number of stripes of counters. Threads beyond this number share
+  // stripes, which remains correct but may contend.
+  enum : std::size_t { StripeCount = 8 };
+
+  explicit InstrumentedBindings(Bindings bindings)
+      : bindings_{std::move(bindings)},
+        counters_{
+            new detail::MethodCounters[std::size_t{StripeCount} * Slots]} {}
+
+  InstrumentedBindings(InstrumentedBindings&&) = default;
+  InstrumentedBindings& operator=(InstrumentedBindings&&) = default;
+
+  template <typename Receiver, typename... Args>
+  Status<void> operator()(Receiver* receiver, Args&&... args) const {
+    MethodSelector method_selector;
+    auto status = receiver->GetMethodSelector(&method_selector);
+    if (!status)
+      return status;
+
+    detail::MethodCounters* counters =
+        &counters_[Stripe() * Slots + Bindings::Find(method_selector)];
+    counters->calls.fetch_add(1, std::memory_order_relaxed);
+
+    // The wrapped table reads the selector through the wrapping receiver.
+    SelectorReceiver<Receiver> instrumented{receiver, counters,
+                                            method_selector};
+    status = bindings_(&instrumented, std::forward<Args>(args)...);
+    instrumented.Finish();
+    if (!status)
+      counters->errors.fetch_add(1, std::memory_order_relaxed);
+    return status;
+  }
+
+  // Returns the statistics of the method with the given selector. Selectors
+  // that are not bound return the statistics of unmatched invocations.
+  MethodStats stats(MethodSelector method_selector) const {
+    return Sum(Bindings::Find(method_selector));
+  }
+
+  // Returns the statistics of invocations that matched none of the bindings.
+  MethodStats unmatched() const { return Sum(Bindings::Count); }
+
+  // Clears the statistics of every method.
+  void Reset() {
+    for (std::size_t i = 0; i < std::size_t{StripeCount} * Slots; i++)
+      counters_[i].Reset();
+  }
+
+  const Bindings& bindings() const { return bindings_; }
+
+ private:
+  // One slot for each binding and one for unmatched selectors.
+  enum : std::size_t { Slots = Bindings::Count + 1 };
+
+  // Replays the method selector already read by the wrapper.
+  template <typename Receiver>
+  class SelectorReceiver : public detail::InstrumentedReceiver<Receiver> {
+   public:
+    SelectorReceiver(Receiver* receiver, detail::MethodCounters* counters,
+                     MethodSelector method_selector)
+        : detail::InstrumentedReceiver<Receiver>{receiver, counters},
+          method_selector_{method_selector} {}
+
+    Status<void> GetMethodSelector(MethodSelector* method_selector) {
+      *method_selector = method_selector_;
+      return {};
+    }
+
+   private:
+    MethodSelector method_selector_;
+  };
+
+  static std::size_t Stripe() {
+    return detail::InstrumentationStripe() % StripeCount;
+  }
+
+  MethodStats Sum(std::size_t slot) const {
+    MethodStats stats;
+    for (std::size_t i = 0; i < StripeCount; i++)
+      counters_[i * Slots + slot].AddTo(&stats);
+    return stats;
+  }
+
+  Bindings bindings_;
+  std::unique_ptr<detail::MethodCounters[]> counters_;
+};
+
+// Returns an instrumented wrapper of the given dispatch table.
+template <typename Bindings>
+InstrumentedBindings<std::decay_t<Bindings>> Instrument(Bindings&& bindings) {
+  return InstrumentedBindings<std::decay_t<Bindings>>{
+      std::forward<Bindings>(bindings)};
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_RPC_INSTRUMENTED_BINDINGS_H_
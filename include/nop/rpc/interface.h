@@ -17,6 +17,7 @@
 #ifndef LIBNOP_INCLUDE_NOP_RPC_INTERFACE_H_
 #define LIBNOP_INCLUDE_NOP_RPC_INTERFACE_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <tuple>
 #include <type_traits>
@@ -26,12 +27,49 @@
 #include <nop/base/members.h>
 #include <nop/base/tuple.h>
 #include <nop/base/utility.h>
+#include <nop/rpc/coroutine.h>
 #include <nop/traits/function_traits.h>
+#include <nop/types/thread_local.h>
 #include <nop/types/variant.h>
 #include <nop/utility/sip_hash.h>
 
 namespace nop {
 
+//
+// Argument storage policies for interface method bindings. The policy passed
+// to InterfaceMethod::Bind() determines where the arguments of an invocation
+// are decoded before the handler is called.
+//
+
+// Decodes the arguments of each invocation into a new tuple. This is the
+// default policy.
+struct FreshArgs {
+  template <typename Method, typename ArgsTuple>
+  struct Storage {
+    ArgsTuple& Get() { return args; }
+
+    ArgsTuple args;
+  };
+};
+
+// Decodes the arguments of each invocation into a tuple that belongs to the
+// binding and the calling thread and persists across invocations. Strings and
+// containers keep their capacity from one invocation to the next, so arguments
+// are decoded without allocating in steady state. Handlers that take such
+// arguments by reference see the decoded values in place, while handlers that
+// take them by value move them out of the storage and give up the capacity.
+//
+// The storage is shared by every binding of the same interface method on the
+// thread, so handlers must not dispatch the same method recursively.
+struct ThreadLocalArgs {
+  template <typename Method, typename ArgsTuple>
+  struct Storage {
+    ArgsTuple& Get() { return args.Get(); }
+
+    ThreadLocal<ArgsTuple, ThreadLocalSlot<Method, 0>> args;
+  };
+};
+
 // InterfaceMethod captures the function signature and selector id of a method
 // in a remote interface. The signature describes the protocol to use when
 // serializing the method for RPC invocation and deserializing the return value.
@@ -51,8 +89,13 @@ namespace nop {
 // the remote method. The return type of these bind methods are primarly useful
 // as arguments to the BindInterface function, which collects a group of
 // bindings into an instance of the InterfaceBindings class to handle dispatch.
+//
+// One-way methods, defined with NOP_ONEWAY_METHOD(), have no return value on
+// the wire: invocation returns as soon as the method selector and arguments
+// are written and dispatch does not send anything back to the caller. One-way
+// methods must have a void return type.
 template <typename MethodSelector_, MethodSelector_ Selector_,
-          typename Signature>
+          typename Signature, bool OneWay_ = false>
 struct InterfaceMethod {
   // Enforce that the MethodSelector type is integral.
   static_assert(std::is_integral<MethodSelector_>::value,
@@ -65,6 +108,13 @@ struct InterfaceMethod {
   // method.
   using InterfaceTraits = FunctionTraits<Signature>;
 
+  // Evaluates to std::true_type if this is a one-way method.
+  using IsOneWay = std::integral_constant<bool, OneWay_>;
+
+  static_assert(!IsOneWay::value ||
+                    std::is_void<typename InterfaceTraits::Return>::value,
+                "One-way methods must have a void return type.");
+
   // Enable if the given function type T is compatible (fungible) with the
   // signature of this interface method.
   template <typename T, typename Return = void>
@@ -114,6 +164,43 @@ struct InterfaceMethod {
         sender, return_value, std::forward<Args>(args)...);
   }
 
+  // Invokes this interface method using the given sender without waiting for
+  // the return value. The completion is called with the Status<Return> of the
+  // method when the sender receives the return value. The sender must support
+  // asynchronous invocation, for example PipelinedMethodSender. Returns the
+  // status of writing the invocation.
+  template <typename Sender, typename Completion, typename... Args,
+            typename Return = typename InterfaceTraits::Return>
+  static EnableIfConforming<Return(Args...), Status<void>> InvokeAsync(
+      Sender* sender, Completion&& completion, Args&&... args) {
+    return Helper<ConformingSignature<Return(Args...)>>::InvokeAsync(
+        sender, std::forward<Completion>(completion),
+        std::forward<Args>(args)...);
+  }
+
+#if NOP_HAS_COROUTINES
+  // Invokes this interface method using the given sender and returns an
+  // awaitable that resumes the awaiting coroutine with the Status<Return> of
+  // the method when the sender receives the return value. The sender must
+  // support asynchronous invocation, and the arguments are copied into the
+  // awaitable until it is awaited.
+  template <typename Sender, typename... Args,
+            typename Return = typename InterfaceTraits::Return,
+            typename Enable = EnableIfConforming<Return(Args...)>>
+  static auto InvokeAsync(Sender* sender, Args&&... args) {
+    return MakeMethodAwaiter<Return>(
+        [sender, args = std::make_tuple(std::forward<Args>(args)...)](
+            auto completion) mutable {
+          return std::apply(
+              [&](auto&... values) {
+                return Helper<ConformingSignature<Return(Args...)>>::
+                    InvokeAsync(sender, std::move(completion), values...);
+              },
+              args);
+        });
+  }
+#endif
+
   // Utility type that deals with the complexity of validating fungible
   // arguments defined by the interface method protocol while accommodating
   // leading passthrough arguments that a handler might receive.
@@ -135,11 +222,14 @@ struct InterfaceMethod {
                   "The handler has fewer arguments than the protocol defines.");
 
     enum : std::size_t {
-      LeadingArgs = HandlerTraits::Arity - InterfaceTraits::Arity
+      LeadingArgs = static_cast<std::size_t>(HandlerTraits::Arity) -
+                    static_cast<std::size_t>(InterfaceTraits::Arity)
     };
 
-    using TrimmedSignature =
-        typename HandlerTraits::template TrimLeadingArgs<LeadingArgs>;
+    // Handlers that are coroutines are checked against the type of the value
+    // their tasks produce.
+    using TrimmedSignature = typename AwaitedSignature<
+        typename HandlerTraits::template TrimLeadingArgs<LeadingArgs>>::Type;
   };
 
   // Enable if the HandlerType is compatible (fungible) with the signature of
@@ -150,8 +240,8 @@ struct InterfaceMethod {
                          Return>;
 
   // Nested type that holds a callable handler for receiver-side dispatch of
-  // this interface method.
-  template <typename Op>
+  // this interface method, decoding arguments with the given storage policy.
+  template <typename Op, typename ArgsPolicy = FreshArgs>
   struct FunctionBinding {
     // Alias of the InterfaceMethod this binding represents.
     using InterfaceMethodType = InterfaceMethod;
@@ -173,14 +263,15 @@ struct InterfaceMethod {
     template <typename Receiver, typename... Passthrough>
     Status<void> Dispatch(Receiver* receiver,
                           Passthrough&&... passthrough) const {
-      return Helper<typename FunctionTraits<Op>::Signature>::Dispatch(
-          receiver, op, std::forward<Passthrough>(passthrough)...);
+      return Helper<typename FunctionTraits<Op>::Signature>::template Dispatch<
+          ArgsPolicy>(receiver, op, std::forward<Passthrough>(passthrough)...);
     }
   };
 
   // Nested type that holds a method pointer handler for receiver-side dispatch
-  // of this interface method.
-  template <typename Class, typename Method>
+  // of this interface method, decoding arguments with the given storage
+  // policy.
+  template <typename Class, typename Method, typename ArgsPolicy = FreshArgs>
   struct MethodBinding {
     // Alias of the InterfaceMethod this binding represents.
     using InterfaceMethodType = InterfaceMethod;
@@ -201,31 +292,38 @@ struct InterfaceMethod {
     template <typename Receiver, typename... Passthrough>
     Status<void> Dispatch(Receiver* receiver, Class* instance,
                           Passthrough&&... passthrough) const {
-      return Helper<typename FunctionTraits<Method>::Signature>::Dispatch(
-          receiver, instance, method,
-          std::forward<Passthrough>(passthrough)...);
+      return Helper<typename FunctionTraits<Method>::Signature>::
+          template Dispatch<ArgsPolicy>(
+              receiver, instance, method,
+              std::forward<Passthrough>(passthrough)...);
     }
   };
 
-  // Returns an instance of Binding holding the given callable object.
-  template <typename Op, typename Enable = EnableIfCompatibleHandler<Op>>
-  static constexpr auto Bind(Op&& op) {
-    return FunctionBinding<Op>{std::forward<Op>(op)};
+  // Returns an instance of Binding holding the given callable object. The
+  // optional policy argument selects where arguments are decoded, for example
+  // ThreadLocalArgs{} to reuse argument storage across invocations.
+  template <typename Op, typename ArgsPolicy = FreshArgs,
+            typename Enable = EnableIfCompatibleHandler<Op>>
+  static constexpr auto Bind(Op&& op, ArgsPolicy = {}) {
+    return FunctionBinding<Op, ArgsPolicy>{std::forward<Op>(op)};
   }
 
   // Returns an instance of Binding holding the given const method pointer.
   template <typename Class, typename Return, typename... Args,
+            typename ArgsPolicy = FreshArgs,
             typename Enable = EnableIfCompatibleHandler<Return(Args...)>>
-  static constexpr auto Bind(Return (Class::*op)(Args...) const) {
+  static constexpr auto Bind(Return (Class::*op)(Args...) const,
+                             ArgsPolicy = {}) {
     return MethodBinding<std::add_const_t<Class>,
-                         Return (Class::*)(Args...) const>{op};
+                         Return (Class::*)(Args...) const, ArgsPolicy>{op};
   }
 
   // Returns an instance of Binding holding the given method pointer.
   template <typename Class, typename Return, typename... Args,
+            typename ArgsPolicy = FreshArgs,
             typename Enable = EnableIfCompatibleHandler<Return(Args...)>>
-  static constexpr auto Bind(Return (Class::*op)(Args...)) {
-    return MethodBinding<Class, Return (Class::*)(Args...)>{op};
+  static constexpr auto Bind(Return (Class::*op)(Args...), ArgsPolicy = {}) {
+    return MethodBinding<Class, Return (Class::*)(Args...), ArgsPolicy>{op};
   }
 
  private:
@@ -244,47 +342,105 @@ struct InterfaceMethod {
     template <typename Sender>
     static void Invoke(Sender* sender, Status<Return>* return_value,
                        Args... args) {
-      sender->template SendMethod(InterfaceMethod::Selector, return_value,
-                                  std::forward_as_tuple(args...));
+      Send(sender, return_value, IsOneWay{}, std::forward_as_tuple(args...));
+    }
+
+    // Invokes the remote method using the given sender without waiting for the
+    // return value.
+    template <typename Sender, typename Completion>
+    static Status<void> InvokeAsync(Sender* sender, Completion&& completion,
+                                    Args... args) {
+      static_assert(!IsOneWay::value,
+                    "One-way methods have no return value to wait for.");
+
+      auto status = sender->template SendMethodAsync<Return>(
+          InterfaceMethod::Selector, std::forward<Completion>(completion),
+          std::forward_as_tuple(args...));
+      if (!status)
+        return status.error();
+      else
+        return {};
     }
 
+    // Argument storage for the given policy.
+    template <typename ArgsPolicy>
+    using ArgsStorage =
+        typename ArgsPolicy::template Storage<InterfaceMethod, ArgsTuple>;
+
     // Dispatches the given handler op, getting the arguments from the given
     // receiver and passthough arguments and then passing the return value back
     // to the receiver.
-    template <typename Receiver, typename Op, typename... Passthrough>
+    template <typename ArgsPolicy, typename Receiver, typename Op,
+              typename... Passthrough>
     static Status<void> Dispatch(Receiver* receiver, Op&& op,
                                  Passthrough&&... passthrough) {
-      ArgsTuple args;
+      ArgsStorage<ArgsPolicy> storage;
+      ArgsTuple& args = storage.Get();
       auto status = receiver->GetArgs(&args);
       if (!status)
         return status;
 
-      Return return_value{Call(std::forward<Op>(op), &args,
-                               std::make_index_sequence<sizeof...(Args)>{},
-                               std::forward<Passthrough>(passthrough)...)};
-
-      return receiver->SendReturn(return_value);
+      return Respond(receiver, IsOneWay{}, [&]() -> Return {
+        return Call(std::forward<Op>(op), &args,
+                    std::make_index_sequence<sizeof...(Args)>{},
+                    std::forward<Passthrough>(passthrough)...);
+      });
     }
 
     // Dispatches the given handler op, getting the arguments from the given
     // receiver and passthough arguments and then passing the return value back
     // to the receiver.
-    template <typename Receiver, typename Class, typename Op,
-              typename... Passthrough>
+    template <typename ArgsPolicy, typename Receiver, typename Class,
+              typename Op, typename... Passthrough>
     static Status<void> Dispatch(Receiver* receiver, Class* instance, Op&& op,
                                  Passthrough&&... passthrough) {
-      ArgsTuple args;
+      ArgsStorage<ArgsPolicy> storage;
+      ArgsTuple& args = storage.Get();
       auto status = receiver->GetArgs(&args);
       if (!status)
         return status;
 
-      Return return_value{Call(instance, std::forward<Op>(op), &args,
-                               std::make_index_sequence<sizeof...(Args)>{},
-                               std::forward<Passthrough>(passthrough)...)};
+      return Respond(receiver, IsOneWay{}, [&]() -> Return {
+        return Call(instance, std::forward<Op>(op), &args,
+                    std::make_index_sequence<sizeof...(Args)>{},
+                    std::forward<Passthrough>(passthrough)...);
+      });
+    }
+
+    // Writes the invocation of a request/response method and waits for the
+    // return value.
+    template <typename Sender, typename ArgsRefTuple>
+    static void Send(Sender* sender, Status<Return>* return_value,
+                     std::false_type /*one_way*/, ArgsRefTuple&& args) {
+      sender->template SendMethod(InterfaceMethod::Selector, return_value,
+                                  std::forward<ArgsRefTuple>(args));
+    }
+
+    // Writes the invocation of a one-way method.
+    template <typename Sender, typename ArgsRefTuple>
+    static void Send(Sender* sender, Status<Return>* return_value,
+                     std::true_type /*one_way*/, ArgsRefTuple&& args) {
+      *return_value = sender->template SendOneWayMethod(
+          InterfaceMethod::Selector, std::forward<ArgsRefTuple>(args));
+    }
 
+    // Calls the handler of a request/response method and sends the return
+    // value back to the caller.
+    template <typename Receiver, typename Handler>
+    static Status<void> Respond(Receiver* receiver, std::false_type /*one_way*/,
+                                Handler&& handler) {
+      Return return_value{handler()};
       return receiver->SendReturn(return_value);
     }
 
+    // Calls the handler of a one-way method, which has nothing to send back.
+    template <typename Receiver, typename Handler>
+    static Status<void> Respond(Receiver* /*receiver*/,
+                                std::true_type /*one_way*/, Handler&& handler) {
+      handler();
+      return {};
+    }
+
     // Helper function to marshall passthough arguments and deserialized
     // arugments to the given handler op.
     template <typename Op, std::size_t... Is, typename... Passthrough>
@@ -313,6 +469,68 @@ struct InterfaceMethod {
           std::get<Is>(std::forward<ArgsTuple>(*args))...));
     }
   };
+
+#if NOP_HAS_COROUTINES
+  // Helper class for dispatching handlers that are coroutines. The handler runs
+  // until its first suspension point during dispatch and the return value is
+  // sent when its task completes. The handler, arguments, and passthrough
+  // arguments are copied into the coroutine frame, but the receiver and the
+  // object of a method handler must outlive the task. Arguments are always
+  // decoded into a new tuple that moves into the frame, whatever the storage
+  // policy of the binding.
+  template <typename Return, typename... Args>
+  struct Helper<Task<Return>(Args...)> {
+    using ArgsTuple = std::tuple<std::decay_t<Args>...>;
+
+    static_assert(IsOneWay::value || !std::is_void<Return>::value,
+                  "Request/response handlers must return a value.");
+
+    template <typename ArgsPolicy, typename Receiver, typename Op,
+              typename... Passthrough>
+    static Status<void> Dispatch(Receiver* receiver, Op&& op,
+                                 Passthrough&&... passthrough) {
+      ArgsTuple args;
+      auto status = receiver->GetArgs(&args);
+      if (!status)
+        return status;
+
+      RespondAsync(DeferredReturn<Receiver>{receiver}, IsOneWay{},
+                   [op = std::decay_t<Op>{op}, args = std::move(args),
+                    ... passthrough = std::decay_t<Passthrough>(passthrough)](
+                       ) mutable -> Task<Return> {
+                     return std::apply(
+                         [&](auto&... values) {
+                           return op(passthrough..., std::move(values)...);
+                         },
+                         args);
+                   });
+      return {};
+    }
+
+    template <typename ArgsPolicy, typename Receiver, typename Class,
+              typename Op, typename... Passthrough>
+    static Status<void> Dispatch(Receiver* receiver, Class* instance, Op&& op,
+                                 Passthrough&&... passthrough) {
+      ArgsTuple args;
+      auto status = receiver->GetArgs(&args);
+      if (!status)
+        return status;
+
+      RespondAsync(DeferredReturn<Receiver>{receiver}, IsOneWay{},
+                   [instance, op, args = std::move(args),
+                    ... passthrough = std::decay_t<Passthrough>(passthrough)](
+                       ) mutable -> Task<Return> {
+                     return std::apply(
+                         [&](auto&... values) {
+                           return (instance->*op)(passthrough...,
+                                                  std::move(values)...);
+                         },
+                         args);
+                   });
+      return {};
+    }
+  };
+#endif
 };
 
 // InterfaceAPI holds a collection of InterfaceMethod types that make up a
@@ -367,6 +585,12 @@ struct Interface {
     return InterfaceType::GetName();
   }
 
+  // Returns the name of the interface type T without copying it.
+  static constexpr const char* GetInterfaceNameCString() {
+    using InterfaceType = typename T::NOP__INTERFACE;
+    return InterfaceType::GetName();
+  }
+
   // Looks up the selector for a method in the interface by numeric index.
   template <std::size_t Index>
   static constexpr auto GetMethodSelector() {
@@ -382,12 +606,134 @@ struct Interface {
 template <typename... Args>
 struct Passthrough {};
 
+// Parameters of a perfect hash over a set of method selectors. See
+// SelectorHash below.
+struct SelectorHashParams {
+  std::size_t shift;
+  std::size_t bits;
+  bool valid;
+};
+
+// Searches for the smallest table, and then the smallest shift, such that
+// (selector >> shift) & ((1 << bits) - 1) maps each of Selectors to a distinct
+// slot. Tables start with at least twice as many slots as there are selectors
+// and grow up to 1 << MaxBits slots before giving up. Method selectors are
+// either hashes, with uniformly distributed bits, or manually assigned values,
+// which are usually small and dense and map directly with shift zero.
+template <typename MethodSelector, MethodSelector... Selectors>
+constexpr SelectorHashParams ComputeSelectorHashParams() {
+  enum : std::size_t {
+    Count = sizeof...(Selectors),
+    SelectorBits = sizeof(MethodSelector) * 8,
+    MaxBits = 12,
+  };
+
+  const std::uint64_t selectors[Count + 1] = {
+      static_cast<std::uint64_t>(Selectors)..., 0};
+
+  // Each attempt marks the slots it uses with its own stamp, which avoids
+  // clearing the array between attempts.
+  std::size_t stamps[std::size_t{1} << MaxBits] = {};
+  std::size_t attempt = 0;
+
+  std::size_t bits = 0;
+  while ((std::size_t{1} << bits) < 2 * Count)
+    bits++;
+
+  for (; bits <= MaxBits && bits <= SelectorBits; bits++) {
+    const std::uint64_t mask = (std::uint64_t{1} << bits) - 1;
+    for (std::size_t shift = 0; shift + bits <= SelectorBits; shift++) {
+      attempt++;
+
+      std::size_t i = 0;
+      for (; i < Count; i++) {
+        const std::size_t slot = (selectors[i] >> shift) & mask;
+        if (stamps[slot] == attempt)
+          break;
+        stamps[slot] = attempt;
+      }
+
+      if (i == Count)
+        return {shift, bits, true};
+    }
+  }
+
+  return {0, 0, false};
+}
+
+// Compile-time perfect hash table that maps each of Selectors to its index in
+// the parameter pack with a single table lookup. IsValid is false when no
+// perfect hash is found within the maximum table size, in which case Find()
+// must not be used.
+template <typename MethodSelector, MethodSelector... Selectors>
+class SelectorHash {
+  static constexpr SelectorHashParams Params =
+      ComputeSelectorHashParams<MethodSelector, Selectors...>();
+
+ public:
+  enum : std::size_t {
+    Count = sizeof...(Selectors),
+    Shift = Params.shift,
+    Size = std::size_t{1} << Params.bits,
+  };
+
+  using IsValid = std::integral_constant<bool, Params.valid>;
+
+  // Returns the index of |method_selector| in Selectors or Count if it is not
+  // one of Selectors.
+  static std::size_t Find(MethodSelector method_selector) {
+    static constexpr Table table = BuildTable();
+    static constexpr MethodSelector selectors[Count + 1] = {Selectors...,
+                                                            MethodSelector{}};
+
+    const std::size_t entry = table.slots[Slot(method_selector)];
+    if (entry != 0 && selectors[entry - 1] == method_selector)
+      return entry - 1;
+    else
+      return Count;
+  }
+
+ private:
+  static_assert(Count < 0xffff, "Too many method selectors.");
+
+  // Table entries hold the index of the selector in the slot plus one, leaving
+  // zero to mark empty slots.
+  using EntryType =
+      std::conditional_t<(Count < 0xff), std::uint8_t, std::uint16_t>;
+
+  struct Table {
+    EntryType slots[Size];
+  };
+
+  static constexpr std::size_t Slot(MethodSelector method_selector) {
+    return (static_cast<std::uint64_t>(method_selector) >> Shift) & (Size - 1);
+  }
+
+  static constexpr Table BuildTable() {
+    const MethodSelector selectors[Count + 1] = {Selectors...,
+                                                 MethodSelector{}};
+
+    Table table{};
+    for (std::size_t i = 0; i < Count; i++)
+      table.slots[Slot(selectors[i])] = static_cast<EntryType>(i + 1);
+
+    return table;
+  }
+};
+
+template <typename MethodSelector, MethodSelector... Selectors>
+constexpr SelectorHashParams SelectorHash<MethodSelector, Selectors...>::Params;
+
 // Base type for InterfaceBindings dispatcher class.
 template <typename, typename...>
 class InterfaceBindings;
 
 // InterfaceBindings provides compile-time dispatch table generation for a set
-// or subset of interface method handlers.
+// or subset of interface method handlers. Method selectors are resolved with a
+// compile-time perfect hash table, so that dispatch costs a single table lookup
+// and indirect call regardless of the number of bindings. Sets of selectors
+// that do not admit a perfect hash within the table size limit fall back to
+// comparing the selector with each binding in turn.
 template <typename... Args, typename... Bindings>
 class InterfaceBindings<Passthrough<Args...>, Bindings...> {
   template <typename A, typename B>
@@ -419,7 +765,22 @@ class InterfaceBindings<Passthrough<Args...>, Bindings...> {
   // Returns true if the given selector matches one of the interface methods
   // bound in this dispatch table.
   bool Match(MethodSelector method_selector) {
-    return MatchTable(method_selector, Index<sizeof...(Bindings)>{});
+    return Find(method_selector) != Count;
+  }
+
+  // Returns the index of the binding for the given selector in this dispatch
+  // table, or Count if none of the bindings match it.
+  static std::size_t Find(MethodSelector method_selector) {
+    if (Hash::IsValid::value) {
+      return Hash::Find(method_selector);
+    } else {
+      const MethodSelector selectors[] = {static_cast<MethodSelector>(
+          Bindings::InterfaceMethodType::Selector)...};
+      std::size_t index = 0;
+      while (index < Count && selectors[index] != method_selector)
+        index++;
+      return index;
+    }
   }
 
   // Attempts to dispatch one of the bound handlers with the given receiver and
@@ -432,8 +793,8 @@ class InterfaceBindings<Passthrough<Args...>, Bindings...> {
     if (!status)
       return status.error();
 
-    return DispatchTable(receiver, method_selector,
-                         Index<sizeof...(Bindings)>{},
+    return DispatchIndex(receiver, Find(method_selector),
+                         std::make_index_sequence<Count>{},
                          std::forward<Args>(args)...);
   }
 
@@ -441,49 +802,37 @@ class InterfaceBindings<Passthrough<Args...>, Bindings...> {
   // The bindings for each interface method in this dispatch table.
   std::tuple<Bindings...> bindings_;
 
-  // Looks up the binding type for a binding in this dispatch table by index.
-  template <std::size_t Index>
-  using At = typename std::tuple_element<Index, decltype(bindings_)>::type;
-
-  // Terminates recursion when searching for the given method selector. Reaching
-  // this function means the selector was not found in this dispatch table.
-  template <typename MethodSelector>
-  bool MatchTable(MethodSelector /*method_selector*/, Index<0>) const {
-    return false;
-  }
-
-  // Recurses through the bindings in this dispatch table looking for the given
-  // method selector.
-  template <typename MethodSelector, std::size_t index>
-  bool MatchTable(MethodSelector method_selector, Index<index>) const {
-    if (At<index - 1>::Match(method_selector))
-      return true;
+  // Perfect hash table mapping the selector of each binding to its index.
+  using Hash = SelectorHash<MethodSelector,
+                            static_cast<MethodSelector>(
+                                Bindings::InterfaceMethodType::Selector)...>;
+
+  // Dispatches the binding at |index| through a table of functions indexed by
+  // binding, returning an error if |index| is out of range.
+  template <typename Receiver, std::size_t... Is>
+  Status<void> DispatchIndex(Receiver* receiver, std::size_t index,
+                             std::index_sequence<Is...>, Args&&... args) const {
+    using Function =
+        Status<void> (*)(const InterfaceBindings*, Receiver*, Args&&...);
+    static constexpr Function functions[] = {&DispatchAt<Receiver, Is>...};
+
+    if (index < Count)
+      return functions[index](this, receiver, std::forward<Args>(args)...);
     else
-      return MatchTable(method_selector, Index<index - 1>{});
+      return ErrorStatus::InvalidInterfaceMethod;
   }
 
-  // Terminates recursion when searching for the given method selector to
-  // dispatch.
-  template <typename Receiver, typename MethodSelector>
-  Status<void> DispatchTable(Receiver* /*receiver*/,
-                             MethodSelector /*method_selector*/, Index<0>,
-                             Args&&... /*args*/) const {
-    return ErrorStatus::InvalidInterfaceMethod;
+  // Dispatches the binding at the given index.
+  template <typename Receiver, std::size_t index>
+  static Status<void> DispatchAt(const InterfaceBindings* self,
+                                 Receiver* receiver, Args&&... args) {
+    return std::get<index>(self->bindings_)
+        .Dispatch(receiver, std::forward<Args>(args)...);
   }
 
-  // Recurses through the bindings in this dispatch table looking for the given
-  // method selector.
-  template <typename Receiver, typename MethodSelector, std::size_t index>
-  Status<void> DispatchTable(Receiver* receiver, MethodSelector method_selector,
-                             Index<index>, Args&&... args) const {
-    if (At<index - 1>::Match(method_selector)) {
-      return std::get<index - 1>(bindings_).Dispatch(
-          receiver, std::forward<Args>(args)...);
-    } else {
-      return DispatchTable(receiver, method_selector, Index<index - 1>{},
-                           std::forward<Args>(args)...);
-    }
-  }
+  // Looks up the binding type for a binding in this dispatch table by index.
+  template <std::size_t Index>
+  using At = typename std::tuple_element<Index, decltype(bindings_)>::type;
 };
 
 // Creates a dispatch table with the given bindings. The leading template
@@ -542,7 +891,7 @@ inline constexpr MethodSelector ComputeMethodSelector(
       Hash = ::nop::SipHash::Compute(string_name, ::nop::kNopInterfaceKey0, \
                                      ::nop::kNopInterfaceKey1)              \
     };                                                                      \
-    static std::string GetName() { return string_name; }                    \
+    static constexpr const char* GetName() { return string_name; }          \
   }
 
 // Defines an interface with a 64bit method selector type. This should be used
@@ -570,6 +919,20 @@ inline constexpr MethodSelector ComputeMethodSelector(
   using name = ::nop::InterfaceMethod<NOP__INTERFACE::MethodSelector, \
                                       selector, __VA_ARGS__>
 
+// Defines a one-way remote method, which returns as soon as the invocation is
+// written and sends no return value back to the caller. The signature must
+// have a void return type.
+#define NOP_ONEWAY_METHOD(name, ... /* signature */)                    \
+  NOP_ONEWAY_METHOD_SEL(                                                \
+      ::nop::ComputeMethodSelector<NOP__INTERFACE::MethodSelector>(     \
+          #name, NOP__INTERFACE::Hash),                                 \
+      name, __VA_ARGS__)
+
+// Defines a one-way remote method with a manually specified method selector.
+#define NOP_ONEWAY_METHOD_SEL(selector, name, ... /* signature */)    \
+  using name = ::nop::InterfaceMethod<NOP__INTERFACE::MethodSelector, \
+                                      selector, __VA_ARGS__, true>
+
 // Defines the collection of remote methods that comprise the remote interface.
 // The arguments to this function must be the symbol names passed to
 // NOP_METHOD() within the same class or structure definition.
@@ -0,0 +1,233 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_RPC_INTERFACE_ROUTER_H_
+#define LIBNOP_INCLUDE_NOP_RPC_INTERFACE_ROUTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <nop/base/utility.h>
+#include <nop/rpc/interface.h>
+#include <nop/status.h>
+
+namespace nop {
+
+//
+// Interface routing serves several remote interfaces over one connection. Each
+// invocation is prefixed with the hash of its interface, which is computed at
+// compile time from the name given to NOP_INTERFACE(), and the receiving end
+// routes the invocation to the dispatch table bound for that interface with a
+// compile-time perfect hash table, the same way InterfaceBindings routes
+// method selectors.
+//
+// Example:
+//
+//   auto sender = nop::MakeSimpleMethodSender(&serializer, &deserializer);
+//   auto files = nop::MakeRoutedMethodSender<FileInterface>(&sender);
+//   auto logs = nop::MakeRoutedMethodSender<LogInterface>(&sender);
+//   FileInterface::Open::Invoke(&files, "foo.txt");
+//   LogInterface::Write::Invoke(&logs, "opened foo.txt");
+//
+//   // At the other end:
+//   auto router = nop::BindRoutes(
+//       nop::Route<FileInterface>(nop::BindInterface(...)),
+//       nop::Route<LogInterface>(nop::BindInterface(...)));
+//   auto receiver = nop::MakeSimpleMethodReceiver(&serializer, &deserializer);
+//   router(&receiver);
+//
+
+// RoutedMethodSender wraps a Sender type, writing the hash of the given
+// interface before each invocation the wrapped sender writes. The wrapped
+// sender must write invocations directly to its serializer, as
+// SimpleMethodSender and PipelinedMethodSender do, and any number of routed
+// senders for different interfaces may share it.
+template <typename InterfaceClass, typename Sender>
+class RoutedMethodSender {
+ public:
+  enum : std::uint64_t { InterfaceHash = InterfaceType<InterfaceClass>::Hash };
+
+  constexpr explicit RoutedMethodSender(Sender* sender) : sender_{sender} {}
+
+  template <typename MethodSelector, typename Return, typename... Args>
+  void SendMethod(MethodSelector method_selector, Status<Return>* return_value,
+                  const std::tuple<Args...>& args) {
+    auto status = WriteRoute();
+    if (!status)
+      *return_value = status.error();
+    else
+      sender_->SendMethod(method_selector, return_value, args);
+  }
+
+  template <typename Return, typename MethodSelector, typename Completion,
+            typename... Args>
+  auto SendMethodAsync(MethodSelector method_selector, Completion&& completion,
+                       const std::tuple<Args...>& args)
+      -> decltype(std::declval<Sender&>().template SendMethodAsync<Return>(
+          method_selector, std::forward<Completion>(completion), args)) {
+    auto status = WriteRoute();
+    if (!status)
+      return status.error();
+
+    return sender_->template SendMethodAsync<Return>(
+        method_selector, std::forward<Completion>(completion), args);
+  }
+
+  template <typename MethodSelector, typename... Args>
+  Status<void> SendOneWayMethod(MethodSelector method_selector,
+                                const std::tuple<Args...>& args) {
+    auto status = WriteRoute();
+    if (!status)
+      return status;
+
+    return sender_->SendOneWayMethod(method_selector, args);
+  }
+
+  constexpr const Sender& sender() const { return *sender_; }
+  constexpr Sender& sender() { return *sender_; }
+
+ private:
+  Status<void> WriteRoute() {
+    return sender_->serializer().Write(
+        static_cast<std::uint64_t>(InterfaceHash));
+  }
+
+  Sender* sender_;
+};
+
+template <typename InterfaceClass, typename Sender>
+constexpr RoutedMethodSender<InterfaceClass, Sender> MakeRoutedMethodSender(
+    Sender* sender) {
+  return RoutedMethodSender<InterfaceClass, Sender>{sender};
+}
+
+// Associates the dispatch table of an interface, usually created by
+// BindInterface(), with the hash of the interface.
+template <typename InterfaceClass, typename Dispatcher>
+struct InterfaceRoute {
+  enum : std::uint64_t { InterfaceHash = InterfaceType<InterfaceClass>::Hash };
+
+  Dispatcher dispatcher;
+};
+
+// Returns a route to the given dispatch table for the interface type T.
+template <typename InterfaceClass, typename Dispatcher>
+constexpr InterfaceRoute<InterfaceClass, std::decay_t<Dispatcher>> Route(
+    Dispatcher&& dispatcher) {
+  return {std::forward<Dispatcher>(dispatcher)};
+}
+
+// InterfaceRouter reads the interface hash written by RoutedMethodSender and
+// dispatches the invocation that follows with the dispatch table routed for
+// that interface, passing along any passthrough arguments. Invocations of
+// interfaces without a route fail with ErrorStatus::InvalidInterfaceMethod.
+template <typename... Routes>
+class InterfaceRouter {
+  template <typename A, typename B>
+  using SameInterface = std::integral_constant<
+      bool, static_cast<std::uint64_t>(A::InterfaceHash) ==
+                static_cast<std::uint64_t>(B::InterfaceHash)>;
+  static_assert(IsUnique<SameInterface, Routes...>::value,
+                "Interfaces cannot be routed more than once.");
+
+ public:
+  // The number of interfaces routed by this router.
+  enum : std::size_t { Count = sizeof...(Routes) };
+
+  constexpr InterfaceRouter(Routes&&... routes)
+      : routes_{std::forward<Routes>(routes)...} {}
+
+  template <typename Receiver, typename... Args>
+  Status<void> operator()(Receiver* receiver, Args&&... args) const {
+    std::uint64_t interface_hash;
+    auto status = receiver->deserializer().Read(&interface_hash);
+    if (!status)
+      return status;
+
+    return DispatchIndex(receiver, Find(interface_hash),
+                         std::make_index_sequence<Count>{},
+                         std::forward<Args>(args)...);
+  }
+
+  // Returns true if the given interface hash has a route in this router.
+  static bool Match(std::uint64_t interface_hash) {
+    return Find(interface_hash) != Count;
+  }
+
+ private:
+  std::tuple<Routes...> routes_;
+
+  using Hash = SelectorHash<std::uint64_t, static_cast<std::uint64_t>(
+                                               Routes::InterfaceHash)...>;
+
+  // Returns the index of the route for |interface_hash| or Count if there is
+  // none.
+  static std::size_t Find(std::uint64_t interface_hash) {
+    return Find(interface_hash, typename Hash::IsValid{});
+  }
+
+  static std::size_t Find(std::uint64_t interface_hash,
+                          std::true_type /*valid*/) {
+    return Hash::Find(interface_hash);
+  }
+
+  static std::size_t Find(std::uint64_t interface_hash,
+                          std::false_type /*valid*/) {
+    const std::uint64_t hashes[Count] = {
+        static_cast<std::uint64_t>(Routes::InterfaceHash)...};
+    std::size_t index = 0;
+    while (index < Count && hashes[index] != interface_hash)
+      index++;
+    return index;
+  }
+
+  // Dispatches the route at |index| through a table of functions indexed by
+  // route, returning an error if |index| is out of range.
+  template <typename Receiver, std::size_t... Is, typename... Args>
+  Status<void> DispatchIndex(Receiver* receiver, std::size_t index,
+                             std::index_sequence<Is...>,
+                             Args&&... args) const {
+    using Function =
+        Status<void> (*)(const InterfaceRouter*, Receiver*, Args&&...);
+    static constexpr Function functions[] = {
+        &DispatchAt<Receiver, Is, Args...>...};
+
+    if (index < Count)
+      return functions[index](this, receiver, std::forward<Args>(args)...);
+    else
+      return ErrorStatus::InvalidInterfaceMethod;
+  }
+
+  template <typename Receiver, std::size_t Index, typename... Args>
+  static Status<void> DispatchAt(const InterfaceRouter* self,
+                                 Receiver* receiver, Args&&... args) {
+    return std::get<Index>(self->routes_)
+        .dispatcher(receiver, std::forward<Args>(args)...);
+  }
+};
+
+// Creates a router with the given routes, which are returned by Route().
+template <typename... Routes>
+constexpr InterfaceRouter<Routes...> BindRoutes(Routes&&... routes) {
+  return {std::forward<Routes>(routes)...};
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_RPC_INTERFACE_ROUTER_H_
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_RPC_METHOD_BATCH_H_
+#define LIBNOP_INCLUDE_NOP_RPC_METHOD_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <nop/rpc/pending_return.h>
+#include <nop/serializer.h>
+#include <nop/status.h>
+#include <nop/utility/vector_writer.h>
+
+namespace nop {
+
+//
+// Method batches carry several method invocations in one message, which
+// amortizes framing and system calls for clients that make many small calls.
+// A batch is encoded as the number of invocations followed by the method
+// selector and arguments of each invocation, exactly as SimpleMethodSender
+// writes them. The return values of the request/response methods in the batch
+// follow in the same order, as written by SimpleMethodReceiver.
+//
+// Example:
+//
+//   auto batch = nop::MakeBatchMethodSender(&serializer, &deserializer);
+//   MyInterface::Sum::InvokeAsync(&batch, on_sum, 1, 2);
+//   MyInterface::Log::Invoke(&batch, "summing");  // One-way method.
+//   MyInterface::Sum::InvokeAsync(&batch, on_sum, 3, 4);
+//   batch.Send();  // Calls on_sum twice.
+//
+//   // At the other end:
+//   auto receiver = nop::MakeSimpleMethodReceiver(&serializer, &deserializer);
+//   nop::DispatchBatch(&receiver, dispatcher);
+//
+
+// BatchMethodSender is a Sender type that accumulates method invocations in an
+// internal buffer instead of writing them immediately. Send() writes the whole
+// batch with a single write to the underlying writer and then reads the return
+// values, calling the completion of each request/response invocation in the
+// order the invocations were added.
+//
+// Request/response methods are added with InterfaceMethod::InvokeAsync() and
+// one-way methods with InterfaceMethod::Invoke(). The internal buffer keeps its
+// capacity across batches, so a long-lived sender does not allocate in steady
+// state.
+template <typename Serializer, typename Deserializer>
+class BatchMethodSender {
+ public:
+  BatchMethodSender(Serializer* serializer, Deserializer* deserializer)
+      : serializer_{serializer}, deserializer_{deserializer} {}
+
+  // Adds a request/response method invocation to the batch. The completion is
+  // called with the Status<Return> of the method by Send().
+  template <typename Return, typename MethodSelector, typename Completion,
+            typename... Args>
+  Status<void> SendMethodAsync(MethodSelector method_selector,
+                               Completion&& completion,
+                               const std::tuple<Args...>& args) {
+    auto status = AddInvocation(method_selector, args);
+    if (!status)
+      return status;
+
+    pending_.emplace_back(
+        Pending::template Make<Return>(std::forward<Completion>(completion)));
+    return {};
+  }
+
+  // Adds a one-way method invocation to the batch.
+  template <typename MethodSelector, typename... Args>
+  Status<void> SendOneWayMethod(MethodSelector method_selector,
+                                const std::tuple<Args...>& args) {
+    return AddInvocation(method_selector, args);
+  }
+
+  // Writes the batch and receives the return values of the request/response
+  // invocations in it. The sender is empty and ready for the next batch
+  // afterwards, even if the batch fails. On failure the invocations that did
+  // not receive their return values are completed with the error.
+  Status<void> Send() {
+    std::vector<Pending> invocations;
+    std::swap(invocations, pending_);
+    const std::uint32_t count = count_;
+    count_ = 0;
+
+    auto status = Write(count);
+    batch_.writer().reset();
+
+    auto invocation = invocations.begin();
+    for (; status && invocation != invocations.end(); ++invocation)
+      status = invocation->Receive(deserializer_);
+
+    for (; invocation != invocations.end(); ++invocation)
+      invocation->Cancel(status.error());
+
+    return status;
+  }
+
+  // Discards the batch, completing the request/response invocations in it with
+  // the given error.
+  void Cancel(ErrorStatus error) {
+    std::vector<Pending> invocations;
+    std::swap(invocations, pending_);
+    count_ = 0;
+    batch_.writer().reset();
+
+    for (Pending& invocation : invocations)
+      invocation.Cancel(error);
+  }
+
+  // Returns the number of invocations in the batch.
+  std::size_t size() const { return count_; }
+
+  // Returns true if the batch has no invocations.
+  bool empty() const { return count_ == 0; }
+
+  constexpr const Serializer& serializer() const { return *serializer_; }
+  constexpr Serializer& serializer() { return *serializer_; }
+  constexpr const Deserializer& deserializer() const { return *deserializer_; }
+  constexpr Deserializer& deserializer() { return *deserializer_; }
+
+ private:
+  using Pending = PendingReturn<Deserializer>;
+
+  // Appends an invocation to the internal buffer. The buffer grows as needed,
+  // so this only fails if a value cannot be encoded, in which case the partial
+  // invocation is discarded.
+  template <typename MethodSelector, typename... Args>
+  Status<void> AddInvocation(MethodSelector method_selector,
+                             const std::tuple<Args...>& args) {
+    const std::size_t size = batch_.writer().size();
+
+    auto status = batch_.Write(method_selector, args);
+    if (!status) {
+      batch_.writer().Truncate(size);
+      return status;
+    }
+
+    count_++;
+    return {};
+  }
+
+  // Writes the invocation count followed by the contents of the internal
+  // buffer.
+  Status<void> Write(std::uint32_t count) {
+    auto status = serializer_->Write(count);
+    if (!status)
+      return status;
+
+    const std::uint8_t* begin = batch_.writer().data();
+    const std::uint8_t* end = begin + batch_.writer().size();
+    auto& writer = serializer_->writer();
+
+    status = writer.Prepare(end - begin);
+    if (!status)
+      return status;
+
+    return writer.Write(begin, end);
+  }
+
+  Serializer* serializer_;
+  Deserializer* deserializer_;
+
+  // Encoded invocations and the completions of the request/response
+  // invocations among them, in order.
+  nop::Serializer<VectorWriter> batch_;
+  std::vector<Pending> pending_;
+  std::uint32_t count_{0};
+};
+
+template <typename Serializer, typename Deserializer>
+BatchMethodSender<Serializer, Deserializer> MakeBatchMethodSender(
+    Serializer* serializer, Deserializer* deserializer) {
+  return {serializer, deserializer};
+}
+
+// Reads a batch of method invocations written by BatchMethodSender with the
+// given receiver and dispatches each of them with the given dispatch table,
+// passing along the given passthrough arguments. Dispatch stops at the first
+// invocation that fails.
+template <typename Receiver, typename Dispatcher, typename... PassthroughArgs>
+Status<void> DispatchBatch(Receiver* receiver, Dispatcher&& dispatcher,
+                           PassthroughArgs... passthrough) {
+  std::uint32_t count;
+  auto status = receiver->deserializer().Read(&count);
+  if (!status)
+    return status;
+
+  for (std::uint32_t i = 0; i < count; i++) {
+    status = dispatcher(receiver, PassthroughArgs(passthrough)...);
+    if (!status)
+      return status;
+  }
+
+  return {};
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_RPC_METHOD_BATCH_H_
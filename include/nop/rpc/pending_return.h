@@ -0,0 +1,118 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_RPC_PENDING_RETURN_H_
+#define LIBNOP_INCLUDE_NOP_RPC_PENDING_RETURN_H_
+
+#include <functional>
+#include <utility>
+
+#include <nop/status.h>
+
+namespace nop {
+
+// PendingReturn holds the completion of a method invocation whose return value
+// has not been received yet, erasing the type of the return value so that
+// senders can keep the pending invocations of different methods together. The
+// completion is called exactly once with the Status<Return> of the method:
+// either with the return value read by Receive() or with the error passed to
+// Cancel().
+template <typename Deserializer>
+class PendingReturn {
+ public:
+  PendingReturn() = default;
+  PendingReturn(const PendingReturn&) = delete;
+  PendingReturn(PendingReturn&& other) { *this = std::move(other); }
+
+  PendingReturn& operator=(const PendingReturn&) = delete;
+  PendingReturn& operator=(PendingReturn&& other) {
+    if (this != &other) {
+      handler_ = std::move(other.handler_);
+      other.handler_ = nullptr;
+    }
+    return *this;
+  }
+
+  // Returns a PendingReturn that calls |completion| with Status<Return>.
+  template <typename Return, typename Completion>
+  static PendingReturn Make(Completion&& completion) {
+    PendingReturn pending;
+    pending.handler_ = [completion = std::forward<Completion>(completion)](
+                           Deserializer* deserializer,
+                           ErrorStatus error) mutable -> Status<void> {
+      Status<Return> return_value;
+      Status<void> status;
+      if (deserializer)
+        status = GetReturn(deserializer, &return_value);
+      else
+        return_value = error;
+
+      completion(std::move(return_value));
+      return status;
+    };
+    return pending;
+  }
+
+  // Reads the return value from |deserializer| and completes the invocation.
+  // The invocation is completed with the error if reading fails.
+  Status<void> Receive(Deserializer* deserializer) {
+    return Complete(deserializer, ErrorStatus::None);
+  }
+
+  // Completes the invocation with the given error.
+  void Cancel(ErrorStatus error) { Complete(nullptr, error); }
+
+  // Returns true if the invocation has not been completed.
+  explicit operator bool() const { return static_cast<bool>(handler_); }
+
+ private:
+  // Completes the invocation, either by reading the return value from the
+  // given deserializer or, when it is nullptr, with the given error.
+  using Handler = std::function<Status<void>(Deserializer*, ErrorStatus)>;
+
+  Status<void> Complete(Deserializer* deserializer, ErrorStatus error) {
+    Handler handler{std::move(handler_)};
+    handler_ = nullptr;
+    if (handler)
+      return handler(deserializer, error);
+    else
+      return {};
+  }
+
+  template <typename Return>
+  static Status<void> GetReturn(Deserializer* deserializer,
+                                Status<Return>* return_status) {
+    Return return_value;
+    auto status = deserializer->Read(&return_value);
+    if (!status)
+      *return_status = status.error();
+    else
+      *return_status = std::move(return_value);
+    return status;
+  }
+
+  static Status<void> GetReturn(Deserializer* /*deserializer*/,
+                                Status<void>* return_status) {
+    *return_status = {};
+    return {};
+  }
+
+  Handler handler_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_RPC_PENDING_RETURN_H_
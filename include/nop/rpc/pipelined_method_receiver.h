@@ -0,0 +1,102 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_RPC_PIPELINED_METHOD_RECEIVER_H_
+#define LIBNOP_INCLUDE_NOP_RPC_PIPELINED_METHOD_RECEIVER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+
+#include <nop/status.h>
+
+namespace nop {
+
+// PipelinedMethodReceiver is the Receiver type that pairs with
+// PipelinedMethodSender. This class deserializes the request id that precedes
+// each method selector and argument tuple, and tags the return value with the
+// same request id, so that the sender can match return values to pending
+// invocations. Each call to a dispatcher handles one invocation; callers may
+// dispatch repeatedly to drain all of the invocations the sender has written.
+//
+// Receivers that complete invocations out of order, for example by handing
+// work off to other threads, may record request_id() after reading the
+// invocation and pass it to SendReturn() later.
+template <typename Serializer, typename Deserializer,
+          typename RequestId = std::uint32_t>
+class PipelinedMethodReceiver {
+  static_assert(std::is_integral<RequestId>::value &&
+                    std::is_unsigned<RequestId>::value,
+                "Request ids must be an unsigned integral type.");
+
+ public:
+  // The number of top-level values that make up each invocation: the request
+  // id, the method selector, and the argument tuple. Framing layers use this to
+  // find the end of an invocation.
+  enum : std::size_t { InvocationValues = 3 };
+
+  constexpr PipelinedMethodReceiver(Serializer* serializer,
+                                    Deserializer* deserializer)
+      : serializer_{serializer}, deserializer_{deserializer} {}
+
+  template <typename MethodSelector>
+  Status<void> GetMethodSelector(MethodSelector* method_selector) {
+    return deserializer_->Read(&request_id_, method_selector);
+  }
+
+  template <typename... Args>
+  Status<void> GetArgs(std::tuple<Args...>* args) {
+    return deserializer_->Read(args);
+  }
+
+  // Sends the return value of the invocation that was read last.
+  template <typename Return>
+  Status<void> SendReturn(const Return& return_value) {
+    return SendReturn(request_id_, return_value);
+  }
+
+  // Sends the return value of the invocation with the given request id.
+  template <typename Return>
+  Status<void> SendReturn(RequestId request_id, const Return& return_value) {
+    return serializer_->Write(request_id, return_value);
+  }
+
+  // Returns the request id of the invocation that was read last.
+  constexpr RequestId request_id() const { return request_id_; }
+
+  constexpr const Serializer& serializer() const { return *serializer_; }
+  constexpr Serializer& serializer() { return *serializer_; }
+  constexpr const Deserializer& deserializer() const { return *deserializer_; }
+  constexpr Deserializer& deserializer() { return *deserializer_; }
+
+ private:
+  Serializer* serializer_;
+  Deserializer* deserializer_;
+  RequestId request_id_{0};
+};
+
+template <typename RequestId = std::uint32_t, typename Serializer,
+          typename Deserializer>
+PipelinedMethodReceiver<Serializer, Deserializer, RequestId>
+MakePipelinedMethodReceiver(Serializer* serializer,
+                            Deserializer* deserializer) {
+  return {serializer, deserializer};
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_RPC_PIPELINED_METHOD_RECEIVER_H_
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_RPC_PIPELINED_METHOD_SENDER_H_
+#define LIBNOP_INCLUDE_NOP_RPC_PIPELINED_METHOD_SENDER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <nop/rpc/pending_return.h>
+#include <nop/status.h>
+
+namespace nop {
+
+// PipelinedMethodSender is an implementation of the Sender type required by
+// the remote interface support in nop/rpc/interface.h that allows many method
+// invocations to be in flight at the same time. Each invocation is tagged with
+// a request id that precedes the method selector and arguments, and the remote
+// receiver tags each return value with the id of the invocation it belongs to.
+// Use PipelinedMethodReceiver at the other end.
+//
+// Methods invoked with InterfaceMethod::InvokeAsync() return as soon as the
+// invocation is written. The completion passed to InvokeAsync() is called with
+// the Status<Return> of the method when ReceiveReturn() reads the matching
+// return value, in whatever order the return values arrive. Methods invoked
+// with InterfaceMethod::Invoke() block until their own return value arrives,
+// completing any other pending invocations whose return values arrive first.
+//
+// Request ids are assigned sequentially and wrap around, so at most as many
+// invocations as there are values of RequestId may be pending at once.
+//
+// Example:
+//
+//   auto sender = nop::MakePipelinedMethodSender(&serializer, &deserializer);
+//   for (const auto& sample : samples) {
+//     MyInterface::Record::InvokeAsync(&sender, [](nop::Status<bool> status) {
+//       ...
+//     }, sample);
+//   }
+//   sender.ReceiveAll();
+//
+template <typename Serializer, typename Deserializer,
+          typename RequestId = std::uint32_t>
+class PipelinedMethodSender {
+  static_assert(std::is_integral<RequestId>::value &&
+                    std::is_unsigned<RequestId>::value,
+                "Request ids must be an unsigned integral type.");
+
+ public:
+  PipelinedMethodSender(Serializer* serializer, Deserializer* deserializer)
+      : serializer_{serializer}, deserializer_{deserializer} {}
+
+  // Writes the method invocation and returns the request id assigned to it,
+  // without waiting for the return value. The completion is called with the
+  // Status<Return> of the method when the return value is received, or with an
+  // error if the invocation is canceled.
+  template <typename Return, typename MethodSelector, typename Completion,
+            typename... Args>
+  Status<RequestId> SendMethodAsync(MethodSelector method_selector,
+                                    Completion&& completion,
+                                    const std::tuple<Args...>& args) {
+    // Every value of RequestId is already in use by a pending invocation.
+    if (pending_.size() >
+        static_cast<std::size_t>(std::numeric_limits<RequestId>::max())) {
+      return ErrorStatus::ProtocolError;
+    }
+
+    const RequestId request_id =
+        static_cast<RequestId>(base_ + pending_.size());
+
+    auto status = serializer_->Write(request_id, method_selector, args);
+    if (!status)
+      return status.error();
+
+    pending_.emplace_back(
+        Pending::template Make<Return>(std::forward<Completion>(completion)));
+    pending_count_++;
+    return request_id;
+  }
+
+  // Writes the method invocation and receives return values until the return
+  // value for this invocation arrives.
+  template <typename MethodSelector, typename Return, typename... Args>
+  void SendMethod(MethodSelector method_selector, Status<Return>* return_value,
+                  const std::tuple<Args...>& args) {
+    bool done = false;
+    auto status = SendMethodAsync<Return>(
+        method_selector,
+        [return_value, &done](Status<Return> method_status) {
+          *return_value = std::move(method_status);
+          done = true;
+        },
+        args);
+    if (!status) {
+      *return_value = status.error();
+      return;
+    }
+
+    // A failure to receive cancels every pending invocation, including this
+    // one, so the loop always terminates with |return_value| set.
+    while (!done)
+      ReceiveReturn();
+  }
+
+  // Writes the invocation of a one-way method. One-way invocations carry the
+  // next request id, to keep the framing the same for the receiver, but do
+  // not consume it because no return value refers to them.
+  template <typename MethodSelector, typename... Args>
+  Status<void> SendOneWayMethod(MethodSelector method_selector,
+                                const std::tuple<Args...>& args) {
+    const RequestId request_id =
+        static_cast<RequestId>(base_ + pending_.size());
+
+    return serializer_->Write(request_id, method_selector, args);
+  }
+
+  // Receives one return value and completes the pending invocation it belongs
+  // to. When receiving fails the position in the input is unknown, so every
+  // pending invocation is canceled with the error.
+  Status<void> ReceiveReturn() {
+    RequestId request_id;
+    auto status = deserializer_->Read(&request_id);
+    if (!status) {
+      Cancel(status.error());
+      return status;
+    }
+
+    const std::size_t index = static_cast<RequestId>(request_id - base_);
+    if (index >= pending_.size() || !pending_[index]) {
+      Cancel(ErrorStatus::ProtocolError);
+      return ErrorStatus::ProtocolError;
+    }
+
+    Pending invocation = std::move(pending_[index]);
+    pending_count_--;
+
+    // Drop completed invocations from the front of the table.
+    while (!pending_.empty() && !pending_.front()) {
+      pending_.pop_front();
+      base_++;
+    }
+
+    status = invocation.Receive(deserializer_);
+    if (!status)
+      Cancel(status.error());
+    return status;
+  }
+
+  // Receives return values until there are no pending invocations.
+  Status<void> ReceiveAll() {
+    while (pending() != 0) {
+      auto status = ReceiveReturn();
+      if (!status)
+        return status;
+    }
+    return {};
+  }
+
+  // Completes every pending invocation with the given error, for example when
+  // the connection is closed.
+  void Cancel(ErrorStatus error) {
+    std::deque<Pending> invocations;
+    std::swap(invocations, pending_);
+    base_ = static_cast<RequestId>(base_ + invocations.size());
+    pending_count_ = 0;
+
+    for (Pending& invocation : invocations)
+      invocation.Cancel(error);
+  }
+
+  // Returns the number of invocations waiting for return values.
+  std::size_t pending() const { return pending_count_; }
+
+  constexpr const Serializer& serializer() const { return *serializer_; }
+  constexpr Serializer& serializer() { return *serializer_; }
+  constexpr const Deserializer& deserializer() const { return *deserializer_; }
+  constexpr Deserializer& deserializer() { return *deserializer_; }
+
+ private:
+  using Pending = PendingReturn<Deserializer>;
+
+  Serializer* serializer_;
+  Deserializer* deserializer_;
+
+  // The invocations with request ids starting at |base_|. Completed
+  // invocations are empty until they reach the front of the table.
+  std::deque<Pending> pending_;
+  RequestId base_{0};
+  std::size_t pending_count_{0};
+};
+
+template <typename RequestId = std::uint32_t, typename Serializer,
+          typename Deserializer>
+PipelinedMethodSender<Serializer, Deserializer, RequestId>
+MakePipelinedMethodSender(Serializer* serializer, Deserializer* deserializer) {
+  return {serializer, deserializer};
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_RPC_PIPELINED_METHOD_SENDER_H_
@@ -17,8 +17,11 @@
 #ifndef LIBNOP_INCLUDE_NOP_RPC_SIMPLE_METHOD_RECEIVER_H_
 #define LIBNOP_INCLUDE_NOP_RPC_SIMPLE_METHOD_RECEIVER_H_
 
+#include <cstddef>
 #include <tuple>
 
+#include <nop/status.h>
+
 namespace nop {
 
 // SimpleMethodReceiver is a minimal implementation of the Receiver type
@@ -29,6 +32,11 @@ namespace nop {
 template <typename Serializer, typename Deserializer>
 class SimpleMethodReceiver {
  public:
+  // The number of top-level values that make up each invocation: the method
+  // selector and the argument tuple. Framing layers use this to find the end of
+  // an invocation.
+  enum : std::size_t { InvocationValues = 2 };
+
   constexpr SimpleMethodReceiver(Serializer* serializer,
                                  Deserializer* deserializer)
       : serializer_{serializer}, deserializer_{deserializer} {}
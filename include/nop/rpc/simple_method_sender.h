@@ -37,13 +37,7 @@ class SimpleMethodSender {
   constexpr void SendMethod(MethodSelector method_selector,
                             Status<Return>* return_value,
                             const std::tuple<Args...>& args) {
-    auto status = serializer_->Write(method_selector);
-    if (!status) {
-      *return_value = status.error();
-      return;
-    }
-
-    status = serializer_->Write(args);
+    auto status = serializer_->Write(method_selector, args);
     if (!status) {
       *return_value = status.error();
       return;
@@ -52,6 +46,12 @@ class SimpleMethodSender {
     GetReturn(return_value);
   }
 
+  template <typename MethodSelector, typename... Args>
+  constexpr Status<void> SendOneWayMethod(MethodSelector method_selector,
+                                          const std::tuple<Args...>& args) {
+    return serializer_->Write(method_selector, args);
+  }
+
   constexpr const Serializer& serializer() const { return *serializer_; }
   constexpr Serializer& serializer() { return *serializer_; }
   constexpr const Deserializer& deserializer() const { return *deserializer_; }
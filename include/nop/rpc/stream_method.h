@@ -0,0 +1,437 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_RPC_STREAM_METHOD_H_
+#define LIBNOP_INCLUDE_NOP_RPC_STREAM_METHOD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <nop/rpc/interface.h>
+#include <nop/status.h>
+
+namespace nop {
+
+//
+// Streaming interface methods carry a sequence of values in one call. Server
+// streaming methods send one invocation and receive any number of values
+// back; client streaming methods send any number of values after the
+// invocation and receive a single return value.
+//
+// Values are written to the underlying serializer as soon as they are
+// produced, each preceded by a true flag, and the stream ends with a false flag
+// followed by the error code of the producer, or zero if the stream completed.
+// A blocking transport such as a pipe or socket provides flow control: a
+// producer that gets ahead of its consumer blocks in the write.
+//
+// Streaming methods use the framing of SimpleMethodSender and
+// SimpleMethodReceiver and are bound and dispatched together with the other
+// methods of an interface by BindInterface().
+//
+// Example:
+//
+//   struct FileInterface : nop::Interface<FileInterface> {
+//     NOP_INTERFACE("io.github.eieio.FileInterface");
+//     NOP_SERVER_STREAM_METHOD(Read, Chunk(const std::string& path));
+//     NOP_CLIENT_STREAM_METHOD(Write, Chunk, bool(const std::string& path));
+//     NOP_INTERFACE_API(Read, Write);
+//   };
+//
+//   // Server:
+//   FileInterface::Read::Bind(
+//       [](const std::string& path, nop::StreamWriter<Chunk>& chunks) {
+//         ...
+//         return chunks.Write(chunk);
+//       });
+//   FileInterface::Write::Bind(
+//       [](const std::string& path, nop::StreamReader<Chunk>& chunks) {
+//         Chunk chunk;
+//         while (chunks.Read(&chunk).get()) ...
+//         return true;
+//       });
+//
+//   // Client:
+//   FileInterface::Read::Invoke(&sender, [](Chunk chunk) { ... }, "foo");
+//   FileInterface::Write::Invoke(
+//       &sender, [&](nop::StreamWriter<Chunk>& chunks) -> nop::Status<void> {
+//         return chunks.Write(chunk);
+//       },
+//       "foo");
+//
+
+// Writes the values of a stream of T with a serializer, which is type-erased
+// so that handlers can name the writer type.
+template <typename T>
+class StreamWriter {
+ public:
+  template <typename Serializer>
+  explicit StreamWriter(Serializer* serializer)
+      : serializer_{serializer},
+        write_{&WriteValue<Serializer>},
+        close_{&WriteEnd<Serializer>} {}
+
+  StreamWriter(const StreamWriter&) = delete;
+  void operator=(const StreamWriter&) = delete;
+
+  // Writes the next value of the stream.
+  Status<void> Write(const T& value) {
+    if (closed_)
+      return ErrorStatus::ProtocolError;
+    return write_(serializer_, value);
+  }
+
+  // Ends the stream, passing the error in |status|, if any, to the reader.
+  // Returns the status of writing the end of the stream.
+  Status<void> Close(const Status<void>& status = {}) {
+    if (closed_)
+      return ErrorStatus::ProtocolError;
+
+    closed_ = true;
+    return close_(serializer_, status ? 0
+                                      : static_cast<std::int32_t>(
+                                            status.error()));
+  }
+
+ private:
+  template <typename Serializer>
+  static Status<void> WriteValue(void* context, const T& value) {
+    auto* serializer = static_cast<Serializer*>(context);
+    return serializer->Write(true, value);
+  }
+
+  template <typename Serializer>
+  static Status<void> WriteEnd(void* context, std::int32_t error) {
+    auto* serializer = static_cast<Serializer*>(context);
+    return serializer->Write(false, error);
+  }
+
+  void* serializer_;
+  Status<void> (*write_)(void*, const T&);
+  Status<void> (*close_)(void*, std::int32_t);
+  bool closed_{false};
+};
+
+// Reads the values of a stream of T with a deserializer, which is type-erased
+// so that handlers can name the reader type.
+template <typename T>
+class StreamReader {
+ public:
+  template <typename Deserializer>
+  explicit StreamReader(Deserializer* deserializer)
+      : deserializer_{deserializer},
+        read_flag_{&ReadValue<Deserializer, bool>},
+        read_value_{&ReadValue<Deserializer, T>},
+        read_error_{&ReadValue<Deserializer, std::int32_t>} {}
+
+  StreamReader(const StreamReader&) = delete;
+  void operator=(const StreamReader&) = delete;
+
+  // Reads the next value of the stream. Returns true if a value was read or
+  // false at the end of the stream. Returns the error of the producer if it
+  // ended the stream with one, or the error reading the stream.
+  Status<bool> Read(T* value) {
+    if (!status_)
+      return status_.error();
+    else if (ended_)
+      return false;
+
+    bool more = false;
+    auto status = read_flag_(deserializer_, &more);
+    if (status && more)
+      status = read_value_(deserializer_, value);
+    if (status && more)
+      return true;
+
+    std::int32_t error = 0;
+    if (status)
+      status = read_error_(deserializer_, &error);
+    if (status && error != 0)
+      status = static_cast<ErrorStatus>(error);
+
+    ended_ = true;
+    status_ = status;
+    if (!status)
+      return status.error();
+    else
+      return false;
+  }
+
+  // Reads and discards the rest of the stream. Returns the same errors as
+  // Read().
+  Status<void> Drain() {
+    T value;
+    while (true) {
+      auto status = Read(&value);
+      if (!status)
+        return status.error();
+      else if (!status.get())
+        return {};
+    }
+  }
+
+  // Returns true if the end of the stream has been read.
+  bool ended() const { return ended_; }
+
+ private:
+  template <typename Deserializer, typename U>
+  static Status<void> ReadValue(void* context, U* value) {
+    return static_cast<Deserializer*>(context)->Read(value);
+  }
+
+  void* deserializer_;
+  Status<void> (*read_flag_)(void*, bool*);
+  Status<void> (*read_value_)(void*, T*);
+  Status<void> (*read_error_)(void*, std::int32_t*);
+  Status<void> status_;
+  bool ended_{false};
+};
+
+// ServerStreamMethod is the counterpart of InterfaceMethod for methods that
+// return a stream of Element values. Handlers take the protocol arguments
+// followed by a StreamWriter<Element>&, which they write the values to, and
+// return Status<void>; an error ends the stream with that error.
+template <typename MethodSelector_, MethodSelector_ Selector_,
+          typename Signature>
+struct ServerStreamMethod;
+
+template <typename MethodSelector_, MethodSelector_ Selector_,
+          typename Element_, typename... Args>
+struct ServerStreamMethod<MethodSelector_, Selector_, Element_(Args...)> {
+  static_assert(std::is_integral<MethodSelector_>::value,
+                "Method selector must be an integral type.");
+
+  using MethodSelector = MethodSelector_;
+  using Element = Element_;
+  using ArgsTuple = std::tuple<std::decay_t<Args>...>;
+
+  enum : MethodSelector { Selector = Selector_ };
+
+  static bool Match(MethodSelector method_selector) {
+    return method_selector == Selector;
+  }
+
+  // Invokes this method using the given sender, calling |on_value| with each
+  // value of the stream until the stream ends. Returns the error that ended
+  // the stream, if any. The sender must write invocations directly, as
+  // SimpleMethodSender does.
+  template <typename Sender, typename OnValue>
+  static Status<void> Invoke(Sender* sender, OnValue&& on_value, Args... args) {
+    auto status =
+        sender->SendOneWayMethod(Selector, std::forward_as_tuple(args...));
+    if (!status)
+      return status;
+
+    StreamReader<Element> reader{&sender->deserializer()};
+    while (true) {
+      Element value;
+      auto read_status = reader.Read(&value);
+      if (!read_status)
+        return read_status.error();
+      else if (!read_status.get())
+        return {};
+
+      on_value(std::move(value));
+    }
+  }
+
+  template <typename Op>
+  struct FunctionBinding {
+    using InterfaceMethodType = ServerStreamMethod;
+
+    Op op;
+
+    static bool Match(MethodSelector method_selector) {
+      return ServerStreamMethod::Match(method_selector);
+    }
+
+    template <typename Receiver, typename... Passthrough>
+    Status<void> Dispatch(Receiver* receiver,
+                          Passthrough&&... passthrough) const {
+      ArgsTuple args;
+      auto status = receiver->GetArgs(&args);
+      if (!status)
+        return status;
+
+      StreamWriter<Element> writer{&receiver->serializer()};
+      Status<void> result =
+          Call(op, &args, &writer, std::make_index_sequence<sizeof...(Args)>{},
+               std::forward<Passthrough>(passthrough)...);
+      return writer.Close(result);
+    }
+  };
+
+  template <typename Op>
+  static constexpr auto Bind(Op&& op) {
+    return FunctionBinding<Op>{std::forward<Op>(op)};
+  }
+
+ private:
+  template <typename Op, std::size_t... Is, typename... Passthrough>
+  static Status<void> Call(Op&& op, ArgsTuple* args,
+                           StreamWriter<Element>* writer,
+                           std::index_sequence<Is...>,
+                           Passthrough&&... passthrough) {
+    // Silence compiler warning in case the handler doesn't have arguments.
+    (void)args;
+
+    return std::forward<Op>(op)(std::forward<Passthrough>(passthrough)...,
+                                std::get<Is>(std::move(*args))..., *writer);
+  }
+};
+
+// ClientStreamMethod is the counterpart of InterfaceMethod for methods that
+// take a stream of Element values after their arguments. Handlers take the
+// protocol arguments followed by a StreamReader<Element>&, which they read the
+// values from, and return the return value. Values the handler does not read
+// are discarded before the return value is sent.
+template <typename MethodSelector_, MethodSelector_ Selector_,
+          typename Element_, typename Signature>
+struct ClientStreamMethod;
+
+template <typename MethodSelector_, MethodSelector_ Selector_,
+          typename Element_, typename Return, typename... Args>
+struct ClientStreamMethod<MethodSelector_, Selector_, Element_,
+                          Return(Args...)> {
+  static_assert(std::is_integral<MethodSelector_>::value,
+                "Method selector must be an integral type.");
+
+  using MethodSelector = MethodSelector_;
+  using Element = Element_;
+  using ArgsTuple = std::tuple<std::decay_t<Args>...>;
+
+  enum : MethodSelector { Selector = Selector_ };
+
+  static bool Match(MethodSelector method_selector) {
+    return method_selector == Selector;
+  }
+
+  // Invokes this method using the given sender and calls |producer| with a
+  // StreamWriter<Element>& to write the stream. The stream ends when the
+  // producer returns, passing along the error it returns, if any. Returns the
+  // return value of the method, or the error of the producer.
+  template <typename Sender, typename Producer>
+  static Status<Return> Invoke(Sender* sender, Producer&& producer,
+                               Args... args) {
+    auto status =
+        sender->SendOneWayMethod(Selector, std::forward_as_tuple(args...));
+    if (!status)
+      return status.error();
+
+    StreamWriter<Element> writer{&sender->serializer()};
+    Status<void> produced = producer(writer);
+    status = writer.Close(produced);
+    if (!status)
+      return status.error();
+
+    // The handler returns a value even when the stream ends with an error.
+    Return return_value;
+    status = sender->deserializer().Read(&return_value);
+    if (!status)
+      return status.error();
+    else if (!produced)
+      return produced.error();
+    else
+      return {std::move(return_value)};
+  }
+
+  template <typename Op>
+  struct FunctionBinding {
+    using InterfaceMethodType = ClientStreamMethod;
+
+    Op op;
+
+    static bool Match(MethodSelector method_selector) {
+      return ClientStreamMethod::Match(method_selector);
+    }
+
+    template <typename Receiver, typename... Passthrough>
+    Status<void> Dispatch(Receiver* receiver,
+                          Passthrough&&... passthrough) const {
+      ArgsTuple args;
+      auto status = receiver->GetArgs(&args);
+      if (!status)
+        return status;
+
+      StreamReader<Element> reader{&receiver->deserializer()};
+      Return return_value{
+          Call(op, &args, &reader, std::make_index_sequence<sizeof...(Args)>{},
+               std::forward<Passthrough>(passthrough)...)};
+
+      // An error in the stream itself means the position in the input is
+      // unknown. Errors the producer ended the stream with are only reported
+      // to the handler.
+      status = reader.Drain();
+      if (!status && !reader.ended())
+        return status;
+
+      return receiver->SendReturn(return_value);
+    }
+  };
+
+  template <typename Op>
+  static constexpr auto Bind(Op&& op) {
+    return FunctionBinding<Op>{std::forward<Op>(op)};
+  }
+
+ private:
+  template <typename Op, std::size_t... Is, typename... Passthrough>
+  static Return Call(Op&& op, ArgsTuple* args, StreamReader<Element>* reader,
+                     std::index_sequence<Is...>,
+                     Passthrough&&... passthrough) {
+    // Silence compiler warning in case the handler doesn't have arguments.
+    (void)args;
+
+    return static_cast<Return>(
+        std::forward<Op>(op)(std::forward<Passthrough>(passthrough)...,
+                             std::get<Is>(std::move(*args))..., *reader));
+  }
+};
+
+// Defines a server streaming method with the given name and signature, whose
+// return type is the type of the values in the stream. This macro is used in
+// the same places as NOP_METHOD().
+#define NOP_SERVER_STREAM_METHOD(name, ... /* signature */)         \
+  NOP_SERVER_STREAM_METHOD_SEL(                                     \
+      ::nop::ComputeMethodSelector<NOP__INTERFACE::MethodSelector>( \
+          #name, NOP__INTERFACE::Hash),                             \
+      name, __VA_ARGS__)
+
+// Defines a server streaming method with a manually specified selector.
+#define NOP_SERVER_STREAM_METHOD_SEL(selector, name, ... /* signature */) \
+  using name = ::nop::ServerStreamMethod<NOP__INTERFACE::MethodSelector,  \
+                                         selector, __VA_ARGS__>
+
+// Defines a client streaming method with the given name, type of the values in
+// the stream, and signature. This macro is used in the same places as
+// NOP_METHOD().
+#define NOP_CLIENT_STREAM_METHOD(name, element, ... /* signature */) \
+  NOP_CLIENT_STREAM_METHOD_SEL(                                      \
+      ::nop::ComputeMethodSelector<NOP__INTERFACE::MethodSelector>(  \
+          #name, NOP__INTERFACE::Hash),                              \
+      name, element, __VA_ARGS__)
+
+// Defines a client streaming method with a manually specified selector.
+#define NOP_CLIENT_STREAM_METHOD_SEL(selector, name, element,         \
+                                     ... /* signature */)             \
+  using name = ::nop::ClientStreamMethod<NOP__INTERFACE::MethodSelector, \
+                                         selector, element, __VA_ARGS__>
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_RPC_STREAM_METHOD_H_
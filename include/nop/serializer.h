@@ -18,23 +18,42 @@
 #define LIBNOP_INCLUDE_NOP_SERIALIZER_H_
 
 #include <nop/base/array.h>
+#include <nop/base/bitset.h>
+#include <nop/base/columnar.h>
+#include <nop/base/delta.h>
+#include <nop/base/deque.h>
+#include <nop/base/diff.h>
 #include <nop/base/encoding.h>
 #include <nop/base/enum.h>
+#include <nop/base/flat_map.h>
 #include <nop/base/handle.h>
+#include <nop/base/hash_map.h>
+#include <nop/base/lazy.h>
 #include <nop/base/list.h>
 #include <nop/base/map.h>
 #include <nop/base/members.h>
 #include <nop/base/optional.h>
 #include <nop/base/pair.h>
+#include <nop/base/pointer.h>
+#include <nop/base/pre_encoded.h>
 #include <nop/base/reference_wrapper.h>
 #include <nop/base/result.h>
 #include <nop/base/serializer.h>
 #include <nop/base/set.h>
+#include <nop/base/shared_blob.h>
+#include <nop/base/shared_frame.h>
+#include <nop/base/skip.h>
+#include <nop/base/slot.h>
+#include <nop/base/static_string.h>
+#include <nop/base/static_vector.h>
+#include <nop/base/streaming_payload.h>
 #include <nop/base/string.h>
 #include <nop/base/table.h>
 #include <nop/base/tuple.h>
+#include <nop/base/validate.h>
 #include <nop/base/value.h>
 #include <nop/base/variant.h>
 #include <nop/base/vector.h>
+#include <nop/base/view.h>
 
 #endif  // LIBNOP_INCLUDE_NOP_SERIALIZER_H_
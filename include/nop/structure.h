@@ -61,6 +61,36 @@ namespace nop {
   friend struct ::nop::MemberListTraits;      \
   using NOP__MEMBERS = ::nop::MemberList<_NOP_MEMBER_LIST(type, __VA_ARGS__)>
 
+// Defines the set of members belonging to a trivially copyable type, like
+// NOP_STRUCTURE, and marks the type as a raw structure. Raw structures are
+// encoded as their direct memory representation in a single BINARY container
+// and decoded with one copy, instead of member by member. Containers of raw
+// structures are packed into one BINARY container, like containers of integral
+// types. Every member of a raw structure must be an integral, float, or double
+// type, another raw structure, or an array of these, and the members must
+// cover the whole structure, without padding.
+//
+// The encoding of a raw structure is not compatible with the encoding of the
+// same type annotated with NOP_STRUCTURE. Raw structures are stored in host
+// byte order, so unlike packed containers of integral types, which are
+// converted to little-endian on big-endian hosts, they are only supported on
+// little-endian hosts.
+//
+// Example:
+//
+//  struct Vec3 {
+//    float x;
+//    float y;
+//    float z;
+//    NOP_RAW_STRUCTURE(Vec3, x, y, z);
+//  };
+//
+#define NOP_RAW_STRUCTURE(type, ... /*members*/) \
+  NOP_STRUCTURE(type, __VA_ARGS__);               \
+  template <typename, typename>                   \
+  friend struct ::nop::IsRawStructure;            \
+  using NOP__RAW_STRUCTURE = void
+
 // Defines the set of members belonging to a type that should be
 // serialized/deserialized without changing the type itself. This is useful for
 // making external library types with public data serializable.
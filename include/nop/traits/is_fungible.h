@@ -18,9 +18,11 @@
 #define LIBNOP_INCLUDE_NOP_TRAITS_IS_FUNGIBLE_H_
 
 #include <array>
+#include <deque>
 #include <list>
 #include <map>
 #include <set>
+#include <string>
 #include <tuple>
 #include <type_traits>
 #include <unordered_map>
@@ -32,9 +34,14 @@
 #include <nop/base/members.h>
 #include <nop/base/table.h>
 #include <nop/base/utility.h>
+#include <nop/types/flat_map.h>
+#include <nop/types/hash_map.h>
 #include <nop/types/optional.h>
 #include <nop/types/result.h>
+#include <nop/types/static_string.h>
+#include <nop/types/static_vector.h>
 #include <nop/types/variant.h>
+#include <nop/types/view.h>
 
 // This header defines rules for which types have equivalent encodings. Types
 // with equivalent encodings my be legally substituted during serialization and
@@ -148,6 +155,78 @@ struct IsFungible<std::unordered_set<A, AnyA...>,
     : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
 
 // Compares two std::tuples to see if the corresponding elements are
+// Traits for the map and set types that share the MAP and array encodings.
+// FlatMap, HashMap, and FlatSet are the types defined by this library.
+template <typename T>
+struct MapTypeTraits : std::false_type {};
+template <typename Key, typename T, typename... Any>
+struct MapTypeTraits<std::map<Key, T, Any...>> : std::true_type {
+  using KeyType = Key;
+  using MappedType = T;
+  using IsLibraryType = std::false_type;
+};
+template <typename Key, typename T, typename... Any>
+struct MapTypeTraits<std::unordered_map<Key, T, Any...>> : std::true_type {
+  using KeyType = Key;
+  using MappedType = T;
+  using IsLibraryType = std::false_type;
+};
+template <typename Key, typename T, typename... Any>
+struct MapTypeTraits<FlatMap<Key, T, Any...>> : std::true_type {
+  using KeyType = Key;
+  using MappedType = T;
+  using IsLibraryType = std::true_type;
+};
+template <typename Key, typename T, typename... Any>
+struct MapTypeTraits<HashMap<Key, T, Any...>> : std::true_type {
+  using KeyType = Key;
+  using MappedType = T;
+  using IsLibraryType = std::true_type;
+};
+
+template <typename T>
+struct SetTypeTraits : std::false_type {};
+template <typename Key, typename... Any>
+struct SetTypeTraits<std::set<Key, Any...>> : std::true_type {
+  using KeyType = Key;
+  using IsLibraryType = std::false_type;
+};
+template <typename Key, typename... Any>
+struct SetTypeTraits<std::unordered_set<Key, Any...>> : std::true_type {
+  using KeyType = Key;
+  using IsLibraryType = std::false_type;
+};
+template <typename Key, typename... Any>
+struct SetTypeTraits<FlatSet<Key, Any...>> : std::true_type {
+  using KeyType = Key;
+  using IsLibraryType = std::true_type;
+};
+
+// Compares the library map types with each other and with the standard map
+// types to see if the key and value types are fungible. Pairs of standard map
+// types are handled above.
+template <typename A, typename B>
+struct IsFungible<
+    A, B,
+    std::enable_if_t<MapTypeTraits<A>::value && MapTypeTraits<B>::value &&
+                     (MapTypeTraits<A>::IsLibraryType::value ||
+                      MapTypeTraits<B>::IsLibraryType::value)>>
+    : And<IsFungible<std::decay_t<typename MapTypeTraits<A>::KeyType>,
+                     std::decay_t<typename MapTypeTraits<B>::KeyType>>,
+          IsFungible<std::decay_t<typename MapTypeTraits<A>::MappedType>,
+                     std::decay_t<typename MapTypeTraits<B>::MappedType>>> {};
+
+// Compares the library set types with each other and with the standard set
+// types to see if the element types are fungible.
+template <typename A, typename B>
+struct IsFungible<
+    A, B,
+    std::enable_if_t<SetTypeTraits<A>::value && SetTypeTraits<B>::value &&
+                     (SetTypeTraits<A>::IsLibraryType::value ||
+                      SetTypeTraits<B>::IsLibraryType::value)>>
+    : IsFungible<std::decay_t<typename SetTypeTraits<A>::KeyType>,
+                 std::decay_t<typename SetTypeTraits<B>::KeyType>> {};
+
 // fungible. Fungible tuples must have the same number of elements.
 template <typename... A, typename... B>
 struct IsFungible<std::tuple<A...>, std::tuple<B...>,
@@ -176,47 +255,47 @@ struct IsFungible<std::tuple<A, B>, std::pair<C, D>>
           IsFungible<std::decay_t<B>, std::decay_t<D>>> {};
 
 // Compares std::vector with an n-element std::tuple to see if every element of
-// the tuple is fugible with the non-integral vector element type.
+// the tuple is fugible with the non-packable vector element type.
 template <typename T, typename Allocator, typename... Ts>
 struct IsFungible<std::vector<T, Allocator>, std::tuple<Ts...>,
-                  EnableIfNotIntegral<T>> : And<IsFungible<T, Ts>...> {};
+                  EnableIfNotPackable<T>> : And<IsFungible<T, Ts>...> {};
 template <typename T, typename Allocator, typename... Ts>
 struct IsFungible<std::tuple<Ts...>, std::vector<T, Allocator>,
-                  EnableIfNotIntegral<T>> : And<IsFungible<T, Ts>...> {};
+                  EnableIfNotPackable<T>> : And<IsFungible<T, Ts>...> {};
 
 // Compares std::list with an n-element std::tuple to see if every element of
-// the tuple is fugible with the non-integral list element type.
+// the tuple is fugible with the non-packable list element type.
 template <typename T, typename Allocator, typename... Ts>
 struct IsFungible<std::list<T, Allocator>, std::tuple<Ts...>,
-                  EnableIfNotIntegral<T>> : And<IsFungible<T, Ts>...> {};
+                  EnableIfNotPackable<T>> : And<IsFungible<T, Ts>...> {};
 template <typename T, typename Allocator, typename... Ts>
 struct IsFungible<std::tuple<Ts...>, std::list<T, Allocator>,
-                  EnableIfNotIntegral<T>> : And<IsFungible<T, Ts>...> {};
+                  EnableIfNotPackable<T>> : And<IsFungible<T, Ts>...> {};
 
 // Compares std::array with an n-element std::tuple to see if every element of
-// the tuple is fugible with the non-integral array element type.
+// the tuple is fugible with the non-packable array element type.
 template <typename T, std::size_t Size, typename... Ts>
 struct IsFungible<
     std::array<T, Size>, std::tuple<Ts...>,
-    std::enable_if_t<Size == sizeof...(Ts) && !std::is_integral<T>::value>>
+    std::enable_if_t<Size == sizeof...(Ts) && !IsPackable<T>::value>>
     : And<IsFungible<T, Ts>...> {};
 template <typename T, std::size_t Size, typename... Ts>
 struct IsFungible<
     std::tuple<Ts...>, std::array<T, Size>,
-    std::enable_if_t<Size == sizeof...(Ts) && !std::is_integral<T>::value>>
+    std::enable_if_t<Size == sizeof...(Ts) && !IsPackable<T>::value>>
     : And<IsFungible<T, Ts>...> {};
 
 // Compares C array with an n-element std::tuple to see if every element of
-// the tuple is fugible with the non-integral C array element type.
+// the tuple is fugible with the non-packable C array element type.
 template <typename T, std::size_t Size, typename... Ts>
 struct IsFungible<
     T[Size], std::tuple<Ts...>,
-    std::enable_if_t<Size == sizeof...(Ts) && !std::is_integral<T>::value>>
+    std::enable_if_t<Size == sizeof...(Ts) && !IsPackable<T>::value>>
     : And<IsFungible<T, Ts>...> {};
 template <typename T, std::size_t Size, typename... Ts>
 struct IsFungible<
     std::tuple<Ts...>, T[Size],
-    std::enable_if_t<Size == sizeof...(Ts) && !std::is_integral<T>::value>>
+    std::enable_if_t<Size == sizeof...(Ts) && !IsPackable<T>::value>>
     : And<IsFungible<T, Ts>...> {};
 
 // Compares std::vector and std::array to see if the element types are
@@ -262,6 +341,37 @@ template <typename A, typename B, typename Allocator, std::size_t Size>
 struct IsFungible<std::list<A, Allocator>, B[Size]>
     : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
 
+// Compares two std::deques to see if the element types are fungible.
+template <typename A, typename B, typename AllocatorA, typename AllocatorB>
+struct IsFungible<std::deque<A, AllocatorA>, std::deque<B, AllocatorB>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+
+// Compares std::deque and std::vector to see if the element types are
+// fungible.
+template <typename A, typename B, typename AllocatorA, typename AllocatorB>
+struct IsFungible<std::deque<A, AllocatorA>, std::vector<B, AllocatorB>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+template <typename A, typename B, typename AllocatorA, typename AllocatorB>
+struct IsFungible<std::vector<A, AllocatorA>, std::deque<B, AllocatorB>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+
+// Compares std::deque and std::list to see if the element types are fungible.
+template <typename A, typename B, typename AllocatorA, typename AllocatorB>
+struct IsFungible<std::deque<A, AllocatorA>, std::list<B, AllocatorB>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+template <typename A, typename B, typename AllocatorA, typename AllocatorB>
+struct IsFungible<std::list<A, AllocatorA>, std::deque<B, AllocatorB>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+
+// Compares std::deque and std::array to see if the element types are
+// fungible.
+template <typename A, typename B, typename Allocator, std::size_t Size>
+struct IsFungible<std::deque<A, Allocator>, std::array<B, Size>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+template <typename A, typename B, typename Allocator, std::size_t Size>
+struct IsFungible<std::array<A, Size>, std::deque<B, Allocator>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+
 // Compares C array and std::array to see if the element types are fungible.
 template <typename A, typename B, std::size_t Size>
 struct IsFungible<A[Size], std::array<B, Size>>
@@ -319,6 +429,61 @@ struct IsFungible<LogicalBuffer<A, SizeTypeA, IsUnboundedA, EnabledA>,
                   std::vector<B, AllocatorB>>
     : IsFungible<A, std::vector<B, AllocatorB>> {};
 
+// Compares string views and std::basic_strings to see if they are fungible.
+template <typename CharType, typename... Any>
+struct IsFungible<BasicStringView<CharType>,
+                  std::basic_string<CharType, Any...>> : std::true_type {};
+template <typename CharType, typename... Any>
+struct IsFungible<std::basic_string<CharType, Any...>,
+                  BasicStringView<CharType>> : std::true_type {};
+
+// Compares array views and std::vectors to see if they are fungible.
+template <typename A, typename B, typename AllocatorB>
+struct IsFungible<ArrayView<A>, std::vector<B, AllocatorB>>
+    : std::is_same<A, B> {};
+template <typename A, typename AllocatorA, typename B>
+struct IsFungible<std::vector<A, AllocatorA>, ArrayView<B>>
+    : std::is_same<A, B> {};
+
+// Compares vectors with inline storage and std::vectors to see if the element
+// types are fungible. The capacity of static vectors is not part of the
+// encoding.
+template <typename A, std::size_t CapacityA, typename B, typename AllocatorB>
+struct IsFungible<StaticVector<A, CapacityA>, std::vector<B, AllocatorB>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+template <typename A, typename AllocatorA, typename B, std::size_t CapacityB>
+struct IsFungible<std::vector<A, AllocatorA>, StaticVector<B, CapacityB>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+template <typename A, std::size_t CapacityA, typename B, typename AllocatorB>
+struct IsFungible<SmallVector<A, CapacityA>, std::vector<B, AllocatorB>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+template <typename A, typename AllocatorA, typename B, std::size_t CapacityB>
+struct IsFungible<std::vector<A, AllocatorA>, SmallVector<B, CapacityB>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+template <typename A, std::size_t CapacityA, typename B, std::size_t CapacityB>
+struct IsFungible<StaticVector<A, CapacityA>, StaticVector<B, CapacityB>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+template <typename A, std::size_t CapacityA, typename B, std::size_t CapacityB>
+struct IsFungible<SmallVector<A, CapacityA>, SmallVector<B, CapacityB>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+template <typename A, std::size_t CapacityA, typename B, std::size_t CapacityB>
+struct IsFungible<StaticVector<A, CapacityA>, SmallVector<B, CapacityB>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+template <typename A, std::size_t CapacityA, typename B, std::size_t CapacityB>
+struct IsFungible<SmallVector<A, CapacityA>, StaticVector<B, CapacityB>>
+    : IsFungible<std::decay_t<A>, std::decay_t<B>> {};
+
+// Compares static strings and std::basic_strings to see if they are fungible.
+template <typename CharType, std::size_t Capacity, typename... Any>
+struct IsFungible<BasicStaticString<CharType, Capacity>,
+                  std::basic_string<CharType, Any...>> : std::true_type {};
+template <typename CharType, typename... Any, std::size_t Capacity>
+struct IsFungible<std::basic_string<CharType, Any...>,
+                  BasicStaticString<CharType, Capacity>> : std::true_type {};
+template <typename CharType, std::size_t CapacityA, std::size_t CapacityB>
+struct IsFungible<BasicStaticString<CharType, CapacityA>,
+                  BasicStaticString<CharType, CapacityB>> : std::true_type {};
+
 // Compares MemberList<A...> and MemberList<B...> to see if every
 // MemberPointer::Type in A is fungible with every MemberPointer::Type in B.
 template <typename... A, typename... B>
@@ -330,12 +495,29 @@ struct IsFungible<MemberList<A...>, MemberList<B...>,
                   std::enable_if_t<sizeof...(A) != sizeof...(B)>>
     : std::false_type {};
 
-// Compares user-defined types A and B to see if every member is fungible.
+// Compares user-defined types A and B to see if every member is fungible. Raw
+// structures are only fungible with other raw structures, since they use a
+// different encoding.
 template <typename A, typename B>
 struct IsFungible<
     A, B, std::enable_if_t<HasMemberList<A>::value && HasMemberList<B>::value>>
-    : IsFungible<typename MemberListTraits<A>::MemberList,
-                 typename MemberListTraits<B>::MemberList> {};
+    : And<std::integral_constant<bool, IsRawStructure<A>::value ==
+                                           IsRawStructure<B>::value>,
+          IsFungible<typename MemberListTraits<A>::MemberList,
+                     typename MemberListTraits<B>::MemberList>> {};
+
+// Compares enum type A and integral type B and vice versa: enums encode as
+// their underlying integral type, alone and in packed containers.
+template <typename A, typename B>
+struct IsFungible<A, B,
+                  std::enable_if_t<std::is_enum<A>::value &&
+                                   std::is_integral<B>::value>>
+    : std::is_same<std::underlying_type_t<A>, B> {};
+template <typename A, typename B>
+struct IsFungible<A, B,
+                  std::enable_if_t<std::is_integral<A>::value &&
+                                   std::is_enum<B>::value>>
+    : std::is_same<A, std::underlying_type_t<B>> {};
 
 // Compares user-defined value wrapper types A and B to see if the values are
 // fungible.
@@ -0,0 +1,246 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_TRAITS_SCHEMA_FINGERPRINT_H_
+#define LIBNOP_INCLUDE_NOP_TRAITS_SCHEMA_FINGERPRINT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <nop/base/logical_buffer.h>
+#include <nop/base/members.h>
+#include <nop/base/table.h>
+#include <nop/base/utility.h>
+#include <nop/utility/sip_hash.h>
+
+namespace nop {
+
+//
+// SchemaFingerprint<T> computes a compile-time 64bit fingerprint of the
+// encoding shape of type T: the member types and order of structures, the ids
+// and types of table entries and the table hash, the sizes and signedness of
+// arithmetic types, and the element types of containers. Two types with the
+// same fingerprint encode the same way, so peers that exchange the
+// fingerprints of the types they communicate with may trust that each other's
+// encodings have the shape they expect; see SchemaHandshake.
+//
+// The fingerprint is structural: the names of structures and their members do
+// not contribute, and neither do the names of enums, which fingerprint as
+// their underlying type. Library and standard templates contribute their
+// template names as the compiler spells them, so peers built by different
+// toolchains may not match and fall back to the checked encoding.
+//
+// Types with custom encodings may specialize SchemaFingerprint to describe
+// their shape when their template name and arguments do not:
+//
+//   template <>
+//   struct SchemaFingerprint<MyType> {
+//     enum : std::uint64_t { Value = 0x0123456789abcdef };
+//   };
+//
+
+template <typename T, typename Enabled = void>
+struct SchemaFingerprint;
+
+namespace detail {
+
+enum : std::uint64_t {
+  kFingerprintKey0 = 0x5ca1ab1edeadc0de,
+  kFingerprintKey1 = 0x0123456789abcdef,
+};
+
+// Tags that distinguish the kinds of types sharing a fingerprint layout.
+enum : std::uint64_t {
+  kFingerprintArithmetic = 1,
+  kFingerprintStructure,
+  kFingerprintRawStructure,
+  kFingerprintTable,
+  kFingerprintEntry,
+  kFingerprintDeletedEntry,
+  kFingerprintArray,
+  kFingerprintLogicalBuffer,
+};
+
+// Mixes |value| into |seed| with the finalizer of SplitMix64.
+constexpr std::uint64_t MixFingerprint(std::uint64_t seed,
+                                       std::uint64_t value) {
+  std::uint64_t z = seed ^ (value + 0x9e3779b97f4a7c15 + (seed << 6) +
+                            (seed >> 2));
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+constexpr std::uint64_t CombineFingerprints(std::uint64_t seed) {
+  return seed;
+}
+template <typename... Rest>
+constexpr std::uint64_t CombineFingerprints(std::uint64_t seed,
+                                            std::uint64_t first,
+                                            Rest... rest) {
+  return CombineFingerprints(MixFingerprint(seed, first), rest...);
+}
+
+// Hashes the name of type T, or of template C, as spelled by the compiler.
+template <typename T>
+constexpr std::uint64_t TypeNameHash() {
+  return SipHash::Compute(__PRETTY_FUNCTION__, kFingerprintKey0,
+                          kFingerprintKey1);
+}
+template <template <typename...> class C>
+constexpr std::uint64_t TemplateNameHash() {
+  return SipHash::Compute(__PRETTY_FUNCTION__, kFingerprintKey0,
+                          kFingerprintKey1);
+}
+template <template <typename, std::size_t> class C>
+constexpr std::uint64_t SizedTemplateNameHash() {
+  return SipHash::Compute(__PRETTY_FUNCTION__, kFingerprintKey0,
+                          kFingerprintKey1);
+}
+
+// Fingerprints of types without member lists. Templates combine their name
+// with the fingerprints of their arguments, so that user-defined element types
+// contribute their shape rather than their name. Other types fall back to
+// their full name.
+template <typename T>
+constexpr std::uint64_t TypeFingerprint(const T*) {
+  return TypeNameHash<T>();
+}
+template <template <typename...> class C, typename... Args>
+constexpr std::uint64_t TypeFingerprint(const C<Args...>*) {
+  return CombineFingerprints(TemplateNameHash<C>(),
+                             SchemaFingerprint<Args>::Value...);
+}
+template <template <typename, std::size_t> class C, typename T,
+          std::size_t Length>
+constexpr std::uint64_t TypeFingerprint(const C<T, Length>*) {
+  return CombineFingerprints(SizedTemplateNameHash<C>(), Length,
+                             SchemaFingerprint<T>::Value);
+}
+template <typename T, std::size_t Length>
+constexpr std::uint64_t TypeFingerprint(const T (*)[Length]) {
+  return CombineFingerprints(kFingerprintArray, Length,
+                             SchemaFingerprint<T>::Value);
+}
+template <typename BufferType, typename SizeType, bool IsUnbounded>
+constexpr std::uint64_t TypeFingerprint(
+    const LogicalBuffer<BufferType, SizeType, IsUnbounded>*) {
+  return CombineFingerprints(kFingerprintLogicalBuffer, IsUnbounded,
+                             SchemaFingerprint<BufferType>::Value,
+                             SchemaFingerprint<SizeType>::Value);
+}
+
+template <typename T>
+struct StructureFingerprint;
+template <typename... MemberPointers>
+struct StructureFingerprint<MemberList<MemberPointers...>> {
+  static constexpr std::uint64_t Compute(std::uint64_t tag) {
+    return CombineFingerprints(
+        tag, sizeof...(MemberPointers),
+        SchemaFingerprint<typename MemberPointers::Type>::Value...);
+  }
+};
+
+template <typename T>
+struct EntryFingerprint;
+template <typename T, std::uint64_t Id>
+struct EntryFingerprint<Entry<T, Id, ActiveEntry>> {
+  enum : std::uint64_t {
+    Value = CombineFingerprints(kFingerprintEntry, Id,
+                                SchemaFingerprint<T>::Value)
+  };
+};
+template <typename T, std::uint64_t Id>
+struct EntryFingerprint<Entry<T, Id, DeletedEntry>> {
+  enum : std::uint64_t {
+    Value = CombineFingerprints(kFingerprintDeletedEntry, Id)
+  };
+};
+
+template <typename T>
+struct TableFingerprint;
+template <typename Hash, typename... MemberPointers>
+struct TableFingerprint<EntryList<Hash, MemberPointers...>> {
+  enum : std::uint64_t {
+    Value = CombineFingerprints(
+        kFingerprintTable, Hash::Value, sizeof...(MemberPointers),
+        EntryFingerprint<typename MemberPointers::Type>::Value...)
+  };
+};
+
+}  // namespace detail
+
+// Types without member lists.
+template <typename T, typename Enabled>
+struct SchemaFingerprint {
+  enum : std::uint64_t {
+    Value = detail::TypeFingerprint(static_cast<const T*>(nullptr))
+  };
+};
+
+// Cv-qualified types fingerprint as their unqualified type.
+template <typename T>
+struct SchemaFingerprint<const T> : SchemaFingerprint<T> {};
+
+// Integral and floating point types are described by their size and kind.
+template <typename T>
+struct SchemaFingerprint<T, std::enable_if_t<std::is_arithmetic<T>::value>> {
+  enum : std::uint64_t {
+    Value = detail::CombineFingerprints(
+        detail::kFingerprintArithmetic, sizeof(T), std::is_integral<T>::value,
+        std::is_signed<T>::value, std::is_same<T, bool>::value)
+  };
+};
+
+// Enums encode as their underlying type.
+template <typename T>
+struct SchemaFingerprint<T, std::enable_if_t<std::is_enum<T>::value>>
+    : SchemaFingerprint<std::underlying_type_t<T>> {};
+
+// Value wrappers encode as their wrapped member.
+template <typename T>
+struct SchemaFingerprint<T, EnableIfIsValueWrapper<T>>
+    : SchemaFingerprint<typename ValueWrapperTraits<T>::Pointer::Type> {};
+
+// Structures are described by their members, in order.
+template <typename T>
+struct SchemaFingerprint<T, EnableIfHasMemberList<T>> {
+  enum : std::uint64_t {
+    Value = detail::StructureFingerprint<
+        typename MemberListTraits<T>::MemberList>::
+        Compute(IsRawStructure<T>::value ? detail::kFingerprintRawStructure
+                                         : detail::kFingerprintStructure)
+  };
+};
+
+// Tables are described by their hash and their entries, in order.
+template <typename T>
+struct SchemaFingerprint<T, EnableIfHasEntryList<T>>
+    : detail::TableFingerprint<typename EntryListTraits<T>::EntryList> {};
+
+// Combines the fingerprints of several types, in order.
+template <typename... Types>
+struct CombinedSchemaFingerprint {
+  enum : std::uint64_t {
+    Value = detail::CombineFingerprints(sizeof...(Types),
+                                        SchemaFingerprint<Types>::Value...)
+  };
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_TRAITS_SCHEMA_FINGERPRINT_H_
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef LIBNOP_INCLUDE_NOP_TYPES_COLUMNAR_H_
+#define LIBNOP_INCLUDE_NOP_TYPES_COLUMNAR_H_
+
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace nop {
+
+//
+// Columnar<T> is a sequence of structures of type T, stored as a vector of
+// rows, that is encoded column by column instead of row by row: each member of
+// T is written as its own column holding that member of every row. Columns of
+// integral, floating point and raw structure members are single packed BIN
+// blocks, which read and write with a few memory copies and compress much
+// better than interleaved rows.
+//
+// The encoding is the same as a structure whose members are vectors of the
+// member types of T, in the same order, so the same data decodes either into a
+// Columnar<T> or directly into such a structure of arrays.
+//
+// Example:
+//
+//   struct Sample {
+//     std::uint64_t timestamp;
+//     double value;
+//     NOP_STRUCTURE(Sample, timestamp, value);
+//   };
+//
+//   struct SampleColumns {
+//     std::vector<std::uint64_t> timestamp;
+//     std::vector<double> value;
+//     NOP_STRUCTURE(SampleColumns, timestamp, value);
+//   };
+//
+//   nop::Columnar<Sample> samples = ...;
+//   serializer.Write(samples);
+//
+//   SampleColumns columns;
+//   deserializer.Read(&columns);  // Reads the columns written above.
+//
+
+template <typename T, typename Allocator = std::allocator<T>>
+class Columnar {
+ public:
+  using container_type = std::vector<T, Allocator>;
+  using value_type = T;
+  using size_type = std::size_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = typename container_type::iterator;
+  using const_iterator = typename container_type::const_iterator;
+
+  Columnar() = default;
+  Columnar(const Columnar&) = default;
+  Columnar(Columnar&&) = default;
+  Columnar(container_type rows) : rows_{std::move(rows)} {}
+  Columnar(std::initializer_list<T> list) : rows_{list} {}
+
+  Columnar& operator=(const Columnar&) = default;
+  Columnar& operator=(Columnar&&) = default;
+
+  iterator begin() { return rows_.begin(); }
+  iterator end() { return rows_.end(); }
+  const_iterator begin() const { return rows_.begin(); }
+  const_iterator end() const { return rows_.end(); }
+
+  bool empty() const { return rows_.empty(); }
+  size_type size() const { return rows_.size(); }
+
+  T& operator[](size_type index) { return rows_[index]; }
+  const T& operator[](size_type index) const { return rows_[index]; }
+
+  T* data() { return rows_.data(); }
+  const T* data() const { return rows_.data(); }
+
+  void reserve(size_type size) { rows_.reserve(size); }
+  void resize(size_type size) { rows_.resize(size); }
+  void clear() { rows_.clear(); }
+
+  void push_back(const T& value) { rows_.push_back(value); }
+  void push_back(T&& value) { rows_.push_back(std::move(value)); }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    rows_.emplace_back(std::forward<Args>(args)...);
+    return rows_.back();
+  }
+
+  // Returns the underlying vector of rows.
+  const container_type& rows() const { return rows_; }
+  container_type& rows() { return rows_; }
+  container_type take() { return std::move(rows_); }
+
+ private:
+  container_type rows_;
+};
+
+template <typename T, typename Allocator>
+inline bool operator==(const Columnar<T, Allocator>& a,
+                       const Columnar<T, Allocator>& b) {
+  return a.rows() == b.rows();
+}
+template <typename T, typename Allocator>
+inline bool operator!=(const Columnar<T, Allocator>& a,
+                       const Columnar<T, Allocator>& b) {
+  return !(a == b);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_TYPES_COLUMNAR_H_
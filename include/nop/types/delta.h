@@ -0,0 +1,106 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef LIBNOP_INCLUDE_NOP_TYPES_DELTA_H_
+#define LIBNOP_INCLUDE_NOP_TYPES_DELTA_H_
+
+#include <cstddef>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+
+namespace nop {
+
+//
+// Delta<Container> holds a std::set or std::vector of integral elements that
+// is encoded compactly as the differences between consecutive elements, each
+// written as a variable-length integer of one to ten bytes. Sorted sets and
+// monotonic vectors of nearby values, such as posting lists or timestamps,
+// take one or two bytes per element instead of the full width of the type.
+// Vectors that are not monotonic are still encoded correctly, with a sign bit
+// on each difference.
+//
+// Delta is a thin wrapper: the elements live in an ordinary Container, which
+// get() returns. Reading a Delta also accepts the regular encoding of
+// Container, so senders may switch to the compact encoding without updating
+// every receiver at once. The reverse does not hold: the compact encoding uses
+// the EXT prefix, which the plain container types reject.
+//
+// Example:
+//
+//   struct PostingList {
+//     std::string term;
+//     nop::Delta<std::set<std::uint64_t>> documents;
+//     NOP_STRUCTURE(PostingList, term, documents);
+//   };
+//
+//   list.documents.get().insert(document_id);
+//
+
+template <typename Container>
+class Delta {
+ public:
+  using container_type = Container;
+  using value_type = typename Container::value_type;
+  using size_type = std::size_t;
+  using const_iterator = typename Container::const_iterator;
+
+  static_assert(std::is_integral<value_type>::value &&
+                    !std::is_same<value_type, bool>::value,
+                "Delta elements must be integral types other than bool.");
+
+  Delta() = default;
+  Delta(const Delta&) = default;
+  Delta(Delta&&) = default;
+  Delta(Container container) : container_{std::move(container)} {}
+  Delta(std::initializer_list<value_type> list) : container_(list) {}
+
+  Delta& operator=(const Delta&) = default;
+  Delta& operator=(Delta&&) = default;
+
+  const_iterator begin() const { return container_.begin(); }
+  const_iterator end() const { return container_.end(); }
+
+  bool empty() const { return container_.empty(); }
+  size_type size() const { return container_.size(); }
+
+  // Returns the underlying container.
+  const Container& get() const { return container_; }
+  Container& get() { return container_; }
+  Container take() { return std::move(container_); }
+
+  const Container& operator*() const { return container_; }
+  Container& operator*() { return container_; }
+  const Container* operator->() const { return &container_; }
+  Container* operator->() { return &container_; }
+
+ private:
+  Container container_;
+};
+
+template <typename Container>
+inline bool operator==(const Delta<Container>& a, const Delta<Container>& b) {
+  return a.get() == b.get();
+}
+template <typename Container>
+inline bool operator!=(const Delta<Container>& a, const Delta<Container>& b) {
+  return !(a == b);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_TYPES_DELTA_H_
@@ -19,11 +19,13 @@
 
 #include <functional>
 #include <tuple>
+#include <type_traits>
 
 #include <nop/base/encoding.h>
 #include <nop/base/utility.h>
 #include <nop/traits/is_detected.h>
 #include <nop/types/detail/logical_buffer.h>
+#include <nop/utility/endian.h>
 
 namespace nop {
 
@@ -178,8 +180,10 @@ template <typename T>
 struct HasInternalMemberList<T, Void<typename T::NOP__MEMBERS>>
     : std::integral_constant<
           bool, IsTemplateBaseOf<MemberList, typename T::NOP__MEMBERS>::value> {
-  static_assert(std::is_default_constructible<T>::value,
-                "Serializable types must be default constructible.");
+  static_assert(std::is_default_constructible<T>::value ||
+                    IsDecodeConstructible<T>::value,
+                "Serializable types must be default constructible or have a "
+                "decode constructor.");
 };
 #else
 // Determines whether type T has a nested type named NOP__MEMBERS of
@@ -200,9 +204,12 @@ struct HasInternalMemberList {
   enum : bool { value = Test<T>(0) };
 
   // Always true if T does not have a NOP__MEMBERS member type. If T does have
-  // the member type then only true if T is also default constructible.
-  static_assert(!value || std::is_default_constructible<T>::value,
-                "Serializable types must be default constructible.");
+  // the member type then only true if T is also default constructible or has
+  // a decode constructor.
+  static_assert(!value || std::is_default_constructible<T>::value ||
+                    IsDecodeConstructible<T>::value,
+                "Serializable types must be default constructible or have a "
+                "decode constructor.");
 };
 #endif
 
@@ -216,8 +223,10 @@ struct HasExternalMemberList<T,
     : std::integral_constant<
           bool, IsTemplateBaseOf<MemberList, typename ExternalMemberTraits<
                                                  T>::MemberList>::value> {
-  static_assert(std::is_default_constructible<T>::value,
-                "Serializable types must be default constructible.");
+  static_assert(std::is_default_constructible<T>::value ||
+                    IsDecodeConstructible<T>::value,
+                "Serializable types must be default constructible or have a "
+                "decode constructor.");
 };
 
 // Determines whether a type has either an internal or external MemberList as
@@ -290,6 +299,26 @@ struct ValueWrapperTraits<T, EnableIfIsValueWrapper<T>> {
   using Pointer = typename MemberList::template At<0>;
 };
 
+// Value wrappers are packable when they are stored exactly like their wrapped
+// arithmetic or enum member: trivially copyable and of the same size, which
+// leaves no room for other members or padding.
+template <typename T>
+struct IsPackedValueWrapper<T, EnableIfIsValueWrapper<T>>
+    : std::integral_constant<
+          bool,
+          (std::is_arithmetic<typename ValueWrapperTraits<T>::Pointer::Type>::
+               value ||
+           std::is_enum<typename ValueWrapperTraits<T>::Pointer::Type>::
+               value) &&
+              std::is_trivially_copyable<T>::value &&
+              sizeof(T) ==
+                  sizeof(typename ValueWrapperTraits<T>::Pointer::Type)> {};
+
+// Packed value wrappers are byte swapped like their wrapped member.
+template <typename T>
+struct IsByteSwapped<T, std::enable_if_t<IsPackedValueWrapper<T>::value>>
+    : IsByteSwapped<typename ValueWrapperTraits<T>::Pointer::Type> {};
+
 }  // namespace nop
 
 #endif  // LIBNOP_INCLUDE_NOP_TYPES_DETAIL_MEMBER_POINTER_H_
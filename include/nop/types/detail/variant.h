@@ -17,6 +17,13 @@
 #ifndef LIBNOP_INCLUDE_NOP_TYPES_DETAIL_VARIANT_H_
 #define LIBNOP_INCLUDE_NOP_TYPES_DETAIL_VARIANT_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
 namespace nop {
 
 // Type tag denoting an empty variant.
@@ -36,6 +43,10 @@ using TypeForIndex = std::tuple_element_t<I, std::tuple<Types...>>;
 template <std::size_t I, typename... Types>
 using TypeTagForIndex = TypeTag<TypeForIndex<I, Types...>>;
 
+// Tag for accessing union elements by index rather than by type.
+template <std::size_t I>
+using IndexTag = std::integral_constant<std::size_t, I>;
+
 // Similar to std::is_constructible but evaluates to false for pointer to
 // boolean construction: avoiding this conversion helps prevent subtle bugs in
 // Variants with bool elements.
@@ -129,6 +140,10 @@ using EnableIfAssignable =
 template <bool CondA, typename SelectA, typename SelectB>
 using Select = std::conditional_t<CondA, SelectA, SelectB>;
 
+// Table-driven dispatch on the active element of a union, defined below.
+template <typename... Types>
+struct UnionDispatch;
+
 // Recursive union type.
 template <typename... Types>
 union Union {};
@@ -164,6 +179,8 @@ union Union<Type> {
 
   Type& get(TypeTag<Type>) { return first_; }
   const Type& get(TypeTag<Type>) const { return first_; }
+  Type& get(IndexTag<0>) { return first_; }
+  const Type& get(IndexTag<0>) const { return first_; }
   EmptyVariant get(TypeTag<EmptyVariant>) const { return {}; }
   constexpr std::int32_t index(TypeTag<Type>) const { return 0; }
 
@@ -291,6 +308,8 @@ union Union<First, Rest...> {
 
   First& get(TypeTag<First>) { return first_; }
   const First& get(TypeTag<First>) const { return first_; }
+  First& get(IndexTag<0>) { return first_; }
+  const First& get(IndexTag<0>) const { return first_; }
   constexpr std::int32_t index(TypeTag<First>) const { return 0; }
 
   template <typename T>
@@ -301,6 +320,14 @@ union Union<First, Rest...> {
   const T& get(TypeTag<T>) const {
     return rest_.get(TypeTag<T>{});
   }
+  template <std::size_t I>
+  TypeForIndex<I, First, Rest...>& get(IndexTag<I>) {
+    return rest_.get(IndexTag<I - 1>{});
+  }
+  template <std::size_t I>
+  const TypeForIndex<I, First, Rest...>& get(IndexTag<I>) const {
+    return rest_.get(IndexTag<I - 1>{});
+  }
   template <typename T>
   constexpr std::int32_t index(TypeTag<T>) const {
     return 1 + rest_.index(TypeTag<T>{});
@@ -330,11 +357,7 @@ union Union<First, Rest...> {
   }
 
   void Destruct(std::int32_t target_index) {
-    if (target_index == index(TypeTag<First>{})) {
-      (get(TypeTag<First>{})).~First();
-    } else {
-      rest_.Destruct(target_index - 1);
-    }
+    Dispatch::Destruct(this, target_index);
   }
 
   template <typename T>
@@ -366,38 +389,115 @@ union Union<First, Rest...> {
     return rest_.Assign(target_index - 1, std::forward<T>(value));
   }
 
-  // Recursively traverses the union and calls Op on the active value when the
-  // active type is found. If the union is empty Op is called on EmptyVariant.
+  // Calls Op on the active value through a dispatch table indexed by the
+  // active index. If the union is empty Op is called on EmptyVariant.
   template <typename Op>
   decltype(auto) Visit(std::int32_t target_index, Op&& op) {
-    if (target_index == index(TypeTag<First>{}))
-      return std::forward<Op>(op)(get(TypeTag<First>{}));
-    else
-      return rest_.Visit(target_index - 1, std::forward<Op>(op));
+    return Dispatch::Visit(this, target_index, std::forward<Op>(op));
   }
   template <typename Op>
   decltype(auto) Visit(std::int32_t target_index, Op&& op) const {
-    if (target_index == index(TypeTag<First>{}))
-      return std::forward<Op>(op)(get(TypeTag<First>{}));
-    else
-      return rest_.Visit(target_index - 1, std::forward<Op>(op));
+    return Dispatch::Visit(this, target_index, std::forward<Op>(op));
   }
 
   template <typename... Args>
   bool Become(std::int32_t target_index, Args&&... args) {
-    if (target_index == index(TypeTag<First>{})) {
-      Construct(TypeTag<First>{}, std::forward<Args>(args)...);
-      return true;
-    } else {
-      return rest_.Become(target_index - 1, std::forward<Args>(args)...);
-    }
+    return Dispatch::Become(this, target_index, std::forward<Args>(args)...);
   }
 
  private:
+  using Dispatch = UnionDispatch<First, Rest...>;
+
   First first_;
   Union<Rest...> rest_;
 };
 
+// Dispatches operations on the active element of Union<Types...> through
+// tables of function pointers indexed by the active index. This makes visiting,
+// destroying, and becoming an element constant time, instead of walking the
+// recursive union one level per element, which matters for variants with many
+// element types. Elements are accessed by index so that repeated types resolve
+// to the correct member.
+template <typename... Types>
+struct UnionDispatch {
+  using UnionType = Union<Types...>;
+  using Indices = std::index_sequence_for<Types...>;
+  enum : std::int32_t { kSize = sizeof...(Types) };
+
+  static bool IsValid(std::int32_t index) {
+    return index >= 0 && index < kSize;
+  }
+
+  template <typename U, typename Op>
+  using VisitResult = decltype(
+      std::declval<Op>()(std::declval<U&>().get(IndexTag<0>{})));
+
+  template <typename U, typename Op>
+  static VisitResult<U, Op> Visit(U* value, std::int32_t index, Op&& op) {
+    return VisitTable(value, index, std::forward<Op>(op), Indices{});
+  }
+
+  static void Destruct(UnionType* value, std::int32_t index) {
+    DestructTable(value, index, Indices{});
+  }
+
+  template <typename... Args>
+  static bool Become(UnionType* value, std::int32_t index, Args&&... args) {
+    return BecomeTable(value, index, Indices{}, std::forward<Args>(args)...);
+  }
+
+ private:
+  template <std::size_t I, typename U, typename Op>
+  static VisitResult<U, Op> VisitElement(U* value, Op&& op) {
+    return std::forward<Op>(op)(value->get(IndexTag<I>{}));
+  }
+
+  template <typename U, typename Op, std::size_t... Is>
+  static VisitResult<U, Op> VisitTable(U* value, std::int32_t index, Op&& op,
+                                       std::index_sequence<Is...>) {
+    using Function = VisitResult<U, Op> (*)(U*, Op&&);
+    static constexpr Function kTable[] = {&VisitElement<Is, U, Op>...};
+    if (IsValid(index))
+      return kTable[index](value, std::forward<Op>(op));
+    else
+      return std::forward<Op>(op)(EmptyVariant{});
+  }
+
+  template <std::size_t I>
+  static void DestructElement(UnionType* value) {
+    using Type = TypeForIndex<I, Types...>;
+    value->get(IndexTag<I>{}).~Type();
+  }
+
+  template <std::size_t... Is>
+  static void DestructTable(UnionType* value, std::int32_t index,
+                            std::index_sequence<Is...>) {
+    using Function = void (*)(UnionType*);
+    static constexpr Function kTable[] = {&DestructElement<Is>...};
+    if (IsValid(index))
+      kTable[index](value);
+  }
+
+  template <std::size_t I, typename... Args>
+  static void BecomeElement(UnionType* value, Args&&... args) {
+    using Type = TypeForIndex<I, Types...>;
+    new (&value->get(IndexTag<I>{})) Type(std::forward<Args>(args)...);
+  }
+
+  template <std::size_t... Is, typename... Args>
+  static bool BecomeTable(UnionType* value, std::int32_t index,
+                          std::index_sequence<Is...>, Args&&... args) {
+    using Function = void (*)(UnionType*, Args&&...);
+    static constexpr Function kTable[] = {&BecomeElement<Is, Args...>...};
+    if (IsValid(index)) {
+      kTable[index](value, std::forward<Args>(args)...);
+      return true;
+    } else {
+      return false;
+    }
+  }
+};
+
 }  // namespace detail
 }  // namespace nop
 
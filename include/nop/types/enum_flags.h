@@ -52,23 +52,8 @@ namespace nop {
 // in the same namespace as the enum class is originally defined in.
 //
 
-// Evaluates to the traits type defined by NOP_ENUM_FLAGS() for the given type
-// T. This type alias uses ADL to find the traits type for type T in the
-// namespace type T is defined in.
-template <typename T>
-using EnumFlagsTraits = decltype(NOP__GetEnumFlagsTraits(std::declval<T*>()));
-
-// Evaluates to std::true_type if the given type T has been tagged as an enum
-// flags type by NOP_ENUM_FLAGS() or std::false_type otherwise.
-template <typename, typename = void>
-struct IsEnumFlags : std::false_type {};
-template <typename T>
-struct IsEnumFlags<T, Void<typename EnumFlagsTraits<T>::Type>>
-    : std::true_type {};
-
-// Enable if type T is tagged as an enum flags type.
-template <typename T>
-using EnableIfEnumFlags = typename std::enable_if<IsEnumFlags<T>::value>::type;
+// EnumFlagsTraits, IsEnumFlags, and EnableIfEnumFlags are defined in
+// nop/base/utility.h, since containers of enum flags types are packed.
 
 // Macro to tag a given enum class type as an enum flags type. This is
 // accomplished by defining a partial specialization of the type
@@ -0,0 +1,332 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_TYPES_FLAT_MAP_H_
+#define LIBNOP_INCLUDE_NOP_TYPES_FLAT_MAP_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace nop {
+
+//
+// Sorted associative containers backed by a single vector. FlatMap<Key, T> and
+// FlatSet<Key> keep their elements sorted by key in contiguous storage, which
+// makes lookup a binary search and iteration a linear scan, without allocating
+// a node per element.
+//
+// FlatMap encodes the same as std::map and FlatSet the same as std::set, and
+// each is fungible with the ordered and unordered standard containers. Since
+// ordered containers are written in key order, decoding appends the elements
+// and only checks the order, falling back to sorting when the input is not
+// sorted. Duplicate keys keep the first occurrence, like std::map.
+//
+// Example:
+//
+//   struct Routes {
+//     nop::FlatMap<std::uint32_t, std::string> next_hop;
+//     NOP_STRUCTURE(Routes, next_hop);
+//   };
+//
+
+// Map of unique keys of type Key to values of type T, sorted by Compare.
+template <typename Key, typename T, typename Compare = std::less<Key>>
+class FlatMap {
+ public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<Key, T>;
+  using key_compare = Compare;
+  using container_type = std::vector<value_type>;
+  using size_type = std::size_t;
+  using iterator = typename container_type::iterator;
+  using const_iterator = typename container_type::const_iterator;
+
+  // Compares elements by key.
+  class value_compare {
+   public:
+    bool operator()(const value_type& a, const value_type& b) const {
+      return compare_(a.first, b.first);
+    }
+
+   private:
+    friend class FlatMap;
+    explicit value_compare(const Compare& compare) : compare_{compare} {}
+    Compare compare_;
+  };
+
+  FlatMap() = default;
+  explicit FlatMap(const Compare& compare) : compare_{compare} {}
+  FlatMap(std::initializer_list<value_type> list,
+          const Compare& compare = Compare{})
+      : container_{list}, compare_{compare} {
+    SortUnique();
+  }
+
+  // Constructs a map from the elements of |container| in any order. Duplicate
+  // keys keep the first occurrence.
+  explicit FlatMap(container_type container,
+                   const Compare& compare = Compare{})
+      : container_{std::move(container)}, compare_{compare} {
+    SortUnique();
+  }
+
+  std::size_t size() const { return container_.size(); }
+  bool empty() const { return container_.empty(); }
+  std::size_t capacity() const { return container_.capacity(); }
+  void reserve(std::size_t size) { container_.reserve(size); }
+
+  // Removes the elements, keeping the storage.
+  void clear() { container_.clear(); }
+
+  iterator begin() { return container_.begin(); }
+  iterator end() { return container_.end(); }
+  const_iterator begin() const { return container_.begin(); }
+  const_iterator end() const { return container_.end(); }
+  const_iterator cbegin() const { return container_.cbegin(); }
+  const_iterator cend() const { return container_.cend(); }
+
+  key_compare key_comp() const { return compare_; }
+  value_compare value_comp() const { return value_compare{compare_}; }
+
+  iterator lower_bound(const Key& key) {
+    return std::lower_bound(begin(), end(), key, KeyCompare{compare_});
+  }
+  const_iterator lower_bound(const Key& key) const {
+    return std::lower_bound(begin(), end(), key, KeyCompare{compare_});
+  }
+
+  iterator find(const Key& key) {
+    auto it = lower_bound(key);
+    return it != end() && !compare_(key, it->first) ? it : end();
+  }
+  const_iterator find(const Key& key) const {
+    auto it = lower_bound(key);
+    return it != end() && !compare_(key, it->first) ? it : end();
+  }
+
+  std::size_t count(const Key& key) const { return find(key) != end(); }
+
+  // Inserts an element with |key| constructed from |args| if the key is not
+  // already present. Inserting in key order appends without moving elements.
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args) {
+    auto it = lower_bound(key);
+    if (it != end() && !compare_(key, it->first))
+      return {it, false};
+
+    it = container_.emplace(it, std::piecewise_construct,
+                            std::forward_as_tuple(key),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+    return {it, true};
+  }
+
+  std::pair<iterator, bool> insert(const value_type& value) {
+    return try_emplace(value.first, value.second);
+  }
+  std::pair<iterator, bool> insert(value_type&& value) {
+    return try_emplace(value.first, std::move(value.second));
+  }
+
+  T& operator[](const Key& key) { return try_emplace(key).first->second; }
+
+  iterator erase(const_iterator position) {
+    return container_.erase(position);
+  }
+  std::size_t erase(const Key& key) {
+    auto it = find(key);
+    if (it == end())
+      return 0;
+
+    container_.erase(it);
+    return 1;
+  }
+
+  // Moves the underlying container out of the map, leaving the map empty.
+  container_type extract() {
+    container_type container{std::move(container_)};
+    container_.clear();
+    return container;
+  }
+
+  // Replaces the underlying container. The elements of |container| must be
+  // sorted by key and have unique keys.
+  void replace(container_type&& container) {
+    container_ = std::move(container);
+  }
+
+  const container_type& container() const { return container_; }
+
+ private:
+  struct KeyCompare {
+    bool operator()(const value_type& a, const Key& b) const {
+      return compare(a.first, b);
+    }
+    const Compare& compare;
+  };
+
+  void SortUnique() {
+    const value_compare less{compare_};
+    std::stable_sort(container_.begin(), container_.end(), less);
+    container_.erase(std::unique(container_.begin(), container_.end(),
+                                 [&less](const value_type& a,
+                                         const value_type& b) {
+                                   return !less(a, b) && !less(b, a);
+                                 }),
+                     container_.end());
+  }
+
+  container_type container_;
+  Compare compare_;
+};
+
+// Set of unique keys of type Key, sorted by Compare.
+template <typename Key, typename Compare = std::less<Key>>
+class FlatSet {
+ public:
+  using key_type = Key;
+  using value_type = Key;
+  using key_compare = Compare;
+  using value_compare = Compare;
+  using container_type = std::vector<Key>;
+  using size_type = std::size_t;
+  using iterator = typename container_type::const_iterator;
+  using const_iterator = typename container_type::const_iterator;
+
+  FlatSet() = default;
+  explicit FlatSet(const Compare& compare) : compare_{compare} {}
+  FlatSet(std::initializer_list<Key> list, const Compare& compare = Compare{})
+      : container_{list}, compare_{compare} {
+    SortUnique();
+  }
+
+  // Constructs a set from the keys of |container| in any order.
+  explicit FlatSet(container_type container,
+                   const Compare& compare = Compare{})
+      : container_{std::move(container)}, compare_{compare} {
+    SortUnique();
+  }
+
+  std::size_t size() const { return container_.size(); }
+  bool empty() const { return container_.empty(); }
+  std::size_t capacity() const { return container_.capacity(); }
+  void reserve(std::size_t size) { container_.reserve(size); }
+
+  // Removes the keys, keeping the storage.
+  void clear() { container_.clear(); }
+
+  const_iterator begin() const { return container_.begin(); }
+  const_iterator end() const { return container_.end(); }
+  const_iterator cbegin() const { return container_.cbegin(); }
+  const_iterator cend() const { return container_.cend(); }
+
+  key_compare key_comp() const { return compare_; }
+  value_compare value_comp() const { return compare_; }
+
+  const_iterator lower_bound(const Key& key) const {
+    return std::lower_bound(begin(), end(), key, compare_);
+  }
+
+  const_iterator find(const Key& key) const {
+    auto it = lower_bound(key);
+    return it != end() && !compare_(key, *it) ? it : end();
+  }
+
+  std::size_t count(const Key& key) const { return find(key) != end(); }
+
+  // Inserts |key| if it is not already present. Inserting in key order appends
+  // without moving elements.
+  template <typename K>
+  std::pair<const_iterator, bool> insert(K&& key) {
+    auto it = lower_bound(key);
+    if (it != end() && !compare_(key, *it))
+      return {it, false};
+
+    return {container_.insert(it, std::forward<K>(key)), true};
+  }
+
+  const_iterator erase(const_iterator position) {
+    return container_.erase(position);
+  }
+  std::size_t erase(const Key& key) {
+    auto it = find(key);
+    if (it == end())
+      return 0;
+
+    container_.erase(it);
+    return 1;
+  }
+
+  // Moves the underlying container out of the set, leaving the set empty.
+  container_type extract() {
+    container_type container{std::move(container_)};
+    container_.clear();
+    return container;
+  }
+
+  // Replaces the underlying container. The keys of |container| must be sorted
+  // and unique.
+  void replace(container_type&& container) {
+    container_ = std::move(container);
+  }
+
+  const container_type& container() const { return container_; }
+
+ private:
+  void SortUnique() {
+    std::stable_sort(container_.begin(), container_.end(), compare_);
+    container_.erase(
+        std::unique(container_.begin(), container_.end(),
+                    [this](const Key& a, const Key& b) {
+                      return !compare_(a, b) && !compare_(b, a);
+                    }),
+        container_.end());
+  }
+
+  container_type container_;
+  Compare compare_;
+};
+
+template <typename Key, typename T, typename Compare>
+inline bool operator==(const FlatMap<Key, T, Compare>& a,
+                       const FlatMap<Key, T, Compare>& b) {
+  return a.container() == b.container();
+}
+template <typename Key, typename T, typename Compare>
+inline bool operator!=(const FlatMap<Key, T, Compare>& a,
+                       const FlatMap<Key, T, Compare>& b) {
+  return !(a == b);
+}
+
+template <typename Key, typename Compare>
+inline bool operator==(const FlatSet<Key, Compare>& a,
+                       const FlatSet<Key, Compare>& b) {
+  return a.container() == b.container();
+}
+template <typename Key, typename Compare>
+inline bool operator!=(const FlatSet<Key, Compare>& a,
+                       const FlatSet<Key, Compare>& b) {
+  return !(a == b);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_TYPES_FLAT_MAP_H_
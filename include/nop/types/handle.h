@@ -38,6 +38,11 @@ namespace nop {
 using HandleReference = std::int64_t;
 enum : HandleReference { kEmptyHandleReference = -1 };
 
+// First handle reference of the range used by readers and writers that cache
+// handles across messages. References at or above this value refer to a
+// cached handle instead of a handle transferred with the current message.
+enum : HandleReference { kCachedHandleReference = HandleReference{1} << 62 };
+
 // Default handle policy. Primarily useful as an example of the required form of
 // a handle policy.
 template <typename T, T Empty = T{}>
@@ -0,0 +1,304 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_TYPES_HASH_MAP_H_
+#define LIBNOP_INCLUDE_NOP_TYPES_HASH_MAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <nop/types/optional.h>
+
+namespace nop {
+
+//
+// Hash map using open addressing with linear probing. Elements are stored in a
+// single array of slots instead of individually allocated nodes, and erasing
+// shifts the following elements back instead of leaving tombstones. The number
+// of slots is a power of two and grows to keep the load factor at or below
+// 3/4.
+//
+// HashMap encodes the same as std::unordered_map and is fungible with it and
+// with std::map. Decoding reserves slots for the encoded number of elements up
+// front, when the reader can tell how much input remains, so that the map does
+// not rehash while it is filled. Clearing the map keeps its slots, so that a
+// long-lived map does not allocate in steady state.
+//
+// Keys must not be modified through iterators.
+//
+template <typename Key, typename T, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class HashMap {
+  using Slot = Optional<std::pair<Key, T>>;
+
+  template <typename SlotType, typename ValueType>
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::remove_const_t<ValueType>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = ValueType*;
+    using reference = ValueType&;
+
+    Iterator() = default;
+    Iterator(SlotType* slot, SlotType* end) : slot_{slot}, end_{end} {
+      SkipEmpty();
+    }
+
+    // Allows conversion from iterator to const_iterator.
+    template <typename OtherSlot, typename OtherValue,
+              typename Enabled = std::enable_if_t<
+                  std::is_convertible<OtherSlot*, SlotType*>::value>>
+    Iterator(const Iterator<OtherSlot, OtherValue>& other)
+        : slot_{other.slot_}, end_{other.end_} {}
+
+    reference operator*() const { return slot_->get(); }
+    pointer operator->() const { return &slot_->get(); }
+
+    Iterator& operator++() {
+      ++slot_;
+      SkipEmpty();
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator copy{*this};
+      ++*this;
+      return copy;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return slot_ == other.slot_;
+    }
+    bool operator!=(const Iterator& other) const {
+      return slot_ != other.slot_;
+    }
+
+   private:
+    template <typename, typename>
+    friend class Iterator;
+
+    void SkipEmpty() {
+      while (slot_ != end_ && slot_->empty())
+        ++slot_;
+    }
+
+    SlotType* slot_{nullptr};
+    SlotType* end_{nullptr};
+  };
+
+ public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<Key, T>;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+  using size_type = std::size_t;
+  using iterator = Iterator<Slot, value_type>;
+  using const_iterator = Iterator<const Slot, const value_type>;
+
+  enum : std::size_t { kMinSlotCount = 8 };
+
+  HashMap() = default;
+  HashMap(std::initializer_list<value_type> list) {
+    reserve(list.size());
+    for (const value_type& element : list)
+      insert(element);
+  }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  std::size_t bucket_count() const { return slots_.size(); }
+
+  iterator begin() { return {slots_.data(), slots_.data() + slots_.size()}; }
+  iterator end() {
+    return {slots_.data() + slots_.size(), slots_.data() + slots_.size()};
+  }
+  const_iterator begin() const {
+    return {slots_.data(), slots_.data() + slots_.size()};
+  }
+  const_iterator end() const {
+    return {slots_.data() + slots_.size(), slots_.data() + slots_.size()};
+  }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  // Makes room for at least |size| elements without rehashing.
+  void reserve(std::size_t size) {
+    std::size_t count = kMinSlotCount;
+    while (count - count / 4 < size)
+      count *= 2;
+    if (count > slots_.size())
+      Rehash(count);
+  }
+
+  // Removes the elements, keeping the slots.
+  void clear() {
+    for (Slot& slot : slots_)
+      slot.clear();
+    size_ = 0;
+  }
+
+  iterator find(const Key& key) {
+    const std::size_t index = Find(key);
+    return index == kNotFound ? end() : MakeIterator(index);
+  }
+  const_iterator find(const Key& key) const {
+    const std::size_t index = Find(key);
+    return index == kNotFound
+               ? end()
+               : const_iterator{slots_.data() + index,
+                                slots_.data() + slots_.size()};
+  }
+
+  std::size_t count(const Key& key) const { return Find(key) != kNotFound; }
+
+  // Inserts an element with |key| constructed from |args| if the key is not
+  // already present.
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args) {
+    reserve(size_ + 1);
+
+    std::size_t index = SlotIndex(key);
+    while (!slots_[index].empty()) {
+      if (equal_(slots_[index].get().first, key))
+        return {MakeIterator(index), false};
+      index = (index + 1) & (slots_.size() - 1);
+    }
+
+    slots_[index] = Slot{InPlace{}, std::piecewise_construct,
+                         std::forward_as_tuple(key),
+                         std::forward_as_tuple(std::forward<Args>(args)...)};
+    size_++;
+    return {MakeIterator(index), true};
+  }
+
+  std::pair<iterator, bool> insert(const value_type& value) {
+    return try_emplace(value.first, value.second);
+  }
+  std::pair<iterator, bool> insert(value_type&& value) {
+    return try_emplace(value.first, std::move(value.second));
+  }
+
+  T& operator[](const Key& key) { return try_emplace(key).first->second; }
+
+  // Erases the element with |key|, shifting back the elements that follow it
+  // in the probe sequence. Iterators are invalidated.
+  std::size_t erase(const Key& key) {
+    std::size_t index = Find(key);
+    if (index == kNotFound)
+      return 0;
+
+    const std::size_t mask = slots_.size() - 1;
+    slots_[index].clear();
+    size_--;
+
+    for (std::size_t next = (index + 1) & mask; !slots_[next].empty();
+         next = (next + 1) & mask) {
+      // Move the element back unless its home slot lies in (index, next].
+      const std::size_t home = SlotIndex(slots_[next].get().first);
+      if (((next - home) & mask) >= ((next - index) & mask)) {
+        slots_[index] = std::move(slots_[next]);
+        slots_[next].clear();
+        index = next;
+      }
+    }
+
+    return 1;
+  }
+
+ private:
+  enum : std::size_t { kNotFound = ~std::size_t{0} };
+
+  iterator MakeIterator(std::size_t index) {
+    return {slots_.data() + index, slots_.data() + slots_.size()};
+  }
+
+  // Returns the home slot of |key|. The hash is multiplied by 2^64 / phi and
+  // the slot taken from the high bits, so that hashes that differ only in
+  // their high bits, such as the identity hashes of integers, spread across
+  // the slots.
+  std::size_t SlotIndex(const Key& key) const {
+    const std::uint64_t hash = hash_(key);
+    return static_cast<std::size_t>((hash * 0x9e3779b97f4a7c15ull) >> shift_);
+  }
+
+  std::size_t Find(const Key& key) const {
+    if (slots_.empty())
+      return kNotFound;
+
+    for (std::size_t index = SlotIndex(key); !slots_[index].empty();
+         index = (index + 1) & (slots_.size() - 1)) {
+      if (equal_(slots_[index].get().first, key))
+        return index;
+    }
+
+    return kNotFound;
+  }
+
+  // Moves the elements into |count| new slots.
+  void Rehash(std::size_t count) {
+    std::vector<Slot> slots(count);
+    std::swap(slots, slots_);
+    for (shift_ = 64; count > 1; count /= 2)
+      shift_--;
+
+    for (Slot& slot : slots) {
+      if (!slot.empty()) {
+        std::size_t index = SlotIndex(slot.get().first);
+        while (!slots_[index].empty())
+          index = (index + 1) & (slots_.size() - 1);
+        slots_[index] = std::move(slot);
+      }
+    }
+  }
+
+  std::vector<Slot> slots_;
+  std::size_t size_{0};
+  unsigned shift_{64};
+  Hash hash_;
+  KeyEqual equal_;
+};
+
+template <typename Key, typename T, typename Hash, typename KeyEqual>
+inline bool operator==(const HashMap<Key, T, Hash, KeyEqual>& a,
+                       const HashMap<Key, T, Hash, KeyEqual>& b) {
+  if (a.size() != b.size())
+    return false;
+
+  for (const auto& element : a) {
+    auto it = b.find(element.first);
+    if (it == b.end() || !(it->second == element.second))
+      return false;
+  }
+
+  return true;
+}
+template <typename Key, typename T, typename Hash, typename KeyEqual>
+inline bool operator!=(const HashMap<Key, T, Hash, KeyEqual>& a,
+                       const HashMap<Key, T, Hash, KeyEqual>& b) {
+  return !(a == b);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_TYPES_HASH_MAP_H_
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_TYPES_PRE_ENCODED_H_
+#define LIBNOP_INCLUDE_NOP_TYPES_PRE_ENCODED_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <nop/base/encoding_byte.h>
+
+namespace nop {
+
+//
+// Types that hold the encoded bytes of a value, so that writing the value is a
+// single bulk write instead of a walk over its members. These suit large
+// values that are written many times but rarely change, such as static
+// catalogs or schemas included in every response.
+//
+// PreEncoded is an opaque buffer holding exactly one encoded value, which is
+// written verbatim in place of the PreEncoded. Reading a PreEncoded captures
+// the encoding of the next value of any type without decoding it, so that it
+// may be forwarded as is.
+//
+// Cached<T> holds a value of type T and the encoding of that value, which is
+// computed the first time the value is written and reused by every following
+// write until the value is modified. Cached<T> reads and writes the same as T.
+//
+// Encoded bytes are produced by a plain writer and written to the output
+// unchanged: T may not contain handles, and the output of writers that rewrite
+// values, such as InterningWriter, is not applied to the bytes.
+//
+// Example:
+//
+//   struct Response {
+//     std::uint64_t id;
+//     nop::Cached<Catalog> catalog;
+//     NOP_STRUCTURE(Response, id, catalog);
+//   };
+//
+//   response.catalog = LoadCatalog();
+//   serializer.Write(response);  // Encodes the catalog.
+//   serializer.Write(response);  // Copies the encoded catalog.
+//
+
+// Opaque buffer holding exactly one encoded value. A default constructed
+// PreEncoded holds the encoding of nil.
+class PreEncoded {
+ public:
+  using BufferType = std::vector<std::uint8_t>;
+
+  PreEncoded() : data_{static_cast<std::uint8_t>(EncodingByte::Nil)} {}
+  PreEncoded(const PreEncoded&) = default;
+  PreEncoded(PreEncoded&&) = default;
+
+  // Takes ownership of |data|, which must hold exactly one encoded value.
+  // Use EncodedLength() to check untrusted data beforehand.
+  explicit PreEncoded(BufferType data) : data_{std::move(data)} {}
+
+  PreEncoded& operator=(const PreEncoded&) = default;
+  PreEncoded& operator=(PreEncoded&&) = default;
+
+  const std::uint8_t* data() const { return data_.data(); }
+  std::size_t size() const { return data_.size(); }
+
+  const BufferType& buffer() const { return data_; }
+  BufferType take() { return std::move(data_); }
+
+ private:
+  BufferType data_;
+};
+
+inline bool operator==(const PreEncoded& a, const PreEncoded& b) {
+  return a.buffer() == b.buffer();
+}
+inline bool operator!=(const PreEncoded& a, const PreEncoded& b) {
+  return !(a == b);
+}
+
+// Value of type T with a cache of its encoding. Accessing the value through a
+// non-const method discards the cache, so modifications must be made through
+// the references those methods return before the value is written again.
+//
+// The cache is filled by the first write of the value, which modifies the
+// cache of a const value. Call FillCache() before writing the same value from
+// more than one thread at a time.
+template <typename T>
+class Cached {
+ public:
+  using value_type = T;
+
+  Cached() = default;
+  Cached(const Cached&) = default;
+  Cached(Cached&&) = default;
+  Cached(T value) : value_{std::move(value)} {}
+
+  Cached& operator=(const Cached&) = default;
+  Cached& operator=(Cached&&) = default;
+  Cached& operator=(T value) {
+    value_ = std::move(value);
+    encoded_.clear();
+    return *this;
+  }
+
+  const T& get() const { return value_; }
+  T& get() {
+    encoded_.clear();
+    return value_;
+  }
+
+  const T& operator*() const { return get(); }
+  T& operator*() { return get(); }
+  const T* operator->() const { return &get(); }
+  T* operator->() { return &get(); }
+
+  // Returns true if the encoding of the value is cached.
+  bool cached() const { return !encoded_.empty(); }
+
+  // Returns the cached encoding of the value, which is empty if the value has
+  // not been written since it was last modified.
+  const std::vector<std::uint8_t>& encoded() const { return encoded_; }
+
+ private:
+  template <typename, typename>
+  friend struct Encoding;
+
+  T value_{};
+  mutable std::vector<std::uint8_t> encoded_;
+};
+
+template <typename T>
+inline bool operator==(const Cached<T>& a, const Cached<T>& b) {
+  return a.get() == b.get();
+}
+template <typename T>
+inline bool operator!=(const Cached<T>& a, const Cached<T>& b) {
+  return !(a == b);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_TYPES_PRE_ENCODED_H_
@@ -0,0 +1,294 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_TYPES_SHARED_BLOB_H_
+#define LIBNOP_INCLUDE_NOP_TYPES_SHARED_BLOB_H_
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <nop/status.h>
+#include <nop/types/file_handle.h>
+
+namespace nop {
+
+//
+// Types for passing large binary payloads between processes by handle instead
+// of by value. A SharedBlob holds its bytes either inline or in a region of a
+// memfd-backed shared memory segment. Inline blobs are encoded as binary data;
+// shared blobs are encoded as a handle to the segment plus the offset and
+// length of the region, so that a 100 MB payload takes a few bytes on the
+// wire. The receiver maps the region read-only and views it in place.
+//
+// Shared blobs must be written with a writer that supports handles, such as
+// SocketWriter, and read with the matching reader. Writing a shared blob to
+// any other writer fails with ErrorStatus::UnexpectedHandleType; inline blobs
+// work with every writer.
+//
+// SharedBlobPool allocates blobs from segments of a fixed size, storing any
+// payload under the pool threshold inline. Segments are never reused: each is
+// unmapped and closed when the pool and every blob allocated from it are
+// gone, while receivers keep their own mappings.
+//
+// The receiver's view is shared with the sender, which may still modify it.
+// Receivers that validate the contents of a blob should copy it first.
+//
+// Example:
+//
+//   nop::SharedBlobPool pool;
+//   auto blob = pool.Create(image.data(), image.size());
+//   serializer.Write(Frame{id, blob.take()});
+//   serializer.writer().Flush();
+//
+// The encoding of SharedBlob is described in nop/base/shared_blob.h.
+//
+
+namespace detail {
+
+// Mapping of a shared memory segment, unmapped when the last blob that refers
+// to it is destroyed.
+class SharedMapping {
+ public:
+  SharedMapping(UniqueFileHandle handle, void* address, std::size_t size)
+      : handle_{std::move(handle)}, address_{address}, size_{size} {}
+  SharedMapping(const SharedMapping&) = delete;
+  ~SharedMapping() { ::munmap(address_, size_); }
+
+  SharedMapping& operator=(const SharedMapping&) = delete;
+
+  const UniqueFileHandle& handle() const { return handle_; }
+  std::uint8_t* address() const { return static_cast<std::uint8_t*>(address_); }
+  std::size_t size() const { return size_; }
+
+ private:
+  UniqueFileHandle handle_;
+  void* address_;
+  std::size_t size_;
+};
+
+}  // namespace detail
+
+// Binary payload stored inline or in shared memory.
+class SharedBlob {
+ public:
+  SharedBlob() = default;
+  SharedBlob(const SharedBlob&) = default;
+  SharedBlob(SharedBlob&&) = default;
+
+  // Constructs an inline blob holding |data|.
+  explicit SharedBlob(std::vector<std::uint8_t> data)
+      : inline_{std::move(data)} {}
+
+  SharedBlob& operator=(const SharedBlob&) = default;
+  SharedBlob& operator=(SharedBlob&&) = default;
+
+  // Maps |size| bytes at |offset| of the shared memory segment |handle|
+  // read-only and takes ownership of the handle, which is closed once the
+  // region is mapped.
+  static Status<SharedBlob> Map(UniqueFileHandle handle, std::uint64_t offset,
+                                std::uint64_t size) {
+    if (!handle)
+      return ErrorStatus::InvalidHandleValue;
+
+    struct stat file_stat;
+    if (::fstat(handle.get(), &file_stat) < 0)
+      return ErrorStatus::IOError;
+
+    const std::uint64_t file_size = static_cast<std::uint64_t>(
+        std::max<off_t>(file_stat.st_size, 0));
+    if (offset > file_size || size > file_size - offset)
+      return ErrorStatus::InvalidContainerLength;
+
+    SharedBlob blob;
+    if (size == 0)
+      return {std::move(blob)};
+
+    const std::uint64_t page_size = ::getpagesize();
+    const std::uint64_t map_offset = offset / page_size * page_size;
+    const std::size_t map_size = offset - map_offset + size;
+    void* address = ::mmap(nullptr, map_size, PROT_READ, MAP_SHARED,
+                           handle.get(), static_cast<off_t>(map_offset));
+    if (address == MAP_FAILED)
+      return ErrorStatus::IOError;
+
+    blob.mapping_ = std::make_shared<detail::SharedMapping>(
+        UniqueFileHandle{}, address, map_size);
+    blob.data_ = blob.mapping_->address() + (offset - map_offset);
+    blob.size_ = size;
+    return {std::move(blob)};
+  }
+
+  const std::uint8_t* data() const {
+    return shared() ? data_ : inline_.data();
+  }
+  std::size_t size() const { return shared() ? size_ : inline_.size(); }
+  bool empty() const { return size() == 0; }
+
+  const std::uint8_t* begin() const { return data(); }
+  const std::uint8_t* end() const { return data() + size(); }
+
+  // Returns the writable bytes of a blob allocated locally, or nullptr for a
+  // blob mapped from another process.
+  std::uint8_t* mutable_data() {
+    if (!shared())
+      return inline_.data();
+    else if (mapping_->handle())
+      return data_;
+    else
+      return nullptr;
+  }
+
+  // Returns true if the bytes are in shared memory.
+  bool shared() const { return static_cast<bool>(mapping_); }
+
+  // Returns the handle of the segment of a local shared blob, which is empty
+  // for inline blobs and blobs mapped from another process.
+  FileHandle handle() const {
+    return shared() ? FileHandle{mapping_->handle().get()} : FileHandle{};
+  }
+
+  // Returns the offset of the bytes in the segment of a local shared blob.
+  std::uint64_t offset() const {
+    return handle() ? data_ - mapping_->address() : 0;
+  }
+
+ private:
+  friend class SharedBlobPool;
+
+  SharedBlob(std::shared_ptr<const detail::SharedMapping> mapping,
+             std::size_t offset, std::size_t size)
+      : mapping_{std::move(mapping)},
+        data_{mapping_->address() + offset},
+        size_{size} {}
+
+  std::vector<std::uint8_t> inline_;
+  std::shared_ptr<const detail::SharedMapping> mapping_;
+  std::uint8_t* data_{nullptr};
+  std::size_t size_{0};
+};
+
+inline bool operator==(const SharedBlob& a, const SharedBlob& b) {
+  return a.size() == b.size() &&
+         (a.size() == 0 || std::memcmp(a.data(), b.data(), a.size()) == 0);
+}
+inline bool operator!=(const SharedBlob& a, const SharedBlob& b) {
+  return !(a == b);
+}
+
+// Allocates SharedBlobs from memfd-backed segments. Payloads smaller than the
+// threshold are stored inline, and payloads larger than the segment size get
+// a segment of their own. The pool is not thread safe.
+class SharedBlobPool {
+ public:
+  enum : std::size_t {
+    kDefaultSegmentSize = 16 * 1024 * 1024,
+    kDefaultThreshold = 64 * 1024,
+    kAlignment = 64,
+  };
+
+  SharedBlobPool(std::size_t segment_size = kDefaultSegmentSize,
+                 std::size_t threshold = kDefaultThreshold)
+      : segment_size_{segment_size}, threshold_{threshold} {}
+  SharedBlobPool(const SharedBlobPool&) = delete;
+  SharedBlobPool(SharedBlobPool&&) = default;
+
+  SharedBlobPool& operator=(const SharedBlobPool&) = delete;
+  SharedBlobPool& operator=(SharedBlobPool&&) = default;
+
+  // Allocates a blob of |size| bytes, to be filled through mutable_data().
+  Status<SharedBlob> Allocate(std::size_t size) {
+    if (size < threshold_)
+      return {SharedBlob{std::vector<std::uint8_t>(size)}};
+
+    const std::size_t aligned = (size + kAlignment - 1) / kAlignment *
+                                kAlignment;
+    if (aligned > segment_size_) {
+      auto status = MapSegment(size);
+      if (!status)
+        return status.error();
+      return {SharedBlob{status.take(), 0, size}};
+    }
+
+    if (!segment_ || segment_size_ - used_ < aligned) {
+      auto status = MapSegment(segment_size_);
+      if (!status)
+        return status.error();
+      segment_ = status.take();
+      used_ = 0;
+    }
+
+    const std::size_t offset = used_;
+    used_ += aligned;
+    return {SharedBlob{segment_, offset, size}};
+  }
+
+  // Allocates a blob and copies |size| bytes from |data| into it.
+  Status<SharedBlob> Create(const void* data, std::size_t size) {
+    auto status = Allocate(size);
+    if (!status)
+      return status;
+
+    if (size > 0)
+      std::memcpy(status.get().mutable_data(), data, size);
+    return status;
+  }
+
+  std::size_t segment_size() const { return segment_size_; }
+  std::size_t threshold() const { return threshold_; }
+
+ private:
+  // Creates and maps a shared memory segment of |size| bytes.
+  static Status<std::shared_ptr<const detail::SharedMapping>> MapSegment(
+      std::size_t size) {
+#if defined(__linux__) && defined(SYS_memfd_create)
+    UniqueFileHandle handle{static_cast<int>(
+        ::syscall(SYS_memfd_create, "nop_shared_blob", 1u /*MFD_CLOEXEC*/))};
+#else
+    UniqueFileHandle handle;
+#endif
+    if (!handle)
+      return ErrorStatus::SystemError;
+    if (::ftruncate(handle.get(), static_cast<off_t>(size)) < 0)
+      return ErrorStatus::IOError;
+
+    void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                           handle.get(), 0);
+    if (address == MAP_FAILED)
+      return ErrorStatus::IOError;
+
+    return {std::make_shared<const detail::SharedMapping>(std::move(handle),
+                                                          address, size)};
+  }
+
+  std::size_t segment_size_;
+  std::size_t threshold_;
+  std::shared_ptr<const detail::SharedMapping> segment_;
+  std::size_t used_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_TYPES_SHARED_BLOB_H_
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_TYPES_SHARED_FRAME_H_
+#define LIBNOP_INCLUDE_NOP_TYPES_SHARED_FRAME_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <nop/base/encoding_byte.h>
+
+namespace nop {
+
+//
+// SharedFrame is an immutable, reference-counted buffer holding exactly one
+// encoded value, for sending the same message to many channels. The value is
+// encoded once with EncodeFrame() and the frame is then written to each
+// channel in place of the value, so that the cost of encoding does not grow
+// with the number of channels. Copies of a frame share the same bytes.
+//
+// Writing a frame is a single bulk write of its bytes. Writers that hold on to
+// their output, such as IovecWriter, keep a reference to the frame instead of
+// copying large frames, and SocketWriter sends frames straight from the shared
+// bytes. Since frames are immutable they may be written from several threads
+// at a time.
+//
+// Frames are encoded by a plain writer, like PreEncoded: the value may not
+// contain handles, whose references are specific to each channel. Reading a
+// SharedFrame captures the encoding of the next value of any type without
+// decoding it.
+//
+// Example:
+//
+//   auto frame = nop::EncodeFrame(message);
+//   if (!frame)
+//     return frame.error();
+//
+//   for (auto& subscriber : subscribers)
+//     subscriber.serializer.Write(frame.get());
+//
+// The encoding of SharedFrame is described in nop/base/shared_frame.h.
+//
+
+class SharedFrame {
+ public:
+  using BufferType = std::vector<std::uint8_t>;
+
+  // A default constructed SharedFrame holds the encoding of nil.
+  SharedFrame()
+      : SharedFrame{BufferType{static_cast<std::uint8_t>(EncodingByte::Nil)}} {}
+  SharedFrame(const SharedFrame&) = default;
+  SharedFrame(SharedFrame&&) = default;
+
+  // Takes ownership of |data|, which must hold exactly one encoded value.
+  explicit SharedFrame(BufferType data)
+      : data_{std::make_shared<const BufferType>(std::move(data))} {}
+
+  SharedFrame& operator=(const SharedFrame&) = default;
+  SharedFrame& operator=(SharedFrame&&) = default;
+
+  const std::uint8_t* data() const { return data_->data(); }
+  std::size_t size() const { return data_->size(); }
+
+  const std::uint8_t* begin() const { return data(); }
+  const std::uint8_t* end() const { return data() + size(); }
+
+  const BufferType& buffer() const { return *data_; }
+
+  // Returns the number of frames sharing these bytes, including this one.
+  long use_count() const { return data_.use_count(); }
+
+ private:
+  // Only null in a moved-from frame.
+  std::shared_ptr<const BufferType> data_;
+};
+
+inline bool operator==(const SharedFrame& a, const SharedFrame& b) {
+  return a.buffer() == b.buffer();
+}
+inline bool operator!=(const SharedFrame& a, const SharedFrame& b) {
+  return !(a == b);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_TYPES_SHARED_FRAME_H_
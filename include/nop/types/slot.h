@@ -0,0 +1,66 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_TYPES_SLOT_H_
+#define LIBNOP_INCLUDE_NOP_TYPES_SLOT_H_
+
+namespace nop {
+
+//
+// Integer or enum of type T that is always encoded at the full width of its
+// type, with the widest prefix the type allows, so that the encoding has the
+// same size and layout whatever the value is. Slot<T> is fungible with T: a
+// slot reads any encoding of T and T reads the encoding of a slot.
+//
+// Slots designate the fields of a MessageTemplate that are patched at runtime,
+// such as sequence numbers and timestamps, but may be used anywhere a field of
+// constant encoded size is useful.
+//
+// Example:
+//
+//   struct Heartbeat {
+//     nop::Slot<std::uint64_t> sequence;
+//     std::uint32_t node;
+//     NOP_STRUCTURE(Heartbeat, sequence, node);
+//   };
+//
+template <typename T>
+class Slot {
+ public:
+  using value_type = T;
+
+  constexpr Slot() = default;
+  constexpr Slot(const Slot&) = default;
+  constexpr Slot(T value) : value_{value} {}
+
+  constexpr Slot& operator=(const Slot&) = default;
+  constexpr Slot& operator=(T value) {
+    value_ = value;
+    return *this;
+  }
+
+  constexpr const T& get() const { return value_; }
+  constexpr T& get() { return value_; }
+
+  constexpr operator T() const { return value_; }
+
+ private:
+  T value_{};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_TYPES_SLOT_H_
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_TYPES_STATIC_STRING_H_
+#define LIBNOP_INCLUDE_NOP_TYPES_STATIC_STRING_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+namespace nop {
+
+//
+// String of at most Capacity characters, stored inline with a null terminator.
+// BasicStaticString encodes the same as std::basic_string and is fungible with
+// it. Deserializing a static string from an encoding with more characters than
+// its capacity fails with ErrorStatus::InvalidStringLength.
+//
+// Constructors truncate strings longer than the capacity. The other operations
+// that would exceed the capacity leave the string unchanged and return false.
+//
+// Example:
+//
+//   struct Command {
+//     nop::StaticString<16> name;
+//     std::int32_t argument;
+//     NOP_STRUCTURE(Command, name, argument);
+//   };
+//
+template <typename CharType, std::size_t Capacity>
+class BasicStaticString {
+  static_assert(Capacity > 0, "BasicStaticString capacity must be non-zero.");
+
+ public:
+  using value_type = CharType;
+  using traits_type = std::char_traits<CharType>;
+  using iterator = CharType*;
+  using const_iterator = const CharType*;
+
+  BasicStaticString() = default;
+  BasicStaticString(const CharType* string) {
+    Truncate(string, traits_type::length(string));
+  }
+  BasicStaticString(const CharType* string, std::size_t size) {
+    Truncate(string, size);
+  }
+  template <typename Traits, typename Allocator>
+  BasicStaticString(
+      const std::basic_string<CharType, Traits, Allocator>& string) {
+    Truncate(string.data(), string.size());
+  }
+
+  // Replaces the contents with |size| characters from |string|. Returns false
+  // without modifying the string if |size| exceeds the capacity.
+  bool assign(const CharType* string, std::size_t size) {
+    if (size > Capacity)
+      return false;
+
+    Truncate(string, size);
+    return true;
+  }
+  bool assign(const CharType* string) {
+    return assign(string, traits_type::length(string));
+  }
+
+  // Appends |size| characters from |string|. Returns false without modifying
+  // the string if the result exceeds the capacity.
+  bool append(const CharType* string, std::size_t size) {
+    if (size > Capacity - size_)
+      return false;
+
+    traits_type::move(data_ + size_, string, size);
+    size_ += size;
+    data_[size_] = CharType{};
+    return true;
+  }
+  bool append(const CharType* string) {
+    return append(string, traits_type::length(string));
+  }
+
+  bool push_back(CharType c) { return append(&c, 1); }
+  void pop_back() { data_[--size_] = CharType{}; }
+
+  // Resizes the string to |size| characters, filling new characters with |c|.
+  // Returns false without modifying the string if |size| exceeds the capacity.
+  bool resize(std::size_t size, CharType c = CharType{}) {
+    if (size > Capacity)
+      return false;
+
+    if (size > size_)
+      traits_type::assign(data_ + size_, size - size_, c);
+    size_ = size;
+    data_[size_] = CharType{};
+    return true;
+  }
+
+  void clear() { resize(0); }
+
+  static constexpr std::size_t capacity() { return Capacity; }
+  static constexpr std::size_t max_size() { return Capacity; }
+
+  std::size_t size() const { return size_; }
+  std::size_t length() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  bool full() const { return size_ == Capacity; }
+
+  CharType* data() { return data_; }
+  const CharType* data() const { return data_; }
+  const CharType* c_str() const { return data_; }
+
+  iterator begin() { return data_; }
+  iterator end() { return data_ + size_; }
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  CharType& operator[](std::size_t index) { return data_[index]; }
+  const CharType& operator[](std::size_t index) const { return data_[index]; }
+
+  std::basic_string<CharType> ToString() const {
+    return std::basic_string<CharType>(data_, size_);
+  }
+
+ private:
+  void Truncate(const CharType* string, std::size_t size) {
+    size_ = std::min(size, Capacity);
+    traits_type::move(data_, string, size_);
+    data_[size_] = CharType{};
+  }
+
+  CharType data_[Capacity + 1] = {};
+  std::size_t size_{0};
+};
+
+template <std::size_t Capacity>
+using StaticString = BasicStaticString<char, Capacity>;
+
+template <typename CharType, std::size_t CapacityA, std::size_t CapacityB>
+inline bool operator==(const BasicStaticString<CharType, CapacityA>& a,
+                       const BasicStaticString<CharType, CapacityB>& b) {
+  using Traits = std::char_traits<CharType>;
+  return a.size() == b.size() &&
+         Traits::compare(a.data(), b.data(), a.size()) == 0;
+}
+template <typename CharType, std::size_t CapacityA, std::size_t CapacityB>
+inline bool operator!=(const BasicStaticString<CharType, CapacityA>& a,
+                       const BasicStaticString<CharType, CapacityB>& b) {
+  return !(a == b);
+}
+
+template <typename CharType, std::size_t Capacity>
+inline bool operator==(const BasicStaticString<CharType, Capacity>& a,
+                       const CharType* b) {
+  using Traits = std::char_traits<CharType>;
+  return a.size() == Traits::length(b) &&
+         Traits::compare(a.data(), b, a.size()) == 0;
+}
+template <typename CharType, std::size_t Capacity>
+inline bool operator!=(const BasicStaticString<CharType, Capacity>& a,
+                       const CharType* b) {
+  return !(a == b);
+}
+
+template <typename CharType, std::size_t Capacity>
+inline bool operator==(const CharType* a,
+                       const BasicStaticString<CharType, Capacity>& b) {
+  return b == a;
+}
+template <typename CharType, std::size_t Capacity>
+inline bool operator!=(const CharType* a,
+                       const BasicStaticString<CharType, Capacity>& b) {
+  return !(b == a);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_TYPES_STATIC_STRING_H_
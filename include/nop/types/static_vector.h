@@ -0,0 +1,347 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_TYPES_STATIC_VECTOR_H_
+#define LIBNOP_INCLUDE_NOP_TYPES_STATIC_VECTOR_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nop {
+
+//
+// Vector types with inline storage. StaticVector<T, Capacity> stores up to
+// Capacity elements inline and never allocates. SmallVector<T, Capacity> stores
+// up to Capacity elements inline and moves its elements to the heap only when
+// it grows beyond that.
+//
+// Both types encode the same as std::vector<T> and are fungible with it.
+// Deserializing a StaticVector from an encoding with more elements than its
+// capacity fails with ErrorStatus::InvalidContainerLength.
+//
+// Since the library does not use exceptions, StaticVector operations that would
+// exceed the capacity leave the vector unchanged and return false.
+//
+// Example of a message type that is decoded without allocating:
+//
+//   struct Telemetry {
+//     std::uint32_t sequence;
+//     nop::StaticVector<float, 32> samples;
+//     NOP_STRUCTURE(Telemetry, sequence, samples);
+//   };
+//
+
+// Vector of at most Capacity elements of type T, stored inline.
+template <typename T, std::size_t Capacity>
+class StaticVector {
+  static_assert(Capacity > 0, "StaticVector capacity must be non-zero.");
+
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  StaticVector() = default;
+  StaticVector(std::initializer_list<T> list) {
+    assign(list.begin(), list.end());
+  }
+  StaticVector(const StaticVector& other) {
+    assign(other.begin(), other.end());
+  }
+  StaticVector(StaticVector&& other) noexcept(
+      std::is_nothrow_move_constructible<T>::value) {
+    for (T& element : other)
+      emplace_back(std::move(element));
+    other.clear();
+  }
+
+  ~StaticVector() { clear(); }
+
+  StaticVector& operator=(const StaticVector& other) {
+    if (this != &other)
+      assign(other.begin(), other.end());
+    return *this;
+  }
+  StaticVector& operator=(StaticVector&& other) noexcept(
+      std::is_nothrow_move_constructible<T>::value) {
+    if (this != &other) {
+      clear();
+      for (T& element : other)
+        emplace_back(std::move(element));
+      other.clear();
+    }
+    return *this;
+  }
+
+  // Replaces the contents with the elements in the range [first, last).
+  // Returns false without modifying the vector if the range does not fit.
+  template <typename Iterator>
+  bool assign(Iterator first, Iterator last) {
+    if (static_cast<std::size_t>(std::distance(first, last)) > Capacity)
+      return false;
+
+    clear();
+    for (; first != last; ++first)
+      emplace_back(*first);
+    return true;
+  }
+
+  static constexpr std::size_t capacity() { return Capacity; }
+  static constexpr std::size_t max_size() { return Capacity; }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  bool full() const { return size_ == Capacity; }
+
+  T* data() { return reinterpret_cast<T*>(storage_); }
+  const T* data() const { return reinterpret_cast<const T*>(storage_); }
+
+  iterator begin() { return data(); }
+  iterator end() { return data() + size_; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size_; }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  T& operator[](std::size_t index) { return data()[index]; }
+  const T& operator[](std::size_t index) const { return data()[index]; }
+
+  T& front() { return data()[0]; }
+  const T& front() const { return data()[0]; }
+  T& back() { return data()[size_ - 1]; }
+  const T& back() const { return data()[size_ - 1]; }
+
+  // Storage is inline, so reserving only checks that |size| fits.
+  bool reserve(std::size_t size) const { return size <= Capacity; }
+
+  template <typename... Args>
+  bool emplace_back(Args&&... args) {
+    if (full())
+      return false;
+
+    new (data() + size_) T(std::forward<Args>(args)...);
+    size_++;
+    return true;
+  }
+
+  bool push_back(const T& value) { return emplace_back(value); }
+  bool push_back(T&& value) { return emplace_back(std::move(value)); }
+
+  void pop_back() { data()[--size_].~T(); }
+
+  // Resizes the vector to |size| elements, value-initializing or copying
+  // |value| into new elements. Returns false without modifying the vector if
+  // |size| exceeds the capacity.
+  bool resize(std::size_t size) {
+    if (size > Capacity)
+      return false;
+
+    while (size_ > size)
+      pop_back();
+    while (size_ < size)
+      emplace_back();
+    return true;
+  }
+  bool resize(std::size_t size, const T& value) {
+    if (size > Capacity)
+      return false;
+
+    while (size_ > size)
+      pop_back();
+    while (size_ < size)
+      emplace_back(value);
+    return true;
+  }
+
+  void clear() {
+    while (size_ > 0)
+      pop_back();
+  }
+
+ private:
+  std::aligned_storage_t<sizeof(T), alignof(T)> storage_[Capacity];
+  std::size_t size_{0};
+};
+
+// Vector that stores up to Capacity elements of type T inline and moves to
+// heap storage when it grows beyond that. Once on the heap the vector stays
+// there, keeping its capacity when cleared, so that a long-lived vector does
+// not allocate in steady state.
+template <typename T, std::size_t Capacity>
+class SmallVector {
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  SmallVector() = default;
+  SmallVector(std::initializer_list<T> list) {
+    reserve(list.size());
+    for (const T& element : list)
+      push_back(element);
+  }
+  SmallVector(const SmallVector&) = default;
+  SmallVector(SmallVector&&) = default;
+
+  // Copies into the existing storage, so that a vector that has moved to the
+  // heap stays there.
+  SmallVector& operator=(const SmallVector& other) {
+    if (this != &other) {
+      clear();
+      reserve(other.size());
+      for (const T& element : other)
+        push_back(element);
+    }
+    return *this;
+  }
+  SmallVector& operator=(SmallVector&&) = default;
+
+  // Returns true if the elements are stored inline.
+  bool is_inline() const { return heap_.capacity() == 0; }
+
+  std::size_t capacity() const {
+    return is_inline() ? Capacity : heap_.capacity();
+  }
+  std::size_t max_size() const { return heap_.max_size(); }
+
+  std::size_t size() const {
+    return is_inline() ? inline_.size() : heap_.size();
+  }
+  bool empty() const { return size() == 0; }
+
+  T* data() { return is_inline() ? inline_.data() : heap_.data(); }
+  const T* data() const { return is_inline() ? inline_.data() : heap_.data(); }
+
+  iterator begin() { return data(); }
+  iterator end() { return data() + size(); }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size(); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  T& operator[](std::size_t index) { return data()[index]; }
+  const T& operator[](std::size_t index) const { return data()[index]; }
+
+  T& front() { return data()[0]; }
+  const T& front() const { return data()[0]; }
+  T& back() { return data()[size() - 1]; }
+  const T& back() const { return data()[size() - 1]; }
+
+  void reserve(std::size_t size) {
+    if (size > capacity()) {
+      Spill(size);
+      heap_.reserve(size);
+    }
+  }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args) {
+    if (is_inline() && !inline_.full()) {
+      inline_.emplace_back(std::forward<Args>(args)...);
+    } else {
+      // Construct the element before spilling, in case the arguments refer to
+      // inline elements.
+      T element(std::forward<Args>(args)...);
+      Spill(Capacity + 1);
+      heap_.push_back(std::move(element));
+    }
+  }
+
+  void push_back(const T& value) { emplace_back(value); }
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+
+  void pop_back() {
+    if (is_inline())
+      inline_.pop_back();
+    else
+      heap_.pop_back();
+  }
+
+  void resize(std::size_t size) {
+    if (is_inline() && size <= Capacity) {
+      inline_.resize(size);
+    } else {
+      Spill(size);
+      heap_.resize(size);
+    }
+  }
+  void resize(std::size_t size, const T& value) {
+    if (is_inline() && size <= Capacity) {
+      inline_.resize(size, value);
+    } else {
+      Spill(size);
+      heap_.resize(size, value);
+    }
+  }
+
+  void clear() {
+    inline_.clear();
+    heap_.clear();
+  }
+
+ private:
+  // Moves the inline elements to heap storage with room for at least |size|
+  // elements. Does nothing if the elements are already on the heap.
+  void Spill(std::size_t size) {
+    if (is_inline()) {
+      heap_.reserve(std::max(size, 2 * Capacity));
+      for (T& element : inline_)
+        heap_.push_back(std::move(element));
+      inline_.clear();
+    }
+  }
+
+  StaticVector<T, Capacity> inline_;
+  std::vector<T> heap_;
+};
+
+template <typename T, std::size_t CapacityA, std::size_t CapacityB>
+inline bool operator==(const StaticVector<T, CapacityA>& a,
+                       const StaticVector<T, CapacityB>& b) {
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+template <typename T, std::size_t CapacityA, std::size_t CapacityB>
+inline bool operator!=(const StaticVector<T, CapacityA>& a,
+                       const StaticVector<T, CapacityB>& b) {
+  return !(a == b);
+}
+
+template <typename T, std::size_t CapacityA, std::size_t CapacityB>
+inline bool operator==(const SmallVector<T, CapacityA>& a,
+                       const SmallVector<T, CapacityB>& b) {
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+template <typename T, std::size_t CapacityA, std::size_t CapacityB>
+inline bool operator!=(const SmallVector<T, CapacityA>& a,
+                       const SmallVector<T, CapacityB>& b) {
+  return !(a == b);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_TYPES_STATIC_VECTOR_H_
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_TYPES_STREAMING_PAYLOAD_H_
+#define LIBNOP_INCLUDE_NOP_TYPES_STREAMING_PAYLOAD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include <nop/base/encoding_byte.h>
+#include <nop/status.h>
+
+namespace nop {
+
+//
+// Types for binary and string payloads that are too large to hold in memory.
+// A streaming payload has a length that is known up front, and its bytes are
+// produced or consumed in chunks through callbacks while the payload is
+// written or read:
+//
+//   * When writing, the source callback fills each chunk, in order, directly
+//     in the output of writers that support reserved writes, or in a buffer of
+//     the chunk size otherwise.
+//   * When reading, the sink callback receives each chunk, in order, directly
+//     from the input of contiguous readers, or from a buffer of the chunk size
+//     otherwise. Payloads read without a sink are skipped.
+//
+// Peak memory is therefore bounded by the chunk size rather than the payload
+// size. The source is called again each time the value is written, so it must
+// be able to produce the same bytes again when a value is written more than
+// once.
+//
+// StreamingBinary uses the same format as std::vector<std::uint8_t> and
+// StreamingString the same format as std::string, so that either side of a
+// connection may use the in-memory types instead.
+//
+// Example:
+//
+//   std::ifstream file{path, std::ios::binary};
+//   nop::StreamingBinary contents{
+//       file_size, [&file](std::uint8_t* data, std::size_t size) {
+//         file.read(reinterpret_cast<char*>(data), size);
+//         return file ? nop::Status<void>{}
+//                     : nop::Status<void>{nop::ErrorStatus::IOError};
+//       }};
+//   serializer.Write(contents);
+//
+// The encoding of streaming payloads is described in
+// nop/base/streaming_payload.h.
+//
+
+template <EncodingByte Prefix>
+class StreamingPayload {
+ public:
+  // Fills the |size| bytes at |data| with the next bytes of the payload.
+  using Source = std::function<Status<void>(std::uint8_t* data,
+                                            std::size_t size)>;
+
+  // Receives the |size| bytes at |data| as the next bytes of the payload.
+  using Sink = std::function<Status<void>(const std::uint8_t* data,
+                                          std::size_t size)>;
+
+  enum : std::size_t { kDefaultChunkSize = 64 * 1024 };
+
+  StreamingPayload() = default;
+  StreamingPayload(const StreamingPayload&) = default;
+  StreamingPayload(StreamingPayload&&) = default;
+
+  // Constructs a payload of |size| bytes produced by |source| for writing.
+  StreamingPayload(std::uint64_t size, Source source,
+                   std::size_t chunk_size = kDefaultChunkSize)
+      : size_{size},
+        chunk_size_{chunk_size ? chunk_size : kDefaultChunkSize},
+        source_{std::move(source)} {}
+
+  // Constructs a payload consumed by |sink| for reading.
+  explicit StreamingPayload(Sink sink,
+                            std::size_t chunk_size = kDefaultChunkSize)
+      : chunk_size_{chunk_size ? chunk_size : kDefaultChunkSize},
+        sink_{std::move(sink)} {}
+
+  StreamingPayload& operator=(const StreamingPayload&) = default;
+  StreamingPayload& operator=(StreamingPayload&&) = default;
+
+  // Returns the length of the payload, which is updated when it is read.
+  std::uint64_t size() const { return size_; }
+  std::size_t chunk_size() const { return chunk_size_; }
+
+  const Source& source() const { return source_; }
+  const Sink& sink() const { return sink_; }
+
+  // Sets the length of the payload that was read.
+  void set_size(std::uint64_t size) { size_ = size; }
+
+ private:
+  std::uint64_t size_{0};
+  std::size_t chunk_size_{kDefaultChunkSize};
+  Source source_;
+  Sink sink_;
+};
+
+using StreamingBinary = StreamingPayload<EncodingByte::Binary>;
+using StreamingString = StreamingPayload<EncodingByte::String>;
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_TYPES_STREAMING_PAYLOAD_H_
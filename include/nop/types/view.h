@@ -0,0 +1,165 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_TYPES_VIEW_H_
+#define LIBNOP_INCLUDE_NOP_TYPES_VIEW_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace nop {
+
+//
+// View types are non-owning references to a contiguous run of elements. They
+// encode the same as the owning container types (std::basic_string and
+// std::vector respectively) but, when deserialized from a reader that supports
+// borrowing from its input, such as BufferReader, they point directly into the
+// input buffer instead of copying out of it. The input buffer must outlive any
+// views deserialized from it.
+//
+// Views are restricted to byte-sized elements so that they never refer to
+// unaligned or byte-swapped data in the input buffer.
+//
+// Example of deserializing a string without allocating:
+//
+//   struct Request {
+//     nop::StringView name;
+//     nop::ArrayView<std::uint8_t> blob;
+//     NOP_STRUCTURE(Request, name, blob);
+//   };
+//
+//   nop::Deserializer<nop::BufferReader> deserializer{buffer, size};
+//   Request request;
+//   deserializer.Read(&request);  // request.blob points into buffer.
+//
+
+// Non-owning view of a string of characters.
+template <typename CharType>
+class BasicStringView {
+  static_assert(sizeof(CharType) == 1,
+                "String views are only supported for byte-sized characters.");
+
+ public:
+  using value_type = CharType;
+  using const_iterator = const CharType*;
+  using iterator = const_iterator;
+
+  constexpr BasicStringView() = default;
+  constexpr BasicStringView(const BasicStringView&) = default;
+  constexpr BasicStringView(const CharType* data, std::size_t size)
+      : data_{data}, size_{size} {}
+  BasicStringView(const CharType* string)
+      : data_{string}, size_{std::char_traits<CharType>::length(string)} {}
+  template <typename Traits, typename Allocator>
+  BasicStringView(const std::basic_string<CharType, Traits, Allocator>& string)
+      : data_{string.data()}, size_{string.size()} {}
+
+  constexpr BasicStringView& operator=(const BasicStringView&) = default;
+
+  constexpr const CharType* data() const { return data_; }
+  constexpr std::size_t size() const { return size_; }
+  constexpr std::size_t length() const { return size_; }
+  constexpr bool empty() const { return size_ == 0; }
+
+  constexpr const_iterator begin() const { return data_; }
+  constexpr const_iterator end() const { return data_ + size_; }
+
+  constexpr const CharType& operator[](std::size_t index) const {
+    return data_[index];
+  }
+
+  std::basic_string<CharType> ToString() const {
+    return std::basic_string<CharType>(data_, size_);
+  }
+
+ private:
+  const CharType* data_{nullptr};
+  std::size_t size_{0};
+};
+
+template <typename CharType>
+inline bool operator==(BasicStringView<CharType> a,
+                       BasicStringView<CharType> b) {
+  using Traits = std::char_traits<CharType>;
+  return a.size() == b.size() &&
+         Traits::compare(a.data(), b.data(), a.size()) == 0;
+}
+template <typename CharType>
+inline bool operator!=(BasicStringView<CharType> a,
+                       BasicStringView<CharType> b) {
+  return !(a == b);
+}
+
+using StringView = BasicStringView<char>;
+
+// Non-owning view of an array of integral elements.
+template <typename T>
+class ArrayView {
+  static_assert(std::is_integral<T>::value && sizeof(T) == 1,
+                "Array views are only supported for byte-sized integral "
+                "elements.");
+
+ public:
+  using value_type = T;
+  using const_iterator = const T*;
+  using iterator = const_iterator;
+
+  constexpr ArrayView() = default;
+  constexpr ArrayView(const ArrayView&) = default;
+  constexpr ArrayView(const T* data, std::size_t size)
+      : data_{data}, size_{size} {}
+  template <typename Allocator>
+  ArrayView(const std::vector<T, Allocator>& vector)
+      : data_{vector.data()}, size_{vector.size()} {}
+  template <std::size_t Size>
+  constexpr ArrayView(const T (&array)[Size]) : data_{array}, size_{Size} {}
+
+  constexpr ArrayView& operator=(const ArrayView&) = default;
+
+  constexpr const T* data() const { return data_; }
+  constexpr std::size_t size() const { return size_; }
+  constexpr bool empty() const { return size_ == 0; }
+
+  constexpr const_iterator begin() const { return data_; }
+  constexpr const_iterator end() const { return data_ + size_; }
+
+  constexpr const T& operator[](std::size_t index) const {
+    return data_[index];
+  }
+
+  std::vector<T> ToVector() const { return std::vector<T>(begin(), end()); }
+
+ private:
+  const T* data_{nullptr};
+  std::size_t size_{0};
+};
+
+template <typename T>
+inline bool operator==(ArrayView<T> a, ArrayView<T> b) {
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+template <typename T>
+inline bool operator!=(ArrayView<T> a, ArrayView<T> b) {
+  return !(a == b);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_TYPES_VIEW_H_
@@ -0,0 +1,286 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_ARENA_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_ARENA_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <nop/utility/page_allocator.h>
+
+namespace nop {
+
+//
+// Arena allocation for deserialization. Decoding a message with nested
+// strings, vectors, and maps normally allocates each of them separately from
+// the heap. Containers that use ArenaAllocator instead allocate from an Arena,
+// which hands out memory from large blocks with a bump pointer and frees
+// everything at once when it is reset, reusing the blocks for the next
+// message.
+//
+// The encodings construct nested elements with their default constructors,
+// so ArenaAllocator finds its arena through ArenaScope: while a scope is
+// active on a thread, every default-constructed ArenaAllocator on that thread
+// allocates from the scope's arena. Outside of a scope ArenaAllocator uses the
+// heap, like std::allocator. Arena containers encode the same as the standard
+// containers.
+//
+// Example:
+//
+//   struct Request {
+//     nop::ArenaString name;
+//     nop::ArenaVector<nop::ArenaString> tags;
+//     NOP_STRUCTURE(Request, name, tags);
+//   };
+//
+//   nop::Arena arena;
+//   while (...) {
+//     {
+//       nop::ArenaScope scope{&arena};
+//       Request request;
+//       deserializer.Read(&request);
+//       Process(request);
+//     }
+//     arena.Reset();  // Frees the whole request.
+//   }
+//
+// Memory is not reclaimed until the arena is reset, so containers that grow
+// by repeated appends waste the memory they outgrow. The encodings reserve
+// containers up front where possible. Values allocated from an arena must be
+// destroyed before the arena is reset or destroyed.
+//
+// Arenas constructed with page options map their blocks with AllocatePages()
+// instead of taking them from the heap, for example to back large blocks
+// with huge pages on the NUMA node of the thread that decodes into them:
+//
+//   const unsigned options =
+//       nop::PageOptions::HugePages | nop::PageOptions::LocalNode;
+//   nop::Arena arena{4 * nop::kHugePageSize, options};
+//
+
+// Monotonic allocator that hands out memory from a list of blocks.
+class Arena {
+ public:
+  enum : std::size_t { kDefaultBlockSize = 64 * 1024 };
+
+  Arena() = default;
+  explicit Arena(std::size_t block_size)
+      : block_size_{std::max<std::size_t>(block_size, 1)} {}
+  Arena(std::size_t block_size, unsigned page_options)
+      : block_size_{std::max<std::size_t>(block_size, 1)},
+        page_backed_{true},
+        page_options_{page_options} {}
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // Returns |size| bytes of memory aligned to |alignment|, which must be a
+  // power of two.
+  void* Allocate(std::size_t size, std::size_t alignment) {
+    while (true) {
+      if (index_ < blocks_.size()) {
+        void* pointer = AllocateFrom(&blocks_[index_], size, alignment);
+        if (pointer)
+          return pointer;
+
+        // Move on to the next block kept from before the last reset, if it
+        // is large enough.
+        index_++;
+        offset_ = 0;
+        if (index_ < blocks_.size() &&
+            blocks_[index_].size >= size + alignment) {
+          continue;
+        }
+      }
+
+      // Insert a new block before any remaining blocks.
+      const std::size_t block_size =
+          std::max<std::size_t>(block_size_, size + alignment);
+      blocks_.insert(blocks_.begin() + index_, NewBlock(block_size));
+      capacity_ += block_size;
+    }
+  }
+
+  // Frees all of the memory allocated from the arena, keeping the blocks for
+  // reuse.
+  void Reset() {
+    index_ = 0;
+    offset_ = 0;
+    allocated_ = 0;
+  }
+
+  // Frees all of the memory allocated from the arena and releases the blocks.
+  void Clear() {
+    Reset();
+    blocks_.clear();
+    capacity_ = 0;
+  }
+
+  // Returns the number of bytes allocated since the arena was last reset.
+  std::size_t allocated() const { return allocated_; }
+
+  // Returns the total size of the blocks held by the arena.
+  std::size_t capacity() const { return capacity_; }
+
+  // Returns the arena of the innermost active ArenaScope on this thread, or
+  // nullptr if there is none.
+  static Arena* Current() { return CurrentSlot(); }
+
+ private:
+  friend class ArenaScope;
+
+  // Frees a block from the heap or unmaps a block of page memory.
+  struct BlockDeleter {
+    std::size_t size;
+    bool page_backed;
+    unsigned page_options;
+
+    void operator()(std::uint8_t* data) const {
+      if (page_backed)
+        FreePages(data, size, page_options);
+      else
+        delete[] data;
+    }
+  };
+
+  struct Block {
+    std::unique_ptr<std::uint8_t[], BlockDeleter> data;
+    std::size_t size;
+  };
+
+  // Allocates a block of |size| bytes. Like the heap, throws std::bad_alloc
+  // when page memory cannot be mapped.
+  Block NewBlock(std::size_t size) const {
+    std::uint8_t* data;
+    if (page_backed_) {
+      data = static_cast<std::uint8_t*>(AllocatePages(size, page_options_));
+      if (data == nullptr)
+        throw std::bad_alloc{};
+    } else {
+      data = new std::uint8_t[size];
+    }
+    return Block{{data, BlockDeleter{size, page_backed_, page_options_}},
+                 size};
+  }
+
+  // Allocates from the unused part of |block|, returning nullptr if there is
+  // not enough room.
+  void* AllocateFrom(Block* block, std::size_t size, std::size_t alignment) {
+    const std::uintptr_t base =
+        reinterpret_cast<std::uintptr_t>(block->data.get());
+    const std::uintptr_t aligned =
+        (base + offset_ + alignment - 1) & ~(alignment - 1);
+    const std::size_t begin = aligned - base;
+    if (begin > block->size || size > block->size - begin)
+      return nullptr;
+
+    offset_ = begin + size;
+    allocated_ += size;
+    return block->data.get() + begin;
+  }
+
+  static Arena*& CurrentSlot() {
+    static thread_local Arena* current = nullptr;
+    return current;
+  }
+
+  std::size_t block_size_{kDefaultBlockSize};
+  bool page_backed_{false};
+  unsigned page_options_{PageOptions::None};
+  std::vector<Block> blocks_;
+  std::size_t index_{0};
+  std::size_t offset_{0};
+  std::size_t allocated_{0};
+  std::size_t capacity_{0};
+};
+
+// Makes |arena| the arena of default-constructed ArenaAllocators on this
+// thread for the lifetime of the scope. Scopes may be nested.
+class ArenaScope {
+ public:
+  explicit ArenaScope(Arena* arena) : previous_{Arena::CurrentSlot()} {
+    Arena::CurrentSlot() = arena;
+  }
+  ~ArenaScope() { Arena::CurrentSlot() = previous_; }
+
+  ArenaScope(const ArenaScope&) = delete;
+  ArenaScope& operator=(const ArenaScope&) = delete;
+
+ private:
+  Arena* previous_;
+};
+
+// Allocator that allocates from an Arena, or from the heap when constructed
+// without one.
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  ArenaAllocator() : arena_{Arena::Current()} {}
+  explicit ArenaAllocator(Arena* arena) : arena_{arena} {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_{other.arena()} {}
+
+  T* allocate(std::size_t count) {
+    if (arena_)
+      return static_cast<T*>(arena_->Allocate(count * sizeof(T), alignof(T)));
+    else
+      return static_cast<T*>(::operator new(count * sizeof(T)));
+  }
+
+  void deallocate(T* pointer, std::size_t /*count*/) {
+    if (!arena_)
+      ::operator delete(pointer);
+  }
+
+  Arena* arena() const { return arena_; }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return !(a == b);
+}
+
+// Standard containers that allocate from the current arena.
+using ArenaString =
+    std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+template <typename Key, typename T, typename Compare = std::less<Key>>
+using ArenaMap =
+    std::map<Key, T, Compare, ArenaAllocator<std::pair<const Key, T>>>;
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_ARENA_H_
@@ -0,0 +1,239 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_ARRAY_INDEX_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_ARRAY_INDEX_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/skip.h>
+#include <nop/status.h>
+#include <nop/structure.h>
+#include <nop/utility/pedantic_buffer_reader.h>
+
+namespace nop {
+
+// ArrayIndex is a sidecar index of the element offsets of an encoded array,
+// which supports reading any element or range of elements without decoding
+// the elements that precede it. The offset of every |stride|-th element is
+// recorded, relative to the start of the array encoding; the remaining
+// elements are found by skipping at most |stride| - 1 elements with
+// SkipValue(). A stride of one makes every lookup constant time, while larger
+// strides trade lookup time for a smaller index.
+//
+// The array encoding itself is unchanged, so an index may be built for any
+// existing array with Build(), or recorded while writing the array with
+// Write(). The index is itself serializable and may be stored alongside the
+// array, for example in a separate file or table entry.
+//
+// Example:
+//
+//   nop::ArrayIndex index{16};
+//   index.Write(records, &writer);
+//   ...
+//   Record record;
+//   auto status = index.Read(data, size, 12345, &record);
+//
+class ArrayIndex {
+ public:
+  enum : std::size_t { kDefaultStride = 1 };
+
+  ArrayIndex() = default;
+  explicit ArrayIndex(std::size_t stride)
+      : stride_{std::max<std::size_t>(stride, 1)} {}
+  ArrayIndex(const ArrayIndex&) = default;
+  ArrayIndex(ArrayIndex&&) = default;
+
+  ArrayIndex& operator=(const ArrayIndex&) = default;
+  ArrayIndex& operator=(ArrayIndex&&) = default;
+
+  // Builds the index for the encoded array at the start of |data|.
+  Status<void> Build(const void* data, std::size_t size) {
+    PedanticBufferReader reader{data, size};
+    auto status = ReadArrayPrefix(&reader);
+    if (!status)
+      return status;
+
+    for (SizeType i = 0; i < count_; i++) {
+      if (i % stride_ == 0)
+        offsets_.push_back(size - reader.remaining());
+
+      status = SkipValue(&reader);
+      if (!status)
+        return status;
+    }
+
+    return {};
+  }
+
+  // Writes |elements| to |writer| as an array, recording the offsets of the
+  // elements. The output is the same as the encoding of the container when
+  // the container is encoded as an array. The writer must provide size()
+  // returning the number of bytes written, like VectorWriter.
+  template <typename Container, typename Writer>
+  Status<void> Write(const Container& elements, Writer* writer) {
+    using Element = typename Container::value_type;
+    static_assert(!std::is_arithmetic<Element>::value,
+                  "Arithmetic elements are encoded as binary containers, which "
+                  "support random access without an index.");
+
+    const std::size_t start = writer->size();
+    auto status =
+        writer->Write(static_cast<std::uint8_t>(EncodingByte::Array));
+    if (!status)
+      return status;
+
+    offsets_.clear();
+    count_ = static_cast<SizeType>(elements.size());
+    status = Encoding<SizeType>::Write(count_, writer);
+    if (!status)
+      return status;
+
+    SizeType i = 0;
+    for (const Element& element : elements) {
+      if (i++ % stride_ == 0)
+        offsets_.push_back(writer->size() - start);
+
+      status = Encoding<Element>::Write(element, writer);
+      if (!status)
+        return status;
+    }
+
+    return {};
+  }
+
+  // Returns the offset of the element with the given index from the start of
+  // the encoded array in |data|.
+  Status<std::size_t> Find(const void* data, std::size_t size,
+                           std::size_t index) const {
+    // Deserialized indices may be invalid.
+    if (stride_ == 0 || index >= count_ || index / stride_ >= offsets_.size())
+      return ErrorStatus::InvalidContainerLength;
+
+    const SizeType offset = offsets_[index / stride_];
+    if (offset > size)
+      return ErrorStatus::ReadLimitReached;
+
+    PedanticBufferReader reader{static_cast<const std::uint8_t*>(data) + offset,
+                                size - offset};
+    for (std::size_t i = 0; i < index % stride_; i++) {
+      auto status = SkipValue(&reader);
+      if (!status)
+        return status.error();
+    }
+
+    return size - reader.remaining();
+  }
+
+  // Reads the element with the given index of the encoded array in |data|.
+  template <typename T>
+  Status<void> Read(const void* data, std::size_t size, std::size_t index,
+                    T* value) const {
+    return ReadRange(data, size, index, 1, &value,
+                     [](T** out, PedanticBufferReader* reader) {
+                       return Encoding<T>::Read(*out, reader);
+                     });
+  }
+
+  // Reads |length| elements starting at the given index of the encoded array
+  // in |data| into |values|.
+  template <typename T, typename Allocator>
+  Status<void> Read(const void* data, std::size_t size, std::size_t index,
+                    std::size_t length,
+                    std::vector<T, Allocator>* values) const {
+    if (length > count_ || index > count_ - length)
+      return ErrorStatus::InvalidContainerLength;
+
+    values->clear();
+    values->reserve(length);
+    return ReadRange(data, size, index, length, values,
+                     [](std::vector<T, Allocator>* out,
+                        PedanticBufferReader* reader) {
+                       out->emplace_back();
+                       return Encoding<T>::Read(&out->back(), reader);
+                     });
+  }
+
+  void clear() {
+    count_ = 0;
+    offsets_.clear();
+  }
+
+  // Returns the number of elements in the indexed array.
+  std::size_t count() const { return static_cast<std::size_t>(count_); }
+  std::size_t stride() const { return static_cast<std::size_t>(stride_); }
+  const std::vector<SizeType>& offsets() const { return offsets_; }
+
+ private:
+  Status<void> ReadArrayPrefix(PedanticBufferReader* reader) {
+    clear();
+
+    std::uint8_t prefix_byte = 0;
+    auto status = reader->Read(&prefix_byte);
+    if (!status)
+      return status;
+    else if (static_cast<EncodingByte>(prefix_byte) != EncodingByte::Array)
+      return ErrorStatus::UnexpectedEncodingType;
+
+    SizeType count = 0;
+    status = Encoding<SizeType>::Read(&count, reader);
+    if (!status)
+      return status;
+
+    // Every element takes at least one byte.
+    status = reader->Ensure(count);
+    if (!status)
+      return status;
+
+    count_ = count;
+    return {};
+  }
+
+  template <typename Out, typename Function>
+  Status<void> ReadRange(const void* data, std::size_t size,
+                         std::size_t index, std::size_t length, Out* out,
+                         Function function) const {
+    auto status = Find(data, size, index);
+    if (!status)
+      return status.error();
+
+    const std::size_t offset = status.get();
+    PedanticBufferReader reader{static_cast<const std::uint8_t*>(data) + offset,
+                                size - offset};
+    for (std::size_t i = 0; i < length; i++) {
+      auto read_status = function(out, &reader);
+      if (!read_status)
+        return read_status;
+    }
+
+    return {};
+  }
+
+  SizeType stride_{kDefaultStride};
+  SizeType count_{0};
+  std::vector<SizeType> offsets_;
+
+  NOP_STRUCTURE(ArrayIndex, stride_, count_, offsets_);
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_ARRAY_INDEX_H_
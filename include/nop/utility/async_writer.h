@@ -0,0 +1,307 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_ASYNC_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_ASYNC_WRITER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <nop/status.h>
+#include <nop/traits/is_detected.h>
+
+namespace nop {
+
+// AsyncWriter is a writer adapter that moves the output of another writer off
+// the serializing thread. Values are serialized into one of a fixed number of
+// buffers owned by the adapter, and each full buffer is handed to a background
+// thread that writes it to the wrapped writer, so that a writer blocking on a
+// slow fd or stream does not stall serialization until every buffer is in
+// flight. At that point writes block until the background thread returns a
+// buffer, which bounds the memory used by the adapter.
+//
+// The wrapped writer is constructed from the trailing constructor arguments,
+// or may be a pointer to an external writer. It is only used by the background
+// thread, and must not be accessed directly until the adapter is drained.
+//
+// Flush() hands the partially filled buffer to the background thread without
+// waiting, and Drain() waits until everything written so far has been written
+// to the wrapped writer, flushing the wrapped writer too when it has a Flush()
+// method. Errors from the wrapped writer are sticky: once a write fails, the
+// remaining buffers are discarded and every later call returns the error. The
+// adapter drains itself when destroyed.
+//
+// Example:
+//
+//   using Writer = nop::AsyncWriter<nop::FdWriter>;
+//   nop::Serializer<Writer> serializer{Writer::kDefaultBufferSize,
+//                                      Writer::kDefaultBufferCount, fd};
+//   serializer.Write(record);  // Returns once |record| is buffered.
+//   serializer.writer().Drain();
+//
+template <typename Writer>
+class AsyncWriter {
+ public:
+  enum : std::size_t {
+    kDefaultBufferSize = 64 * 1024,
+    kDefaultBufferCount = 2,
+  };
+
+  // Creates an adapter with |buffer_count| buffers of |buffer_size| bytes each,
+  // passing |args| to the constructor of the wrapped writer.
+  template <typename... Args>
+  AsyncWriter(std::size_t buffer_size, std::size_t buffer_count,
+              Args&&... args)
+      : writer_{std::forward<Args>(args)...},
+        buffer_size_{std::max<std::size_t>(buffer_size, 1)},
+        buffer_count_{std::max<std::size_t>(buffer_count, 1)},
+        buffers_{new Buffer[buffer_count_]} {
+    for (std::size_t i = 0; i < buffer_count_; i++) {
+      buffers_[i].data.reset(new std::uint8_t[buffer_size_]);
+      free_.push_back(&buffers_[i]);
+    }
+    thread_ = std::thread{&AsyncWriter::Run, this};
+  }
+
+  AsyncWriter(const AsyncWriter&) = delete;
+  void operator=(const AsyncWriter&) = delete;
+
+  ~AsyncWriter() {
+    Drain();
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      stopping_ = true;
+    }
+    full_condition_.notify_one();
+    thread_.join();
+  }
+
+  Status<void> Prepare(std::size_t size) {
+    // Start a new buffer rather than splitting a value that fits in one.
+    if (current_ != nullptr && size > buffer_size_ - current_->size &&
+        size <= buffer_size_) {
+      return Flush();
+    }
+    return ReturnStatus();
+  }
+
+  Status<void> Write(std::uint8_t byte) {
+    if (current_ == nullptr || current_->size == buffer_size_)
+      return Write(&byte, &byte + 1);
+
+    current_->data[current_->size++] = byte;
+    return {};
+  }
+
+  Status<void> Write(const void* begin, const void* end) {
+    const std::uint8_t* source = static_cast<const std::uint8_t*>(begin);
+    return Append(static_cast<const std::uint8_t*>(end) - source,
+                  [&source](std::uint8_t* target, std::size_t count) {
+                    std::memcpy(target, source, count);
+                    source += count;
+                  });
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    return Append(padding_bytes,
+                  [padding_value](std::uint8_t* target, std::size_t count) {
+                    std::memset(target, padding_value, count);
+                  });
+  }
+
+  // Hands the partially filled buffer to the background thread without
+  // waiting for it to be written.
+  Status<void> Flush() {
+    if (current_ != nullptr && current_->size > 0)
+      Handoff();
+    return ReturnStatus();
+  }
+
+  // Waits until everything written so far has been written to the wrapped
+  // writer, and flushes the wrapped writer if it supports flushing.
+  Status<void> Drain() {
+    Flush();
+
+    std::unique_lock<std::mutex> lock{mutex_};
+    const std::size_t held = current_ != nullptr ? 1 : 0;
+    free_condition_.wait(
+        lock, [this, held] { return free_.size() + held == buffer_count_; });
+
+    // The background thread is idle until the next handoff.
+    if (status_)
+      status_ = FlushWriter(IsDetected<FlushTest, WriterType>{});
+    if (!status_)
+      failed_.store(true, std::memory_order_relaxed);
+    return status_;
+  }
+
+  // Returns the wrapped writer. Only safe to use while the adapter is drained.
+  const Writer& writer() const { return writer_; }
+  Writer& writer() { return writer_; }
+
+  std::size_t buffer_size() const { return buffer_size_; }
+  std::size_t buffer_count() const { return buffer_count_; }
+
+ private:
+  using WriterType = std::remove_pointer_t<Writer>;
+
+  template <typename T>
+  using FlushTest = decltype(std::declval<T&>().Flush());
+
+  struct Buffer {
+    std::unique_ptr<std::uint8_t[]> data;
+    std::size_t size{0};
+  };
+
+  template <typename T>
+  static T& Dereference(T& writer) {
+    return writer;
+  }
+  template <typename T>
+  static T& Dereference(T* writer) {
+    return *writer;
+  }
+
+  Status<void> FlushWriter(std::true_type) {
+    return Dereference(writer_).Flush();
+  }
+  Status<void> FlushWriter(std::false_type) { return {}; }
+
+  // Returns the sticky error of the background thread, if any.
+  Status<void> ReturnStatus() {
+    if (!failed_.load(std::memory_order_acquire))
+      return {};
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    return status_;
+  }
+
+  // Fills buffers with |length_bytes| bytes produced by |fill|, handing each
+  // buffer off as it fills up.
+  template <typename Fill>
+  Status<void> Append(std::size_t length_bytes, Fill fill) {
+    auto status = ReturnStatus();
+    if (!status)
+      return status;
+
+    while (length_bytes > 0) {
+      if (current_ == nullptr)
+        Acquire();
+
+      const std::size_t count =
+          std::min(length_bytes, buffer_size_ - current_->size);
+      fill(&current_->data[current_->size], count);
+      current_->size += count;
+      length_bytes -= count;
+
+      if (current_->size == buffer_size_)
+        Handoff();
+    }
+    return {};
+  }
+
+  // Takes a free buffer, waiting for the background thread to return one when
+  // every buffer is in flight.
+  void Acquire() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    free_condition_.wait(lock, [this] { return !free_.empty(); });
+    current_ = free_.front();
+    free_.pop_front();
+  }
+
+  // Queues the current buffer for the background thread.
+  void Handoff() {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      full_.push_back(current_);
+      current_ = nullptr;
+    }
+    full_condition_.notify_one();
+  }
+
+  // Background thread: writes full buffers to the wrapped writer in order.
+  void Run() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    while (true) {
+      full_condition_.wait(lock,
+                           [this] { return !full_.empty() || stopping_; });
+      if (full_.empty())
+        return;
+
+      Buffer* buffer = full_.front();
+      full_.pop_front();
+      const bool discard = !status_;
+      lock.unlock();
+
+      Status<void> status;
+      if (!discard) {
+        // Writers such as BufferWriter only check their limits in Prepare().
+        WriterType& writer = Dereference(writer_);
+        status = writer.Prepare(buffer->size);
+        if (status) {
+          status = writer.Write(buffer->data.get(),
+                                buffer->data.get() + buffer->size);
+        }
+      }
+
+      lock.lock();
+      if (!status) {
+        status_ = status;
+        failed_.store(true, std::memory_order_release);
+      }
+      buffer->size = 0;
+      free_.push_back(buffer);
+      free_condition_.notify_all();
+    }
+  }
+
+  Writer writer_;
+  std::size_t buffer_size_;
+  std::size_t buffer_count_;
+  std::unique_ptr<Buffer[]> buffers_;
+
+  // Buffer being filled by the serializing thread, if any.
+  Buffer* current_{nullptr};
+
+  // Guards the state below, which is shared with the background thread.
+  std::mutex mutex_;
+  std::condition_variable free_condition_;
+  std::condition_variable full_condition_;
+  std::deque<Buffer*> free_;
+  std::deque<Buffer*> full_;
+  Status<void> status_;
+  bool stopping_{false};
+
+  // Set when |status_| holds an error, to check for errors without locking.
+  std::atomic<bool> failed_{false};
+
+  std::thread thread_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_ASYNC_WRITER_H_
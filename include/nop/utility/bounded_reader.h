@@ -20,6 +20,10 @@
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
 
 #include <nop/base/encoding.h>
 #include <nop/base/handle.h>
@@ -27,6 +31,15 @@
 
 namespace nop {
 
+// Passes the TrustedEncoding property of Reader through to BoundedReader.
+template <typename Reader, typename Enabled = void>
+struct BoundedReaderBase {};
+template <typename Reader>
+struct BoundedReaderBase<Reader,
+                         std::enable_if_t<IsTrustedReader<Reader>::value>> {
+  using TrustedEncoding = void;
+};
+
 // BoundedReader is a reader type that wraps another reader pointer and tracks
 // the number of bytes read. Reader operations are transparently passed to the
 // underlying reader unless the requested operation would exceed the size limit
@@ -34,7 +47,7 @@ namespace nop {
 // input up to the size limit in situations that require specific input payload
 // size.
 template <typename Reader>
-class BoundedReader {
+class BoundedReader : public BoundedReaderBase<Reader> {
  public:
   constexpr BoundedReader() = default;
   constexpr BoundedReader(const BoundedReader&) = default;
@@ -63,7 +76,7 @@ class BoundedReader {
     }
   }
 
-  template <typename T, typename Enable = EnableIfArithmetic<T>>
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
   constexpr Status<void> Read(T* begin, T* end) {
     const std::size_t element_size = sizeof(T);
     const std::size_t length = end - begin;
@@ -92,7 +105,21 @@ class BoundedReader {
     return {};
   }
 
-  // Skips any bytes remaining in the limit set at construction.
+  // Borrows |size| bytes from the underlying reader, which must support this
+  // operation.
+  constexpr Status<const std::uint8_t*> Borrow(std::size_t size) {
+    if (size > (size_ - index_))
+      return ErrorStatus::ReadLimitReached;
+
+    auto status = reader_->Borrow(size);
+    if (!status)
+      return status;
+
+    index_ += size;
+    return status;
+  }
+
+  // Skips any bytes remaining in the current limit.
   constexpr Status<void> ReadPadding() {
     const std::size_t padding_bytes = size_ - index_;
     auto status = reader_->Skip(padding_bytes);
@@ -103,13 +130,84 @@ class BoundedReader {
     return {};
   }
 
+  // Narrows the limit to the next |size| bytes, storing the current limit in
+  // |limit| to restore with PopLimit().
+  constexpr Status<void> PushLimit(std::size_t size, std::size_t* limit) {
+    if (size > (size_ - index_))
+      return ErrorStatus::ReadLimitReached;
+
+    *limit = size_;
+    size_ = index_ + size;
+    return {};
+  }
+
+  // Skips any bytes remaining in the current limit and restores |limit|.
+  constexpr Status<void> PopLimit(std::size_t limit) {
+    auto status = ReadPadding();
+    if (!status)
+      return status;
+
+    size_ = limit;
+    return {};
+  }
+
   template <typename HandleType>
   constexpr Status<HandleType> GetHandle(HandleReference handle_reference) {
-    return reader_->GetHandle(handle_reference);
+    return reader_->template GetHandle<HandleType>(handle_reference);
+  }
+
+  // Returns the profile of the underlying reader. Only available when the
+  // underlying reader collects an EncodingProfile; see ProfilerTest.
+  template <typename R = Reader, typename = ProfilerTest<R>>
+  ProfilerTest<R> profiler() const {
+    return reader_->profiler();
   }
 
   constexpr bool empty() const { return index_ == size_; }
 
+  // Returns the number of bytes remaining within the limit that the underlying
+  // reader also reports as remaining. Only available when the underlying
+  // reader supports this operation.
+  template <typename R = Reader,
+            typename = decltype(std::declval<const R&>().remaining())>
+  constexpr std::size_t remaining() const {
+    const std::size_t limit = size_ - index_;
+    const std::size_t remaining = reader_->remaining();
+    return limit < remaining ? limit : remaining;
+  }
+
+  // Defines and finds interned strings and shared objects in the tables of the
+  // underlying reader. Only available when the underlying reader is an
+  // interning reader. The bytes of a definition are read through this reader,
+  // within the limit.
+  template <typename R = Reader,
+            typename = decltype(std::declval<R&>().DefineString(
+                std::uint64_t{}, std::size_t{}))>
+  Status<std::string*> DefineString(std::uint64_t index, std::size_t size) {
+    return reader_->DefineString(index, size);
+  }
+  template <typename R = Reader,
+            typename = decltype(std::declval<const R&>().FindString(
+                std::uint64_t{}))>
+  Status<const std::string*> FindString(std::uint64_t index) const {
+    return reader_->FindString(index);
+  }
+  template <typename R = Reader,
+            typename = decltype(std::declval<R&>().DefineObject(
+                std::uint64_t{}, std::declval<std::shared_ptr<void>>(),
+                std::declval<const void*>()))>
+  Status<void> DefineObject(std::uint64_t index, std::shared_ptr<void> object,
+                            const void* type) {
+    return reader_->DefineObject(index, std::move(object), type);
+  }
+  template <typename R = Reader,
+            typename = decltype(std::declval<const R&>().FindObject(
+                std::uint64_t{}, std::declval<const void*>()))>
+  Status<std::shared_ptr<void>> FindObject(std::uint64_t index,
+                                           const void* type) const {
+    return reader_->FindObject(index, type);
+  }
+
   constexpr std::size_t size() const { return index_; }
   constexpr std::size_t capacity() const { return size_; }
 
@@ -119,6 +217,72 @@ class BoundedReader {
   std::size_t index_{0};
 };
 
+// BoundedReaderScope reads a region of |size| bytes from a reader through a
+// BoundedReader. When the reader is itself a BoundedReader, as it is for the
+// entries of nested tables, the scope narrows its limit instead of wrapping it
+// again, so that reads at any depth go through a single layer of bounds checks
+// and a single reader type.
+//
+// Example:
+//
+//   BoundedReaderScope<Reader> scope{reader, size};
+//   auto status = scope.status();
+//   if (!status)
+//     return status;
+//
+//   status = Encoding<T>::Read(value, scope.reader());
+//   if (!status)
+//     return status;
+//
+//   return scope.ReadPadding();
+//
+template <typename Reader>
+class BoundedReaderScope {
+ public:
+  using ReaderType = BoundedReader<Reader>;
+
+  constexpr BoundedReaderScope(Reader* reader, std::size_t size)
+      : bounded_reader_{reader, size} {}
+
+  BoundedReaderScope(const BoundedReaderScope&) = delete;
+  void operator=(const BoundedReaderScope&) = delete;
+
+  constexpr Status<void> status() const { return {}; }
+  constexpr ReaderType* reader() { return &bounded_reader_; }
+
+  // Skips any bytes remaining in the region.
+  constexpr Status<void> ReadPadding() { return bounded_reader_.ReadPadding(); }
+
+ private:
+  ReaderType bounded_reader_;
+};
+
+template <typename Reader>
+class BoundedReaderScope<BoundedReader<Reader>> {
+ public:
+  using ReaderType = BoundedReader<Reader>;
+
+  constexpr BoundedReaderScope(ReaderType* reader, std::size_t size)
+      : reader_{reader}, status_{reader->PushLimit(size, &limit_)} {}
+
+  BoundedReaderScope(const BoundedReaderScope&) = delete;
+  void operator=(const BoundedReaderScope&) = delete;
+
+  // Returns ErrorStatus::ReadLimitReached if the region does not fit within
+  // the limit of the enclosing region.
+  constexpr Status<void> status() const { return status_; }
+  constexpr ReaderType* reader() { return reader_; }
+
+  // Skips any bytes remaining in the region and restores the limit of the
+  // enclosing region.
+  constexpr Status<void> ReadPadding() { return reader_->PopLimit(limit_); }
+
+ private:
+  ReaderType* reader_;
+  std::size_t limit_{0};
+  Status<void> status_;
+};
+
 }  // namespace nop
 
 #endif  // LIBNOP_INCLUDE_NOP_UTILITY_BOUNDED_READER_H_
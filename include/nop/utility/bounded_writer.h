@@ -20,20 +20,33 @@
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
+#include <utility>
 
+#include <nop/base/canonical.h>
 #include <nop/base/encoding.h>
 #include <nop/base/handle.h>
 #include <nop/base/utility.h>
 
 namespace nop {
 
+// Passes the canonical encoding and SkipStaging properties of Writer through
+// to BoundedWriter.
+template <typename Writer, typename Enabled = void>
+struct BoundedWriterBase : CanonicalWriterBase<Writer> {};
+template <typename Writer>
+struct BoundedWriterBase<Writer,
+                         std::enable_if_t<IsSkipStagingWriter<Writer>::value>>
+    : CanonicalWriterBase<Writer> {
+  using SkipStaging = void;
+};
+
 // BoundedWriter is a writer type that wraps another writer pointer and tracks
 // the number of bytes written. Writer operations are transparently passed to
 // the underlying writer unless the requested operation would exceed the size
 // limit set at construction. BufferWriter can also pad the output up to the
 // size limit in situations that require specific output payload size.
 template <typename Writer>
-class BoundedWriter {
+class BoundedWriter : public BoundedWriterBase<Writer> {
  public:
   constexpr BoundedWriter() = default;
   constexpr BoundedWriter(const BoundedWriter&) = default;
@@ -62,7 +75,7 @@ class BoundedWriter {
     }
   }
 
-  template <typename T, typename Enabel = EnableIfArithmetic<T>>
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
   constexpr Status<void> Write(const T* begin, const T* end) {
     const std::size_t element_size = sizeof(T);
     const std::size_t length = end - begin;
@@ -92,7 +105,8 @@ class BoundedWriter {
     return {};
   }
 
-  // Fills out any remaining bytes with the given padding value.
+  // Fills out any bytes remaining in the current limit with the given padding
+  // value.
   constexpr Status<void> WritePadding(std::uint8_t padding_value = 0x00) {
     const std::size_t padding_bytes = size_ - index_;
     auto status = writer_->Skip(padding_bytes, padding_value);
@@ -103,11 +117,72 @@ class BoundedWriter {
     return {};
   }
 
+  // Narrows the limit to the next |size| bytes, storing the current limit in
+  // |limit| to restore with PopLimit().
+  constexpr Status<void> PushLimit(std::size_t size, std::size_t* limit) {
+    if (size > (size_ - index_))
+      return ErrorStatus::WriteLimitReached;
+
+    *limit = size_;
+    size_ = index_ + size;
+    return {};
+  }
+
+  // Pads out any bytes remaining in the current limit and restores |limit|.
+  constexpr Status<void> PopLimit(std::size_t limit) {
+    auto status = WritePadding();
+    if (!status)
+      return status;
+
+    size_ = limit;
+    return {};
+  }
+
   template <typename HandleType>
-  constexpr Status<HandleType> PushHandle(const HandleType& handle) {
+  constexpr Status<HandleReference> PushHandle(const HandleType& handle) {
     return writer_->PushHandle(handle);
   }
 
+  // Predicts the handle references of the underlying writer. Only available
+  // when the underlying writer supports this operation.
+  template <typename HandleType, typename W = Writer,
+            typename = PeekHandleReferenceTest<W, HandleType>>
+  HandleReference PeekHandleReference(const HandleType& handle,
+                                      std::size_t pending) const {
+    return writer_->PeekHandleReference(handle, pending);
+  }
+
+  // Reserves output of the underlying writer within the size limit. Only
+  // available when the underlying writer supports reserved writes.
+  template <typename W = Writer, typename = ReserveTest<W>>
+  Status<std::uint8_t*> Reserve(std::size_t size) {
+    if (size > (size_ - index_))
+      return ErrorStatus::WriteLimitReached;
+    else
+      return writer_->Reserve(size);
+  }
+
+  template <typename W = Writer, typename = ReserveTest<W>>
+  void Commit(std::size_t size) {
+    writer_->Commit(size);
+    index_ += size;
+  }
+
+  // Records the position of a slot in the underlying writer. Only available
+  // when the underlying writer supports this operation.
+  template <typename W = Writer,
+            typename = decltype(std::declval<W&>().RecordSlot(EncodingByte{}))>
+  constexpr Status<void> RecordSlot(EncodingByte prefix) {
+    return writer_->RecordSlot(prefix);
+  }
+
+  // Returns the profile of the underlying writer. Only available when the
+  // underlying writer collects an EncodingProfile; see ProfilerTest.
+  template <typename W = Writer, typename = ProfilerTest<W>>
+  ProfilerTest<W> profiler() const {
+    return writer_->profiler();
+  }
+
   constexpr std::size_t size() const { return index_; }
   constexpr std::size_t capacity() const { return size_; }
 
@@ -117,6 +192,58 @@ class BoundedWriter {
   std::size_t index_{0};
 };
 
+// BoundedWriterScope writes a region of |size| bytes to a writer through a
+// BoundedWriter, narrowing the limit of the writer instead of wrapping it again
+// when it is itself a BoundedWriter. See BoundedReaderScope.
+template <typename Writer>
+class BoundedWriterScope {
+ public:
+  using WriterType = BoundedWriter<Writer>;
+
+  constexpr BoundedWriterScope(Writer* writer, std::size_t size)
+      : bounded_writer_{writer, size} {}
+
+  BoundedWriterScope(const BoundedWriterScope&) = delete;
+  void operator=(const BoundedWriterScope&) = delete;
+
+  constexpr Status<void> status() const { return {}; }
+  constexpr WriterType* writer() { return &bounded_writer_; }
+
+  // Pads out any bytes remaining in the region.
+  constexpr Status<void> WritePadding() {
+    return bounded_writer_.WritePadding();
+  }
+
+ private:
+  WriterType bounded_writer_;
+};
+
+template <typename Writer>
+class BoundedWriterScope<BoundedWriter<Writer>> {
+ public:
+  using WriterType = BoundedWriter<Writer>;
+
+  constexpr BoundedWriterScope(WriterType* writer, std::size_t size)
+      : writer_{writer}, status_{writer->PushLimit(size, &limit_)} {}
+
+  BoundedWriterScope(const BoundedWriterScope&) = delete;
+  void operator=(const BoundedWriterScope&) = delete;
+
+  // Returns ErrorStatus::WriteLimitReached if the region does not fit within
+  // the limit of the enclosing region.
+  constexpr Status<void> status() const { return status_; }
+  constexpr WriterType* writer() { return writer_; }
+
+  // Pads out any bytes remaining in the region and restores the limit of the
+  // enclosing region.
+  constexpr Status<void> WritePadding() { return writer_->PopLimit(limit_); }
+
+ private:
+  WriterType* writer_;
+  std::size_t limit_{0};
+  Status<void> status_;
+};
+
 }  // namespace nop
 
 #endif  // LIBNOP_INCLUDE_NOP_UTILITY_BOUNDED_WRITER_H_
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_BUFFER_POOL_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_BUFFER_POOL_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/types/thread_local.h>
+#include <nop/utility/vector_writer.h>
+
+namespace nop {
+
+// BufferPool keeps the buffers of finished messages for reuse by the next
+// ones, so that encoders do not allocate a new output buffer per message.
+// Buffers are kept in size classes by capacity, powers of two from
+// kMinBufferSize up, and Acquire() hands out the smallest pooled buffer that
+// holds the requested size.
+//
+// The pool is trimmed as buffers are released: a size class keeps at most
+// |max_buffers_per_class| buffers, and buffers that grew past |max_buffer_size|
+// for an unusually large message are freed rather than pinning that much
+// memory in the pool.
+//
+// Buffers are allocated with Allocator. BufferPool uses std::allocator;
+// pools of buffers in page memory, such as huge pages on the NUMA node of the
+// calling thread, use PageAllocator:
+//
+//   using LocalPageAllocator =
+//       nop::PageAllocator<std::uint8_t, nop::PageOptions::HugePages |
+//                                            nop::PageOptions::LocalNode>;
+//   nop::BasicPooledSerializer<LocalPageAllocator> serializer;
+//
+// BufferPool is not thread safe. ThreadLocalBufferPool() returns a pool for
+// each thread, which PooledSerializer uses by default.
+//
+// Example:
+//
+//   nop::BufferPool pool;
+//   nop::Serializer<nop::VectorWriter> serializer{pool.Acquire()};
+//   serializer.Write(message);
+//   SendBytes(serializer.writer().data(), serializer.writer().size());
+//   pool.Release(serializer.writer().take());
+//
+template <typename Allocator = std::allocator<std::uint8_t>>
+class BasicBufferPool {
+ public:
+  using BufferType = typename BasicVectorWriter<Allocator>::BufferType;
+
+  enum : std::size_t {
+    kMinBufferSize = 256,
+    kSizeClasses = 13,
+    kDefaultMaxBuffersPerClass = 4,
+    kDefaultMaxBufferSize = std::size_t{kMinBufferSize} << (kSizeClasses - 1),
+  };
+
+  explicit BasicBufferPool(
+      std::size_t max_buffers_per_class = kDefaultMaxBuffersPerClass,
+      std::size_t max_buffer_size = kDefaultMaxBufferSize,
+      const Allocator& allocator = Allocator{})
+      : max_buffers_per_class_{max_buffers_per_class},
+        max_buffer_size_{max_buffer_size},
+        allocator_{allocator} {}
+
+  BasicBufferPool(BasicBufferPool&&) = default;
+  BasicBufferPool& operator=(BasicBufferPool&&) = default;
+
+  // Returns an empty buffer with capacity for at least |size| bytes, reusing a
+  // pooled buffer when one is large enough.
+  BufferType Acquire(std::size_t size = 0) {
+    const std::size_t size_class = ClassFor(size);
+    for (std::size_t index = size_class; index < kSizeClasses; index++) {
+      std::vector<BufferType>& buffers = classes_[index];
+      if (!buffers.empty()) {
+        BufferType buffer{std::move(buffers.back())};
+        buffers.pop_back();
+        count_--;
+        return buffer;
+      }
+    }
+
+    BufferType buffer{allocator_};
+    buffer.reserve(size_class < kSizeClasses ? ClassSize(size_class) : size);
+    return buffer;
+  }
+
+  // Returns |buffer| to the pool, discarding its contents. The buffer is freed
+  // instead if it is too small or too large to pool, or its size class is
+  // full.
+  void Release(BufferType&& buffer) {
+    const std::size_t capacity = buffer.capacity();
+    if (capacity < kMinBufferSize || capacity > max_buffer_size_)
+      return;
+
+    std::vector<BufferType>& buffers = classes_[ClassOf(capacity)];
+    if (buffers.size() >= max_buffers_per_class_)
+      return;
+
+    buffer.clear();
+    buffers.push_back(std::move(buffer));
+    count_++;
+  }
+
+  // Frees all of the pooled buffers.
+  void Clear() {
+    for (auto& buffers : classes_)
+      buffers.clear();
+    count_ = 0;
+  }
+
+  // Returns the number of pooled buffers.
+  std::size_t size() const { return count_; }
+
+  std::size_t max_buffers_per_class() const { return max_buffers_per_class_; }
+  std::size_t max_buffer_size() const { return max_buffer_size_; }
+
+ private:
+  static constexpr std::size_t ClassSize(std::size_t index) {
+    return std::size_t{kMinBufferSize} << index;
+  }
+
+  // Returns the smallest size class whose buffers hold |size| bytes, or the
+  // number of classes if none do.
+  static std::size_t ClassFor(std::size_t size) {
+    std::size_t index = 0;
+    while (index < kSizeClasses && ClassSize(index) < size)
+      index++;
+    return index;
+  }
+
+  // Returns the largest size class that a buffer of |capacity| bytes belongs
+  // to, where |capacity| is at least kMinBufferSize.
+  static std::size_t ClassOf(std::size_t capacity) {
+    std::size_t index = 0;
+    while (index + 1 < kSizeClasses && ClassSize(index + 1) <= capacity)
+      index++;
+    return index;
+  }
+
+  std::size_t max_buffers_per_class_;
+  std::size_t max_buffer_size_;
+  Allocator allocator_;
+  std::array<std::vector<BufferType>, kSizeClasses> classes_;
+  std::size_t count_{0};
+};
+
+using BufferPool = BasicBufferPool<>;
+
+// Returns the buffer pool with buffers allocated by Allocator of the calling
+// thread, which is created with the default limits on first use.
+template <typename Allocator>
+BasicBufferPool<Allocator>& ThreadLocalBasicBufferPool() {
+  using PoolType = BasicBufferPool<Allocator>;
+  ThreadLocal<PoolType, ThreadLocalSlot<PoolType, 0>> pool{InPlace{}};
+  return pool.Get();
+}
+
+// Returns the buffer pool of the calling thread.
+inline BufferPool& ThreadLocalBufferPool() {
+  return ThreadLocalBasicBufferPool<std::allocator<std::uint8_t>>();
+}
+
+// Serializer over a VectorWriter with a buffer borrowed from a BufferPool,
+// which is returned to the pool when the serializer is destroyed. The buffer
+// is not returned if it is moved out of the writer with take(). By default the
+// buffer is borrowed from the pool of the calling thread, in which case the
+// serializer must be destroyed on the same thread.
+//
+// Example:
+//
+//   nop::PooledSerializer serializer;
+//   serializer.Write(message);
+//   SendBytes(serializer.writer().data(), serializer.writer().size());
+//
+template <typename Allocator = std::allocator<std::uint8_t>>
+class BasicPooledSerializer : public Serializer<BasicVectorWriter<Allocator>> {
+ public:
+  using PoolType = BasicBufferPool<Allocator>;
+
+  explicit BasicPooledSerializer(std::size_t size = 0)
+      : BasicPooledSerializer{&ThreadLocalBasicBufferPool<Allocator>(), size} {
+  }
+  explicit BasicPooledSerializer(PoolType* pool, std::size_t size = 0)
+      : Serializer<BasicVectorWriter<Allocator>>{pool->Acquire(size)},
+        pool_{pool} {}
+
+  ~BasicPooledSerializer() { pool_->Release(this->writer().take()); }
+
+  BasicPooledSerializer(const BasicPooledSerializer&) = delete;
+  void operator=(const BasicPooledSerializer&) = delete;
+
+  PoolType* pool() const { return pool_; }
+
+ private:
+  PoolType* pool_;
+};
+
+using PooledSerializer = BasicPooledSerializer<>;
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_BUFFER_POOL_H_
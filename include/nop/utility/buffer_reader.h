@@ -47,7 +47,7 @@ class BufferReader {
   BufferReader& operator=(const BufferReader&) = default;
 
   Status<void> Ensure(std::size_t size) {
-    if (size_ - index_ < size)
+    if (NOP_UNLIKELY(size_ - index_ < size))
       return ErrorStatus::ReadLimitReached;
     else
       return {};
@@ -55,7 +55,7 @@ class BufferReader {
 
   Status<void> Read(std::uint8_t* byte) { return Read(byte, byte + 1); }
 
-  template <typename T, typename Enable = EnableIfArithmetic<T>>
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
   Status<void> Read(T* begin, T* end) {
     const std::size_t element_size = sizeof(T);
     const std::size_t length = end - begin;
@@ -71,6 +71,18 @@ class BufferReader {
     return {};
   }
 
+  // Returns a pointer to the next |size| bytes of the input and advances past
+  // them. The pointer remains valid for as long as the underlying buffer. This
+  // supports zero-copy deserialization of view types.
+  Status<const std::uint8_t*> Borrow(std::size_t size) {
+    if (NOP_UNLIKELY(size_ - index_ < size))
+      return ErrorStatus::ReadLimitReached;
+
+    const std::uint8_t* data = &buffer_[index_];
+    index_ += size;
+    return data;
+  }
+
   bool empty() const { return index_ == size_; }
 
   std::size_t remaining() const { return size_ - index_; }
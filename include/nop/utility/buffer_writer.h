@@ -34,6 +34,9 @@ namespace nop {
 // and you need bounds checking in the Write() and Skip() methods.
 class BufferWriter {
  public:
+  // Writes are not bounds checked, so staging them would only add a copy.
+  using SkipStaging = void;
+
   BufferWriter() = default;
   BufferWriter(const BufferWriter&) = default;
   template <std::size_t Size>
@@ -46,7 +49,7 @@ class BufferWriter {
   BufferWriter& operator=(const BufferWriter&) = default;
 
   Status<void> Prepare(std::size_t size) {
-    if (index_ + size > size_)
+    if (NOP_UNLIKELY(index_ + size > size_))
       return ErrorStatus::WriteLimitReached;
     else
       return {};
@@ -54,7 +57,7 @@ class BufferWriter {
 
   Status<void> Write(std::uint8_t byte) { return Write(&byte, &byte + 1); }
 
-  template <typename T, typename Enable = EnableIfArithmetic<T>>
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
   Status<void> Write(const T* begin, const T* end) {
     const std::size_t element_size = sizeof(T);
     const std::size_t length = end - begin;
@@ -72,6 +75,17 @@ class BufferWriter {
     return {};
   }
 
+  // Returns a pointer to the next |size| bytes of the buffer for encodings to
+  // store values into directly. See IsReservingWriter.
+  Status<std::uint8_t*> Reserve(std::size_t size) {
+    if (NOP_UNLIKELY(size > size_ - index_))
+      return ErrorStatus::WriteLimitReached;
+    else
+      return &buffer_[index_];
+  }
+
+  void Commit(std::size_t size) { index_ += size; }
+
   std::size_t size() const { return index_; }
   std::size_t capacity() const { return size_; }
 
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_BUFFERED_FD_READER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_BUFFERED_FD_READER_H_
+
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include <nop/status.h>
+
+namespace nop {
+
+// BufferedFdReader is a reader type that wraps around a UNIX file descriptor
+// and satisfies reads from an internal buffer, refilling the buffer with as
+// few calls to read() as possible. This substantially reduces the number of
+// system calls compared to FdReader when decoding many small values, such as
+// the prefixes and integers that make up most encodings.
+//
+// Reads larger than the internal buffer bypass it: the requested range and the
+// internal buffer are filled together with a single call to readv(), so large
+// binary payloads are read directly into their destination.
+//
+// Like FdReader, the reader takes ownership of the fd and automatically closes
+// it when destroyed, unless it is released. Any data remaining in the internal
+// buffer is discarded when the fd is released or cleared.
+class BufferedFdReader {
+ public:
+  enum : std::size_t { kDefaultBufferSize = 4096 };
+
+  BufferedFdReader() = default;
+  BufferedFdReader(int fd, std::size_t buffer_size = kDefaultBufferSize)
+      : fd_{fd},
+        buffer_{new std::uint8_t[buffer_size]},
+        buffer_size_{buffer_size} {}
+  BufferedFdReader(const BufferedFdReader&) = delete;
+  BufferedFdReader(BufferedFdReader&& other) { *this = std::move(other); }
+
+  ~BufferedFdReader() { Clear(); }
+
+  BufferedFdReader& operator=(const BufferedFdReader&) = delete;
+  BufferedFdReader& operator=(BufferedFdReader&& other) {
+    if (this != &other) {
+      Clear();
+      std::swap(fd_, other.fd_);
+      std::swap(buffer_, other.buffer_);
+      std::swap(buffer_size_, other.buffer_size_);
+      std::swap(begin_, other.begin_);
+      std::swap(end_, other.end_);
+    }
+    return *this;
+  }
+
+  void Clear() {
+    ::close(fd_);
+    fd_ = -1;
+    begin_ = end_ = 0;
+  }
+
+  int Release() {
+    const int released_fd = fd_;
+    fd_ = -1;
+    begin_ = end_ = 0;
+    return released_fd;
+  }
+
+  Status<void> Ensure(std::size_t) { return {}; }
+
+  Status<void> Read(std::uint8_t* byte) {
+    if (begin_ == end_) {
+      auto status = Fill(nullptr, 0);
+      if (!status)
+        return status.error();
+    }
+
+    *byte = buffer_[begin_++];
+    return {};
+  }
+
+  Status<void> Read(void* begin, void* end) {
+    std::uint8_t* begin_byte = static_cast<std::uint8_t*>(begin);
+    std::uint8_t* end_byte = static_cast<std::uint8_t*>(end);
+
+    std::size_t length_bytes = end_byte - begin_byte;
+    while (length_bytes > 0) {
+      const std::size_t count = std::min(length_bytes, buffered());
+      if (count > 0) {
+        std::memcpy(begin_byte, &buffer_[begin_], count);
+        begin_ += count;
+        begin_byte += count;
+        length_bytes -= count;
+      } else if (length_bytes >= buffer_size_) {
+        // Read directly into the destination, picking up any following data
+        // into the internal buffer with the same call.
+        auto status = Fill(begin_byte, length_bytes);
+        if (!status)
+          return status.error();
+
+        begin_byte += status.get();
+        length_bytes -= status.get();
+      } else {
+        auto status = Fill(nullptr, 0);
+        if (!status)
+          return status.error();
+      }
+    }
+
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    while (padding_bytes > 0) {
+      if (begin_ == end_) {
+        auto status = Fill(nullptr, 0);
+        if (!status)
+          return status.error();
+      }
+
+      const std::size_t count = std::min(padding_bytes, buffered());
+      begin_ += count;
+      padding_bytes -= count;
+    }
+
+    return {};
+  }
+
+  // Returns the number of bytes read from the fd that have not yet been
+  // consumed by the reader.
+  std::size_t buffered() const { return end_ - begin_; }
+  std::size_t buffer_size() const { return buffer_size_; }
+
+ private:
+  // Reads at least one byte from the fd. When |direct| is not null up to
+  // |direct_size| bytes are read into |direct| before the internal buffer,
+  // which must be empty. Returns the number of bytes stored in |direct|.
+  Status<std::size_t> Fill(std::uint8_t* direct, std::size_t direct_size) {
+    iovec vec[2] = {{direct, direct_size}, {buffer_.get(), buffer_size_}};
+    begin_ = end_ = 0;
+
+    while (true) {
+      const ssize_t ret = direct ? ::readv(fd_, vec, 2)
+                                 : ::read(fd_, buffer_.get(), buffer_size_);
+      if (ret > 0) {
+        const std::size_t count = static_cast<std::size_t>(ret);
+        const std::size_t direct_count = std::min(count, direct_size);
+        end_ = count - direct_count;
+        return direct_count;
+      } else if (ret == 0) {
+        return ErrorStatus::ReadLimitReached;
+      } else if (errno != EINTR) {
+        return ErrorStatus::IOError;
+      }
+    }
+  }
+
+  int fd_{-1};
+  std::unique_ptr<std::uint8_t[]> buffer_;
+  std::size_t buffer_size_{0};
+  std::size_t begin_{0};
+  std::size_t end_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_BUFFERED_FD_READER_H_
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_BUFFERED_FD_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_BUFFERED_FD_WRITER_H_
+
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include <nop/status.h>
+
+namespace nop {
+
+// BufferedFdWriter is a writer type that wraps around a UNIX file descriptor
+// and accumulates output in an internal buffer, coalescing the many small
+// writes that make up most encodings into a single call to write().
+//
+// Serializer calls Prepare() with the encoded size of each value before writing
+// it. The writer uses this hint to flush previously buffered data when the next
+// value would not fit, and to grow the internal buffer up to |max_buffer_size|
+// so that a value is usually written with one system call. Writes that do not
+// fit in the buffer are combined with the buffered data using writev().
+//
+// Buffered data is written to the fd when Flush() is called, when the buffer is
+// full, and when the writer is destroyed or the fd is cleared. Because data may
+// remain buffered after Serializer::Write() returns, request/response protocols
+// must call Flush() before waiting for a reply.
+//
+// The writer takes ownerhip of the fd and automatically closes it when
+// destroyed, unless it is released. Releasing the fd flushes buffered data
+// first.
+class BufferedFdWriter {
+ public:
+  enum : std::size_t {
+    kDefaultBufferSize = 4096,
+    kDefaultMaxBufferSize = 1 << 20,
+  };
+
+  BufferedFdWriter() = default;
+  BufferedFdWriter(int fd, std::size_t buffer_size = kDefaultBufferSize,
+                   std::size_t max_buffer_size = kDefaultMaxBufferSize)
+      : fd_{fd},
+        buffer_{new std::uint8_t[buffer_size]},
+        capacity_{buffer_size},
+        max_capacity_{std::max(buffer_size, max_buffer_size)} {}
+  BufferedFdWriter(const BufferedFdWriter&) = delete;
+  BufferedFdWriter(BufferedFdWriter&& other) { *this = std::move(other); }
+
+  ~BufferedFdWriter() { Clear(); }
+
+  BufferedFdWriter& operator=(const BufferedFdWriter&) = delete;
+  BufferedFdWriter& operator=(BufferedFdWriter&& other) {
+    if (this != &other) {
+      Clear();
+      std::swap(fd_, other.fd_);
+      std::swap(buffer_, other.buffer_);
+      std::swap(capacity_, other.capacity_);
+      std::swap(max_capacity_, other.max_capacity_);
+      std::swap(size_, other.size_);
+    }
+    return *this;
+  }
+
+  // Flushes any buffered data and closes the fd.
+  void Clear() {
+    if (fd_ >= 0) {
+      Flush();
+      ::close(fd_);
+    }
+    fd_ = -1;
+    size_ = 0;
+  }
+
+  // Flushes any buffered data and releases ownership of the fd.
+  int Release() {
+    Flush();
+    const int released_fd = fd_;
+    fd_ = -1;
+    size_ = 0;
+    return released_fd;
+  }
+
+  // Writes any buffered data to the fd.
+  Status<void> Flush() {
+    const std::size_t size = size_;
+    size_ = 0;
+    return WriteBytes(buffer_.get(), size, nullptr, 0);
+  }
+
+  Status<void> Prepare(std::size_t size) {
+    if (size <= capacity_ - size_)
+      return {};
+
+    auto status = Flush();
+    if (!status)
+      return status;
+
+    // Grow the buffer to hold the whole value, within the configured limit.
+    if (size > capacity_ && capacity_ < max_capacity_) {
+      capacity_ = std::min(std::max(size, capacity_ * 2), max_capacity_);
+      buffer_.reset(new std::uint8_t[capacity_]);
+    }
+
+    return {};
+  }
+
+  Status<void> Write(std::uint8_t byte) {
+    if (size_ == capacity_)
+      return Write(&byte, &byte + 1);
+
+    buffer_[size_++] = byte;
+    return {};
+  }
+
+  Status<void> Write(const void* begin, const void* end) {
+    const std::uint8_t* begin_byte = static_cast<const std::uint8_t*>(begin);
+    const std::uint8_t* end_byte = static_cast<const std::uint8_t*>(end);
+    const std::size_t length_bytes = end_byte - begin_byte;
+
+    if (length_bytes <= capacity_ - size_) {
+      std::memcpy(&buffer_[size_], begin_byte, length_bytes);
+      size_ += length_bytes;
+      return {};
+    }
+
+    // Write the buffered data and the new data together.
+    const std::size_t size = size_;
+    size_ = 0;
+    return WriteBytes(buffer_.get(), size, begin_byte, length_bytes);
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    while (padding_bytes > 0) {
+      if (size_ == capacity_) {
+        auto status = Flush();
+        if (!status)
+          return status;
+        else if (capacity_ == 0)
+          return ErrorStatus::WriteLimitReached;
+      }
+
+      const std::size_t count = std::min(padding_bytes, capacity_ - size_);
+      std::memset(&buffer_[size_], padding_value, count);
+      size_ += count;
+      padding_bytes -= count;
+    }
+
+    return {};
+  }
+
+  // Returns the number of bytes written that have not been flushed to the fd.
+  std::size_t buffered() const { return size_; }
+  std::size_t capacity() const { return capacity_; }
+
+ private:
+  // Writes |first| followed by |second| to the fd, handling partial writes.
+  Status<void> WriteBytes(const std::uint8_t* first, std::size_t first_size,
+                          const std::uint8_t* second, std::size_t second_size) {
+    iovec vec[2] = {{const_cast<std::uint8_t*>(first), first_size},
+                    {const_cast<std::uint8_t*>(second), second_size}};
+    iovec* current = vec[0].iov_len ? &vec[0] : &vec[1];
+
+    while (current->iov_len > 0) {
+      const int count = current == &vec[0] && vec[1].iov_len ? 2 : 1;
+      const ssize_t ret = ::writev(fd_, current, count);
+      if (ret > 0) {
+        std::size_t written = static_cast<std::size_t>(ret);
+        while (written > 0) {
+          const std::size_t consumed = std::min(written, current->iov_len);
+          current->iov_base = static_cast<std::uint8_t*>(current->iov_base) +
+                              consumed;
+          current->iov_len -= consumed;
+          written -= consumed;
+          if (current->iov_len == 0 && current == &vec[0])
+            current = &vec[1];
+        }
+      } else if (ret == 0) {
+        return ErrorStatus::WriteLimitReached;
+      } else if (errno != EINTR) {
+        return ErrorStatus::IOError;
+      }
+    }
+
+    return {};
+  }
+
+  int fd_{-1};
+  std::unique_ptr<std::uint8_t[]> buffer_;
+  std::size_t capacity_{0};
+  std::size_t max_capacity_{0};
+  std::size_t size_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_BUFFERED_FD_WRITER_H_
@@ -0,0 +1,382 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_C_ABI_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_C_ABI_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include <nop/base/encoding.h>
+#include <nop/base/lazy.h>
+#include <nop/base/skip.h>
+#include <nop/base/validate.h>
+#include <nop/status.h>
+#include <nop/utility/pedantic_buffer_reader.h>
+#include <nop/utility/pedantic_buffer_writer.h>
+
+//
+// C ABI for foreign runtimes, such as Python ctypes or cffi, to read and write
+// encoded values in place instead of marshalling them through C structures.
+//
+// Encoded values are exchanged as views of caller-owned buffers. Reading
+// functions return views of the nested values of a view, located with the
+// schema-less skipping engine, so that a foreign runtime can navigate to the
+// values it needs and decode only those. String and binary payloads are
+// returned as views of their bytes without copying them. Writing functions
+// append encoded values to a caller-owned buffer.
+//
+// NOP_C_ABI(prefix) defines the generic functions, named prefix_<function>:
+//
+//   int prefix_length(NopView value, size_t* length);
+//   int prefix_count(NopView value, size_t* count);
+//   int prefix_element(NopView value, size_t index, NopView* element);
+//   int prefix_read_bytes(NopView value, NopView* bytes);
+//   int prefix_read_<bool|int64|uint64|float|double>(NopView value, T* out);
+//   int prefix_write_<bool|int64|uint64|float|double>(NopBuffer* buffer,
+//                                                     T value);
+//   int prefix_write_string(NopBuffer* buffer, const char* data, size_t size);
+//   int prefix_write_binary(NopBuffer* buffer, const void* data, size_t size);
+//   int prefix_write_array(NopBuffer* buffer, size_t count);
+//   int prefix_write_map(NopBuffer* buffer, size_t count);
+//
+// NOP_C_ABI_STRUCTURE(prefix, type) defines functions for a structure with a
+// member list, which check the encoding against the structure:
+//
+//   size_t prefix_member_count(void);
+//   int prefix_member(NopView value, size_t index, NopView* member);
+//   int prefix_validate(NopView value);
+//   int prefix_write_header(NopBuffer* buffer);
+//
+// The elements of arrays and structures, and the alternating keys and values
+// of maps, are selected by index. The members of a structure are written by
+// writing its header followed by each member in order, and arrays and maps
+// likewise with the number of elements or pairs that follow. Integer reads
+// accept any encoding of the given signedness that fits.
+//
+// Every int function returns zero on success or a negative ErrorStatus, and
+// leaves its outputs unchanged on failure. Input is not trusted: every read is
+// bounds checked against the view, and every write against the capacity of the
+// buffer.
+//
+// Example of exporting a structure from a shared library:
+//
+//   NOP_C_ABI(nop);
+//   NOP_C_ABI_STRUCTURE(triangle, Triangle);
+//
+// and reading the first vertex of the second triangle of an encoded array of
+// triangles in Python:
+//
+//   triangles = NopView(cast(buffer, c_void_p), size)
+//   triangle, vertex = NopView(), NopView()
+//   library.nop_element(triangles, 1, byref(triangle))
+//   library.triangle_member(triangle, 0, byref(vertex))
+//
+
+extern "C" {
+
+// A view of encoded bytes in a buffer owned by the caller. Views produced by
+// the C ABI functions point into the buffer of the view they were derived
+// from.
+struct NopView {
+  const void* data;
+  size_t size;
+};
+
+// A buffer owned by the caller that encoded values are appended to. |size| is
+// the number of bytes written so far.
+struct NopBuffer {
+  void* data;
+  size_t capacity;
+  size_t size;
+};
+
+}  // extern "C"
+
+namespace nop {
+
+// Implementation details of the C ABI functions.
+struct CAbi {
+  static int Result(const Status<void>& status) {
+    if (status)
+      return 0;
+    else
+      return -static_cast<int>(status.error());
+  }
+
+  static PedanticBufferReader ReaderFor(NopView value) {
+    return {value.data, value.size};
+  }
+
+  // Stores the view of the next value in |reader|, which reads |value|, in
+  // |next|.
+  static Status<void> NextValue(NopView value, PedanticBufferReader* reader,
+                                NopView* next) {
+    const std::size_t offset = value.size - reader->remaining();
+    auto status = SkipValue(reader);
+    if (!status)
+      return status;
+
+    *next = {static_cast<const std::uint8_t*>(value.data) + offset,
+             value.size - reader->remaining() - offset};
+    return {};
+  }
+
+  // Reads the number of values nested in a container of values.
+  static Status<void> ReadCount(PedanticBufferReader* reader,
+                                SizeType* count) {
+    std::uint8_t prefix_byte = 0;
+    auto status = reader->Read(&prefix_byte);
+    if (!status)
+      return status;
+
+    const auto prefix = static_cast<EncodingByte>(prefix_byte);
+    if (prefix != EncodingByte::Array && prefix != EncodingByte::Structure &&
+        prefix != EncodingByte::Map) {
+      return ErrorStatus::UnexpectedEncodingType;
+    }
+
+    status = Encoding<SizeType>::Read(count, reader);
+    if (!status)
+      return status;
+    else if (prefix == EncodingByte::Map &&
+             *count > std::numeric_limits<SizeType>::max() / 2)
+      return ErrorStatus::InvalidContainerLength;
+    else if (prefix == EncodingByte::Map)
+      *count *= 2;
+
+    return {};
+  }
+
+  static Status<void> Length(NopView value, size_t* length) {
+    auto status = EncodedLength(value.data, value.size);
+    if (!status)
+      return status.error();
+
+    *length = status.get();
+    return {};
+  }
+
+  static Status<void> Count(NopView value, size_t* count) {
+    auto reader = ReaderFor(value);
+    SizeType element_count = 0;
+    auto status = ReadCount(&reader, &element_count);
+    if (!status)
+      return status;
+    else if (element_count > std::numeric_limits<size_t>::max())
+      return ErrorStatus::InvalidContainerLength;
+
+    *count = static_cast<size_t>(element_count);
+    return {};
+  }
+
+  static Status<void> Element(NopView value, size_t index, NopView* element) {
+    auto reader = ReaderFor(value);
+    SizeType count = 0;
+    auto status = ReadCount(&reader, &count);
+    if (!status)
+      return status;
+    else if (index >= count)
+      return ErrorStatus::InvalidContainerLength;
+
+    for (size_t i = 0; i < index; i++) {
+      status = SkipValue(&reader);
+      if (!status)
+        return status;
+    }
+
+    return NextValue(value, &reader, element);
+  }
+
+  template <typename T>
+  static Status<void> Member(NopView value, size_t index, NopView* member) {
+    auto reader = ReaderFor(value);
+    auto status = SeekMember<T>(index, &reader);
+    if (!status)
+      return status;
+
+    return NextValue(value, &reader, member);
+  }
+
+  // Returns a view of the payload of a string or binary container.
+  static Status<void> ReadBytes(NopView value, NopView* bytes) {
+    auto reader = ReaderFor(value);
+    std::uint8_t prefix_byte = 0;
+    auto status = reader.Read(&prefix_byte);
+    if (!status)
+      return status;
+
+    const auto prefix = static_cast<EncodingByte>(prefix_byte);
+    if (prefix != EncodingByte::String && prefix != EncodingByte::Binary)
+      return ErrorStatus::UnexpectedEncodingType;
+
+    SizeType size = 0;
+    status = Encoding<SizeType>::Read(&size, &reader);
+    if (!status)
+      return status;
+    else if (size > reader.remaining())
+      return ErrorStatus::ReadLimitReached;
+
+    auto data = reader.Borrow(static_cast<std::size_t>(size));
+    if (!data)
+      return data.error();
+
+    *bytes = {data.get(), static_cast<size_t>(size)};
+    return {};
+  }
+
+  template <typename T>
+  static Status<void> Read(NopView value, T* out) {
+    auto reader = ReaderFor(value);
+    T result;
+    auto status = Encoding<T>::Read(&result, &reader);
+    if (!status)
+      return status;
+
+    *out = result;
+    return {};
+  }
+
+  template <typename T>
+  static Status<void> Validate(NopView value) {
+    auto reader = ReaderFor(value);
+    return nop::Validate<T>(&reader);
+  }
+
+  // Calls |function| with a writer for the unused part of |buffer| and counts
+  // the bytes it writes if it succeeds.
+  template <typename Function>
+  static Status<void> Append(NopBuffer* buffer, Function&& function) {
+    if (buffer->size > buffer->capacity)
+      return ErrorStatus::WriteLimitReached;
+
+    PedanticBufferWriter writer{
+        static_cast<std::uint8_t*>(buffer->data) + buffer->size,
+        buffer->capacity - buffer->size};
+    auto status = function(&writer);
+    if (!status)
+      return status;
+
+    buffer->size += writer.size();
+    return {};
+  }
+
+  template <typename T>
+  static Status<void> Write(NopBuffer* buffer, const T& value) {
+    return Append(buffer, [&value](PedanticBufferWriter* writer) {
+      return Encoding<T>::Write(value, writer);
+    });
+  }
+
+  // Writes a container prefix and the number of values or bytes that follow,
+  // followed by |size| bytes from |data|, if any.
+  static Status<void> WriteContainer(NopBuffer* buffer, EncodingByte prefix,
+                                     size_t count, const void* data = nullptr,
+                                     size_t size = 0) {
+    return Append(buffer, [&](PedanticBufferWriter* writer) {
+      auto status = writer->Write(static_cast<std::uint8_t>(prefix));
+      if (!status)
+        return status;
+
+      status = Encoding<SizeType>::Write(static_cast<SizeType>(count), writer);
+      if (!status || size == 0)
+        return status;
+
+      const auto* begin = static_cast<const std::uint8_t*>(data);
+      return writer->Write(begin, begin + size);
+    });
+  }
+};
+
+}  // namespace nop
+
+// Defines the read and write functions for a scalar type.
+#define NOP_C_ABI_SCALAR(prefix, name, type)                          \
+  extern "C" int prefix##_read_##name(NopView value, type* out) {     \
+    return ::nop::CAbi::Result(::nop::CAbi::Read(value, out));        \
+  }                                                                   \
+  extern "C" int prefix##_write_##name(NopBuffer* buffer, type value) { \
+    return ::nop::CAbi::Result(::nop::CAbi::Write(buffer, value));    \
+  }
+
+// Defines the generic C ABI functions with the given name prefix. This macro
+// must be used once at namespace scope in a translation unit of the library
+// that exports the functions.
+#define NOP_C_ABI(prefix)                                                    \
+  extern "C" int prefix##_length(NopView value, size_t* length) {           \
+    return ::nop::CAbi::Result(::nop::CAbi::Length(value, length));         \
+  }                                                                          \
+  extern "C" int prefix##_count(NopView value, size_t* count) {             \
+    return ::nop::CAbi::Result(::nop::CAbi::Count(value, count));           \
+  }                                                                          \
+  extern "C" int prefix##_element(NopView value, size_t index,              \
+                                  NopView* element) {                        \
+    return ::nop::CAbi::Result(::nop::CAbi::Element(value, index, element)); \
+  }                                                                          \
+  extern "C" int prefix##_read_bytes(NopView value, NopView* bytes) {       \
+    return ::nop::CAbi::Result(::nop::CAbi::ReadBytes(value, bytes));       \
+  }                                                                          \
+  NOP_C_ABI_SCALAR(prefix, bool, bool)                                       \
+  NOP_C_ABI_SCALAR(prefix, int64, int64_t)                                   \
+  NOP_C_ABI_SCALAR(prefix, uint64, uint64_t)                                 \
+  NOP_C_ABI_SCALAR(prefix, float, float)                                     \
+  NOP_C_ABI_SCALAR(prefix, double, double)                                   \
+  extern "C" int prefix##_write_string(NopBuffer* buffer, const char* data, \
+                                       size_t size) {                        \
+    return ::nop::CAbi::Result(::nop::CAbi::WriteContainer(                  \
+        buffer, ::nop::EncodingByte::String, size, data, size));             \
+  }                                                                          \
+  extern "C" int prefix##_write_binary(NopBuffer* buffer, const void* data, \
+                                       size_t size) {                        \
+    return ::nop::CAbi::Result(::nop::CAbi::WriteContainer(                  \
+        buffer, ::nop::EncodingByte::Binary, size, data, size));             \
+  }                                                                          \
+  extern "C" int prefix##_write_array(NopBuffer* buffer, size_t count) {    \
+    return ::nop::CAbi::Result(::nop::CAbi::WriteContainer(                  \
+        buffer, ::nop::EncodingByte::Array, count));                         \
+  }                                                                          \
+  extern "C" int prefix##_write_map(NopBuffer* buffer, size_t count) {      \
+    return ::nop::CAbi::Result(::nop::CAbi::WriteContainer(                  \
+        buffer, ::nop::EncodingByte::Map, count));                           \
+  }                                                                          \
+  static_assert(true, "")
+
+// Defines the C ABI functions of structure |type| with the given name prefix.
+// The structure must have a member list, as defined by NOP_STRUCTURE.
+#define NOP_C_ABI_STRUCTURE(prefix, type)                                     \
+  extern "C" size_t prefix##_member_count(void) {                            \
+    return ::nop::MemberListTraits<type>::MemberList::Count;                  \
+  }                                                                           \
+  extern "C" int prefix##_member(NopView value, size_t index,                \
+                                 NopView* member) {                           \
+    return ::nop::CAbi::Result(                                               \
+        ::nop::CAbi::Member<type>(value, index, member));                     \
+  }                                                                           \
+  extern "C" int prefix##_validate(NopView value) {                          \
+    return ::nop::CAbi::Result(::nop::CAbi::Validate<type>(value));           \
+  }                                                                           \
+  extern "C" int prefix##_write_header(NopBuffer* buffer) {                  \
+    return ::nop::CAbi::Result(::nop::CAbi::WriteContainer(                   \
+        buffer, ::nop::EncodingByte::Structure,                               \
+        ::nop::MemberListTraits<type>::MemberList::Count));                   \
+  }                                                                           \
+  static_assert(true, "")
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_C_ABI_H_
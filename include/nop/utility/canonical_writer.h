@@ -0,0 +1,92 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_CANONICAL_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_CANONICAL_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <nop/base/canonical.h>
+#include <nop/base/encoding.h>
+#include <nop/base/handle.h>
+#include <nop/base/utility.h>
+
+namespace nop {
+
+// CanonicalWriter is a writer type that wraps another writer pointer and
+// selects the canonical encoding described in nop/base/canonical.h, so that
+// equal values always produce identical bytes, regardless of the iteration
+// order of unordered containers. The output suits hashing, for example as the
+// key of a content-addressed cache, and reads as usual.
+//
+// Only the basic writer operations are passed through. In particular, table
+// entries are always written with their exact sizes rather than patched in
+// place, even when the underlying writer supports Patch(), and strings and
+// shared objects are not interned, so that the bytes do not depend on the
+// underlying writer.
+//
+// Example:
+//
+//   nop::VectorWriter vector_writer;
+//   nop::CanonicalWriter<nop::VectorWriter> canonical_writer{&vector_writer};
+//   nop::Serializer<decltype(canonical_writer)*> serializer{&canonical_writer};
+//   serializer.Write(request);
+//   const std::uint64_t key = nop::SipHash::Compute(
+//       nop::BlockReader<std::uint8_t>{vector_writer.data(),
+//                                      vector_writer.size()},
+//       k0, k1);
+//
+template <typename Writer>
+class CanonicalWriter {
+ public:
+  using Canonical = void;
+
+  CanonicalWriter() = default;
+  CanonicalWriter(const CanonicalWriter&) = default;
+  CanonicalWriter(Writer* writer) : writer_{writer} {}
+
+  CanonicalWriter& operator=(const CanonicalWriter&) = default;
+
+  Status<void> Prepare(std::size_t size) { return writer_->Prepare(size); }
+
+  Status<void> Write(std::uint8_t byte) { return writer_->Write(byte); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    return writer_->Write(begin, end);
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    return writer_->Skip(padding_bytes, padding_value);
+  }
+
+  template <typename HandleType>
+  Status<HandleReference> PushHandle(const HandleType& handle) {
+    return writer_->PushHandle(handle);
+  }
+
+  Writer* writer() const { return writer_; }
+
+ private:
+  Writer* writer_{nullptr};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_CANONICAL_WRITER_H_
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_CHECKSUM_READER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_CHECKSUM_READER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <nop/base/encoding.h>
+#include <nop/base/handle.h>
+#include <nop/base/utility.h>
+#include <nop/utility/crc32c.h>
+
+namespace nop {
+
+// ChecksumReader is a reader type that wraps another reader pointer and
+// computes a checksum of the bytes read as they pass through. Once a message is
+// read, VerifyDigest() reads the digest appended by ChecksumWriter and compares
+// it with the checksum of the message, then starts a new checksum for the next
+// message. Skipped bytes are read through a small buffer so that they are
+// included in the checksum.
+//
+// Example:
+//
+//   nop::ChecksumReader<nop::StreamReader<std::ifstream>> checksum_reader{
+//       &stream_reader};
+//   nop::Deserializer<decltype(checksum_reader)*> deserializer{
+//       &checksum_reader};
+//   auto status = deserializer.Read(&message);
+//   if (status)
+//     status = checksum_reader.VerifyDigest();
+//
+template <typename Reader, typename Checksum = Crc32cChecksum>
+class ChecksumReader {
+ public:
+  using DigestType = typename Checksum::ValueType;
+
+  ChecksumReader() = default;
+  ChecksumReader(const ChecksumReader&) = default;
+  ChecksumReader(Reader* reader) : reader_{reader} {}
+
+  ChecksumReader& operator=(const ChecksumReader&) = default;
+
+  Status<void> Ensure(std::size_t size) { return reader_->Ensure(size); }
+
+  Status<void> Read(std::uint8_t* byte) {
+    auto status = reader_->Read(byte);
+    if (!status)
+      return status;
+
+    checksum_.Update(byte, 1);
+    return {};
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Read(T* begin, T* end) {
+    auto status = reader_->Read(begin, end);
+    if (!status)
+      return status;
+
+    checksum_.Update(begin, (end - begin) * sizeof(T));
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    std::uint8_t padding[64];
+    while (padding_bytes > 0) {
+      const std::size_t count = std::min(padding_bytes, sizeof(padding));
+      auto status = Read(padding, padding + count);
+      if (!status)
+        return status;
+
+      padding_bytes -= count;
+    }
+    return {};
+  }
+
+  // Borrows |size| bytes from the underlying reader, which must support this
+  // operation.
+  template <typename R = Reader,
+            typename = decltype(std::declval<R&>().Borrow(std::size_t{}))>
+  Status<const std::uint8_t*> Borrow(std::size_t size) {
+    auto status = reader_->Borrow(size);
+    if (!status)
+      return status;
+
+    checksum_.Update(status.get(), size);
+    return status;
+  }
+
+  // Returns the number of bytes remaining in the underlying reader. Only
+  // available when the underlying reader supports this operation.
+  template <typename R = Reader,
+            typename = decltype(std::declval<const R&>().remaining())>
+  std::size_t remaining() const {
+    return reader_->remaining();
+  }
+
+  template <typename HandleType>
+  Status<HandleType> GetHandle(HandleReference handle_reference) {
+    return reader_->template GetHandle<HandleType>(handle_reference);
+  }
+
+  // Reads the digest written by ChecksumWriter and compares it with the
+  // checksum of the bytes read since the last digest or reset, then starts a
+  // new checksum. Returns ErrorStatus::ProtocolError if they differ.
+  Status<void> VerifyDigest() {
+    DigestType digest;
+    auto status = reader_->Ensure(sizeof(digest));
+    if (!status)
+      return status;
+
+    status = reader_->Read(&digest, &digest + 1);
+    if (!status)
+      return status;
+
+    const DigestType expected = checksum_.value();
+    checksum_.Reset();
+    if (digest != expected)
+      return ErrorStatus::ProtocolError;
+    else
+      return {};
+  }
+
+  // Returns the checksum of the bytes read since the last digest or reset.
+  DigestType digest() const { return checksum_.value(); }
+  void Reset() { checksum_.Reset(); }
+
+  Reader* reader() const { return reader_; }
+
+ private:
+  Reader* reader_{nullptr};
+  Checksum checksum_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_CHECKSUM_READER_H_
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_CHECKSUM_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_CHECKSUM_WRITER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <nop/base/encoding.h>
+#include <nop/base/handle.h>
+#include <nop/base/utility.h>
+#include <nop/utility/crc32c.h>
+
+namespace nop {
+
+// ChecksumWriter is a writer type that wraps another writer pointer and
+// computes a checksum of the bytes written as they pass through, so that
+// integrity checking does not need a second pass over the output. Once a
+// message is written, WriteDigest() appends the checksum to the output and
+// starts a new checksum for the next message. ChecksumReader verifies the
+// digest when reading.
+//
+// The writer does not support patching previously written data, which would
+// invalidate the checksum, so tables are written with their sizes computed in
+// advance.
+//
+// Example:
+//
+//   nop::ChecksumWriter<nop::StreamWriter<std::ofstream>> checksum_writer{
+//       &stream_writer};
+//   nop::Serializer<decltype(checksum_writer)*> serializer{&checksum_writer};
+//   serializer.Write(message);
+//   checksum_writer.WriteDigest();
+//
+template <typename Writer, typename Checksum = Crc32cChecksum>
+class ChecksumWriter {
+ public:
+  using DigestType = typename Checksum::ValueType;
+
+  ChecksumWriter() = default;
+  ChecksumWriter(const ChecksumWriter&) = default;
+  ChecksumWriter(Writer* writer) : writer_{writer} {}
+
+  ChecksumWriter& operator=(const ChecksumWriter&) = default;
+
+  Status<void> Prepare(std::size_t size) { return writer_->Prepare(size); }
+
+  Status<void> Write(std::uint8_t byte) {
+    auto status = writer_->Write(byte);
+    if (!status)
+      return status;
+
+    checksum_.Update(&byte, 1);
+    return {};
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    auto status = writer_->Write(begin, end);
+    if (!status)
+      return status;
+
+    checksum_.Update(begin, (end - begin) * sizeof(T));
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    auto status = writer_->Skip(padding_bytes, padding_value);
+    if (!status)
+      return status;
+
+    std::uint8_t padding[64];
+    std::memset(padding, padding_value, sizeof(padding));
+    while (padding_bytes > 0) {
+      const std::size_t count = std::min(padding_bytes, sizeof(padding));
+      checksum_.Update(padding, count);
+      padding_bytes -= count;
+    }
+    return {};
+  }
+
+  template <typename HandleType>
+  Status<HandleReference> PushHandle(const HandleType& handle) {
+    return writer_->PushHandle(handle);
+  }
+
+  // Writes the digest of the bytes written since the last digest or reset,
+  // and starts a new checksum. The digest is written as a fixed-size value in
+  // host byte order and is not itself included in the next checksum.
+  Status<void> WriteDigest() {
+    const DigestType digest = checksum_.value();
+    auto status = writer_->Prepare(sizeof(digest));
+    if (!status)
+      return status;
+
+    status = writer_->Write(&digest, &digest + 1);
+    if (!status)
+      return status;
+
+    checksum_.Reset();
+    return {};
+  }
+
+  // Returns the checksum of the bytes written since the last digest or reset.
+  DigestType digest() const { return checksum_.value(); }
+  void Reset() { checksum_.Reset(); }
+
+  Writer* writer() const { return writer_; }
+
+ private:
+  Writer* writer_{nullptr};
+  Checksum checksum_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_CHECKSUM_WRITER_H_
@@ -34,4 +34,29 @@
 #define NOP_FALLTHROUGH
 #endif
 
+// Branch prediction hints. Error checks along the encoding paths are marked
+// unlikely so that compilers move the error returns out of line, keeping the
+// instructions of the success path together.
+#if defined(__GNUC__) || defined(__clang__)
+#define NOP_LIKELY(condition) __builtin_expect(!!(condition), 1)
+#define NOP_UNLIKELY(condition) __builtin_expect(!!(condition), 0)
+#else
+#define NOP_LIKELY(condition) (!!(condition))
+#define NOP_UNLIKELY(condition) (!!(condition))
+#endif
+
+// Keeps a function out of line and, with NOP_COLD, optimizes it for size and
+// places it away from frequently executed code.
+#if __has_cpp_attribute(gnu::noinline)
+#define NOP_NOINLINE [[gnu::noinline]]
+#else
+#define NOP_NOINLINE
+#endif
+
+#if __has_cpp_attribute(gnu::cold)
+#define NOP_COLD [[gnu::cold]]
+#else
+#define NOP_COLD
+#endif
+
 #endif  // LIBNOP_INCLUDE_NOP_UTILITY_COMPILER_H_
@@ -0,0 +1,197 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_COMPRESSING_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_COMPRESSING_WRITER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <nop/base/encoding.h>
+#include <nop/base/handle.h>
+#include <nop/base/utility.h>
+#include <nop/utility/compression_codec.h>
+
+namespace nop {
+
+// CompressingWriter is a writer type that wraps another writer pointer and
+// compresses the output in blocks as it is produced, so that a large message
+// is never held uncompressed in memory in full. Each block is written to the
+// underlying writer with a small header:
+//
+// +--------------+-----------------+-------------------+
+// | U32:RAW_SIZE | U32:STORED_SIZE | STORED_SIZE BYTES |
+// +--------------+-----------------+-------------------+
+//
+// Blocks that do not compress are stored as is, with STORED_SIZE equal to
+// RAW_SIZE. The header fields are in host byte order. DecompressingReader
+// reads the blocks back.
+//
+// The Prepare() hint with the size of each value chooses how it is blocked: a
+// value that does not fit in the rest of the current block but fits in a block
+// of its own starts a new block, unless the current block is less than a
+// quarter full, so that small messages are not needlessly split across
+// blocks. Large writes are compressed straight from their source in full
+// blocks rather than copied through the block buffer.
+//
+// Data is buffered until a block fills up. Flush() compresses and writes the
+// partial block, which happens automatically when the writer is destroyed.
+//
+// Example:
+//
+//   nop::CompressingWriter<nop::FdWriter> compressing_writer{&fd_writer};
+//   nop::Serializer<decltype(compressing_writer)*> serializer{
+//       &compressing_writer};
+//   serializer.Write(snapshot);
+//   compressing_writer.Flush();
+//
+template <typename Writer, typename Codec = Lz4Codec>
+class CompressingWriter {
+ public:
+  enum : std::size_t { kDefaultBlockSize = 64 * 1024 };
+
+  CompressingWriter(Writer* writer, std::size_t block_size = kDefaultBlockSize)
+      : writer_{writer},
+        block_size_{std::max<std::size_t>(block_size, 1)},
+        block_{new std::uint8_t[block_size_]},
+        compressed_{new std::uint8_t[Codec::Bound(block_size_)]} {}
+
+  CompressingWriter(const CompressingWriter&) = delete;
+  void operator=(const CompressingWriter&) = delete;
+
+  ~CompressingWriter() { Flush(); }
+
+  Status<void> Prepare(std::size_t size) {
+    if (size > block_size_ - size_ && size <= block_size_ &&
+        size_ >= block_size_ / 4) {
+      return Flush();
+    }
+    return {};
+  }
+
+  Status<void> Write(std::uint8_t byte) {
+    if (size_ == block_size_)
+      return Write(&byte, &byte + 1);
+
+    block_[size_++] = byte;
+    return {};
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    const std::uint8_t* source = reinterpret_cast<const std::uint8_t*>(begin);
+    std::size_t length_bytes = (end - begin) * sizeof(T);
+
+    while (length_bytes > 0) {
+      if (size_ == 0 && length_bytes >= block_size_) {
+        auto status = WriteBlock(source, block_size_);
+        if (!status)
+          return status;
+
+        source += block_size_;
+        length_bytes -= block_size_;
+        continue;
+      }
+
+      const std::size_t count = std::min(length_bytes, block_size_ - size_);
+      std::memcpy(&block_[size_], source, count);
+      size_ += count;
+      source += count;
+      length_bytes -= count;
+
+      if (size_ == block_size_) {
+        auto status = Flush();
+        if (!status)
+          return status;
+      }
+    }
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    while (padding_bytes > 0) {
+      const std::size_t count = std::min(padding_bytes, block_size_ - size_);
+      std::memset(&block_[size_], padding_value, count);
+      size_ += count;
+      padding_bytes -= count;
+
+      if (size_ == block_size_) {
+        auto status = Flush();
+        if (!status)
+          return status;
+      }
+    }
+    return {};
+  }
+
+  template <typename HandleType>
+  Status<HandleReference> PushHandle(const HandleType& handle) {
+    return writer_->PushHandle(handle);
+  }
+
+  // Compresses and writes the partial block, if any.
+  Status<void> Flush() {
+    if (size_ == 0)
+      return {};
+
+    const std::size_t size = size_;
+    size_ = 0;
+    return WriteBlock(block_.get(), size);
+  }
+
+  // Returns the number of bytes buffered in the current block.
+  std::size_t buffered() const { return size_; }
+  std::size_t block_size() const { return block_size_; }
+
+  Writer* writer() const { return writer_; }
+
+ private:
+  // Compresses |size| bytes from |source| and writes them as a block.
+  Status<void> WriteBlock(const std::uint8_t* source, std::size_t size) {
+    std::size_t stored_size = Codec::Compress(source, size, compressed_.get());
+    const std::uint8_t* stored = compressed_.get();
+    if (stored_size >= size) {
+      stored = source;
+      stored_size = size;
+    }
+
+    const std::uint32_t header[2] = {static_cast<std::uint32_t>(size),
+                                     static_cast<std::uint32_t>(stored_size)};
+    auto status = writer_->Prepare(sizeof(header) + stored_size);
+    if (!status)
+      return status;
+
+    status = writer_->Write(&header[0], &header[2]);
+    if (!status)
+      return status;
+
+    return writer_->Write(stored, stored + stored_size);
+  }
+
+  Writer* writer_;
+  std::size_t block_size_;
+  std::unique_ptr<std::uint8_t[]> block_;
+  std::unique_ptr<std::uint8_t[]> compressed_;
+  std::size_t size_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_COMPRESSING_WRITER_H_
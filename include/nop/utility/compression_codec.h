@@ -0,0 +1,249 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_COMPRESSION_CODEC_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_COMPRESSION_CODEC_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Block compression codecs for CompressingWriter and DecompressingReader.
+//
+// A codec is a type with three static methods:
+//
+//   // Returns the largest compressed size of |size| bytes of input.
+//   static std::size_t Bound(std::size_t size);
+//
+//   // Compresses |size| bytes from |source| into |target|, which holds at
+//   // least Bound(size) bytes, and returns the compressed size.
+//   static std::size_t Compress(const std::uint8_t* source, std::size_t size,
+//                               std::uint8_t* target);
+//
+//   // Decompresses |size| bytes from |source| into exactly |target_size|
+//   // bytes at |target|. Returns false if the input is malformed.
+//   static bool Decompress(const std::uint8_t* source, std::size_t size,
+//                          std::uint8_t* target, std::size_t target_size);
+//
+// Adapting an external library, such as zstd or the reference LZ4
+// implementation, takes a few lines wrapping its block functions.
+
+namespace nop {
+
+// Codec that stores blocks without compressing them, for incompressible data
+// or when the CPU is the bottleneck rather than the link.
+struct StoredCodec {
+  static std::size_t Bound(std::size_t size) { return size; }
+
+  static std::size_t Compress(const std::uint8_t* source, std::size_t size,
+                              std::uint8_t* target) {
+    std::memcpy(target, source, size);
+    return size;
+  }
+
+  static bool Decompress(const std::uint8_t* source, std::size_t size,
+                         std::uint8_t* target, std::size_t target_size) {
+    if (size != target_size)
+      return false;
+
+    std::memcpy(target, source, size);
+    return true;
+  }
+};
+
+// Self-contained codec producing the LZ4 block format, interoperable with the
+// reference implementation's LZ4_decompress_safe() and LZ4_compress_default().
+// Compression is a single greedy pass with a small hash table of recent
+// positions, trading ratio for speed like LZ4's fast mode. Decompression
+// checks every length and offset against the bounds of its input and output.
+struct Lz4Codec {
+  static std::size_t Bound(std::size_t size) { return size + size / 255 + 16; }
+
+  static std::size_t Compress(const std::uint8_t* source, std::size_t size,
+                              std::uint8_t* target) {
+    std::uint32_t table[1 << kHashBits] = {};
+    const std::uint8_t* const end = source + size;
+    const std::uint8_t* anchor = source;
+    std::uint8_t* output = target;
+
+    // The format requires the last match to start at least kMatchLimit bytes
+    // before the end of the input and to end kLastLiterals bytes before it.
+    if (size > kMatchLimit) {
+      const std::uint8_t* const match_start_limit = end - kMatchLimit;
+      const std::uint8_t* const match_end_limit = end - kLastLiterals;
+      const std::uint8_t* input = source + 1;
+
+      while (input < match_start_limit) {
+        const std::uint32_t sequence = Load32(input);
+        std::uint32_t& entry = table[Hash(sequence)];
+        const std::uint8_t* match = source + entry;
+        entry = static_cast<std::uint32_t>(input - source);
+
+        if (match >= input ||
+            static_cast<std::size_t>(input - match) > kMaxOffset ||
+            Load32(match) != sequence) {
+          input++;
+          continue;
+        }
+
+        const std::uint8_t* match_end = input + kMinMatch;
+        const std::uint8_t* reference = match + kMinMatch;
+        while (match_end < match_end_limit && *match_end == *reference) {
+          match_end++;
+          reference++;
+        }
+        while (input > anchor && match > source && input[-1] == match[-1]) {
+          input--;
+          match--;
+        }
+
+        output = WriteLiterals(output, anchor, input - anchor,
+                               match_end - input - kMinMatch);
+        const std::size_t offset = input - match;
+        *output++ = static_cast<std::uint8_t>(offset);
+        *output++ = static_cast<std::uint8_t>(offset >> 8);
+        output = WriteLength(output, match_end - input - kMinMatch);
+
+        input = match_end;
+        anchor = match_end;
+      }
+    }
+
+    output = WriteLiterals(output, anchor, end - anchor, 0);
+    return output - target;
+  }
+
+  static bool Decompress(const std::uint8_t* source, std::size_t size,
+                         std::uint8_t* target, std::size_t target_size) {
+    const std::uint8_t* input = source;
+    const std::uint8_t* const input_end = source + size;
+    std::uint8_t* output = target;
+    std::uint8_t* const output_end = target + target_size;
+
+    while (input < input_end) {
+      const std::uint8_t token = *input++;
+
+      std::size_t literals = token >> 4;
+      if (!ReadLength(&input, input_end, &literals) ||
+          literals > static_cast<std::size_t>(input_end - input) ||
+          literals > static_cast<std::size_t>(output_end - output)) {
+        return false;
+      }
+      if (literals > 0)
+        std::memcpy(output, input, literals);
+      input += literals;
+      output += literals;
+
+      // The last sequence has only literals.
+      if (input == input_end)
+        break;
+      else if (input_end - input < 2)
+        return false;
+
+      const std::size_t offset = input[0] | (std::size_t{input[1]} << 8);
+      input += 2;
+      if (offset == 0 || offset > static_cast<std::size_t>(output - target))
+        return false;
+
+      std::size_t length = token & 0xf;
+      if (!ReadLength(&input, input_end, &length))
+        return false;
+      length += kMinMatch;
+      if (length > static_cast<std::size_t>(output_end - output))
+        return false;
+
+      // Matches may overlap their own output to repeat short patterns.
+      const std::uint8_t* match = output - offset;
+      if (offset >= length) {
+        std::memcpy(output, match, length);
+        output += length;
+      } else {
+        while (length-- > 0)
+          *output++ = *match++;
+      }
+    }
+
+    return output == output_end;
+  }
+
+ private:
+  enum : std::size_t {
+    kHashBits = 12,
+    kMinMatch = 4,
+    kLastLiterals = 5,
+    kMatchLimit = 12,
+    kMaxOffset = 65535,
+  };
+
+  static std::uint32_t Load32(const std::uint8_t* data) {
+    std::uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+
+  static std::uint32_t Hash(std::uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - kHashBits);
+  }
+
+  // Writes the extension bytes of a length that does not fit in its token.
+  static std::uint8_t* WriteLength(std::uint8_t* output, std::size_t length) {
+    if (length < 15)
+      return output;
+
+    length -= 15;
+    while (length >= 255) {
+      *output++ = 255;
+      length -= 255;
+    }
+    *output++ = static_cast<std::uint8_t>(length);
+    return output;
+  }
+
+  // Writes the token of a sequence with |match_length| and its literals.
+  static std::uint8_t* WriteLiterals(std::uint8_t* output,
+                                     const std::uint8_t* literals,
+                                     std::size_t count,
+                                     std::size_t match_length) {
+    *output++ = static_cast<std::uint8_t>(
+        (std::min<std::size_t>(count, 15) << 4) |
+        std::min<std::size_t>(match_length, 15));
+    output = WriteLength(output, count);
+    if (count > 0)
+      std::memcpy(output, literals, count);
+    return output + count;
+  }
+
+  // Adds the extension bytes following a token to |length|, if any.
+  static bool ReadLength(const std::uint8_t** input,
+                         const std::uint8_t* input_end, std::size_t* length) {
+    if (*length != 15)
+      return true;
+
+    std::uint8_t byte;
+    do {
+      if (*input == input_end)
+        return false;
+      byte = *(*input)++;
+      *length += byte;
+    } while (byte == 255);
+    return true;
+  }
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_COMPRESSION_CODEC_H_
@@ -0,0 +1,304 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_CONCURRENT_APPEND_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_CONCURRENT_APPEND_WRITER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <nop/base/utility.h>
+#include <nop/status.h>
+
+namespace nop {
+
+//
+// Lock-free appends to a shared output region.
+//
+// ConcurrentAppendRegion divides a region of memory, such as a shared mapping
+// of a log file, into records that any number of threads append to at once.
+// Each thread serializes through its own ConcurrentAppendWriter: the Prepare()
+// call that Serializer makes with the encoded size of a value claims a record
+// with a single fetch_add on the shared tail, and the value is then encoded
+// into that private record without further synchronization. Throughput scales
+// with the number of writers instead of being limited by a lock around a
+// single writer.
+//
+// Each record starts with an 8 byte header holding its reserved length and
+// its state, and is padded to a multiple of 8 bytes:
+//
+// +-------------+-----------------+------------+-----------+
+// | U32:LENGTH  | U32:SIZE        | DATA...    | PADDING   |
+// +-------------+-----------------+------------+-----------+
+//
+// SIZE is kPending while the record is being written and the number of bytes
+// of data once it is committed, which is less than LENGTH when the size passed
+// to Prepare() was an overestimate. Readers skip records that are still
+// pending, so a slow or failed writer never exposes a partial value. The
+// region starts with a cache line holding the tail, so memory that is all
+// zeros, such as a new mapping, is an empty region.
+//
+// Example:
+//
+//   nop::ConcurrentAppendRegion region{mapping, mapping_size};
+//
+//   // On each thread:
+//   nop::Serializer<nop::ConcurrentAppendWriter> serializer{&region};
+//   auto status = serializer.Write(record);
+//
+//   // Reading:
+//   std::size_t offset = 0;
+//   const std::uint8_t* data;
+//   std::size_t size;
+//   while (region.NextRecord(&offset, &data, &size)) {
+//     nop::Deserializer<nop::BufferReader> deserializer{data, size};
+//     deserializer.Read(&record);
+//   }
+//
+class ConcurrentAppendRegion {
+ public:
+  enum : std::size_t { kHeaderSize = 64, kRecordHeaderSize = 8 };
+  enum : std::uint32_t { kPending = 0xffffffff };
+
+  ConcurrentAppendRegion() = default;
+
+  // Uses the |size| bytes at |data|, which must be aligned to 8 bytes. The
+  // region continues after any records already appended to the memory.
+  ConcurrentAppendRegion(void* data, std::size_t size)
+      : data_{static_cast<std::uint8_t*>(data)},
+        capacity_{size > kHeaderSize ? size - kHeaderSize : 0} {}
+
+  ConcurrentAppendRegion(const ConcurrentAppendRegion&) = delete;
+  void operator=(const ConcurrentAppendRegion&) = delete;
+
+  // Returns the number of bytes of the region claimed by records, including
+  // records that are still pending.
+  std::size_t size() const {
+    const std::uint64_t tail = this->tail().load(std::memory_order_acquire);
+    return tail < capacity_ ? static_cast<std::size_t>(tail) : capacity_;
+  }
+
+  // Returns the number of bytes of the region available for records.
+  std::size_t capacity() const { return capacity_; }
+
+  // Finds the first committed record at or after |*offset|, which starts at
+  // zero, storing its data and size and advancing |*offset| past it. Pending
+  // records are skipped. Returns false when there are no further records, or
+  // when the next record has been claimed but its header is not written yet;
+  // scanning may be resumed from |*offset| later to find records appended
+  // since.
+  bool NextRecord(std::size_t* offset, const std::uint8_t** data,
+                  std::size_t* size) const {
+    const std::size_t end = this->size();
+    while (*offset + kRecordHeaderSize <= end) {
+      const std::uint64_t header =
+          record_header(*offset).load(std::memory_order_acquire);
+      if (header == 0)
+        return false;
+
+      const std::size_t length = Length(header);
+      const std::uint32_t state = State(header);
+      const std::size_t record = *offset;
+      *offset += kRecordHeaderSize + length;
+      if (state != kPending) {
+        *data = records() + record + kRecordHeaderSize;
+        *size = state;
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  friend class ConcurrentAppendWriter;
+
+  static constexpr std::uint64_t MakeHeader(std::size_t length,
+                                            std::uint32_t state) {
+    return static_cast<std::uint64_t>(length) |
+           (static_cast<std::uint64_t>(state) << 32);
+  }
+  static constexpr std::size_t Length(std::uint64_t header) {
+    return static_cast<std::size_t>(header & 0xffffffff);
+  }
+  static constexpr std::uint32_t State(std::uint64_t header) {
+    return static_cast<std::uint32_t>(header >> 32);
+  }
+
+  // Claims a record for |size| bytes of data, returning a pointer to the data
+  // and storing the offset of the record in |record| and its reserved length
+  // in |length|.
+  Status<std::uint8_t*> Claim(std::size_t size, std::size_t* record,
+                              std::size_t* length) {
+    if (data_ == nullptr || size >= kPending)
+      return ErrorStatus::WriteLimitReached;
+
+    const std::size_t record_size =
+        (kRecordHeaderSize + size + kRecordHeaderSize - 1) &
+        ~std::size_t{kRecordHeaderSize - 1};
+    const std::uint64_t start =
+        tail().fetch_add(record_size, std::memory_order_relaxed);
+    if (start >= capacity_)
+      return ErrorStatus::WriteLimitReached;
+
+    // The region is full. Mark the part of it this record claimed as pending
+    // so that readers do not stop at the missing header.
+    if (record_size > capacity_ - start) {
+      if (capacity_ - start >= kRecordHeaderSize) {
+        record_header(start).store(
+            MakeHeader(capacity_ - start - kRecordHeaderSize, kPending),
+            std::memory_order_release);
+      }
+      return ErrorStatus::WriteLimitReached;
+    }
+
+    *record = static_cast<std::size_t>(start);
+    *length = record_size - kRecordHeaderSize;
+    record_header(*record).store(MakeHeader(*length, kPending),
+                                 std::memory_order_relaxed);
+    return records() + *record + kRecordHeaderSize;
+  }
+
+  // Commits the record at |record| with |size| bytes of data, publishing it
+  // to readers.
+  void Publish(std::size_t record, std::size_t length, std::size_t size) {
+    record_header(record).store(
+        MakeHeader(length, static_cast<std::uint32_t>(size)),
+        std::memory_order_release);
+  }
+
+  std::atomic<std::uint64_t>& tail() const {
+    return *reinterpret_cast<std::atomic<std::uint64_t>*>(data_);
+  }
+  std::atomic<std::uint64_t>& record_header(std::size_t record) const {
+    return *reinterpret_cast<std::atomic<std::uint64_t>*>(records() + record);
+  }
+  std::uint8_t* records() const { return data_ + kHeaderSize; }
+
+  std::uint8_t* data_{nullptr};
+  std::size_t capacity_{0};
+};
+
+// Writer type that appends records to a ConcurrentAppendRegion. Each thread
+// uses its own writer; any number of writers may share a region.
+//
+// Every Prepare() that does not fit in the record in progress commits that
+// record and claims a new one, and a record is committed automatically once
+// the prepared size has been written. Writes beyond the prepared size fail
+// with ErrorStatus::WriteLimitReached rather than splitting a value across
+// records, so the writer must be used through Serializer, which prepares the
+// size of each value.
+class ConcurrentAppendWriter {
+ public:
+  ConcurrentAppendWriter() = default;
+  explicit ConcurrentAppendWriter(ConcurrentAppendRegion* region)
+      : region_{region} {}
+
+  ConcurrentAppendWriter(const ConcurrentAppendWriter&) = delete;
+  void operator=(const ConcurrentAppendWriter&) = delete;
+
+  ~ConcurrentAppendWriter() { Flush(); }
+
+  // Claims a record for the next |size| bytes, committing the record in
+  // progress, if any.
+  Status<void> Prepare(std::size_t size) {
+    if (size <= reserved_)
+      return {};
+
+    Flush();
+    if (region_ == nullptr)
+      return ErrorStatus::WriteLimitReached;
+
+    auto status = region_->Claim(size, &record_, &length_);
+    if (!status)
+      return status.error();
+
+    cursor_ = status.get();
+    reserved_ = size;
+    used_ = 0;
+    return {};
+  }
+
+  Status<void> Write(std::uint8_t byte) { return Write(&byte, &byte + 1); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    const std::size_t length_bytes = (end - begin) * sizeof(T);
+    if (length_bytes > reserved_)
+      return ErrorStatus::WriteLimitReached;
+
+    std::memcpy(cursor_, begin, length_bytes);
+    Advance(length_bytes);
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    if (padding_bytes > reserved_)
+      return ErrorStatus::WriteLimitReached;
+
+    std::memset(cursor_, padding_value, padding_bytes);
+    Advance(padding_bytes);
+    return {};
+  }
+
+  // Returns a pointer to the next |size| bytes of the record in progress for
+  // encodings to store values into directly. See IsReservingWriter.
+  Status<std::uint8_t*> Reserve(std::size_t size) {
+    if (size > reserved_)
+      return ErrorStatus::WriteLimitReached;
+    else
+      return cursor_;
+  }
+
+  void Commit(std::size_t size) { Advance(size); }
+
+  // Commits the partially written record, if any, leaving the rest of its
+  // reserved length as padding. Records are committed automatically when the
+  // size passed to Prepare() has been written.
+  void Flush() {
+    if (used_ != 0)
+      region_->Publish(record_, length_, used_);
+    reserved_ = 0;
+    used_ = 0;
+  }
+
+  const ConcurrentAppendRegion* region() const { return region_; }
+
+ private:
+  void Advance(std::size_t bytes) {
+    cursor_ += bytes;
+    used_ += bytes;
+    reserved_ -= bytes;
+    if (reserved_ == 0)
+      Flush();
+  }
+
+  ConcurrentAppendRegion* region_{nullptr};
+
+  // The offset and reserved length of the record in progress.
+  std::size_t record_{0};
+  std::size_t length_{0};
+
+  std::uint8_t* cursor_{nullptr};
+  std::size_t reserved_{0};
+  std::size_t used_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_CONCURRENT_APPEND_WRITER_H_
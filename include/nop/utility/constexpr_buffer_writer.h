@@ -19,6 +19,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <type_traits>
 
 #include <nop/base/encoding.h>
 #include <nop/base/utility.h>
@@ -30,6 +31,9 @@ namespace nop {
 // PedanticBufferWriter for runtime serialization into a byte buffer.
 class ConstexprBufferWriter {
  public:
+  // Staged writes are not constant expressions.
+  using SkipStaging = void;
+
   constexpr ConstexprBufferWriter() = default;
   constexpr ConstexprBufferWriter(const ConstexprBufferWriter&) = default;
   template <std::size_t Size>
@@ -57,7 +61,7 @@ class ConstexprBufferWriter {
     }
   }
 
-  template <typename T, typename Enable = EnableIfArithmetic<T>>
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
   constexpr Status<void> Write(const T* begin, const T* end) {
     const std::size_t element_size = sizeof(T);
     const std::size_t length = end - begin;
@@ -131,6 +135,10 @@ class ConstexprBufferWriter {
   constexpr void WriteElement(std::int64_t value, std::size_t offset) {
     WriteElement(static_cast<std::uint64_t>(value), offset);
   }
+  template <typename T, typename Enabled = EnableIfEnumFlags<T>>
+  constexpr void WriteElement(T value, std::size_t offset) {
+    WriteElement(static_cast<std::underlying_type_t<T>>(value), offset);
+  }
 
   // TODO(eieio): At the time of this writing there isn't simple way to get the
   // raw bytes of a floating point type in a constexpr expression.
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_COUNTING_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_COUNTING_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include <nop/base/encoding.h>
+#include <nop/base/handle.h>
+#include <nop/base/utility.h>
+#include <nop/status.h>
+#include <nop/traits/is_detected.h>
+
+namespace nop {
+
+// Passes the integer width of Writer through to CountingWriter.
+template <typename Writer, typename Enabled = void>
+struct CountingWriterBase {};
+template <typename Writer>
+struct CountingWriterBase<Writer,
+                          std::enable_if_t<IsFixedWidthWriter<Writer>::value>> {
+  using FixedWidthIntegers = void;
+};
+
+// CountingWriter is a writer type that counts the bytes written to it without
+// storing them. Encoding a value to a CountingWriter measures the exact size
+// the value would encode to on Writer, for the types whose Encoding<T>::Size()
+// is only an upper bound; see IsSizeOverestimated.
+//
+// Handle references are not known until a handle is pushed to the writer that
+// transfers it. When Writer can predict its references, as described by
+// PeekHandleReferenceTest, the predictions are used; otherwise non-empty
+// handles are counted at the widest reference, the same as Size(), and only
+// empty handles are counted exactly. Like Size(), the count assumes that table
+// entries are written in two passes, which is how they are written to writers
+// without Patch(); CountingWriter does not provide Patch() itself.
+//
+// Example:
+//
+//   nop::CountingWriter<SocketWriter> counting_writer{&socket_writer};
+//   auto status = nop::Encoding<Message>::Write(message, &counting_writer);
+//   const std::size_t size = counting_writer.size();
+//
+template <typename Writer = void>
+class CountingWriter : public CountingWriterBase<Writer> {
+ public:
+  using SkipPrepare = void;
+
+  CountingWriter() = default;
+  CountingWriter(const CountingWriter&) = default;
+  CountingWriter(const Writer* writer) : writer_{writer} {}
+
+  CountingWriter& operator=(const CountingWriter&) = default;
+
+  Status<void> Prepare(std::size_t /*size*/) { return {}; }
+
+  Status<void> Write(std::uint8_t /*byte*/) {
+    size_ += 1;
+    return {};
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    size_ += (end - begin) * sizeof(T);
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t /*padding_value*/ = 0x00) {
+    size_ += padding_bytes;
+    return {};
+  }
+
+  template <typename HandleType>
+  Status<HandleReference> PushHandle(const HandleType& handle) {
+    const HandleReference handle_reference = PeekHandleReference(handle, 0);
+    if (handle)
+      pending_handles_++;
+    return {handle_reference};
+  }
+
+  // Predicts handle references through the underlying writer, so that counts
+  // nest.
+  template <typename HandleType>
+  HandleReference PeekHandleReference(const HandleType& handle,
+                                      std::size_t pending) const {
+    return PeekHandleReference(
+        handle, pending_handles_ + pending,
+        IsDetected<PeekHandleReferenceTest, Writer, HandleType>{});
+  }
+
+  // Returns the number of bytes written.
+  std::size_t size() const { return size_; }
+
+ private:
+  template <typename HandleType>
+  HandleReference PeekHandleReference(const HandleType& handle,
+                                      std::size_t pending,
+                                      std::true_type) const {
+    return writer_->PeekHandleReference(handle, pending);
+  }
+
+  template <typename HandleType>
+  HandleReference PeekHandleReference(const HandleType& handle,
+                                      std::size_t /*pending*/,
+                                      std::false_type) const {
+    return handle ? std::numeric_limits<HandleReference>::max()
+                  : HandleReference{kEmptyHandleReference};
+  }
+
+  const Writer* writer_{nullptr};
+  std::size_t size_{0};
+  std::size_t pending_handles_{0};
+};
+
+// Returns the exact size |value| encodes to on |writer|, measured with a dry
+// run through CountingWriter. Nothing is written to |writer|.
+template <typename T, typename Writer>
+Status<std::size_t> ExactEncodingSize(const T& value, const Writer* writer) {
+  CountingWriter<Writer> counting_writer{writer};
+  auto status = Encoding<T>::Write(value, &counting_writer);
+  if (!status)
+    return status.error();
+  else
+    return counting_writer.size();
+}
+
+// As above, without handle reference predictions.
+template <typename T>
+Status<std::size_t> ExactEncodingSize(const T& value) {
+  return ExactEncodingSize(value, static_cast<const void*>(nullptr));
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_COUNTING_WRITER_H_
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_CRC32C_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_CRC32C_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+// CRC-32C (Castagnoli), the checksum used by iSCSI, ext4, and most log and
+// storage formats. The CRC32 instructions of SSE 4.2 and ARMv8 are used when
+// the target supports them; otherwise the checksum is computed eight bytes at
+// a time with the slicing-by-8 table method.
+
+namespace nop {
+
+namespace detail {
+
+// Lookup tables for the slicing-by-8 method over the reflected polynomial.
+struct Crc32cTables {
+  enum : std::uint32_t { kPolynomial = 0x82f63b78 };
+
+  Crc32cTables() {
+    for (std::uint32_t i = 0; i < 256; i++) {
+      std::uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++)
+        crc = (crc >> 1) ^ (kPolynomial & (0 - (crc & 1)));
+      entries[0][i] = crc;
+    }
+    for (std::uint32_t i = 0; i < 256; i++) {
+      for (int slice = 1; slice < 8; slice++) {
+        const std::uint32_t previous = entries[slice - 1][i];
+        entries[slice][i] = (previous >> 8) ^ entries[0][previous & 0xff];
+      }
+    }
+  }
+
+  static const Crc32cTables& Get() {
+    static const Crc32cTables tables;
+    return tables;
+  }
+
+  std::uint32_t entries[8][256];
+};
+
+inline std::uint32_t Crc32cSoftware(const std::uint8_t* data, std::size_t size,
+                                    std::uint32_t crc) {
+  const auto& table = Crc32cTables::Get().entries;
+  while (size >= 8) {
+    std::uint32_t low;
+    std::uint32_t high;
+    std::memcpy(&low, data, sizeof(low));
+    std::memcpy(&high, data + 4, sizeof(high));
+    low ^= crc;
+    crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^
+          table[5][(low >> 16) & 0xff] ^ table[4][low >> 24] ^
+          table[3][high & 0xff] ^ table[2][(high >> 8) & 0xff] ^
+          table[1][(high >> 16) & 0xff] ^ table[0][high >> 24];
+    data += 8;
+    size -= 8;
+  }
+  while (size-- > 0)
+    crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xff];
+  return crc;
+}
+
+#if defined(__SSE4_2__)
+inline std::uint32_t Crc32cHardware(const std::uint8_t* data, std::size_t size,
+                                    std::uint32_t crc) {
+#if defined(__x86_64__)
+  std::uint64_t crc64 = crc;
+  while (size >= 8) {
+    std::uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += 8;
+    size -= 8;
+  }
+  crc = static_cast<std::uint32_t>(crc64);
+#endif
+  while (size-- > 0)
+    crc = _mm_crc32_u8(crc, *data++);
+  return crc;
+}
+#elif defined(__ARM_FEATURE_CRC32)
+inline std::uint32_t Crc32cHardware(const std::uint8_t* data, std::size_t size,
+                                    std::uint32_t crc) {
+  while (size >= 8) {
+    std::uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc = __crc32cd(crc, word);
+    data += 8;
+    size -= 8;
+  }
+  while (size-- > 0)
+    crc = __crc32cb(crc, *data++);
+  return crc;
+}
+#endif
+
+}  // namespace detail
+
+// Returns the CRC-32C of |size| bytes at |data|. Passing the checksum of
+// preceding data as |crc| continues the checksum across discontiguous parts:
+// Crc32c(b, size_b, Crc32c(a, size_a)) is the checksum of a followed by b.
+inline std::uint32_t Crc32c(const void* data, std::size_t size,
+                            std::uint32_t crc = 0) {
+  const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+#if defined(__SSE4_2__) || defined(__ARM_FEATURE_CRC32)
+  return ~detail::Crc32cHardware(bytes, size, ~crc);
+#else
+  return ~detail::Crc32cSoftware(bytes, size, ~crc);
+#endif
+}
+
+// Incremental CRC-32C, for use as the Checksum parameter of ChecksumWriter and
+// ChecksumReader. Checksum types provide a ValueType, an Update() method that
+// adds bytes to the checksum, a value() method, and a Reset() method.
+class Crc32cChecksum {
+ public:
+  using ValueType = std::uint32_t;
+
+  void Update(const void* data, std::size_t size) {
+    crc_ = Crc32c(data, size, crc_);
+  }
+
+  ValueType value() const { return crc_; }
+  void Reset() { crc_ = 0; }
+
+ private:
+  std::uint32_t crc_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_CRC32C_H_
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_DECOMPRESSING_READER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_DECOMPRESSING_READER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/handle.h>
+#include <nop/base/utility.h>
+#include <nop/utility/compression_codec.h>
+
+namespace nop {
+
+// DecompressingReader is a reader type that wraps another reader pointer and
+// decompresses the blocks written by CompressingWriter as the input is
+// consumed. Only one block is held decompressed at a time, and reads that
+// cover a whole block are decompressed straight into their destination. Blocks
+// larger than |max_block_size| are rejected before any memory is allocated
+// for them.
+//
+// Example:
+//
+//   nop::DecompressingReader<nop::FdReader> decompressing_reader{&fd_reader};
+//   nop::Deserializer<decltype(decompressing_reader)*> deserializer{
+//       &decompressing_reader};
+//   deserializer.Read(&snapshot);
+//
+template <typename Reader, typename Codec = Lz4Codec>
+class DecompressingReader {
+ public:
+  enum : std::size_t { kDefaultMaxBlockSize = 4 * 1024 * 1024 };
+
+  DecompressingReader(Reader* reader,
+                      std::size_t max_block_size = kDefaultMaxBlockSize)
+      : reader_{reader}, max_block_size_{max_block_size} {}
+
+  DecompressingReader(const DecompressingReader&) = delete;
+  void operator=(const DecompressingReader&) = delete;
+
+  // The decompressed size of the input is not known in advance.
+  Status<void> Ensure(std::size_t /*size*/) { return {}; }
+
+  Status<void> Read(std::uint8_t* byte) {
+    if (index_ == block_.size())
+      return Read(byte, byte + 1);
+
+    *byte = block_[index_++];
+    return {};
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Read(T* begin, T* end) {
+    std::uint8_t* target = reinterpret_cast<std::uint8_t*>(begin);
+    std::size_t length_bytes = (end - begin) * sizeof(T);
+
+    while (length_bytes > 0) {
+      if (index_ == block_.size()) {
+        auto status = ReadBlock(target, length_bytes);
+        if (!status)
+          return status.error();
+
+        // The block was decompressed directly into the target.
+        target += status.get();
+        length_bytes -= status.get();
+        continue;
+      }
+
+      const std::size_t count = std::min(length_bytes, block_.size() - index_);
+      std::memcpy(target, &block_[index_], count);
+      index_ += count;
+      target += count;
+      length_bytes -= count;
+    }
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    while (padding_bytes > 0) {
+      if (index_ == block_.size()) {
+        auto status = ReadBlock(nullptr, 0);
+        if (!status)
+          return status.error();
+      }
+
+      const std::size_t count =
+          std::min(padding_bytes, block_.size() - index_);
+      index_ += count;
+      padding_bytes -= count;
+    }
+    return {};
+  }
+
+  template <typename HandleType>
+  Status<HandleType> GetHandle(HandleReference handle_reference) {
+    return reader_->template GetHandle<HandleType>(handle_reference);
+  }
+
+  // Returns true when the current block and the underlying reader are both
+  // exhausted. Only available when the underlying reader supports this
+  // operation.
+  template <typename R = Reader,
+            typename = decltype(std::declval<const R&>().empty())>
+  bool empty() const {
+    return index_ == block_.size() && reader_->empty();
+  }
+
+  // Returns the number of decompressed bytes buffered from the current block.
+  std::size_t buffered() const { return block_.size() - index_; }
+  std::size_t max_block_size() const { return max_block_size_; }
+
+  Reader* reader() const { return reader_; }
+
+ private:
+  // Reads the next block, decompressing it into |target| if it has room for
+  // the whole block, or into the block buffer otherwise. Returns the number of
+  // bytes decompressed into |target|.
+  Status<std::size_t> ReadBlock(std::uint8_t* target, std::size_t size) {
+    std::uint32_t header[2];
+    auto status = reader_->Ensure(sizeof(header));
+    if (!status)
+      return status.error();
+
+    status = reader_->Read(&header[0], &header[2]);
+    if (!status)
+      return status.error();
+
+    const std::size_t raw_size = header[0];
+    const std::size_t stored_size = header[1];
+    if (raw_size == 0 || raw_size > max_block_size_ ||
+        stored_size > Codec::Bound(raw_size)) {
+      return ErrorStatus::ProtocolError;
+    }
+
+    const bool direct = target != nullptr && raw_size <= size;
+    if (!direct) {
+      block_.resize(raw_size);
+      index_ = 0;
+      target = block_.data();
+    }
+
+    status = reader_->Ensure(stored_size);
+    if (!status)
+      return status.error();
+
+    if (stored_size == raw_size) {
+      status = reader_->Read(target, target + raw_size);
+      if (!status)
+        return status.error();
+    } else {
+      compressed_.resize(stored_size);
+      status = reader_->Read(compressed_.data(),
+                             compressed_.data() + stored_size);
+      if (!status)
+        return status.error();
+
+      if (!Codec::Decompress(compressed_.data(), stored_size, target,
+                             raw_size)) {
+        return ErrorStatus::ProtocolError;
+      }
+    }
+
+    if (direct) {
+      block_.clear();
+      index_ = 0;
+      return raw_size;
+    } else {
+      return 0;
+    }
+  }
+
+  Reader* reader_;
+  std::size_t max_block_size_;
+  std::vector<std::uint8_t> block_;
+  std::vector<std::uint8_t> compressed_;
+  std::size_t index_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_DECOMPRESSING_READER_H_
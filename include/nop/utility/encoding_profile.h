@@ -0,0 +1,339 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_ENCODING_PROFILE_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_ENCODING_PROFILE_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nop/base/canonical.h>
+#include <nop/base/encoding.h>
+#include <nop/base/handle.h>
+#include <nop/base/utility.h>
+
+namespace nop {
+
+//
+// Profiling of encoded bytes and calls by type.
+//
+// ProfilingWriter and ProfilingReader wrap another writer or reader and count
+// the bytes passing through them in an EncodingProfile. EncodingIO reports the
+// start and end of every value it writes or reads to the profile, which
+// attributes each byte to the innermost value being encoded, split into the
+// prefix byte, the payload, and padding, and records the number of values and
+// the time spent on them by type. This shows which types dominate the encoded
+// size of a message, and where packed or fixed-width encodings would pay off.
+//
+// The hook in EncodingIO is selected at compile time by ProfilerTest and is
+// compiled out for writers and readers that do not collect a profile.
+// ProfilingWriter opts out of staged and reserved writes so that it sees each
+// value as it is encoded. Wrappers other than BoundedWriter and BoundedReader
+// hide the profile, so the profiling wrapper should be the outermost one.
+//
+// Example:
+//
+//   nop::EncodingProfile profile;
+//   nop::Serializer<nop::ProfilingWriter<nop::StreamWriter<std::ofstream>>>
+//       serializer{&stream_writer, &profile};
+//   serializer.Write(message);
+//   std::fputs(profile.Report().c_str(), stderr);
+//
+
+namespace detail {
+
+// Extracts the name of T from the signature of this function.
+template <typename T>
+std::string ParseEncodingTypeName() {
+  const std::string function = __PRETTY_FUNCTION__;
+  const std::size_t begin = function.find("T = ");
+  const std::size_t end = function.rfind(']');
+  if (begin == std::string::npos || end == std::string::npos || end < begin)
+    return function;
+
+  // GCC appends the definitions of type aliases after a semicolon.
+  const std::string name = function.substr(begin + 4, end - begin - 4);
+  return name.substr(0, name.find("; "));
+}
+
+}  // namespace detail
+
+// Returns the name of T as spelled by the compiler.
+template <typename T>
+const std::string& EncodingTypeName() {
+  static const std::string name = detail::ParseEncodingTypeName<T>();
+  return name;
+}
+
+// Collects the bytes, calls, and time attributed to each encoded type.
+class EncodingProfile {
+ public:
+  // The totals for one type. The time of a value includes the time spent on
+  // the values nested in it.
+  struct Entry {
+    std::string name;
+    std::uint64_t calls;
+    std::uint64_t prefix_bytes;
+    std::uint64_t payload_bytes;
+    std::uint64_t padding_bytes;
+    std::uint64_t nanoseconds;
+
+    std::uint64_t total_bytes() const {
+      return prefix_bytes + payload_bytes + padding_bytes;
+    }
+  };
+
+  EncodingProfile() { Clear(); }
+
+  // Starts attributing bytes to a value of type T. Called by EncodingIO.
+  template <typename T>
+  void Begin() {
+    static const char key = 0;
+    auto search = index_.find(&key);
+    if (search == index_.end()) {
+      search = index_.emplace(&key, entries_.size()).first;
+      entries_.push_back(Entry{EncodingTypeName<T>(), 0, 0, 0, 0, 0});
+    }
+
+    entries_[search->second].calls++;
+    frames_.push_back(Frame{search->second, Clock::now()});
+    prefix_pending_ = true;
+  }
+
+  // Ends the innermost value started by Begin().
+  void End() {
+    const Frame& frame = frames_.back();
+    entries_[frame.entry].nanoseconds += static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                             frame.start)
+            .count());
+    frames_.pop_back();
+    prefix_pending_ = false;
+  }
+
+  // Attributes |bytes| written or read to the innermost value. The first byte
+  // of a value is its prefix.
+  void CountBytes(std::size_t bytes) {
+    if (bytes == 0)
+      return;
+
+    Entry& entry = current();
+    if (prefix_pending_) {
+      entry.prefix_bytes += 1;
+      bytes -= 1;
+      prefix_pending_ = false;
+    }
+    entry.payload_bytes += bytes;
+  }
+
+  // Attributes |bytes| of padding, or input skipped by a reader, to the
+  // innermost value.
+  void CountPadding(std::size_t bytes) { current().padding_bytes += bytes; }
+
+  // Returns the entries of the types seen, ordered by decreasing total bytes.
+  // Bytes written or read outside of any value are attributed to an entry
+  // named "(none)", which is omitted when it is empty.
+  std::vector<Entry> entries() const {
+    std::vector<Entry> entries;
+    for (const Entry& entry : entries_) {
+      if (entry.calls != 0 || entry.total_bytes() != 0)
+        entries.push_back(entry);
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const Entry& a, const Entry& b) {
+                       return a.total_bytes() > b.total_bytes();
+                     });
+    return entries;
+  }
+
+  // Returns a table of the entries, one line per type.
+  std::string Report() const {
+    std::string report;
+    char line[256];
+    std::snprintf(line, sizeof(line), "%10s %10s %10s %10s %10s %12s  %s\n",
+                  "calls", "prefix", "payload", "padding", "total", "time(ns)",
+                  "type");
+    report += line;
+    for (const Entry& entry : entries()) {
+      std::snprintf(line, sizeof(line),
+                    "%10llu %10llu %10llu %10llu %10llu %12llu  ",
+                    static_cast<unsigned long long>(entry.calls),
+                    static_cast<unsigned long long>(entry.prefix_bytes),
+                    static_cast<unsigned long long>(entry.payload_bytes),
+                    static_cast<unsigned long long>(entry.padding_bytes),
+                    static_cast<unsigned long long>(entry.total_bytes()),
+                    static_cast<unsigned long long>(entry.nanoseconds));
+      report += line;
+      report += entry.name;
+      report += '\n';
+    }
+    return report;
+  }
+
+  // Discards the collected totals.
+  void Clear() {
+    index_.clear();
+    entries_.assign(1, Entry{"(none)", 0, 0, 0, 0, 0});
+    frames_.clear();
+    prefix_pending_ = false;
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Frame {
+    std::size_t entry;
+    Clock::time_point start;
+  };
+
+  Entry& current() {
+    return entries_[frames_.empty() ? 0 : frames_.back().entry];
+  }
+
+  std::unordered_map<const void*, std::size_t> index_;
+  std::vector<Entry> entries_;
+  std::vector<Frame> frames_;
+  bool prefix_pending_;
+};
+
+// Writer type that wraps another writer pointer and counts the bytes written
+// by type in an EncodingProfile.
+template <typename Writer>
+class ProfilingWriter : public CanonicalWriterBase<Writer> {
+ public:
+  using SkipStaging = void;
+
+  ProfilingWriter() = default;
+  ProfilingWriter(const ProfilingWriter&) = default;
+  ProfilingWriter(Writer* writer, EncodingProfile* profile)
+      : writer_{writer}, profile_{profile} {}
+
+  ProfilingWriter& operator=(const ProfilingWriter&) = default;
+
+  Status<void> Prepare(std::size_t size) { return writer_->Prepare(size); }
+
+  Status<void> Write(std::uint8_t byte) {
+    auto status = writer_->Write(byte);
+    if (!status)
+      return status;
+
+    profile_->CountBytes(1);
+    return {};
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    auto status = writer_->Write(begin, end);
+    if (!status)
+      return status;
+
+    profile_->CountBytes((end - begin) * sizeof(T));
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    auto status = writer_->Skip(padding_bytes, padding_value);
+    if (!status)
+      return status;
+
+    profile_->CountPadding(padding_bytes);
+    return {};
+  }
+
+  template <typename HandleType>
+  Status<HandleReference> PushHandle(const HandleType& handle) {
+    return writer_->PushHandle(handle);
+  }
+
+  EncodingProfile* profiler() const { return profile_; }
+  Writer* writer() const { return writer_; }
+
+ private:
+  Writer* writer_{nullptr};
+  EncodingProfile* profile_{nullptr};
+};
+
+// Reader type that wraps another reader pointer and counts the bytes read by
+// type in an EncodingProfile.
+template <typename Reader>
+class ProfilingReader {
+ public:
+  ProfilingReader() = default;
+  ProfilingReader(const ProfilingReader&) = default;
+  ProfilingReader(Reader* reader, EncodingProfile* profile)
+      : reader_{reader}, profile_{profile} {}
+
+  ProfilingReader& operator=(const ProfilingReader&) = default;
+
+  Status<void> Ensure(std::size_t size) { return reader_->Ensure(size); }
+
+  Status<void> Read(std::uint8_t* byte) {
+    auto status = reader_->Read(byte);
+    if (!status)
+      return status;
+
+    profile_->CountBytes(1);
+    return {};
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Read(T* begin, T* end) {
+    auto status = reader_->Read(begin, end);
+    if (!status)
+      return status;
+
+    profile_->CountBytes((end - begin) * sizeof(T));
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    auto status = reader_->Skip(padding_bytes);
+    if (!status)
+      return status;
+
+    profile_->CountPadding(padding_bytes);
+    return {};
+  }
+
+  template <typename HandleType>
+  Status<HandleType> GetHandle(HandleReference handle_reference) {
+    return reader_->template GetHandle<HandleType>(handle_reference);
+  }
+
+  template <typename R = Reader,
+            typename = decltype(std::declval<const R&>().empty())>
+  bool empty() const {
+    return reader_->empty();
+  }
+
+  EncodingProfile* profiler() const { return profile_; }
+  Reader* reader() const { return reader_; }
+
+ private:
+  Reader* reader_{nullptr};
+  EncodingProfile* profile_{nullptr};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_ENCODING_PROFILE_H_
@@ -17,10 +17,19 @@
 #ifndef LIBNOP_INCLUDE_NOP_UTILITY_ENDIAN_H_
 #define LIBNOP_INCLUDE_NOP_UTILITY_ENDIAN_H_
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <type_traits>
 #include <utility>
 
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 //
 // Little-endian and big-endian to host-endian conversion utilities. These
 // utilities are portable and very efficient on modern compilers.
@@ -52,6 +61,16 @@
 
 namespace nop {
 
+// True when the host is little-endian, in which case the little-endian
+// encodings are copied directly between memory and readers or writers. Hosts
+// that do not identify their byte order are assumed to be little-endian.
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && \
+    __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool kHostIsLittleEndian = false;
+#else
+constexpr bool kHostIsLittleEndian = true;
+#endif
+
 // Base type for endian conversions to host endianness.
 template <typename T, typename Enable = void>
 struct HostEndian;
@@ -172,6 +191,158 @@ struct HostEndian<T, std::enable_if_t<std::is_floating_point<T>::value>> {
   using Integral = decltype(IntegralType(std::declval<T>()));
 };
 
+// Reverses the bytes of each of the |count| Size-byte values at |data|. The
+// bulk of a range is swapped in 32-byte or 16-byte vectors with AVX2, SSSE3, or
+// NEON shuffles when the target supports them. Other targets use the portable
+// loop, which compilers vectorize with the permute instructions of the target,
+// such as VSX on POWER.
+template <std::size_t Size>
+class ByteSwapKernel {
+ public:
+  static void Swap(std::uint8_t* data, std::size_t count) {
+    static_assert(Size > 0, "Value size must be non-zero.");
+    const std::size_t i = SwapVectors(
+        data, count, std::integral_constant<bool, 16 % Size == 0>{});
+    SwapWords(data + i * Size, count - i, std::is_void<Word>{});
+  }
+
+ private:
+  // Unsigned integral type of Size bytes, if any.
+  using Word = std::conditional_t<
+      Size == 2, std::uint16_t,
+      std::conditional_t<
+          Size == 4, std::uint32_t,
+          std::conditional_t<Size == 8, std::uint64_t, void>>>;
+
+  static void SwapWords(std::uint8_t* data, std::size_t count, std::true_type) {
+    for (std::size_t i = 0; i < count; i++)
+      std::reverse(data + i * Size, data + (i + 1) * Size);
+  }
+
+  // Swaps the remaining values with shifts, which compilers reduce to byte
+  // swap instructions.
+  static void SwapWords(std::uint8_t* data, std::size_t count,
+                        std::false_type) {
+    for (std::size_t i = 0; i < count; i++) {
+      Word word;
+      std::memcpy(&word, data + i * Size, Size);
+      word = Reverse(word, std::make_index_sequence<Size>{});
+      std::memcpy(data + i * Size, &word, Size);
+    }
+  }
+
+  template <typename W, std::size_t... Is>
+  static W Reverse(W word, std::index_sequence<Is...>) {
+    W reversed = 0;
+    (void)std::initializer_list<bool>{
+        (reversed |= static_cast<W>(((word >> Is * 8) & 0xff)
+                                    << (Size - Is - 1) * 8),
+         false)...};
+    return reversed;
+  }
+
+  // Swaps whole vectors and returns the number of values swapped.
+  static std::size_t SwapVectors(std::uint8_t* /*data*/,
+                                 std::size_t /*count*/, std::false_type) {
+    return 0;
+  }
+
+  static std::size_t SwapVectors(std::uint8_t* data, std::size_t count,
+                                 std::true_type) {
+    std::size_t i = 0;
+#if defined(__AVX2__) || defined(__SSSE3__)
+    alignas(16) std::uint8_t mask_bytes[16];
+    for (std::size_t j = 0; j < 16; j++)
+      mask_bytes[j] = static_cast<std::uint8_t>(j - j % Size + Size - 1 -
+                                                j % Size);
+    const __m128i mask =
+        _mm_load_si128(reinterpret_cast<const __m128i*>(mask_bytes));
+#if defined(__AVX2__)
+    const __m256i wide_mask = _mm256_broadcastsi128_si256(mask);
+    for (; i + 32 / Size <= count; i += 32 / Size) {
+      __m256i* vector = reinterpret_cast<__m256i*>(data + i * Size);
+      _mm256_storeu_si256(
+          vector, _mm256_shuffle_epi8(_mm256_loadu_si256(vector), wide_mask));
+    }
+#endif
+    for (; i + 16 / Size <= count; i += 16 / Size) {
+      __m128i* vector = reinterpret_cast<__m128i*>(data + i * Size);
+      _mm_storeu_si128(vector,
+                       _mm_shuffle_epi8(_mm_loadu_si128(vector), mask));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 / Size <= count; i += 16 / Size) {
+      std::uint8_t* vector = data + i * Size;
+      vst1q_u8(vector, Reverse(vld1q_u8(vector)));
+    }
+#else
+    (void)data;
+    (void)count;
+#endif
+    return i;
+  }
+
+#if !defined(__AVX2__) && !defined(__SSSE3__) && defined(__ARM_NEON)
+  template <std::size_t S = Size, std::enable_if_t<S == 1, int> = 0>
+  static uint8x16_t Reverse(uint8x16_t vector) {
+    return vector;
+  }
+  template <std::size_t S = Size, std::enable_if_t<S == 2, int> = 0>
+  static uint8x16_t Reverse(uint8x16_t vector) {
+    return vrev16q_u8(vector);
+  }
+  template <std::size_t S = Size, std::enable_if_t<S == 4, int> = 0>
+  static uint8x16_t Reverse(uint8x16_t vector) {
+    return vrev32q_u8(vector);
+  }
+  template <std::size_t S = Size, std::enable_if_t<S == 8, int> = 0>
+  static uint8x16_t Reverse(uint8x16_t vector) {
+    return vrev64q_u8(vector);
+  }
+  template <std::size_t S = Size, std::enable_if_t<S == 16, int> = 0>
+  static uint8x16_t Reverse(uint8x16_t vector) {
+    const uint8x16_t swapped = vrev64q_u8(vector);
+    return vextq_u8(swapped, swapped, 8);
+  }
+#endif
+};
+
+// Reverses the byte order of each value in the range [begin, end) in place.
+// The values may be of any bitwise copyable type: the bytes of each value are
+// reversed as a whole.
+template <typename T>
+inline void SwapBytes(T* begin, T* end) {
+  ByteSwapKernel<sizeof(T)>::Swap(reinterpret_cast<std::uint8_t*>(begin),
+                                  end - begin);
+}
+
+// Evaluates to true if the representation in memory of the arithmetic or enum
+// type T differs from its little-endian representation on this host. Types
+// stored like an arithmetic type, such as packed value wrappers, specialize
+// this trait.
+template <typename T, typename Enabled = void>
+struct IsByteSwapped
+    : std::integral_constant<bool, !kHostIsLittleEndian && (sizeof(T) > 1) &&
+                                       (std::is_arithmetic<T>::value ||
+                                        std::is_enum<T>::value)> {};
+
+// Converts the little-endian values in the range [begin, end) to host
+// endianness in place. Does nothing on little-endian hosts or for types other
+// than arithmetic and enum types, such as raw structures, which are stored in
+// host byte order.
+template <typename T>
+inline void FromLittleEndian(T* begin, T* end) {
+  if (IsByteSwapped<T>::value)
+    SwapBytes(begin, end);
+}
+
+// Converts the host-endian values in the range [begin, end) to little
+// endianness in place, with the same exceptions as FromLittleEndian().
+template <typename T>
+inline void ToLittleEndian(T* begin, T* end) {
+  FromLittleEndian(begin, end);
+}
+
 }  // namespace nop
 
 #endif  // LIBNOP_INCLUDE_NOP_UTILITY_ENDIAN_H_
@@ -21,6 +21,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <utility>
 
 #include <nop/status.h>
@@ -75,20 +78,42 @@ class FdReader {
     }
   }
 
+  // Reads the range [begin, end) with as few calls to read() as the kernel
+  // allows. Use BufferedFdReader to also coalesce small reads.
   Status<void> Read(void* begin, void* end) {
-    std::uint8_t* begin_byte = static_cast<std::uint8_t*>(begin);
+    std::uint8_t* byte = static_cast<std::uint8_t*>(begin);
     std::uint8_t* end_byte = static_cast<std::uint8_t*>(end);
 
-    for (std::uint8_t* byte = begin_byte; byte < end_byte; byte++) {
-      auto status = Read(byte);
+    while (byte < end_byte) {
+      const ssize_t ret = ::read(fd_, byte, end_byte - byte);
+      if (ret > 0)
+        byte += ret;
+      else if (ret == 0)
+        return ErrorStatus::ReadLimitReached;
+      else if (errno != EINTR)
+        return ErrorStatus::IOError;
+    }
+
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    std::uint8_t padding[kPaddingChunkSize];
+    while (padding_bytes > 0) {
+      const std::size_t count = std::min(padding_bytes, sizeof(padding));
+      auto status = Read(padding, padding + count);
       if (!status)
         return status;
+
+      padding_bytes -= count;
     }
 
     return {};
   }
 
  private:
+  enum : std::size_t { kPaddingChunkSize = 64 };
+
   int fd_{-1};
 };
 
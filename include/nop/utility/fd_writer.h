@@ -21,14 +21,25 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <utility>
 
 #include <nop/status.h>
 
 namespace nop {
 
+// FdWriter is a writer type that wraps around a UNIX file descriptor. The
+// writer takes ownerhip of the fd and automatically closes it when destroyed,
+// unless it is released.
 class FdWriter {
  public:
+  // Writes go directly to the output, so there is no need to compute the size
+  // of each value ahead of time.
+  using SkipPrepare = void;
+
   FdWriter() = default;
   FdWriter(int fd) : fd_{fd} {}
   FdWriter(const FdWriter&) = delete;
@@ -72,20 +83,45 @@ class FdWriter {
     }
   }
 
+  // Writes the range [begin, end) with as few calls to write() as the kernel
+  // allows. Use BufferedFdWriter to also coalesce small writes.
   Status<void> Write(const void* begin, const void* end) {
-    const std::uint8_t* begin_byte = static_cast<const std::uint8_t*>(begin);
+    const std::uint8_t* byte = static_cast<const std::uint8_t*>(begin);
     const std::uint8_t* end_byte = static_cast<const std::uint8_t*>(end);
 
-    for (const std::uint8_t* byte = begin_byte; byte < end_byte; byte++) {
-      auto status = Write(*byte);
+    while (byte < end_byte) {
+      const ssize_t ret = ::write(fd_, byte, end_byte - byte);
+      if (ret > 0)
+        byte += ret;
+      else if (ret == 0)
+        return ErrorStatus::WriteLimitReached;
+      else if (errno != EINTR)
+        return ErrorStatus::IOError;
+    }
+
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    std::uint8_t padding[kPaddingChunkSize];
+    std::memset(padding, padding_value, sizeof(padding));
+
+    while (padding_bytes > 0) {
+      const std::size_t count = std::min(padding_bytes, sizeof(padding));
+      auto status = Write(padding, padding + count);
       if (!status)
         return status;
+
+      padding_bytes -= count;
     }
 
     return {};
   }
 
  private:
+  enum : std::size_t { kPaddingChunkSize = 64 };
+
   int fd_{-1};
 };
 
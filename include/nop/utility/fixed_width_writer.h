@@ -0,0 +1,112 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_FIXED_WIDTH_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_FIXED_WIDTH_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <nop/base/encoding.h>
+#include <nop/base/handle.h>
+#include <nop/base/utility.h>
+
+namespace nop {
+
+// FixedWidthWriter is a writer type that wraps another writer pointer and
+// selects the fixed-width integer mode described in nop/base/encoding.h: every
+// integer and enum is written with the widest prefix of its type followed by
+// all of its bytes, in a single write without branching on the value. Readers
+// decode the output as usual, and see the same prefix for every value of a
+// member, which keeps decoding predictable.
+//
+// This suits trusted, CPU-bound links where the larger encoding is cheaper
+// than choosing the smallest prefix for each integer. Note that lengths and
+// counts are 64-bit integers and take nine bytes each in this mode.
+//
+// The sizes computed by Serializer::GetSize() assume the smallest prefixes and
+// do not bound the output of this writer, so it opts out of Prepare(). Values
+// written through BoundedWriter, such as two-pass table entries when the
+// underlying writer does not support Patch(), keep the smallest prefixes so
+// that they stay within their computed sizes.
+//
+// Example:
+//
+//   nop::FixedWidthWriter<nop::VectorWriter> fixed_width_writer{
+//       &vector_writer};
+//   nop::Serializer<decltype(fixed_width_writer)*> serializer{
+//       &fixed_width_writer};
+//   serializer.Write(message);
+//
+template <typename Writer>
+class FixedWidthWriter {
+ public:
+  using FixedWidthIntegers = void;
+  using SkipPrepare = void;
+
+  FixedWidthWriter() = default;
+  FixedWidthWriter(const FixedWidthWriter&) = default;
+  FixedWidthWriter(Writer* writer) : writer_{writer} {}
+
+  FixedWidthWriter& operator=(const FixedWidthWriter&) = default;
+
+  Status<void> Prepare(std::size_t size) { return writer_->Prepare(size); }
+
+  Status<void> Write(std::uint8_t byte) { return writer_->Write(byte); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    return writer_->Write(begin, end);
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    return writer_->Skip(padding_bytes, padding_value);
+  }
+
+  // Patches previously written data in the underlying writer, which must
+  // support this operation.
+  template <typename T, typename W = Writer,
+            typename = decltype(std::declval<W&>().Patch(
+                std::size_t{}, std::declval<const T*>(),
+                std::declval<const T*>()))>
+  Status<void> Patch(std::size_t position, const T* begin, const T* end) {
+    return writer_->Patch(position, begin, end);
+  }
+
+  // Returns the number of bytes written to the underlying writer. Only
+  // available when the underlying writer supports this operation.
+  template <typename W = Writer,
+            typename = decltype(std::declval<const W&>().size())>
+  std::size_t size() const {
+    return writer_->size();
+  }
+
+  template <typename HandleType>
+  Status<HandleReference> PushHandle(const HandleType& handle) {
+    return writer_->PushHandle(handle);
+  }
+
+  Writer* writer() const { return writer_; }
+
+ private:
+  Writer* writer_{nullptr};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_FIXED_WIDTH_WRITER_H_
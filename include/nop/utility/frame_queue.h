@@ -0,0 +1,384 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_FRAME_QUEUE_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_FRAME_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include <nop/base/utility.h>
+#include <nop/serializer.h>
+#include <nop/status.h>
+
+namespace nop {
+
+//
+// Bounded lock-free multi-producer multi-consumer queue of encoded frames.
+//
+// FrameQueue holds a fixed number of fixed-size slots. A producer claims the
+// next free slot and serializes directly into it through a SlotWriter, and a
+// consumer claims the next filled slot and deserializes directly out of it
+// through a SlotReader, so frames are never copied through a temporary
+// buffer. Slots are claimed and released with a sequence number per slot and
+// a compare-and-swap on the shared position of each side, without locks.
+//
+// Frames are handed off in the order their slots were claimed. A slot whose
+// producer abandons it, for example because the value did not fit, is skipped
+// by consumers.
+//
+// Example:
+//
+//   nop::FrameQueue queue{1024, 256};
+//
+//   // Producer threads:
+//   auto pushed = queue.TryPush(quote);  // False when the queue is full.
+//
+//   // Consumer threads:
+//   Quote quote;
+//   auto popped = queue.TryPop(&quote);  // False when the queue is empty.
+//
+class FrameQueue {
+ public:
+  class SlotWriter;
+  class SlotReader;
+
+  // Creates a queue of at least |slot_count| slots, rounded up to a power of
+  // two, each holding frames of up to |slot_size| bytes.
+  FrameQueue(std::size_t slot_count, std::size_t slot_size)
+      : slot_size_{slot_size} {
+    std::size_t rounded = 2;
+    while (rounded < slot_count)
+      rounded <<= 1;
+
+    mask_ = rounded - 1;
+    cells_.reset(new Cell[rounded]);
+    buffer_.reset(new std::uint8_t[rounded * slot_size]);
+    for (std::size_t i = 0; i < rounded; i++)
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  FrameQueue(const FrameQueue&) = delete;
+  void operator=(const FrameQueue&) = delete;
+
+  // Claims the next free slot for |writer|. Returns false if the queue is
+  // full. The frame is handed off when the writer commits it.
+  bool BeginPush(SlotWriter* writer);
+
+  // Claims the next filled slot for |reader|. Returns false if the queue is
+  // empty. The slot is returned to producers when the reader releases it.
+  bool BeginPop(SlotReader* reader);
+
+  // Serializes |value| into the next free slot. Returns false if the queue is
+  // full, or an error if the value does not fit in a slot.
+  template <typename T>
+  Status<bool> TryPush(const T& value);
+
+  // Deserializes the next frame into |value|. Returns false if the queue is
+  // empty, or an error if the frame does not hold a T.
+  template <typename T>
+  Status<bool> TryPop(T* value);
+
+  std::size_t slot_count() const { return mask_ + 1; }
+  std::size_t slot_size() const { return slot_size_; }
+
+ private:
+  // Frame size marking a slot abandoned by its producer.
+  enum : std::size_t { kAbandoned = ~std::size_t{0} };
+
+  // Per-slot state, padded to keep neighboring slots off the same cache line.
+  struct Cell {
+    std::atomic<std::size_t> sequence{0};
+    std::size_t size{0};
+    char padding[64 - 2 * sizeof(std::size_t)];
+  };
+
+  // Pads the shared positions onto separate cache lines.
+  struct Position {
+    std::atomic<std::size_t> value{0};
+    char padding[64 - sizeof(std::size_t)];
+  };
+
+  // Claims the cell at the position of |side| whose sequence is |offset| ahead
+  // of the position, the standard bounded queue algorithm over sequence
+  // numbers. Returns false if no cell is ready.
+  bool Claim(Position* side, std::size_t offset, std::size_t* position) {
+    std::size_t current = side->value.load(std::memory_order_relaxed);
+    while (true) {
+      Cell& cell = cells_[current & mask_];
+      const std::size_t sequence =
+          cell.sequence.load(std::memory_order_acquire);
+      const auto difference = static_cast<std::ptrdiff_t>(
+          sequence - (current + offset));
+      if (difference == 0) {
+        if (side->value.compare_exchange_weak(current, current + 1,
+                                              std::memory_order_relaxed)) {
+          *position = current;
+          return true;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        current = side->value.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Hands the frame in the slot at |position| to consumers.
+  void Publish(std::size_t position, std::size_t size) {
+    Cell& cell = cells_[position & mask_];
+    cell.size = size;
+    cell.sequence.store(position + 1, std::memory_order_release);
+  }
+
+  // Returns the slot at |position| to producers.
+  void Release(std::size_t position) {
+    cells_[position & mask_].sequence.store(position + mask_ + 1,
+                                            std::memory_order_release);
+  }
+
+  std::uint8_t* slot(std::size_t position) const {
+    return &buffer_[(position & mask_) * slot_size_];
+  }
+
+  std::size_t slot_size_;
+  std::size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+  std::unique_ptr<std::uint8_t[]> buffer_;
+  Position push_position_;
+  Position pop_position_;
+};
+
+// Writer type that serializes into a slot claimed with FrameQueue::BeginPush().
+// The frame is handed off by Commit(); a writer destroyed or reused without
+// committing abandons its slot.
+class FrameQueue::SlotWriter {
+ public:
+  SlotWriter() = default;
+  SlotWriter(const SlotWriter&) = delete;
+  void operator=(const SlotWriter&) = delete;
+
+  ~SlotWriter() { Abandon(); }
+
+  Status<void> Prepare(std::size_t size) {
+    if (queue_ == nullptr || size > capacity_ - size_)
+      return ErrorStatus::WriteLimitReached;
+    else
+      return {};
+  }
+
+  Status<void> Write(std::uint8_t byte) { return Write(&byte, &byte + 1); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    const std::size_t length_bytes = (end - begin) * sizeof(T);
+    auto status = Prepare(length_bytes);
+    if (!status)
+      return status;
+
+    std::memcpy(&buffer_[size_], begin, length_bytes);
+    size_ += length_bytes;
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    auto status = Prepare(padding_bytes);
+    if (!status)
+      return status;
+
+    std::memset(&buffer_[size_], padding_value, padding_bytes);
+    size_ += padding_bytes;
+    return {};
+  }
+
+  // Overwrites previously written data at |position| with the given elements.
+  // Tables use this to write their entries in a single pass.
+  template <typename T, typename Enable = EnableIfArithmetic<T>>
+  Status<void> Patch(std::size_t position, const T* begin, const T* end) {
+    const std::size_t length_bytes = (end - begin) * sizeof(T);
+    if (position > size_ || length_bytes > size_ - position)
+      return ErrorStatus::WriteLimitReached;
+
+    std::memcpy(&buffer_[position], begin, length_bytes);
+    return {};
+  }
+
+  // Hands the frame written so far to consumers.
+  void Commit() {
+    if (queue_ != nullptr)
+      queue_->Publish(position_, size_);
+    queue_ = nullptr;
+  }
+
+  // Gives up the slot, which consumers skip.
+  void Abandon() {
+    if (queue_ != nullptr)
+      queue_->Publish(position_, kAbandoned);
+    queue_ = nullptr;
+  }
+
+  std::size_t size() const { return size_; }
+  std::size_t capacity() const { return capacity_; }
+
+ private:
+  friend class FrameQueue;
+
+  void Reset(FrameQueue* queue, std::size_t position) {
+    Abandon();
+    queue_ = queue;
+    position_ = position;
+    buffer_ = queue->slot(position);
+    size_ = 0;
+    capacity_ = queue->slot_size_;
+  }
+
+  FrameQueue* queue_{nullptr};
+  std::size_t position_{0};
+  std::uint8_t* buffer_{nullptr};
+  std::size_t size_{0};
+  std::size_t capacity_{0};
+};
+
+// Reader type that deserializes from a slot claimed with
+// FrameQueue::BeginPop(). The slot is returned to producers by Release(), or
+// when the reader is destroyed or reused.
+class FrameQueue::SlotReader {
+ public:
+  SlotReader() = default;
+  SlotReader(const SlotReader&) = delete;
+  void operator=(const SlotReader&) = delete;
+
+  ~SlotReader() { Release(); }
+
+  Status<void> Ensure(std::size_t size) {
+    if (size > size_ - index_)
+      return ErrorStatus::ReadLimitReached;
+    else
+      return {};
+  }
+
+  Status<void> Read(std::uint8_t* byte) { return Read(byte, byte + 1); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Read(T* begin, T* end) {
+    const std::size_t length_bytes = (end - begin) * sizeof(T);
+    auto status = Ensure(length_bytes);
+    if (!status)
+      return status;
+
+    std::memcpy(begin, &buffer_[index_], length_bytes);
+    index_ += length_bytes;
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    auto status = Ensure(padding_bytes);
+    if (!status)
+      return status;
+
+    index_ += padding_bytes;
+    return {};
+  }
+
+  // Returns the slot to producers.
+  void Release() {
+    if (queue_ != nullptr)
+      queue_->Release(position_);
+    queue_ = nullptr;
+    buffer_ = nullptr;
+    size_ = 0;
+    index_ = 0;
+  }
+
+  bool empty() const { return index_ == size_; }
+  std::size_t remaining() const { return size_ - index_; }
+  std::size_t size() const { return size_; }
+
+ private:
+  friend class FrameQueue;
+
+  void Reset(FrameQueue* queue, std::size_t position, std::size_t size) {
+    Release();
+    queue_ = queue;
+    position_ = position;
+    buffer_ = queue->slot(position);
+    size_ = size;
+  }
+
+  FrameQueue* queue_{nullptr};
+  std::size_t position_{0};
+  const std::uint8_t* buffer_{nullptr};
+  std::size_t size_{0};
+  std::size_t index_{0};
+};
+
+inline bool FrameQueue::BeginPush(SlotWriter* writer) {
+  std::size_t position;
+  if (!Claim(&push_position_, 0, &position))
+    return false;
+
+  writer->Reset(this, position);
+  return true;
+}
+
+inline bool FrameQueue::BeginPop(SlotReader* reader) {
+  std::size_t position;
+  while (Claim(&pop_position_, 1, &position)) {
+    const std::size_t size = cells_[position & mask_].size;
+    if (size != kAbandoned) {
+      reader->Reset(this, position, size);
+      return true;
+    }
+    Release(position);
+  }
+  return false;
+}
+
+template <typename T>
+Status<bool> FrameQueue::TryPush(const T& value) {
+  Serializer<SlotWriter> serializer;
+  if (!BeginPush(&serializer.writer()))
+    return false;
+
+  auto status = serializer.Write(value);
+  if (!status)
+    return status.error();
+
+  serializer.writer().Commit();
+  return true;
+}
+
+template <typename T>
+Status<bool> FrameQueue::TryPop(T* value) {
+  Deserializer<SlotReader> deserializer;
+  if (!BeginPop(&deserializer.reader()))
+    return false;
+
+  auto status = deserializer.Read(value);
+  if (!status)
+    return status.error();
+  else
+    return true;
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_FRAME_QUEUE_H_
@@ -0,0 +1,357 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_FRAME_SCANNER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_FRAME_SCANNER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/status.h>
+
+namespace nop {
+
+// FrameScanner determines the encoded length of a top-level value from its
+// prefixes alone, without knowing its C++ type or decoding it. The scanner is
+// incremental: input may be fed to Scan() in chunks of any size as it arrives,
+// and scanning resumes where the previous chunk left off without rescanning.
+// Payloads of strings, binary containers, numbers, and table entries are
+// skipped without being examined.
+//
+// This supports non-blocking readers that accumulate input in a buffer: once
+// the scanner reports that the value is complete, the whole value is buffered
+// and may be decoded with BufferReader, which never runs out of input midway.
+//
+// Example:
+//
+//   auto status = scanner.Scan(chunk, chunk_size);
+//   if (!status)
+//     return status.error();
+//   AppendToBuffer(chunk, status.get());
+//   if (scanner.complete()) {
+//     nop::Deserializer<nop::BufferReader> deserializer{buffer, length};
+//     deserializer.Read(&message);
+//     scanner.Reset();
+//     // Scan the rest of the chunk for the next value.
+//   }
+//
+class FrameScanner {
+ public:
+  FrameScanner() { Reset(); }
+  FrameScanner(const FrameScanner&) = default;
+  FrameScanner(FrameScanner&&) = default;
+
+  FrameScanner& operator=(const FrameScanner&) = default;
+  FrameScanner& operator=(FrameScanner&&) = default;
+
+  // Prepares the scanner to scan a new value.
+  void Reset() {
+    state_ = State::Prefix;
+    error_ = ErrorStatus::None;
+    frames_.clear();
+    frames_.push_back({false, 1});
+    integer_count_ = 0;
+    integer_index_ = 0;
+    integer_bytes_ = 0;
+    integer_shift_ = 0;
+    integer_ = 0;
+    skip_bytes_ = 0;
+    length_ = 0;
+  }
+
+  // Scans up to |size| more bytes of the current value from |data|. Returns the
+  // number of bytes consumed, which is less than |size| when the value ends
+  // before the end of the input. The remaining bytes belong to the next value,
+  // which may be scanned after calling Reset(). Errors in the encoding are
+  // sticky until the scanner is reset.
+  Status<std::size_t> Scan(const void* data, std::size_t size) {
+    const std::uint8_t* input = static_cast<const std::uint8_t*>(data);
+    std::size_t index = 0;
+
+    while (index < size && state_ != State::Complete) {
+      if (state_ == State::Error) {
+        return error_;
+      } else if (state_ == State::Bytes) {
+        const std::size_t count =
+            static_cast<std::size_t>(std::min<std::uint64_t>(
+                skip_bytes_, static_cast<std::uint64_t>(size - index)));
+        index += count;
+        skip_bytes_ -= count;
+        if (skip_bytes_ == 0)
+          Advance();
+      } else if (state_ == State::IntegerBytes) {
+        integer_ |= static_cast<std::uint64_t>(input[index++])
+                    << integer_shift_;
+        integer_shift_ += 8;
+        if (--integer_bytes_ == 0)
+          FinishInteger();
+      } else if (state_ == State::IntegerPrefix) {
+        ScanIntegerPrefix(static_cast<EncodingByte>(input[index++]));
+      } else {
+        ScanPrefix(static_cast<EncodingByte>(input[index++]));
+      }
+    }
+
+    length_ += index;
+    if (state_ == State::Error)
+      return error_;
+    else
+      return index;
+  }
+
+  // Returns true when the whole value has been scanned.
+  bool complete() const { return state_ == State::Complete; }
+
+  // Returns the number of bytes of the current value scanned so far. This is
+  // the total encoded length of the value once it is complete.
+  std::size_t length() const { return length_; }
+
+  // Returns the minimum number of additional bytes required before the value
+  // may be complete. The actual number may be larger, since the size of nested
+  // values is not known until their prefixes are scanned.
+  std::uint64_t needed() const {
+    switch (state_) {
+      case State::Complete:
+      case State::Error:
+        return 0;
+      case State::Bytes:
+        return skip_bytes_;
+      case State::IntegerBytes:
+        return integer_bytes_;
+      default:
+        return 1;
+    }
+  }
+
+ private:
+  enum class State {
+    Prefix,         // The prefix of the next value.
+    IntegerPrefix,  // The prefix of an integer following a prefix.
+    IntegerBytes,   // The payload of an integer following a prefix.
+    Bytes,          // A payload to skip.
+    Complete,
+    Error,
+  };
+
+  // Describes what to do with an integer scanned after a prefix.
+  enum class Integer {
+    Ignore,        // Handle type and reference, error code, table hash, etc.
+    Length,        // Length in bytes of a payload to skip.
+    Count,         // Number of elements of an array or structure.
+    MapCount,      // Number of key/value pairs of a map.
+    VariantValue,  // Variant index, followed by one value.
+    EntryCount,    // Number of entries of a table.
+  };
+
+  // A container being scanned with the number of values or table entries that
+  // have not been started yet.
+  struct Frame {
+    bool entries;
+    std::uint64_t remaining;
+  };
+
+  void Fail(ErrorStatus error) {
+    state_ = State::Error;
+    error_ = error;
+  }
+
+  // Expects the given integers, in order, to follow.
+  void ExpectIntegers(Integer first, Integer second = Integer::Ignore,
+                      std::size_t count = 1) {
+    integers_[0] = first;
+    integers_[1] = second;
+    integer_count_ = count;
+    integer_index_ = 0;
+    state_ = State::IntegerPrefix;
+  }
+
+  void ScanPrefix(EncodingByte prefix) {
+    frames_.back().remaining--;
+
+    switch (prefix) {
+      case EncodingByte::U8:
+      case EncodingByte::I8:
+      case EncodingByte::U16:
+      case EncodingByte::I16:
+      case EncodingByte::U32:
+      case EncodingByte::I32:
+      case EncodingByte::F32:
+      case EncodingByte::U64:
+      case EncodingByte::I64:
+      case EncodingByte::F64:
+        skip_bytes_ = BaseEncodingSize(prefix) - 1;
+        state_ = State::Bytes;
+        break;
+
+      case EncodingByte::Binary:
+      case EncodingByte::String:
+        ExpectIntegers(Integer::Length);
+        break;
+
+      case EncodingByte::Array:
+      case EncodingByte::Structure:
+        ExpectIntegers(Integer::Count);
+        break;
+
+      case EncodingByte::Map:
+        ExpectIntegers(Integer::MapCount);
+        break;
+
+      case EncodingByte::Variant:
+        ExpectIntegers(Integer::VariantValue);
+        break;
+
+      case EncodingByte::Handle:
+        ExpectIntegers(Integer::Ignore, Integer::Ignore, 2);
+        break;
+
+      case EncodingByte::Error:
+        ExpectIntegers(Integer::Ignore);
+        break;
+
+      case EncodingByte::Table:
+        ExpectIntegers(Integer::Ignore, Integer::EntryCount, 2);
+        break;
+
+      case EncodingByte::Extension:
+        ExpectIntegers(Integer::Ignore, Integer::Length, 2);
+        break;
+
+      case EncodingByte::Nil:
+        Advance();
+        break;
+
+      default:
+        if (IsFixIntPrefix(prefix))
+          Advance();
+        else
+          Fail(ErrorStatus::UnexpectedEncodingType);
+        break;
+    }
+  }
+
+  void ScanIntegerPrefix(EncodingByte prefix) {
+    const bool is_signed =
+        (prefix >= EncodingByte::I8 && prefix <= EncodingByte::I64) ||
+        prefix >= EncodingByte::NegativeFixIntMin;
+    const bool is_integer = IsFixIntPrefix(prefix) ||
+                            (prefix >= EncodingByte::U8 &&
+                             prefix <= EncodingByte::I64);
+
+    if (!is_integer || (is_signed && IsUnsigned(integers_[integer_index_]))) {
+      Fail(ErrorStatus::UnexpectedEncodingType);
+    } else if (IsFixIntPrefix(prefix)) {
+      integer_ = static_cast<std::uint8_t>(prefix);
+      FinishInteger();
+    } else {
+      integer_ = 0;
+      integer_shift_ = 0;
+      integer_bytes_ = BaseEncodingSize(prefix) - 1;
+      state_ = State::IntegerBytes;
+    }
+  }
+
+  void FinishInteger() {
+    const Integer integer = integers_[integer_index_++];
+    const std::uint64_t value = integer_;
+
+    switch (integer) {
+      case Integer::Ignore:
+        if (integer_index_ < integer_count_)
+          state_ = State::IntegerPrefix;
+        else
+          Advance();
+        break;
+
+      case Integer::Length:
+        skip_bytes_ = value;
+        state_ = State::Bytes;
+        if (skip_bytes_ == 0)
+          Advance();
+        break;
+
+      case Integer::Count:
+        frames_.push_back({false, value});
+        Advance();
+        break;
+
+      case Integer::MapCount:
+        if (value > std::numeric_limits<std::uint64_t>::max() / 2) {
+          Fail(ErrorStatus::InvalidContainerLength);
+        } else {
+          frames_.push_back({false, 2 * value});
+          Advance();
+        }
+        break;
+
+      case Integer::VariantValue:
+        frames_.push_back({false, 1});
+        Advance();
+        break;
+
+      case Integer::EntryCount:
+        frames_.push_back({true, value});
+        Advance();
+        break;
+    }
+  }
+
+  // Moves on to the next value or table entry after finishing a value or
+  // starting a container.
+  void Advance() {
+    while (!frames_.empty() && frames_.back().remaining == 0)
+      frames_.pop_back();
+
+    if (frames_.empty()) {
+      state_ = State::Complete;
+    } else if (frames_.back().entries) {
+      // Table entries are an id followed by the size of the entry payload.
+      frames_.back().remaining--;
+      ExpectIntegers(Integer::Ignore, Integer::Length, 2);
+    } else {
+      state_ = State::Prefix;
+    }
+  }
+
+  static bool IsFixIntPrefix(EncodingByte prefix) {
+    return prefix <= EncodingByte::PositiveFixIntMax ||
+           prefix >= EncodingByte::NegativeFixIntMin;
+  }
+
+  static bool IsUnsigned(Integer integer) {
+    return integer != Integer::Ignore && integer != Integer::VariantValue;
+  }
+
+  State state_;
+  ErrorStatus error_;
+  std::vector<Frame> frames_;
+  Integer integers_[2];
+  std::size_t integer_count_;
+  std::size_t integer_index_;
+  std::size_t integer_bytes_;
+  std::size_t integer_shift_;
+  std::uint64_t integer_;
+  std::uint64_t skip_bytes_;
+  std::size_t length_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_FRAME_SCANNER_H_
@@ -0,0 +1,298 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_FRAMING_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_FRAMING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <nop/base/table.h>
+#include <nop/base/utility.h>
+#include <nop/status.h>
+
+namespace nop {
+
+//
+// Length-prefixed framing for message streams.
+//
+// Encodings are self-delimiting, but only to a reader that decodes them, so a
+// receiver on a byte stream cannot otherwise find the end of a message without
+// decoding it. FramedWriter prefixes each top-level value with a fixed-size
+// frame header holding the length of the value and a set of user-defined flags:
+//
+// +------------+-----------+-----------------+
+// | U32:LENGTH | U32:FLAGS | LENGTH BYTES... |
+// +------------+-----------+-----------------+
+//
+// The header fields are unsigned 32-bit integers in host byte order, like the
+// fixed-width integers of the encoding itself. FramedReader reads each frame
+// with one bulk read of its payload, after which the value is decoded from
+// memory, or the frame is handed whole to another thread for decoding.
+//
+// Example:
+//
+//   nop::Serializer<nop::FramedWriter<nop::FdWriter>> serializer{fd};
+//   serializer.writer().set_flags(kPriorityFlag);
+//   serializer.Write(message);
+//
+//   nop::Deserializer<nop::FramedReader<nop::FdReader>> deserializer{fd};
+//   deserializer.reader().NextFrame();
+//   deserializer.Read(&message);
+//
+
+// Size of the header preceding each frame.
+enum : std::size_t { kFrameHeaderSize = 2 * sizeof(std::uint32_t) };
+
+// Writer adapter that frames each top-level value written by Serializer, which
+// prepares the writer with the encoded size of every value before writing it.
+// The header is written with that size, and the frame ends as soon as that
+// many bytes are written. A few encodings overestimate their size: when such a
+// frame is ended, by preparing the next value or calling EndFrame(), its length
+// is backfilled with the exact size if the wrapped writer supports patching,
+// or else the frame is padded out to the size in the header.
+template <typename Writer>
+class FramedWriter {
+ public:
+  template <typename... Args>
+  FramedWriter(Args&&... args) : writer_{std::forward<Args>(args)...} {}
+  FramedWriter(FramedWriter&&) = default;
+  FramedWriter& operator=(FramedWriter&&) = default;
+
+  // Starts a frame for a value of |size| bytes, ending the previous frame
+  // first.
+  Status<void> Prepare(std::size_t size) {
+    auto status = EndFrame();
+    if (!status)
+      return status;
+    else if (size > std::numeric_limits<std::uint32_t>::max())
+      return ErrorStatus::WriteLimitReached;
+
+    status = writer_.Prepare(kFrameHeaderSize + size);
+    if (!status)
+      return status;
+
+    position_ = GetPosition(IsPatchWriter<Writer>{});
+    const std::uint32_t header[2] = {static_cast<std::uint32_t>(size), flags_};
+    status = writer_.Write(&header[0], &header[2]);
+    if (!status)
+      return status;
+
+    size_ = size;
+    remaining_ = size;
+    return {};
+  }
+
+  Status<void> Write(std::uint8_t byte) {
+    auto status = Consume(1);
+    if (!status)
+      return status;
+
+    return writer_.Write(byte);
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    auto status = Consume((end - begin) * sizeof(T));
+    if (!status)
+      return status;
+
+    return writer_.Write(begin, end);
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    auto status = Consume(padding_bytes);
+    if (!status)
+      return status;
+
+    return writer_.Skip(padding_bytes, padding_value);
+  }
+
+  // Ends the current frame early, backfilling or padding the frame to match
+  // its header. This is only necessary after the last value written when its
+  // encoding overestimates its size.
+  Status<void> EndFrame() {
+    if (remaining_ == 0)
+      return {};
+
+    const std::size_t remaining = remaining_;
+    remaining_ = 0;
+    return Finish(remaining, IsPatchWriter<Writer>{});
+  }
+
+  // Sets the flags written in the header of subsequent frames.
+  void set_flags(std::uint32_t flags) { flags_ = flags; }
+  std::uint32_t flags() const { return flags_; }
+
+  // Returns the number of bytes left to write in the current frame.
+  std::size_t remaining() const { return remaining_; }
+
+  const Writer& writer() const { return writer_; }
+  Writer& writer() { return writer_; }
+  Writer&& take() { return std::move(writer_); }
+
+ private:
+  FramedWriter(const FramedWriter&) = delete;
+  void operator=(const FramedWriter&) = delete;
+
+  // Accounts for |size| bytes of the current frame. Writing outside of a frame
+  // or past its end is an error.
+  Status<void> Consume(std::size_t size) {
+    if (size > remaining_)
+      return ErrorStatus::WriteLimitReached;
+
+    remaining_ -= size;
+    return {};
+  }
+
+  std::size_t GetPosition(std::true_type) const { return writer_.size(); }
+  std::size_t GetPosition(std::false_type) const { return 0; }
+
+  // Patches the length in the header with the number of bytes written.
+  Status<void> Finish(std::size_t remaining, std::true_type) {
+    const std::uint32_t length = static_cast<std::uint32_t>(size_ - remaining);
+    return writer_.Patch(position_, &length, &length + 1);
+  }
+
+  // Pads the frame out to the length in the header.
+  Status<void> Finish(std::size_t remaining, std::false_type) {
+    return writer_.Skip(remaining);
+  }
+
+  Writer writer_;
+  std::uint32_t flags_{0};
+  std::size_t position_{0};
+  std::size_t size_{0};
+  std::size_t remaining_{0};
+};
+
+// Reader adapter that reads the frames written by FramedWriter. NextFrame()
+// reads the next frame into an internal buffer, from which the value is then
+// read; reading past the end of the frame fails rather than consuming the next
+// frame. Any part of a frame left unread, such as padding, is discarded by the
+// next call to NextFrame(). Frames larger than max_frame_size() are rejected
+// before any memory is allocated for them.
+template <typename Reader>
+class FramedReader {
+ public:
+  enum : std::size_t { kDefaultMaxFrameSize = 16 * 1024 * 1024 };
+
+  template <typename... Args>
+  FramedReader(Args&&... args) : reader_{std::forward<Args>(args)...} {}
+  FramedReader(FramedReader&&) = default;
+  FramedReader& operator=(FramedReader&&) = default;
+
+  // Reads the next frame, discarding the rest of the current frame.
+  Status<void> NextFrame() {
+    std::uint32_t header[2];
+    auto status = reader_.Ensure(kFrameHeaderSize);
+    if (!status)
+      return status;
+
+    status = reader_.Read(&header[0], &header[2]);
+    if (!status)
+      return status;
+    else if (header[0] > max_frame_size_)
+      return ErrorStatus::ProtocolError;
+
+    frame_.resize(header[0]);
+    index_ = 0;
+    flags_ = header[1];
+
+    status = reader_.Ensure(frame_.size());
+    if (!status)
+      return status;
+
+    return reader_.Read(frame_.data(), frame_.data() + frame_.size());
+  }
+
+  // Reads the next frame into |payload| and returns its flags, so that the
+  // frame may be decoded elsewhere, for example with BufferReader.
+  Status<std::uint32_t> ReadFrame(std::vector<std::uint8_t>* payload) {
+    auto status = NextFrame();
+    if (!status)
+      return status.error();
+
+    // Swap buffers to reuse the capacity of |payload| for the next frame.
+    frame_.swap(*payload);
+    frame_.clear();
+    return flags_;
+  }
+
+  Status<void> Ensure(std::size_t size) {
+    if (size > frame_.size() - index_)
+      return ErrorStatus::ReadLimitReached;
+    else
+      return {};
+  }
+
+  Status<void> Read(std::uint8_t* byte) { return Read(byte, byte + 1); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Read(T* begin, T* end) {
+    const std::size_t length_bytes = (end - begin) * sizeof(T);
+    auto status = Ensure(length_bytes);
+    if (!status)
+      return status;
+
+    std::memcpy(begin, frame_.data() + index_, length_bytes);
+    index_ += length_bytes;
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    auto status = Ensure(padding_bytes);
+    if (!status)
+      return status;
+
+    index_ += padding_bytes;
+    return {};
+  }
+
+  // Returns true when the current frame has been read to the end.
+  bool empty() const { return index_ == frame_.size(); }
+
+  // Returns the size and flags of the current frame.
+  std::size_t frame_size() const { return frame_.size(); }
+  std::uint32_t flags() const { return flags_; }
+
+  void set_max_frame_size(std::size_t size) { max_frame_size_ = size; }
+  std::size_t max_frame_size() const { return max_frame_size_; }
+
+  const Reader& reader() const { return reader_; }
+  Reader& reader() { return reader_; }
+  Reader&& take() { return std::move(reader_); }
+
+ private:
+  FramedReader(const FramedReader&) = delete;
+  void operator=(const FramedReader&) = delete;
+
+  Reader reader_;
+  std::vector<std::uint8_t> frame_;
+  std::size_t index_{0};
+  std::uint32_t flags_{0};
+  std::size_t max_frame_size_{kDefaultMaxFrameSize};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_FRAMING_H_
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_INTERNING_READER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_INTERNING_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/handle.h>
+#include <nop/base/interned_string.h>
+#include <nop/base/pointer.h>
+#include <nop/base/utility.h>
+
+namespace nop {
+
+// InterningReader is a reader type that wraps another reader pointer and keeps
+// the table of strings defined by InterningWriter, resolving references to
+// them. Each distinct string is copied into the table once; StringView values
+// read through this reader refer to the table rather than the input, and remain
+// valid until Reset() is called or the reader is destroyed. Definitions with an
+// index of |max_strings| or more are rejected.
+//
+// The reader likewise keeps the table of objects shared through
+// std::shared_ptr, constructing each object once and resolving the references
+// to it, so that the pointers read share ownership as the pointers written did.
+//
+// Call Reset() between messages, matching the writer.
+//
+// Example:
+//
+//   nop::InterningReader<nop::BufferReader> interning_reader{&buffer_reader};
+//   nop::Deserializer<decltype(interning_reader)*> deserializer{
+//       &interning_reader};
+//   deserializer.Read(&batch);
+//   interning_reader.Reset();
+//
+template <typename Reader>
+class InterningReader {
+ public:
+  enum : std::size_t { kDefaultMaxStrings = 1 << 16 };
+
+  InterningReader(Reader* reader,
+                  std::size_t max_strings = kDefaultMaxStrings)
+      : reader_{reader}, max_strings_{max_strings} {}
+
+  InterningReader(const InterningReader&) = delete;
+  void operator=(const InterningReader&) = delete;
+
+  Status<void> Ensure(std::size_t size) { return reader_->Ensure(size); }
+
+  Status<void> Read(std::uint8_t* byte) { return reader_->Read(byte); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Read(T* begin, T* end) {
+    return reader_->Read(begin, end);
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    return reader_->Skip(padding_bytes);
+  }
+
+  // Borrows |size| bytes from the underlying reader, which must support this
+  // operation.
+  template <typename R = Reader,
+            typename = decltype(std::declval<R&>().Borrow(std::size_t{}))>
+  Status<const std::uint8_t*> Borrow(std::size_t size) {
+    return reader_->Borrow(size);
+  }
+
+  // Returns the number of bytes remaining in the underlying reader. Only
+  // available when the underlying reader supports this operation.
+  template <typename R = Reader,
+            typename = decltype(std::declval<const R&>().remaining())>
+  std::size_t remaining() const {
+    return reader_->remaining();
+  }
+
+  // Returns true when the underlying reader is exhausted. Only available when
+  // the underlying reader supports this operation.
+  template <typename R = Reader,
+            typename = decltype(std::declval<const R&>().empty())>
+  bool empty() const {
+    return reader_->empty();
+  }
+
+  template <typename HandleType>
+  Status<HandleType> GetHandle(HandleReference handle_reference) {
+    return reader_->template GetHandle<HandleType>(handle_reference);
+  }
+
+  // Returns storage of |size| bytes for the string defined at |index|.
+  // Returns ErrorStatus::ProtocolError if the index is out of range or already
+  // defined.
+  Status<std::string*> DefineString(std::uint64_t index, std::size_t size) {
+    if (index >= max_strings_)
+      return ErrorStatus::ProtocolError;
+    else if (index < strings_.size() && strings_[index])
+      return ErrorStatus::ProtocolError;
+
+    if (index >= strings_.size())
+      strings_.resize(index + 1);
+
+    strings_[index].reset(new std::string(size, '\0'));
+    return strings_[index].get();
+  }
+
+  // Returns the string defined at |index|. Returns ErrorStatus::ProtocolError
+  // if there is no such string, which happens when the definition was skipped
+  // before it could be read.
+  Status<const std::string*> FindString(std::uint64_t index) const {
+    if (index >= strings_.size() || !strings_[index])
+      return ErrorStatus::ProtocolError;
+    else
+      return strings_[index].get();
+  }
+
+  // Adds |object| of type |type| to the table at |index|. Returns
+  // ErrorStatus::ProtocolError if the index is out of range or already
+  // defined.
+  Status<void> DefineObject(std::uint64_t index, std::shared_ptr<void> object,
+                            const void* type) {
+    if (index >= max_strings_)
+      return ErrorStatus::ProtocolError;
+    else if (index < objects_.size() && objects_[index].object)
+      return ErrorStatus::ProtocolError;
+
+    if (index >= objects_.size())
+      objects_.resize(index + 1);
+
+    objects_[index] = {std::move(object), type};
+    return {};
+  }
+
+  // Returns the object defined at |index|. Returns ErrorStatus::ProtocolError
+  // if there is no such object or it has a different type than |type|.
+  Status<std::shared_ptr<void>> FindObject(std::uint64_t index,
+                                           const void* type) const {
+    if (index >= objects_.size() || !objects_[index].object ||
+        objects_[index].type != type) {
+      return ErrorStatus::ProtocolError;
+    } else {
+      return objects_[index].object;
+    }
+  }
+
+  // Clears the tables to start a new message, invalidating the views that
+  // refer to them. Objects remain owned by the pointers that were read.
+  void Reset() {
+    strings_.clear();
+    objects_.clear();
+  }
+
+  Reader* reader() const { return reader_; }
+
+ private:
+  Reader* reader_;
+  std::size_t max_strings_;
+  std::vector<std::unique_ptr<std::string>> strings_;
+
+  struct Object {
+    std::shared_ptr<void> object;
+    const void* type;
+  };
+  std::vector<Object> objects_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_INTERNING_READER_H_
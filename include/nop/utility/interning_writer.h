@@ -0,0 +1,237 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_INTERNING_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_INTERNING_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/handle.h>
+#include <nop/base/interned_string.h>
+#include <nop/base/pointer.h>
+#include <nop/base/utility.h>
+
+namespace nop {
+
+// InterningWriter is a writer type that wraps another writer pointer and keeps
+// a table of the strings written through it, so that strings repeated within a
+// message are written in full once and referenced by index afterwards, using
+// the formats described in nop/base/interned_string.h. Strings shorter than
+// |min_size| bytes are always written in full, since a reference would not be
+// much smaller, and at most |max_strings| strings are interned per message.
+// InterningReader reads the output.
+//
+// When the underlying writer supports Patch(), the writer also keeps a table
+// of the objects written through std::shared_ptr, so that each object shared
+// by several pointers in a message is written once, using the formats
+// described in nop/base/pointer.h. At most |max_strings| objects are tracked
+// per message; further objects are written in full at every occurrence.
+//
+// The tables is scoped to a message: call Reset() between messages, so that
+// each message may be decoded on its own and the table does not grow without
+// bound.
+//
+// Interning applies to std::basic_string and StringView values written
+// directly through this writer. Strings written through BoundedWriter, such as
+// table entries when the underlying writer does not support Patch(), are
+// written in full. Because definitions are slightly larger than the regular
+// string encoding, Serializer::GetSize() does not bound the output of this
+// writer.
+//
+// Example:
+//
+//   nop::InterningWriter<nop::VectorWriter> interning_writer{&vector_writer};
+//   nop::Serializer<decltype(interning_writer)*> serializer{
+//       &interning_writer};
+//   serializer.Write(batch);
+//   interning_writer.Reset();
+//
+template <typename Writer>
+class InterningWriter {
+ public:
+  enum : std::size_t { kDefaultMinSize = 8, kDefaultMaxStrings = 1 << 16 };
+
+  InterningWriter(Writer* writer, std::size_t min_size = kDefaultMinSize,
+                  std::size_t max_strings = kDefaultMaxStrings)
+      : writer_{writer}, min_size_{min_size}, max_strings_{max_strings} {}
+
+  InterningWriter(const InterningWriter&) = delete;
+  void operator=(const InterningWriter&) = delete;
+
+  Status<void> Prepare(std::size_t size) { return writer_->Prepare(size); }
+
+  Status<void> Write(std::uint8_t byte) { return writer_->Write(byte); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    return writer_->Write(begin, end);
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    return writer_->Skip(padding_bytes, padding_value);
+  }
+
+  // Patches previously written data in the underlying writer, which must
+  // support this operation.
+  template <typename T, typename W = Writer,
+            typename = decltype(std::declval<W&>().Patch(
+                std::size_t{}, std::declval<const T*>(),
+                std::declval<const T*>()))>
+  Status<void> Patch(std::size_t position, const T* begin, const T* end) {
+    return writer_->Patch(position, begin, end);
+  }
+
+  // Returns the number of bytes written to the underlying writer. Only
+  // available when the underlying writer supports this operation.
+  template <typename W = Writer,
+            typename = decltype(std::declval<const W&>().size())>
+  std::size_t size() const {
+    return writer_->size();
+  }
+
+  template <typename HandleType>
+  Status<HandleReference> PushHandle(const HandleType& handle) {
+    return writer_->PushHandle(handle);
+  }
+
+  // Looks up the |size| bytes at |data| in the table, returning the index of
+  // the string in |index| if it has been written before in this message.
+  // Otherwise adds the string to the table if it is long enough and the table
+  // has room.
+  InternResult InternString(const void* data, std::size_t size,
+                            std::uint64_t* index) {
+    if (size < min_size_)
+      return InternResult::None;
+
+    const Key key{static_cast<const char*>(data), size};
+    auto search = indices_.find(key);
+    if (search != indices_.end()) {
+      *index = search->second;
+      return InternResult::Found;
+    } else if (strings_.size() >= max_strings_) {
+      return InternResult::None;
+    }
+
+    // The table refers to its own copy of the string.
+    *index = strings_.size();
+    strings_.emplace_back(key.data, key.size);
+    indices_.emplace(Key{strings_.back().data(), size}, *index);
+    return InternResult::Added;
+  }
+
+  // Looks up the object of static type |type| at |object| in the table,
+  // returning its index in |index| if it has been written before in this
+  // message. Otherwise adds the object to the table if the table has room.
+  // The table holds a reference to each object, so that the address of an
+  // object is not reused by another before the table is reset. Only available
+  // when the underlying writer supports Patch(), which definitions require.
+  template <typename W = Writer,
+            typename = decltype(std::declval<W&>().Patch(
+                std::size_t{}, std::declval<const std::uint32_t*>(),
+                std::declval<const std::uint32_t*>()))>
+  InternResult InternObject(std::shared_ptr<const void> object,
+                            const void* type, std::uint64_t* index) {
+    const ObjectKey key{object.get(), type};
+    auto search = object_indices_.find(key);
+    if (search != object_indices_.end()) {
+      *index = search->second;
+      return InternResult::Found;
+    } else if (objects_.size() >= max_strings_) {
+      return InternResult::None;
+    }
+
+    *index = objects_.size();
+    objects_.push_back(std::move(object));
+    object_indices_.emplace(key, *index);
+    return InternResult::Added;
+  }
+
+  // Clears the tables to start a new message.
+  void Reset() {
+    indices_.clear();
+    strings_.clear();
+    object_indices_.clear();
+    objects_.clear();
+  }
+
+  // Returns the number of strings in the table.
+  std::size_t string_count() const { return strings_.size(); }
+
+  // Returns the number of objects in the table.
+  std::size_t object_count() const { return objects_.size(); }
+
+  Writer* writer() const { return writer_; }
+
+ private:
+  struct Key {
+    const char* data;
+    std::size_t size;
+
+    bool operator==(const Key& other) const {
+      return size == other.size && std::memcmp(data, other.data, size) == 0;
+    }
+  };
+
+  // FNV-1a hash of the bytes of a key.
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const {
+      std::uint64_t hash = 0xcbf29ce484222325ull;
+      for (std::size_t i = 0; i < key.size; i++) {
+        hash ^= static_cast<std::uint8_t>(key.data[i]);
+        hash *= 0x100000001b3ull;
+      }
+      return static_cast<std::size_t>(hash);
+    }
+  };
+
+  struct ObjectKey {
+    const void* address;
+    const void* type;
+
+    bool operator==(const ObjectKey& other) const {
+      return address == other.address && type == other.type;
+    }
+  };
+
+  struct ObjectKeyHash {
+    std::size_t operator()(const ObjectKey& key) const {
+      const std::hash<const void*> hash;
+      return hash(key.address) ^ (hash(key.type) * 31);
+    }
+  };
+
+  Writer* writer_;
+  std::size_t min_size_;
+  std::size_t max_strings_;
+  std::deque<std::string> strings_;
+  std::unordered_map<Key, std::uint64_t, KeyHash> indices_;
+  std::vector<std::shared_ptr<const void>> objects_;
+  std::unordered_map<ObjectKey, std::uint64_t, ObjectKeyHash> object_indices_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_INTERNING_WRITER_H_
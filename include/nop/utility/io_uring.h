@@ -0,0 +1,741 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_IO_URING_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_IO_URING_H_
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <nop/base/utility.h>
+#include <nop/status.h>
+
+namespace nop {
+
+//
+// Asynchronous readers and writers over Linux io_uring.
+//
+// IoUring owns a submission and completion queue shared with the kernel,
+// driven with the raw system calls so that no library beyond the kernel
+// headers is needed. Any number of IoUringReader and IoUringWriter instances,
+// usually one of each per connection, share one ring: their reads and writes
+// are queued on the ring and reach the kernel together with the next call to
+// Submit() or Wait(), so one thread can drive many connections with one system
+// call per batch.
+//
+// The ring may register a pool of buffers with the kernel, which readers and
+// writers use with the fixed buffer operations to avoid mapping their buffers
+// on every operation, and a table of files, which readers and writers refer to
+// by index instead of by fd to avoid looking up the file on every operation.
+//
+// Writers fill one buffer while the previous one is being written, and
+// readers read ahead into one buffer while the previous one is decoded. Both
+// only block, by waiting on the ring, when the other buffer is still busy.
+//
+// Readers and writers do not own their fds, and the ring must outlive them.
+//
+// Example:
+//
+//   nop::IoUring ring;
+//   auto status = ring.Setup(256);
+//   if (status)
+//     status = ring.RegisterBuffers(64, 64 * 1024);
+//
+//   nop::Serializer<nop::IoUringWriter> serializer{&ring, socket_fd};
+//   status = serializer.Write(message);  // Queued when the buffer fills.
+//   status = serializer.writer().Flush();
+//   status = ring.Submit();  // Submits the writes of every connection.
+//
+
+// Base of the operations that readers and writers queue on the ring. The ring
+// calls |complete| with the result of the operation when it completes.
+struct IoUringOperation {
+  void (*complete)(IoUringOperation* operation, int result);
+};
+
+class IoUring {
+ public:
+  IoUring() = default;
+  IoUring(const IoUring&) = delete;
+  void operator=(const IoUring&) = delete;
+
+  ~IoUring() { Clear(); }
+
+  // Creates a ring with room for |entries| queued operations.
+  Status<void> Setup(unsigned entries, unsigned flags = 0) {
+    Clear();
+
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = flags;
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0) {
+      fd_ = -1;
+      return ErrorStatus::IOError;
+    }
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+
+    sq_ring_ = Map(sq_size_, IORING_OFF_SQ_RING);
+    cq_ring_ = single_mmap ? sq_ring_ : Map(cq_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(Map(sqes_size_, IORING_OFF_SQES));
+    if (sq_ring_ == nullptr || cq_ring_ == nullptr || sqes_ == nullptr) {
+      Clear();
+      return ErrorStatus::IOError;
+    }
+
+    auto* sq = static_cast<std::uint8_t*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+    auto* cq = static_cast<std::uint8_t*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return {};
+  }
+
+  // Closes the ring. Operations still queued are abandoned.
+  void Clear() {
+    if (sqes_ != nullptr)
+      ::munmap(sqes_, sqes_size_);
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_)
+      ::munmap(cq_ring_, cq_size_);
+    if (sq_ring_ != nullptr)
+      ::munmap(sq_ring_, sq_size_);
+    if (fd_ >= 0)
+      ::close(fd_);
+
+    fd_ = -1;
+    sq_ring_ = cq_ring_ = nullptr;
+    sqes_ = nullptr;
+    queued_ = 0;
+    buffers_.reset();
+    free_buffers_.clear();
+    buffer_size_ = 0;
+  }
+
+  // Allocates |count| buffers of |size| bytes and registers them with the
+  // kernel for readers and writers to use with fixed buffer operations.
+  Status<void> RegisterBuffers(std::size_t count, std::size_t size) {
+    if (fd_ < 0 || buffers_)
+      return ErrorStatus::IOError;
+
+    std::unique_ptr<std::uint8_t[]> buffers{new std::uint8_t[count * size]};
+    std::vector<iovec> vecs(count);
+    for (std::size_t i = 0; i < count; i++)
+      vecs[i] = {&buffers[i * size], size};
+
+    if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS,
+                  vecs.data(), static_cast<unsigned>(count)) < 0) {
+      return ErrorStatus::IOError;
+    }
+
+    buffers_ = std::move(buffers);
+    buffer_size_ = size;
+    free_buffers_.clear();
+    for (std::size_t i = count; i > 0; i--)
+      free_buffers_.push_back(static_cast<int>(i - 1));
+    return {};
+  }
+
+  // Registers a table of files, which readers and writers refer to by index
+  // when constructed with |fixed_file| set.
+  Status<void> RegisterFiles(const int* fds, unsigned count) {
+    if (fd_ < 0 ||
+        ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_FILES, fds,
+                  count) < 0) {
+      return ErrorStatus::IOError;
+    }
+    return {};
+  }
+
+  // Takes a registered buffer from the pool, returning its index, or -1 if
+  // there are none left.
+  int AcquireBuffer() {
+    if (free_buffers_.empty())
+      return -1;
+
+    const int index = free_buffers_.back();
+    free_buffers_.pop_back();
+    return index;
+  }
+
+  void ReleaseBuffer(int index) {
+    if (index >= 0)
+      free_buffers_.push_back(index);
+  }
+
+  std::uint8_t* buffer(int index) const {
+    return &buffers_[static_cast<std::size_t>(index) * buffer_size_];
+  }
+  std::size_t buffer_size() const { return buffer_size_; }
+
+  // Returns a cleared submission queue entry for |operation|, submitting the
+  // queued entries first if the queue is full. The entry is submitted by the
+  // next call to Submit() or Wait().
+  Status<io_uring_sqe*> Queue(IoUringOperation* operation) {
+    if (fd_ < 0)
+      return ErrorStatus::IOError;
+
+    unsigned tail = *sq_tail_;
+    if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == sq_entries_) {
+      auto status = Enter(0, 0);
+      if (!status)
+        return status.error();
+      if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == sq_entries_)
+        return ErrorStatus::IOError;
+    }
+
+    const unsigned index = tail & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = reinterpret_cast<std::uint64_t>(operation);
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    queued_++;
+    return sqe;
+  }
+
+  // Submits the queued entries without waiting and runs the completions
+  // already available.
+  Status<void> Submit() {
+    auto status = Enter(0, 0);
+    if (!status)
+      return status;
+
+    ProcessCompletions();
+    return {};
+  }
+
+  // Submits the queued entries and waits for at least one completion, then
+  // runs the available completions.
+  Status<void> Wait() {
+    auto status = Enter(1, IORING_ENTER_GETEVENTS);
+    if (!status)
+      return status;
+
+    ProcessCompletions();
+    return {};
+  }
+
+  // Runs the available completions, returning the number run.
+  std::size_t ProcessCompletions() {
+    if (fd_ < 0)
+      return 0;
+
+    std::size_t count = 0;
+    unsigned head = *cq_head_;
+    while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+      const io_uring_cqe cqe = cqes_[head & cq_mask_];
+      __atomic_store_n(cq_head_, ++head, __ATOMIC_RELEASE);
+
+      auto* operation = reinterpret_cast<IoUringOperation*>(cqe.user_data);
+      if (operation != nullptr)
+        operation->complete(operation, cqe.res);
+      count++;
+    }
+    return count;
+  }
+
+  int fd() const { return fd_; }
+
+  // Returns the number of entries queued since the last submission.
+  unsigned queued() const { return queued_; }
+
+ private:
+  void* Map(std::size_t size, off_t offset) {
+    void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd_, offset);
+    return address == MAP_FAILED ? nullptr : address;
+  }
+
+  Status<void> Enter(unsigned min_complete, unsigned flags) {
+    if (fd_ < 0)
+      return ErrorStatus::IOError;
+
+    while (true) {
+      const long ret = ::syscall(__NR_io_uring_enter, fd_, queued_,
+                                 min_complete, flags, nullptr, 0);
+      if (ret >= 0) {
+        queued_ -= std::min(queued_, static_cast<unsigned>(ret));
+        return {};
+      } else if (errno != EINTR) {
+        return ErrorStatus::IOError;
+      }
+    }
+  }
+
+  int fd_{-1};
+  void* sq_ring_{nullptr};
+  void* cq_ring_{nullptr};
+  io_uring_sqe* sqes_{nullptr};
+  std::size_t sq_size_{0};
+  std::size_t cq_size_{0};
+  std::size_t sqes_size_{0};
+
+  unsigned* sq_head_{nullptr};
+  unsigned* sq_tail_{nullptr};
+  unsigned* sq_array_{nullptr};
+  unsigned sq_mask_{0};
+  unsigned sq_entries_{0};
+  unsigned* cq_head_{nullptr};
+  unsigned* cq_tail_{nullptr};
+  unsigned cq_mask_{0};
+  io_uring_cqe* cqes_{nullptr};
+  unsigned queued_{0};
+
+  std::unique_ptr<std::uint8_t[]> buffers_;
+  std::size_t buffer_size_{0};
+  std::vector<int> free_buffers_;
+};
+
+namespace detail {
+
+// One of the two buffers of a reader or writer, taken from the registered
+// pool of the ring when possible.
+struct IoUringBuffer : IoUringOperation {
+  void* owner{nullptr};
+  std::uint8_t* data{nullptr};
+  std::size_t capacity{0};
+  std::size_t size{0};
+  std::size_t offset{0};
+  int index{-1};
+  bool in_flight{false};
+  std::unique_ptr<std::uint8_t[]> storage;
+
+  void Acquire(IoUring* ring, std::size_t default_size) {
+    index = ring->AcquireBuffer();
+    if (index >= 0) {
+      data = ring->buffer(index);
+      capacity = ring->buffer_size();
+    } else {
+      storage.reset(new std::uint8_t[default_size]);
+      data = storage.get();
+      capacity = default_size;
+    }
+  }
+
+  void Release(IoUring* ring) {
+    ring->ReleaseBuffer(index);
+    index = -1;
+    storage.reset();
+    data = nullptr;
+    capacity = size = offset = 0;
+  }
+
+  // Prepares |sqe| to transfer the bytes of this buffer from |begin| to |end|.
+  void Prepare(io_uring_sqe* sqe, int fd, bool fixed_file, bool write,
+               std::size_t begin, std::size_t end) const {
+    if (index >= 0) {
+      sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+      sqe->buf_index = static_cast<std::uint16_t>(index);
+    } else {
+      sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    sqe->fd = fd;
+    sqe->flags = fixed_file ? IOSQE_FIXED_FILE : 0;
+    sqe->off = ~std::uint64_t{0};  // The current file position.
+    sqe->addr = reinterpret_cast<std::uint64_t>(data + begin);
+    sqe->len = static_cast<std::uint32_t>(end - begin);
+  }
+};
+
+}  // namespace detail
+
+// Writer type that writes to a file through an IoUring. Bytes are collected in
+// the current buffer, which is queued for writing when it fills or when the
+// writer is flushed, while the other buffer collects the following bytes. A
+// short write is continued from the completion. Errors are reported by the
+// next write after they happen.
+class IoUringWriter {
+ public:
+  enum : std::size_t { kDefaultBufferSize = 4096 };
+
+  // Writes to |fd|, which is an index into the files registered with the ring
+  // when |fixed_file| is true.
+  IoUringWriter(IoUring* ring, int fd, bool fixed_file = false,
+                std::size_t buffer_size = kDefaultBufferSize)
+      : ring_{ring}, fd_{fd}, fixed_file_{fixed_file} {
+    for (auto& buffer : buffers_) {
+      buffer.owner = this;
+      buffer.complete = &OnComplete;
+      buffer.Acquire(ring_, buffer_size);
+    }
+  }
+
+  IoUringWriter(const IoUringWriter&) = delete;
+  void operator=(const IoUringWriter&) = delete;
+
+  ~IoUringWriter() {
+    Finish();
+    for (auto& buffer : buffers_)
+      buffer.Release(ring_);
+  }
+
+  Status<void> Prepare(std::size_t size) {
+    if (!status_)
+      return status_;
+
+    detail::IoUringBuffer& buffer = buffers_[current_];
+    if (size > buffer.capacity - buffer.size && buffer.size != 0)
+      return Flush();
+    else
+      return {};
+  }
+
+  Status<void> Write(std::uint8_t byte) { return Write(&byte, &byte + 1); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    const auto* bytes = reinterpret_cast<const std::uint8_t*>(begin);
+    std::size_t length_bytes = (end - begin) * sizeof(T);
+    while (length_bytes != 0) {
+      auto status = Reserve();
+      if (!status)
+        return status;
+
+      detail::IoUringBuffer& buffer = buffers_[current_];
+      const std::size_t count =
+          std::min(length_bytes, buffer.capacity - buffer.size);
+      std::memcpy(buffer.data + buffer.size, bytes, count);
+      buffer.size += count;
+      bytes += count;
+      length_bytes -= count;
+    }
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    while (padding_bytes != 0) {
+      auto status = Reserve();
+      if (!status)
+        return status;
+
+      detail::IoUringBuffer& buffer = buffers_[current_];
+      const std::size_t count =
+          std::min(padding_bytes, buffer.capacity - buffer.size);
+      std::memset(buffer.data + buffer.size, padding_value, count);
+      buffer.size += count;
+      padding_bytes -= count;
+    }
+    return {};
+  }
+
+  // Queues the bytes collected so far for writing, waiting for the previous
+  // write to finish first if it is still in progress. The write reaches the
+  // kernel with the next submission on the ring.
+  Status<void> Flush() {
+    detail::IoUringBuffer& buffer = buffers_[current_];
+    if (buffer.size == 0)
+      return status_;
+
+    detail::IoUringBuffer& other = buffers_[current_ ^ 1];
+    while (other.in_flight && status_) {
+      auto status = ring_->Wait();
+      if (!status)
+        return status;
+    }
+    if (!status_)
+      return status_;
+
+    buffer.offset = 0;
+    auto status = QueueWrite(&buffer);
+    if (!status)
+      return status;
+
+    current_ ^= 1;
+    return {};
+  }
+
+  // Flushes the writer and waits for every queued write to finish.
+  Status<void> Finish() {
+    auto status = Flush();
+    while (status && Busy()) {
+      status = ring_->Wait();
+    }
+    return status ? status_ : status;
+  }
+
+  // Returns true while a write is queued or in progress.
+  bool Busy() const { return buffers_[0].in_flight || buffers_[1].in_flight; }
+
+  // Returns the number of bytes collected and not yet queued.
+  std::size_t buffered() const { return buffers_[current_].size; }
+
+  int fd() const { return fd_; }
+
+ private:
+  // Makes room in the current buffer, flushing it if it is full.
+  Status<void> Reserve() {
+    if (!status_)
+      return status_;
+
+    detail::IoUringBuffer& buffer = buffers_[current_];
+    if (buffer.size == buffer.capacity)
+      return Flush();
+    else
+      return {};
+  }
+
+  Status<void> QueueWrite(detail::IoUringBuffer* buffer) {
+    auto sqe = ring_->Queue(buffer);
+    if (!sqe)
+      return sqe.error();
+
+    buffer->Prepare(sqe.get(), fd_, fixed_file_, true, buffer->offset,
+                    buffer->size);
+    buffer->in_flight = true;
+    return {};
+  }
+
+  static void OnComplete(IoUringOperation* operation, int result) {
+    auto* buffer = static_cast<detail::IoUringBuffer*>(operation);
+    auto* self = static_cast<IoUringWriter*>(buffer->owner);
+
+    if (result == -EINTR || result == -EAGAIN) {
+      result = 0;
+    } else if (result < 0) {
+      buffer->in_flight = false;
+      buffer->size = 0;
+      self->status_ = ErrorStatus::IOError;
+      return;
+    }
+
+    buffer->offset += static_cast<std::size_t>(result);
+    if (buffer->offset < buffer->size) {
+      auto status = self->QueueWrite(buffer);
+      if (status)
+        return;
+      self->status_ = status;
+    }
+
+    buffer->in_flight = false;
+    buffer->size = 0;
+  }
+
+  IoUring* ring_;
+  int fd_;
+  bool fixed_file_;
+  detail::IoUringBuffer buffers_[2];
+  std::size_t current_{0};
+  Status<void> status_;
+};
+
+// Reader type that reads from a file through an IoUring. While the reader
+// consumes the current buffer, the next read is already queued into the other
+// buffer, so decoding overlaps with the read. Reads block, by waiting on the
+// ring, only when the next buffer has not been filled yet.
+class IoUringReader {
+ public:
+  enum : std::size_t { kDefaultBufferSize = 4096 };
+
+  // Reads from |fd|, which is an index into the files registered with the
+  // ring when |fixed_file| is true.
+  IoUringReader(IoUring* ring, int fd, bool fixed_file = false,
+                std::size_t buffer_size = kDefaultBufferSize)
+      : ring_{ring}, fd_{fd}, fixed_file_{fixed_file} {
+    for (auto& buffer : buffers_) {
+      buffer.owner = this;
+      buffer.complete = &OnComplete;
+      buffer.Acquire(ring_, buffer_size);
+    }
+  }
+
+  IoUringReader(const IoUringReader&) = delete;
+  void operator=(const IoUringReader&) = delete;
+
+  // Cancels the read ahead, if any, and waits for it to finish.
+  ~IoUringReader() {
+    for (auto& buffer : buffers_) {
+      if (buffer.in_flight) {
+        auto sqe = ring_->Queue(nullptr);
+        if (sqe) {
+          sqe.get()->opcode = IORING_OP_ASYNC_CANCEL;
+          sqe.get()->addr = reinterpret_cast<std::uint64_t>(
+              static_cast<IoUringOperation*>(&buffer));
+        }
+      }
+      while (buffer.in_flight && ring_->Wait()) {
+      }
+      buffer.Release(ring_);
+    }
+  }
+
+  // Queues the first read ahead without waiting for it, for callers that
+  // start many readers before waiting on the ring.
+  Status<void> Start() {
+    detail::IoUringBuffer& other = buffers_[next()];
+    if (!other.in_flight && other.offset == other.size && !ended_ && status_)
+      return QueueRead(&other);
+    else
+      return {};
+  }
+
+  // Data arrives as it is read, so there is nothing to check ahead of time.
+  Status<void> Ensure(std::size_t /*size*/) { return {}; }
+
+  Status<void> Read(std::uint8_t* byte) { return Read(byte, byte + 1); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Read(T* begin, T* end) {
+    auto* bytes = reinterpret_cast<std::uint8_t*>(begin);
+    std::size_t length_bytes = (end - begin) * sizeof(T);
+    while (length_bytes != 0) {
+      auto status = Fill();
+      if (!status)
+        return status;
+
+      detail::IoUringBuffer& buffer = buffers_[current_];
+      const std::size_t count =
+          std::min(length_bytes, buffer.size - buffer.offset);
+      std::memcpy(bytes, buffer.data + buffer.offset, count);
+      buffer.offset += count;
+      bytes += count;
+      length_bytes -= count;
+    }
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    while (padding_bytes != 0) {
+      auto status = Fill();
+      if (!status)
+        return status;
+
+      detail::IoUringBuffer& buffer = buffers_[current_];
+      const std::size_t count =
+          std::min(padding_bytes, buffer.size - buffer.offset);
+      buffer.offset += count;
+      padding_bytes -= count;
+    }
+    return {};
+  }
+
+  // Returns the number of bytes read and not yet consumed, which may be
+  // decoded without waiting.
+  std::size_t buffered() const {
+    const detail::IoUringBuffer& buffer = buffers_[current_];
+    const detail::IoUringBuffer& other = buffers_[next()];
+    return buffer.size - buffer.offset +
+           (other.in_flight ? 0 : other.size - other.offset);
+  }
+
+  int fd() const { return fd_; }
+
+ private:
+  std::size_t next() const { return current_ ^ 1; }
+
+  // Makes the current buffer hold unread bytes, switching to the next buffer
+  // and waiting for its read if necessary. The buffer given up is queued for
+  // the next read ahead.
+  Status<void> Fill() {
+    detail::IoUringBuffer* buffer = &buffers_[current_];
+    while (buffer->offset == buffer->size) {
+      auto status = Start();
+      if (!status)
+        return status;
+
+      detail::IoUringBuffer& other = buffers_[next()];
+      while (other.in_flight && status_) {
+        status = ring_->Wait();
+        if (!status)
+          return status;
+      }
+      if (other.offset == other.size) {
+        if (!status_)
+          return status_;
+        else if (ended_)
+          return ErrorStatus::ReadLimitReached;
+        continue;
+      }
+
+      buffer->size = buffer->offset = 0;
+      current_ = next();
+      buffer = &buffers_[current_];
+      if (!ended_ && status_) {
+        status = QueueRead(&buffers_[next()]);
+        if (!status)
+          return status;
+      }
+    }
+    return {};
+  }
+
+  Status<void> QueueRead(detail::IoUringBuffer* buffer) {
+    auto sqe = ring_->Queue(buffer);
+    if (!sqe)
+      return sqe.error();
+
+    buffer->size = buffer->offset = 0;
+    buffer->Prepare(sqe.get(), fd_, fixed_file_, false, 0, buffer->capacity);
+    buffer->in_flight = true;
+    return {};
+  }
+
+  static void OnComplete(IoUringOperation* operation, int result) {
+    auto* buffer = static_cast<detail::IoUringBuffer*>(operation);
+    auto* self = static_cast<IoUringReader*>(buffer->owner);
+    buffer->in_flight = false;
+
+    if (result == -EINTR || result == -EAGAIN) {
+      // Retried by the next fill.
+    } else if (result == -ECANCELED) {
+      self->ended_ = true;
+    } else if (result < 0) {
+      self->status_ = ErrorStatus::IOError;
+    } else if (result == 0) {
+      self->ended_ = true;
+    } else {
+      buffer->size = static_cast<std::size_t>(result);
+    }
+  }
+
+  IoUring* ring_;
+  int fd_;
+  bool fixed_file_;
+  detail::IoUringBuffer buffers_[2];
+  std::size_t current_{0};
+  bool ended_{false};
+  Status<void> status_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_IO_URING_H_
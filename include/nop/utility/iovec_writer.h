@@ -0,0 +1,219 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_IOVEC_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_IOVEC_WRITER_H_
+
+#include <errno.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <nop/status.h>
+#include <nop/types/shared_frame.h>
+
+namespace nop {
+
+// IovecWriter is a writer type that builds a scatter/gather list for the
+// encoded output instead of a contiguous buffer. Small writes, such as the
+// prefixes and integers that make up most encodings, are accumulated in an
+// internal scratch buffer. Contiguous payloads at least |threshold| bytes long,
+// such as the contents of large strings, binary containers, and arrays of
+// integral types, are referenced in place without copying.
+//
+// The resulting list may be written to a file descriptor in one call with
+// WriteTo(), or passed to writev() or sendmsg() through iovecs(). Because
+// large payloads are referenced rather than copied, the serialized values must
+// outlive the writer, or at least remain unmodified until the output is
+// written and the writer is cleared. Large SharedFrames are referenced in the
+// same way, and the writer keeps a reference to each of them until it is
+// cleared, so that frames need not outlive the writer.
+//
+// Example:
+//
+//   nop::Serializer<nop::IovecWriter> serializer;
+//   serializer.Write(message);
+//   serializer.writer().WriteTo(fd);
+//   serializer.writer().clear();
+//
+class IovecWriter {
+ public:
+  enum : std::size_t { kDefaultThreshold = 4096 };
+
+  // Writes go to the scratch buffer or the list of references, which grow on
+  // demand, so there is no need to compute the size of each value ahead of
+  // time.
+  using SkipPrepare = void;
+
+  IovecWriter() = default;
+  explicit IovecWriter(std::size_t threshold)
+      : threshold_{std::max<std::size_t>(threshold, 1)} {}
+  IovecWriter(const IovecWriter&) = default;
+  IovecWriter(IovecWriter&&) = default;
+
+  IovecWriter& operator=(const IovecWriter&) = default;
+  IovecWriter& operator=(IovecWriter&&) = default;
+
+  Status<void> Prepare(std::size_t /*size*/) { return {}; }
+
+  Status<void> Write(std::uint8_t byte) {
+    scratch_.push_back(byte);
+    size_ += 1;
+    return {};
+  }
+
+  Status<void> Write(const void* begin, const void* end) {
+    const std::uint8_t* begin_byte = static_cast<const std::uint8_t*>(begin);
+    const std::uint8_t* end_byte = static_cast<const std::uint8_t*>(end);
+    const std::size_t length_bytes = end_byte - begin_byte;
+
+    if (length_bytes >= threshold_) {
+      FinishScratchSegment();
+      segments_.push_back({begin_byte, 0, length_bytes});
+    } else {
+      scratch_.insert(scratch_.end(), begin_byte, end_byte);
+    }
+
+    size_ += length_bytes;
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    scratch_.insert(scratch_.end(), padding_bytes, padding_value);
+    size_ += padding_bytes;
+    return {};
+  }
+
+  Status<void> WriteFrame(const SharedFrame& frame) {
+    if (frame.size() >= threshold_)
+      frames_.push_back(frame);
+    return Write(frame.begin(), frame.end());
+  }
+
+  // Returns the scatter/gather list for the output written so far. The list is
+  // invalidated by subsequent writes.
+  const std::vector<iovec>& iovecs() { return BuildIovecs(); }
+
+  // Writes the output to |fd| with as few calls to writev() as possible,
+  // handling partial writes.
+  Status<void> WriteTo(int fd) {
+    std::vector<iovec>& vec = BuildIovecs();
+    std::size_t index = 0;
+
+    while (index < vec.size()) {
+      const int count = static_cast<int>(
+          std::min<std::size_t>(vec.size() - index, IOV_MAX));
+      const ssize_t ret = ::writev(fd, &vec[index], count);
+      if (ret > 0) {
+        std::size_t written = static_cast<std::size_t>(ret);
+        while (written > 0) {
+          const std::size_t consumed = std::min(written, vec[index].iov_len);
+          vec[index].iov_base =
+              static_cast<std::uint8_t*>(vec[index].iov_base) + consumed;
+          vec[index].iov_len -= consumed;
+          written -= consumed;
+          if (vec[index].iov_len == 0)
+            index++;
+        }
+      } else if (ret == 0) {
+        return ErrorStatus::WriteLimitReached;
+      } else if (errno != EINTR) {
+        return ErrorStatus::IOError;
+      }
+    }
+
+    return {};
+  }
+
+  // Discards the output, keeping the capacity of the internal buffers so that a
+  // long-lived writer does not allocate in steady state.
+  void clear() {
+    scratch_.clear();
+    segments_.clear();
+    iovecs_.clear();
+    frames_.clear();
+    scratch_begin_ = 0;
+    size_ = 0;
+  }
+
+  // Returns true if the entry at |index| in the list returned by iovecs()
+  // references a payload in place rather than the scratch buffer. Referenced
+  // payloads other than frames belong to the caller and remain valid after the
+  // writer is cleared.
+  bool references(std::size_t index) const {
+    return segments_[index].external != nullptr;
+  }
+
+  // Returns the total number of bytes written, including referenced payloads.
+  std::size_t size() const { return size_; }
+
+  // Returns the number of bytes copied into the scratch buffer.
+  std::size_t scratch_size() const { return scratch_.size(); }
+
+  std::size_t threshold() const { return threshold_; }
+
+ private:
+  // A run of output that is either a range of the scratch buffer or an
+  // external payload. Scratch ranges are stored as offsets because the scratch
+  // buffer may be reallocated as it grows.
+  struct Segment {
+    const std::uint8_t* external;
+    std::size_t offset;
+    std::size_t length;
+  };
+
+  // Rebuilds the scatter/gather list from the segments written so far.
+  std::vector<iovec>& BuildIovecs() {
+    FinishScratchSegment();
+
+    iovecs_.clear();
+    for (const Segment& segment : segments_) {
+      const std::uint8_t* base =
+          segment.external ? segment.external : &scratch_[segment.offset];
+      iovecs_.push_back({const_cast<std::uint8_t*>(base), segment.length});
+    }
+
+    return iovecs_;
+  }
+
+  // Adds a segment for the scratch data written since the last segment.
+  void FinishScratchSegment() {
+    if (scratch_begin_ < scratch_.size()) {
+      segments_.push_back(
+          {nullptr, scratch_begin_, scratch_.size() - scratch_begin_});
+      scratch_begin_ = scratch_.size();
+    }
+  }
+
+  std::size_t threshold_{kDefaultThreshold};
+  std::vector<std::uint8_t> scratch_;
+  std::vector<Segment> segments_;
+  std::vector<iovec> iovecs_;
+  std::vector<SharedFrame> frames_;
+  std::size_t scratch_begin_{0};
+  std::size_t size_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_IOVEC_WRITER_H_
@@ -0,0 +1,670 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_JSON_TRANSCODER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_JSON_TRANSCODER_H_
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include <nop/base/encoding.h>
+#include <nop/status.h>
+#include <nop/utility/bounded_reader.h>
+#include <nop/utility/endian.h>
+
+namespace nop {
+
+//
+// Schema-less transcoding of encoded values to JSON. TranscodeToJson() reads
+// one encoded value from a reader and writes it as JSON text to a writer,
+// driven only by the prefixes in the input, without materializing the value
+// or knowing its C++ type. This renders messages for logs and debugging at
+// close to the speed the input can be scanned.
+//
+// Values map to JSON as follows:
+//
+//   integers and floats  numbers; non-finite floats become null
+//   STR                  strings, with the bytes passed through as UTF-8
+//   BIN                  base64 strings; packed arrays of integers or floats
+//                        are encoded as BIN and so transcode this way too
+//   ARY, STU             arrays; structure members are not named
+//   MAP                  objects; integer keys are quoted, other keys that are
+//                        not strings are rejected
+//   TAB                  objects keyed by entry id
+//   VAR                  {"index":INDEX,"value":VALUE}
+//   HND                  {"type":TYPE,"handle":REF}
+//   ERR                  {"error":CODE}
+//   EXT                  {"extension":CODE,"data":BASE64}
+//   NIL                  null
+//
+// Strings are escaped a word at a time, copying runs of bytes that need no
+// escaping in one step. Readers over contiguous memory, such as BufferReader,
+// have string and binary payloads transcoded in place; other readers are read
+// through a small stack buffer. Output is staged in a small buffer and written
+// to the writer in large runs.
+//
+// Nesting deeper than |max_depth| fails with ErrorStatus::ProtocolError, so
+// that hostile input cannot exhaust the stack. As when decoding, use a reader
+// that checks every read, such as PedanticBufferReader, for untrusted input.
+//
+// Example:
+//
+//   nop::BufferReader reader{data, size};
+//   nop::StreamWriter<std::ostringstream> writer;
+//   auto status = nop::TranscodeToJson(&reader, &writer);
+//
+template <typename Writer>
+class JsonTranscoder {
+ public:
+  enum : std::size_t { kDefaultMaxDepth = 64 };
+
+  JsonTranscoder(Writer* writer, std::size_t max_depth = kDefaultMaxDepth)
+      : writer_{writer}, max_depth_{max_depth} {}
+
+  JsonTranscoder(const JsonTranscoder&) = delete;
+  void operator=(const JsonTranscoder&) = delete;
+
+  // Transcodes the next value from |reader| and flushes the output.
+  template <typename Reader>
+  Status<void> Transcode(Reader* reader) {
+    auto status = Value(reader, 0);
+    if (!status)
+      return status;
+
+    return Flush();
+  }
+
+ private:
+  enum : std::size_t { kBufferSize = 512, kChunkSize = 240 };
+
+  template <typename Reader>
+  Status<void> Value(Reader* reader, std::size_t depth) {
+    if (depth > max_depth_)
+      return ErrorStatus::ProtocolError;
+
+    std::uint8_t prefix_byte = 0;
+    auto status = reader->Read(&prefix_byte);
+    if (!status)
+      return status;
+
+    switch (static_cast<EncodingByte>(prefix_byte)) {
+      case EncodingByte::F32:
+        return Float<float>(reader, "%.9g");
+      case EncodingByte::F64:
+        return Float<double>(reader, "%.17g");
+
+      case EncodingByte::String:
+        return String(reader);
+      case EncodingByte::Binary:
+        return Binary(reader);
+
+      case EncodingByte::Array:
+      case EncodingByte::Structure:
+        return Array(reader, depth);
+      case EncodingByte::Map:
+        return Map(reader, depth);
+      case EncodingByte::Table:
+        return Table(reader, depth);
+
+      case EncodingByte::Variant:
+        Put("{\"index\":");
+        status = Integer(reader);
+        if (!status)
+          return status;
+
+        Put(",\"value\":");
+        status = Value(reader, depth + 1);
+        if (!status)
+          return status;
+
+        Put('}');
+        return {};
+
+      case EncodingByte::Handle:
+        Put("{\"type\":");
+        status = Integer(reader);
+        if (!status)
+          return status;
+
+        Put(",\"handle\":");
+        status = Integer(reader);
+        if (!status)
+          return status;
+
+        Put('}');
+        return {};
+
+      case EncodingByte::Error:
+        Put("{\"error\":");
+        status = Integer(reader);
+        if (!status)
+          return status;
+
+        Put('}');
+        return {};
+
+      case EncodingByte::Extension:
+        Put("{\"extension\":");
+        status = Integer(reader);
+        if (!status)
+          return status;
+
+        Put(",\"data\":");
+        status = Binary(reader);
+        if (!status)
+          return status;
+
+        Put('}');
+        return {};
+
+      case EncodingByte::Nil:
+        Put("null");
+        return {};
+
+      default:
+        return IntegerPayload(prefix_byte, reader);
+    }
+  }
+
+  // Transcodes an integer of any size, such as a variant index.
+  template <typename Reader>
+  Status<void> Integer(Reader* reader) {
+    std::uint8_t prefix_byte = 0;
+    auto status = reader->Read(&prefix_byte);
+    if (!status)
+      return status;
+
+    return IntegerPayload(prefix_byte, reader);
+  }
+
+  // Transcodes the payload of an integer with the given prefix, failing if
+  // the prefix is not an integer prefix.
+  template <typename Reader>
+  Status<void> IntegerPayload(std::uint8_t prefix_byte, Reader* reader) {
+    switch (static_cast<EncodingByte>(prefix_byte)) {
+      case EncodingByte::U8:
+        return Unsigned<std::uint8_t>(reader);
+      case EncodingByte::U16:
+        return Unsigned<std::uint16_t>(reader);
+      case EncodingByte::U32:
+        return Unsigned<std::uint32_t>(reader);
+      case EncodingByte::U64:
+        return Unsigned<std::uint64_t>(reader);
+      case EncodingByte::I8:
+        return Signed<std::int8_t>(reader);
+      case EncodingByte::I16:
+        return Signed<std::int16_t>(reader);
+      case EncodingByte::I32:
+        return Signed<std::int32_t>(reader);
+      case EncodingByte::I64:
+        return Signed<std::int64_t>(reader);
+      default:
+        break;
+    }
+
+    const EncodingByte prefix = static_cast<EncodingByte>(prefix_byte);
+    if (prefix <= EncodingByte::PositiveFixIntMax)
+      PutUnsigned(prefix_byte);
+    else if (prefix >= EncodingByte::NegativeFixIntMin)
+      PutSigned(static_cast<std::int8_t>(prefix_byte));
+    else
+      return ErrorStatus::UnexpectedEncodingType;
+
+    return {};
+  }
+
+  template <typename T, typename Reader>
+  static Status<T> ReadPayload(Reader* reader) {
+    T value = 0;
+    auto status = reader->Read(&value, &value + 1);
+    if (!status)
+      return status.error();
+
+    FromLittleEndian(&value, &value + 1);
+    return value;
+  }
+
+  template <typename T, typename Reader>
+  Status<void> Unsigned(Reader* reader) {
+    auto value = ReadPayload<T>(reader);
+    if (!value)
+      return value.error();
+
+    PutUnsigned(value.get());
+    return {};
+  }
+
+  template <typename T, typename Reader>
+  Status<void> Signed(Reader* reader) {
+    auto value = ReadPayload<T>(reader);
+    if (!value)
+      return value.error();
+
+    PutSigned(value.get());
+    return {};
+  }
+
+  template <typename T, typename Reader>
+  Status<void> Float(Reader* reader, const char* format) {
+    auto value = ReadPayload<T>(reader);
+    if (!value)
+      return value.error();
+
+    // Integral values, which are common in practice, skip the much slower
+    // general formatting.
+    const T number = value.get();
+    const T kMaxExact = static_cast<T>(std::uint64_t{1}
+                                       << std::numeric_limits<T>::digits);
+    if (!std::isfinite(number)) {
+      Put("null");
+    } else if (number > -kMaxExact && number < kMaxExact &&
+               number == static_cast<T>(static_cast<std::int64_t>(number))) {
+      if (number == 0 && std::signbit(number))
+        Put('-');
+      PutSigned(static_cast<std::int64_t>(number));
+    } else {
+      char buffer[32];
+      const int length = std::snprintf(buffer, sizeof(buffer), format,
+                                       static_cast<double>(number));
+      Put(buffer, static_cast<std::size_t>(length));
+    }
+    return {};
+  }
+
+  // Reads the size of a container, string, or binary payload.
+  template <typename Reader>
+  static Status<std::size_t> ReadSize(Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status.error();
+    else if (size > std::numeric_limits<std::size_t>::max())
+      return ErrorStatus::ReadLimitReached;
+
+    return static_cast<std::size_t>(size);
+  }
+
+  template <typename Reader>
+  Status<void> Array(Reader* reader, std::size_t depth) {
+    auto count = ReadSize(reader);
+    if (!count)
+      return count.error();
+
+    Put('[');
+    for (std::size_t i = 0; i < count.get(); i++) {
+      if (i != 0)
+        Put(',');
+
+      auto status = Value(reader, depth + 1);
+      if (!status)
+        return status;
+    }
+    Put(']');
+    return {};
+  }
+
+  template <typename Reader>
+  Status<void> Map(Reader* reader, std::size_t depth) {
+    auto count = ReadSize(reader);
+    if (!count)
+      return count.error();
+
+    Put('{');
+    for (std::size_t i = 0; i < count.get(); i++) {
+      if (i != 0)
+        Put(',');
+
+      auto status = Key(reader);
+      if (!status)
+        return status;
+
+      Put(':');
+      status = Value(reader, depth + 1);
+      if (!status)
+        return status;
+    }
+    Put('}');
+    return {};
+  }
+
+  // Transcodes a map key, which must be a string or an integer. Integer keys
+  // are quoted, since JSON object keys are strings.
+  template <typename Reader>
+  Status<void> Key(Reader* reader) {
+    std::uint8_t prefix_byte = 0;
+    auto status = reader->Read(&prefix_byte);
+    if (!status)
+      return status;
+    else if (static_cast<EncodingByte>(prefix_byte) == EncodingByte::String)
+      return String(reader);
+
+    Put('"');
+    status = IntegerPayload(prefix_byte, reader);
+    if (!status)
+      return status;
+
+    Put('"');
+    return {};
+  }
+
+  // Transcodes the active entries of a table. Each entry value is read within
+  // the size of its entry, skipping any padding that follows it.
+  template <typename Reader>
+  Status<void> Table(Reader* reader, std::size_t depth) {
+    std::uint64_t hash = 0;
+    auto status = Encoding<std::uint64_t>::Read(&hash, reader);
+    if (!status)
+      return status;
+
+    auto count = ReadSize(reader);
+    if (!count)
+      return count.error();
+
+    Put('{');
+    for (std::size_t i = 0; i < count.get(); i++) {
+      if (i != 0)
+        Put(',');
+
+      std::uint64_t id = 0;
+      status = Encoding<std::uint64_t>::Read(&id, reader);
+      if (!status)
+        return status;
+
+      Put('"');
+      PutUnsigned(id);
+      Put("\":");
+
+      auto size = ReadSize(reader);
+      if (!size)
+        return size.error();
+
+      BoundedReaderScope<Reader> scope{reader, size.get()};
+      status = scope.status();
+      if (!status)
+        return status;
+
+      status = Value(scope.reader(), depth + 1);
+      if (!status)
+        return status;
+
+      status = scope.ReadPadding();
+      if (!status)
+        return status;
+    }
+    Put('}');
+    return {};
+  }
+
+  template <typename Reader>
+  Status<void> String(Reader* reader) {
+    auto size = ReadSize(reader);
+    if (!size)
+      return size.error();
+
+    Put('"');
+    auto status = Payload(size.get(), reader, &JsonTranscoder::PutEscaped);
+    if (!status)
+      return status;
+
+    Put('"');
+    return {};
+  }
+
+  template <typename Reader>
+  Status<void> Binary(Reader* reader) {
+    auto size = ReadSize(reader);
+    if (!size)
+      return size.error();
+
+    Put('"');
+    auto status = Payload(size.get(), reader, &JsonTranscoder::PutBase64);
+    if (!status)
+      return status;
+
+    Put('"');
+    return {};
+  }
+
+  using PayloadFunction = void (JsonTranscoder::*)(const std::uint8_t*,
+                                                   std::size_t);
+
+  // Passes |size| bytes of payload to |function|, in place when the reader is
+  // over contiguous memory and in chunks otherwise. Chunks are a multiple of
+  // three bytes, so that base64 output is not padded between chunks.
+  template <typename Reader>
+  Status<void> Payload(std::size_t size, Reader* reader,
+                       PayloadFunction function) {
+    return Payload(size, reader, function, IsContiguousReader<Reader>{});
+  }
+
+  template <typename Reader>
+  Status<void> Payload(std::size_t size, Reader* reader,
+                       PayloadFunction function, std::true_type) {
+    auto data = reader->Borrow(size);
+    if (!data)
+      return data.error();
+
+    (this->*function)(data.get(), size);
+    return {};
+  }
+
+  template <typename Reader>
+  Status<void> Payload(std::size_t size, Reader* reader,
+                       PayloadFunction function, std::false_type) {
+    auto status = reader->Ensure(size);
+    if (!status)
+      return status;
+
+    std::uint8_t chunk[kChunkSize];
+    while (size > 0) {
+      const std::size_t count = size < kChunkSize ? size : kChunkSize;
+      status = reader->Read(chunk, chunk + count);
+      if (!status)
+        return status;
+
+      (this->*function)(chunk, count);
+      size -= count;
+    }
+    return {};
+  }
+
+  // Returns a word with the high bit set in each byte of |word| that must be
+  // escaped in a JSON string: control characters, quotes, and backslashes.
+  // Bytes above a flagged byte may also be flagged; the caller rescans flagged
+  // words a byte at a time.
+  static std::uint64_t EscapeMask(std::uint64_t word) {
+    const std::uint64_t kOnes = 0x0101010101010101;
+    const std::uint64_t kHighBits = 0x8080808080808080;
+    const std::uint64_t quotes = word ^ (kOnes * '"');
+    const std::uint64_t backslashes = word ^ (kOnes * '\\');
+    return ((word - kOnes * 0x20) | (quotes - kOnes) |
+            (backslashes - kOnes)) &
+           ~word & kHighBits;
+  }
+
+  static bool NeedsEscape(std::uint8_t byte) {
+    return byte < 0x20 || byte == '"' || byte == '\\';
+  }
+
+  void PutEscaped(const std::uint8_t* data, std::size_t size) {
+    const std::uint8_t* run = data;
+    const std::uint8_t* end = data + size;
+    const std::uint8_t* cursor = data;
+    while (cursor != end) {
+      // Skip a word at a time while no byte needs escaping.
+      std::uint64_t word;
+      if (end - cursor >= 8) {
+        std::memcpy(&word, cursor, sizeof(word));
+        if (EscapeMask(word) == 0) {
+          cursor += 8;
+          continue;
+        }
+      }
+
+      const std::uint8_t byte = *cursor;
+      if (!NeedsEscape(byte)) {
+        cursor++;
+        continue;
+      }
+
+      Put(reinterpret_cast<const char*>(run),
+          static_cast<std::size_t>(cursor - run));
+      PutEscape(byte);
+      run = ++cursor;
+    }
+    Put(reinterpret_cast<const char*>(run),
+        static_cast<std::size_t>(cursor - run));
+  }
+
+  void PutEscape(std::uint8_t byte) {
+    switch (byte) {
+      case '"':
+        Put("\\\"");
+        break;
+      case '\\':
+        Put("\\\\");
+        break;
+      case '\b':
+        Put("\\b");
+        break;
+      case '\f':
+        Put("\\f");
+        break;
+      case '\n':
+        Put("\\n");
+        break;
+      case '\r':
+        Put("\\r");
+        break;
+      case '\t':
+        Put("\\t");
+        break;
+      default: {
+        static const char kHex[] = "0123456789abcdef";
+        const char escape[6] = {'\\', 'u', '0', '0', kHex[byte >> 4],
+                                kHex[byte & 0xf]};
+        Put(escape, sizeof(escape));
+        break;
+      }
+    }
+  }
+
+  void PutBase64(const std::uint8_t* data, std::size_t size) {
+    static const char kAlphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    char group[4];
+    for (; size >= 3; data += 3, size -= 3) {
+      const std::uint32_t bits = (data[0] << 16) | (data[1] << 8) | data[2];
+      group[0] = kAlphabet[(bits >> 18) & 0x3f];
+      group[1] = kAlphabet[(bits >> 12) & 0x3f];
+      group[2] = kAlphabet[(bits >> 6) & 0x3f];
+      group[3] = kAlphabet[bits & 0x3f];
+      Put(group, sizeof(group));
+    }
+
+    if (size > 0) {
+      const std::uint32_t bits =
+          (data[0] << 16) | (size > 1 ? data[1] << 8 : 0);
+      group[0] = kAlphabet[(bits >> 18) & 0x3f];
+      group[1] = kAlphabet[(bits >> 12) & 0x3f];
+      group[2] = size > 1 ? kAlphabet[(bits >> 6) & 0x3f] : '=';
+      group[3] = '=';
+      Put(group, sizeof(group));
+    }
+  }
+
+  void PutUnsigned(std::uint64_t value) {
+    char buffer[20];
+    char* end = buffer + sizeof(buffer);
+    char* begin = end;
+    do {
+      *--begin = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while (value != 0);
+    Put(begin, static_cast<std::size_t>(end - begin));
+  }
+
+  void PutSigned(std::int64_t value) {
+    if (value >= 0) {
+      PutUnsigned(static_cast<std::uint64_t>(value));
+    } else {
+      Put('-');
+      PutUnsigned(0 - static_cast<std::uint64_t>(value));
+    }
+  }
+
+  // Output is staged in |buffer_| and written out when it fills up. Errors
+  // from the writer are kept in |status_| and returned by Flush(), so that the
+  // transcoder does not check every write.
+  void Put(char c) {
+    if (size_ == kBufferSize)
+      Flush();
+    buffer_[size_++] = c;
+  }
+
+  template <std::size_t Size>
+  void Put(const char (&string)[Size]) {
+    Put(string, Size - 1);
+  }
+
+  void Put(const char* data, std::size_t size) {
+    if (size > kBufferSize - size_) {
+      Flush();
+      if (size > kBufferSize) {
+        if (status_)
+          status_ = writer_->Write(data, data + size);
+        return;
+      }
+    }
+
+    std::memcpy(&buffer_[size_], data, size);
+    size_ += size;
+  }
+
+  Status<void> Flush() {
+    if (status_ && size_ != 0)
+      status_ = writer_->Write(buffer_, buffer_ + size_);
+
+    size_ = 0;
+    return status_;
+  }
+
+  Writer* writer_;
+  std::size_t max_depth_;
+  Status<void> status_;
+  std::size_t size_{0};
+  char buffer_[kBufferSize];
+};
+
+// Transcodes the next encoded value from |reader| to JSON text written to
+// |writer|.
+template <typename Reader, typename Writer>
+Status<void> TranscodeToJson(
+    Reader* reader, Writer* writer,
+    std::size_t max_depth = JsonTranscoder<Writer>::kDefaultMaxDepth) {
+  JsonTranscoder<Writer> transcoder{writer, max_depth};
+  return transcoder.Transcode(reader);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_JSON_TRANSCODER_H_
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_MESSAGE_TEMPLATE_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_MESSAGE_TEMPLATE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <nop/base/encoding.h>
+#include <nop/base/slot.h>
+#include <nop/base/utility.h>
+#include <nop/utility/constexpr_buffer_writer.h>
+#include <nop/utility/endian.h>
+
+namespace nop {
+
+// MessageTemplate holds the encoding of a message that is constant except for
+// a few fields, built at compile time, and the positions of those fields in
+// the encoding. The fields are designated by declaring them as Slot<T>, which
+// always encodes the value at the full width of T, so that the bytes of each
+// slot may be overwritten at runtime without changing the size or validity of
+// the encoding. Sending such a message is then a copy of the template and a
+// store per patched field, rather than a walk over its members.
+//
+// Size is the capacity of the template, which must be at least the encoded
+// size of the message, and MaxSlots is the largest number of slots it records.
+// Slots are numbered in the order they are written, which for structures is the
+// order of their members. Templates cannot hold handles, and floating point
+// fields cannot be encoded at compile time. Construction errors are reported
+// by status(), which is a constant expression for constexpr templates.
+//
+// Example:
+//
+//   struct Heartbeat {
+//     nop::Slot<std::uint64_t> sequence;
+//     nop::Slot<std::uint64_t> timestamp;
+//     std::uint32_t node;
+//     NOP_STRUCTURE(Heartbeat, sequence, timestamp, node);
+//   };
+//
+//   constexpr Heartbeat kHeartbeat{0, 0, kNodeId};
+//   constexpr nop::MessageTemplate<nop::Encoding<Heartbeat>::Size(kHeartbeat)>
+//       kHeartbeatTemplate{kHeartbeat};
+//   static_assert(kHeartbeatTemplate.status(), "Invalid heartbeat template.");
+//
+//   auto message = kHeartbeatTemplate;
+//   message.Patch<std::uint64_t>(0, sequence++);
+//   message.Patch<std::uint64_t>(1, Now());
+//   Send(message.data(), message.size());
+//
+template <std::size_t Size, std::size_t MaxSlots = 8>
+class MessageTemplate {
+  static_assert(Size > 0, "MessageTemplate size must be non-zero.");
+  static_assert(MaxSlots > 0, "MessageTemplate must record at least one slot.");
+
+ public:
+  constexpr MessageTemplate() = default;
+  constexpr MessageTemplate(const MessageTemplate&) = default;
+
+  // Builds the template from the encoding of |value|.
+  template <typename T>
+  constexpr explicit MessageTemplate(const T& value) {
+    Writer writer{this};
+    auto status = writer.Prepare(Encoding<T>::Size(value));
+    if (status)
+      status = Encoding<T>::Write(value, &writer);
+
+    if (status)
+      size_ = writer.size();
+    else
+      error_ = status.error();
+  }
+
+  constexpr MessageTemplate& operator=(const MessageTemplate&) = default;
+
+  // Returns the error that occurred while building the template, if any.
+  constexpr Status<void> status() const {
+    if (error_ != ErrorStatus::None)
+      return error_;
+    else
+      return {};
+  }
+
+  constexpr const std::uint8_t* data() const { return data_; }
+  constexpr std::size_t size() const { return size_; }
+  constexpr std::size_t capacity() const { return Size; }
+
+  constexpr std::size_t slot_count() const { return slot_count_; }
+
+  // Returns the offset of the payload of the given slot in the encoding.
+  constexpr std::size_t slot_offset(std::size_t index) const {
+    return slots_[index].offset;
+  }
+
+  // Returns the prefix of the given slot, which determines its width.
+  constexpr EncodingByte slot_prefix(std::size_t index) const {
+    return slots_[index].prefix;
+  }
+
+  // Overwrites the value of the slot at |index|, which must be a Slot<T>.
+  // Returns ErrorStatus::UnexpectedEncodingType if there is no such slot.
+  template <typename T,
+            typename Enabled = std::enable_if_t<FixedWidthInteger<T>::value>>
+  Status<void> Patch(std::size_t index, T value) {
+    using Integer = typename FixedWidthInteger<T>::Type;
+    if (index >= slot_count_ ||
+        slots_[index].prefix != FixedWidthInteger<T>::Prefix) {
+      return ErrorStatus::UnexpectedEncodingType;
+    }
+
+    Integer integer = static_cast<Integer>(value);
+    ToLittleEndian(&integer, &integer + 1);
+    std::memcpy(&data_[slots_[index].offset], &integer, sizeof(Integer));
+    return {};
+  }
+
+ private:
+  struct SlotInfo {
+    std::size_t offset{0};
+    EncodingByte prefix{EncodingByte::Nil};
+  };
+
+  // Writes the encoding into the template and records the positions of the
+  // slots as they are written.
+  class Writer {
+   public:
+    // Staged writes would hide the positions of slots.
+    using SkipStaging = void;
+
+    constexpr Writer(MessageTemplate* target)
+        : target_{target}, writer_{target->data_, Size} {}
+
+    constexpr Status<void> Prepare(std::size_t size) {
+      return writer_.Prepare(size);
+    }
+
+    constexpr Status<void> Write(std::uint8_t byte) {
+      return writer_.Write(byte);
+    }
+
+    template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+    constexpr Status<void> Write(const T* begin, const T* end) {
+      return writer_.Write(begin, end);
+    }
+
+    constexpr Status<void> Skip(std::size_t padding_bytes,
+                                std::uint8_t padding_value = 0x00) {
+      return writer_.Skip(padding_bytes, padding_value);
+    }
+
+    constexpr Status<void> RecordSlot(EncodingByte prefix) {
+      if (target_->slot_count_ == MaxSlots)
+        return ErrorStatus::WriteLimitReached;
+
+      SlotInfo& slot = target_->slots_[target_->slot_count_++];
+      slot.offset = writer_.size();
+      slot.prefix = prefix;
+      return {};
+    }
+
+    constexpr std::size_t size() const { return writer_.size(); }
+
+   private:
+    MessageTemplate* target_;
+    ConstexprBufferWriter writer_;
+  };
+
+  std::uint8_t data_[Size] = {};
+  std::size_t size_{0};
+  SlotInfo slots_[MaxSlots] = {};
+  std::size_t slot_count_{0};
+  ErrorStatus error_{ErrorStatus::None};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_MESSAGE_TEMPLATE_H_
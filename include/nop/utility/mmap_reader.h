@@ -0,0 +1,180 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_MMAP_READER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_MMAP_READER_H_
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include <nop/base/encoding.h>
+#include <nop/base/utility.h>
+#include <nop/status.h>
+
+namespace nop {
+
+// MmapReader is a reader type that maps a file into memory and deserializes
+// directly from the mapping, avoiding the copies made by stream and fd
+// readers. This is the fastest way to load large serialized files. Because
+// files may be truncated or corrupted, the reader checks bounds on every read,
+// like PedanticBufferReader. The reader supports borrowing from its input, so
+// view types deserialized from the reader point directly into the mapping and
+// remain valid until the reader is cleared or destroyed.
+//
+// The reader takes ownership of the fd passed to Open() and automatically
+// unmaps and closes it when destroyed, unless it is released.
+//
+// Example:
+//
+//   nop::Deserializer<nop::MmapReader> deserializer;
+//   auto status = deserializer.reader().Open(open(path, O_RDONLY));
+//   if (status)
+//     status = deserializer.Read(&snapshot);
+//
+class MmapReader {
+ public:
+  MmapReader() = default;
+  MmapReader(const MmapReader&) = delete;
+  MmapReader(MmapReader&& other) { *this = std::move(other); }
+
+  ~MmapReader() { Clear(); }
+
+  MmapReader& operator=(const MmapReader&) = delete;
+  MmapReader& operator=(MmapReader&& other) {
+    if (this != &other) {
+      Clear();
+      std::swap(fd_, other.fd_);
+      std::swap(buffer_, other.buffer_);
+      std::swap(size_, other.size_);
+      std::swap(index_, other.index_);
+    }
+    return *this;
+  }
+
+  // Takes ownership of |fd| and maps the whole file read-only, replacing any
+  // previous mapping. The kernel is advised that the mapping is read
+  // sequentially so that it reads ahead aggressively.
+  Status<void> Open(int fd) {
+    Clear();
+    fd_ = fd;
+    if (fd_ < 0)
+      return ErrorStatus::IOError;
+
+    struct stat file_stat;
+    if (::fstat(fd_, &file_stat) < 0)
+      return ErrorStatus::IOError;
+
+    // Empty files cannot be mapped but are valid, empty input.
+    const std::size_t size = static_cast<std::size_t>(file_stat.st_size);
+    if (size == 0)
+      return {};
+
+    void* address = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0);
+    if (address == MAP_FAILED)
+      return ErrorStatus::IOError;
+
+    ::madvise(address, size, MADV_SEQUENTIAL);
+    buffer_ = static_cast<const std::uint8_t*>(address);
+    size_ = size;
+    return {};
+  }
+
+  // Unmaps the file and closes the fd.
+  void Clear() {
+    Unmap();
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = -1;
+  }
+
+  // Unmaps the file and releases ownership of the fd.
+  int Release() {
+    Unmap();
+    const int released_fd = fd_;
+    fd_ = -1;
+    return released_fd;
+  }
+
+  Status<void> Ensure(std::size_t size) {
+    if (size_ - index_ < size)
+      return ErrorStatus::ReadLimitReached;
+    else
+      return {};
+  }
+
+  Status<void> Read(std::uint8_t* byte) { return Read(byte, byte + 1); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Read(T* begin, T* end) {
+    const std::size_t length_bytes = (end - begin) * sizeof(T);
+    if (size_ - index_ < length_bytes)
+      return ErrorStatus::ReadLimitReached;
+
+    std::memcpy(begin, &buffer_[index_], length_bytes);
+    index_ += length_bytes;
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    if (size_ - index_ < padding_bytes)
+      return ErrorStatus::ReadLimitReached;
+
+    index_ += padding_bytes;
+    return {};
+  }
+
+  // Returns a pointer to the next |size| bytes of the mapping and advances past
+  // them. The pointer remains valid until the reader is cleared or destroyed.
+  Status<const std::uint8_t*> Borrow(std::size_t size) {
+    if (size_ - index_ < size)
+      return ErrorStatus::ReadLimitReached;
+
+    const std::uint8_t* data = &buffer_[index_];
+    index_ += size;
+    return data;
+  }
+
+  bool empty() const { return index_ == size_; }
+
+  const std::uint8_t* data() const { return buffer_; }
+  std::size_t remaining() const { return size_ - index_; }
+  std::size_t size() const { return size_; }
+
+ private:
+  void Unmap() {
+    if (buffer_ != nullptr)
+      ::munmap(const_cast<std::uint8_t*>(buffer_), size_);
+    buffer_ = nullptr;
+    size_ = 0;
+    index_ = 0;
+  }
+
+  int fd_{-1};
+  const std::uint8_t* buffer_{nullptr};
+  std::size_t size_{0};
+  std::size_t index_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_MMAP_READER_H_
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_MMAP_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_MMAP_WRITER_H_
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include <nop/base/encoding.h>
+#include <nop/base/utility.h>
+#include <nop/status.h>
+
+namespace nop {
+
+// MmapWriter is a writer type that serializes into a file through a shared
+// memory mapping. Serializer calls Prepare() with the encoded size of each
+// value before writing it, which the writer uses to grow the file with
+// ftruncate() and remap it geometrically, so that most writes are plain
+// copies into the mapping.
+//
+// The file is truncated to the number of bytes written when the writer is
+// finished, cleared, or destroyed.
+//
+// The writer takes ownership of the fd passed to Open() and automatically
+// finishes and closes it when destroyed, unless it is released.
+//
+// Example:
+//
+//   nop::Serializer<nop::MmapWriter> serializer;
+//   auto status = serializer.writer().Open(open(path, O_RDWR | O_CREAT, 0644));
+//   if (status)
+//     status = serializer.Write(snapshot);
+//   if (status)
+//     status = serializer.writer().Finish();
+//
+class MmapWriter {
+ public:
+  MmapWriter() = default;
+  MmapWriter(const MmapWriter&) = delete;
+  MmapWriter(MmapWriter&& other) { *this = std::move(other); }
+
+  ~MmapWriter() { Clear(); }
+
+  MmapWriter& operator=(const MmapWriter&) = delete;
+  MmapWriter& operator=(MmapWriter&& other) {
+    if (this != &other) {
+      Clear();
+      std::swap(fd_, other.fd_);
+      std::swap(buffer_, other.buffer_);
+      std::swap(size_, other.size_);
+      std::swap(capacity_, other.capacity_);
+    }
+    return *this;
+  }
+
+  // Takes ownership of |fd|, which must be open for reading and writing, and
+  // starts writing at the beginning of the file, finishing any previous file.
+  Status<void> Open(int fd) {
+    Clear();
+    fd_ = fd;
+    if (fd_ < 0)
+      return ErrorStatus::IOError;
+    else
+      return {};
+  }
+
+  // Unmaps the file and truncates it to the number of bytes written. The
+  // writer continues writing at the end of the file if more data is written.
+  Status<void> Finish() {
+    Unmap();
+    if (fd_ >= 0 && ::ftruncate(fd_, static_cast<off_t>(size_)) < 0)
+      return ErrorStatus::IOError;
+    else
+      return {};
+  }
+
+  // Finishes the file and closes the fd.
+  void Clear() {
+    Finish();
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = -1;
+    size_ = 0;
+  }
+
+  // Finishes the file and releases ownership of the fd.
+  int Release() {
+    Finish();
+    const int released_fd = fd_;
+    fd_ = -1;
+    size_ = 0;
+    return released_fd;
+  }
+
+  Status<void> Prepare(std::size_t size) {
+    if (size > capacity_ - size_)
+      return Grow(size);
+    else
+      return {};
+  }
+
+  Status<void> Write(std::uint8_t byte) { return Write(&byte, &byte + 1); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    const std::size_t length_bytes = (end - begin) * sizeof(T);
+    auto status = Prepare(length_bytes);
+    if (!status)
+      return status;
+
+    std::memcpy(&buffer_[size_], begin, length_bytes);
+    size_ += length_bytes;
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    auto status = Prepare(padding_bytes);
+    if (!status)
+      return status;
+
+    std::memset(&buffer_[size_], padding_value, padding_bytes);
+    size_ += padding_bytes;
+    return {};
+  }
+
+  // Returns a pointer to the next |size| bytes of the mapping, growing it as
+  // needed, for encodings to store values into directly. See
+  // IsReservingWriter.
+  Status<std::uint8_t*> Reserve(std::size_t size) {
+    auto status = Prepare(size);
+    if (!status)
+      return status.error();
+    else
+      return &buffer_[size_];
+  }
+
+  void Commit(std::size_t size) { size_ += size; }
+
+  // Overwrites previously written data at |position| with the given elements.
+  // Tables use this to write their entries in a single pass.
+  template <typename T, typename Enable = EnableIfArithmetic<T>>
+  Status<void> Patch(std::size_t position, const T* begin, const T* end) {
+    const std::size_t length_bytes = (end - begin) * sizeof(T);
+    if (position > size_ || length_bytes > size_ - position)
+      return ErrorStatus::WriteLimitReached;
+
+    std::memcpy(&buffer_[position], begin, length_bytes);
+    return {};
+  }
+
+  // Returns the written data. The pointer is invalidated by subsequent writes.
+  const std::uint8_t* data() const { return buffer_; }
+
+  std::size_t size() const { return size_; }
+  std::size_t capacity() const { return capacity_; }
+
+ private:
+  enum : std::size_t { kMinimumCapacity = 64 * 1024 };
+
+  // Grows the file and the mapping to hold at least |size| more bytes.
+  Status<void> Grow(std::size_t size) {
+    if (fd_ < 0)
+      return ErrorStatus::IOError;
+
+    const std::size_t page_size = static_cast<std::size_t>(::getpagesize());
+    std::size_t capacity =
+        std::max({size_ + size, 2 * capacity_, std::size_t{kMinimumCapacity}});
+    capacity = (capacity + page_size - 1) / page_size * page_size;
+
+    Unmap();
+    if (::ftruncate(fd_, static_cast<off_t>(capacity)) < 0)
+      return ErrorStatus::IOError;
+
+    void* address = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fd_, 0);
+    if (address == MAP_FAILED)
+      return ErrorStatus::IOError;
+
+    buffer_ = static_cast<std::uint8_t*>(address);
+    capacity_ = capacity;
+    return {};
+  }
+
+  void Unmap() {
+    if (buffer_ != nullptr)
+      ::munmap(buffer_, capacity_);
+    buffer_ = nullptr;
+    capacity_ = 0;
+  }
+
+  int fd_{-1};
+  std::uint8_t* buffer_{nullptr};
+  std::size_t size_{0};
+  std::size_t capacity_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_MMAP_WRITER_H_
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_PAGE_ALLOCATOR_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_PAGE_ALLOCATOR_H_
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace nop {
+
+//
+// Page memory for large buffers and arena blocks. Memory is mapped directly
+// from the kernel with mmap() rather than taken from the heap, which allows
+// two placement options:
+//
+//   PageOptions::HugePages backs allocations of at least kHugePageSize bytes
+//   with 2 MB transparent huge pages through madvise(MADV_HUGEPAGE), which
+//   cuts the TLB misses of walking large messages.
+//
+//   PageOptions::LocalNode places the pages on the NUMA node of the calling
+//   thread through mbind(MPOL_PREFERRED), so that a buffer allocated by one
+//   thread and reused by a thread on another node does not migrate there on
+//   first touch. Combined with thread-local buffer pools, each thread then
+//   reuses buffers on its own node.
+//
+// Both options are hints: when the kernel does not support them the memory is
+// still allocated, with the default placement.
+//
+
+// Options for page memory. The values may be combined with |.
+struct PageOptions {
+  enum : unsigned {
+    None = 0,
+    HugePages = 1 << 0,
+    LocalNode = 1 << 1,
+  };
+};
+
+enum : std::size_t { kHugePageSize = 2 * 1024 * 1024 };
+
+// Returns the NUMA node of the CPU the calling thread is running on, or -1 if
+// it is not known.
+inline int CurrentNumaNode() {
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+    return static_cast<int>(node);
+#endif
+  return -1;
+}
+
+// Returns the size of the mapping that holds |size| bytes with |options|.
+inline std::size_t PageMappingSize(std::size_t size, unsigned options) {
+  const std::size_t page_size =
+      (options & PageOptions::HugePages) && size >= kHugePageSize
+          ? std::size_t{kHugePageSize}
+          : static_cast<std::size_t>(::getpagesize());
+  return (size + page_size - 1) / page_size * page_size;
+}
+
+// Maps |size| bytes of zeroed memory with the given options. Huge page backed
+// mappings are aligned to kHugePageSize. Returns nullptr on failure.
+inline void* AllocatePages(std::size_t size, unsigned options) {
+  const std::size_t mapping_size = PageMappingSize(size, options);
+  const bool huge =
+      (options & PageOptions::HugePages) && size >= kHugePageSize;
+
+  // Huge pages need an aligned mapping: map an extra huge page and trim the
+  // unaligned ends.
+  const std::size_t extra = huge ? std::size_t{kHugePageSize} : 0;
+  void* address = ::mmap(nullptr, mapping_size + extra, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (address == MAP_FAILED)
+    return nullptr;
+
+  std::uint8_t* begin = static_cast<std::uint8_t*>(address);
+  if (huge) {
+    const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(begin);
+    const std::size_t head =
+        ((base + kHugePageSize - 1) & ~std::uintptr_t{kHugePageSize - 1}) -
+        base;
+    if (head > 0)
+      ::munmap(begin, head);
+    if (extra > head)
+      ::munmap(begin + head + mapping_size, extra - head);
+    begin += head;
+
+#ifdef MADV_HUGEPAGE
+    ::madvise(begin, mapping_size, MADV_HUGEPAGE);
+#endif
+  }
+
+#if defined(__linux__) && defined(SYS_mbind)
+  if (options & PageOptions::LocalNode) {
+    const int node = CurrentNumaNode();
+    enum : unsigned long { kMaxNodes = 1024, kMpolPreferred = 1 };
+    constexpr std::size_t kBitsPerLong = 8 * sizeof(unsigned long);
+    if (node >= 0 && static_cast<unsigned long>(node) < kMaxNodes) {
+      unsigned long mask[kMaxNodes / kBitsPerLong] = {};
+      mask[node / kBitsPerLong] = 1ul << (node % kBitsPerLong);
+      ::syscall(SYS_mbind, begin, mapping_size, kMpolPreferred, mask,
+                kMaxNodes + 1, 0);
+    }
+  }
+#endif
+
+  return begin;
+}
+
+// Unmaps memory returned by AllocatePages() with the same size and options.
+inline void FreePages(void* pointer, std::size_t size, unsigned options) {
+  if (pointer != nullptr)
+    ::munmap(pointer, PageMappingSize(size, options));
+}
+
+// Allocator that maps allocations of at least kMinPageAllocation bytes with
+// AllocatePages() and the given options, and takes smaller ones from the heap,
+// where mapping whole pages would waste memory. Like std::allocator, throws
+// std::bad_alloc when memory cannot be allocated.
+//
+// Example:
+//
+//   using HugeBuffer = std::vector<
+//       std::uint8_t,
+//       nop::PageAllocator<std::uint8_t, nop::PageOptions::HugePages>>;
+//   nop::Serializer<nop::BasicVectorWriter<HugeBuffer::allocator_type>>
+//       serializer;
+//
+template <typename T, unsigned Options = PageOptions::None>
+class PageAllocator {
+ public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  enum : std::size_t { kMinPageAllocation = 64 * 1024 };
+
+  template <typename U>
+  struct rebind {
+    using other = PageAllocator<U, Options>;
+  };
+
+  PageAllocator() = default;
+  template <typename U>
+  PageAllocator(const PageAllocator<U, Options>& /*other*/) {}
+
+  T* allocate(std::size_t count) {
+    const std::size_t size = count * sizeof(T);
+    if (size < kMinPageAllocation)
+      return static_cast<T*>(::operator new(size));
+
+    void* pointer = AllocatePages(size, Options);
+    if (pointer == nullptr)
+      throw std::bad_alloc{};
+    return static_cast<T*>(pointer);
+  }
+
+  void deallocate(T* pointer, std::size_t count) {
+    const std::size_t size = count * sizeof(T);
+    if (size < kMinPageAllocation)
+      ::operator delete(pointer);
+    else
+      FreePages(pointer, size, Options);
+  }
+};
+
+template <typename T, typename U, unsigned Options>
+bool operator==(const PageAllocator<T, Options>& /*a*/,
+                const PageAllocator<U, Options>& /*b*/) {
+  return true;
+}
+template <typename T, typename U, unsigned Options>
+bool operator!=(const PageAllocator<T, Options>& /*a*/,
+                const PageAllocator<U, Options>& /*b*/) {
+  return false;
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_PAGE_ALLOCATOR_H_
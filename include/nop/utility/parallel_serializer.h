@@ -0,0 +1,310 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_PARALLEL_SERIALIZER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_PARALLEL_SERIALIZER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/skip.h>
+#include <nop/base/utility.h>
+#include <nop/status.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/buffer_writer.h>
+#include <nop/utility/pedantic_buffer_reader.h>
+
+namespace nop {
+
+// Calls |function| with each chunk index, running the first chunk on the
+// calling thread and the others on their own threads.
+template <typename Function>
+void RunParallelChunks(std::size_t chunk_count, Function function) {
+  std::vector<std::thread> threads;
+  threads.reserve(chunk_count - 1);
+  for (std::size_t chunk = 1; chunk < chunk_count; chunk++)
+    threads.emplace_back(function, chunk);
+
+  function(0);
+  for (auto& thread : threads)
+    thread.join();
+}
+
+// ParallelSerializer encodes large vectors of non-packable elements, such as
+// structures, using several threads. The vector is partitioned into one chunk
+// per thread, and the threads compute the encoded size of their chunks
+// concurrently. The chunk offsets are then computed with a prefix sum, and
+// the threads encode their chunks concurrently into disjoint regions of a
+// single buffer.
+//
+// The output is byte-for-byte the same as serializing the vector with
+// Serializer. A few encodings overestimate their size; in that case the gaps
+// left between chunks are closed after encoding, which costs one move of the
+// output following each short chunk.
+//
+// The elements must not be modified during serialization. Encodings of
+// handles are not supported, since BufferWriter does not support handles.
+//
+// Example:
+//
+//   nop::ParallelSerializer serializer{8};
+//   auto status = serializer.Write(records);
+//   if (status)
+//     WriteFile(serializer.data(), serializer.size());
+//
+class ParallelSerializer {
+ public:
+  // Vectors shorter than this many elements per thread are split among fewer
+  // threads, since the cost of starting a thread outweighs the work.
+  enum : std::size_t { kMinimumChunkSize = 64 };
+
+  ParallelSerializer()
+      : ParallelSerializer{std::thread::hardware_concurrency()} {}
+  explicit ParallelSerializer(std::size_t thread_count)
+      : thread_count_{std::max<std::size_t>(thread_count, 1)} {}
+  ParallelSerializer(const ParallelSerializer&) = delete;
+  ParallelSerializer(ParallelSerializer&&) = default;
+
+  ParallelSerializer& operator=(const ParallelSerializer&) = delete;
+  ParallelSerializer& operator=(ParallelSerializer&&) = default;
+
+  // Appends the encoding of |values| to the buffer.
+  template <typename T, typename Allocator>
+  Status<void> Write(const std::vector<T, Allocator>& values) {
+    static_assert(!IsPackable<T>::value,
+                  "Vectors of packable elements are encoded as a single copy "
+                  "of the elements and gain nothing from parallel encoding.");
+
+    const std::size_t count = values.size();
+    const std::size_t chunk_count = std::max<std::size_t>(
+        1, std::min(thread_count_, count / kMinimumChunkSize));
+
+    // Returns the indices of the first and last elements of a chunk.
+    auto chunk_bounds = [count, chunk_count](std::size_t chunk) {
+      return std::make_pair(chunk * count / chunk_count,
+                            (chunk + 1) * count / chunk_count);
+    };
+
+    // Compute the size of each chunk.
+    std::vector<std::size_t> offsets(chunk_count + 1);
+    RunParallelChunks(chunk_count, [&](std::size_t chunk) {
+      const auto bounds = chunk_bounds(chunk);
+      std::size_t size = 0;
+      for (std::size_t i = bounds.first; i < bounds.second; i++)
+        size += Encoding<T>::Size(values[i]);
+      offsets[chunk + 1] = size;
+    });
+
+    // Compute the offset of each chunk relative to the first element.
+    for (std::size_t chunk = 0; chunk < chunk_count; chunk++)
+      offsets[chunk + 1] += offsets[chunk];
+
+    const std::size_t start = buffer_.size();
+    const std::size_t header_size = BaseEncodingSize(EncodingByte::Array) +
+                                    Encoding<SizeType>::Size(count);
+    buffer_.resize(start + header_size + offsets[chunk_count]);
+
+    BufferWriter header_writer{&buffer_[start], header_size};
+    auto status = header_writer.Write(
+        static_cast<std::uint8_t>(EncodingByte::Array));
+    if (status)
+      status = Encoding<SizeType>::Write(count, &header_writer);
+    if (!status) {
+      buffer_.resize(start);
+      return status;
+    }
+
+    // Encode the chunks, recording where each one ends.
+    std::uint8_t* elements = &buffer_[start + header_size];
+    std::vector<Status<void>> statuses(chunk_count);
+    std::vector<std::size_t> sizes(chunk_count);
+    RunParallelChunks(chunk_count, [&](std::size_t chunk) {
+      const auto bounds = chunk_bounds(chunk);
+      BufferWriter writer{elements + offsets[chunk],
+                          offsets[chunk + 1] - offsets[chunk]};
+      for (std::size_t i = bounds.first; i < bounds.second; i++) {
+        statuses[chunk] = Encoding<T>::Write(values[i], &writer);
+        if (!statuses[chunk])
+          break;
+      }
+      sizes[chunk] = writer.size();
+    });
+
+    for (const auto& chunk_status : statuses) {
+      if (!chunk_status) {
+        buffer_.resize(start);
+        return chunk_status;
+      }
+    }
+
+    // Close any gaps left by chunks that overestimated their size.
+    std::size_t end = 0;
+    for (std::size_t chunk = 0; chunk < chunk_count; chunk++) {
+      if (end != offsets[chunk])
+        std::memmove(elements + end, elements + offsets[chunk], sizes[chunk]);
+      end += sizes[chunk];
+    }
+    buffer_.resize(start + header_size + end);
+
+    return {};
+  }
+
+  // Discards the output, keeping the capacity of the buffer.
+  void reset() { buffer_.clear(); }
+
+  // Moves the buffer out of the serializer.
+  std::vector<std::uint8_t> take() {
+    std::vector<std::uint8_t> buffer{std::move(buffer_)};
+    buffer_.clear();
+    return buffer;
+  }
+
+  const std::uint8_t* data() const { return buffer_.data(); }
+  const std::vector<std::uint8_t>& buffer() const { return buffer_; }
+  std::size_t size() const { return buffer_.size(); }
+  std::size_t thread_count() const { return thread_count_; }
+
+ private:
+  std::size_t thread_count_;
+  std::vector<std::uint8_t> buffer_;
+};
+
+// ParallelDeserializer decodes large vectors of non-packable elements, such as
+// structures, using several threads. The elements of a vector are encoded one
+// after another with no index, so the boundaries of the chunks are found first
+// by skipping over the elements with SkipValue(), which reads only their
+// prefixes and jumps over strings, binary containers, and table entries
+// without examining them. The vector is then sized to hold every element, and
+// the threads decode their chunks concurrently from disjoint regions of the
+// input into disjoint ranges of the vector.
+//
+// The input is bounds checked while scanning and decoding, so it may come from
+// an untrusted source. Reading fails, leaving the vector empty, if an element
+// fails to decode or does not end where scanning found it to end. Decoding
+// elements that hold handles is not supported, since BufferReader does not
+// support handles.
+//
+// Example:
+//
+//   nop::ParallelDeserializer deserializer{8};
+//   std::vector<Record> records;
+//   auto status = deserializer.Read(data, size, &records);
+//   if (status)
+//     Consume(data + status.get());
+//
+class ParallelDeserializer {
+ public:
+  // Vectors shorter than this many elements per thread are split among fewer
+  // threads, since the cost of starting a thread outweighs the work.
+  enum : std::size_t { kMinimumChunkSize = 64 };
+
+  ParallelDeserializer()
+      : ParallelDeserializer{std::thread::hardware_concurrency()} {}
+  explicit ParallelDeserializer(std::size_t thread_count)
+      : thread_count_{std::max<std::size_t>(thread_count, 1)} {}
+
+  // Decodes the vector encoded at the start of |data| into |values|,
+  // replacing its contents, and returns the number of bytes it occupies.
+  template <typename T, typename Allocator>
+  Status<std::size_t> Read(const void* data, std::size_t size,
+                           std::vector<T, Allocator>* values) const {
+    static_assert(!IsPackable<T>::value,
+                  "Vectors of packable elements are decoded as a single copy "
+                  "of the elements and gain nothing from parallel decoding.");
+
+    values->clear();
+    const std::uint8_t* input = static_cast<const std::uint8_t*>(data);
+    PedanticBufferReader scanner{input, size};
+
+    EncodingByte prefix;
+    auto status = SkipValueCommon::ReadPrefix(&prefix, &scanner);
+    if (!status)
+      return status.error();
+    else if (prefix != EncodingByte::Array)
+      return ErrorStatus::UnexpectedEncodingType;
+
+    SizeType count = 0;
+    status = Encoding<SizeType>::Read(&count, &scanner);
+    if (!status)
+      return status.error();
+
+    // Each element occupies at least one byte.
+    if (count > scanner.remaining())
+      return ErrorStatus::InvalidContainerLength;
+
+    const std::size_t element_count = static_cast<std::size_t>(count);
+    const std::size_t chunk_count = std::max<std::size_t>(
+        1, std::min(thread_count_, element_count / kMinimumChunkSize));
+
+    // Returns the index of the first element of a chunk.
+    auto chunk_begin = [element_count, chunk_count](std::size_t chunk) {
+      return chunk * element_count / chunk_count;
+    };
+
+    // Find the offset of each chunk, and the end of the last chunk.
+    std::vector<std::size_t> offsets(chunk_count + 1);
+    std::size_t chunk = 0;
+    for (std::size_t i = 0; i < element_count; i++) {
+      while (chunk < chunk_count && chunk_begin(chunk) == i)
+        offsets[chunk++] = size - scanner.remaining();
+
+      status = SkipValue(&scanner);
+      if (!status)
+        return status.error();
+    }
+    while (chunk <= chunk_count)
+      offsets[chunk++] = size - scanner.remaining();
+
+    values->resize(element_count);
+    std::vector<Status<void>> statuses(chunk_count);
+    RunParallelChunks(chunk_count, [&](std::size_t chunk) {
+      BufferReader reader{input + offsets[chunk],
+                          offsets[chunk + 1] - offsets[chunk]};
+      const std::size_t end = chunk_begin(chunk + 1);
+      for (std::size_t i = chunk_begin(chunk); i < end; i++) {
+        statuses[chunk] = Encoding<T>::Read(&(*values)[i], &reader);
+        if (!statuses[chunk])
+          return;
+      }
+      if (!reader.empty())
+        statuses[chunk] = ErrorStatus::ProtocolError;
+    });
+
+    for (const auto& chunk_status : statuses) {
+      if (!chunk_status) {
+        values->clear();
+        return chunk_status.error();
+      }
+    }
+
+    return offsets[chunk_count];
+  }
+
+  std::size_t thread_count() const { return thread_count_; }
+
+ private:
+  std::size_t thread_count_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_PARALLEL_SERIALIZER_H_
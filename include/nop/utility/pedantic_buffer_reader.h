@@ -45,7 +45,7 @@ class PedanticBufferReader {
   PedanticBufferReader& operator=(const PedanticBufferReader&) = default;
 
   Status<void> Ensure(std::size_t size) {
-    if (size_ - index_ < size)
+    if (NOP_UNLIKELY(size_ - index_ < size))
       return ErrorStatus::ReadLimitReached;
     else
       return {};
@@ -53,13 +53,13 @@ class PedanticBufferReader {
 
   Status<void> Read(std::uint8_t* byte) { return Read(byte, byte + 1); }
 
-  template <typename T, typename Enable = EnableIfArithmetic<T>>
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
   Status<void> Read(T* begin, T* end) {
     const std::size_t element_size = sizeof(T);
     const std::size_t length = end - begin;
     const std::size_t length_bytes = length * element_size;
 
-    if (length_bytes > (size_ - index_))
+    if (NOP_UNLIKELY(length_bytes > (size_ - index_)))
       return ErrorStatus::ReadLimitReached;
 
     std::memcpy(begin, &buffer_[index_], length_bytes);
@@ -68,13 +68,24 @@ class PedanticBufferReader {
   }
 
   Status<void> Skip(std::size_t padding_bytes) {
-    if (padding_bytes > (size_ - index_))
+    if (NOP_UNLIKELY(padding_bytes > (size_ - index_)))
       return ErrorStatus::ReadLimitReached;
 
     index_ += padding_bytes;
     return {};
   }
 
+  // Returns a pointer to the next |size| bytes of the input and advances past
+  // them. The pointer remains valid for as long as the underlying buffer.
+  Status<const std::uint8_t*> Borrow(std::size_t size) {
+    if (NOP_UNLIKELY(size > (size_ - index_)))
+      return ErrorStatus::ReadLimitReached;
+
+    const std::uint8_t* data = &buffer_[index_];
+    index_ += size;
+    return data;
+  }
+
   bool empty() const { return index_ == size_; }
 
   std::size_t remaining() const { return size_ - index_; }
@@ -47,7 +47,7 @@ class PedanticBufferWriter {
   PedanticBufferWriter& operator=(const PedanticBufferWriter&) = default;
 
   Status<void> Prepare(std::size_t size) {
-    if (index_ + size > size_)
+    if (NOP_UNLIKELY(index_ + size > size_))
       return ErrorStatus::WriteLimitReached;
     else
       return {};
@@ -57,13 +57,13 @@ class PedanticBufferWriter {
     return Write(&byte, &byte + 1);
   }
 
-  template <typename T, typename Enable = EnableIfArithmetic<T>>
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
   Status<void> Write(const T* begin, const T* end) {
     const std::size_t element_size = sizeof(T);
     const std::size_t length = end - begin;
     const std::size_t length_bytes = length * element_size;
 
-    if (length_bytes > (size_ - index_))
+    if (NOP_UNLIKELY(length_bytes > (size_ - index_)))
       return ErrorStatus::WriteLimitReached;
 
     std::memcpy(&buffer_[index_], begin, length_bytes);
@@ -82,6 +82,17 @@ class PedanticBufferWriter {
     return {};
   }
 
+  // Returns a pointer to the next |size| bytes of the buffer for encodings to
+  // store values into directly. See IsReservingWriter.
+  Status<std::uint8_t*> Reserve(std::size_t size) {
+    if (NOP_UNLIKELY(size > size_ - index_))
+      return ErrorStatus::WriteLimitReached;
+    else
+      return &buffer_[index_];
+  }
+
+  void Commit(std::size_t size) { index_ += size; }
+
   std::size_t size() const { return index_; }
   std::size_t capacity() const { return size_; }
 
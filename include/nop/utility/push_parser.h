@@ -0,0 +1,553 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_PUSH_PARSER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_PUSH_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include <nop/base/encoding.h>
+#include <nop/base/skip.h>
+#include <nop/status.h>
+#include <nop/utility/bounded_reader.h>
+#include <nop/utility/endian.h>
+
+namespace nop {
+
+//
+// Schema-less push parsing of encoded values. PushParser walks one encoded
+// value from a reader, driven only by the prefixes in the input, and reports
+// what it finds to a handler through callbacks, in the style of a SAX parser.
+// Containers are reported as begin and end events around their elements, and
+// string and binary payloads as a sequence of chunks, so that arbitrarily
+// large messages are processed in constant memory.
+//
+// Before each element of an array or structure, each key and value of a map,
+// and each table entry, the parser asks the handler how to proceed. The
+// handler returns ParseAction::Parse to have the parser report the value,
+// ParseAction::Skip to have it skipped, or ParseAction::Consumed after reading
+// the value from the reader itself, for example with Encoding<T>::Read() for
+// a sub-value of known type.
+//
+// Handlers derive from PushHandler and hide the callbacks they need; the rest
+// accept everything. Callbacks return an error to stop parsing:
+//
+//   Nil()
+//   Unsigned(value), Signed(value)   integers, including bools
+//   Float(value)                     F32 and F64 values
+//   BeginString(size), StringChunk(data, size), EndString()
+//   BeginBinary(size), BinaryChunk(data, size), EndBinary()
+//   BeginArray(count), Element(index, reader), EndArray()
+//   BeginStructure(count), Element(index, reader), EndStructure()
+//   BeginMap(count), Key(index, reader), Value(index, reader), EndMap()
+//   BeginTable(hash, count), Entry(id, size, reader), EndTable()
+//   BeginVariant(index), EndVariant()      around the value of the variant
+//   Handle(type, reference)
+//   Error(code)
+//   BeginExtension(code, size), ExtensionChunk(data, size), EndExtension()
+//
+// Readers over contiguous memory, such as BufferReader, pass each payload as
+// a single chunk in place; other readers pass chunks of up to kChunkSize
+// bytes read through a stack buffer.
+//
+// Nesting deeper than |max_depth| fails with ErrorStatus::ProtocolError, so
+// that hostile input cannot exhaust the stack. As when decoding, use a reader
+// that checks every read, such as PedanticBufferReader, for untrusted input.
+//
+// Example:
+//
+//   struct SumHandler : nop::PushHandler {
+//     nop::Status<void> Unsigned(std::uint64_t value) {
+//       sum += value;
+//       return {};
+//     }
+//     std::uint64_t sum = 0;
+//   };
+//
+//   SumHandler handler;
+//   auto status = nop::PushParse(&reader, &handler);
+//
+
+// How the parser proceeds with the value that follows a callback.
+enum class ParseAction {
+  Parse,     // Report the value to the handler.
+  Skip,      // Skip the value without reporting it.
+  Consumed,  // The handler read the value from the reader.
+};
+
+// Base class for push parser handlers that accepts every event.
+struct PushHandler {
+  Status<void> Nil() { return {}; }
+  Status<void> Unsigned(std::uint64_t /*value*/) { return {}; }
+  Status<void> Signed(std::int64_t /*value*/) { return {}; }
+  Status<void> Float(double /*value*/) { return {}; }
+
+  Status<void> BeginString(std::size_t /*size*/) { return {}; }
+  Status<void> StringChunk(const std::uint8_t* /*data*/,
+                           std::size_t /*size*/) {
+    return {};
+  }
+  Status<void> EndString() { return {}; }
+
+  Status<void> BeginBinary(std::size_t /*size*/) { return {}; }
+  Status<void> BinaryChunk(const std::uint8_t* /*data*/,
+                           std::size_t /*size*/) {
+    return {};
+  }
+  Status<void> EndBinary() { return {}; }
+
+  Status<void> BeginArray(std::size_t /*count*/) { return {}; }
+  Status<void> EndArray() { return {}; }
+  Status<void> BeginStructure(std::size_t /*count*/) { return {}; }
+  Status<void> EndStructure() { return {}; }
+
+  template <typename Reader>
+  Status<ParseAction> Element(std::size_t /*index*/, Reader* /*reader*/) {
+    return ParseAction::Parse;
+  }
+
+  Status<void> BeginMap(std::size_t /*count*/) { return {}; }
+  Status<void> EndMap() { return {}; }
+
+  template <typename Reader>
+  Status<ParseAction> Key(std::size_t /*index*/, Reader* /*reader*/) {
+    return ParseAction::Parse;
+  }
+  template <typename Reader>
+  Status<ParseAction> Value(std::size_t /*index*/, Reader* /*reader*/) {
+    return ParseAction::Parse;
+  }
+
+  // Entries are reported with the size of the encoded entry value. The reader
+  // passed to Entry() is limited to the entry, and any bytes the handler
+  // leaves unread are skipped.
+  Status<void> BeginTable(std::uint64_t /*hash*/, std::size_t /*count*/) {
+    return {};
+  }
+  Status<void> EndTable() { return {}; }
+
+  template <typename Reader>
+  Status<ParseAction> Entry(std::uint64_t /*id*/, std::size_t /*size*/,
+                            Reader* /*reader*/) {
+    return ParseAction::Parse;
+  }
+
+  Status<void> BeginVariant(std::int32_t /*index*/) { return {}; }
+  Status<void> EndVariant() { return {}; }
+
+  Status<void> Handle(std::uint64_t /*type*/, std::int64_t /*reference*/) {
+    return {};
+  }
+  Status<void> Error(std::int64_t /*code*/) { return {}; }
+
+  Status<void> BeginExtension(std::uint64_t /*code*/, std::size_t /*size*/) {
+    return {};
+  }
+  Status<void> ExtensionChunk(const std::uint8_t* /*data*/,
+                              std::size_t /*size*/) {
+    return {};
+  }
+  Status<void> EndExtension() { return {}; }
+};
+
+template <typename Handler>
+class PushParser {
+ public:
+  enum : std::size_t { kDefaultMaxDepth = 64, kChunkSize = 4096 };
+
+  PushParser(Handler* handler, std::size_t max_depth = kDefaultMaxDepth)
+      : handler_{handler}, max_depth_{max_depth} {}
+
+  PushParser(const PushParser&) = delete;
+  void operator=(const PushParser&) = delete;
+
+  // Parses the next value from |reader|, reporting it to the handler.
+  template <typename Reader>
+  Status<void> Parse(Reader* reader) {
+    return ParseValue(reader, 0);
+  }
+
+ private:
+  template <typename Reader>
+  Status<void> ParseValue(Reader* reader, std::size_t depth) {
+    if (depth > max_depth_)
+      return ErrorStatus::ProtocolError;
+
+    std::uint8_t prefix_byte = 0;
+    auto status = reader->Read(&prefix_byte);
+    if (!status)
+      return status;
+
+    switch (static_cast<EncodingByte>(prefix_byte)) {
+      case EncodingByte::U8:
+        return ParseNumber<std::uint8_t>(reader);
+      case EncodingByte::U16:
+        return ParseNumber<std::uint16_t>(reader);
+      case EncodingByte::U32:
+        return ParseNumber<std::uint32_t>(reader);
+      case EncodingByte::U64:
+        return ParseNumber<std::uint64_t>(reader);
+      case EncodingByte::I8:
+        return ParseNumber<std::int8_t>(reader);
+      case EncodingByte::I16:
+        return ParseNumber<std::int16_t>(reader);
+      case EncodingByte::I32:
+        return ParseNumber<std::int32_t>(reader);
+      case EncodingByte::I64:
+        return ParseNumber<std::int64_t>(reader);
+      case EncodingByte::F32:
+        return ParseNumber<float>(reader);
+      case EncodingByte::F64:
+        return ParseNumber<double>(reader);
+
+      case EncodingByte::String:
+        return ParseString(reader);
+      case EncodingByte::Binary:
+        return ParseBinary(reader);
+
+      case EncodingByte::Array:
+        return ParseArray(reader, depth, false);
+      case EncodingByte::Structure:
+        return ParseArray(reader, depth, true);
+      case EncodingByte::Map:
+        return ParseMap(reader, depth);
+      case EncodingByte::Table:
+        return ParseTable(reader, depth);
+      case EncodingByte::Variant:
+        return ParseVariant(reader, depth);
+
+      case EncodingByte::Handle: {
+        std::uint64_t type = 0;
+        status = Encoding<std::uint64_t>::Read(&type, reader);
+        if (!status)
+          return status;
+
+        std::int64_t reference = 0;
+        status = Encoding<std::int64_t>::Read(&reference, reader);
+        if (!status)
+          return status;
+
+        return handler_->Handle(type, reference);
+      }
+
+      case EncodingByte::Error: {
+        std::int64_t code = 0;
+        status = Encoding<std::int64_t>::Read(&code, reader);
+        if (!status)
+          return status;
+
+        return handler_->Error(code);
+      }
+
+      case EncodingByte::Extension:
+        return ParseExtension(reader);
+
+      case EncodingByte::Nil:
+        return handler_->Nil();
+
+      default:
+        break;
+    }
+
+    const EncodingByte prefix = static_cast<EncodingByte>(prefix_byte);
+    if (prefix <= EncodingByte::PositiveFixIntMax)
+      return handler_->Unsigned(prefix_byte);
+    else if (prefix >= EncodingByte::NegativeFixIntMin)
+      return handler_->Signed(static_cast<std::int8_t>(prefix_byte));
+    else
+      return ErrorStatus::UnexpectedEncodingType;
+  }
+
+  template <typename T, typename Reader>
+  Status<void> ParseNumber(Reader* reader) {
+    T value = 0;
+    auto status = reader->Read(&value, &value + 1);
+    if (!status)
+      return status;
+
+    FromLittleEndian(&value, &value + 1);
+    return Report(value);
+  }
+
+  template <typename T>
+  std::enable_if_t<std::is_unsigned<T>::value, Status<void>> Report(T value) {
+    return handler_->Unsigned(value);
+  }
+  template <typename T>
+  std::enable_if_t<std::is_signed<T>::value && std::is_integral<T>::value,
+                   Status<void>>
+  Report(T value) {
+    return handler_->Signed(value);
+  }
+  template <typename T>
+  std::enable_if_t<std::is_floating_point<T>::value, Status<void>> Report(
+      T value) {
+    return handler_->Float(value);
+  }
+
+  // Reads the size of a container, string, or binary payload.
+  template <typename Reader>
+  static Status<std::size_t> ReadSize(Reader* reader) {
+    SizeType size = 0;
+    auto status = Encoding<SizeType>::Read(&size, reader);
+    if (!status)
+      return status.error();
+    else if (size > std::numeric_limits<std::size_t>::max())
+      return ErrorStatus::ReadLimitReached;
+
+    return static_cast<std::size_t>(size);
+  }
+
+  // Parses, skips, or leaves the next value as |action| directs.
+  template <typename Reader>
+  Status<void> Follow(Status<ParseAction> action, Reader* reader,
+                      std::size_t depth) {
+    if (!action)
+      return action.error();
+
+    switch (action.get()) {
+      case ParseAction::Parse:
+        return ParseValue(reader, depth);
+      case ParseAction::Skip:
+        return SkipValue(reader);
+      case ParseAction::Consumed:
+        return {};
+    }
+    return ErrorStatus::ProtocolError;
+  }
+
+  template <typename Reader>
+  Status<void> ParseArray(Reader* reader, std::size_t depth,
+                          bool structure) {
+    auto count = ReadSize(reader);
+    if (!count)
+      return count.error();
+
+    auto status = structure ? handler_->BeginStructure(count.get())
+                            : handler_->BeginArray(count.get());
+    if (!status)
+      return status;
+
+    for (std::size_t i = 0; i < count.get(); i++) {
+      status = Follow(handler_->Element(i, reader), reader, depth + 1);
+      if (!status)
+        return status;
+    }
+
+    return structure ? handler_->EndStructure() : handler_->EndArray();
+  }
+
+  template <typename Reader>
+  Status<void> ParseMap(Reader* reader, std::size_t depth) {
+    auto count = ReadSize(reader);
+    if (!count)
+      return count.error();
+
+    auto status = handler_->BeginMap(count.get());
+    if (!status)
+      return status;
+
+    for (std::size_t i = 0; i < count.get(); i++) {
+      status = Follow(handler_->Key(i, reader), reader, depth + 1);
+      if (!status)
+        return status;
+
+      status = Follow(handler_->Value(i, reader), reader, depth + 1);
+      if (!status)
+        return status;
+    }
+
+    return handler_->EndMap();
+  }
+
+  // Parses the active entries of a table. Each entry value is read within the
+  // size of its entry, skipping anything that follows it.
+  template <typename Reader>
+  Status<void> ParseTable(Reader* reader, std::size_t depth) {
+    std::uint64_t hash = 0;
+    auto status = Encoding<std::uint64_t>::Read(&hash, reader);
+    if (!status)
+      return status;
+
+    auto count = ReadSize(reader);
+    if (!count)
+      return count.error();
+
+    status = handler_->BeginTable(hash, count.get());
+    if (!status)
+      return status;
+
+    for (std::size_t i = 0; i < count.get(); i++) {
+      std::uint64_t id = 0;
+      status = Encoding<std::uint64_t>::Read(&id, reader);
+      if (!status)
+        return status;
+
+      auto size = ReadSize(reader);
+      if (!size)
+        return size.error();
+
+      BoundedReaderScope<Reader> scope{reader, size.get()};
+      status = scope.status();
+      if (!status)
+        return status;
+
+      status = Follow(handler_->Entry(id, size.get(), scope.reader()),
+                      scope.reader(), depth + 1);
+      if (!status)
+        return status;
+
+      status = scope.ReadPadding();
+      if (!status)
+        return status;
+    }
+
+    return handler_->EndTable();
+  }
+
+  template <typename Reader>
+  Status<void> ParseVariant(Reader* reader, std::size_t depth) {
+    std::int32_t index = 0;
+    auto status = Encoding<std::int32_t>::Read(&index, reader);
+    if (!status)
+      return status;
+
+    status = handler_->BeginVariant(index);
+    if (!status)
+      return status;
+
+    status = ParseValue(reader, depth + 1);
+    if (!status)
+      return status;
+
+    return handler_->EndVariant();
+  }
+
+  template <typename Reader>
+  Status<void> ParseString(Reader* reader) {
+    auto size = ReadSize(reader);
+    if (!size)
+      return size.error();
+
+    auto status = handler_->BeginString(size.get());
+    if (!status)
+      return status;
+
+    status = Payload(size.get(), reader, &Handler::StringChunk);
+    if (!status)
+      return status;
+
+    return handler_->EndString();
+  }
+
+  template <typename Reader>
+  Status<void> ParseBinary(Reader* reader) {
+    auto size = ReadSize(reader);
+    if (!size)
+      return size.error();
+
+    auto status = handler_->BeginBinary(size.get());
+    if (!status)
+      return status;
+
+    status = Payload(size.get(), reader, &Handler::BinaryChunk);
+    if (!status)
+      return status;
+
+    return handler_->EndBinary();
+  }
+
+  template <typename Reader>
+  Status<void> ParseExtension(Reader* reader) {
+    std::uint64_t code = 0;
+    auto status = Encoding<std::uint64_t>::Read(&code, reader);
+    if (!status)
+      return status;
+
+    auto size = ReadSize(reader);
+    if (!size)
+      return size.error();
+
+    status = handler_->BeginExtension(code, size.get());
+    if (!status)
+      return status;
+
+    status = Payload(size.get(), reader, &Handler::ExtensionChunk);
+    if (!status)
+      return status;
+
+    return handler_->EndExtension();
+  }
+
+  // Passes |size| bytes of payload to the chunk callback |function|, in place
+  // when the reader is over contiguous memory and in chunks otherwise.
+  template <typename Reader, typename Function>
+  Status<void> Payload(std::size_t size, Reader* reader, Function function) {
+    return Payload(size, reader, function, IsContiguousReader<Reader>{});
+  }
+
+  template <typename Reader, typename Function>
+  Status<void> Payload(std::size_t size, Reader* reader, Function function,
+                       std::true_type) {
+    auto data = reader->Borrow(size);
+    if (!data)
+      return data.error();
+
+    return (handler_->*function)(data.get(), size);
+  }
+
+  template <typename Reader, typename Function>
+  Status<void> Payload(std::size_t size, Reader* reader, Function function,
+                       std::false_type) {
+    auto status = reader->Ensure(size);
+    if (!status)
+      return status;
+
+    std::uint8_t chunk[kChunkSize];
+    while (size > 0) {
+      const std::size_t count = size < kChunkSize ? size : kChunkSize;
+      status = reader->Read(chunk, chunk + count);
+      if (!status)
+        return status;
+
+      status = (handler_->*function)(chunk, count);
+      if (!status)
+        return status;
+
+      size -= count;
+    }
+    return {};
+  }
+
+  Handler* handler_;
+  std::size_t max_depth_;
+};
+
+// Parses the next encoded value from |reader|, reporting it to |handler|.
+template <typename Reader, typename Handler>
+Status<void> PushParse(
+    Reader* reader, Handler* handler,
+    std::size_t max_depth = PushParser<Handler>::kDefaultMaxDepth) {
+  PushParser<Handler> parser{handler, max_depth};
+  return parser.Parse(reader);
+}
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_PUSH_PARSER_H_
@@ -0,0 +1,576 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_RANDOM_VALUE_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_RANDOM_VALUE_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <list>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <nop/table.h>
+#include <nop/types/detail/logical_buffer.h>
+#include <nop/types/detail/member_pointer.h>
+#include <nop/types/optional.h>
+#include <nop/types/variant.h>
+
+namespace nop {
+
+//
+// Random values of serializable types, for benchmark and capacity test corpora
+// of arbitrary schemas. RandomValueGenerator walks the member lists of
+// structures and value wrappers given by NOP_STRUCTURE and NOP_VALUE, the entry
+// lists of tables given by NOP_TABLE, and the element types of variants,
+// optionals, and the standard containers, and fills each value with random
+// contents drawn from the distributions in RandomValueOptions:
+//
+//   - Integers have a random number of significant bits, so that their encoded
+//     sizes vary the way real counters and ids do, and a random sign.
+//   - Strings have random lengths and printable ASCII contents.
+//   - Vectors, lists, maps, sets, and logical buffers have random
+//     sizes. Maps and sets may end up smaller when random keys collide, and
+//     logical buffers are limited to the length of their array.
+//   - Table entries and optionals are filled with the given probability.
+//   - Variants pick their element type with the given weights.
+//
+// Containers nested deeper than RandomValueOptions::max_depth are left empty
+// and optionals unfilled, which bounds the size of recursive schemas.
+//
+// Other types are supported by specializing RandomValue<T>.
+//
+// Example:
+//
+//   nop::RandomValueOptions options;
+//   options.string_length = {0, 256, 16};
+//   options.entry_occupancy = 0.25;
+//   nop::RandomValueGenerator generator{seed, options};
+//   std::vector<Message> corpus = nop::GenerateCorpus<Message>(1000,
+//                                                              &generator);
+//
+
+// Distribution of random sizes between |min| and |max| inclusive. Sizes are
+// uniform when |mean| is zero and otherwise follow a geometric distribution
+// with the given mean above |min|, truncated at |max|, which favors small sizes
+// like most real data does.
+struct SizeDistribution {
+  std::size_t min;
+  std::size_t max;
+  double mean;
+
+  template <typename Engine>
+  std::size_t operator()(Engine* engine) const {
+    if (max <= min)
+      return min;
+
+    std::size_t size;
+    if (mean <= 0.0) {
+      size = std::uniform_int_distribution<std::size_t>{min, max}(*engine);
+    } else {
+      const double p = 1.0 / (1.0 + mean);
+      size = min + std::geometric_distribution<std::size_t>{p}(*engine);
+    }
+    return std::min(size, max);
+  }
+};
+
+// Distributions of the random values produced by RandomValueGenerator.
+struct RandomValueOptions {
+  // Number of significant bits of integers, limited to the width of each type.
+  SizeDistribution integer_bits{0, 64, 0.0};
+
+  // Standard deviation of floating point values, which are normally
+  // distributed around zero.
+  double float_scale{1000.0};
+
+  // Enums take underlying values from zero up to, but not including, this
+  // number, which should not exceed the number of enumerators.
+  std::size_t enum_values{1};
+
+  // Lengths of strings in characters.
+  SizeDistribution string_length{0, 32, 0.0};
+
+  // Sizes of vectors, lists, maps, sets, and logical buffers.
+  SizeDistribution container_size{0, 8, 0.0};
+
+  // Containers nested deeper than this are empty and optionals unfilled.
+  std::size_t max_depth{8};
+
+  // Probability that each active table entry is filled.
+  double entry_occupancy{0.75};
+
+  // Probability that an optional is filled.
+  double optional_occupancy{0.5};
+
+  // Probability that a variant is empty.
+  double empty_variant{0.0};
+
+  // Relative weights of the element types of variants, by element index.
+  // Elements beyond the end of the list have weight one.
+  std::vector<double> variant_weights;
+};
+
+// Generation of random values of type T. Specializations provide:
+//
+//   template <typename Generator>
+//   static void Generate(T* value, Generator* generator);
+//
+template <typename T, typename Enabled = void>
+struct RandomValue {
+  static_assert(sizeof(T) != sizeof(T),
+                "RandomValue does not support this type. Specialize "
+                "RandomValue<T> to generate values of it.");
+};
+
+// Generator of random values with the distributions given by
+// RandomValueOptions. Generators are deterministic for a given seed, engine,
+// and options, so corpora may be regenerated instead of stored.
+template <typename Engine = std::mt19937_64>
+class BasicRandomValueGenerator {
+ public:
+  explicit BasicRandomValueGenerator(
+      typename Engine::result_type seed,
+      RandomValueOptions options = RandomValueOptions{})
+      : engine_{seed}, options_{std::move(options)} {}
+
+  // Returns a new random value of type T.
+  template <typename T>
+  T Generate() {
+    T value{};
+    Generate(&value);
+    return value;
+  }
+
+  // Replaces |value| with a random value.
+  template <typename T>
+  void Generate(T* value) {
+    RandomValue<T>::Generate(value, this);
+  }
+
+  // Returns true with probability |p|.
+  bool Chance(double p) {
+    return p >= 1.0 ||
+           (p > 0.0 && std::bernoulli_distribution{p}(engine_));
+  }
+
+  // Returns a random integer with the distribution of integer_bits.
+  template <typename T>
+  T Integer() {
+    const std::size_t digits = std::numeric_limits<T>::digits;
+    const std::size_t bits = std::min(options_.integer_bits(&engine_), digits);
+    if (bits == 0)
+      return T{0};
+
+    const std::uint64_t max =
+        bits >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << bits) - 1;
+    const T magnitude = static_cast<T>(
+        std::uniform_int_distribution<std::uint64_t>{0, max}(engine_));
+    if (std::is_signed<T>::value && Chance(0.5))
+      return static_cast<T>(-magnitude);
+    else
+      return magnitude;
+  }
+
+  // Returns a random length for a string.
+  std::size_t StringLength() { return options_.string_length(&engine_); }
+
+  // Returns a random size for a container, or zero when nested too deeply.
+  std::size_t ContainerSize() {
+    return depth_ >= options_.max_depth ? 0
+                                        : options_.container_size(&engine_);
+  }
+
+  // Returns true if an optional should be filled.
+  bool FillOptional() {
+    return depth_ < options_.max_depth && Chance(options_.optional_occupancy);
+  }
+
+  // Returns the index of the element type a variant with |count| element types
+  // should hold, or Variant<>::kEmptyIndex for an empty variant.
+  std::int32_t VariantIndex(std::size_t count) {
+    if (count == 0 || Chance(options_.empty_variant))
+      return -1;
+
+    std::vector<double> weights(count, 1.0);
+    const std::size_t given = std::min(count, options_.variant_weights.size());
+    std::copy(options_.variant_weights.begin(),
+              options_.variant_weights.begin() + given, weights.begin());
+    std::discrete_distribution<std::int32_t> distribution{weights.begin(),
+                                                          weights.end()};
+    return distribution(engine_);
+  }
+
+  // Tracks the nesting of containers while their elements are generated.
+  class NestingScope {
+   public:
+    explicit NestingScope(BasicRandomValueGenerator* generator)
+        : generator_{generator} {
+      generator_->depth_++;
+    }
+    ~NestingScope() { generator_->depth_--; }
+
+    NestingScope(const NestingScope&) = delete;
+    void operator=(const NestingScope&) = delete;
+
+   private:
+    BasicRandomValueGenerator* generator_;
+  };
+
+  Engine& engine() { return engine_; }
+  const RandomValueOptions& options() const { return options_; }
+  std::size_t depth() const { return depth_; }
+
+ private:
+  Engine engine_;
+  RandomValueOptions options_;
+  std::size_t depth_{0};
+};
+
+// RandomValueGenerator with the default engine.
+using RandomValueGenerator = BasicRandomValueGenerator<>;
+
+// Returns |count| random values of type T.
+template <typename T, typename Generator>
+std::vector<T> GenerateCorpus(std::size_t count, Generator* generator) {
+  std::vector<T> corpus;
+  corpus.reserve(count);
+  for (std::size_t i = 0; i < count; i++)
+    corpus.push_back(generator->template Generate<T>());
+  return corpus;
+}
+
+//
+// Specializations for the built-in types.
+//
+
+template <>
+struct RandomValue<bool> {
+  template <typename Generator>
+  static void Generate(bool* value, Generator* generator) {
+    *value = generator->Chance(0.5);
+  }
+};
+
+template <typename T>
+struct RandomValue<
+    T, std::enable_if_t<std::is_integral<T>::value &&
+                        !std::is_same<T, bool>::value>> {
+  template <typename Generator>
+  static void Generate(T* value, Generator* generator) {
+    *value = generator->template Integer<T>();
+  }
+};
+
+template <typename T>
+struct RandomValue<T, std::enable_if_t<std::is_floating_point<T>::value>> {
+  template <typename Generator>
+  static void Generate(T* value, Generator* generator) {
+    std::normal_distribution<double> distribution{
+        0.0, generator->options().float_scale};
+    *value = static_cast<T>(distribution(generator->engine()));
+  }
+};
+
+template <typename T>
+struct RandomValue<T, std::enable_if_t<std::is_enum<T>::value>> {
+  template <typename Generator>
+  static void Generate(T* value, Generator* generator) {
+    using Underlying = std::underlying_type_t<T>;
+    const std::size_t count = std::max<std::size_t>(
+        1, generator->options().enum_values);
+    *value = static_cast<T>(static_cast<Underlying>(
+        std::uniform_int_distribution<std::size_t>{0, count - 1}(
+            generator->engine())));
+  }
+};
+
+template <typename CharT, typename Traits, typename Allocator>
+struct RandomValue<std::basic_string<CharT, Traits, Allocator>> {
+  template <typename Generator>
+  static void Generate(std::basic_string<CharT, Traits, Allocator>* value,
+                       Generator* generator) {
+    // Printable ASCII characters.
+    std::uniform_int_distribution<int> distribution{0x20, 0x7e};
+    const std::size_t length = generator->StringLength();
+    value->clear();
+    value->reserve(length);
+    for (std::size_t i = 0; i < length; i++)
+      value->push_back(static_cast<CharT>(distribution(generator->engine())));
+  }
+};
+
+// Fills sequence containers with a random number of random elements.
+template <typename Sequence>
+struct RandomSequence {
+  template <typename Generator>
+  static void Generate(Sequence* value, Generator* generator) {
+    using ValueType = typename Sequence::value_type;
+    const std::size_t size = generator->ContainerSize();
+    typename Generator::NestingScope scope{generator};
+    value->clear();
+    for (std::size_t i = 0; i < size; i++)
+      value->push_back(generator->template Generate<ValueType>());
+  }
+};
+
+template <typename T, typename Allocator>
+struct RandomValue<std::vector<T, Allocator>>
+    : RandomSequence<std::vector<T, Allocator>> {};
+
+template <typename T, typename Allocator>
+struct RandomValue<std::list<T, Allocator>>
+    : RandomSequence<std::list<T, Allocator>> {};
+
+template <typename T, typename Allocator>
+struct RandomValue<std::deque<T, Allocator>>
+    : RandomSequence<std::deque<T, Allocator>> {};
+
+// Fills associative containers with a random number of random elements.
+// Elements with keys that are already present are dropped.
+template <typename Container>
+struct RandomAssociative {
+  template <typename Generator>
+  static void Generate(Container* value, Generator* generator) {
+    using KeyType = std::remove_const_t<typename Container::key_type>;
+    const std::size_t size = generator->ContainerSize();
+    typename Generator::NestingScope scope{generator};
+    value->clear();
+    for (std::size_t i = 0; i < size; i++)
+      Insert(value, generator->template Generate<KeyType>(), generator,
+             IsSet{});
+  }
+
+ private:
+  using IsSet = std::is_same<typename Container::key_type,
+                             typename Container::value_type>;
+
+  template <typename Key, typename Generator>
+  static void Insert(Container* value, Key&& key, Generator* /*generator*/,
+                     std::true_type /*is_set*/) {
+    value->insert(std::forward<Key>(key));
+  }
+
+  // Maps also take a random mapped value for each key.
+  template <typename Key, typename Generator>
+  static void Insert(Container* value, Key&& key, Generator* generator,
+                     std::false_type /*is_set*/) {
+    using MappedType = typename Container::mapped_type;
+    value->emplace(std::forward<Key>(key),
+                   generator->template Generate<MappedType>());
+  }
+};
+
+template <typename Key, typename T, typename Compare, typename Allocator>
+struct RandomValue<std::map<Key, T, Compare, Allocator>>
+    : RandomAssociative<std::map<Key, T, Compare, Allocator>> {};
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+struct RandomValue<std::unordered_map<Key, T, Hash, KeyEqual, Allocator>>
+    : RandomAssociative<std::unordered_map<Key, T, Hash, KeyEqual, Allocator>> {
+};
+
+template <typename Key, typename Compare, typename Allocator>
+struct RandomValue<std::set<Key, Compare, Allocator>>
+    : RandomAssociative<std::set<Key, Compare, Allocator>> {};
+
+template <typename Key, typename Hash, typename KeyEqual, typename Allocator>
+struct RandomValue<std::unordered_set<Key, Hash, KeyEqual, Allocator>>
+    : RandomAssociative<std::unordered_set<Key, Hash, KeyEqual, Allocator>> {};
+
+// Fixed size arrays are always full.
+template <typename T, std::size_t Length>
+struct RandomValue<std::array<T, Length>> {
+  template <typename Generator>
+  static void Generate(std::array<T, Length>* value, Generator* generator) {
+    typename Generator::NestingScope scope{generator};
+    for (T& element : *value)
+      generator->Generate(&element);
+  }
+};
+
+template <typename T, std::size_t Length>
+struct RandomValue<T[Length]> {
+  template <typename Generator>
+  static void Generate(T (*value)[Length], Generator* generator) {
+    typename Generator::NestingScope scope{generator};
+    for (T& element : *value)
+      generator->Generate(&element);
+  }
+};
+
+template <typename T, typename U>
+struct RandomValue<std::pair<T, U>> {
+  template <typename Generator>
+  static void Generate(std::pair<T, U>* value, Generator* generator) {
+    generator->Generate(&value->first);
+    generator->Generate(&value->second);
+  }
+};
+
+template <typename... Types>
+struct RandomValue<std::tuple<Types...>> {
+  template <typename Generator>
+  static void Generate(std::tuple<Types...>* value, Generator* generator) {
+    GenerateElements(value, generator, std::index_sequence_for<Types...>{});
+  }
+
+ private:
+  template <typename Generator, std::size_t... Is>
+  static void GenerateElements(std::tuple<Types...>* value,
+                               Generator* generator,
+                               std::index_sequence<Is...>) {
+    const int expand[] = {0,
+                          (generator->Generate(&std::get<Is>(*value)), 0)...};
+    (void)expand;
+  }
+};
+
+template <typename T>
+struct RandomValue<Optional<T>> {
+  template <typename Generator>
+  static void Generate(Optional<T>* value, Generator* generator) {
+    if (generator->FillOptional()) {
+      typename Generator::NestingScope scope{generator};
+      *value = generator->template Generate<T>();
+    } else {
+      value->clear();
+    }
+  }
+};
+
+template <typename... Ts>
+struct RandomValue<Variant<Ts...>> {
+  template <typename Generator>
+  static void Generate(Variant<Ts...>* value, Generator* generator) {
+    value->Become(generator->VariantIndex(sizeof...(Ts)));
+    value->Visit(
+        [generator](auto&& element) { GenerateElement(&element, generator); });
+  }
+
+ private:
+  template <typename T, typename Generator>
+  static void GenerateElement(T* element, Generator* generator) {
+    generator->Generate(element);
+  }
+
+  template <typename Generator>
+  static void GenerateElement(EmptyVariant* /*element*/,
+                              Generator* /*generator*/) {}
+};
+
+// Generates the members of structures and value wrappers from their member
+// lists. Members that are logical buffers are given a random size no larger
+// than their array.
+template <typename MemberList>
+struct RandomMembers {
+  template <typename T, typename Generator>
+  static void Generate(T* value, Generator* generator) {
+    GenerateMembers(value, generator,
+                    std::make_index_sequence<MemberList::Count>{});
+  }
+
+ private:
+  template <typename T, typename Generator, std::size_t... Is>
+  static void GenerateMembers(T* value, Generator* generator,
+                              std::index_sequence<Is...>) {
+    const int expand[] = {
+        0,
+        (GenerateMember(MemberList::template At<Is>::Resolve(value), generator),
+         0)...};
+    (void)expand;
+  }
+
+  template <typename Member, typename Generator>
+  static void GenerateMember(Member* member, Generator* generator) {
+    generator->Generate(member);
+  }
+
+  template <typename BufferType, typename SizeType, bool IsUnbounded,
+            typename Generator>
+  static void GenerateMember(
+      LogicalBuffer<BufferType, SizeType, IsUnbounded> buffer,
+      Generator* generator) {
+    using Buffer = LogicalBuffer<BufferType, SizeType, IsUnbounded>;
+    const std::size_t size = std::min<std::size_t>(generator->ContainerSize(),
+                                                   Buffer::Length);
+    typename Generator::NestingScope scope{generator};
+    buffer.size() = static_cast<SizeType>(size);
+    for (auto& element : buffer)
+      generator->Generate(&element);
+  }
+};
+
+template <typename T>
+struct RandomValue<T, std::enable_if_t<HasMemberList<T>::value>>
+    : RandomMembers<typename MemberListTraits<T>::MemberList> {};
+
+template <typename T>
+struct RandomValue<T, EnableIfIsValueWrapper<T>>
+    : RandomMembers<typename ValueWrapperTraits<T>::MemberList> {};
+
+// Fills each active entry of a table with probability entry_occupancy.
+template <typename Table>
+struct RandomValue<Table, EnableIfHasEntryList<Table>> {
+  template <typename Generator>
+  static void Generate(Table* value, Generator* generator) {
+    GenerateEntries(value, generator, std::make_index_sequence<Count>{});
+  }
+
+ private:
+  using EntryList = typename EntryListTraits<Table>::EntryList;
+  enum : std::size_t { Count = EntryList::Count };
+
+  template <typename Generator, std::size_t... Is>
+  static void GenerateEntries(Table* value, Generator* generator,
+                              std::index_sequence<Is...>) {
+    const int expand[] = {
+        0,
+        (GenerateEntry(EntryList::template At<Is>::Resolve(value), generator),
+         0)...};
+    (void)expand;
+  }
+
+  template <typename T, std::uint64_t Id, typename Generator>
+  static void GenerateEntry(Entry<T, Id, ActiveEntry>* entry,
+                            Generator* generator) {
+    if (generator->Chance(generator->options().entry_occupancy))
+      *entry = generator->template Generate<T>();
+    else
+      entry->clear();
+  }
+
+  template <typename T, std::uint64_t Id, typename Generator>
+  static void GenerateEntry(Entry<T, Id, DeletedEntry>* /*entry*/,
+                            Generator* /*generator*/) {}
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_RANDOM_VALUE_H_
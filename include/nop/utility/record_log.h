@@ -0,0 +1,633 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_RECORD_LOG_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_RECORD_LOG_H_
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/status.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/crc32c.h>
+#include <nop/utility/mmap_reader.h>
+#include <nop/utility/vector_writer.h>
+
+namespace nop {
+
+//
+// Append-only log of serialized records.
+//
+// Records are grouped into blocks, each preceded by a header with a checksum,
+// and a cleanly closed log ends with an index of the blocks for seeking by
+// record number:
+//
+// +--------+---------+-----+---------+-------+--------+
+// | HEADER | BLOCK 0 | ... | BLOCK N | INDEX | FOOTER |
+// +--------+---------+-----+---------+-------+--------+
+//
+// Each block holds the records written since the previous block, each record
+// prefixed by its U32 length:
+//
+// +-------+---------+-------------------+-----------+------------+-----------+
+// | MAGIC | U32:CRC | U64:FIRST_RECORD  | U32:COUNT | U32:LENGTH | RECORDS...|
+// +-------+---------+-------------------+-----------+------------+-----------+
+//
+// The CRC-32C covers the header fields after it and the records. The index is
+// the offset and first record number of every block, and the footer records
+// the offset of the index, the total number of records, and the CRC-32C of the
+// index. All fields are in host byte order.
+//
+// A log that was not closed cleanly, because the process crashed, lacks the
+// index. Its blocks are then found by following the block headers from the
+// start of the file, which touches only the headers, and only the checksum of
+// the last block is verified to drop a block torn by the crash. The checksums
+// of the other blocks are verified when they are read.
+//
+
+namespace detail {
+
+enum : std::uint32_t {
+  kRecordLogMagic = 0x474c504e,  // "NPLG"
+  kRecordLogVersion = 1,
+  kRecordBlockMagic = 0x4b4c424e,  // "NBLK"
+  kRecordFooterMagic = 0x444e454e,  // "NEND"
+};
+
+struct RecordLogHeader {
+  std::uint32_t magic;
+  std::uint32_t version;
+};
+
+struct RecordBlockHeader {
+  std::uint32_t magic;
+  std::uint32_t crc;
+  std::uint64_t first_record;
+  std::uint32_t count;
+  std::uint32_t length;
+};
+
+struct RecordIndexEntry {
+  std::uint64_t offset;
+  std::uint64_t first_record;
+};
+
+struct RecordLogFooter {
+  std::uint32_t magic;
+  std::uint32_t crc;
+  std::uint64_t index_offset;
+  std::uint64_t record_count;
+};
+
+static_assert(sizeof(RecordBlockHeader) == 24, "Unexpected block header size.");
+static_assert(sizeof(RecordLogFooter) == 24, "Unexpected footer size.");
+
+// Returns the checksum of the block with |header| and |payload|.
+inline std::uint32_t RecordBlockCrc(const RecordBlockHeader& header,
+                                    const std::uint8_t* payload) {
+  const std::size_t offset = offsetof(RecordBlockHeader, first_record);
+  const std::uint32_t crc =
+      Crc32c(reinterpret_cast<const std::uint8_t*>(&header) + offset,
+             sizeof(header) - offset);
+  return Crc32c(payload, header.length, crc);
+}
+
+// Block index of a record log, loaded from the index at the end of the file or
+// rebuilt from the block headers.
+struct RecordLogIndex {
+  std::vector<RecordIndexEntry> entries;
+  std::uint64_t record_count{0};
+
+  // Offset of the end of the last valid block.
+  std::uint64_t end{sizeof(RecordLogHeader)};
+
+  // True if the index was rebuilt because the log was not closed cleanly.
+  bool recovered{false};
+
+  // Loads the index of the log of |size| bytes at |data|.
+  Status<void> Load(const std::uint8_t* data, std::size_t size) {
+    entries.clear();
+    record_count = 0;
+    end = sizeof(RecordLogHeader);
+    recovered = false;
+
+    RecordLogHeader header;
+    if (size < sizeof(header))
+      return ErrorStatus::ProtocolError;
+
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != kRecordLogMagic ||
+        header.version != kRecordLogVersion) {
+      return ErrorStatus::ProtocolError;
+    }
+
+    if (LoadIndex(data, size))
+      return {};
+
+    Recover(data, size);
+    return {};
+  }
+
+ private:
+  // Loads the index written when the log was closed. Returns false if the
+  // footer or index is missing or invalid.
+  bool LoadIndex(const std::uint8_t* data, std::size_t size) {
+    RecordLogFooter footer;
+    if (size < sizeof(RecordLogHeader) + sizeof(footer))
+      return false;
+
+    const std::size_t footer_offset = size - sizeof(footer);
+    std::memcpy(&footer, data + footer_offset, sizeof(footer));
+    if (footer.magic != kRecordFooterMagic ||
+        footer.index_offset < sizeof(RecordLogHeader) ||
+        footer.index_offset > footer_offset ||
+        (footer_offset - footer.index_offset) % sizeof(RecordIndexEntry)) {
+      return false;
+    }
+
+    const std::size_t index_size = footer_offset - footer.index_offset;
+    std::uint32_t crc = Crc32c(data + footer.index_offset, index_size);
+    crc = Crc32c(&footer.index_offset,
+                 sizeof(footer) - offsetof(RecordLogFooter, index_offset), crc);
+    if (crc != footer.crc)
+      return false;
+
+    entries.resize(index_size / sizeof(RecordIndexEntry));
+    if (index_size > 0)
+      std::memcpy(entries.data(), data + footer.index_offset, index_size);
+    record_count = footer.record_count;
+    end = footer.index_offset;
+    return true;
+  }
+
+  // Rebuilds the index by following the block headers, keeping the blocks up
+  // to the first invalid header and dropping the last block if it was torn.
+  void Recover(const std::uint8_t* data, std::size_t size) {
+    recovered = true;
+
+    std::uint64_t offset = sizeof(RecordLogHeader);
+    RecordBlockHeader header;
+    while (size - offset >= sizeof(header)) {
+      std::memcpy(&header, data + offset, sizeof(header));
+      if (header.magic != kRecordBlockMagic ||
+          header.first_record != record_count ||
+          header.length > size - offset - sizeof(header)) {
+        break;
+      }
+
+      entries.push_back({offset, header.first_record});
+      record_count += header.count;
+      offset += sizeof(header) + header.length;
+    }
+
+    // Verify the last block, which a crash may have left partially written.
+    if (!entries.empty()) {
+      const RecordIndexEntry& last = entries.back();
+      std::memcpy(&header, data + last.offset, sizeof(header));
+      if (RecordBlockCrc(header, data + last.offset + sizeof(header)) !=
+          header.crc) {
+        offset = last.offset;
+        record_count = last.first_record;
+        entries.pop_back();
+      }
+    }
+    end = offset;
+  }
+};
+
+}  // namespace detail
+
+// RecordLogWriter appends serialized records to a record log file. Records are
+// buffered until the block reaches the configured block size, and each block
+// is written to the file with one system call. The writer takes ownership of
+// the fd passed to Open() and closes it when closed or destroyed.
+//
+// Opening a file that already holds a log continues the log: a cleanly closed
+// log has its index removed, to be written again when the writer is closed,
+// and a log that was not closed cleanly is truncated after its last valid
+// block.
+//
+// Example:
+//
+//   nop::RecordLogWriter log;
+//   auto status = log.Open(open(path, O_RDWR | O_CREAT, 0644));
+//   for (const auto& event : events)
+//     status = log.Write(event);
+//   status = log.Close();
+//
+class RecordLogWriter {
+ public:
+  enum : std::size_t { kDefaultBlockSize = 64 * 1024 };
+
+  RecordLogWriter() = default;
+  RecordLogWriter(const RecordLogWriter&) = delete;
+  void operator=(const RecordLogWriter&) = delete;
+
+  ~RecordLogWriter() { Close(); }
+
+  // Takes ownership of |fd| and prepares to append records in blocks of about
+  // |block_size| bytes.
+  Status<void> Open(int fd, std::size_t block_size = kDefaultBlockSize) {
+    Close();
+    fd_ = fd;
+    block_size_ = block_size;
+    if (fd_ < 0)
+      return ErrorStatus::IOError;
+
+    struct stat file_stat;
+    if (::fstat(fd_, &file_stat) < 0)
+      return ErrorStatus::IOError;
+
+    detail::RecordLogIndex index;
+    const std::size_t size = static_cast<std::size_t>(file_stat.st_size);
+    if (size == 0) {
+      const detail::RecordLogHeader header{detail::kRecordLogMagic,
+                                           detail::kRecordLogVersion};
+      auto status = WriteBytes(&header, sizeof(header), nullptr, 0);
+      if (!status)
+        return status;
+    } else {
+      void* address = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0);
+      if (address == MAP_FAILED)
+        return ErrorStatus::IOError;
+
+      auto status = index.Load(static_cast<const std::uint8_t*>(address), size);
+      ::munmap(address, size);
+      if (!status)
+        return status;
+
+      // Drop the index or the torn block and append after the last block.
+      if (::ftruncate(fd_, static_cast<off_t>(index.end)) < 0 ||
+          ::lseek(fd_, static_cast<off_t>(index.end), SEEK_SET) < 0) {
+        return ErrorStatus::IOError;
+      }
+    }
+
+    entries_ = std::move(index.entries);
+    record_count_ = index.record_count;
+    block_first_record_ = record_count_;
+    offset_ = index.end;
+    return {};
+  }
+
+  // Serializes |value| as the next record.
+  template <typename T>
+  Status<void> Write(const T& value) {
+    if (fd_ < 0)
+      return ErrorStatus::IOError;
+
+    VectorWriter& writer = block_.writer();
+    const std::size_t position = writer.size();
+    auto status = writer.Skip(sizeof(std::uint32_t));
+    if (status)
+      status = block_.Write(value);
+
+    const std::size_t length = writer.size() - position - sizeof(std::uint32_t);
+    if (status && length > std::numeric_limits<std::uint32_t>::max())
+      status = ErrorStatus::WriteLimitReached;
+    if (!status) {
+      writer.Truncate(position);
+      return status;
+    }
+
+    const std::uint32_t length_bytes = static_cast<std::uint32_t>(length);
+    writer.Patch(position, &length_bytes, &length_bytes + 1);
+    record_count_++;
+
+    if (writer.size() >= block_size_)
+      return Flush();
+    else
+      return {};
+  }
+
+  // Writes the records buffered so far to the file as a block.
+  Status<void> Flush() {
+    const std::vector<std::uint8_t>& payload = block_.writer().buffer();
+    if (payload.empty())
+      return {};
+    else if (payload.size() > std::numeric_limits<std::uint32_t>::max())
+      return ErrorStatus::WriteLimitReached;
+
+    detail::RecordBlockHeader header;
+    header.magic = detail::kRecordBlockMagic;
+    header.first_record = block_first_record_;
+    header.count = static_cast<std::uint32_t>(record_count_ -
+                                              block_first_record_);
+    header.length = static_cast<std::uint32_t>(payload.size());
+    header.crc = detail::RecordBlockCrc(header, payload.data());
+
+    auto status =
+        WriteBytes(&header, sizeof(header), payload.data(), payload.size());
+    if (!status)
+      return status;
+
+    entries_.push_back({offset_, block_first_record_});
+    offset_ += sizeof(header) + payload.size();
+    block_first_record_ = record_count_;
+    block_.writer().reset();
+    return {};
+  }
+
+  // Writes buffered records and waits for the file to reach storage.
+  Status<void> Sync() {
+    auto status = Flush();
+    if (!status)
+      return status;
+    else if (::fdatasync(fd_) < 0)
+      return ErrorStatus::IOError;
+    else
+      return {};
+  }
+
+  // Writes buffered records and the index, and closes the file.
+  Status<void> Close() {
+    if (fd_ < 0)
+      return {};
+
+    auto status = Flush();
+    if (status) {
+      detail::RecordLogFooter footer;
+      footer.magic = detail::kRecordFooterMagic;
+      footer.index_offset = offset_;
+      footer.record_count = record_count_;
+
+      const std::size_t index_size =
+          entries_.size() * sizeof(detail::RecordIndexEntry);
+      std::uint32_t crc = Crc32c(entries_.data(), index_size);
+      footer.crc = Crc32c(
+          &footer.index_offset,
+          sizeof(footer) - offsetof(detail::RecordLogFooter, index_offset),
+          crc);
+      status = WriteBytes(entries_.data(), index_size, &footer, sizeof(footer));
+    }
+
+    ::close(Release());
+    return status;
+  }
+
+  // Writes buffered records and releases ownership of the fd without writing
+  // the index. The log may be continued by opening the fd again.
+  int Release() {
+    Flush();
+    const int released_fd = fd_;
+    fd_ = -1;
+    entries_.clear();
+    block_.writer().reset();
+    record_count_ = 0;
+    block_first_record_ = 0;
+    offset_ = 0;
+    return released_fd;
+  }
+
+  // Returns the number of records in the log, including buffered records.
+  std::uint64_t record_count() const { return record_count_; }
+
+  // Returns the number of blocks written to the file.
+  std::size_t block_count() const { return entries_.size(); }
+
+  std::size_t block_size() const { return block_size_; }
+  int fd() const { return fd_; }
+
+ private:
+  // Writes |first| followed by |second| to the fd, handling partial writes.
+  Status<void> WriteBytes(const void* first, std::size_t first_size,
+                          const void* second, std::size_t second_size) {
+    iovec vec[2] = {{const_cast<void*>(first), first_size},
+                    {const_cast<void*>(second), second_size}};
+    iovec* current = &vec[0];
+    std::size_t count = 2;
+
+    while (count > 0) {
+      if (current->iov_len == 0) {
+        current++;
+        count--;
+        continue;
+      }
+
+      const ssize_t ret = ::writev(fd_, current, static_cast<int>(count));
+      if (ret > 0) {
+        std::size_t written = static_cast<std::size_t>(ret);
+        while (written > 0) {
+          const std::size_t consumed = std::min(written, current->iov_len);
+          current->iov_base = static_cast<std::uint8_t*>(current->iov_base) +
+                              consumed;
+          current->iov_len -= consumed;
+          written -= consumed;
+          if (current->iov_len == 0 && count > 1) {
+            current++;
+            count--;
+          }
+        }
+      } else if (ret == 0) {
+        return ErrorStatus::WriteLimitReached;
+      } else if (errno != EINTR) {
+        return ErrorStatus::IOError;
+      }
+    }
+    return {};
+  }
+
+  int fd_{-1};
+  std::size_t block_size_{kDefaultBlockSize};
+  Serializer<VectorWriter> block_;
+  std::vector<detail::RecordIndexEntry> entries_;
+  std::uint64_t record_count_{0};
+  std::uint64_t block_first_record_{0};
+  std::uint64_t offset_{0};
+};
+
+// RecordLogReader reads the records of a record log, sequentially or starting
+// from any record number, directly from a read-only mapping of the file. The
+// block containing a record is found with a binary search over the index, and
+// the checksum of each block is verified when reading first enters it. The
+// reader takes ownership of the fd passed to Open().
+//
+// Example:
+//
+//   nop::RecordLogReader log;
+//   auto status = log.Open(open(path, O_RDONLY));
+//   status = log.Seek(1000);
+//   Event event;
+//   while (log.Read(&event))
+//     Replay(event);
+//
+class RecordLogReader {
+ public:
+  RecordLogReader() = default;
+  RecordLogReader(const RecordLogReader&) = delete;
+  void operator=(const RecordLogReader&) = delete;
+
+  // Takes ownership of |fd|, maps the log, and loads its index, rebuilding the
+  // index if the log was not closed cleanly.
+  Status<void> Open(int fd) {
+    index_ = {};
+    ResetPosition();
+    auto status = mapping_.Open(fd);
+    if (!status)
+      return status;
+
+    return index_.Load(mapping_.data(), mapping_.size());
+  }
+
+  void Clear() {
+    mapping_.Clear();
+    index_ = {};
+    ResetPosition();
+  }
+
+  // Positions the reader at record number |record|. Seeking to the end of the
+  // log is allowed.
+  Status<void> Seek(std::uint64_t record) {
+    if (record > index_.record_count)
+      return ErrorStatus::ReadLimitReached;
+
+    ResetPosition();
+    const auto& entries = index_.entries;
+    auto found = std::upper_bound(
+        entries.begin(), entries.end(), record,
+        [](std::uint64_t number, const detail::RecordIndexEntry& entry) {
+          return number < entry.first_record;
+        });
+    if (found == entries.begin())
+      return {};
+
+    auto status = EnterBlock(found - entries.begin() - 1);
+    if (!status)
+      return status;
+
+    // Skip over the preceding records of the block by their lengths.
+    while (next_record_ < record) {
+      auto length = NextRecord();
+      if (!length)
+        return length.error();
+      cursor_ += length.get();
+    }
+    return {};
+  }
+
+  // Deserializes the next record into |value|. Returns ReadLimitReached at the
+  // end of the log.
+  template <typename T>
+  Status<void> Read(T* value) {
+    auto length = NextRecord();
+    if (!length)
+      return length.error();
+
+    Deserializer<BufferReader> deserializer{mapping_.data() + cursor_,
+                                            length.get()};
+    cursor_ += length.get();
+    return deserializer.Read(value);
+  }
+
+  // Returns the number of the record read next.
+  std::uint64_t position() const { return next_record_; }
+
+  std::uint64_t record_count() const { return index_.record_count; }
+  std::size_t block_count() const { return index_.entries.size(); }
+
+  // Returns true if the index was rebuilt because the log was not closed
+  // cleanly.
+  bool recovered() const { return index_.recovered; }
+
+ private:
+  void ResetPosition() {
+    block_ = 0;
+    block_end_ = 0;
+    cursor_ = 0;
+    next_record_ = 0;
+    block_remaining_ = 0;
+  }
+
+  // Verifies block |block| and positions the reader at its first record.
+  Status<void> EnterBlock(std::size_t block) {
+    const std::uint8_t* data = mapping_.data();
+    const detail::RecordIndexEntry& entry = index_.entries[block];
+    detail::RecordBlockHeader header;
+    if (entry.offset > index_.end ||
+        index_.end - entry.offset < sizeof(header)) {
+      return ErrorStatus::ProtocolError;
+    }
+
+    std::memcpy(&header, data + entry.offset, sizeof(header));
+    const std::size_t payload = entry.offset + sizeof(header);
+    if (header.magic != detail::kRecordBlockMagic ||
+        header.first_record != entry.first_record ||
+        header.length > index_.end - payload ||
+        detail::RecordBlockCrc(header, data + payload) != header.crc) {
+      return ErrorStatus::ProtocolError;
+    }
+
+    block_ = block + 1;
+    cursor_ = payload;
+    block_end_ = payload + header.length;
+    next_record_ = header.first_record;
+    block_remaining_ = header.count;
+    return {};
+  }
+
+  // Advances to the next record, entering the next block if necessary, and
+  // returns its length with the cursor at its first byte.
+  Status<std::size_t> NextRecord() {
+    while (block_remaining_ == 0) {
+      if (block_ >= index_.entries.size())
+        return ErrorStatus::ReadLimitReached;
+
+      auto status = EnterBlock(block_);
+      if (!status)
+        return status.error();
+    }
+
+    std::uint32_t length;
+    if (block_end_ - cursor_ < sizeof(length))
+      return ErrorStatus::ProtocolError;
+
+    std::memcpy(&length, mapping_.data() + cursor_, sizeof(length));
+    cursor_ += sizeof(length);
+    if (length > block_end_ - cursor_)
+      return ErrorStatus::ProtocolError;
+
+    block_remaining_--;
+    next_record_++;
+    return length;
+  }
+
+  MmapReader mapping_;
+  detail::RecordLogIndex index_;
+
+  // Index of the block entered next, and the bounds of the current block.
+  std::size_t block_{0};
+  std::size_t block_end_{0};
+  std::size_t cursor_{0};
+  std::uint64_t next_record_{0};
+  std::uint32_t block_remaining_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_RECORD_LOG_H_
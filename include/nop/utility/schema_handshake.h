@@ -0,0 +1,167 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_SCHEMA_HANDSHAKE_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_SCHEMA_HANDSHAKE_H_
+
+#include <cstdint>
+
+#include <nop/base/serializer.h>
+#include <nop/status.h>
+#include <nop/traits/schema_fingerprint.h>
+#include <nop/utility/fixed_width_writer.h>
+#include <nop/utility/trusted_reader.h>
+
+namespace nop {
+
+// Modes of a connection negotiated by SchemaHandshake.
+enum class SchemaMode : std::uint8_t {
+  // The peers' schemas differ: values are written and read with the standard
+  // encoding and every read is checked against the expected types.
+  Standard,
+  // The peers' schemas match: reads elide the checks of the encoding shape;
+  // see TrustedReader.
+  Trusted,
+  // As Trusted, and writes also use fixed-width integers; see
+  // FixedWidthWriter. This suits CPU-bound links where the larger encoding is
+  // cheaper than choosing the smallest prefix for each integer.
+  TrustedFixedWidth,
+};
+
+//
+// SchemaHandshake exchanges the combined SchemaFingerprint of Types, the types
+// sent over a connection, when the connection is established. Peers built
+// with identical definitions of those types agree on a fast mode; peers built
+// from different versions fall back to the standard, checked encoding, so a
+// connection is always safe and at full speed between identical builds.
+//
+// The fingerprint is written with the standard encoding, so that any two
+// peers can read it, whatever their versions. Both peers reach the same mode,
+// since they compare the same two fingerprints.
+//
+// Example:
+//
+//   using Handshake = nop::SchemaHandshake<Request, Response>;
+//   auto mode = Handshake::Negotiate(&writer, &reader);
+//   if (!mode)
+//     return mode.error();
+//
+//   nop::NegotiatedSerializer<Writer> serializer{&writer, mode.get()};
+//   nop::NegotiatedDeserializer<Reader> deserializer{&reader, mode.get()};
+//
+template <typename... Types>
+struct SchemaHandshake {
+  enum : std::uint64_t {
+    Fingerprint = CombinedSchemaFingerprint<Types...>::Value
+  };
+
+  // Writes the local fingerprint to |writer|. Buffering writers must be
+  // flushed before waiting for the peer's fingerprint.
+  template <typename Writer>
+  static Status<void> WriteFingerprint(Writer* writer) {
+    return Encoding<std::uint64_t>::Write(std::uint64_t{Fingerprint}, writer);
+  }
+
+  // Reads the peer's fingerprint from |reader| and returns |preferred| when it
+  // matches the local fingerprint, SchemaMode::Standard otherwise.
+  template <typename Reader>
+  static Status<SchemaMode> ReadFingerprint(
+      Reader* reader, SchemaMode preferred = SchemaMode::Trusted) {
+    std::uint64_t fingerprint = 0;
+    auto status = Encoding<std::uint64_t>::Read(&fingerprint, reader);
+    if (!status)
+      return status.error();
+    else if (fingerprint == Fingerprint)
+      return preferred;
+    else
+      return SchemaMode::Standard;
+  }
+
+  // Writes the local fingerprint and reads the peer's, returning the mode of
+  // the connection.
+  template <typename Writer, typename Reader>
+  static Status<SchemaMode> Negotiate(
+      Writer* writer, Reader* reader,
+      SchemaMode preferred = SchemaMode::Trusted) {
+    auto status = WriteFingerprint(writer);
+    if (!status)
+      return status.error();
+    else
+      return ReadFingerprint(reader, preferred);
+  }
+};
+
+// Serializer over a pointer to Writer that writes in the mode negotiated by
+// SchemaHandshake.
+template <typename Writer>
+class NegotiatedSerializer {
+ public:
+  NegotiatedSerializer(Writer* writer, SchemaMode mode)
+      : writer_{writer}, mode_{mode} {}
+
+  template <typename T, typename... Ts>
+  Status<void> Write(const T& value, const Ts&... values) {
+    if (mode_ == SchemaMode::TrustedFixedWidth) {
+      FixedWidthWriter<Writer> fixed_width_writer{writer_};
+      return Serializer<FixedWidthWriter<Writer>*>{&fixed_width_writer}.Write(
+          value, values...);
+    } else {
+      return Serializer<Writer*>{writer_}.Write(value, values...);
+    }
+  }
+
+  SchemaMode mode() const { return mode_; }
+
+  const Writer& writer() const { return *writer_; }
+  Writer& writer() { return *writer_; }
+
+ private:
+  Writer* writer_;
+  SchemaMode mode_;
+};
+
+// Deserializer over a pointer to Reader that reads in the mode negotiated by
+// SchemaHandshake.
+template <typename Reader>
+class NegotiatedDeserializer {
+ public:
+  NegotiatedDeserializer(Reader* reader, SchemaMode mode)
+      : reader_{reader}, mode_{mode} {}
+
+  template <typename T, typename... Ts>
+  Status<void> Read(T* value, Ts*... values) {
+    if (mode_ != SchemaMode::Standard) {
+      TrustedReader<Reader> trusted_reader{reader_};
+      return Deserializer<TrustedReader<Reader>*>{&trusted_reader}.Read(
+          value, values...);
+    } else {
+      return Deserializer<Reader*>{reader_}.Read(value, values...);
+    }
+  }
+
+  SchemaMode mode() const { return mode_; }
+
+  const Reader& reader() const { return *reader_; }
+  Reader& reader() { return *reader_; }
+
+ private:
+  Reader* reader_;
+  SchemaMode mode_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_SCHEMA_HANDSHAKE_H_
@@ -0,0 +1,339 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_SOCKET_READER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_SOCKET_READER_H_
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include <nop/status.h>
+#include <nop/types/handle.h>
+
+namespace nop {
+
+// SocketReader is a reader type that wraps around a UNIX domain stream socket
+// and receives the file handles sent by SocketWriter as SCM_RIGHTS ancillary
+// data. Data is received into an internal buffer with recvmsg(), and handles
+// received along with the data are stored in a handle table until they are
+// claimed by deserializing the handles that refer to them.
+//
+// Deserialized handles are owned by the caller, which is responsible for
+// closing them, for example by wrapping them in UniqueFileHandle. Handles that
+// are received but never claimed are closed when the reader is destroyed or
+// cleared.
+//
+// References to handles cached by SocketWriter::CacheHandle() are resolved
+// from the reader's handle cache instead. Cached handles remain owned by the
+// reader: they should be deserialized as non-owning FileHandle values and stay
+// open until they are evicted with EvictHandle() or the reader is cleared.
+//
+// The reader takes ownership of the socket and automatically closes it when
+// destroyed, unless it is released. Any data remaining in the internal buffer
+// is discarded when the socket is released or cleared.
+class SocketReader {
+ public:
+  enum : std::size_t { kDefaultBufferSize = 4096 };
+
+  // The maximum number of handles the kernel delivers with one call to
+  // recvmsg().
+  enum : std::size_t { kMaxHandlesPerMessage = 253 };
+
+  SocketReader() = default;
+  SocketReader(int fd, std::size_t buffer_size = kDefaultBufferSize)
+      : fd_{fd},
+        buffer_{new std::uint8_t[buffer_size]},
+        buffer_size_{buffer_size} {}
+  SocketReader(const SocketReader&) = delete;
+  SocketReader(SocketReader&& other) { *this = std::move(other); }
+
+  ~SocketReader() { Clear(); }
+
+  SocketReader& operator=(const SocketReader&) = delete;
+  SocketReader& operator=(SocketReader&& other) {
+    if (this != &other) {
+      Clear();
+      std::swap(fd_, other.fd_);
+      std::swap(buffer_, other.buffer_);
+      std::swap(buffer_size_, other.buffer_size_);
+      std::swap(begin_, other.begin_);
+      std::swap(end_, other.end_);
+      std::swap(handles_, other.handles_);
+      std::swap(handle_base_, other.handle_base_);
+      std::swap(cache_, other.cache_);
+    }
+    return *this;
+  }
+
+  // Closes the socket, the cached handles and any handles that have not been
+  // claimed.
+  void Clear() {
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = -1;
+    begin_ = end_ = 0;
+    ClearHandles();
+    for (const auto& entry : cache_)
+      ::close(entry.second);
+    cache_.clear();
+  }
+
+  // Releases ownership of the socket. Handles that have not been claimed remain
+  // in the handle table.
+  int Release() {
+    const int released_fd = fd_;
+    fd_ = -1;
+    begin_ = end_ = 0;
+    return released_fd;
+  }
+
+  Status<void> Ensure(std::size_t) { return {}; }
+
+  Status<void> Read(std::uint8_t* byte) {
+    if (begin_ == end_) {
+      auto status = Fill();
+      if (!status)
+        return status;
+    }
+
+    *byte = buffer_[begin_++];
+    return {};
+  }
+
+  Status<void> Read(void* begin, void* end) {
+    std::uint8_t* begin_byte = static_cast<std::uint8_t*>(begin);
+    std::uint8_t* end_byte = static_cast<std::uint8_t*>(end);
+
+    std::size_t length_bytes = end_byte - begin_byte;
+    while (length_bytes > 0) {
+      if (begin_ == end_) {
+        auto status = Fill();
+        if (!status)
+          return status;
+      }
+
+      const std::size_t count = std::min(length_bytes, buffered());
+      std::memcpy(begin_byte, &buffer_[begin_], count);
+      begin_ += count;
+      begin_byte += count;
+      length_bytes -= count;
+    }
+
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    while (padding_bytes > 0) {
+      if (begin_ == end_) {
+        auto status = Fill();
+        if (!status)
+          return status;
+      }
+
+      const std::size_t count = std::min(padding_bytes, buffered());
+      begin_ += count;
+      padding_bytes -= count;
+    }
+
+    return {};
+  }
+
+  // Claims the handle with the given reference from the handle table. Each
+  // handle may be claimed only once. References to cached handles may be
+  // resolved any number of times and return a handle owned by the reader.
+  template <typename HandleType>
+  Status<HandleType> GetHandle(HandleReference handle_reference) {
+    static_assert(std::is_same<typename HandleType::Type, int>::value,
+                  "SocketReader only supports file descriptor handles.");
+
+    if (handle_reference < 0)
+      return {HandleType{}};
+
+    if (handle_reference >= kCachedHandleReference) {
+      const HandleReference cache_id =
+          handle_reference - kCachedHandleReference;
+      auto search = cache_.find(cache_id);
+      if (search != cache_.end())
+        return {HandleType{search->second}};
+
+      // The first reference to a cached handle arrives with its transfer.
+      auto status = ClaimHandle(cache_id);
+      if (!status)
+        return status.error();
+
+      cache_.emplace(cache_id, status.get());
+      return {HandleType{status.get()}};
+    }
+
+    auto status = ClaimHandle(handle_reference);
+    if (!status)
+      return status.error();
+
+    return {HandleType{status.get()}};
+  }
+
+  // Closes the cached handle with the given reference, as returned by
+  // SocketWriter::EvictHandle(). Evicting kEmptyHandleReference does nothing.
+  Status<void> EvictHandle(HandleReference handle_reference) {
+    if (handle_reference == kEmptyHandleReference)
+      return {};
+
+    auto search = cache_.find(handle_reference - kCachedHandleReference);
+    if (handle_reference < kCachedHandleReference || search == cache_.end())
+      return ErrorStatus::InvalidHandleReference;
+
+    ::close(search->second);
+    cache_.erase(search);
+    return {};
+  }
+
+  // Closes any handles that have been received but not claimed.
+  void ClearHandles() {
+    for (int handle : handles_) {
+      if (handle >= 0)
+        ::close(handle);
+    }
+    handle_base_ += handles_.size();
+    handles_.clear();
+  }
+
+  // Returns the number of bytes received from the socket that have not yet
+  // been consumed by the reader.
+  std::size_t buffered() const { return end_ - begin_; }
+  std::size_t buffer_size() const { return buffer_size_; }
+
+  // Returns the number of handles received that have not been claimed.
+  std::size_t pending_handles() const {
+    return std::count_if(handles_.begin(), handles_.end(),
+                         [](int handle) { return handle >= 0; });
+  }
+
+  // Returns the number of handles in the handle cache.
+  std::size_t cached_handles() const { return cache_.size(); }
+
+ private:
+  HandleReference handle_end() const {
+    return handle_base_ + static_cast<HandleReference>(handles_.size());
+  }
+
+  // Removes the handle with the given reference from the handle table and
+  // returns it.
+  Status<int> ClaimHandle(HandleReference handle_reference) {
+    // Handles arrive with the data that precedes their references, so any
+    // valid reference is already in the handle table.
+    if (handle_reference < handle_base_ || handle_reference >= handle_end())
+      return ErrorStatus::InvalidHandleReference;
+
+    int& handle = handles_[handle_reference - handle_base_];
+    if (handle < 0)
+      return ErrorStatus::InvalidHandleReference;
+
+    const int claimed_handle = handle;
+    handle = -1;
+
+    // Drop claimed handles from the front of the table.
+    while (!handles_.empty() && handles_.front() < 0) {
+      handles_.pop_front();
+      handle_base_++;
+    }
+
+    return {claimed_handle};
+  }
+
+  // Receives at least one byte into the empty internal buffer.
+  Status<void> Fill() {
+    begin_ = end_ = 0;
+    auto status = Receive(buffer_.get(), buffer_size_);
+    if (!status)
+      return status.error();
+
+    end_ = status.get();
+    return {};
+  }
+
+  // Receives up to |size| bytes into |data|, storing any handles that arrive
+  // with the data in the handle table. Returns the number of bytes received.
+  Status<std::size_t> Receive(std::uint8_t* data, std::size_t size) {
+    union {
+      cmsghdr header;
+      char buffer[CMSG_SPACE(sizeof(int) * kMaxHandlesPerMessage)];
+    } control;
+
+    while (true) {
+      iovec vec = {data, size};
+      msghdr message = {};
+      message.msg_iov = &vec;
+      message.msg_iovlen = 1;
+      message.msg_control = control.buffer;
+      message.msg_controllen = sizeof(control.buffer);
+
+      const ssize_t ret = ::recvmsg(fd_, &message, MSG_CMSG_CLOEXEC);
+      if (ret >= 0) {
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr;
+             header = CMSG_NXTHDR(&message, header)) {
+          if (header->cmsg_level == SOL_SOCKET &&
+              header->cmsg_type == SCM_RIGHTS) {
+            const std::size_t count =
+                (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (std::size_t i = 0; i < count; i++) {
+              int handle;
+              std::memcpy(&handle, CMSG_DATA(header) + i * sizeof(int),
+                          sizeof(int));
+              handles_.push_back(handle);
+            }
+          }
+        }
+
+        if (message.msg_flags & MSG_CTRUNC)
+          return ErrorStatus::ProtocolError;
+        else if (ret == 0)
+          return ErrorStatus::ReadLimitReached;
+        else
+          return static_cast<std::size_t>(ret);
+      } else if (errno != EINTR) {
+        return ErrorStatus::IOError;
+      }
+    }
+  }
+
+  int fd_{-1};
+  std::unique_ptr<std::uint8_t[]> buffer_;
+  std::size_t buffer_size_{0};
+  std::size_t begin_{0};
+  std::size_t end_{0};
+  std::deque<int> handles_;
+  HandleReference handle_base_{0};
+
+  // Maps the reference of each cached handle's transfer to the handle.
+  std::unordered_map<HandleReference, int> cache_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_SOCKET_READER_H_
@@ -0,0 +1,318 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_SOCKET_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_SOCKET_WRITER_H_
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <nop/status.h>
+#include <nop/types/handle.h>
+#include <nop/types/shared_frame.h>
+
+namespace nop {
+
+// SocketWriter is a writer type that wraps around a UNIX domain stream socket
+// and supports serializing file handles, which are passed to the other end of
+// the socket as SCM_RIGHTS ancillary data. Use SocketReader to read the data
+// and handles at the other end.
+//
+// The encoded data and the handles pushed while encoding are buffered until
+// Flush() is called, which sends them together with a single call to
+// sendmsg(), or a few calls when there are many handles or the socket only
+// accepts part of the data. Handles are not duplicated when they are pushed:
+// they must remain open until the buffered data is flushed.
+//
+// Handle references are numbered sequentially across all of the messages sent
+// through the writer, which allows the reader to match references to received
+// handles without additional framing.
+//
+// Handles that are sent repeatedly may be registered with CacheHandle(). A
+// cached handle is transferred only the first time it is pushed; later pushes
+// encode a reference to the copy the reader keeps in its handle cache. Cached
+// handles must remain open until they are evicted with EvictHandle(), and the
+// application is responsible for telling the reader about evictions.
+//
+// SharedFrames are sent straight from their shared bytes rather than copied
+// into the buffer: writing a frame flushes the data buffered before it and
+// then sends the frame, so frames sent to many sockets are never copied.
+//
+// The writer takes ownership of the socket and automatically closes it when
+// destroyed, unless it is released. Buffered data is flushed first.
+//
+// Example:
+//
+//   nop::Serializer<nop::SocketWriter> serializer{socket_fd};
+//   serializer.Write(nop::FileHandle{memfd});
+//   serializer.writer().Flush();
+//
+class SocketWriter {
+ public:
+  // Values with handles are measured exactly before they are buffered.
+  using ExactPrepare = void;
+
+  // The maximum number of handles the kernel accepts in one call to sendmsg().
+  enum : std::size_t { kMaxHandlesPerMessage = 253 };
+
+  SocketWriter() = default;
+  SocketWriter(int fd) : fd_{fd} {}
+  SocketWriter(const SocketWriter&) = delete;
+  SocketWriter(SocketWriter&& other) { *this = std::move(other); }
+
+  ~SocketWriter() { Clear(); }
+
+  SocketWriter& operator=(const SocketWriter&) = delete;
+  SocketWriter& operator=(SocketWriter&& other) {
+    if (this != &other) {
+      Clear();
+      std::swap(fd_, other.fd_);
+      std::swap(buffer_, other.buffer_);
+      std::swap(handles_, other.handles_);
+      std::swap(handle_count_, other.handle_count_);
+      std::swap(cache_, other.cache_);
+    }
+    return *this;
+  }
+
+  // Flushes any buffered data and closes the socket.
+  void Clear() {
+    if (fd_ >= 0) {
+      Flush();
+      ::close(fd_);
+    }
+    fd_ = -1;
+    buffer_.clear();
+    handles_.clear();
+    cache_.clear();
+  }
+
+  // Flushes any buffered data and releases ownership of the socket.
+  int Release() {
+    Flush();
+    const int released_fd = fd_;
+    fd_ = -1;
+    return released_fd;
+  }
+
+  // Sends the buffered data and any handles pushed since the last flush.
+  Status<void> Flush() {
+    auto status = Send(buffer_.data(), buffer_.size(), handles_);
+    buffer_.clear();
+    handles_.clear();
+    return status;
+  }
+
+  Status<void> Prepare(std::size_t size) {
+    buffer_.reserve(buffer_.size() + size);
+    return {};
+  }
+
+  Status<void> Write(std::uint8_t byte) {
+    buffer_.push_back(byte);
+    return {};
+  }
+
+  Status<void> Write(const void* begin, const void* end) {
+    const std::uint8_t* begin_byte = static_cast<const std::uint8_t*>(begin);
+    const std::uint8_t* end_byte = static_cast<const std::uint8_t*>(end);
+    buffer_.insert(buffer_.end(), begin_byte, end_byte);
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    buffer_.insert(buffer_.end(), padding_bytes, padding_value);
+    return {};
+  }
+
+  Status<void> WriteFrame(const SharedFrame& frame) {
+    auto status = Flush();
+    if (!status)
+      return status;
+
+    return Send(frame.data(), frame.size(), {});
+  }
+
+  template <typename HandleType>
+  Status<HandleReference> PushHandle(const HandleType& handle) {
+    static_assert(std::is_same<typename HandleType::Type, int>::value,
+                  "SocketWriter only supports file descriptor handles.");
+
+    if (!handle)
+      return {kEmptyHandleReference};
+
+    auto search = cache_.find(handle.get());
+    if (search == cache_.end()) {
+      const HandleReference handle_reference = handle_count_++;
+      handles_.push_back(handle.get());
+      return {handle_reference};
+    }
+
+    // Cached handles are identified by the reference of their first transfer.
+    if (search->second == kEmptyHandleReference) {
+      search->second = handle_count_++;
+      handles_.push_back(handle.get());
+    }
+    return {kCachedHandleReference + search->second};
+  }
+
+  // Returns the reference PushHandle() would return for |handle| after
+  // |pending| more non-empty handles, without pushing it. This lets sizes be
+  // measured exactly; see CountingWriter.
+  template <typename HandleType>
+  HandleReference PeekHandleReference(const HandleType& handle,
+                                      std::size_t pending) const {
+    if (!handle)
+      return kEmptyHandleReference;
+
+    const HandleReference next_reference = handle_count_ + pending;
+    auto search = cache_.find(handle.get());
+    if (search == cache_.end())
+      return next_reference;
+    else if (search->second == kEmptyHandleReference)
+      return kCachedHandleReference + next_reference;
+    else
+      return kCachedHandleReference + search->second;
+  }
+
+  // Registers |handle| to be transferred only once. The handle is sent the
+  // first time it is pushed after this call.
+  template <typename HandleType>
+  Status<void> CacheHandle(const HandleType& handle) {
+    static_assert(std::is_same<typename HandleType::Type, int>::value,
+                  "SocketWriter only supports file descriptor handles.");
+
+    if (!handle)
+      return ErrorStatus::InvalidHandleValue;
+
+    cache_.emplace(handle.get(), kEmptyHandleReference);
+    return {};
+  }
+
+  // Removes |handle| from the cache and returns the reference the reader uses
+  // for it, to be passed to SocketReader::EvictHandle(), or
+  // kEmptyHandleReference when the handle was never sent. After this call the
+  // handle may be closed once buffered data is flushed.
+  template <typename HandleType>
+  Status<HandleReference> EvictHandle(const HandleType& handle) {
+    static_assert(std::is_same<typename HandleType::Type, int>::value,
+                  "SocketWriter only supports file descriptor handles.");
+
+    auto search = cache_.find(handle.get());
+    if (search == cache_.end())
+      return ErrorStatus::InvalidHandleValue;
+
+    const HandleReference handle_reference =
+        search->second == kEmptyHandleReference
+            ? kEmptyHandleReference
+            : kCachedHandleReference + search->second;
+    cache_.erase(search);
+    return {handle_reference};
+  }
+
+  // Returns the number of bytes written that have not been flushed.
+  std::size_t buffered() const { return buffer_.size(); }
+
+  // Returns the number of handles pushed that have not been flushed.
+  std::size_t buffered_handles() const { return handles_.size(); }
+
+  // Returns the number of handles registered with CacheHandle().
+  std::size_t cached_handles() const { return cache_.size(); }
+
+ private:
+  // Sends the |size| bytes at |data| with |handles| attached, handling partial
+  // writes. Each call to sendmsg() carries at most kMaxHandlesPerMessage
+  // handles; when more handles remain after a batch only one byte is sent with
+  // the batch, so that there is data left to carry the remaining handles.
+  // Every encoded handle reference takes more than one byte, so there is
+  // always enough data.
+  Status<void> Send(const std::uint8_t* data, std::size_t size,
+                    const std::vector<int>& handles) {
+    union {
+      cmsghdr header;
+      char buffer[CMSG_SPACE(sizeof(int) * kMaxHandlesPerMessage)];
+    } control;
+
+    std::size_t offset = 0;
+    std::size_t handle_offset = 0;
+    while (offset < size) {
+      const std::size_t handle_count =
+          std::min<std::size_t>(handles.size() - handle_offset,
+                                kMaxHandlesPerMessage);
+      const bool more_handles =
+          handle_offset + handle_count < handles.size();
+
+      iovec vec = {const_cast<std::uint8_t*>(data + offset),
+                   more_handles ? 1 : size - offset};
+      msghdr message = {};
+      message.msg_iov = &vec;
+      message.msg_iovlen = 1;
+
+      if (handle_count > 0) {
+        const std::size_t handles_size = sizeof(int) * handle_count;
+        message.msg_control = control.buffer;
+        message.msg_controllen = CMSG_SPACE(handles_size);
+
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(handles_size);
+        std::memcpy(CMSG_DATA(header), &handles[handle_offset], handles_size);
+      }
+
+      const ssize_t ret = ::sendmsg(fd_, &message, MSG_NOSIGNAL);
+      if (ret > 0) {
+        offset += static_cast<std::size_t>(ret);
+        handle_offset += handle_count;
+      } else if (ret == 0) {
+        return ErrorStatus::WriteLimitReached;
+      } else if (errno != EINTR) {
+        return ErrorStatus::IOError;
+      }
+    }
+
+    if (handle_offset < handles.size())
+      return ErrorStatus::ProtocolError;
+    else
+      return {};
+  }
+
+  int fd_{-1};
+  std::vector<std::uint8_t> buffer_;
+  std::vector<int> handles_;
+  HandleReference handle_count_{0};
+
+  // Maps cached handles to the reference of their first transfer, or to
+  // kEmptyHandleReference until they are sent.
+  std::unordered_map<int, HandleReference> cache_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_SOCKET_WRITER_H_
@@ -0,0 +1,550 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_SPSC_RING_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_SPSC_RING_H_
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include <nop/base/utility.h>
+#include <nop/status.h>
+
+namespace nop {
+
+//
+// Single-producer single-consumer ring buffer in shared memory.
+//
+// SpscRing maps a ring buffer that one SpscRingWriter and one SpscRingReader,
+// usually in different processes, use as a transport for Serializer and
+// Deserializer without copying through the kernel. The writer serializes
+// directly into the ring: each Prepare() from the serializer reserves a
+// contiguous record large enough for the value about to be written, skipping
+// to the start of the ring when the record would not fit before the end, and
+// the record is published to the reader as soon as it is filled.
+//
+// Both sides spin briefly when the ring is empty or full and then sleep on a
+// futex in the shared mapping. Wakeups are only issued when the peer has
+// announced that it is sleeping, so a busy transport makes no system calls.
+//
+// Example:
+//
+//   // Producer:
+//   nop::SpscRing ring;
+//   auto status = ring.Create(1 << 20);
+//   SendFdToConsumer(ring.fd());
+//   nop::Serializer<nop::SpscRingWriter> serializer{&ring};
+//   status = serializer.Write(quote);
+//
+//   // Consumer:
+//   nop::SpscRing ring;
+//   auto status = ring.Open(ReceiveFdFromProducer());
+//   nop::Deserializer<nop::SpscRingReader> deserializer{&ring};
+//   status = deserializer.Read(&quote);
+//
+class SpscRing {
+ public:
+  SpscRing() = default;
+  SpscRing(const SpscRing&) = delete;
+  SpscRing(SpscRing&& other) { *this = std::move(other); }
+
+  ~SpscRing() { Clear(); }
+
+  SpscRing& operator=(const SpscRing&) = delete;
+  SpscRing& operator=(SpscRing&& other) {
+    if (this != &other) {
+      Clear();
+      std::swap(fd_, other.fd_);
+      std::swap(header_, other.header_);
+      std::swap(mapping_size_, other.mapping_size_);
+    }
+    return *this;
+  }
+
+  // Creates a new ring with room for at least |capacity| bytes, rounded up to
+  // a power of two, in an anonymous shared memory file.
+  Status<void> Create(std::size_t capacity) {
+    Clear();
+    std::size_t rounded = kMinimumCapacity;
+    while (rounded < capacity)
+      rounded <<= 1;
+
+    const int fd = static_cast<int>(::syscall(SYS_memfd_create, "nop-ring", 0));
+    if (fd < 0)
+      return ErrorStatus::IOError;
+    if (::ftruncate(fd, static_cast<off_t>(sizeof(Header) + rounded)) < 0) {
+      ::close(fd);
+      return ErrorStatus::IOError;
+    }
+
+    auto status = Map(fd, sizeof(Header) + rounded);
+    if (!status)
+      return status;
+
+    new (header_) Header{};
+    header_->capacity = rounded;
+    header_->magic.store(kMagic, std::memory_order_release);
+    return {};
+  }
+
+  // Takes ownership of |fd|, the file of a ring created by Create() in this or
+  // another process, and maps it.
+  Status<void> Open(int fd) {
+    Clear();
+    if (fd < 0)
+      return ErrorStatus::IOError;
+
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) < 0 ||
+        static_cast<std::size_t>(file_stat.st_size) < sizeof(Header)) {
+      ::close(fd);
+      return ErrorStatus::IOError;
+    }
+
+    const std::size_t size = static_cast<std::size_t>(file_stat.st_size);
+    auto status = Map(fd, size);
+    if (!status)
+      return status;
+
+    if (header_->magic.load(std::memory_order_acquire) != kMagic ||
+        header_->capacity != size - sizeof(Header) ||
+        (header_->capacity & (header_->capacity - 1)) != 0) {
+      Clear();
+      return ErrorStatus::ProtocolError;
+    }
+    return {};
+  }
+
+  // Marks the ring closed and wakes both sides. Readers fail with
+  // ErrorStatus::ReadLimitReached once the data written before closing is
+  // consumed and writers fail with ErrorStatus::WriteLimitReached.
+  void Close() {
+    if (header_ == nullptr)
+      return;
+
+    header_->closed.store(1, std::memory_order_seq_cst);
+    Wake(&header_->reader_event);
+    Wake(&header_->writer_event);
+  }
+
+  // Unmaps the ring and closes its fd.
+  void Clear() {
+    if (header_ != nullptr)
+      ::munmap(header_, mapping_size_);
+    if (fd_ >= 0)
+      ::close(fd_);
+    header_ = nullptr;
+    mapping_size_ = 0;
+    fd_ = -1;
+  }
+
+  bool is_open() const { return header_ != nullptr; }
+  bool is_closed() const {
+    return header_->closed.load(std::memory_order_acquire) != 0;
+  }
+
+  // Returns the file of the ring, for passing to the peer process.
+  int fd() const { return fd_; }
+
+  std::size_t capacity() const { return header_ ? header_->capacity : 0; }
+
+  // Returns the largest record the writer reserves, which bounds the size of
+  // each contiguous reservation. Larger values are split across records.
+  std::size_t max_record() const { return capacity() / 2 - kRecordHeaderSize; }
+
+ private:
+  friend class SpscRingWriter;
+  friend class SpscRingReader;
+
+  enum : std::uint32_t { kMagic = 0x4e4f5052 };
+  enum : std::size_t { kMinimumCapacity = 64, kRecordHeaderSize = 4 };
+
+  // Record length marking the rest of the ring up to the end as padding.
+  enum : std::uint32_t { kPadding = 0xffffffff };
+
+  // The number of times each side polls before sleeping.
+  enum : int { kSpinCount = 4096 };
+
+  // Shared state at the start of the mapping. The writer and reader positions
+  // count bytes since the ring was created and are on separate cache lines.
+  struct Header {
+    std::atomic<std::uint32_t> magic{0};
+    std::atomic<std::uint32_t> closed{0};
+    std::uint64_t capacity{0};
+
+    alignas(64) std::atomic<std::uint64_t> head{0};
+    std::atomic<std::uint32_t> reader_waiting{0};
+    std::atomic<std::uint32_t> reader_event{0};
+
+    alignas(64) std::atomic<std::uint64_t> tail{0};
+    std::atomic<std::uint32_t> writer_waiting{0};
+    std::atomic<std::uint32_t> writer_event{0};
+  };
+
+  Status<void> Map(int fd, std::size_t size) {
+    void* address =
+        ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+      ::close(fd);
+      return ErrorStatus::IOError;
+    }
+
+    fd_ = fd;
+    header_ = static_cast<Header*>(address);
+    mapping_size_ = size;
+    return {};
+  }
+
+  std::uint8_t* data() const {
+    return reinterpret_cast<std::uint8_t*>(header_ + 1);
+  }
+
+  // Spins and then sleeps until |ready| returns true or the ring is closed.
+  // The sleeping side sets |waiting| before checking |ready| a final time, and
+  // the other side wakes it through |event| after making progress. Both sides
+  // use sequentially consistent accesses so that one of them always sees the
+  // other.
+  template <typename Ready>
+  bool Wait(std::atomic<std::uint32_t>* waiting,
+            std::atomic<std::uint32_t>* event, Ready ready) {
+    for (int i = 0; i < kSpinCount; i++) {
+      if (ready())
+        return true;
+      if (is_closed())
+        return ready();
+    }
+
+    while (true) {
+      const std::uint32_t observed = event->load(std::memory_order_seq_cst);
+      waiting->store(1, std::memory_order_seq_cst);
+      if (ready() || is_closed()) {
+        waiting->store(0, std::memory_order_relaxed);
+        return ready();
+      }
+
+      ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(event), FUTEX_WAIT,
+                observed, nullptr, nullptr, 0);
+      waiting->store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Wakes the peer sleeping on |event| if it announced so through |waiting|.
+  static void Notify(std::atomic<std::uint32_t>* waiting,
+                     std::atomic<std::uint32_t>* event) {
+    if (waiting->load(std::memory_order_seq_cst) != 0)
+      Wake(event);
+  }
+
+  static void Wake(std::atomic<std::uint32_t>* event) {
+    event->fetch_add(1, std::memory_order_seq_cst);
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(event), FUTEX_WAKE,
+              1, nullptr, nullptr, 0);
+  }
+
+  int fd_{-1};
+  Header* header_{nullptr};
+  std::size_t mapping_size_{0};
+};
+
+// Writer type that serializes into an SpscRing. Only one writer may use a ring
+// at a time.
+class SpscRingWriter {
+ public:
+  SpscRingWriter() = default;
+  explicit SpscRingWriter(SpscRing* ring)
+      : ring_{ring}, head_{ring->header_->head.load()} {}
+
+  SpscRingWriter(const SpscRingWriter&) = delete;
+  void operator=(const SpscRingWriter&) = delete;
+
+  ~SpscRingWriter() { Flush(); }
+
+  // Reserves a contiguous record for the next |size| bytes, publishing the
+  // record in progress, if any. Sizes larger than SpscRing::max_record() are
+  // split across several records as they are written.
+  Status<void> Prepare(std::size_t size) {
+    if (size <= reserved_)
+      return {};
+
+    Flush();
+    return ReserveRecord(size);
+  }
+
+  Status<void> Write(std::uint8_t byte) { return Write(&byte, &byte + 1); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    const auto* bytes = reinterpret_cast<const std::uint8_t*>(begin);
+    std::size_t length_bytes = (end - begin) * sizeof(T);
+    while (length_bytes != 0) {
+      if (reserved_ == 0) {
+        auto status = ReserveRecord(length_bytes);
+        if (!status)
+          return status;
+      }
+
+      const std::size_t chunk = std::min(length_bytes, reserved_);
+      std::memcpy(cursor_, bytes, chunk);
+      Advance(chunk);
+      bytes += chunk;
+      length_bytes -= chunk;
+    }
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    while (padding_bytes != 0) {
+      if (reserved_ == 0) {
+        auto status = ReserveRecord(padding_bytes);
+        if (!status)
+          return status;
+      }
+
+      const std::size_t chunk = std::min(padding_bytes, reserved_);
+      std::memset(cursor_, padding_value, chunk);
+      Advance(chunk);
+      padding_bytes -= chunk;
+    }
+    return {};
+  }
+
+  // Returns a pointer to the next |size| bytes of the record in progress for
+  // encodings to store values into directly, failing if the record reserved by
+  // Prepare() does not have room for them. See IsReservingWriter.
+  Status<std::uint8_t*> Reserve(std::size_t size) {
+    if (size > reserved_)
+      return ErrorStatus::WriteLimitReached;
+    else
+      return cursor_;
+  }
+
+  void Commit(std::size_t size) { Advance(size); }
+
+  // Publishes the partially written record, if any. Records are published
+  // automatically when the size passed to Prepare() has been written.
+  void Flush() {
+    if (ring_ == nullptr || used_ == 0) {
+      reserved_ = 0;
+      return;
+    }
+
+    const auto length = static_cast<std::uint32_t>(used_);
+    std::memcpy(ring_->data() + record_, &length, sizeof(length));
+    head_ = start_ + SpscRing::kRecordHeaderSize + used_;
+    reserved_ = 0;
+    used_ = 0;
+
+    auto* header = ring_->header_;
+    header->head.store(head_, std::memory_order_seq_cst);
+    SpscRing::Notify(&header->reader_waiting, &header->reader_event);
+  }
+
+  const SpscRing* ring() const { return ring_; }
+
+ private:
+  // Waits for room for a record of up to |size| bytes after the published
+  // head, writing a padding marker first if the record does not fit before the
+  // end of the ring.
+  Status<void> ReserveRecord(std::size_t size) {
+    if (ring_ == nullptr)
+      return ErrorStatus::WriteLimitReached;
+
+    auto* header = ring_->header_;
+    const std::size_t capacity = header->capacity;
+    const std::size_t length = std::min(size, ring_->max_record());
+    const std::size_t record_size = SpscRing::kRecordHeaderSize + length;
+
+    const std::size_t offset = head_ & (capacity - 1);
+    const std::size_t padding =
+        capacity - offset < record_size ? capacity - offset : 0;
+
+    const bool ready = ring_->Wait(
+        &header->writer_waiting, &header->writer_event, [&] {
+          const std::uint64_t tail =
+              header->tail.load(std::memory_order_seq_cst);
+          return capacity - (head_ - tail) >= padding + record_size;
+        });
+    if (!ready || ring_->is_closed())
+      return ErrorStatus::WriteLimitReached;
+
+    if (padding >= SpscRing::kRecordHeaderSize) {
+      const std::uint32_t marker = SpscRing::kPadding;
+      std::memcpy(ring_->data() + offset, &marker, sizeof(marker));
+    }
+
+    start_ = head_ + padding;
+    record_ = static_cast<std::size_t>(start_ & (capacity - 1));
+    cursor_ = ring_->data() + record_ + SpscRing::kRecordHeaderSize;
+    reserved_ = length;
+    used_ = 0;
+    return {};
+  }
+
+  void Advance(std::size_t bytes) {
+    cursor_ += bytes;
+    used_ += bytes;
+    reserved_ -= bytes;
+    if (reserved_ == 0)
+      Flush();
+  }
+
+  SpscRing* ring_{nullptr};
+
+  // The published head and the position and offset of the record in progress.
+  std::uint64_t head_{0};
+  std::uint64_t start_{0};
+  std::size_t record_{0};
+
+  std::uint8_t* cursor_{nullptr};
+  std::size_t reserved_{0};
+  std::size_t used_{0};
+};
+
+// Reader type that deserializes from an SpscRing, blocking until the writer
+// publishes enough data. Only one reader may use a ring at a time.
+class SpscRingReader {
+ public:
+  SpscRingReader() = default;
+  explicit SpscRingReader(SpscRing* ring)
+      : ring_{ring}, tail_{ring->header_->tail.load()} {}
+
+  SpscRingReader(const SpscRingReader&) = delete;
+  void operator=(const SpscRingReader&) = delete;
+
+  // Data arrives as it is published, so there is nothing to check ahead of
+  // time.
+  Status<void> Ensure(std::size_t /*size*/) { return {}; }
+
+  Status<void> Read(std::uint8_t* byte) { return Read(byte, byte + 1); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Read(T* begin, T* end) {
+    auto* bytes = reinterpret_cast<std::uint8_t*>(begin);
+    std::size_t length_bytes = (end - begin) * sizeof(T);
+    while (length_bytes != 0) {
+      if (remaining_ == 0) {
+        auto status = NextRecord();
+        if (!status)
+          return status;
+      }
+
+      const std::size_t chunk = std::min(length_bytes, remaining_);
+      std::memcpy(bytes, cursor_, chunk);
+      Consume(chunk);
+      bytes += chunk;
+      length_bytes -= chunk;
+    }
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    while (padding_bytes != 0) {
+      if (remaining_ == 0) {
+        auto status = NextRecord();
+        if (!status)
+          return status;
+      }
+
+      const std::size_t chunk = std::min(padding_bytes, remaining_);
+      Consume(chunk);
+      padding_bytes -= chunk;
+    }
+    return {};
+  }
+
+  // Returns true if all of the published data has been read.
+  bool empty() const {
+    return remaining_ == 0 &&
+           ring_->header_->head.load(std::memory_order_acquire) == tail_;
+  }
+
+ private:
+  // Waits for the next record, skipping padding at the end of the ring.
+  Status<void> NextRecord() {
+    if (ring_ == nullptr)
+      return ErrorStatus::ReadLimitReached;
+
+    auto* header = ring_->header_;
+    const std::size_t capacity = header->capacity;
+    while (true) {
+      const bool ready =
+          ring_->Wait(&header->reader_waiting, &header->reader_event, [&] {
+            return header->head.load(std::memory_order_seq_cst) != tail_;
+          });
+      if (!ready)
+        return ErrorStatus::ReadLimitReached;
+
+      const std::size_t offset = tail_ & (capacity - 1);
+      std::uint32_t length = SpscRing::kPadding;
+      if (capacity - offset >= SpscRing::kRecordHeaderSize)
+        std::memcpy(&length, ring_->data() + offset, sizeof(length));
+
+      if (length == SpscRing::kPadding) {
+        tail_ += capacity - offset;
+        Publish();
+        continue;
+      }
+
+      // Records never wrap, so a length that runs past the end of the ring
+      // can only come from a corrupt or hostile writer.
+      if (length > capacity - offset - SpscRing::kRecordHeaderSize)
+        return ErrorStatus::ProtocolError;
+
+      cursor_ = ring_->data() + offset + SpscRing::kRecordHeaderSize;
+      remaining_ = length;
+      record_end_ = tail_ + SpscRing::kRecordHeaderSize + length;
+      return {};
+    }
+  }
+
+  void Consume(std::size_t bytes) {
+    cursor_ += bytes;
+    remaining_ -= bytes;
+    if (remaining_ == 0) {
+      tail_ = record_end_;
+      Publish();
+    }
+  }
+
+  // Returns the space up to the current position to the writer.
+  void Publish() {
+    auto* header = ring_->header_;
+    header->tail.store(tail_, std::memory_order_seq_cst);
+    SpscRing::Notify(&header->writer_waiting, &header->writer_event);
+  }
+
+  SpscRing* ring_{nullptr};
+  std::uint64_t tail_{0};
+  std::uint64_t record_end_{0};
+  const std::uint8_t* cursor_{nullptr};
+  std::size_t remaining_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_SPSC_RING_H_
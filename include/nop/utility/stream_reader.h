@@ -17,8 +17,13 @@
 #ifndef LIBNOP_INLCUDE_NOP_UTILITY_STREAM_READER_H_
 #define LIBNOP_INLCUDE_NOP_UTILITY_STREAM_READER_H_
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <ios>
 #include <istream>
+#include <iterator>
+#include <utility>
 
 #include <nop/status.h>
 
@@ -28,6 +33,10 @@ namespace nop {
 // Reader template type that wraps STL input streams.
 //
 // Implements the basic reader interface on top of an STL input stream type.
+// Reads come straight from the stream buffer with sbumpc() and sgetn(), which
+// copy from the get area inline, bypassing the sentry and state checks of the
+// formatted stream interface. Running out of input is detected from the
+// results of the stream buffer operations and reflected in the stream state.
 //
 
 template <typename IStream>
@@ -41,26 +50,66 @@ class StreamReader {
   Status<void> Ensure(std::size_t /*size*/) { return {}; }
 
   Status<void> Read(std::uint8_t* byte) {
-    using CharType = typename IStream::char_type;
-    stream_.read(reinterpret_cast<CharType*>(byte), sizeof(std::uint8_t));
+    auto* buffer = stream_.rdbuf();
+    if (buffer == nullptr)
+      return Fail();
 
-    return ReturnStatus();
+    const auto value = buffer->sbumpc();
+    if (TraitsType::eq_int_type(value, TraitsType::eof()))
+      return Fail();
+
+    *byte = static_cast<std::uint8_t>(TraitsType::to_char_type(value));
+    return {};
   }
 
   Status<void> Read(void* begin, void* end) {
-    using CharType = typename IStream::char_type;
     CharType* begin_char = static_cast<CharType*>(begin);
     CharType* end_char = static_cast<CharType*>(end);
-
-    const std::size_t length_bytes = std::distance(begin_char, end_char);
-    stream_.read(begin_char, length_bytes);
-
-    return ReturnStatus();
+    return ReadChars(begin_char, std::distance(begin_char, end_char));
   }
 
   Status<void> Skip(std::size_t padding_bytes) {
-    stream_.seekg(padding_bytes, std::ios_base::cur);
-    return ReturnStatus();
+    auto* buffer = stream_.rdbuf();
+    if (buffer == nullptr)
+      return Fail();
+
+    // Seek over the padding when the input is seekable and long enough, and
+    // read it otherwise.
+    using OffsetType = typename TraitsType::off_type;
+    const auto position = buffer->pubseekoff(0, std::ios_base::cur,
+                                             std::ios_base::in);
+    if (position != PositionType(OffsetType(-1))) {
+      const auto end = buffer->pubseekoff(0, std::ios_base::end,
+                                          std::ios_base::in);
+      buffer->pubseekpos(position, std::ios_base::in);
+      if (end != PositionType(OffsetType(-1)) &&
+          static_cast<std::size_t>(end - position) >= padding_bytes) {
+        buffer->pubseekoff(static_cast<OffsetType>(padding_bytes),
+                           std::ios_base::cur, std::ios_base::in);
+        return {};
+      }
+    }
+
+    enum : std::size_t { kPaddingSize = 64 };
+    CharType padding[kPaddingSize];
+    while (padding_bytes > 0) {
+      const std::size_t count =
+          std::min<std::size_t>(padding_bytes, kPaddingSize);
+      auto status = ReadChars(padding, count);
+      if (!status)
+        return status;
+
+      padding_bytes -= count;
+    }
+    return {};
+  }
+
+  // Returns true if the stream has no more input. This may wait for input on
+  // streams over pipes or sockets.
+  bool empty() const {
+    auto* buffer = stream_.rdbuf();
+    return buffer == nullptr ||
+           TraitsType::eq_int_type(buffer->sgetc(), TraitsType::eof());
   }
 
   const IStream& stream() const { return stream_; }
@@ -68,11 +117,24 @@ class StreamReader {
   IStream&& take() { return std::move(stream_); }
 
  private:
-  Status<void> ReturnStatus() {
-    if (stream_.bad() || stream_.eof())
-      return ErrorStatus::StreamError;
-    else
-      return {};
+  using CharType = typename IStream::char_type;
+  using TraitsType = typename IStream::traits_type;
+  using PositionType = typename TraitsType::pos_type;
+
+  Status<void> ReadChars(CharType* data, std::size_t count) {
+    auto* buffer = stream_.rdbuf();
+    if (buffer == nullptr ||
+        buffer->sgetn(data, static_cast<std::streamsize>(count)) !=
+            static_cast<std::streamsize>(count)) {
+      return Fail();
+    }
+    return {};
+  }
+
+  // Marks the stream as having run out of input, like a failed read().
+  Status<void> Fail() {
+    stream_.setstate(std::ios_base::eofbit | std::ios_base::failbit);
+    return ErrorStatus::StreamError;
   }
 
   IStream stream_;
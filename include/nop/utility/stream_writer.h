@@ -17,8 +17,13 @@
 #ifndef LIBNOP_INLCUDE_NOP_UTILITY_STREAM_WRITER_H_
 #define LIBNOP_INLCUDE_NOP_UTILITY_STREAM_WRITER_H_
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <ios>
+#include <iterator>
 #include <ostream>
+#include <utility>
 
 #include <nop/status.h>
 
@@ -28,11 +33,19 @@ namespace nop {
 // Writer template type that wraps STL output streams.
 //
 // Implements the basic writer interface on top of an STL output stream type.
+// Writes go straight to the stream buffer with sputc() and sputn(), which copy
+// into the put area inline, bypassing the sentry and state checks of the
+// formatted stream interface. Errors are detected from the results of the
+// stream buffer operations and reflected in the stream state.
 //
 
 template <typename OStream>
 class StreamWriter {
  public:
+  // Writes go directly to the output, so there is no need to compute the size
+  // of each value ahead of time.
+  using SkipPrepare = void;
+
   template <typename... Args>
   StreamWriter(Args&&... args) : stream_{std::forward<Args>(args)...} {}
   StreamWriter(const StreamWriter&) = default;
@@ -41,28 +54,36 @@ class StreamWriter {
   Status<void> Prepare(std::size_t /*size*/) { return {}; }
 
   Status<void> Write(std::uint8_t byte) {
-    stream_.put(static_cast<typename OStream::char_type>(byte));
-    return ReturnStatus();
+    auto* buffer = stream_.rdbuf();
+    if (buffer == nullptr ||
+        TraitsType::eq_int_type(buffer->sputc(static_cast<CharType>(byte)),
+                                TraitsType::eof())) {
+      return Fail();
+    }
+    return {};
   }
 
   Status<void> Write(const void* begin, const void* end) {
-    using CharType = typename OStream::char_type;
     const CharType* begin_char = static_cast<const CharType*>(begin);
     const CharType* end_char = static_cast<const CharType*>(end);
-
-    const std::size_t length_bytes = std::distance(begin_char, end_char);
-    stream_.write(begin_char, length_bytes);
-
-    return ReturnStatus();
+    return WriteChars(begin_char, std::distance(begin_char, end_char));
   }
 
   Status<void> Skip(std::size_t padding_bytes,
                     std::uint8_t padding_value = 0x00) {
-    for (std::size_t i = 0; i < padding_bytes; i++) {
-      stream_.put(padding_value);
-      auto status = ReturnStatus();
+    enum : std::size_t { kPaddingSize = 64 };
+    CharType padding[kPaddingSize];
+    std::fill(padding, padding + kPaddingSize,
+              static_cast<CharType>(padding_value));
+
+    while (padding_bytes > 0) {
+      const std::size_t count =
+          std::min<std::size_t>(padding_bytes, kPaddingSize);
+      auto status = WriteChars(padding, count);
       if (!status)
         return status;
+
+      padding_bytes -= count;
     }
 
     return {};
@@ -73,11 +94,22 @@ class StreamWriter {
   OStream&& take() { return std::move(stream_); }
 
  private:
-  Status<void> ReturnStatus() {
-    if (stream_.bad() || stream_.eof())
-      return ErrorStatus::StreamError;
-    else
-      return {};
+  using CharType = typename OStream::char_type;
+  using TraitsType = typename OStream::traits_type;
+
+  Status<void> WriteChars(const CharType* data, std::size_t count) {
+    auto* buffer = stream_.rdbuf();
+    if (buffer == nullptr ||
+        buffer->sputn(data, static_cast<std::streamsize>(count)) !=
+            static_cast<std::streamsize>(count)) {
+      return Fail();
+    }
+    return {};
+  }
+
+  Status<void> Fail() {
+    stream_.setstate(std::ios_base::badbit);
+    return ErrorStatus::StreamError;
   }
 
   OStream stream_;
@@ -0,0 +1,317 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_TCP_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_TCP_WRITER_H_
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>  // Declares struct timespec for linux/errqueue.h.
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <nop/status.h>
+#include <nop/utility/iovec_writer.h>
+
+namespace nop {
+
+// TcpWriter is a writer type for TCP sockets that sends each message with as
+// little copying as possible. Messages are collected with an IovecWriter, so
+// large payloads are referenced in place, and Flush() sends the message with
+// the socket corked, so that the kernel only emits full segments until the
+// whole message is queued.
+//
+// Referenced payloads at least |zero_copy_threshold| bytes long are sent with
+// MSG_ZEROCOPY, which pins the pages instead of copying them into the socket
+// buffer. The kernel reports when it is done with each zero-copy send through
+// the socket error queue: payloads must not be modified or freed until
+// pending_zero_copy() drops to zero, for example by calling
+// WaitForCompletions(). Sockets that do not support zero-copy sends fall back
+// to ordinary sends.
+//
+// The writer takes ownership of the socket and automatically closes it when
+// destroyed, unless it is released. Buffered data is flushed first.
+//
+// Example:
+//
+//   nop::Serializer<nop::TcpWriter> serializer{socket_fd};
+//   serializer.Write(response);
+//   serializer.writer().Flush();
+//   serializer.writer().WaitForCompletions();  // Before reusing |response|.
+//
+class TcpWriter {
+ public:
+  enum : std::size_t { kDefaultZeroCopyThreshold = 64 * 1024 };
+
+  // Writes are collected by the IovecWriter, which grows on demand.
+  using SkipPrepare = void;
+
+  TcpWriter() = default;
+  explicit TcpWriter(
+      int fd, std::size_t zero_copy_threshold = kDefaultZeroCopyThreshold,
+      bool cork = true)
+      : fd_{fd},
+        iovec_writer_{std::min<std::size_t>(zero_copy_threshold,
+                                            IovecWriter::kDefaultThreshold)},
+        zero_copy_threshold_{zero_copy_threshold},
+        cork_{cork} {
+    const int enable = 1;
+    zero_copy_ = fd_ >= 0 && ::setsockopt(fd_, SOL_SOCKET, SO_ZEROCOPY,
+                                          &enable, sizeof(enable)) == 0;
+  }
+
+  TcpWriter(const TcpWriter&) = delete;
+  TcpWriter(TcpWriter&& other) { *this = std::move(other); }
+
+  ~TcpWriter() { Clear(); }
+
+  TcpWriter& operator=(const TcpWriter&) = delete;
+  TcpWriter& operator=(TcpWriter&& other) {
+    if (this != &other) {
+      Clear();
+      std::swap(fd_, other.fd_);
+      std::swap(iovec_writer_, other.iovec_writer_);
+      std::swap(zero_copy_threshold_, other.zero_copy_threshold_);
+      std::swap(cork_, other.cork_);
+      std::swap(zero_copy_, other.zero_copy_);
+      std::swap(zero_copy_sent_, other.zero_copy_sent_);
+      std::swap(zero_copy_completed_, other.zero_copy_completed_);
+      std::swap(zero_copy_copied_, other.zero_copy_copied_);
+    }
+    return *this;
+  }
+
+  // Flushes any buffered data, waits for outstanding zero-copy sends, and
+  // closes the socket.
+  void Clear() {
+    if (fd_ >= 0) {
+      Flush();
+      WaitForCompletions();
+      ::close(fd_);
+    }
+    fd_ = -1;
+    iovec_writer_.clear();
+  }
+
+  // Flushes any buffered data and releases ownership of the socket.
+  int Release() {
+    Flush();
+    const int released_fd = fd_;
+    fd_ = -1;
+    return released_fd;
+  }
+
+  Status<void> Prepare(std::size_t /*size*/) { return {}; }
+
+  Status<void> Write(std::uint8_t byte) { return iovec_writer_.Write(byte); }
+
+  Status<void> Write(const void* begin, const void* end) {
+    return iovec_writer_.Write(begin, end);
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    return iovec_writer_.Skip(padding_bytes, padding_value);
+  }
+
+  // Sends the message written since the last flush with the socket corked,
+  // sending large referenced payloads with MSG_ZEROCOPY when supported.
+  Status<void> Flush() {
+    if (iovec_writer_.size() == 0)
+      return {};
+
+    const std::vector<iovec>& list = iovec_writer_.iovecs();
+    vec_.assign(list.begin(), list.end());
+
+    SetCork(true);
+    auto status = Send();
+    SetCork(false);
+
+    iovec_writer_.clear();
+    if (status)
+      ReapCompletions();
+    return status;
+  }
+
+  // Reads the zero-copy completions reported so far without blocking.
+  Status<void> ReapCompletions() {
+    while (pending_zero_copy() != 0) {
+      char control[CMSG_SPACE(sizeof(sock_extended_err)) +
+                   CMSG_SPACE(sizeof(sockaddr_in6))];
+      msghdr message = {};
+      message.msg_control = control;
+      message.msg_controllen = sizeof(control);
+
+      const ssize_t ret =
+          ::recvmsg(fd_, &message, MSG_ERRQUEUE | MSG_DONTWAIT);
+      if (ret < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          return {};
+        else if (errno != EINTR)
+          return ErrorStatus::IOError;
+        continue;
+      }
+
+      for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr;
+           header = CMSG_NXTHDR(&message, header)) {
+        const bool error = (header->cmsg_level == SOL_IP &&
+                            header->cmsg_type == IP_RECVERR) ||
+                           (header->cmsg_level == SOL_IPV6 &&
+                            header->cmsg_type == IPV6_RECVERR);
+        if (!error)
+          continue;
+
+        const auto* extended =
+            reinterpret_cast<const sock_extended_err*>(CMSG_DATA(header));
+        if (extended->ee_errno != 0 ||
+            extended->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+          continue;
+        }
+
+        // Each notification covers a range of send calls.
+        const std::uint64_t count =
+            std::uint64_t{extended->ee_data} - extended->ee_info + 1;
+        zero_copy_completed_ += count;
+        if (extended->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+          zero_copy_copied_ += count;
+      }
+    }
+    return {};
+  }
+
+  // Waits up to |timeout_ms| milliseconds, or indefinitely when negative, for
+  // every zero-copy send to complete.
+  Status<void> WaitForCompletions(int timeout_ms = -1) {
+    while (true) {
+      auto status = ReapCompletions();
+      if (!status || pending_zero_copy() == 0)
+        return status;
+
+      // Notifications raise POLLERR, which is always reported.
+      pollfd poll_fd = {fd_, 0, 0};
+      const int ret = ::poll(&poll_fd, 1, timeout_ms);
+      if (ret == 0)
+        return ErrorStatus::IOError;
+      else if (ret < 0 && errno != EINTR)
+        return ErrorStatus::IOError;
+    }
+  }
+
+  // Returns true if the socket accepted the zero-copy option.
+  bool zero_copy_enabled() const { return zero_copy_; }
+
+  // Returns the number of zero-copy sends whose payloads the kernel may still
+  // be reading.
+  std::uint64_t pending_zero_copy() const {
+    return zero_copy_sent_ - zero_copy_completed_;
+  }
+
+  // Returns the number of zero-copy sends, and how many of them the kernel
+  // completed by copying after all, as it does on loopback.
+  std::uint64_t zero_copy_sends() const { return zero_copy_sent_; }
+  std::uint64_t zero_copy_copied() const { return zero_copy_copied_; }
+
+  // Returns the number of bytes written that have not been flushed.
+  std::size_t buffered() const { return iovec_writer_.size(); }
+
+  std::size_t zero_copy_threshold() const { return zero_copy_threshold_; }
+  int fd() const { return fd_; }
+
+ private:
+  void SetCork(bool enable) {
+    if (cork_ && vec_.size() > 1) {
+      const int value = enable ? 1 : 0;
+      ::setsockopt(fd_, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+    }
+  }
+
+  // Returns true if the entry at |index| is sent with MSG_ZEROCOPY.
+  bool IsZeroCopy(std::size_t index) const {
+    return zero_copy_ && iovec_writer_.references(index) &&
+           vec_[index].iov_len >= zero_copy_threshold_;
+  }
+
+  // Sends the entries of |vec_|, each zero-copy entry with a call of its own
+  // and runs of the others together, handling partial writes.
+  Status<void> Send() {
+    std::size_t index = 0;
+    while (index < vec_.size()) {
+      const bool zero_copy = IsZeroCopy(index);
+      std::size_t end = index + 1;
+      while (!zero_copy && end < vec_.size() && end - index < IOV_MAX &&
+             !IsZeroCopy(end)) {
+        end++;
+      }
+
+      msghdr message = {};
+      message.msg_iov = &vec_[index];
+      message.msg_iovlen = end - index;
+      const int flags = MSG_NOSIGNAL | (zero_copy ? MSG_ZEROCOPY : 0);
+
+      ssize_t ret = ::sendmsg(fd_, &message, flags);
+      if (ret < 0 && zero_copy && errno == ENOBUFS) {
+        // Out of memory to pin the pages: copy this payload instead.
+        ret = ::sendmsg(fd_, &message, MSG_NOSIGNAL);
+      } else if (ret >= 0 && zero_copy) {
+        zero_copy_sent_++;
+      }
+
+      if (ret > 0) {
+        std::size_t written = static_cast<std::size_t>(ret);
+        while (written > 0) {
+          const std::size_t consumed = std::min(written, vec_[index].iov_len);
+          vec_[index].iov_base =
+              static_cast<std::uint8_t*>(vec_[index].iov_base) + consumed;
+          vec_[index].iov_len -= consumed;
+          written -= consumed;
+          if (vec_[index].iov_len == 0)
+            index++;
+        }
+      } else if (ret == 0) {
+        return ErrorStatus::WriteLimitReached;
+      } else if (errno != EINTR) {
+        return ErrorStatus::IOError;
+      }
+    }
+    return {};
+  }
+
+  int fd_{-1};
+  IovecWriter iovec_writer_;
+  std::vector<iovec> vec_;
+  std::size_t zero_copy_threshold_{kDefaultZeroCopyThreshold};
+  bool cork_{true};
+  bool zero_copy_{false};
+  std::uint64_t zero_copy_sent_{0};
+  std::uint64_t zero_copy_completed_{0};
+  std::uint64_t zero_copy_copied_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_TCP_WRITER_H_
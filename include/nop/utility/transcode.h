@@ -0,0 +1,507 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_TRANSCODE_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_TRANSCODE_H_
+
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <nop/status.h>
+#include <nop/traits/is_detected.h>
+#include <nop/traits/is_fungible.h>
+
+namespace nop {
+
+//
+// Transcode() converts a value to another type with the same encoding, as
+// determined by IsFungible, without encoding the value and decoding the result.
+// The value is copied member by member and element by element, so converting
+// between, for example, a user-defined structure of std::vectors and a C
+// structure of logical buffers costs no more than copying the elements.
+//
+// The destination is updated the same way decoding the encoding of the source
+// into it would: containers are resized, fixed-size arrays and static
+// containers must have room for the elements, and the capacity of unbounded
+// logical buffers is trusted. String and array views are set to refer to the
+// storage of the source, which must outlive them.
+//
+// Values that are only on one side in memory need no transcoding: write an
+// in-memory value with the encoding of a fungible type, or read an encoding
+// into a fungible in-memory value, using Protocol<T>::Write() and
+// Protocol<T>::Read().
+//
+// Example:
+//
+//   CPolyhedron* c_polyhedron = AllocatePolyhedron(polyhedron.size());
+//   auto status = nop::Transcode(polyhedron, c_polyhedron);
+//
+template <typename From, typename To, typename Enabled = void>
+struct Transcoder;
+
+template <typename From, typename To>
+Status<void> Transcode(const From& from, To* to) {
+  static_assert(IsFungible<From, To>::value,
+                "Transcode requires fungible types.");
+  return Transcoder<From, To>::Transcode(from, to);
+}
+
+// Implementation details of Transcode.
+struct TranscodeCommon {
+  // Transcodes into the target of a member pointer, which resolves to a
+  // pointer to the member or, for logical buffer pairs, to a LogicalBuffer
+  // value referring to the members.
+  template <typename From, typename To>
+  static Status<void> TranscodeTo(const From& from, To* to) {
+    return Transcoder<From, To>::Transcode(from, to);
+  }
+  template <typename From, typename BufferType, typename SizeType,
+            bool IsUnbounded>
+  static Status<void> TranscodeTo(
+      const From& from, LogicalBuffer<BufferType, SizeType, IsUnbounded> to) {
+    return Transcoder<From, LogicalBuffer<BufferType, SizeType, IsUnbounded>>::
+        Transcode(from, &to);
+  }
+
+  // Transcodes each member of a structure, table, or value wrapper.
+  template <typename FromMembers, typename ToMembers, typename From,
+            typename To, std::size_t... Is>
+  static Status<void> TranscodeMembers(const From& from, To* to,
+                                       std::index_sequence<Is...>) {
+    Status<void> status;
+    NOP_EXPAND_STATUS(
+        status,
+        TranscodeTo(FromMembers::template At<Is>::Resolve(from),
+                    ToMembers::template At<Is>::Resolve(to)));
+    return status;
+  }
+
+  // Transcodes the elements of a sequence into a destination that already
+  // holds the same number of elements.
+  template <typename From, typename To>
+  static Status<void> TranscodeElements(const From& from, To* to) {
+    using FromElement = std::decay_t<decltype(*std::begin(from))>;
+    using ToElement = std::decay_t<decltype(*std::begin(*to))>;
+
+    auto out = std::begin(*to);
+    for (const auto& element : from) {
+      auto status =
+          Transcoder<FromElement, ToElement>::Transcode(element, &*out);
+      if (!status)
+        return status;
+      ++out;
+    }
+    return {};
+  }
+};
+
+// Traits for the types that transcode as sequences of elements. Resize()
+// prepares the destination to hold |size| elements.
+template <typename T, typename Enabled = void>
+struct TranscodeSequenceTraits : std::false_type {};
+template <typename T, typename Allocator>
+struct TranscodeSequenceTraits<std::vector<T, Allocator>> : std::true_type {
+  static Status<void> Resize(std::vector<T, Allocator>* value,
+                             std::size_t size) {
+    value->resize(size);
+    return {};
+  }
+};
+template <typename T, typename Allocator>
+struct TranscodeSequenceTraits<std::list<T, Allocator>> : std::true_type {
+  static Status<void> Resize(std::list<T, Allocator>* value,
+                             std::size_t size) {
+    value->resize(size);
+    return {};
+  }
+};
+template <typename T, std::size_t Capacity>
+struct TranscodeSequenceTraits<SmallVector<T, Capacity>> : std::true_type {
+  static Status<void> Resize(SmallVector<T, Capacity>* value,
+                             std::size_t size) {
+    value->resize(size);
+    return {};
+  }
+};
+template <typename T, std::size_t Capacity>
+struct TranscodeSequenceTraits<StaticVector<T, Capacity>> : std::true_type {
+  static Status<void> Resize(StaticVector<T, Capacity>* value,
+                             std::size_t size) {
+    if (!value->resize(size))
+      return ErrorStatus::InvalidContainerLength;
+    return {};
+  }
+};
+template <typename T, std::size_t Length>
+struct TranscodeSequenceTraits<std::array<T, Length>> : std::true_type {
+  static Status<void> Resize(std::array<T, Length>* /*value*/,
+                             std::size_t size) {
+    if (size != Length)
+      return ErrorStatus::InvalidContainerLength;
+    return {};
+  }
+};
+template <typename T, std::size_t Length>
+struct TranscodeSequenceTraits<T[Length]> : std::true_type {
+  static Status<void> Resize(T (*)[Length], std::size_t size) {
+    if (size != Length)
+      return ErrorStatus::InvalidContainerLength;
+    return {};
+  }
+};
+template <typename BufferType, typename SizeType, bool IsUnbounded>
+struct TranscodeSequenceTraits<
+    LogicalBuffer<BufferType, SizeType, IsUnbounded>> : std::true_type {
+  using Type = LogicalBuffer<BufferType, SizeType, IsUnbounded>;
+
+  static Status<void> Resize(Type* value, std::size_t size) {
+    if (!IsUnbounded && size > Type::Length)
+      return ErrorStatus::InvalidContainerLength;
+
+    value->size() = static_cast<SizeType>(size);
+    return {};
+  }
+};
+
+// Traits for the string types, which transcode as a whole.
+template <typename T>
+struct TranscodeStringTraits : std::false_type {};
+template <typename CharType, typename... Any>
+struct TranscodeStringTraits<std::basic_string<CharType, Any...>>
+    : std::true_type {
+  template <typename From>
+  static Status<void> Assign(const From& from,
+                             std::basic_string<CharType, Any...>* to) {
+    to->assign(from.data(), from.size());
+    return {};
+  }
+};
+template <typename CharType, std::size_t Capacity>
+struct TranscodeStringTraits<BasicStaticString<CharType, Capacity>>
+    : std::true_type {
+  template <typename From>
+  static Status<void> Assign(const From& from,
+                             BasicStaticString<CharType, Capacity>* to) {
+    if (!to->assign(from.data(), from.size()))
+      return ErrorStatus::InvalidStringLength;
+    return {};
+  }
+};
+template <typename CharType>
+struct TranscodeStringTraits<BasicStringView<CharType>> : std::true_type {
+  template <typename From>
+  static Status<void> Assign(const From& from, BasicStringView<CharType>* to) {
+    *to = BasicStringView<CharType>{from.data(), from.size()};
+    return {};
+  }
+};
+
+// Evaluates to true if T is a std::pair or std::tuple.
+template <typename T>
+struct IsTupleLike : std::false_type {};
+template <typename... Ts>
+struct IsTupleLike<std::tuple<Ts...>> : std::true_type {};
+template <typename A, typename B>
+struct IsTupleLike<std::pair<A, B>> : std::true_type {};
+
+// Predicates selecting the Transcoder specializations below, in order of
+// precedence.
+template <typename From, typename To>
+using IsIdentityTranscode =
+    std::integral_constant<bool, std::is_same<From, To>::value &&
+                                     std::is_copy_assignable<To>::value>;
+
+template <typename From, typename To>
+using IsWrapperTranscode = std::integral_constant<
+    bool, !IsIdentityTranscode<From, To>::value &&
+              (IsValueWrapper<From>::value || IsValueWrapper<To>::value)>;
+
+template <typename From, typename To>
+using IsSequenceTranscode = std::integral_constant<
+    bool, !IsIdentityTranscode<From, To>::value &&
+              !IsValueWrapper<From>::value && !IsValueWrapper<To>::value &&
+              TranscodeSequenceTraits<To>::value>;
+
+template <typename T>
+struct IsArrayView : std::false_type {};
+template <typename T>
+struct IsArrayView<ArrayView<T>> : std::true_type {};
+
+template <typename From, typename To>
+using IsArrayViewTranscode = std::integral_constant<
+    bool, !IsIdentityTranscode<From, To>::value &&
+              !IsValueWrapper<From>::value && IsArrayView<To>::value>;
+
+template <typename From, typename To>
+using IsStringTranscode = std::integral_constant<
+    bool, !IsIdentityTranscode<From, To>::value &&
+              TranscodeStringTraits<From>::value &&
+              TranscodeStringTraits<To>::value>;
+
+template <typename From, typename To>
+using IsMapTranscode = std::integral_constant<
+    bool, !IsIdentityTranscode<From, To>::value &&
+              MapTypeTraits<From>::value && MapTypeTraits<To>::value>;
+
+template <typename From, typename To>
+using IsSetTranscode = std::integral_constant<
+    bool, !IsIdentityTranscode<From, To>::value &&
+              SetTypeTraits<From>::value && SetTypeTraits<To>::value>;
+
+template <typename From, typename To>
+using IsTupleTranscode = std::integral_constant<
+    bool, !IsIdentityTranscode<From, To>::value &&
+              IsTupleLike<From>::value && IsTupleLike<To>::value>;
+
+template <typename From, typename To>
+using IsStructureTranscode = std::integral_constant<
+    bool, !IsIdentityTranscode<From, To>::value &&
+              !IsValueWrapper<From>::value && !IsValueWrapper<To>::value &&
+              HasMemberList<From>::value && HasMemberList<To>::value>;
+
+template <typename From, typename To>
+using IsTableTranscode = std::integral_constant<
+    bool, !IsIdentityTranscode<From, To>::value &&
+              HasEntryList<From>::value && HasEntryList<To>::value>;
+
+// Values of the same, assignable type are copied.
+template <typename T>
+struct Transcoder<T, T, std::enable_if_t<IsIdentityTranscode<T, T>::value>> {
+  static Status<void> Transcode(const T& from, T* to) {
+    *to = from;
+    return {};
+  }
+};
+
+// Value wrappers transcode the wrapped member.
+template <typename From, typename To>
+struct Transcoder<From, To,
+                  std::enable_if_t<IsWrapperTranscode<From, To>::value>> {
+  static Status<void> Transcode(const From& from, To* to) {
+    return TranscodeCommon::TranscodeTo(Source(from, IsWrapper<From>{}),
+                                        Target(to, IsWrapper<To>{}));
+  }
+
+ private:
+  template <typename T>
+  using IsWrapper = std::integral_constant<bool, IsValueWrapper<T>::value>;
+
+  static decltype(auto) Source(const From& from, std::true_type) {
+    return ValueWrapperTraits<From>::Pointer::Resolve(from);
+  }
+  static const From& Source(const From& from, std::false_type) {
+    return from;
+  }
+
+  static auto Target(To* to, std::true_type) {
+    return ValueWrapperTraits<To>::Pointer::Resolve(to);
+  }
+  static To* Target(To* to, std::false_type) { return to; }
+};
+
+// Sequences are resized to hold the elements of the source, which are then
+// transcoded in order.
+template <typename From, typename To>
+struct Transcoder<From, To,
+                  std::enable_if_t<IsSequenceTranscode<From, To>::value>> {
+  static Status<void> Transcode(const From& from, To* to) {
+    const auto size = std::distance(std::begin(from), std::end(from));
+    auto status = TranscodeSequenceTraits<To>::Resize(
+        to, static_cast<std::size_t>(size));
+    if (!status)
+      return status;
+
+    return TranscodeCommon::TranscodeElements(from, to);
+  }
+};
+
+// Array views refer to the elements of the source.
+template <typename From, typename To>
+struct Transcoder<From, To,
+                  std::enable_if_t<IsArrayViewTranscode<From, To>::value>> {
+  static Status<void> Transcode(const From& from, To* to) {
+    *to = To{from.data(), from.size()};
+    return {};
+  }
+};
+
+template <typename From, typename To>
+struct Transcoder<From, To,
+                  std::enable_if_t<IsStringTranscode<From, To>::value>> {
+  static Status<void> Transcode(const From& from, To* to) {
+    return TranscodeStringTraits<To>::Assign(from, to);
+  }
+};
+
+// Maps and sets are cleared and refilled with the transcoded elements.
+template <typename From, typename To>
+struct Transcoder<From, To,
+                  std::enable_if_t<IsMapTranscode<From, To>::value>> {
+  static Status<void> Transcode(const From& from, To* to) {
+    using FromKey = typename MapTypeTraits<From>::KeyType;
+    using FromValue = typename MapTypeTraits<From>::MappedType;
+    using ToKey = typename MapTypeTraits<To>::KeyType;
+    using ToValue = typename MapTypeTraits<To>::MappedType;
+
+    to->clear();
+    for (const auto& element : from) {
+      ToKey key{};
+      auto status =
+          Transcoder<FromKey, ToKey>::Transcode(element.first, &key);
+      if (!status)
+        return status;
+
+      ToValue value{};
+      status =
+          Transcoder<FromValue, ToValue>::Transcode(element.second, &value);
+      if (!status)
+        return status;
+
+      to->insert({std::move(key), std::move(value)});
+    }
+    return {};
+  }
+};
+
+template <typename From, typename To>
+struct Transcoder<From, To,
+                  std::enable_if_t<IsSetTranscode<From, To>::value>> {
+  static Status<void> Transcode(const From& from, To* to) {
+    using FromKey = typename SetTypeTraits<From>::KeyType;
+    using ToKey = typename SetTypeTraits<To>::KeyType;
+
+    to->clear();
+    for (const auto& element : from) {
+      ToKey key{};
+      auto status = Transcoder<FromKey, ToKey>::Transcode(element, &key);
+      if (!status)
+        return status;
+
+      to->insert(std::move(key));
+    }
+    return {};
+  }
+};
+
+template <typename From, typename To>
+struct Transcoder<From, To,
+                  std::enable_if_t<IsTupleTranscode<From, To>::value>> {
+  static Status<void> Transcode(const From& from, To* to) {
+    return Transcode(from, to,
+                     std::make_index_sequence<std::tuple_size<From>::value>{});
+  }
+
+ private:
+  template <std::size_t... Is>
+  static Status<void> Transcode(const From& from, To* to,
+                                std::index_sequence<Is...>) {
+    Status<void> status;
+    NOP_EXPAND_STATUS(status, TranscodeCommon::TranscodeTo(
+                                  std::get<Is>(from), &std::get<Is>(*to)));
+    return status;
+  }
+};
+
+template <typename From, typename To>
+struct Transcoder<From, To,
+                  std::enable_if_t<IsStructureTranscode<From, To>::value>> {
+  static Status<void> Transcode(const From& from, To* to) {
+    using FromMembers = typename MemberListTraits<From>::MemberList;
+    using ToMembers = typename MemberListTraits<To>::MemberList;
+    return TranscodeCommon::TranscodeMembers<FromMembers, ToMembers>(
+        from, to, std::make_index_sequence<FromMembers::Count>{});
+  }
+};
+
+template <typename From, typename To>
+struct Transcoder<From, To,
+                  std::enable_if_t<IsTableTranscode<From, To>::value>> {
+  static Status<void> Transcode(const From& from, To* to) {
+    using FromEntries = typename EntryListTraits<From>::EntryList;
+    using ToEntries = typename EntryListTraits<To>::EntryList;
+    return TranscodeCommon::TranscodeMembers<FromEntries, ToEntries>(
+        from, to, std::make_index_sequence<FromEntries::Count>{});
+  }
+};
+
+// Optional values and table entries transcode the contained value, if any.
+template <typename A, typename B>
+struct Transcoder<Optional<A>, Optional<B>,
+                  std::enable_if_t<!std::is_same<A, B>::value>> {
+  static Status<void> Transcode(const Optional<A>& from, Optional<B>* to) {
+    if (from.empty()) {
+      to->clear();
+      return {};
+    }
+
+    if (to->empty())
+      *to = B{};
+    return Transcoder<A, B>::Transcode(from.get(), &to->get());
+  }
+};
+template <typename A, typename B, std::uint64_t Id>
+struct Transcoder<Entry<A, Id, ActiveEntry>, Entry<B, Id, ActiveEntry>,
+                  std::enable_if_t<!std::is_same<A, B>::value>>
+    : Transcoder<Optional<A>, Optional<B>> {};
+template <typename A, typename B, std::uint64_t Id>
+struct Transcoder<Entry<A, Id, DeletedEntry>, Entry<B, Id, DeletedEntry>,
+                  std::enable_if_t<!std::is_same<A, B>::value>> {
+  static Status<void> Transcode(const Entry<A, Id, DeletedEntry>& /*from*/,
+                                Entry<B, Id, DeletedEntry>* /*to*/) {
+    return {};
+  }
+};
+
+// Variants become the alternative at the index of the active alternative of
+// the source.
+template <typename... A, typename... B>
+struct Transcoder<Variant<A...>, Variant<B...>,
+                  std::enable_if_t<!std::is_same<Variant<A...>,
+                                                 Variant<B...>>::value>> {
+  static Status<void> Transcode(const Variant<A...>& from, Variant<B...>* to) {
+    return Transcode(from, to, std::index_sequence_for<A...>{});
+  }
+
+ private:
+  using Function = Status<void> (*)(const Variant<A...>&, Variant<B...>*);
+
+  template <std::size_t... Is>
+  static Status<void> Transcode(const Variant<A...>& from, Variant<B...>* to,
+                                std::index_sequence<Is...>) {
+    if (from.empty()) {
+      to->Become(Variant<B...>::kEmptyIndex);
+      return {};
+    }
+
+    static constexpr Function functions[] = {&TranscodeAt<Is>...};
+    return functions[from.index()](from, to);
+  }
+
+  template <std::size_t Index>
+  static Status<void> TranscodeAt(const Variant<A...>& from,
+                                  Variant<B...>* to) {
+    to->Become(static_cast<std::int32_t>(Index));
+    return TranscodeCommon::TranscodeTo(*from.template get<Index>(),
+                                        to->template get<Index>());
+  }
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_TRANSCODE_H_
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_TRUSTED_BUFFER_READER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_TRUSTED_BUFFER_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <nop/base/encoding.h>
+#include <nop/base/utility.h>
+
+namespace nop {
+
+// A reader type for decoding messages from trusted peers, such as processes
+// built from the same source, out of a byte buffer. Decoding through this
+// reader elides the checks of the encoding shape that decoding untrusted input
+// requires: prefixes are not matched against the types read, the member counts
+// of structures and hashes of tables are not compared, and Ensure() does not
+// check container lengths in advance. Every read is still checked against the
+// end of the buffer, so input that is not what the peer was expected to send
+// may decode incorrectly, but is never read out of bounds.
+//
+// Example:
+//
+//   nop::Deserializer<nop::TrustedBufferReader> deserializer{data, size};
+//   auto status = deserializer.Read(&message);
+//
+class TrustedBufferReader {
+ public:
+  using TrustedEncoding = void;
+
+  TrustedBufferReader() = default;
+  TrustedBufferReader(const TrustedBufferReader&) = default;
+  template <std::size_t Size>
+  TrustedBufferReader(const std::uint8_t (&buffer)[Size])
+      : buffer_{buffer}, size_{Size} {}
+  TrustedBufferReader(const std::uint8_t* buffer, std::size_t size)
+      : buffer_{buffer}, size_{size} {}
+  TrustedBufferReader(const void* buffer, std::size_t size)
+      : buffer_{static_cast<const std::uint8_t*>(buffer)}, size_{size} {}
+
+  TrustedBufferReader& operator=(const TrustedBufferReader&) = default;
+
+  // Container lengths are trusted; the reads that follow are still checked.
+  Status<void> Ensure(std::size_t /*size*/) { return {}; }
+
+  Status<void> Read(std::uint8_t* byte) {
+    if (index_ == size_)
+      return ErrorStatus::ReadLimitReached;
+
+    *byte = buffer_[index_++];
+    return {};
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Read(T* begin, T* end) {
+    const std::size_t length_bytes = (end - begin) * sizeof(T);
+    if (length_bytes > (size_ - index_))
+      return ErrorStatus::ReadLimitReached;
+
+    std::memcpy(begin, &buffer_[index_], length_bytes);
+    index_ += length_bytes;
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    if (padding_bytes > (size_ - index_))
+      return ErrorStatus::ReadLimitReached;
+
+    index_ += padding_bytes;
+    return {};
+  }
+
+  // Returns a pointer to the next |size| bytes of the input and advances past
+  // them. The pointer remains valid for as long as the underlying buffer.
+  Status<const std::uint8_t*> Borrow(std::size_t size) {
+    if (size > (size_ - index_))
+      return ErrorStatus::ReadLimitReached;
+
+    const std::uint8_t* data = &buffer_[index_];
+    index_ += size;
+    return data;
+  }
+
+  bool empty() const { return index_ == size_; }
+
+  std::size_t remaining() const { return size_ - index_; }
+  std::size_t capacity() const { return size_; }
+
+ private:
+  const std::uint8_t* buffer_{nullptr};
+  std::size_t size_{0};
+  std::size_t index_{0};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_TRUSTED_BUFFER_READER_H_
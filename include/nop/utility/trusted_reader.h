@@ -0,0 +1,103 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_TRUSTED_READER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_TRUSTED_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <nop/base/encoding.h>
+#include <nop/base/handle.h>
+#include <nop/base/utility.h>
+
+namespace nop {
+
+// TrustedReader is a reader type that wraps another reader pointer and marks
+// its input as coming from a trusted peer, as described by TrustedEncoding in
+// nop/base/encoding.h: prefixes are not matched against the types read, and
+// the member counts of structures and hashes of tables are not compared. This
+// extends the checks elided by TrustedBufferReader to any reader, such as one
+// reading from a socket whose peer passed a SchemaHandshake.
+//
+// Operations are passed to the underlying reader unchanged, which remains
+// responsible for bounds checking; Ensure() is still forwarded so that the
+// underlying reader may reject container lengths larger than its input.
+//
+// Example:
+//
+//   nop::TrustedReader<nop::FdReader> trusted_reader{&fd_reader};
+//   nop::Deserializer<decltype(trusted_reader)*> deserializer{
+//       &trusted_reader};
+//   deserializer.Read(&message);
+//
+template <typename Reader>
+class TrustedReader {
+ public:
+  using TrustedEncoding = void;
+
+  TrustedReader() = default;
+  TrustedReader(const TrustedReader&) = default;
+  TrustedReader(Reader* reader) : reader_{reader} {}
+
+  TrustedReader& operator=(const TrustedReader&) = default;
+
+  Status<void> Ensure(std::size_t size) { return reader_->Ensure(size); }
+
+  Status<void> Read(std::uint8_t* byte) { return reader_->Read(byte); }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Read(T* begin, T* end) {
+    return reader_->Read(begin, end);
+  }
+
+  Status<void> Skip(std::size_t padding_bytes) {
+    return reader_->Skip(padding_bytes);
+  }
+
+  // Borrows |size| bytes from the underlying reader. Only available when the
+  // underlying reader supports this operation.
+  template <typename R = Reader, typename = decltype(std::declval<R&>().Borrow(
+                                     std::size_t{}))>
+  Status<const std::uint8_t*> Borrow(std::size_t size) {
+    return reader_->Borrow(size);
+  }
+
+  // Returns the number of bytes remaining in the underlying reader. Only
+  // available when the underlying reader supports this operation.
+  template <typename R = Reader,
+            typename = decltype(std::declval<const R&>().remaining())>
+  std::size_t remaining() const {
+    return reader_->remaining();
+  }
+
+  template <typename HandleType>
+  Status<HandleType> GetHandle(HandleReference handle_reference) {
+    return reader_->template GetHandle<HandleType>(handle_reference);
+  }
+
+  bool empty() const { return reader_->empty(); }
+
+  Reader* reader() const { return reader_; }
+
+ private:
+  Reader* reader_{nullptr};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_TRUSTED_READER_H_
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_VECTOR_WRITER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_VECTOR_WRITER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/base/utility.h>
+
+namespace nop {
+
+// A writer type that serializes into a contiguous buffer that it owns. Unlike
+// BufferWriter, the buffer grows as needed: Serializer calls Prepare() with the
+// encoded size of each value before writing it, which the writer uses to grow
+// the buffer geometrically so that writes never reallocate.
+//
+// The buffer may be moved out of the writer with take() without copying, or
+// reset() to reuse its capacity for the next message so that a long-lived
+// writer does not allocate in steady state.
+//
+// Example:
+//
+//   nop::Serializer<nop::VectorWriter> serializer;
+//   serializer.Write(message);
+//   SendBytes(serializer.writer().data(), serializer.writer().size());
+//   serializer.writer().reset();
+//
+template <typename Allocator = std::allocator<std::uint8_t>>
+class BasicVectorWriter {
+ public:
+  using BufferType = std::vector<std::uint8_t, Allocator>;
+
+  BasicVectorWriter() = default;
+  BasicVectorWriter(const BasicVectorWriter&) = default;
+  BasicVectorWriter(BasicVectorWriter&&) = default;
+  explicit BasicVectorWriter(const Allocator& allocator) : buffer_{allocator} {}
+  explicit BasicVectorWriter(std::size_t capacity,
+                             const Allocator& allocator = Allocator{})
+      : buffer_{allocator} {
+    buffer_.reserve(capacity);
+  }
+  explicit BasicVectorWriter(BufferType&& buffer)
+      : buffer_{std::move(buffer)} {
+    buffer_.clear();
+  }
+
+  BasicVectorWriter& operator=(const BasicVectorWriter&) = default;
+  BasicVectorWriter& operator=(BasicVectorWriter&&) = default;
+
+  Status<void> Prepare(std::size_t size) {
+    const std::size_t required = buffer_.size() + size;
+    if (required > buffer_.capacity())
+      buffer_.reserve(std::max(required, 2 * buffer_.capacity()));
+    return {};
+  }
+
+  Status<void> Write(std::uint8_t byte) {
+    buffer_.push_back(byte);
+    return {};
+  }
+
+  template <typename T, typename Enable = EnableIfBitwiseCopyable<T>>
+  Status<void> Write(const T* begin, const T* end) {
+    using Byte = std::uint8_t;
+    const Byte* begin_byte = reinterpret_cast<const Byte*>(begin);
+    const Byte* end_byte = reinterpret_cast<const Byte*>(end);
+    buffer_.insert(buffer_.end(), begin_byte, end_byte);
+    return {};
+  }
+
+  Status<void> Skip(std::size_t padding_bytes,
+                    std::uint8_t padding_value = 0x00) {
+    buffer_.insert(buffer_.end(), padding_bytes, padding_value);
+    return {};
+  }
+
+  // Extends the buffer by |size| bytes for encodings to store values into
+  // directly, and returns a pointer to them. Commit() trims the bytes of the
+  // reservation that are not used. See IsReservingWriter.
+  Status<std::uint8_t*> Reserve(std::size_t size) {
+    reserved_ = buffer_.size();
+    buffer_.resize(reserved_ + size);
+    return &buffer_[reserved_];
+  }
+
+  void Commit(std::size_t size) { buffer_.resize(reserved_ + size); }
+
+  // Overwrites previously written data at |position| with the given elements.
+  // Tables use this to write their entries in a single pass.
+  template <typename T, typename Enable = EnableIfArithmetic<T>>
+  Status<void> Patch(std::size_t position, const T* begin, const T* end) {
+    const std::size_t length_bytes = (end - begin) * sizeof(T);
+    if (position > buffer_.size() || length_bytes > buffer_.size() - position)
+      return ErrorStatus::WriteLimitReached;
+
+    std::memcpy(&buffer_[position], begin, length_bytes);
+    return {};
+  }
+
+  // Discards the data written after the first |size| bytes.
+  void Truncate(std::size_t size) {
+    if (size < buffer_.size())
+      buffer_.resize(size);
+  }
+
+  // Discards the written data, keeping the capacity of the buffer.
+  void reset() { buffer_.clear(); }
+
+  // Moves the buffer out of the writer. The writer is left empty with no
+  // capacity.
+  BufferType take() {
+    BufferType buffer{std::move(buffer_)};
+    buffer_.clear();
+    return buffer;
+  }
+
+  const std::uint8_t* data() const { return buffer_.data(); }
+  const BufferType& buffer() const { return buffer_; }
+
+  std::size_t size() const { return buffer_.size(); }
+  std::size_t capacity() const { return buffer_.capacity(); }
+
+ private:
+  BufferType buffer_;
+  std::size_t reserved_{0};
+};
+
+// VectorWriter with the default allocator.
+using VectorWriter = BasicVectorWriter<>;
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_VECTOR_WRITER_H_
@@ -0,0 +1,591 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_WIRE_SIZE_PROFILER_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_WIRE_SIZE_PROFILER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nop/base/encoding.h>
+#include <nop/serializer.h>
+#include <nop/status.h>
+#include <nop/utility/vector_writer.h>
+
+namespace nop {
+
+//
+// Offline analysis of where the bytes of encoded messages go.
+//
+// WireSizeProfiler walks a sample of encoded messages, driven only by their
+// prefixes, and totals the bytes at each position in the schema, or path:
+//
+//   $            the message itself
+//   $.2          member 2 of a structure
+//   $[]          the elements of an array
+//   ${key}, ${}  the keys and values of a map
+//   $#7          table entry 7
+//   $<1>         alternative 1 of a variant
+//
+// At each path the bytes are split into prefixes, length fields (container
+// counts and string, binary, and extension lengths), table overhead (hashes,
+// entry counts, ids, and sizes), padding after table entry values, which
+// BoundedWriter::WritePadding() writes when an entry size is overestimated,
+// and the remaining payload. Bytes are attributed to the innermost value, so
+// the totals over all paths add up to the size of the sample.
+//
+// Each path also carries the estimated bytes saved, or added when negative,
+// by alternative encodings of its values:
+//
+//   packed       arrays of numbers as packed binary at the widest element
+//   fixed width  integers at the widest observed width, as written by
+//                FixedWidthWriter; this trades size for speed
+//   delta        arrays of integers as Delta sets; see nop/base/delta.h
+//   interning    strings repeated within a message of at least
+//                kInterningMinSize bytes as references; see InterningWriter
+//
+// The estimates depend only on the values seen, not on their declared types,
+// so widths narrower than the declared type are possible in the packed and
+// fixed-width estimates.
+//
+// Example:
+//
+//   nop::WireSizeProfiler profiler;
+//   for (const auto& message : sample)
+//     profiler.Add(message.data(), message.size());
+//   std::fputs(profiler.Report().c_str(), stdout);
+//
+class WireSizeProfiler {
+ public:
+  enum : std::size_t { kDefaultMaxDepth = 64, kInterningMinSize = 8 };
+
+  // The totals at one path.
+  struct Entry {
+    std::string path;
+    std::uint64_t count;
+    std::uint64_t prefix_bytes;
+    std::uint64_t length_bytes;
+    std::uint64_t table_bytes;
+    std::uint64_t padding_bytes;
+    std::uint64_t payload_bytes;
+
+    std::int64_t packed_savings;
+    std::int64_t fixed_width_savings;
+    std::int64_t delta_savings;
+    std::int64_t interning_savings;
+
+    std::uint64_t total_bytes() const {
+      return prefix_bytes + length_bytes + table_bytes + padding_bytes +
+             payload_bytes;
+    }
+  };
+
+  explicit WireSizeProfiler(std::size_t max_depth = kDefaultMaxDepth)
+      : max_depth_{max_depth} {}
+
+  // Analyzes the encoded value at the start of the |size| bytes at |data| and
+  // returns its size, so that a buffer of consecutive messages may be analyzed
+  // one at a time. The totals include the part of a malformed value read
+  // before the error.
+  Status<std::size_t> Add(const void* data, std::size_t size) {
+    begin_ = static_cast<const std::uint8_t*>(data);
+    cursor_ = begin_;
+    end_ = begin_ + size;
+    path_ = "$";
+    strings_.clear();
+    messages_++;
+
+    Scalar scalar;
+    auto status = Value(0, &scalar);
+    if (!status)
+      return status.error();
+    else
+      return static_cast<std::size_t>(cursor_ - begin_);
+  }
+
+  // Encodes |value| and analyzes the encoding.
+  template <typename T>
+  Status<void> AddValue(const T& value) {
+    Serializer<VectorWriter> serializer;
+    auto status = serializer.Write(value);
+    if (!status)
+      return status;
+
+    const auto& buffer = serializer.writer().buffer();
+    auto size = Add(buffer.data(), buffer.size());
+    if (!size)
+      return size.error();
+    else
+      return {};
+  }
+
+  // Returns the totals of each path, in path order.
+  std::vector<Entry> entries() const {
+    std::vector<Entry> entries;
+    for (const auto& path : paths_) {
+      const Totals& totals = path.second;
+      Entry entry = totals.entry;
+      entry.path = path.first;
+
+      // Fixed width integers have at least one byte of payload.
+      const std::uint64_t fixed_size =
+          std::max<std::uint64_t>(totals.max_integer_size, 2);
+      entry.fixed_width_savings =
+          static_cast<std::int64_t>(totals.integer_bytes) -
+          static_cast<std::int64_t>(totals.integers * fixed_size);
+      entries.push_back(std::move(entry));
+    }
+    return entries;
+  }
+
+  // Returns the number of messages analyzed.
+  std::size_t messages() const { return messages_; }
+
+  // Returns a table of the totals, one line per path.
+  std::string Report() const {
+    std::string report;
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "%10s %10s %10s %10s %10s %10s %10s %10s %10s %10s %10s  "
+                  "%s\n",
+                  "count", "prefix", "length", "table", "padding", "payload",
+                  "total", "packed", "fixed", "delta", "interning", "path");
+    report += line;
+    for (const Entry& entry : entries()) {
+      std::snprintf(
+          line, sizeof(line),
+          "%10llu %10llu %10llu %10llu %10llu %10llu %10llu %10lld %10lld "
+          "%10lld %10lld  ",
+          static_cast<unsigned long long>(entry.count),
+          static_cast<unsigned long long>(entry.prefix_bytes),
+          static_cast<unsigned long long>(entry.length_bytes),
+          static_cast<unsigned long long>(entry.table_bytes),
+          static_cast<unsigned long long>(entry.padding_bytes),
+          static_cast<unsigned long long>(entry.payload_bytes),
+          static_cast<unsigned long long>(entry.total_bytes()),
+          static_cast<long long>(entry.packed_savings),
+          static_cast<long long>(entry.fixed_width_savings),
+          static_cast<long long>(entry.delta_savings),
+          static_cast<long long>(entry.interning_savings));
+      report += line;
+      report += entry.path;
+      report += '\n';
+    }
+    return report;
+  }
+
+  // Discards the collected totals.
+  void Clear() {
+    paths_.clear();
+    messages_ = 0;
+  }
+
+ private:
+  struct Totals {
+    Entry entry{};
+    std::uint64_t integers{0};
+    std::uint64_t integer_bytes{0};
+    std::uint64_t max_integer_size{0};
+  };
+
+  // Describes a value that is a number, for the estimates of its container.
+  struct Scalar {
+    enum Kind { None, Integer, Float } kind{None};
+    std::uint64_t bits{0};
+    bool is_signed{false};
+    std::size_t width{0};
+  };
+
+  Status<void> Value(std::size_t depth, Scalar* scalar) {
+    if (depth > max_depth_)
+      return ErrorStatus::ProtocolError;
+
+    Totals& totals = paths_[path_];
+    Entry& entry = totals.entry;
+    entry.count++;
+
+    const std::uint8_t* start = cursor_;
+    std::uint8_t prefix_byte = 0;
+    auto status = ReadByte(&prefix_byte);
+    if (!status)
+      return status;
+
+    entry.prefix_bytes++;
+    const auto prefix = static_cast<EncodingByte>(prefix_byte);
+    switch (prefix) {
+      case EncodingByte::F32:
+      case EncodingByte::F64:
+        scalar->kind = Scalar::Float;
+        scalar->width = prefix == EncodingByte::F32 ? 4 : 8;
+        entry.payload_bytes += scalar->width;
+        return Skip(scalar->width);
+
+      case EncodingByte::String:
+        return String(&entry, start);
+
+      case EncodingByte::Binary:
+      case EncodingByte::Extension: {
+        if (prefix == EncodingByte::Extension) {
+          status = Integer(&entry.payload_bytes);
+          if (!status)
+            return status;
+        }
+
+        auto size = Size(&entry.length_bytes);
+        if (!size)
+          return size.error();
+
+        entry.payload_bytes += size.get();
+        return Skip(size.get());
+      }
+
+      case EncodingByte::Array:
+      case EncodingByte::Structure:
+        return Array(prefix, depth, &entry, start);
+
+      case EncodingByte::Map:
+        return Map(depth, &entry);
+
+      case EncodingByte::Table:
+        return Table(depth, &entry);
+
+      case EncodingByte::Variant: {
+        Scalar index;
+        status = Integer(&entry.payload_bytes, &index);
+        if (!status)
+          return status;
+
+        const auto alternative = static_cast<std::int64_t>(index.bits);
+        Scalar value;
+        return Nested("<" + std::to_string(alternative) + ">", depth, &value);
+      }
+
+      case EncodingByte::Handle:
+        status = Integer(&entry.payload_bytes);
+        if (!status)
+          return status;
+        return Integer(&entry.payload_bytes);
+
+      case EncodingByte::Error:
+        return Integer(&entry.payload_bytes);
+
+      case EncodingByte::Nil:
+        return {};
+
+      default:
+        status = IntegerPayload(prefix, scalar);
+        if (!status)
+          return status;
+
+        entry.payload_bytes += scalar->width;
+        totals.integers++;
+        totals.integer_bytes += 1 + scalar->width;
+        totals.max_integer_size =
+            std::max<std::uint64_t>(totals.max_integer_size, 1 + scalar->width);
+        return {};
+    }
+  }
+
+  // Analyzes a value nested at |suffix| under the current path.
+  Status<void> Nested(const std::string& suffix, std::size_t depth,
+                      Scalar* scalar) {
+    const std::size_t length = path_.size();
+    path_ += suffix;
+    auto status = Value(depth + 1, scalar);
+    path_.resize(length);
+    return status;
+  }
+
+  Status<void> String(Entry* entry, const std::uint8_t* start) {
+    auto size = Size(&entry->length_bytes);
+    if (!size)
+      return size.error();
+
+    const std::uint8_t* data = cursor_;
+    entry->payload_bytes += size.get();
+    auto status = Skip(size.get());
+    if (!status || size.get() < kInterningMinSize)
+      return status;
+
+    // Repeated strings would be written as references to the first one, which
+    // is written as a slightly larger definition.
+    const std::int64_t current = cursor_ - start;
+    const std::uint64_t index = strings_.size();
+    auto search = strings_.find(
+        std::string{reinterpret_cast<const char*>(data), size.get()});
+    if (search != strings_.end()) {
+      const std::size_t length = IntegerSize(search->second);
+      const std::size_t reference = 2 + IntegerSize(length) + length;
+      entry->interning_savings +=
+          current - static_cast<std::int64_t>(reference);
+    } else {
+      const std::size_t length = IntegerSize(index) + size.get();
+      const std::size_t definition = 2 + IntegerSize(length) + length;
+      entry->interning_savings +=
+          current - static_cast<std::int64_t>(definition);
+      strings_.emplace(
+          std::string{reinterpret_cast<const char*>(data), size.get()}, index);
+    }
+    return {};
+  }
+
+  Status<void> Array(EncodingByte prefix, std::size_t depth, Entry* entry,
+                     const std::uint8_t* start) {
+    auto count = Size(&entry->length_bytes);
+    if (!count)
+      return count.error();
+
+    const bool is_array = prefix == EncodingByte::Array;
+    Scalar::Kind kind = count.get() != 0 ? Scalar::Integer : Scalar::None;
+    std::size_t width = 1;
+    std::vector<Scalar> integers;
+
+    for (std::size_t i = 0; i < count.get(); i++) {
+      Scalar element;
+      auto status =
+          Nested(is_array ? "[]" : "." + std::to_string(i), depth, &element);
+      if (!status)
+        return status;
+
+      if (i == 0 && element.kind == Scalar::Float)
+        kind = Scalar::Float;
+      if (element.kind != kind)
+        kind = Scalar::None;
+      width = std::max(width, element.width);
+      if (kind == Scalar::Integer)
+        integers.push_back(element);
+    }
+
+    if (!is_array || kind == Scalar::None)
+      return {};
+
+    const std::int64_t current = cursor_ - start;
+    const std::size_t packed_bytes = count.get() * width;
+    const std::size_t packed = 1 + IntegerSize(packed_bytes) + packed_bytes;
+    entry->packed_savings += current - static_cast<std::int64_t>(packed);
+
+    if (kind == Scalar::Integer) {
+      const std::size_t length = DeltaLength(integers);
+      const std::size_t delta = 2 + IntegerSize(length) + length;
+      entry->delta_savings += current - static_cast<std::int64_t>(delta);
+    }
+    return {};
+  }
+
+  Status<void> Map(std::size_t depth, Entry* entry) {
+    auto count = Size(&entry->length_bytes);
+    if (!count)
+      return count.error();
+
+    for (std::size_t i = 0; i < count.get(); i++) {
+      Scalar key;
+      auto status = Nested("{key}", depth, &key);
+      if (!status)
+        return status;
+
+      Scalar value;
+      status = Nested("{}", depth, &value);
+      if (!status)
+        return status;
+    }
+    return {};
+  }
+
+  // Analyzes the entries of a table, each within the size of its entry. The
+  // bytes left over after an entry value are padding.
+  Status<void> Table(std::size_t depth, Entry* entry) {
+    auto status = Integer(&entry->table_bytes);
+    if (!status)
+      return status;
+
+    auto count = Size(&entry->table_bytes);
+    if (!count)
+      return count.error();
+
+    for (std::size_t i = 0; i < count.get(); i++) {
+      Scalar id;
+      status = Integer(&entry->table_bytes, &id);
+      if (!status)
+        return status;
+
+      auto size = Size(&entry->table_bytes);
+      if (!size)
+        return size.error();
+      else if (size.get() > static_cast<std::size_t>(end_ - cursor_))
+        return ErrorStatus::ReadLimitReached;
+
+      const std::uint8_t* end = end_;
+      end_ = cursor_ + size.get();
+
+      const std::string suffix = "#" + std::to_string(id.bits);
+      Scalar value;
+      status = Nested(suffix, depth, &value);
+      if (!status)
+        return status;
+
+      paths_[path_ + suffix].entry.padding_bytes += end_ - cursor_;
+      cursor_ = end_;
+      end_ = end;
+    }
+    return {};
+  }
+
+  // Reads an integer, adding its size to |bytes|.
+  Status<void> Integer(std::uint64_t* bytes, Scalar* scalar = nullptr) {
+    std::uint8_t prefix_byte = 0;
+    auto status = ReadByte(&prefix_byte);
+    if (!status)
+      return status;
+
+    Scalar integer;
+    status = IntegerPayload(static_cast<EncodingByte>(prefix_byte), &integer);
+    if (!status)
+      return status;
+
+    *bytes += 1 + integer.width;
+    if (scalar)
+      *scalar = integer;
+    return {};
+  }
+
+  // Reads a container count or payload length, adding its size to |bytes|.
+  // Every element takes at least one byte, so neither may exceed the input
+  // remaining.
+  Status<std::size_t> Size(std::uint64_t* bytes) {
+    Scalar size;
+    auto status = Integer(bytes, &size);
+    if (!status)
+      return status.error();
+    else if (size.is_signed ||
+             size.bits > static_cast<std::uint64_t>(end_ - cursor_))
+      return ErrorStatus::ReadLimitReached;
+    else
+      return static_cast<std::size_t>(size.bits);
+  }
+
+  // Reads the payload of the integer with |prefix|, failing if the prefix is
+  // not an integer prefix.
+  Status<void> IntegerPayload(EncodingByte prefix, Scalar* scalar) {
+    scalar->kind = Scalar::Integer;
+    if (prefix <= EncodingByte::PositiveFixIntMax) {
+      scalar->bits = static_cast<std::uint64_t>(prefix);
+      return {};
+    } else if (prefix >= EncodingByte::NegativeFixIntMin) {
+      scalar->bits = static_cast<std::uint64_t>(
+          static_cast<std::int64_t>(static_cast<std::int8_t>(prefix)));
+      scalar->is_signed = true;
+      return {};
+    } else if (prefix < EncodingByte::U8 || prefix > EncodingByte::I64) {
+      return ErrorStatus::UnexpectedEncodingType;
+    }
+
+    scalar->width = BaseEncodingSize(prefix) - 1;
+    scalar->is_signed = prefix >= EncodingByte::I8;
+    if (scalar->width > static_cast<std::size_t>(end_ - cursor_))
+      return ErrorStatus::ReadLimitReached;
+
+    std::uint64_t bits = 0;
+    for (std::size_t i = 0; i < scalar->width; i++)
+      bits |= static_cast<std::uint64_t>(cursor_[i]) << (8 * i);
+    cursor_ += scalar->width;
+
+    // Sign extend narrower signed integers.
+    if (scalar->is_signed && scalar->width < 8) {
+      const std::uint64_t sign = std::uint64_t{1} << (8 * scalar->width - 1);
+      bits = (bits ^ sign) - sign;
+    }
+    scalar->bits = bits;
+    return {};
+  }
+
+  Status<void> ReadByte(std::uint8_t* byte) {
+    if (cursor_ == end_)
+      return ErrorStatus::ReadLimitReached;
+
+    *byte = *cursor_++;
+    return {};
+  }
+
+  Status<void> Skip(std::size_t size) {
+    if (size > static_cast<std::size_t>(end_ - cursor_))
+      return ErrorStatus::ReadLimitReached;
+
+    cursor_ += size;
+    return {};
+  }
+
+  // Returns the encoded size of the unsigned integer |value|.
+  static std::size_t IntegerSize(std::uint64_t value) {
+    return Encoding<std::uint64_t>::Size(value);
+  }
+
+  static std::size_t VarintSize(std::uint64_t value) {
+    std::size_t size = 1;
+    while (value >= 0x80) {
+      value >>= 7;
+      size++;
+    }
+    return size;
+  }
+
+  // Returns the length of the Delta encoding of |integers|: the count
+  // followed by the differences, unsigned when the integers are
+  // non-decreasing and zigzag encoded otherwise.
+  static std::size_t DeltaLength(const std::vector<Scalar>& integers) {
+    bool increasing = true;
+    for (std::size_t i = 0; i < integers.size(); i++) {
+      const auto value = static_cast<std::int64_t>(integers[i].bits);
+      if ((integers[i].is_signed && value < 0) ||
+          (i != 0 && value < static_cast<std::int64_t>(integers[i - 1].bits)))
+        increasing = false;
+    }
+
+    std::size_t length = VarintSize(integers.size());
+    std::uint64_t previous = 0;
+    for (const Scalar& integer : integers) {
+      const std::uint64_t difference = integer.bits - previous;
+      const auto signed_difference = static_cast<std::int64_t>(difference);
+      length += VarintSize(
+          increasing ? difference
+                     : (difference << 1) ^
+                           static_cast<std::uint64_t>(signed_difference >> 63));
+      previous = integer.bits;
+    }
+    return length;
+  }
+
+  std::size_t max_depth_;
+  std::map<std::string, Totals> paths_;
+  std::size_t messages_{0};
+
+  // The message being analyzed and the strings it has repeated, by index.
+  const std::uint8_t* begin_{nullptr};
+  const std::uint8_t* cursor_{nullptr};
+  const std::uint8_t* end_{nullptr};
+  std::string path_;
+  std::unordered_map<std::string, std::uint64_t> strings_;
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_WIRE_SIZE_PROFILER_H_
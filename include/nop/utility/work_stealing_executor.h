@@ -0,0 +1,197 @@
+/*
+ * Copyright 2018 The Native Object Protocols Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBNOP_INCLUDE_NOP_UTILITY_WORK_STEALING_EXECUTOR_H_
+#define LIBNOP_INCLUDE_NOP_UTILITY_WORK_STEALING_EXECUTOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace nop {
+
+// WorkStealingExecutor runs tasks on a fixed pool of worker threads. Each
+// worker has its own queue: tasks are submitted to the queue of a particular
+// worker, usually chosen by a hint such as a connection id so that related
+// tasks tend to run on the same worker, and each worker runs the tasks in its
+// queue in order. Workers whose queues are empty steal the most recently
+// submitted tasks from the queues of other workers, which keeps every worker
+// busy when the cost of tasks is uneven.
+//
+// Queues are guarded by a mutex each, rather than being lock-free, so the
+// executor suits tasks that take at least a few microseconds, such as
+// dispatching remote method invocations.
+//
+// The queue depth and the number of tasks executed and stolen by each worker
+// are available for tuning the number of workers and the choice of hints.
+//
+// Destroying the executor waits for the tasks already submitted to finish.
+class WorkStealingExecutor {
+ public:
+  using Task = std::function<void()>;
+
+  explicit WorkStealingExecutor(
+      std::size_t worker_count = std::thread::hardware_concurrency()) {
+    worker_count = std::max<std::size_t>(worker_count, 1);
+    for (std::size_t i = 0; i < worker_count; i++)
+      workers_.emplace_back(new Worker);
+    for (std::size_t i = 0; i < worker_count; i++)
+      workers_[i]->thread = std::thread{[this, i] { Run(i); }};
+  }
+
+  WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+  WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+  ~WorkStealingExecutor() {
+    {
+      std::lock_guard<std::mutex> lock{idle_mutex_};
+      stopping_ = true;
+    }
+    idle_.notify_all();
+
+    for (auto& worker : workers_)
+      worker->thread.join();
+  }
+
+  // Submits a task to the queue of the worker selected by |hint|.
+  void Submit(Task task, std::size_t hint) {
+    Worker& worker = *workers_[hint % workers_.size()];
+    {
+      // Counting the task while it is queued ensures that it is counted before
+      // the worker that takes it uncounts it.
+      std::lock_guard<std::mutex> idle_lock{idle_mutex_};
+      std::lock_guard<std::mutex> lock{worker.mutex};
+      worker.tasks.push_back(std::move(task));
+      worker.depth.store(worker.tasks.size(), std::memory_order_relaxed);
+      pending_++;
+    }
+    idle_.notify_one();
+  }
+
+  // Submits a task to the workers in turn.
+  void Submit(Task task) {
+    Submit(std::move(task), next_.fetch_add(1, std::memory_order_relaxed));
+  }
+
+  std::size_t worker_count() const { return workers_.size(); }
+
+  // Returns the number of tasks waiting in the queue of the given worker.
+  std::size_t queue_depth(std::size_t worker) const {
+    return workers_[worker]->depth.load(std::memory_order_relaxed);
+  }
+
+  // Returns the number of tasks the given worker has run, including the tasks
+  // it stole from other workers.
+  std::uint64_t executed(std::size_t worker) const {
+    return workers_[worker]->executed.load(std::memory_order_relaxed);
+  }
+
+  // Returns the number of tasks the given worker has stolen from other
+  // workers.
+  std::uint64_t stolen(std::size_t worker) const {
+    return workers_[worker]->stolen.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::atomic<std::size_t> depth{0};
+    std::atomic<std::uint64_t> executed{0};
+    std::atomic<std::uint64_t> stolen{0};
+    std::thread thread;
+  };
+
+  // Takes the task at the front of the given worker's queue when |front| is
+  // true, or at the back otherwise.
+  bool Take(Worker* worker, bool front, Task* task) {
+    std::lock_guard<std::mutex> lock{worker->mutex};
+    if (worker->tasks.empty())
+      return false;
+
+    if (front) {
+      *task = std::move(worker->tasks.front());
+      worker->tasks.pop_front();
+    } else {
+      *task = std::move(worker->tasks.back());
+      worker->tasks.pop_back();
+    }
+    worker->depth.store(worker->tasks.size(), std::memory_order_relaxed);
+    return true;
+  }
+
+  // Takes the next task from the queue of worker |index|, or steals one from
+  // the other workers, starting with the next worker.
+  bool Next(std::size_t index, Task* task) {
+    Worker* worker = workers_[index].get();
+    if (Take(worker, true, task))
+      return true;
+
+    for (std::size_t i = 1; i < workers_.size(); i++) {
+      Worker* victim = workers_[(index + i) % workers_.size()].get();
+      if (Take(victim, false, task)) {
+        worker->stolen.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void Run(std::size_t index) {
+    Worker* worker = workers_[index].get();
+    while (true) {
+      Task task;
+      if (Next(index, &task)) {
+        {
+          std::lock_guard<std::mutex> lock{idle_mutex_};
+          pending_--;
+        }
+        task();
+        worker->executed.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock{idle_mutex_};
+      idle_.wait(lock, [this] { return stopping_ || pending_ != 0; });
+      if (stopping_ && pending_ == 0)
+        return;
+    }
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<std::size_t> next_{0};
+
+  // The number of tasks submitted that have not been taken by a worker, which
+  // idle workers wait on.
+  std::mutex idle_mutex_;
+  std::condition_variable idle_;
+  std::size_t pending_{0};
+  bool stopping_{false};
+};
+
+}  // namespace nop
+
+#endif  // LIBNOP_INCLUDE_NOP_UTILITY_WORK_STEALING_EXECUTOR_H_
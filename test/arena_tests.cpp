@@ -0,0 +1,190 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/utility/arena.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::Arena;
+using nop::ArenaAllocator;
+using nop::ArenaMap;
+using nop::ArenaScope;
+using nop::ArenaString;
+using nop::ArenaVector;
+using nop::BufferReader;
+using nop::Deserializer;
+using nop::Serializer;
+using nop::VectorWriter;
+
+namespace {
+
+struct Shape {
+  std::string name;
+  std::vector<std::string> tags;
+  std::map<std::uint32_t, std::string> labels;
+  std::set<std::string> groups;
+  NOP_STRUCTURE(Shape, name, tags, labels, groups);
+};
+
+struct Scene {
+  std::string title;
+  std::vector<Shape> shapes;
+  NOP_STRUCTURE(Scene, title, shapes);
+};
+
+template <typename T>
+using ArenaSet = std::set<T, std::less<T>, ArenaAllocator<T>>;
+
+struct ArenaShape {
+  ArenaString name;
+  ArenaVector<ArenaString> tags;
+  ArenaMap<std::uint32_t, ArenaString> labels;
+  ArenaSet<ArenaString> groups;
+  NOP_STRUCTURE(ArenaShape, name, tags, labels, groups);
+};
+
+struct ArenaScene {
+  ArenaString title;
+  ArenaVector<ArenaShape> shapes;
+  NOP_STRUCTURE(ArenaScene, title, shapes);
+};
+
+Scene MakeScene() {
+  Shape shape{"a shape with a long name that is not inlined",
+              std::vector<std::string>(10, std::string(40, 't')),
+              {{1, std::string(50, 'l')}, {2, "label"}},
+              {"group one", "group two"}};
+  return {"scene", std::vector<Shape>(20, shape)};
+}
+
+std::vector<std::uint8_t> Encode(const Scene& scene) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(scene));
+  return serializer.writer().take();
+}
+
+}  // anonymous namespace
+
+TEST(Arena, Allocate) {
+  Arena arena{256};
+  EXPECT_EQ(0u, arena.capacity());
+
+  void* a = arena.Allocate(10, 1);
+  void* b = arena.Allocate(8, 8);
+  EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(b) % 8);
+  EXPECT_LE(static_cast<std::uint8_t*>(a) + 10, static_cast<std::uint8_t*>(b));
+  EXPECT_EQ(18u, arena.allocated());
+  EXPECT_EQ(256u, arena.capacity());
+
+  // Large allocations get their own blocks.
+  arena.Allocate(1000, 16);
+  EXPECT_EQ(256u + 1016u, arena.capacity());
+  arena.Allocate(200, 1);
+  EXPECT_EQ(2 * 256u + 1016u, arena.capacity());
+
+  // Blocks are reused after a reset.
+  arena.Reset();
+  EXPECT_EQ(0u, arena.allocated());
+  EXPECT_EQ(a, arena.Allocate(10, 1));
+  arena.Allocate(1000, 1);
+  arena.Allocate(200, 1);
+  EXPECT_EQ(2 * 256u + 1016u, arena.capacity());
+
+  arena.Clear();
+  EXPECT_EQ(0u, arena.capacity());
+}
+
+TEST(Arena, Deserialize) {
+  const Scene scene = MakeScene();
+  const auto encoding = Encode(scene);
+
+  Arena arena;
+  std::size_t capacity = 0;
+  for (int i = 0; i < 3; i++) {
+    {
+      ArenaScope scope{&arena};
+      ArenaScene arena_scene;
+      Deserializer<BufferReader> deserializer{encoding.data(),
+                                              encoding.size()};
+      ASSERT_TRUE(deserializer.Read(&arena_scene));
+
+      // Every nested container allocates from the arena.
+      ASSERT_EQ(scene.shapes.size(), arena_scene.shapes.size());
+      EXPECT_EQ(&arena, arena_scene.shapes.get_allocator().arena());
+      const ArenaShape& shape = arena_scene.shapes.back();
+      EXPECT_EQ(&arena, shape.name.get_allocator().arena());
+      EXPECT_EQ(&arena, shape.tags.back().get_allocator().arena());
+      EXPECT_EQ(&arena, shape.labels.get_allocator().arena());
+      EXPECT_STREQ(scene.shapes.back().name.c_str(), shape.name.c_str());
+      EXPECT_EQ(2u, shape.groups.size());
+      EXPECT_STREQ("label", shape.labels.at(2).c_str());
+      EXPECT_LT(0u, arena.allocated());
+
+      // Arena containers encode the same as the standard containers.
+      Serializer<VectorWriter> serializer;
+      ASSERT_TRUE(serializer.Write(arena_scene));
+      EXPECT_EQ(encoding, serializer.writer().buffer());
+    }
+
+    // The arena reaches a steady state after the first message.
+    if (i == 0)
+      capacity = arena.capacity();
+    EXPECT_EQ(capacity, arena.capacity());
+    arena.Reset();
+  }
+
+  // Outside of a scope arena containers use the heap.
+  ArenaString string(100, 's');
+  EXPECT_EQ(nullptr, string.get_allocator().arena());
+}
+
+TEST(Arena, DeserializeMapKeys) {
+  const std::string long_a(40, 'a');
+  const std::string long_b(40, 'b');
+  Serializer<VectorWriter> serializer;
+  ASSERT_TRUE(serializer.Write(std::map<std::string, std::string>{
+      {long_a, std::string(50, '1')}, {long_b, std::string(50, '2')}}));
+  const auto encoding = serializer.writer().take();
+
+  // Keys are decoded with the allocator of their map, so decoding under one
+  // arena leaves nothing behind that a decode under a later arena would use.
+  for (int i = 0; i < 2; i++) {
+    Arena arena;
+    ArenaScope scope{&arena};
+    ArenaMap<ArenaString, ArenaString> map;
+    for (int j = 0; j < 2; j++) {
+      Deserializer<BufferReader> deserializer{encoding.data(),
+                                              encoding.size()};
+      ASSERT_TRUE(deserializer.Read(&map));
+    }
+
+    ASSERT_EQ(2u, map.size());
+    for (const auto& entry : map) {
+      EXPECT_EQ(&arena, entry.first.get_allocator().arena());
+      EXPECT_EQ(&arena, entry.second.get_allocator().arena());
+    }
+    EXPECT_STREQ(long_b.c_str(), map.rbegin()->first.c_str());
+  }
+}
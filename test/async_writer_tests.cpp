@@ -0,0 +1,135 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/utility/async_writer.h>
+#include <nop/utility/buffer_writer.h>
+#include <nop/utility/fd_reader.h>
+#include <nop/utility/fd_writer.h>
+#include <nop/utility/stream_reader.h>
+#include <nop/utility/stream_writer.h>
+
+using nop::AsyncWriter;
+using nop::BufferWriter;
+using nop::Deserializer;
+using nop::ErrorStatus;
+using nop::FdReader;
+using nop::FdWriter;
+using nop::Serializer;
+using nop::Status;
+using nop::StreamReader;
+using nop::StreamWriter;
+
+TEST(AsyncWriterTests, Stream) {
+  using Writer = AsyncWriter<StreamWriter<std::stringstream>>;
+  Serializer<Writer> serializer{16u, 2u};
+  EXPECT_EQ(16u, serializer.writer().buffer_size());
+  EXPECT_EQ(2u, serializer.writer().buffer_count());
+
+  // Values larger than a buffer are split across buffers.
+  const std::string large(100, 'x');
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(serializer.Write(std::to_string(i)));
+    ASSERT_TRUE(serializer.Write(std::vector<int>{i, i + 1}));
+  }
+  ASSERT_TRUE(serializer.Write(large));
+  ASSERT_TRUE(serializer.writer().Drain());
+
+  Deserializer<StreamReader<std::stringstream>> deserializer{
+      serializer.writer().writer().stream().str()};
+  for (int i = 0; i < 100; i++) {
+    std::string string_value;
+    std::vector<int> vector_value;
+    ASSERT_TRUE(deserializer.Read(&string_value));
+    ASSERT_TRUE(deserializer.Read(&vector_value));
+    EXPECT_EQ(std::to_string(i), string_value);
+    EXPECT_EQ((std::vector<int>{i, i + 1}), vector_value);
+  }
+
+  std::string large_value;
+  ASSERT_TRUE(deserializer.Read(&large_value));
+  EXPECT_EQ(large, large_value);
+}
+
+TEST(AsyncWriterTests, Pipe) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+
+  // The reader runs concurrently, so the pipe never fills up for long.
+  std::vector<std::uint64_t> values;
+  std::thread reader{[&values, fd = fds[0]] {
+    Deserializer<FdReader> deserializer{fd};
+    std::uint64_t value;
+    while (deserializer.Read(&value))
+      values.push_back(value);
+  }};
+
+  {
+    // The destructor drains the adapter before closing the write end.
+    Serializer<AsyncWriter<FdWriter>> serializer{64u, 3u, fds[1]};
+    for (std::uint64_t i = 0; i < 10000; i++)
+      ASSERT_TRUE(serializer.Write(i * 0x10001));
+    ASSERT_TRUE(serializer.writer().Flush());
+  }
+  reader.join();
+
+  ASSERT_EQ(10000u, values.size());
+  for (std::uint64_t i = 0; i < values.size(); i++)
+    EXPECT_EQ(i * 0x10001, values[i]);
+}
+
+TEST(AsyncWriterTests, External) {
+  StreamWriter<std::stringstream> stream_writer;
+  {
+    AsyncWriter<StreamWriter<std::stringstream>*> writer{4, 1, &stream_writer};
+    Serializer<decltype(writer)*> serializer{&writer};
+    ASSERT_TRUE(serializer.Write(std::string{"external"}));
+  }
+
+  Deserializer<StreamReader<std::stringstream>> deserializer{
+      stream_writer.stream().str()};
+  std::string value;
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ("external", value);
+}
+
+TEST(AsyncWriterTests, Error) {
+  std::uint8_t buffer[16];
+  Serializer<AsyncWriter<BufferWriter>> serializer{8u, 2u, buffer,
+                                                   sizeof(buffer)};
+
+  // The first values fit in the wrapped writer.
+  ASSERT_TRUE(serializer.Write(std::string{"012345"}));
+  ASSERT_TRUE(serializer.writer().Drain());
+  EXPECT_EQ(8u, serializer.writer().writer().size());
+
+  // Writing past the end fails in the background and the error sticks.
+  serializer.Write(std::string{"0123456789abcdef"});
+  Status<void> status = serializer.writer().Drain();
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::WriteLimitReached, status.error());
+
+  status = serializer.Write(1);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::WriteLimitReached, status.error());
+}
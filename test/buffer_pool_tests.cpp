@@ -0,0 +1,122 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/utility/buffer_pool.h>
+#include <nop/utility/buffer_reader.h>
+
+using nop::BufferPool;
+using nop::Deserializer;
+using nop::PooledSerializer;
+using nop::ThreadLocalBufferPool;
+
+TEST(BufferPool, AcquireRelease) {
+  BufferPool pool{2, 4096};
+
+  // New buffers are rounded up to a size class.
+  BufferPool::BufferType buffer = pool.Acquire();
+  EXPECT_LE(256u, buffer.capacity());
+  buffer = pool.Acquire(1000);
+  EXPECT_LE(1024u, buffer.capacity());
+  EXPECT_EQ(0u, pool.size());
+
+  // Released buffers are reused by requests that fit in them.
+  buffer.assign(10, 0xff);
+  const std::uint8_t* data = buffer.data();
+  pool.Release(std::move(buffer));
+  EXPECT_EQ(1u, pool.size());
+
+  buffer = pool.Acquire(2000);
+  EXPECT_NE(data, buffer.data());
+  EXPECT_EQ(1u, pool.size());
+
+  buffer = pool.Acquire(300);
+  EXPECT_EQ(data, buffer.data());
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ(0u, pool.size());
+
+  // Size classes keep a limited number of buffers.
+  for (int i = 0; i < 3; i++)
+    pool.Release(pool.Acquire(600));
+  EXPECT_EQ(1u, pool.size());
+  std::vector<BufferPool::BufferType> buffers;
+  for (int i = 0; i < 3; i++)
+    buffers.push_back(pool.Acquire(600));
+  for (auto& released : buffers)
+    pool.Release(std::move(released));
+  EXPECT_EQ(2u, pool.size());
+
+  // Buffers that are too small or too large are freed.
+  pool.Clear();
+  pool.Release(BufferPool::BufferType(16));
+  BufferPool::BufferType large;
+  large.reserve(8192);
+  pool.Release(std::move(large));
+  EXPECT_EQ(0u, pool.size());
+}
+
+TEST(PooledSerializer, Write) {
+  BufferPool pool;
+  const std::uint8_t* data = nullptr;
+  {
+    PooledSerializer serializer{&pool};
+    ASSERT_TRUE(serializer.Write(std::string(1000, 'x')));
+    data = serializer.writer().data();
+
+    Deserializer<nop::BufferReader> deserializer{serializer.writer().data(),
+                                                 serializer.writer().size()};
+    std::string value;
+    ASSERT_TRUE(deserializer.Read(&value));
+    EXPECT_EQ(std::string(1000, 'x'), value);
+  }
+  EXPECT_EQ(1u, pool.size());
+
+  // The next serializer reuses the buffer.
+  {
+    PooledSerializer serializer{&pool, 500};
+    EXPECT_EQ(0u, pool.size());
+    EXPECT_EQ(0u, serializer.writer().size());
+    ASSERT_TRUE(serializer.Write(std::string(500, 'y')));
+    EXPECT_EQ(data, serializer.writer().data());
+
+    // Buffers moved out of the writer are not returned.
+    serializer.writer().take();
+  }
+  EXPECT_EQ(0u, pool.size());
+}
+
+TEST(PooledSerializer, ThreadLocal) {
+  ThreadLocalBufferPool().Clear();
+  { PooledSerializer serializer{}; }
+  EXPECT_EQ(1u, ThreadLocalBufferPool().size());
+
+  // Each thread has a pool of its own.
+  std::size_t other_size = 0;
+  std::thread thread{[&other_size] {
+    { PooledSerializer serializer{}; }
+    { PooledSerializer serializer{}; }
+    other_size = ThreadLocalBufferPool().size();
+  }};
+  thread.join();
+  EXPECT_EQ(1u, other_size);
+  EXPECT_EQ(1u, ThreadLocalBufferPool().size());
+  ThreadLocalBufferPool().Clear();
+}
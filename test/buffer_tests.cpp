@@ -0,0 +1,1238 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/traits/is_detected.h>
+#include <nop/traits/is_fungible.h>
+#include <nop/types/optional.h>
+#include <nop/types/variant.h>
+#include <nop/types/view.h>
+#include <nop/utility/array_index.h>
+#include <nop/utility/bounded_reader.h>
+#include <nop/utility/bounded_writer.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/buffer_writer.h>
+#include <nop/utility/checksum_reader.h>
+#include <nop/utility/checksum_writer.h>
+#include <nop/utility/crc32c.h>
+#include <nop/utility/parallel_serializer.h>
+#include <nop/utility/pedantic_buffer_reader.h>
+#include <nop/utility/pedantic_buffer_writer.h>
+#include <nop/utility/stream_reader.h>
+#include <nop/utility/stream_writer.h>
+#include <nop/utility/trusted_buffer_reader.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::ArrayIndex;
+using nop::ArrayView;
+using nop::BasicVectorWriter;
+using nop::BufferReader;
+using nop::BufferWriter;
+using nop::BoundedReader;
+using nop::BoundedReaderScope;
+using nop::BoundedWriter;
+using nop::BoundedWriterScope;
+using nop::ChecksumReader;
+using nop::ChecksumWriter;
+using nop::Crc32c;
+using nop::Deserializer;
+using nop::EncodingByte;
+using nop::Entry;
+using nop::ErrorStatus;
+using nop::IsDetected;
+using nop::IsFungible;
+using nop::IsReservingWriter;
+using nop::MaxEncodedSize;
+using nop::MaxEncodingSize;
+using nop::Optional;
+using nop::ParallelDeserializer;
+using nop::ParallelSerializer;
+using nop::PedanticBufferReader;
+using nop::PedanticBufferWriter;
+using nop::ReserveCount;
+using nop::Serializer;
+using nop::Status;
+using nop::StreamReader;
+using nop::StreamWriter;
+using nop::StringView;
+using nop::TrustedBufferReader;
+using nop::Variant;
+using nop::VectorWriter;
+
+namespace {
+
+struct TestMessage {
+  std::uint32_t id;
+  std::string name;
+  std::vector<std::int16_t> values;
+  NOP_STRUCTURE(TestMessage, id, name, values);
+};
+
+struct ViewMessage {
+  StringView name;
+  ArrayView<std::uint8_t> blob;
+  NOP_STRUCTURE(ViewMessage, name, blob);
+};
+
+struct OwningMessage {
+  std::string name;
+  std::vector<std::uint8_t> blob;
+  NOP_STRUCTURE(OwningMessage, name, blob);
+};
+
+struct Sloppy {
+  std::uint32_t value;
+};
+
+struct RawPoint {
+  float x;
+  float y;
+  NOP_RAW_STRUCTURE(RawPoint, x, y);
+};
+
+struct BoundedMessage {
+  std::uint32_t id;
+  std::int16_t delta;
+  float weight;
+  bool flag;
+  std::array<std::uint8_t, 4> tag;
+  NOP_STRUCTURE(BoundedMessage, id, delta, weight, flag, tag);
+};
+
+enum class Mode : std::uint8_t { Idle, Run };
+
+struct ControlSample {
+  Mode mode;
+  Variant<std::int32_t, double> setpoint;
+  Optional<std::uint16_t> fault;
+  std::int16_t samples[4];
+  std::uint8_t sample_count;
+  NOP_STRUCTURE(ControlSample, mode, setpoint, fault,
+                (samples, sample_count));
+};
+
+template <typename T>
+using MaxEncodedSizeTest = decltype(MaxEncodedSize<T>::value);
+
+struct RawMessage {
+  RawPoint origin;
+  std::vector<RawPoint> points;
+  NOP_STRUCTURE(RawMessage, origin, points);
+};
+
+struct ViewTable {
+  Entry<StringView, 0> name;
+  NOP_TABLE(ViewTable, name);
+};
+
+struct InnerTable {
+  Entry<int, 0> value;
+  Entry<std::vector<std::string>, 1> names;
+  NOP_TABLE_HASH(1, InnerTable, value, names);
+};
+
+struct OuterTable {
+  Entry<InnerTable, 0> inner;
+  Entry<std::uint32_t, 1> id;
+  NOP_TABLE_HASH(2, OuterTable, inner, id);
+};
+
+// InnerTable under another name, and so another hash.
+struct RenamedTable {
+  Entry<int, 0> value;
+  Entry<std::vector<std::string>, 1> names;
+  NOP_TABLE_HASH(3, RenamedTable, value, names);
+};
+
+// OuterTable with the renamed inner table.
+struct RenamedOuterTable {
+  Entry<RenamedTable, 0> inner;
+  Entry<std::uint32_t, 1> id;
+  NOP_TABLE_HASH(2, RenamedOuterTable, inner, id);
+};
+
+// Prefix of the members of TestMessage.
+struct TestMessageHeader {
+  std::uint32_t id;
+  std::string name;
+  NOP_STRUCTURE(TestMessageHeader, id, name);
+};
+
+// Allocator that counts the number of allocations made through it.
+template <typename T>
+struct CountingAllocator : std::allocator<T> {
+  template <typename U>
+  struct rebind {
+    using other = CountingAllocator<U>;
+  };
+
+  CountingAllocator(std::size_t* count) : count{count} {}
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U>& other) : count{other.count} {}
+
+  T* allocate(std::size_t n) {
+    ++*count;
+    return std::allocator<T>::allocate(n);
+  }
+
+  std::size_t* count;
+};
+
+}  // anonymous namespace
+
+namespace nop {
+
+// An encoding that overestimates its size by one byte, like handles do.
+template <>
+struct Encoding<Sloppy> : EncodingIO<Sloppy> {
+  static constexpr EncodingByte Prefix(const Sloppy& value) {
+    return Encoding<std::uint32_t>::Prefix(value.value);
+  }
+
+  static constexpr std::size_t Size(const Sloppy& value) {
+    return Encoding<std::uint32_t>::Size(value.value) + 1;
+  }
+
+  static constexpr bool Match(EncodingByte prefix) {
+    return Encoding<std::uint32_t>::Match(prefix);
+  }
+
+  template <typename Writer>
+  static constexpr Status<void> WritePayload(EncodingByte prefix,
+                                             const Sloppy& value,
+                                             Writer* writer) {
+    return Encoding<std::uint32_t>::WritePayload(prefix, value.value, writer);
+  }
+
+  template <typename Reader>
+  static constexpr Status<void> ReadPayload(EncodingByte prefix, Sloppy* value,
+                                            Reader* reader) {
+    return Encoding<std::uint32_t>::ReadPayload(prefix, &value->value, reader);
+  }
+};
+
+}  // namespace nop
+
+TEST(VectorWriter, Write) {
+  Serializer<VectorWriter> serializer;
+  const TestMessage message{10, "foo", {1, 2, 3}};
+
+  ASSERT_TRUE(serializer.Write(message));
+  EXPECT_EQ(serializer.GetSize(message), serializer.writer().size());
+  EXPECT_LE(serializer.writer().size(), serializer.writer().capacity());
+
+  Deserializer<BufferReader> deserializer{serializer.writer().data(),
+                                          serializer.writer().size()};
+  TestMessage read_message;
+  ASSERT_TRUE(deserializer.Read(&read_message));
+  EXPECT_EQ(10u, read_message.id);
+  EXPECT_EQ("foo", read_message.name);
+  EXPECT_EQ((std::vector<std::int16_t>{1, 2, 3}), read_message.values);
+}
+
+TEST(VectorWriter, TakeAndReset) {
+  Serializer<VectorWriter> serializer;
+
+  ASSERT_TRUE(serializer.Write(std::string(100, 'x')));
+  const std::uint8_t* data = serializer.writer().data();
+
+  // Taking the buffer does not copy it.
+  std::vector<std::uint8_t> buffer = serializer.writer().take();
+  EXPECT_EQ(data, buffer.data());
+  EXPECT_EQ(102u, buffer.size());
+  EXPECT_EQ(0u, serializer.writer().size());
+
+  // Reset keeps the capacity so that subsequent writes don't reallocate.
+  ASSERT_TRUE(serializer.Write(std::string(100, 'x')));
+  const std::size_t capacity = serializer.writer().capacity();
+  data = serializer.writer().data();
+  serializer.writer().reset();
+  EXPECT_EQ(0u, serializer.writer().size());
+  EXPECT_EQ(capacity, serializer.writer().capacity());
+
+  ASSERT_TRUE(serializer.Write(std::string(50, 'y')));
+  EXPECT_EQ(data, serializer.writer().data());
+  EXPECT_EQ(52u, serializer.writer().size());
+}
+
+TEST(VectorWriter, Allocator) {
+  using Writer = BasicVectorWriter<CountingAllocator<std::uint8_t>>;
+
+  std::size_t count = 0;
+  Serializer<Writer> serializer{CountingAllocator<std::uint8_t>{&count}};
+
+  // Each write grows the buffer with at most one allocation.
+  ASSERT_TRUE(serializer.Write(TestMessage{1, "bar", {1, 2, 3, 4}}));
+  EXPECT_EQ(1u, count);
+
+  // Steady state after reset does not allocate.
+  for (int i = 0; i < 10; i++) {
+    serializer.writer().reset();
+    ASSERT_TRUE(serializer.Write(TestMessage{1, "bar", {1, 2, 3, 4}}));
+  }
+  EXPECT_EQ(1u, count);
+}
+
+TEST(VectorWriter, Table) {
+  Serializer<VectorWriter> serializer;
+
+  // Entry sizes are patched into fixed-width slots after writing each value.
+  InnerTable inner;
+  inner.value = 5;
+  ASSERT_TRUE(serializer.Write(inner));
+
+  const auto u32 = static_cast<std::uint8_t>(EncodingByte::U32);
+  const std::vector<std::uint8_t> expected{
+      static_cast<std::uint8_t>(EncodingByte::Table), 1, 1, 0, u32, 1, 0, 0, 0,
+      5};
+  EXPECT_EQ(expected, serializer.writer().buffer());
+  serializer.writer().reset();
+
+  // Nested tables read back the same as tables written in two passes.
+  OuterTable outer;
+  outer.inner = InnerTable{};
+  outer.inner.get().value = -1000;
+  outer.inner.get().names = std::vector<std::string>{"a", "bc", "def"};
+  outer.id = 1u << 31;
+  ASSERT_TRUE(serializer.Write(outer));
+
+  Deserializer<PedanticBufferReader> deserializer{serializer.writer().data(),
+                                                  serializer.writer().size()};
+  OuterTable read_outer;
+  ASSERT_TRUE(deserializer.Read(&read_outer));
+  EXPECT_TRUE(deserializer.reader().empty());
+  ASSERT_TRUE(read_outer.inner);
+  EXPECT_EQ(-1000, read_outer.inner.get().value.get());
+  EXPECT_EQ((std::vector<std::string>{"a", "bc", "def"}),
+            read_outer.inner.get().names.get());
+  EXPECT_EQ(1u << 31, read_outer.id.get());
+}
+
+TEST(BufferReader, Views) {
+  const std::vector<std::uint8_t> blob{1, 2, 3, 4, 5};
+  const ViewMessage message{"hello", blob};
+
+  Serializer<VectorWriter> serializer;
+  ASSERT_TRUE(serializer.Write(message));
+
+  // Views encode the same as the owning types.
+  Serializer<VectorWriter> expected_serializer;
+  ASSERT_TRUE(expected_serializer.Write(OwningMessage{"hello", blob}));
+  EXPECT_EQ(expected_serializer.writer().buffer(),
+            serializer.writer().buffer());
+
+  const std::vector<std::uint8_t> buffer = serializer.writer().take();
+  const std::uint8_t* begin = buffer.data();
+  const std::uint8_t* end = begin + buffer.size();
+
+  Deserializer<BufferReader> deserializer{buffer.data(), buffer.size()};
+  ViewMessage read_message;
+  ASSERT_TRUE(deserializer.Read(&read_message));
+  EXPECT_EQ(StringView{"hello"}, read_message.name);
+  EXPECT_EQ(ArrayView<std::uint8_t>{blob}, read_message.blob);
+
+  // The views point into the input buffer.
+  EXPECT_LE(begin, reinterpret_cast<const std::uint8_t*>(
+                       read_message.name.data()));
+  EXPECT_GT(end, reinterpret_cast<const std::uint8_t*>(
+                     read_message.name.data()));
+  EXPECT_LE(begin, read_message.blob.data());
+  EXPECT_GT(end, read_message.blob.data());
+  EXPECT_TRUE(deserializer.reader().empty());
+
+  // Views work through bounded readers, such as those used by tables.
+  ViewTable table;
+  table.name = StringView{"table"};
+  ASSERT_TRUE(serializer.Write(table));
+
+  Deserializer<PedanticBufferReader> table_deserializer{
+      serializer.writer().data(), serializer.writer().size()};
+  ViewTable read_table;
+  ASSERT_TRUE(table_deserializer.Read(&read_table));
+  EXPECT_EQ(StringView{"table"}, read_table.name.get());
+
+  // Views may not extend past the end of the input.
+  Deserializer<BufferReader> short_deserializer{buffer.data(),
+                                                buffer.size() - 1};
+  EXPECT_EQ(ErrorStatus::ReadLimitReached,
+            short_deserializer.Read(&read_message).error());
+
+  EXPECT_TRUE((IsFungible<StringView, std::string>::value));
+  EXPECT_TRUE((IsFungible<ArrayView<std::uint8_t>,
+                          std::vector<std::uint8_t>>::value));
+  EXPECT_TRUE((IsFungible<ViewMessage, OwningMessage>::value));
+  EXPECT_FALSE((IsFungible<ArrayView<std::uint8_t>,
+                           std::vector<std::int8_t>>::value));
+}
+
+TEST(BufferReader, RawStructure) {
+  Serializer<VectorWriter> serializer;
+  const RawMessage message{{1.0f, 2.0f}, {{3.0f, 4.0f}, {5.0f, 6.0f}}};
+
+  ASSERT_TRUE(serializer.Write(message));
+  EXPECT_EQ(serializer.GetSize(message), serializer.writer().size());
+
+  Deserializer<BufferReader> deserializer{serializer.writer().data(),
+                                          serializer.writer().size()};
+  RawMessage read_message;
+  ASSERT_TRUE(deserializer.Read(&read_message));
+  EXPECT_EQ(1.0f, read_message.origin.x);
+  EXPECT_EQ(2.0f, read_message.origin.y);
+  ASSERT_EQ(2u, read_message.points.size());
+  EXPECT_EQ(5.0f, read_message.points[1].x);
+  EXPECT_EQ(6.0f, read_message.points[1].y);
+
+  // The safe readers accept raw structures the same way.
+  Deserializer<PedanticBufferReader> pedantic_deserializer{
+      serializer.writer().data(), serializer.writer().size() - 1};
+  EXPECT_FALSE(pedantic_deserializer.Read(&read_message));
+}
+
+TEST(BufferReader, BoundedStructure) {
+  EXPECT_TRUE(MaxEncodingSize<BoundedMessage>::value);
+  EXPECT_EQ(38u, MaxEncodingSize<BoundedMessage>::Size);
+  EXPECT_FALSE(MaxEncodingSize<TestMessage>::value);
+
+  Serializer<VectorWriter> serializer;
+  const BoundedMessage message{10, -2, 0.5f, true, {{1, 2, 3, 4}}};
+  ASSERT_TRUE(serializer.Write(message));
+  const std::size_t size = serializer.writer().size();
+  ASSERT_GT(MaxEncodingSize<BoundedMessage>::Size, size);
+
+  // With room for the largest encoding the members are read with one bounds
+  // check, consuming exactly the encoded bytes.
+  std::vector<std::uint8_t> padded{serializer.writer().data(),
+                                   serializer.writer().data() + size};
+  padded.resize(MaxEncodingSize<BoundedMessage>::Size);
+  {
+    Deserializer<PedanticBufferReader> deserializer{padded.data(),
+                                                    padded.size()};
+    BoundedMessage read_message;
+    ASSERT_TRUE(deserializer.Read(&read_message));
+    EXPECT_EQ(10u, read_message.id);
+    EXPECT_EQ(-2, read_message.delta);
+    EXPECT_EQ(0.5f, read_message.weight);
+    EXPECT_TRUE(read_message.flag);
+    EXPECT_EQ((std::array<std::uint8_t, 4>{{1, 2, 3, 4}}), read_message.tag);
+    EXPECT_EQ(padded.size() - size, deserializer.reader().remaining());
+  }
+
+  // Otherwise the members are read with the usual checks.
+  {
+    Deserializer<PedanticBufferReader> deserializer{serializer.writer().data(),
+                                                    size};
+    BoundedMessage read_message;
+    ASSERT_TRUE(deserializer.Read(&read_message));
+    EXPECT_EQ(10u, read_message.id);
+    EXPECT_TRUE(deserializer.reader().empty());
+  }
+  {
+    Deserializer<PedanticBufferReader> deserializer{serializer.writer().data(),
+                                                    size - 1};
+    BoundedMessage read_message;
+    auto status = deserializer.Read(&read_message);
+    ASSERT_FALSE(status);
+    EXPECT_EQ(ErrorStatus::ReadLimitReached, status.error());
+  }
+
+  // Bounded readers over contiguous input are checked once as well.
+  {
+    PedanticBufferReader reader{padded.data(), padded.size()};
+    BoundedReader<PedanticBufferReader> bounded_reader{&reader, padded.size()};
+    BoundedMessage read_message;
+    ASSERT_TRUE(nop::Encoding<BoundedMessage>::Read(&read_message,
+                                                    &bounded_reader));
+    EXPECT_EQ(10u, read_message.id);
+    EXPECT_EQ(size, bounded_reader.size());
+  }
+}
+
+TEST(BufferReader, BoundedElements) {
+  Serializer<VectorWriter> serializer;
+  const std::vector<BoundedMessage> messages{
+      {10, -2, 0.5f, true, {{1, 2, 3, 4}}},
+      {11, 3, 1.5f, false, {{5, 6, 7, 8}}},
+      {12, -4, 2.5f, true, {{9, 10, 11, 12}}}};
+  ASSERT_TRUE(serializer.Write(messages));
+  const std::size_t size = serializer.writer().size();
+  ASSERT_GT(messages.size() * MaxEncodingSize<BoundedMessage>::Size, size);
+
+  // With room for the largest encoding of every element the elements are read
+  // with one bounds check, consuming exactly the encoded bytes.
+  std::vector<std::uint8_t> padded{serializer.writer().data(),
+                                   serializer.writer().data() + size};
+  padded.resize(size + messages.size() * MaxEncodingSize<BoundedMessage>::Size);
+  {
+    Deserializer<PedanticBufferReader> deserializer{padded.data(),
+                                                    padded.size()};
+    std::vector<BoundedMessage> read_messages;
+    ASSERT_TRUE(deserializer.Read(&read_messages));
+    ASSERT_EQ(3u, read_messages.size());
+    EXPECT_EQ(12u, read_messages[2].id);
+    EXPECT_EQ((std::array<std::uint8_t, 4>{{5, 6, 7, 8}}),
+              read_messages[1].tag);
+    EXPECT_EQ(padded.size() - size, deserializer.reader().remaining());
+  }
+
+  // Invalid elements are still rejected.
+  {
+    std::vector<std::uint8_t> invalid = padded;
+    const std::size_t last =
+        size - nop::Encoding<BoundedMessage>::Size(messages[2]);
+    invalid[last] = static_cast<std::uint8_t>(EncodingByte::String);
+    Deserializer<PedanticBufferReader> deserializer{invalid.data(),
+                                                    invalid.size()};
+    std::vector<BoundedMessage> read_messages;
+    EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+              deserializer.Read(&read_messages).error());
+    EXPECT_EQ(2u, read_messages.size());
+  }
+
+  // Otherwise the elements are read with the usual checks.
+  {
+    Deserializer<PedanticBufferReader> deserializer{serializer.writer().data(),
+                                                    size};
+    std::vector<BoundedMessage> read_messages;
+    ASSERT_TRUE(deserializer.Read(&read_messages));
+    ASSERT_EQ(3u, read_messages.size());
+    EXPECT_EQ(12u, read_messages[2].id);
+    EXPECT_TRUE(deserializer.reader().empty());
+  }
+  {
+    Deserializer<PedanticBufferReader> deserializer{serializer.writer().data(),
+                                                    size - 1};
+    std::vector<BoundedMessage> read_messages;
+    EXPECT_EQ(ErrorStatus::ReadLimitReached,
+              deserializer.Read(&read_messages).error());
+  }
+}
+
+TEST(BufferWriter, MaxEncodedSize) {
+  EXPECT_EQ(2u, MaxEncodedSize<Mode>::value);
+  EXPECT_EQ(15u, (MaxEncodedSize<Variant<std::int32_t, double>>::value));
+  EXPECT_EQ(3u, MaxEncodedSize<Optional<std::uint16_t>>::value);
+  EXPECT_EQ(7u, MaxEncodedSize<Optional<Variant<>>>::value);
+  EXPECT_EQ(18u, (MaxEncodedSize<std::int16_t[4]>::value));
+  EXPECT_EQ(41u, MaxEncodedSize<ControlSample>::value);
+
+  EXPECT_FALSE((IsDetected<MaxEncodedSizeTest, std::string>::value));
+  EXPECT_FALSE((IsDetected<MaxEncodedSizeTest, TestMessage>::value));
+  EXPECT_FALSE(
+      (IsDetected<MaxEncodedSizeTest, Variant<int, std::string>>::value));
+  EXPECT_FALSE(
+      (IsDetected<MaxEncodedSizeTest, Optional<std::vector<int>>>::value));
+
+  // A stack buffer of the maximum size holds any value of the type.
+  ControlSample sample{Mode::Run, {}, 7u, {1, 2, 3, 0}, 3};
+  sample.setpoint = -1.0;
+  std::uint8_t buffer[MaxEncodedSize<ControlSample>::value];
+  Serializer<BufferWriter> serializer{buffer, sizeof(buffer)};
+  ASSERT_TRUE(serializer.Write(sample));
+
+  ControlSample read_sample;
+  Deserializer<BufferReader> deserializer{buffer,
+                                          serializer.writer().size()};
+  ASSERT_TRUE(deserializer.Read(&read_sample));
+  EXPECT_EQ(Mode::Run, read_sample.mode);
+  ASSERT_TRUE(read_sample.setpoint.is<double>());
+  EXPECT_EQ(-1.0, *read_sample.setpoint.get<double>());
+  ASSERT_TRUE(read_sample.fault);
+  EXPECT_EQ(7u, read_sample.fault.get());
+  EXPECT_EQ(3u, read_sample.sample_count);
+  EXPECT_EQ(3, read_sample.samples[2]);
+}
+
+TEST(PedanticBufferWriter, Reserve) {
+  EXPECT_TRUE(IsReservingWriter<PedanticBufferWriter>::value);
+  EXPECT_TRUE(IsReservingWriter<VectorWriter>::value);
+  EXPECT_TRUE(IsReservingWriter<BoundedWriter<VectorWriter>>::value);
+  EXPECT_FALSE(IsReservingWriter<StreamWriter<std::stringstream>>::value);
+  EXPECT_FALSE(
+      IsReservingWriter<BoundedWriter<StreamWriter<std::stringstream>>>::value);
+
+  // Small values encode in fewer bytes than the reserved maximum.
+  const BoundedMessage message{1, -2, 0.5f, true, {{1, 2, 3, 4}}};
+  std::uint8_t expected[MaxEncodingSize<BoundedMessage>::Size];
+  Serializer<BufferWriter> serializer{expected, sizeof(expected)};
+  ASSERT_TRUE(serializer.Write(message));
+  const std::size_t size = serializer.writer().size();
+  ASSERT_GT(sizeof(expected), size);
+
+  // Reserved writes produce the same encoding.
+  std::uint8_t buffer[sizeof(expected)] = {};
+  Serializer<PedanticBufferWriter> pedantic{buffer, sizeof(buffer)};
+  ASSERT_TRUE(pedantic.Write(message));
+  ASSERT_EQ(size, pedantic.writer().size());
+  EXPECT_EQ(0, std::memcmp(expected, buffer, size));
+
+  Serializer<VectorWriter> vector;
+  ASSERT_TRUE(vector.Write(message));
+  ASSERT_EQ(size, vector.writer().size());
+  EXPECT_EQ(0, std::memcmp(expected, vector.writer().data(), size));
+
+  // Output too small for the maximum falls back to checked writes.
+  Serializer<PedanticBufferWriter> exact{buffer, size};
+  ASSERT_TRUE(exact.Write(message));
+  EXPECT_EQ(size, exact.writer().size());
+  EXPECT_EQ(0, std::memcmp(expected, buffer, size));
+
+  Serializer<PedanticBufferWriter> short_buffer{buffer, size - 1};
+  EXPECT_EQ(ErrorStatus::WriteLimitReached,
+            short_buffer.Write(message).error());
+
+  VectorWriter vector_writer;
+  BoundedWriter<VectorWriter> bounded_writer{&vector_writer, size};
+  Serializer<BoundedWriter<VectorWriter>*> bounded{&bounded_writer};
+  ASSERT_TRUE(bounded.Write(message));
+  EXPECT_EQ(size, bounded_writer.size());
+  ASSERT_EQ(size, vector_writer.size());
+  EXPECT_EQ(0, std::memcmp(expected, vector_writer.data(), size));
+
+  vector_writer.reset();
+  bounded_writer = BoundedWriter<VectorWriter>{&vector_writer, size - 1};
+  EXPECT_EQ(ErrorStatus::WriteLimitReached, bounded.Write(message).error());
+}
+
+TEST(BufferReader, ReserveOnRead) {
+  using Strings = std::vector<std::string, CountingAllocator<std::string>>;
+
+  Serializer<VectorWriter> serializer;
+  ASSERT_TRUE(serializer.Write(std::vector<std::string>(1000, "abc")));
+
+  // Reading the vector reserves storage for all of the elements at once.
+  std::size_t count = 0;
+  Strings strings{CountingAllocator<std::string>{&count}};
+  Deserializer<BufferReader> deserializer{serializer.writer().data(),
+                                          serializer.writer().size()};
+  ASSERT_TRUE(deserializer.Read(&strings));
+  EXPECT_EQ(1000u, strings.size());
+  EXPECT_EQ(1u, count);
+
+  std::unordered_map<int, std::string> map;
+  for (int i = 0; i < 100; i++)
+    map[i] = std::to_string(i);
+
+  serializer.writer().reset();
+  ASSERT_TRUE(serializer.Write(map));
+  Deserializer<BufferReader> map_deserializer{serializer.writer().data(),
+                                              serializer.writer().size()};
+  std::unordered_map<int, std::string> read_map;
+  ASSERT_TRUE(map_deserializer.Read(&read_map));
+  EXPECT_EQ(map, read_map);
+
+  // Abusive element counts only reserve up to the bytes remaining.
+  const std::uint8_t abusive[] = {
+      static_cast<std::uint8_t>(EncodingByte::Array),
+      static_cast<std::uint8_t>(EncodingByte::U32), 0xff, 0xff, 0xff, 0x7f,
+      static_cast<std::uint8_t>(EncodingByte::String), 0};
+  Deserializer<PedanticBufferReader> abusive_deserializer{abusive,
+                                                          sizeof(abusive)};
+  std::vector<std::string> abused;
+  EXPECT_EQ(ErrorStatus::ReadLimitReached,
+            abusive_deserializer.Read(&abused).error());
+  EXPECT_GE(2u, abused.capacity());
+}
+
+TEST(BufferReader, ReserveCount) {
+  const std::uint8_t buffer[16] = {};
+  BufferReader reader{buffer, sizeof(buffer)};
+  EXPECT_EQ(10u, ReserveCount(10, &reader));
+  EXPECT_EQ(16u, ReserveCount(1000, &reader));
+
+  BoundedReader<BufferReader> bounded_reader{&reader, 4};
+  EXPECT_EQ(4u, ReserveCount(1000, &bounded_reader));
+  ASSERT_TRUE(reader.Skip(14));
+  EXPECT_EQ(2u, ReserveCount(1000, &bounded_reader));
+
+  BoundedReader<BoundedReader<BufferReader>> nested_reader{&bounded_reader, 4};
+  EXPECT_EQ(2u, ReserveCount(1000, &nested_reader));
+}
+
+TEST(BoundedReaderScope, Nested) {
+  const std::uint8_t buffer[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  BufferReader reader{buffer, sizeof(buffer)};
+  BoundedReader<BufferReader> bounded_reader{&reader, 6};
+
+  std::uint8_t byte = 0;
+  ASSERT_TRUE(bounded_reader.Read(&byte));
+  EXPECT_EQ(1u, byte);
+
+  {
+    // Nested regions narrow the limit of the enclosing reader.
+    BoundedReaderScope<BoundedReader<BufferReader>> scope{&bounded_reader, 3};
+    ASSERT_TRUE(scope.status());
+    EXPECT_EQ(&bounded_reader, scope.reader());
+
+    ASSERT_TRUE(scope.reader()->Read(&byte));
+    EXPECT_EQ(2u, byte);
+    EXPECT_EQ(ErrorStatus::ReadLimitReached, scope.reader()->Skip(3).error());
+    ASSERT_TRUE(scope.ReadPadding());
+  }
+
+  // The enclosing limit is restored after the padding of the region.
+  EXPECT_EQ(4u, bounded_reader.size());
+  EXPECT_EQ(6u, bounded_reader.capacity());
+  ASSERT_TRUE(bounded_reader.Read(&byte));
+  EXPECT_EQ(5u, byte);
+
+  {
+    BoundedReaderScope<BoundedReader<BufferReader>> scope{&bounded_reader, 2};
+    EXPECT_EQ(ErrorStatus::ReadLimitReached, scope.status().error());
+  }
+
+  {
+    BoundedReaderScope<BufferReader> scope{&reader, 3};
+    ASSERT_TRUE(scope.status());
+    ASSERT_TRUE(scope.reader()->Read(&byte));
+    EXPECT_EQ(6u, byte);
+    ASSERT_TRUE(scope.ReadPadding());
+    EXPECT_TRUE(reader.empty());
+  }
+}
+
+TEST(BoundedWriterScope, Nested) {
+  std::uint8_t buffer[8] = {};
+  BufferWriter writer{buffer, sizeof(buffer)};
+  BoundedWriter<BufferWriter> bounded_writer{&writer, 6};
+  ASSERT_TRUE(bounded_writer.Write(std::uint8_t{1}));
+
+  {
+    BoundedWriterScope<BoundedWriter<BufferWriter>> scope{&bounded_writer, 3};
+    ASSERT_TRUE(scope.status());
+    EXPECT_EQ(&bounded_writer, scope.writer());
+
+    ASSERT_TRUE(scope.writer()->Write(std::uint8_t{2}));
+    EXPECT_EQ(ErrorStatus::WriteLimitReached,
+              scope.writer()->Skip(3).error());
+    ASSERT_TRUE(scope.WritePadding());
+  }
+
+  EXPECT_EQ(4u, bounded_writer.size());
+  EXPECT_EQ(6u, bounded_writer.capacity());
+  ASSERT_TRUE(bounded_writer.Write(std::uint8_t{5}));
+
+  {
+    BoundedWriterScope<BoundedWriter<BufferWriter>> scope{&bounded_writer, 2};
+    EXPECT_EQ(ErrorStatus::WriteLimitReached, scope.status().error());
+  }
+
+  const std::uint8_t expected[8] = {1, 2, 0, 0, 5, 0, 0, 0};
+  EXPECT_EQ(0, std::memcmp(expected, buffer, sizeof(buffer)));
+}
+
+TEST(BoundedReaderScope, NestedTables) {
+  OuterTable table;
+  table.inner = InnerTable{};
+  table.inner.get().value = 3;
+  table.inner.get().names = std::vector<std::string>{"x", "yz"};
+  table.id = 9;
+
+  // BufferWriter writes the entries in two passes, through BoundedWriter.
+  std::uint8_t buffer[64];
+  Serializer<BufferWriter> serializer{buffer, sizeof(buffer)};
+  ASSERT_TRUE(serializer.Write(table));
+  const std::size_t size = serializer.writer().size();
+
+  Deserializer<PedanticBufferReader> deserializer{buffer, size};
+  OuterTable read_table;
+  ASSERT_TRUE(deserializer.Read(&read_table));
+  EXPECT_EQ(3, read_table.inner.get().value.get());
+  EXPECT_EQ(table.inner.get().names.get(),
+            read_table.inner.get().names.get());
+  EXPECT_EQ(9u, read_table.id.get());
+
+  for (std::size_t i = 0; i < size; i++) {
+    Deserializer<PedanticBufferReader> truncated{buffer, i};
+    EXPECT_FALSE(truncated.Read(&read_table)) << "size=" << i;
+  }
+
+  // An inner entry that claims more than the outer entry holds is rejected.
+  const std::uint8_t nested[] = {
+      static_cast<std::uint8_t>(EncodingByte::Table), 2, 1,
+      0, 7,  // Outer entry 0, seven bytes.
+      static_cast<std::uint8_t>(EncodingByte::Table), 1, 1,
+      0, 8,  // Inner entry 0, eight bytes.
+      5, 0, 0, 0, 0, 0, 0, 0};
+  Deserializer<PedanticBufferReader> invalid{nested, sizeof(nested)};
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, invalid.Read(&read_table).error());
+}
+
+TEST(TrustedBufferReader, Read) {
+  Serializer<VectorWriter> serializer;
+  const TestMessage message{7, "trusted", {1, -2, 3}};
+  ASSERT_TRUE(serializer.Write(message));
+  const std::vector<std::uint8_t> data = serializer.writer().take();
+
+  {
+    Deserializer<TrustedBufferReader> deserializer{data.data(), data.size()};
+    TestMessage read_message;
+    ASSERT_TRUE(deserializer.Read(&read_message));
+    EXPECT_EQ(message.name, read_message.name);
+    EXPECT_EQ(message.values, read_message.values);
+    EXPECT_TRUE(deserializer.reader().empty());
+  }
+
+  // Member counts are trusted.
+  {
+    Deserializer<PedanticBufferReader> deserializer{data.data(), data.size()};
+    TestMessageHeader header;
+    EXPECT_EQ(ErrorStatus::InvalidMemberCount,
+              deserializer.Read(&header).error());
+  }
+  {
+    Deserializer<TrustedBufferReader> deserializer{data.data(), data.size()};
+    TestMessageHeader header;
+    ASSERT_TRUE(deserializer.Read(&header));
+    EXPECT_EQ(7u, header.id);
+    EXPECT_EQ(message.name, header.name);
+  }
+
+  // Reads are still bounds checked.
+  for (std::size_t size = 0; size < data.size(); size++) {
+    Deserializer<TrustedBufferReader> deserializer{data.data(), size};
+    TestMessage read_message;
+    EXPECT_EQ(ErrorStatus::ReadLimitReached,
+              deserializer.Read(&read_message).error())
+        << "size=" << size;
+  }
+}
+
+TEST(TrustedBufferReader, Table) {
+  InnerTable table;
+  table.value = 10;
+  table.names = std::vector<std::string>{"a", "b"};
+
+  Serializer<VectorWriter> serializer;
+  ASSERT_TRUE(serializer.Write(table));
+  const std::vector<std::uint8_t> data = serializer.writer().take();
+
+  // Table hashes are trusted.
+  {
+    Deserializer<PedanticBufferReader> deserializer{data.data(), data.size()};
+    RenamedTable renamed;
+    EXPECT_EQ(ErrorStatus::InvalidTableHash,
+              deserializer.Read(&renamed).error());
+  }
+  {
+    Deserializer<TrustedBufferReader> deserializer{data.data(), data.size()};
+    RenamedTable renamed;
+    ASSERT_TRUE(deserializer.Read(&renamed));
+    EXPECT_EQ(10, renamed.value.get());
+    EXPECT_EQ(table.names.get(), renamed.names.get());
+  }
+
+  // Trust extends to tables nested in table entries.
+  OuterTable outer;
+  outer.inner = table;
+  outer.id = 5;
+  ASSERT_TRUE(serializer.Write(outer));
+  const std::vector<std::uint8_t> outer_data = serializer.writer().take();
+  {
+    Deserializer<PedanticBufferReader> deserializer{outer_data.data(),
+                                                    outer_data.size()};
+    RenamedOuterTable renamed;
+    EXPECT_EQ(ErrorStatus::InvalidTableHash,
+              deserializer.Read(&renamed).error());
+  }
+  {
+    Deserializer<TrustedBufferReader> deserializer{outer_data.data(),
+                                                   outer_data.size()};
+    RenamedOuterTable renamed;
+    ASSERT_TRUE(deserializer.Read(&renamed));
+    EXPECT_EQ(10, renamed.inner.get().value.get());
+    EXPECT_EQ(5u, renamed.id.get());
+  }
+}
+
+TEST(ArrayIndex, Write) {
+  std::vector<TestMessage> messages;
+  for (std::uint32_t i = 0; i < 100; i++) {
+    messages.push_back(
+        {i, std::string(i, 'a'), std::vector<std::int16_t>(i % 7, -1)});
+  }
+
+  for (std::size_t stride : {1, 3, 16, 1000}) {
+    // The indexed encoding is the same as the plain array encoding.
+    VectorWriter writer;
+    ArrayIndex index{stride};
+    ASSERT_TRUE(index.Write(messages, &writer));
+    EXPECT_EQ(messages.size(), index.count());
+    EXPECT_EQ((messages.size() + stride - 1) / stride, index.offsets().size());
+
+    Serializer<VectorWriter> serializer;
+    ASSERT_TRUE(serializer.Write(messages));
+    EXPECT_EQ(serializer.writer().buffer(), writer.buffer());
+
+    ArrayIndex built{stride};
+    ASSERT_TRUE(built.Build(writer.data(), writer.size()));
+    EXPECT_EQ(index.offsets(), built.offsets());
+
+    for (std::size_t i : {0, 1, 2, 17, 98, 99}) {
+      TestMessage message;
+      auto status = index.Read(writer.data(), writer.size(), i, &message);
+      ASSERT_TRUE(status) << status.GetErrorMessage();
+      EXPECT_EQ(messages[i].id, message.id);
+      EXPECT_EQ(messages[i].name, message.name);
+    }
+
+    std::vector<TestMessage> range;
+    ASSERT_TRUE(index.Read(writer.data(), writer.size(), 40, 20, &range));
+    ASSERT_EQ(20u, range.size());
+    EXPECT_EQ(40u, range.front().id);
+    EXPECT_EQ(59u, range.back().id);
+
+    TestMessage message;
+    EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+              index.Read(writer.data(), writer.size(), 100, &message).error());
+    EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+              index.Read(writer.data(), writer.size(), 90, 11, &range).error());
+  }
+}
+
+TEST(ArrayIndex, Serialize) {
+  std::vector<std::string> strings(50, "string");
+  VectorWriter writer;
+  ArrayIndex index{4};
+  ASSERT_TRUE(index.Write(strings, &writer));
+
+  // The index may be stored alongside the array.
+  Serializer<VectorWriter> serializer;
+  ASSERT_TRUE(serializer.Write(index));
+  Deserializer<BufferReader> deserializer{serializer.writer().data(),
+                                          serializer.writer().size()};
+  ArrayIndex read_index;
+  ASSERT_TRUE(deserializer.Read(&read_index));
+  EXPECT_EQ(4u, read_index.stride());
+  EXPECT_EQ(index.offsets(), read_index.offsets());
+
+  std::string value;
+  ASSERT_TRUE(read_index.Read(writer.data(), writer.size(), 49, &value));
+  EXPECT_EQ("string", value);
+
+  // Integral arrays are encoded as binary containers and are not indexed.
+  const std::vector<std::uint8_t> binary = {0xbc, 0};
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            index.Build(binary.data(), binary.size()).error());
+}
+
+TEST(ParallelSerializer, Write) {
+  std::vector<TestMessage> messages;
+  for (std::uint32_t i = 0; i < 1000; i++) {
+    messages.push_back({i * 7919, std::string(i % 37, 'm'),
+                        std::vector<std::int16_t>(i % 11, -300)});
+  }
+
+  Serializer<VectorWriter> serializer;
+  ASSERT_TRUE(serializer.Write(messages));
+
+  for (std::size_t threads : {1, 2, 3, 8}) {
+    ParallelSerializer parallel{threads};
+    ASSERT_TRUE(parallel.Write(messages));
+    EXPECT_EQ(serializer.writer().buffer(), parallel.buffer())
+        << "threads=" << threads;
+
+    // Writes append to the buffer.
+    ASSERT_TRUE(parallel.Write(std::vector<std::string>{}));
+    EXPECT_EQ(serializer.writer().size() + 2, parallel.size());
+  }
+
+  // Gaps left by encodings that overestimate their size are closed.
+  std::vector<Sloppy> sloppy;
+  for (std::uint32_t i = 0; i < 1000; i++)
+    sloppy.push_back({i * 100000});
+
+  serializer.writer().reset();
+  ASSERT_TRUE(serializer.Write(sloppy));
+  EXPECT_GT(serializer.GetSize(sloppy), serializer.writer().size());
+
+  ParallelSerializer parallel{4};
+  ASSERT_TRUE(parallel.Write(sloppy));
+  EXPECT_EQ(serializer.writer().buffer(), parallel.buffer());
+}
+
+TEST(ParallelDeserializer, Read) {
+  std::vector<TestMessage> messages;
+  for (std::uint32_t i = 0; i < 1000; i++) {
+    messages.push_back({i * 7919, std::string(i % 37, 'm'),
+                        std::vector<std::int16_t>(i % 11, -300)});
+  }
+
+  Serializer<VectorWriter> serializer;
+  ASSERT_TRUE(serializer.Write(messages));
+  ASSERT_TRUE(serializer.Write(std::string{"trailer"}));
+  const auto& buffer = serializer.writer().buffer();
+  const std::size_t vector_size = serializer.GetSize(messages);
+
+  for (std::size_t threads : {1, 2, 3, 8}) {
+    ParallelDeserializer deserializer{threads};
+    std::vector<TestMessage> decoded(3);
+    auto status = deserializer.Read(buffer.data(), buffer.size(), &decoded);
+    ASSERT_TRUE(status) << "threads=" << threads;
+    EXPECT_EQ(vector_size, status.get());
+    ASSERT_EQ(messages.size(), decoded.size());
+    for (std::size_t i = 0; i < messages.size(); i++) {
+      EXPECT_EQ(messages[i].id, decoded[i].id);
+      EXPECT_EQ(messages[i].name, decoded[i].name);
+      EXPECT_EQ(messages[i].values, decoded[i].values);
+    }
+  }
+
+  ParallelDeserializer deserializer{4};
+  std::vector<TestMessage> decoded;
+
+  // Truncated input fails while scanning.
+  auto status = deserializer.Read(buffer.data(), vector_size - 1, &decoded);
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, status.error());
+  EXPECT_TRUE(decoded.empty());
+
+  // Empty vectors.
+  serializer.writer().reset();
+  ASSERT_TRUE(serializer.Write(std::vector<TestMessage>{}));
+  status = deserializer.Read(serializer.writer().data(),
+                             serializer.writer().size(), &decoded);
+  ASSERT_TRUE(status);
+  EXPECT_EQ(2u, status.get());
+  EXPECT_TRUE(decoded.empty());
+
+  // Elements of the wrong type fail while decoding.
+  serializer.writer().reset();
+  ASSERT_TRUE(serializer.Write(std::vector<std::string>(500, "wrong")));
+  status = deserializer.Read(serializer.writer().data(),
+                             serializer.writer().size(), &decoded);
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType, status.error());
+  EXPECT_TRUE(decoded.empty());
+
+  // Values that are not arrays.
+  serializer.writer().reset();
+  ASSERT_TRUE(serializer.Write(std::string{"not an array"}));
+  status = deserializer.Read(serializer.writer().data(),
+                             serializer.writer().size(), &decoded);
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType, status.error());
+}
+
+TEST(ChecksumWriter, RoundTrip) {
+  std::vector<std::uint8_t> buffer(256);
+  BufferWriter buffer_writer{buffer.data(), buffer.size()};
+  ChecksumWriter<BufferWriter> checksum_writer{&buffer_writer};
+  Serializer<ChecksumWriter<BufferWriter>*> serializer{&checksum_writer};
+
+  const std::vector<std::string> messages{"first", "second", "third"};
+  std::vector<std::size_t> sizes;
+  for (const auto& message : messages) {
+    ASSERT_TRUE(serializer.Write(message));
+    ASSERT_TRUE(serializer.Write(std::vector<int>(10, 7)));
+    ASSERT_TRUE(checksum_writer.Skip(3, 0x55));
+    ASSERT_TRUE(checksum_writer.WriteDigest());
+    sizes.push_back(buffer_writer.size());
+  }
+
+  // The digest follows the bytes it covers.
+  std::uint32_t digest;
+  std::memcpy(&digest, &buffer[sizes[0] - sizeof(digest)], sizeof(digest));
+  EXPECT_EQ(Crc32c(buffer.data(), sizes[0] - sizeof(digest)), digest);
+
+  BufferReader buffer_reader{buffer.data(), buffer_writer.size()};
+  ChecksumReader<BufferReader> checksum_reader{&buffer_reader};
+  Deserializer<ChecksumReader<BufferReader>*> deserializer{&checksum_reader};
+  for (const auto& message : messages) {
+    std::string value;
+    std::vector<int> numbers;
+    ASSERT_TRUE(deserializer.Read(&value));
+    ASSERT_TRUE(deserializer.Read(&numbers));
+    ASSERT_TRUE(checksum_reader.Skip(3));
+    ASSERT_TRUE(checksum_reader.VerifyDigest());
+    EXPECT_EQ(message, value);
+  }
+  EXPECT_TRUE(buffer_reader.empty());
+}
+
+TEST(ChecksumReader, Corruption) {
+  std::vector<std::uint8_t> buffer(64);
+  BufferWriter buffer_writer{buffer.data(), buffer.size()};
+  ChecksumWriter<BufferWriter> checksum_writer{&buffer_writer};
+  Serializer<ChecksumWriter<BufferWriter>*> serializer{&checksum_writer};
+  ASSERT_TRUE(serializer.Write(std::string{"payload"}));
+  ASSERT_TRUE(checksum_writer.WriteDigest());
+
+  // Flip a byte of the string payload, which still decodes.
+  buffer[4] ^= 0x20;
+
+  BufferReader buffer_reader{buffer.data(), buffer_writer.size()};
+  ChecksumReader<BufferReader> checksum_reader{&buffer_reader};
+  Deserializer<ChecksumReader<BufferReader>*> deserializer{&checksum_reader};
+  std::string value;
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ("paYload", value);
+  EXPECT_EQ(ErrorStatus::ProtocolError, checksum_reader.VerifyDigest().error());
+}
+
+namespace {
+
+// Stream buffer over a string that does not support seeking.
+class UnseekableBuffer : public std::streambuf {
+ public:
+  explicit UnseekableBuffer(std::string data) : data_{std::move(data)} {
+    setg(&data_[0], &data_[0], &data_[0] + data_.size());
+  }
+
+ private:
+  std::string data_;
+};
+
+// Reader that cannot tell when it is empty, like a pipe.
+class UnsizedReader {
+ public:
+  UnsizedReader(const void* data, std::size_t size) : reader_{data, size} {}
+
+  Status<void> Ensure(std::size_t size) { return reader_.Ensure(size); }
+  Status<void> Read(std::uint8_t* byte) { return reader_.Read(byte); }
+  template <typename T>
+  Status<void> Read(T* begin, T* end) {
+    return reader_.Read(begin, end);
+  }
+  Status<void> Skip(std::size_t padding_bytes) {
+    return reader_.Skip(padding_bytes);
+  }
+
+ private:
+  PedanticBufferReader reader_;
+};
+
+}  // anonymous namespace
+
+TEST(Deserializer, ReadBatch) {
+  Serializer<VectorWriter> serializer;
+  for (std::uint32_t i = 0; i < 10; i++)
+    ASSERT_TRUE(serializer.Write(TestMessage{i, "message", {1, 2, 3}}));
+  const std::vector<std::uint8_t> data = serializer.writer().take();
+
+  {
+    Deserializer<BufferReader> deserializer{data.data(), data.size()};
+    std::vector<TestMessage> messages;
+    auto status = deserializer.ReadBatch(&messages, 4);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(4u, status.get());
+
+    // Batches append to the vector and stop at the end of the input.
+    status = deserializer.ReadBatch(&messages);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(6u, status.get());
+    ASSERT_EQ(10u, messages.size());
+    EXPECT_EQ(9u, messages[9].id);
+    EXPECT_EQ("message", messages[9].name);
+    EXPECT_TRUE(deserializer.reader().empty());
+
+    status = deserializer.ReadBatch(&messages);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(0u, status.get());
+  }
+  {
+    Deserializer<StreamReader<std::stringstream>> deserializer{
+        std::string{data.begin(), data.end()}};
+    std::vector<TestMessage> messages;
+    auto status = deserializer.ReadBatch(&messages);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(10u, status.get());
+    EXPECT_EQ(std::vector<std::int16_t>({1, 2, 3}), messages[5].values);
+  }
+  {
+    Deserializer<UnsizedReader> deserializer{data.data(), data.size()};
+    std::vector<TestMessage> messages;
+    auto status = deserializer.ReadBatch(&messages);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(10u, status.get());
+    EXPECT_EQ(9u, messages[9].id);
+  }
+
+  // A truncated value is an error, leaving the values read before it.
+  {
+    Deserializer<PedanticBufferReader> deserializer{data.data(),
+                                                    data.size() - 1};
+    std::vector<TestMessage> messages;
+    EXPECT_EQ(ErrorStatus::ReadLimitReached,
+              deserializer.ReadBatch(&messages).error());
+    EXPECT_EQ(9u, messages.size());
+  }
+  {
+    Deserializer<UnsizedReader> deserializer{data.data(), data.size() - 1};
+    std::vector<TestMessage> messages;
+    EXPECT_EQ(ErrorStatus::ReadLimitReached,
+              deserializer.ReadBatch(&messages).error());
+    EXPECT_EQ(9u, messages.size());
+  }
+  {
+    Deserializer<UnsizedReader> deserializer{data.data(), data.size()};
+    std::vector<std::string> strings;
+    EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+              deserializer.ReadBatch(&strings).error());
+    EXPECT_TRUE(strings.empty());
+  }
+}
+
+TEST(StreamWriter, RoundTrip) {
+  Serializer<StreamWriter<std::stringstream>> serializer;
+  ASSERT_TRUE(serializer.Write(std::string{"stream"}));
+  ASSERT_TRUE(serializer.writer().Skip(100, 0x55));
+  ASSERT_TRUE(serializer.Write(std::vector<int>(20, 3)));
+
+  const std::string data = serializer.writer().stream().str();
+  EXPECT_EQ(std::string(100, 0x55), data.substr(8, 100));
+
+  Deserializer<StreamReader<std::stringstream>> deserializer{data};
+  std::string value;
+  std::vector<int> numbers;
+  ASSERT_TRUE(deserializer.Read(&value));
+  ASSERT_TRUE(deserializer.reader().Skip(100));
+  ASSERT_TRUE(deserializer.Read(&numbers));
+  EXPECT_EQ("stream", value);
+  EXPECT_EQ(std::vector<int>(20, 3), numbers);
+
+  // Reading past the end fails and sets the stream state.
+  std::uint8_t byte;
+  EXPECT_EQ(ErrorStatus::StreamError,
+            deserializer.reader().Read(&byte).error());
+  EXPECT_TRUE(deserializer.reader().stream().eof());
+  EXPECT_TRUE(deserializer.reader().stream().fail());
+}
+
+TEST(StreamReader, Skip) {
+  // Seekable streams cannot skip past the end.
+  StreamReader<std::stringstream> reader{std::string(10, 'x')};
+  EXPECT_TRUE(reader.Skip(4));
+  EXPECT_EQ(ErrorStatus::StreamError, reader.Skip(7).error());
+
+  // Unseekable streams read over the padding.
+  UnseekableBuffer buffer{std::string(100, 'y') + "z"};
+  StreamReader<std::istream> unseekable{&buffer};
+  std::uint8_t byte;
+  ASSERT_TRUE(unseekable.Skip(100));
+  ASSERT_TRUE(unseekable.Read(&byte));
+  EXPECT_EQ('z', byte);
+  EXPECT_EQ(ErrorStatus::StreamError, unseekable.Skip(1).error());
+}
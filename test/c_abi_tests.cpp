@@ -0,0 +1,191 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/c_abi.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::BufferReader;
+using nop::Deserializer;
+using nop::ErrorStatus;
+using nop::Serializer;
+using nop::VectorWriter;
+
+namespace {
+
+struct Point {
+  std::int32_t x;
+  std::int32_t y;
+  NOP_STRUCTURE(Point, x, y);
+};
+
+struct Shape {
+  std::string name;
+  std::vector<Point> points;
+  std::vector<float> weights;
+  bool closed;
+  NOP_STRUCTURE(Shape, name, points, weights, closed);
+};
+
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  return serializer.writer().take();
+}
+
+NopView ViewOf(const std::vector<std::uint8_t>& data) {
+  return {data.data(), data.size()};
+}
+
+int ErrorOf(ErrorStatus error) { return -static_cast<int>(error); }
+
+}  // anonymous namespace
+
+NOP_C_ABI(test_nop);
+NOP_C_ABI_STRUCTURE(test_point, Point);
+NOP_C_ABI_STRUCTURE(test_shape, Shape);
+
+TEST(CAbi, Read) {
+  const Shape shape{"square", {{0, 0}, {0, 4}, {4, 4}, {4, 0}}, {0.5f, 2.f},
+                    true};
+  const std::vector<std::uint8_t> data = Encode(shape);
+  const NopView value = ViewOf(data);
+
+  EXPECT_EQ(4u, test_shape_member_count());
+  EXPECT_EQ(0, test_shape_validate(value));
+
+  std::size_t length = 0;
+  ASSERT_EQ(0, test_nop_length(value, &length));
+  EXPECT_EQ(data.size(), length);
+
+  // String payloads are viewed in place.
+  NopView member{}, bytes{};
+  ASSERT_EQ(0, test_shape_member(value, 0, &member));
+  ASSERT_EQ(0, test_nop_read_bytes(member, &bytes));
+  EXPECT_EQ("square",
+            std::string(static_cast<const char*>(bytes.data), bytes.size));
+  EXPECT_GT(bytes.data, static_cast<const void*>(data.data()));
+  EXPECT_LT(bytes.data, static_cast<const void*>(data.data() + data.size()));
+
+  // Select the y coordinate of the third point.
+  std::size_t count = 0;
+  NopView points{}, point{}, coordinate{};
+  ASSERT_EQ(0, test_shape_member(value, 1, &points));
+  ASSERT_EQ(0, test_nop_count(points, &count));
+  EXPECT_EQ(4u, count);
+  ASSERT_EQ(0, test_nop_element(points, 2, &point));
+  EXPECT_EQ(0, test_point_validate(point));
+  ASSERT_EQ(0, test_point_member(point, 1, &coordinate));
+
+  std::int64_t y = 0;
+  ASSERT_EQ(0, test_nop_read_int64(coordinate, &y));
+  EXPECT_EQ(4, y);
+
+  // Vectors of numbers are encoded as binary payloads.
+  ASSERT_EQ(0, test_shape_member(value, 2, &member));
+  ASSERT_EQ(0, test_nop_read_bytes(member, &bytes));
+  ASSERT_EQ(2 * sizeof(float), bytes.size);
+
+  bool closed = false;
+  ASSERT_EQ(0, test_shape_member(value, 3, &member));
+  ASSERT_EQ(0, test_nop_read_bool(member, &closed));
+  EXPECT_TRUE(closed);
+}
+
+TEST(CAbi, ReadErrors) {
+  const std::vector<std::uint8_t> data = Encode(Point{1, -2});
+  const NopView value = ViewOf(data);
+
+  NopView member{};
+  EXPECT_EQ(ErrorOf(ErrorStatus::InvalidMemberCount),
+            test_point_member(value, 2, &member));
+  EXPECT_EQ(ErrorOf(ErrorStatus::InvalidContainerLength),
+            test_nop_element(value, 2, &member));
+  EXPECT_EQ(ErrorOf(ErrorStatus::InvalidMemberCount),
+            test_shape_validate(value));
+
+  // Outputs are left unchanged on failure.
+  ASSERT_EQ(0, test_point_member(value, 1, &member));
+  std::uint64_t unsigned_value = 7;
+  EXPECT_EQ(ErrorOf(ErrorStatus::UnexpectedEncodingType),
+            test_nop_read_uint64(member, &unsigned_value));
+  EXPECT_EQ(7u, unsigned_value);
+
+  NopView bytes{};
+  EXPECT_EQ(ErrorOf(ErrorStatus::UnexpectedEncodingType),
+            test_nop_read_bytes(member, &bytes));
+  EXPECT_EQ(nullptr, bytes.data);
+
+  // Truncated input is rejected.
+  const NopView truncated{data.data(), data.size() - 1};
+  EXPECT_EQ(ErrorOf(ErrorStatus::ReadLimitReached),
+            test_point_validate(truncated));
+  EXPECT_EQ(ErrorOf(ErrorStatus::ReadLimitReached),
+            test_point_member(truncated, 1, &member));
+
+  const std::vector<std::uint8_t> string = Encode(std::string{"abcd"});
+  EXPECT_EQ(ErrorOf(ErrorStatus::ReadLimitReached),
+            test_nop_read_bytes({string.data(), string.size() - 1}, &bytes));
+}
+
+TEST(CAbi, Write) {
+  std::uint8_t storage[64];
+  NopBuffer buffer{storage, sizeof(storage), 0};
+
+  // Write a shape member by member.
+  const float weights[] = {1.f, 0.25f};
+  ASSERT_EQ(0, test_shape_write_header(&buffer));
+  ASSERT_EQ(0, test_nop_write_string(&buffer, "line", 4));
+  ASSERT_EQ(0, test_nop_write_array(&buffer, 2));
+  for (std::int64_t i = 0; i < 2; i++) {
+    ASSERT_EQ(0, test_point_write_header(&buffer));
+    ASSERT_EQ(0, test_nop_write_int64(&buffer, i));
+    ASSERT_EQ(0, test_nop_write_int64(&buffer, -i));
+  }
+  ASSERT_EQ(0, test_nop_write_binary(&buffer, weights, sizeof(weights)));
+  ASSERT_EQ(0, test_nop_write_bool(&buffer, false));
+  EXPECT_EQ(0, test_shape_validate({storage, buffer.size}));
+
+  Deserializer<BufferReader> deserializer{storage, buffer.size};
+  Shape shape;
+  ASSERT_TRUE(deserializer.Read(&shape));
+  EXPECT_EQ("line", shape.name);
+  ASSERT_EQ(2u, shape.points.size());
+  EXPECT_EQ(1, shape.points[1].x);
+  EXPECT_EQ(-1, shape.points[1].y);
+  EXPECT_EQ((std::vector<float>{1.f, 0.25f}), shape.weights);
+  EXPECT_FALSE(shape.closed);
+
+  // Writes that do not fit leave the buffer unchanged.
+  const std::size_t size = buffer.size;
+  const std::string text(sizeof(storage), 'x');
+  EXPECT_EQ(ErrorOf(ErrorStatus::WriteLimitReached),
+            test_nop_write_string(&buffer, text.data(), text.size()));
+  EXPECT_EQ(size, buffer.size);
+
+  buffer.size = 0;
+  ASSERT_EQ(0, test_nop_write_double(&buffer, 0.5));
+  double value = 0;
+  ASSERT_EQ(0, test_nop_read_double({storage, buffer.size}, &value));
+  EXPECT_EQ(0.5, value);
+}
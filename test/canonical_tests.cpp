@@ -0,0 +1,153 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/types/hash_map.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/canonical_writer.h>
+#include <nop/utility/sip_hash.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::BlockReader;
+using nop::BufferReader;
+using nop::CanonicalWriter;
+using nop::Deserializer;
+using nop::Entry;
+using nop::HashMap;
+using nop::Serializer;
+using nop::SipHash;
+using nop::VectorWriter;
+
+namespace {
+
+struct Request {
+  std::unordered_map<std::string, std::uint32_t> parameters;
+  std::unordered_set<std::string> tags;
+  std::unordered_set<std::int32_t> ids;
+  HashMap<std::uint64_t, std::string> names;
+  NOP_STRUCTURE(Request, parameters, tags, ids, names);
+};
+
+struct Envelope {
+  Entry<Request, 0> request;
+  Entry<std::unordered_map<std::string, std::unordered_set<std::uint16_t>>, 1>
+      groups;
+  NOP_TABLE_NS("Envelope", Envelope, request, groups);
+};
+
+// Fills |envelope| with the same content, inserting the elements in forward
+// or reverse order into containers with different bucket counts.
+Envelope MakeEnvelope(bool reverse) {
+  const std::size_t kCount = 50;
+  Request request;
+  request.parameters.reserve(reverse ? 200 : 0);
+  request.tags.reserve(reverse ? 300 : 0);
+  request.ids.reserve(reverse ? 400 : 0);
+
+  std::unordered_map<std::string, std::unordered_set<std::uint16_t>> groups;
+  for (std::size_t n = 0; n < kCount; n++) {
+    const std::size_t i = reverse ? kCount - 1 - n : n;
+    request.parameters.emplace("parameter" + std::to_string(i), i * 3);
+    request.tags.insert("tag" + std::to_string(i * 7));
+    request.ids.insert(static_cast<std::int32_t>(i * 1000) - 20000);
+    request.names.insert({i << 20, std::to_string(i)});
+    groups["group" + std::to_string(i % 5)].insert(
+        static_cast<std::uint16_t>(i));
+  }
+
+  Envelope envelope;
+  envelope.request = std::move(request);
+  envelope.groups = std::move(groups);
+  return envelope;
+}
+
+template <typename T>
+std::vector<std::uint8_t> EncodeCanonical(const T& value) {
+  VectorWriter vector_writer;
+  CanonicalWriter<VectorWriter> writer{&vector_writer};
+  Serializer<decltype(writer)*> serializer{&writer};
+  EXPECT_TRUE(serializer.Write(value));
+  return {vector_writer.data(), vector_writer.data() + vector_writer.size()};
+}
+
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  return {serializer.writer().data(),
+          serializer.writer().data() + serializer.writer().size()};
+}
+
+}  // anonymous namespace
+
+TEST(CanonicalWriter, Deterministic) {
+  const Envelope forward = MakeEnvelope(false);
+  const Envelope reverse = MakeEnvelope(true);
+
+  const std::vector<std::uint8_t> forward_bytes = EncodeCanonical(forward);
+  const std::vector<std::uint8_t> reverse_bytes = EncodeCanonical(reverse);
+  EXPECT_EQ(forward_bytes, reverse_bytes);
+  EXPECT_EQ(SipHash::Compute(BlockReader<std::uint8_t>{forward_bytes.data(),
+                                                       forward_bytes.size()},
+                             1, 2),
+            SipHash::Compute(BlockReader<std::uint8_t>{reverse_bytes.data(),
+                                                       reverse_bytes.size()},
+                             1, 2));
+
+  // Sorting the elements does not change the encoded size.
+  Serializer<VectorWriter> serializer;
+  EXPECT_EQ(serializer.GetSize(forward), forward_bytes.size());
+
+  // The canonical encoding reads as usual.
+  BufferReader reader{forward_bytes.data(), forward_bytes.size()};
+  Deserializer<BufferReader*> deserializer{&reader};
+  Envelope decoded;
+  ASSERT_TRUE(deserializer.Read(&decoded));
+  ASSERT_TRUE(decoded.request && decoded.groups);
+  EXPECT_EQ(forward.request.get().parameters, decoded.request.get().parameters);
+  EXPECT_EQ(forward.request.get().tags, decoded.request.get().tags);
+  EXPECT_EQ(forward.request.get().ids, decoded.request.get().ids);
+  EXPECT_EQ(forward.groups.get(), decoded.groups.get());
+  EXPECT_EQ(forward_bytes, EncodeCanonical(decoded));
+}
+
+TEST(CanonicalWriter, Order) {
+  // Integers below 128 encode as single bytes, so the canonical order of an
+  // unordered map with such keys is the order of a std::map.
+  std::unordered_map<std::uint32_t, std::string> unordered;
+  std::map<std::uint32_t, std::string> ordered;
+  for (std::uint32_t i = 0; i < 100; i++) {
+    const std::uint32_t key = (i * 37) % 100;
+    unordered.emplace(key, std::to_string(i));
+    ordered.emplace(key, std::to_string(i));
+  }
+  EXPECT_EQ(Encode(ordered), EncodeCanonical(unordered));
+
+  // Sets of integral types are sorted by value.
+  const std::unordered_set<std::int64_t> set = {5, -3, 1ll << 40, 0, -70000};
+  const std::vector<std::int64_t> sorted = {-70000, -3, 0, 5, 1ll << 40};
+  std::vector<std::uint8_t> expected = Encode(sorted);
+  EXPECT_EQ(expected, EncodeCanonical(set));
+}
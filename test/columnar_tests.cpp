@@ -0,0 +1,159 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/types/columnar.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::BufferReader;
+using nop::Columnar;
+using nop::Deserializer;
+using nop::ErrorStatus;
+using nop::Serializer;
+using nop::VectorWriter;
+
+namespace {
+
+struct Record {
+  std::uint32_t id;
+  double value;
+  std::string label;
+  std::int8_t flags;
+  NOP_STRUCTURE(Record, id, value, label, flags);
+};
+
+bool operator==(const Record& a, const Record& b) {
+  return a.id == b.id && a.value == b.value && a.label == b.label &&
+         a.flags == b.flags;
+}
+
+struct RecordColumns {
+  std::vector<std::uint32_t> id;
+  std::vector<double> value;
+  std::vector<std::string> label;
+  std::vector<std::int8_t> flags;
+  NOP_STRUCTURE(RecordColumns, id, value, label, flags);
+};
+
+struct Single {
+  std::uint32_t id;
+  NOP_STRUCTURE(Single, id);
+};
+
+struct Labels {
+  std::vector<std::string> id;
+  NOP_STRUCTURE(Labels, id);
+};
+
+Columnar<Record> MakeRecords(std::size_t count) {
+  Columnar<Record> records;
+  for (std::size_t i = 0; i < count; i++) {
+    records.push_back({static_cast<std::uint32_t>(i * 3), i * 0.5,
+                       "record" + std::to_string(i % 5),
+                       static_cast<std::int8_t>(i % 3 - 1)});
+  }
+  return records;
+}
+
+// Returns the encoding of |value|.
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  EXPECT_EQ(serializer.GetSize(value), serializer.writer().size());
+  return serializer.writer().take();
+}
+
+// Decodes |encoding| into |value|.
+template <typename T>
+nop::Status<void> Decode(const std::vector<std::uint8_t>& encoding, T* value) {
+  Deserializer<BufferReader> deserializer{encoding.data(), encoding.size()};
+  return deserializer.Read(value);
+}
+
+}  // anonymous namespace
+
+TEST(Columnar, RoundTrip) {
+  // Enough rows to span several chunks of the packed columns.
+  for (std::size_t count : {0, 1, 300, 2000}) {
+    const Columnar<Record> records = MakeRecords(count);
+    const std::vector<std::uint8_t> encoding = Encode(records);
+
+    Columnar<Record> decoded;
+    ASSERT_TRUE(Decode(encoding, &decoded));
+    EXPECT_EQ(records, decoded);
+  }
+}
+
+TEST(Columnar, StructureOfArrays) {
+  const Columnar<Record> records = MakeRecords(100);
+  RecordColumns columns;
+  for (const Record& record : records) {
+    columns.id.push_back(record.id);
+    columns.value.push_back(record.value);
+    columns.label.push_back(record.label);
+    columns.flags.push_back(record.flags);
+  }
+
+  // The columnar encoding is the encoding of the structure of arrays.
+  const std::vector<std::uint8_t> encoding = Encode(records);
+  EXPECT_EQ(Encode(columns), encoding);
+
+  RecordColumns decoded_columns;
+  ASSERT_TRUE(Decode(encoding, &decoded_columns));
+  EXPECT_EQ(columns.id, decoded_columns.id);
+  EXPECT_EQ(columns.label, decoded_columns.label);
+
+  Columnar<Record> decoded;
+  ASSERT_TRUE(Decode(Encode(columns), &decoded));
+  EXPECT_EQ(records, decoded);
+}
+
+TEST(Columnar, Reuse) {
+  // Decoding reuses existing rows and trims the extra ones.
+  Columnar<Record> decoded = MakeRecords(50);
+  ASSERT_TRUE(Decode(Encode(MakeRecords(20)), &decoded));
+  EXPECT_EQ(MakeRecords(20), decoded);
+
+  ASSERT_TRUE(Decode(Encode(MakeRecords(30)), &decoded));
+  EXPECT_EQ(MakeRecords(30), decoded);
+}
+
+TEST(Columnar, Errors) {
+  // Columns of different lengths are rejected.
+  RecordColumns columns;
+  columns.id = {1, 2, 3};
+  columns.value = {1.0, 2.0};
+  columns.label = {"a", "b", "c"};
+  columns.flags = {0, 0, 0};
+
+  Columnar<Record> decoded;
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+            Decode(Encode(columns), &decoded).error());
+
+  // Packed columns must be packed.
+  Columnar<Single> single;
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            Decode(Encode(Labels{{"x"}}), &single).error());
+  EXPECT_EQ(ErrorStatus::InvalidMemberCount,
+            Decode(Encode(columns), &single).error());
+}
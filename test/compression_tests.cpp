@@ -0,0 +1,179 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/compressing_writer.h>
+#include <nop/utility/compression_codec.h>
+#include <nop/utility/decompressing_reader.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::BufferReader;
+using nop::CompressingWriter;
+using nop::DecompressingReader;
+using nop::Deserializer;
+using nop::ErrorStatus;
+using nop::Lz4Codec;
+using nop::Serializer;
+using nop::StoredCodec;
+using nop::VectorWriter;
+
+namespace {
+
+struct Sample {
+  std::uint32_t id;
+  std::string label;
+  std::vector<std::uint32_t> values;
+  NOP_STRUCTURE(Sample, id, label, values);
+};
+
+Sample MakeSample(std::uint32_t id) {
+  return {id, "sample-" + std::to_string(id % 10),
+          std::vector<std::uint32_t>(id % 64, id % 7)};
+}
+
+// Returns |size| bytes of pseudo-random, incompressible data.
+std::vector<std::uint8_t> RandomBytes(std::size_t size) {
+  std::vector<std::uint8_t> data(size);
+  std::uint32_t state = 12345;
+  for (auto& byte : data) {
+    state = state * 1103515245 + 12345;
+    byte = static_cast<std::uint8_t>(state >> 24);
+  }
+  return data;
+}
+
+std::vector<std::uint8_t> Lz4RoundTrip(const std::vector<std::uint8_t>& data) {
+  std::vector<std::uint8_t> compressed(Lz4Codec::Bound(data.size()));
+  compressed.resize(
+      Lz4Codec::Compress(data.data(), data.size(), compressed.data()));
+
+  std::vector<std::uint8_t> decompressed(data.size());
+  EXPECT_TRUE(Lz4Codec::Decompress(compressed.data(), compressed.size(),
+                                   decompressed.data(), decompressed.size()));
+  return decompressed;
+}
+
+}  // anonymous namespace
+
+TEST(Lz4Codec, RoundTrip) {
+  for (std::size_t size = 0; size < 100; size++) {
+    std::vector<std::uint8_t> repeated(size, 'a');
+    EXPECT_EQ(repeated, Lz4RoundTrip(repeated));
+
+    const std::vector<std::uint8_t> random = RandomBytes(size);
+    EXPECT_EQ(random, Lz4RoundTrip(random));
+  }
+
+  // Long literal runs and matches use extension bytes.
+  std::vector<std::uint8_t> data = RandomBytes(1000);
+  const std::vector<std::uint8_t> copy = data;
+  data.insert(data.end(), copy.begin(), copy.end());
+  data.insert(data.end(), 2000, 'z');
+  EXPECT_EQ(data, Lz4RoundTrip(data));
+
+  std::vector<std::uint8_t> compressed(Lz4Codec::Bound(data.size()));
+  EXPECT_GT(data.size() / 2,
+            Lz4Codec::Compress(data.data(), data.size(), compressed.data()));
+}
+
+TEST(Lz4Codec, Decompress) {
+  // A block in the reference format: "abc", a match repeating them three
+  // times, and the final literals.
+  const std::vector<std::uint8_t> block = {
+      0x35, 'a', 'b', 'c', 0x03, 0x00, 0x50, '1', '2', '3', '4', '5'};
+  const std::string expected = "abcabcabcabc12345";
+  std::vector<std::uint8_t> output(expected.size());
+  ASSERT_TRUE(Lz4Codec::Decompress(block.data(), block.size(), output.data(),
+                                   output.size()));
+  EXPECT_EQ(expected, std::string(output.begin(), output.end()));
+
+  // Malformed blocks are rejected.
+  std::vector<std::uint8_t> bad_offset = block;
+  bad_offset[4] = 0x04;
+  EXPECT_FALSE(Lz4Codec::Decompress(bad_offset.data(), bad_offset.size(),
+                                    output.data(), output.size()));
+  EXPECT_FALSE(Lz4Codec::Decompress(block.data(), block.size() - 1,
+                                    output.data(), output.size()));
+  EXPECT_FALSE(Lz4Codec::Decompress(block.data(), block.size(), output.data(),
+                                    output.size() - 1));
+}
+
+TEST(CompressingWriter, RoundTrip) {
+  VectorWriter vector_writer;
+  std::size_t raw_size = 0;
+  {
+    CompressingWriter<VectorWriter> writer{&vector_writer, 512};
+    Serializer<decltype(writer)*> serializer{&writer};
+    for (std::uint32_t i = 0; i < 500; i++) {
+      ASSERT_TRUE(serializer.Write(MakeSample(i)));
+      raw_size += serializer.GetSize(MakeSample(i));
+    }
+
+    // Large writes bypass the block buffer.
+    ASSERT_TRUE(serializer.Write(std::vector<std::uint8_t>(5000, 'x')));
+    ASSERT_TRUE(serializer.Write(RandomBytes(3000)));
+    ASSERT_TRUE(writer.Flush());
+  }
+  EXPECT_GT(raw_size / 2, vector_writer.size());
+
+  BufferReader buffer_reader{vector_writer.data(), vector_writer.size()};
+  DecompressingReader<BufferReader> reader{&buffer_reader};
+  Deserializer<decltype(reader)*> deserializer{&reader};
+  for (std::uint32_t i = 0; i < 500; i++) {
+    Sample sample;
+    ASSERT_TRUE(deserializer.Read(&sample));
+    EXPECT_EQ(MakeSample(i).label, sample.label);
+    EXPECT_EQ(MakeSample(i).values, sample.values);
+  }
+
+  std::vector<std::uint8_t> bytes;
+  ASSERT_TRUE(deserializer.Read(&bytes));
+  EXPECT_EQ(std::vector<std::uint8_t>(5000, 'x'), bytes);
+  ASSERT_TRUE(deserializer.Read(&bytes));
+  EXPECT_EQ(RandomBytes(3000), bytes);
+  EXPECT_TRUE(reader.empty());
+}
+
+TEST(CompressingWriter, Stored) {
+  VectorWriter vector_writer;
+  {
+    CompressingWriter<VectorWriter, StoredCodec> writer{&vector_writer, 64};
+    Serializer<decltype(writer)*> serializer{&writer};
+    ASSERT_TRUE(serializer.Write(std::string(100, 's')));
+  }
+
+  // Stored blocks hold the raw bytes after their headers.
+  EXPECT_EQ(102u + 2 * 2 * sizeof(std::uint32_t), vector_writer.size());
+
+  BufferReader buffer_reader{vector_writer.data(), vector_writer.size()};
+  DecompressingReader<BufferReader, StoredCodec> reader{&buffer_reader};
+  Deserializer<decltype(reader)*> deserializer{&reader};
+  std::string value;
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ(std::string(100, 's'), value);
+
+  // Oversized blocks are rejected.
+  BufferReader limited_reader{vector_writer.data(), vector_writer.size()};
+  DecompressingReader<BufferReader, StoredCodec> limited{&limited_reader, 32};
+  std::uint8_t byte;
+  EXPECT_EQ(ErrorStatus::ProtocolError, limited.Read(&byte).error());
+}
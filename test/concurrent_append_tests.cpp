@@ -0,0 +1,174 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/concurrent_append_writer.h>
+
+using nop::BufferReader;
+using nop::ConcurrentAppendRegion;
+using nop::ConcurrentAppendWriter;
+using nop::Deserializer;
+using nop::ErrorStatus;
+using nop::Serializer;
+
+namespace {
+
+struct Entry {
+  std::uint32_t thread;
+  std::uint32_t sequence;
+  std::string text;
+  NOP_STRUCTURE(Entry, thread, sequence, text);
+};
+
+// Zeroed memory aligned for the region.
+std::vector<std::uint64_t> MakeMemory(std::size_t size) {
+  return std::vector<std::uint64_t>(size / sizeof(std::uint64_t), 0);
+}
+
+// Reads the committed records of |region| as Entries.
+std::vector<Entry> ReadEntries(const ConcurrentAppendRegion& region) {
+  std::vector<Entry> entries;
+  std::size_t offset = 0;
+  const std::uint8_t* data;
+  std::size_t size;
+  while (region.NextRecord(&offset, &data, &size)) {
+    Deserializer<BufferReader> deserializer{data, size};
+    Entry entry;
+    EXPECT_TRUE(deserializer.Read(&entry));
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+}  // anonymous namespace
+
+TEST(ConcurrentAppendWriter, WriteRead) {
+  auto memory = MakeMemory(4096);
+  ConcurrentAppendRegion region{memory.data(), 4096};
+  EXPECT_EQ(4096u - ConcurrentAppendRegion::kHeaderSize, region.capacity());
+  EXPECT_EQ(0u, region.size());
+
+  Serializer<ConcurrentAppendWriter> serializer{&region};
+  ASSERT_TRUE(serializer.Write(Entry{0, 1, "one"}));
+  ASSERT_TRUE(serializer.Write(Entry{0, 2, "two"}));
+
+  // Records are padded to a multiple of 8 bytes.
+  EXPECT_EQ(0u, region.size() % 8);
+
+  std::vector<Entry> entries = ReadEntries(region);
+  ASSERT_EQ(2u, entries.size());
+  EXPECT_EQ(1u, entries[0].sequence);
+  EXPECT_EQ("one", entries[0].text);
+  EXPECT_EQ(2u, entries[1].sequence);
+  EXPECT_EQ("two", entries[1].text);
+
+  // Another region over the same memory continues after the records.
+  ConcurrentAppendRegion other{memory.data(), 4096};
+  Serializer<ConcurrentAppendWriter> other_serializer{&other};
+  ASSERT_TRUE(other_serializer.Write(Entry{1, 3, "three"}));
+  EXPECT_EQ(3u, ReadEntries(region).size());
+}
+
+TEST(ConcurrentAppendWriter, Pending) {
+  auto memory = MakeMemory(4096);
+  ConcurrentAppendRegion region{memory.data(), 4096};
+
+  // A record claimed first but finished last is skipped until it is
+  // committed.
+  ConcurrentAppendWriter slow{&region};
+  const std::uint32_t value = 1;
+  ASSERT_TRUE(slow.Prepare(8));
+  ASSERT_TRUE(slow.Write(&value, &value + 1));
+
+  Serializer<ConcurrentAppendWriter> serializer{&region};
+  ASSERT_TRUE(serializer.Write(Entry{0, 1, "fast"}));
+
+  std::vector<Entry> entries = ReadEntries(region);
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ("fast", entries[0].text);
+
+  // Flushing commits the bytes written so far of an overestimated record.
+  slow.Flush();
+  std::size_t offset = 0;
+  const std::uint8_t* data;
+  std::size_t size;
+  ASSERT_TRUE(region.NextRecord(&offset, &data, &size));
+  EXPECT_EQ(4u, size);
+  ASSERT_TRUE(region.NextRecord(&offset, &data, &size));
+  EXPECT_FALSE(region.NextRecord(&offset, &data, &size));
+
+  // Writes beyond the prepared size are not split across records.
+  ASSERT_TRUE(slow.Prepare(2));
+  EXPECT_EQ(ErrorStatus::WriteLimitReached,
+            slow.Write(&value, &value + 1).error());
+}
+
+TEST(ConcurrentAppendWriter, Full) {
+  auto memory = MakeMemory(256);
+  ConcurrentAppendRegion region{memory.data(), 256};
+
+  Serializer<ConcurrentAppendWriter> serializer{&region};
+  const Entry entry{0, 0, std::string(40, 'x')};
+  ASSERT_TRUE(serializer.Write(entry));
+  ASSERT_TRUE(serializer.Write(entry));
+  ASSERT_TRUE(serializer.Write(entry));
+  EXPECT_EQ(ErrorStatus::WriteLimitReached, serializer.Write(entry).error());
+  EXPECT_EQ(ErrorStatus::WriteLimitReached, serializer.Write(entry).error());
+
+  // The records that fit are intact.
+  EXPECT_EQ(3u, ReadEntries(region).size());
+  EXPECT_EQ(region.capacity(), region.size());
+}
+
+TEST(ConcurrentAppendWriter, Threads) {
+  const std::size_t kSize = 1 << 20;
+  auto memory = MakeMemory(kSize);
+  ConcurrentAppendRegion region{memory.data(), kSize};
+
+  const std::uint32_t kThreads = 4;
+  const std::uint32_t kCount = 1000;
+  std::vector<std::thread> threads;
+  for (std::uint32_t thread = 0; thread < kThreads; thread++) {
+    threads.emplace_back([&region, thread] {
+      Serializer<ConcurrentAppendWriter> serializer{&region};
+      for (std::uint32_t i = 0; i < kCount; i++) {
+        EXPECT_TRUE(serializer.Write(
+            Entry{thread, i, std::string(i % 32, 'a' + thread)}));
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  // Every record is intact and the records of each thread are in order.
+  std::vector<std::uint32_t> next(kThreads, 0);
+  for (const Entry& entry : ReadEntries(region)) {
+    ASSERT_LT(entry.thread, kThreads);
+    EXPECT_EQ(next[entry.thread], entry.sequence);
+    EXPECT_EQ(std::string(entry.sequence % 32, 'a' + entry.thread),
+              entry.text);
+    next[entry.thread]++;
+  }
+  EXPECT_EQ(std::vector<std::uint32_t>(kThreads, kCount), next);
+}
@@ -0,0 +1,257 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <nop/rpc/coroutine.h>
+
+// Coroutine support is only available when building with C++20, for example
+// with `make WITH_CPP20=true`.
+#if NOP_HAS_COROUTINES
+
+#include <coroutine>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <nop/rpc/interface.h>
+#include <nop/rpc/pipelined_method_receiver.h>
+#include <nop/rpc/pipelined_method_sender.h>
+#include <nop/serializer.h>
+
+#include "test_reader.h"
+#include "test_writer.h"
+
+using nop::BindInterface;
+using nop::Deserializer;
+using nop::ErrorStatus;
+using nop::Interface;
+using nop::MakePipelinedMethodReceiver;
+using nop::MakePipelinedMethodSender;
+using nop::Serializer;
+using nop::Spawn;
+using nop::Status;
+using nop::Task;
+using nop::TestReader;
+using nop::TestWriter;
+
+namespace {
+
+struct CoroutineInterface : Interface<CoroutineInterface> {
+  NOP_INTERFACE("CoroutineInterface");
+
+  NOP_METHOD(Sum, int(int a, int b));
+  NOP_METHOD(Length, std::size_t(const std::string& string));
+  NOP_ONEWAY_METHOD(Log, void(const std::string& message));
+
+  NOP_INTERFACE_API(Sum, Length, Log);
+};
+
+// Suspends coroutines that await Wait() until Resume() is called.
+class Event {
+ public:
+  struct Awaiter {
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+      event->waiting_.push_back(handle);
+    }
+    void await_resume() const noexcept {}
+
+    Event* event;
+  };
+
+  // Awaiting through a separate awaiter, rather than the event itself, keeps
+  // compilers that copy awaitables captured by lambda coroutines working.
+  Awaiter Wait() { return {this}; }
+
+  // Resumes the coroutine that suspended on this event at |index|.
+  void Resume(std::size_t index) { waiting_[index].resume(); }
+
+  std::size_t waiting() const { return waiting_.size(); }
+
+ private:
+  std::vector<std::coroutine_handle<>> waiting_;
+};
+
+Task<int> Square(int value) { co_return value * value; }
+
+}  // anonymous namespace
+
+TEST(CoroutineTests, Task) {
+  int result = 0;
+  Event event;
+
+  auto coroutine = [&]() -> Task<void> {
+    const int square = co_await Square(7);
+    co_await event.Wait();
+    result = square;
+  };
+
+  // Tasks are lazy but spawned tasks run until they first suspend.
+  Task<void> task = coroutine();
+  EXPECT_EQ(0u, event.waiting());
+  Spawn(std::move(task));
+  EXPECT_EQ(1u, event.waiting());
+  EXPECT_EQ(0, result);
+
+  event.Resume(0);
+  EXPECT_EQ(49, result);
+}
+
+TEST(CoroutineTests, InvokeAsync) {
+  TestWriter client_writer;
+  TestReader client_reader;
+  Serializer<TestWriter*> client_serializer{&client_writer};
+  Deserializer<TestReader*> client_deserializer{&client_reader};
+  auto sender =
+      MakePipelinedMethodSender(&client_serializer, &client_deserializer);
+
+  std::vector<int> sums;
+  std::size_t length = 0;
+  auto client = [&]() -> Task<void> {
+    Status<int> sum = co_await CoroutineInterface::Sum::InvokeAsync(&sender,
+                                                                    10, 20);
+    EXPECT_TRUE(sum);
+    sums.push_back(sum.get());
+
+    Status<std::size_t> status =
+        co_await CoroutineInterface::Length::InvokeAsync(&sender, "foobar");
+    EXPECT_TRUE(status);
+    length = status.get();
+  };
+  auto other_client = [&]() -> Task<void> {
+    Status<int> sum =
+        co_await CoroutineInterface::Sum::InvokeAsync(&sender, 1, 2);
+    EXPECT_TRUE(sum);
+    sums.push_back(sum.get());
+  };
+
+  // The coroutines capture by reference, so the lambdas must outlive them.
+  Spawn(client());
+  Spawn(other_client());
+  EXPECT_EQ(2u, sender.pending());
+
+  // Serves the given number of invocations written so far.
+  auto serve = [&](int count) {
+    TestReader server_reader;
+    TestWriter server_writer;
+    Serializer<TestWriter*> server_serializer{&server_writer};
+    Deserializer<TestReader*> server_deserializer{&server_reader};
+    auto receiver =
+        MakePipelinedMethodReceiver(&server_serializer, &server_deserializer);
+    auto dispatcher = BindInterface(
+        CoroutineInterface::Sum::Bind([](int a, int b) { return a + b; }),
+        CoroutineInterface::Length::Bind(
+            [](const std::string& string) { return string.size(); }));
+
+    server_reader.Set(client_writer.data());
+    client_writer.clear();
+    for (int i = 0; i < count; i++)
+      ASSERT_TRUE(dispatcher(&receiver));
+    client_reader.Set(server_writer.data());
+  };
+
+  // Each return value resumes the coroutine that awaits it, which may invoke
+  // further methods.
+  serve(2);
+  ASSERT_TRUE(sender.ReceiveReturn());
+  ASSERT_TRUE(sender.ReceiveReturn());
+  EXPECT_EQ((std::vector<int>{30, 3}), sums);
+  EXPECT_EQ(1u, sender.pending());
+
+  serve(1);
+  ASSERT_TRUE(sender.ReceiveAll());
+  EXPECT_EQ(6u, length);
+
+  // Canceled invocations resume the coroutine with the error.
+  Status<int> failed;
+  auto failing_client = [&]() -> Task<void> {
+    failed = co_await CoroutineInterface::Sum::InvokeAsync(&sender, 1, 2);
+  };
+  Spawn(failing_client());
+  EXPECT_EQ(1u, sender.pending());
+  sender.Cancel(ErrorStatus::IOError);
+  ASSERT_FALSE(failed);
+  EXPECT_EQ(ErrorStatus::IOError, failed.error());
+}
+
+TEST(CoroutineTests, Dispatch) {
+  TestWriter client_writer;
+  TestReader client_reader;
+  Serializer<TestWriter*> client_serializer{&client_writer};
+  Deserializer<TestReader*> client_deserializer{&client_reader};
+  auto sender =
+      MakePipelinedMethodSender(&client_serializer, &client_deserializer);
+
+  TestReader server_reader;
+  TestWriter server_writer;
+  Serializer<TestWriter*> server_serializer{&server_writer};
+  Deserializer<TestReader*> server_deserializer{&server_reader};
+  auto receiver =
+      MakePipelinedMethodReceiver(&server_serializer, &server_deserializer);
+
+  Event event;
+  std::vector<std::string> log;
+  auto dispatcher = BindInterface(
+      CoroutineInterface::Sum::Bind([&](int a, int b) -> Task<int> {
+        co_await event.Wait();
+        co_return a + b;
+      }),
+      CoroutineInterface::Length::Bind(
+          [&](const std::string& string) -> Task<std::size_t> {
+            co_await event.Wait();
+            co_return string.size();
+          }),
+      CoroutineInterface::Log::Bind(
+          [&](const std::string& message) -> Task<void> {
+            co_await event.Wait();
+            log.push_back(message);
+          }));
+
+  std::vector<int> sums;
+  std::size_t length = 0;
+  auto on_sum = [&](Status<int> status) {
+    ASSERT_TRUE(status);
+    sums.push_back(status.get());
+  };
+  ASSERT_TRUE((CoroutineInterface::Sum::InvokeAsync(&sender, on_sum, 1, 2)));
+  ASSERT_TRUE((CoroutineInterface::Length::InvokeAsync(
+      &sender, [&](Status<std::size_t> status) { length = status.get(); },
+      std::string{"foobar"})));
+  ASSERT_TRUE((CoroutineInterface::Log::Invoke(&sender, "hello")));
+  ASSERT_TRUE((CoroutineInterface::Sum::InvokeAsync(&sender, on_sum, 3, 4)));
+
+  // Every handler suspends, so nothing is sent back during dispatch, and the
+  // arguments are kept alive for the handlers after dispatch returns.
+  server_reader.Set(client_writer.data());
+  for (int i = 0; i < 4; i++)
+    ASSERT_TRUE(dispatcher(&receiver));
+  EXPECT_EQ(4u, event.waiting());
+  EXPECT_TRUE(server_writer.data().empty());
+
+  // Return values are sent as the handlers complete, tagged with the request
+  // id of the invocation they belong to.
+  event.Resume(3);
+  event.Resume(2);
+  event.Resume(1);
+  event.Resume(0);
+  EXPECT_EQ((std::vector<std::string>{"hello"}), log);
+
+  client_reader.Set(server_writer.data());
+  ASSERT_TRUE(sender.ReceiveAll());
+  EXPECT_EQ((std::vector<int>{7, 3}), sums);
+  EXPECT_EQ(6u, length);
+}
+
+#endif  // NOP_HAS_COROUTINES
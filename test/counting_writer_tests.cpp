@@ -0,0 +1,151 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/types/file_handle.h>
+#include <nop/utility/counting_writer.h>
+#include <nop/utility/socket_reader.h>
+#include <nop/utility/socket_writer.h>
+#include <nop/utility/vector_writer.h>
+
+#include "test_writer.h"
+
+using nop::CountingWriter;
+using nop::Deserializer;
+using nop::Encoding;
+using nop::Entry;
+using nop::ExactEncodingSize;
+using nop::FileHandle;
+using nop::HandleReference;
+using nop::IsSizeOverestimated;
+using nop::Serializer;
+using nop::SocketReader;
+using nop::SocketWriter;
+using nop::TestWriter;
+using nop::VectorWriter;
+
+namespace {
+
+struct Record {
+  std::uint32_t id;
+  std::string name;
+  std::vector<std::int64_t> values;
+  NOP_STRUCTURE(Record, id, name, values);
+};
+
+struct Attachment {
+  Entry<std::string, 0> name;
+  Entry<FileHandle, 1> file;
+  NOP_TABLE(Attachment, name, file);
+};
+
+// TestWriter that predicts the references it assigns to handles.
+class PredictingWriter : public TestWriter {
+ public:
+  template <typename HandleType>
+  HandleReference PeekHandleReference(const HandleType& handle,
+                                      std::size_t pending) const {
+    if (handle)
+      return handles().size() + pending;
+    else
+      return nop::kEmptyHandleReference;
+  }
+};
+
+}  // anonymous namespace
+
+TEST(CountingWriter, Traits) {
+  EXPECT_FALSE(IsSizeOverestimated<Record>::value);
+  EXPECT_FALSE(IsSizeOverestimated<std::vector<Record>>::value);
+  EXPECT_TRUE(IsSizeOverestimated<FileHandle>::value);
+  EXPECT_TRUE(IsSizeOverestimated<std::vector<FileHandle>>::value);
+  EXPECT_TRUE(IsSizeOverestimated<Attachment>::value);
+}
+
+TEST(CountingWriter, Count) {
+  const Record record{42, "record", {1, -1, 1 << 20, 1ll << 40}};
+
+  CountingWriter<> counting_writer;
+  ASSERT_TRUE(Encoding<Record>::Write(record, &counting_writer));
+
+  VectorWriter vector_writer;
+  ASSERT_TRUE(Encoding<Record>::Write(record, &vector_writer));
+  EXPECT_EQ(vector_writer.size(), counting_writer.size());
+  EXPECT_EQ(Encoding<Record>::Size(record), counting_writer.size());
+}
+
+TEST(CountingWriter, Handles) {
+  // Without predictions only empty handles are counted exactly.
+  EXPECT_EQ(3u, ExactEncodingSize(FileHandle{}).get());
+  EXPECT_EQ(Encoding<FileHandle>::Size(FileHandle{3}),
+            ExactEncodingSize(FileHandle{3}).get());
+
+  // Predicted references are counted at their encoded width.
+  PredictingWriter writer;
+  EXPECT_EQ(3u, ExactEncodingSize(FileHandle{3}, &writer).get());
+  EXPECT_EQ(8u, ExactEncodingSize(std::vector<FileHandle>{FileHandle{3},
+                                                          FileHandle{4}},
+                                  &writer)
+                    .get());
+  EXPECT_TRUE(writer.data().empty());
+}
+
+TEST(CountingWriter, TableEntries) {
+  Attachment attachment;
+  attachment.name = "attachment";
+  attachment.file = FileHandle{3};
+
+  PredictingWriter writer;
+  auto size = ExactEncodingSize(attachment, &writer);
+  ASSERT_TRUE(size);
+  EXPECT_LT(size.get(), Encoding<Attachment>::Size(attachment));
+
+  // Entries are written without padding.
+  ASSERT_TRUE(Encoding<Attachment>::Write(attachment, &writer));
+  EXPECT_EQ(size.get(), writer.data().size());
+}
+
+TEST(CountingWriter, SocketWriter) {
+  int sockets[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+  Serializer<SocketWriter> serializer{sockets[0]};
+  Deserializer<SocketReader> deserializer{sockets[1]};
+
+  Attachment attachment;
+  attachment.name = "attachment";
+  attachment.file = FileHandle{dup(sockets[0])};
+
+  ASSERT_TRUE(serializer.Write(attachment));
+  EXPECT_GT(Encoding<Attachment>::Size(attachment),
+            serializer.writer().buffered());
+  ASSERT_TRUE(serializer.writer().Flush());
+
+  Attachment received;
+  ASSERT_TRUE(deserializer.Read(&received));
+  EXPECT_EQ("attachment", received.name.get());
+  ASSERT_TRUE(received.file);
+  EXPECT_TRUE(received.file.get());
+}
@@ -0,0 +1,175 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include <nop/base/skip.h>
+#include <nop/serializer.h>
+#include <nop/types/delta.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/stream_reader.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::BufferReader;
+using nop::Delta;
+using nop::Deserializer;
+using nop::EncodedLength;
+using nop::ErrorStatus;
+using nop::Serializer;
+using nop::StreamReader;
+using nop::VectorWriter;
+
+namespace {
+
+// Returns the encoding of |value|.
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  EXPECT_EQ(serializer.GetSize(value), serializer.writer().size());
+  return serializer.writer().take();
+}
+
+// Decodes |encoding| into |value|.
+template <typename T>
+nop::Status<void> Decode(const std::vector<std::uint8_t>& encoding, T* value) {
+  Deserializer<BufferReader> deserializer{encoding.data(), encoding.size()};
+  return deserializer.Read(value);
+}
+
+template <typename T>
+T RoundTrip(const T& value) {
+  T decoded;
+  EXPECT_TRUE(Decode(Encode(value), &decoded));
+  return decoded;
+}
+
+}  // anonymous namespace
+
+TEST(Delta, Set) {
+  std::set<std::uint64_t> ids;
+  for (std::uint64_t i = 0; i < 1000; i++)
+    ids.insert(1000000000000ull + i * 37);
+
+  const Delta<std::set<std::uint64_t>> delta{ids};
+  EXPECT_EQ(delta, RoundTrip(delta));
+
+  // One byte per element, plus the first element and the headers.
+  EXPECT_GT(20u, Encode(delta).size() - ids.size());
+  EXPECT_GT(Encode(ids).size() / 7, Encode(delta).size());
+
+  // Decoding reuses and trims the existing elements.
+  Delta<std::set<std::uint64_t>> decoded{{1, 1000000000037ull, ~0ull}};
+  ASSERT_TRUE(Decode(Encode(delta), &decoded));
+  EXPECT_EQ(ids, decoded.get());
+
+  EXPECT_EQ(Delta<std::set<std::uint64_t>>{},
+            RoundTrip(Delta<std::set<std::uint64_t>>{}));
+}
+
+TEST(Delta, Vector) {
+  // Monotonic vectors with runs of small and large differences.
+  std::vector<std::uint32_t> monotonic;
+  for (std::uint32_t i = 0; i < 500; i++)
+    monotonic.push_back(i * (i % 50 < 25 ? 3 : 100000));
+  EXPECT_EQ(Delta<std::vector<std::uint32_t>>{monotonic},
+            RoundTrip(Delta<std::vector<std::uint32_t>>{monotonic}));
+
+  // Vectors in any order, including the extremes of the element type.
+  const Delta<std::vector<std::int64_t>> signed_values{
+      {5, -3, 0, std::numeric_limits<std::int64_t>::min(),
+       std::numeric_limits<std::int64_t>::max(), -1, -2, -3, 10}};
+  EXPECT_EQ(signed_values, RoundTrip(signed_values));
+
+  const Delta<std::vector<std::uint8_t>> bytes{{0, 255, 0, 255, 1, 2, 3}};
+  EXPECT_EQ(bytes, RoundTrip(bytes));
+
+  const Delta<std::vector<std::int16_t>> shorts{{-1, -1, -1, -1, -1, -1, -1,
+                                                 -1, -1, 1, 2, 3, 4, 5, 6, 7,
+                                                 8, 9, -32768, 32767}};
+  EXPECT_EQ(shorts, RoundTrip(shorts));
+
+  // Readers without contiguous input decode through a temporary buffer.
+  const std::vector<std::uint8_t> encoding = Encode(signed_values);
+  Deserializer<StreamReader<std::stringstream>> deserializer{
+      std::string(encoding.begin(), encoding.end())};
+  Delta<std::vector<std::int64_t>> decoded;
+  ASSERT_TRUE(deserializer.Read(&decoded));
+  EXPECT_EQ(signed_values, decoded);
+}
+
+TEST(Delta, Compatibility) {
+  // Delta reads the regular encodings of its container.
+  const std::set<std::int32_t> set{-5, 1, 7, 100};
+  Delta<std::set<std::int32_t>> delta_set;
+  ASSERT_TRUE(Decode(Encode(set), &delta_set));
+  EXPECT_EQ(set, delta_set.get());
+
+  const std::vector<std::uint16_t> vector{1, 2, 3};
+  Delta<std::vector<std::uint16_t>> delta_vector;
+  ASSERT_TRUE(Decode(Encode(vector), &delta_vector));
+  EXPECT_EQ(vector, delta_vector.get());
+
+  // The regular containers reject the compact encoding.
+  std::set<std::int32_t> decoded;
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            Decode(Encode(delta_set), &decoded).error());
+
+  // Extensions are skipped without knowing their type.
+  const std::vector<std::uint8_t> encoding = Encode(delta_set);
+  std::vector<std::uint8_t> padded = encoding;
+  padded.push_back(0);
+  auto length = EncodedLength(padded.data(), padded.size());
+  ASSERT_TRUE(length);
+  EXPECT_EQ(encoding.size(), length.get());
+}
+
+TEST(Delta, Errors) {
+  const Delta<std::vector<std::uint32_t>> value{{1, 2, 300, 70000}};
+  const std::vector<std::uint8_t> encoding = Encode(value);
+  Delta<std::vector<std::uint32_t>> decoded;
+
+  // Unknown extension codes.
+  std::vector<std::uint8_t> unknown = encoding;
+  unknown[1] = 3;
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            Decode(unknown, &decoded).error());
+
+  // Element counts larger than the payload.
+  std::vector<std::uint8_t> count = encoding;
+  count[3] = 100;
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+            Decode(count, &decoded).error());
+
+  // Truncated varints.
+  std::vector<std::uint8_t> truncated = encoding;
+  truncated[2]--;
+  truncated.pop_back();
+  truncated.back() |= 0x80;
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+            Decode(truncated, &decoded).error());
+
+  // Differences out of the range of the element type.
+  const std::vector<std::uint8_t> wide =
+      Encode(Delta<std::vector<std::uint32_t>>{{1000}});
+  Delta<std::vector<std::uint8_t>> narrow;
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+            Decode(wide, &narrow).error());
+}
@@ -0,0 +1,241 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nop/base/skip.h>
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/vector_writer.h>
+
+#include "test_utilities.h"
+
+using nop::BufferReader;
+using nop::Compose;
+using nop::Deserializer;
+using nop::EncodingByte;
+using nop::Entry;
+using nop::ErrorStatus;
+using nop::GetDiffSize;
+using nop::ReadDiff;
+using nop::Serializer;
+using nop::SkipValue;
+using nop::VectorWriter;
+using nop::WriteDiff;
+
+namespace {
+
+struct Vector3 {
+  float x;
+  float y;
+  float z;
+  NOP_STRUCTURE(Vector3, x, y, z);
+};
+
+struct Entity {
+  std::uint32_t id;
+  Vector3 position;
+  std::string label;
+  NOP_STRUCTURE(Entity, id, position, label);
+};
+
+struct Settings {
+  Entry<std::uint32_t, 0> tick_rate;
+  Entry<std::string, 1> map_name;
+  NOP_TABLE(Settings, tick_rate, map_name);
+};
+
+struct World {
+  Entry<std::uint64_t, 0> frame;
+  Entry<Entity, 1> player;
+  Entry<std::vector<Entity>, 2> npcs;
+  Entry<Settings, 3> settings;
+  Entry<std::string, 4> message;
+  NOP_TABLE_NS("World", World, frame, player, npcs, settings, message);
+};
+
+World MakeWorld() {
+  World world;
+  world.frame = 1u;
+  world.player = Entity{1, {1.f, 2.f, 3.f}, "player"};
+  world.npcs = std::vector<Entity>{};
+  for (std::uint32_t i = 0; i < 200; i++)
+    world.npcs.get().push_back({i + 2, {0.f, 0.f, 0.f}, "npc"});
+  world.settings = Settings{};
+  world.settings.get().tick_rate = 60u;
+  world.settings.get().map_name = std::string{"arena"};
+  world.message = std::string{"welcome"};
+  return world;
+}
+
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  VectorWriter writer;
+  Serializer<VectorWriter*> serializer{&writer};
+  EXPECT_TRUE(serializer.Write(value));
+  return writer.take();
+}
+
+// Writes the diff from |previous| to |current| and applies it to |value|.
+void ApplyDiff(const World& previous, const World& current, World* value,
+               std::size_t* size) {
+  VectorWriter writer;
+  ASSERT_TRUE(WriteDiff(previous, current, &writer));
+  *size = writer.size();
+  EXPECT_EQ(GetDiffSize(previous, current), writer.size());
+
+  BufferReader reader{writer.data(), writer.size()};
+  auto status = ReadDiff(value, &reader);
+  ASSERT_TRUE(status) << status.GetErrorMessage();
+  EXPECT_TRUE(reader.empty());
+}
+
+}  // anonymous namespace
+
+TEST(Diff, Unchanged) {
+  const World world = MakeWorld();
+  World subscriber = world;
+  std::size_t size = 0;
+  ApplyDiff(world, world, &subscriber, &size);
+  EXPECT_EQ(Encode(world), Encode(subscriber));
+
+  // An empty diff holds only the table hash and two zero counts.
+  const std::vector<std::uint8_t> expected =
+      Compose(EncodingByte::Extension, 7, 11, EncodingByte::U64,
+              nop::Integer<std::uint64_t>(
+                  nop::EntryListTraits<World>::EntryList::Hash),
+              0, 0);
+  VectorWriter writer;
+  ASSERT_TRUE(WriteDiff(world, world, &writer));
+  EXPECT_EQ(expected, writer.take());
+}
+
+TEST(Diff, Changed) {
+  const World previous = MakeWorld();
+  World current = previous;
+  current.frame = 2u;
+  current.player.get().position.x = 5.f;
+  current.settings.get().map_name = std::string{"canyon"};
+
+  World subscriber = previous;
+  std::size_t size = 0;
+  ApplyDiff(previous, current, &subscriber, &size);
+  EXPECT_EQ(Encode(current), Encode(subscriber));
+  EXPECT_GT(Encode(current).size() / 50, size);
+
+  // Changing one element of a vector sends the whole vector.
+  current.npcs.get()[10].label = "moved";
+  ApplyDiff(previous, current, &subscriber, &size);
+  EXPECT_EQ(Encode(current), Encode(subscriber));
+  EXPECT_LT(Encode(current).size() / 2, size);
+}
+
+TEST(Diff, AddedAndRemoved) {
+  const World previous = MakeWorld();
+  World current = previous;
+  current.message.clear();
+  current.settings.get().tick_rate.clear();
+
+  World subscriber = previous;
+  std::size_t size = 0;
+  ApplyDiff(previous, current, &subscriber, &size);
+  EXPECT_FALSE(subscriber.message);
+  ASSERT_TRUE(subscriber.settings);
+  EXPECT_FALSE(subscriber.settings.get().tick_rate);
+  EXPECT_EQ(Encode(current), Encode(subscriber));
+
+  // Entries that were empty are added in full.
+  ApplyDiff(current, previous, &subscriber, &size);
+  EXPECT_EQ(Encode(previous), Encode(subscriber));
+
+  // A diff from an empty snapshot reproduces the snapshot.
+  World empty;
+  ApplyDiff(World{}, previous, &empty, &size);
+  EXPECT_EQ(Encode(previous), Encode(empty));
+}
+
+TEST(Diff, Snapshot) {
+  // The regular encoding replaces the value in full.
+  const World world = MakeWorld();
+  const std::vector<std::uint8_t> data = Encode(world);
+  BufferReader reader{data.data(), data.size()};
+  World subscriber;
+  subscriber.message = std::string{"stale"};
+  ASSERT_TRUE(ReadDiff(&subscriber, &reader));
+  EXPECT_EQ(data, Encode(subscriber));
+
+  // Structures may be diffed on their own.
+  const Entity previous{1, {1.f, 2.f, 3.f}, "entity"};
+  Entity current = previous;
+  current.position.z = 4.f;
+  VectorWriter writer;
+  ASSERT_TRUE(WriteDiff(previous, current, &writer));
+  const std::vector<std::uint8_t> expected =
+      Compose(EncodingByte::Extension, 8, 12, 1, 1, EncodingByte::Extension,
+              8, 7, 1, 2, EncodingByte::F32, nop::Float(4.f));
+  EXPECT_EQ(expected, std::vector<std::uint8_t>(
+                          writer.data(), writer.data() + writer.size()));
+
+  Entity entity = previous;
+  reader = BufferReader{writer.data(), writer.size()};
+  ASSERT_TRUE(ReadDiff(&entity, &reader));
+  EXPECT_EQ(4.f, entity.position.z);
+
+  // Diffs are skipped as extensions.
+  reader = BufferReader{writer.data(), writer.size()};
+  EXPECT_TRUE(SkipValue(&reader));
+  EXPECT_TRUE(reader.empty());
+}
+
+TEST(Diff, Errors) {
+  Entity entity;
+
+  // Member index out of range.
+  auto data = Compose(EncodingByte::Extension, 8, 3, 1, 3, 0);
+  BufferReader reader{data.data(), data.size()};
+  EXPECT_EQ(ErrorStatus::InvalidMemberCount,
+            ReadDiff(&entity, &reader).error());
+
+  // Unknown extension code.
+  data = Compose(EncodingByte::Extension, 7, 1, 0);
+  reader = BufferReader{data.data(), data.size()};
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            ReadDiff(&entity, &reader).error());
+
+  // Table hash mismatch.
+  Settings settings;
+  data = Compose(EncodingByte::Extension, 7, 3, 1, 0, 0);
+  reader = BufferReader{data.data(), data.size()};
+  EXPECT_EQ(ErrorStatus::InvalidTableHash,
+            ReadDiff(&settings, &reader).error());
+
+  // Payload larger than its size.
+  const World world = MakeWorld();
+  World changed = world;
+  changed.frame = 2u;
+  VectorWriter writer;
+  ASSERT_TRUE(WriteDiff(world, changed, &writer));
+  data = writer.take();
+  data[2]--;
+  reader = BufferReader{data.data(), data.size()};
+  World subscriber = world;
+  EXPECT_EQ(ErrorStatus::ReadLimitReached,
+            ReadDiff(&subscriber, &reader).error());
+}
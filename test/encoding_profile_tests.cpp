@@ -0,0 +1,152 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/encoding_profile.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::BufferReader;
+using nop::Deserializer;
+using nop::EncodingProfile;
+using nop::EncodingTypeName;
+using nop::ProfilingReader;
+using nop::ProfilingWriter;
+using nop::Serializer;
+using nop::VectorWriter;
+
+namespace {
+
+struct Record {
+  std::uint32_t id;
+  std::string name;
+  std::vector<std::string> tags;
+  NOP_STRUCTURE(Record, id, name, tags);
+};
+
+// Returns the entry of T in |profile|, or an empty entry if there is none.
+template <typename T>
+EncodingProfile::Entry Find(const EncodingProfile& profile) {
+  for (const auto& entry : profile.entries()) {
+    if (entry.name == EncodingTypeName<T>())
+      return entry;
+  }
+  return EncodingProfile::Entry{"", 0, 0, 0, 0, 0};
+}
+
+}  // anonymous namespace
+
+TEST(EncodingProfile, TypeName) {
+  EXPECT_EQ("int", EncodingTypeName<int>());
+  EXPECT_NE(std::string::npos, EncodingTypeName<Record>().find("Record"));
+  EXPECT_NE(EncodingTypeName<std::string>(),
+            EncodingTypeName<std::vector<std::string>>());
+}
+
+TEST(EncodingProfile, Writer) {
+  EncodingProfile profile;
+  VectorWriter writer;
+  Serializer<ProfilingWriter<VectorWriter>> serializer{&writer, &profile};
+
+  const Record record{1000, "abc", {"x", "yz"}};
+  ASSERT_TRUE(serializer.Write(record));
+  ASSERT_TRUE(serializer.Write(record));
+
+  // Each byte is attributed to the innermost value.
+  const auto record_entry = Find<Record>(profile);
+  EXPECT_EQ(2u, record_entry.calls);
+  EXPECT_EQ(2u, record_entry.prefix_bytes);
+  EXPECT_EQ(0u, record_entry.payload_bytes);
+
+  const auto id_entry = Find<std::uint32_t>(profile);
+  EXPECT_EQ(2u, id_entry.calls);
+  EXPECT_EQ(2u, id_entry.prefix_bytes);
+  EXPECT_EQ(2u * 2u, id_entry.payload_bytes);
+
+  // The member count and the string lengths are written as std::uint64_t.
+  const auto size_entry = Find<std::uint64_t>(profile);
+  EXPECT_EQ(2u * 5u, size_entry.calls);
+  EXPECT_EQ(2u * 5u, size_entry.prefix_bytes);
+  EXPECT_EQ(0u, size_entry.payload_bytes);
+
+  const auto string_entry = Find<std::string>(profile);
+  EXPECT_EQ(2u * 3u, string_entry.calls);
+  EXPECT_EQ(2u * 3u, string_entry.prefix_bytes);
+  EXPECT_EQ(2u * 6u, string_entry.payload_bytes);
+
+  const auto tags_entry = Find<std::vector<std::string>>(profile);
+  EXPECT_EQ(2u, tags_entry.calls);
+  EXPECT_EQ(2u, tags_entry.prefix_bytes);
+
+  // Every byte is attributed to some type.
+  std::uint64_t total = 0;
+  for (const auto& entry : profile.entries())
+    total += entry.total_bytes();
+  EXPECT_EQ(writer.size(), total);
+
+  // Bytes outside of any value are attributed to "(none)".
+  ASSERT_TRUE(serializer.writer().Skip(3));
+  const auto entries = profile.entries();
+  auto none = std::find_if(entries.begin(), entries.end(),
+                           [](const EncodingProfile::Entry& entry) {
+                             return entry.name == "(none)";
+                           });
+  ASSERT_NE(entries.end(), none);
+  EXPECT_EQ(3u, none->padding_bytes);
+
+  const std::string report = profile.Report();
+  EXPECT_NE(std::string::npos, report.find("payload"));
+  EXPECT_NE(std::string::npos, report.find(EncodingTypeName<Record>()));
+
+  profile.Clear();
+  EXPECT_TRUE(profile.entries().empty());
+}
+
+TEST(EncodingProfile, Reader) {
+  VectorWriter writer;
+  Serializer<VectorWriter*> serializer{&writer};
+  const Record record{1000, "abc", {"x", "yz"}};
+  ASSERT_TRUE(serializer.Write(record));
+
+  EncodingProfile profile;
+  BufferReader buffer_reader{writer.data(), writer.size()};
+  Deserializer<ProfilingReader<BufferReader>> deserializer{&buffer_reader,
+                                                           &profile};
+  Record value;
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ("abc", value.name);
+
+  const auto string_entry = Find<std::string>(profile);
+  EXPECT_EQ(3u, string_entry.calls);
+  EXPECT_EQ(3u, string_entry.prefix_bytes);
+  EXPECT_EQ(6u, string_entry.payload_bytes);
+
+  const auto id_entry = Find<std::uint32_t>(profile);
+  EXPECT_EQ(1u, id_entry.calls);
+  EXPECT_EQ(2u, id_entry.payload_bytes);
+
+  std::uint64_t total = 0;
+  for (const auto& entry : profile.entries())
+    total += entry.total_bytes();
+  EXPECT_EQ(writer.size(), total);
+}
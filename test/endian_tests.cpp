@@ -17,10 +17,14 @@
 #include <algorithm>
 #include <cstdint>
 #include <type_traits>
+#include <vector>
 
 #include <nop/utility/endian.h>
 
+using nop::FromLittleEndian;
 using nop::HostEndian;
+using nop::SwapBytes;
+using nop::ToLittleEndian;
 
 namespace {
 
@@ -46,6 +50,27 @@ struct Bytes {
   T value;
 };
 
+// Checks SwapBytes() against HostEndian for ranges of every length up to a few
+// vectors, so that both the vector and the scalar paths are covered.
+template <typename T>
+void CheckSwapBytes() {
+  for (std::size_t length = 0; length < 40; length++) {
+    std::vector<T> values(length);
+    for (std::size_t i = 0; i < length; i++)
+      values[i] = static_cast<T>(0x0123456789abcdefull * (i + 1));
+
+    std::vector<T> swapped = values;
+    SwapBytes(swapped.data(), swapped.data() + swapped.size());
+    for (std::size_t i = 0; i < length; i++) {
+      EXPECT_EQ(HostEndian<T>::FromBig(HostEndian<T>::ToLittle(values[i])),
+                swapped[i]);
+    }
+
+    SwapBytes(swapped.data(), swapped.data() + swapped.size());
+    EXPECT_EQ(values, swapped);
+  }
+}
+
 }  // anonymous namespace
 
 TEST(EndianTests, Little) {
@@ -166,3 +191,35 @@ TEST(EndianTests, Big) {
               HostEndian<std::int64_t>::ToBig(0x7766554433221100LL));
   }
 }
+
+TEST(EndianTests, SwapBytes) {
+  CheckSwapBytes<std::uint8_t>();
+  CheckSwapBytes<std::uint16_t>();
+  CheckSwapBytes<std::uint32_t>();
+  CheckSwapBytes<std::uint64_t>();
+
+  struct Triple {
+    std::uint8_t bytes[3];
+  };
+  Triple triples[2] = {{{1, 2, 3}}, {{4, 5, 6}}};
+  SwapBytes(&triples[0], &triples[2]);
+  EXPECT_EQ(3, triples[0].bytes[0]);
+  EXPECT_EQ(1, triples[0].bytes[2]);
+  EXPECT_EQ(6, triples[1].bytes[0]);
+}
+
+TEST(EndianTests, LittleEndianRange) {
+  const std::uint32_t expected[] = {0x03020100, 0x07060504};
+  const std::uint8_t bytes[] = {0, 1, 2, 3, 4, 5, 6, 7};
+  std::uint32_t values[2];
+  std::copy(bytes, bytes + sizeof(bytes),
+            reinterpret_cast<std::uint8_t*>(values));
+
+  FromLittleEndian(&values[0], &values[2]);
+  EXPECT_EQ(expected[0], values[0]);
+  EXPECT_EQ(expected[1], values[1]);
+
+  ToLittleEndian(&values[0], &values[2]);
+  EXPECT_TRUE(std::equal(bytes, bytes + sizeof(bytes),
+                         reinterpret_cast<const std::uint8_t*>(values)));
+}
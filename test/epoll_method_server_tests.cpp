@@ -0,0 +1,303 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <nop/rpc/epoll_method_server.h>
+#include <nop/rpc/interface.h>
+#include <nop/rpc/pipelined_method_receiver.h>
+#include <nop/rpc/pipelined_method_sender.h>
+#include <nop/serializer.h>
+#include <nop/utility/fd_reader.h>
+#include <nop/utility/fd_writer.h>
+#include <nop/utility/vector_writer.h>
+#include <nop/utility/work_stealing_executor.h>
+
+using nop::BindInterface;
+using nop::Deserializer;
+using nop::EpollMethodServer;
+using nop::FdReader;
+using nop::FdWriter;
+using nop::Interface;
+using nop::MakePipelinedMethodSender;
+using nop::PipelinedMethodReceiver;
+using nop::Serializer;
+using nop::Status;
+using nop::VectorWriter;
+using nop::WorkStealingExecutor;
+
+namespace {
+
+struct ServerInterface : Interface<ServerInterface> {
+  NOP_INTERFACE("io.github.eieio.ServerInterface");
+
+  NOP_METHOD(Sum, int(int a, int b));
+  NOP_METHOD(Length, std::size_t(const std::string& string));
+
+  NOP_INTERFACE_API(Sum, Length);
+};
+
+auto BindServer() {
+  return BindInterface(
+      ServerInterface::Sum::Bind([](int a, int b) { return a + b; }),
+      ServerInterface::Length::Bind(
+          [](const std::string& string) { return string.size(); }));
+}
+
+using Dispatcher = decltype(BindServer());
+
+// Appends an invocation in the format read by SimpleMethodReceiver.
+template <typename Method, typename... Args>
+void AppendInvocation(Serializer<VectorWriter>* serializer, Args&&... args) {
+  ASSERT_TRUE(serializer->Write(
+      static_cast<std::uint64_t>(Method::Selector)));
+  ASSERT_TRUE(serializer->Write(std::forward_as_tuple(args...)));
+}
+
+void WriteAll(int fd, const std::uint8_t* data, std::size_t size) {
+  while (size > 0) {
+    const ssize_t ret = write(fd, data, size);
+    ASSERT_LT(0, ret);
+    data += ret;
+    size -= ret;
+  }
+}
+
+// Polls the server until it dispatches |count| invocations, failing if that
+// takes too many polls. Polls that only receive input for the executor do not
+// count any invocations.
+template <typename Server>
+void PollFor(Server* server, std::size_t count) {
+  for (int polls = 0; count > 0; polls++) {
+    ASSERT_GT(100, polls);
+    auto status = server->Poll(1000);
+    ASSERT_TRUE(status);
+    ASSERT_GE(count, status.get());
+    count -= status.get();
+  }
+}
+
+// Returns true if the peer of |fd| has closed the connection.
+bool IsClosed(int fd) {
+  std::uint8_t byte;
+  return read(fd, &byte, 1) == 0;
+}
+
+}  // anonymous namespace
+
+TEST(EpollMethodServer, Dispatch) {
+  EpollMethodServer<Dispatcher> server{BindServer()};
+
+  int fds_a[2];
+  int fds_b[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_a));
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_b));
+  ASSERT_TRUE(server.AddConnection(fds_a[0]));
+  ASSERT_TRUE(server.AddConnection(fds_b[0]));
+  EXPECT_EQ(2u, server.connections());
+
+  Deserializer<FdReader> client_a{fds_a[1]};
+  Deserializer<FdReader> client_b{fds_b[1]};
+
+  Serializer<VectorWriter> invocations;
+  AppendInvocation<ServerInterface::Sum>(&invocations, 10, 20);
+  AppendInvocation<ServerInterface::Length>(&invocations,
+                                            std::string{"foobar"});
+  const std::uint8_t* data = invocations.writer().data();
+  const std::size_t size = invocations.writer().size();
+
+  // Partial invocations are buffered until the rest arrives.
+  WriteAll(fds_a[1], data, 3);
+  auto status = server.Poll(1000);
+  ASSERT_TRUE(status);
+  EXPECT_EQ(0u, status.get());
+
+  WriteAll(fds_a[1], data + 3, size - 3);
+  WriteAll(fds_b[1], data, size);
+  PollFor(&server, 4);
+
+  for (auto* client : {&client_a, &client_b}) {
+    int sum = 0;
+    std::size_t length = 0;
+    ASSERT_TRUE(client->Read(&sum));
+    ASSERT_TRUE(client->Read(&length));
+    EXPECT_EQ(30, sum);
+    EXPECT_EQ(6u, length);
+  }
+
+  // Closed connections are removed from the server.
+  client_b.reader().Clear();
+  status = server.Poll(1000);
+  ASSERT_TRUE(status);
+  EXPECT_EQ(1u, server.connections());
+}
+
+TEST(EpollMethodServer, Pipelined) {
+  EpollMethodServer<Dispatcher, PipelinedMethodReceiver> server{BindServer()};
+
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  ASSERT_TRUE(server.AddConnection(fds[0]));
+
+  Serializer<FdWriter> serializer{dup(fds[1])};
+  Deserializer<FdReader> deserializer{fds[1]};
+  auto sender = MakePipelinedMethodSender(&serializer, &deserializer);
+
+  std::vector<int> sums;
+  auto on_sum = [&](Status<int> status) {
+    ASSERT_TRUE(status);
+    sums.push_back(status.get());
+  };
+  std::size_t length = 0;
+  auto on_length = [&](Status<std::size_t> status) {
+    ASSERT_TRUE(status);
+    length = status.get();
+  };
+
+  ASSERT_TRUE((ServerInterface::Sum::InvokeAsync(&sender, on_sum, 1, 2)));
+  ASSERT_TRUE((ServerInterface::Length::InvokeAsync(&sender, on_length, "x")));
+  ASSERT_TRUE((ServerInterface::Sum::InvokeAsync(&sender, on_sum, 3, 4)));
+
+  PollFor(&server, 3);
+
+  ASSERT_TRUE(sender.ReceiveAll());
+  EXPECT_EQ((std::vector<int>{3, 7}), sums);
+  EXPECT_EQ(1u, length);
+}
+
+TEST(EpollMethodServer, CloseOnError) {
+  EpollMethodServer<Dispatcher> server{BindServer(), 64};
+
+  int fds_a[2];
+  int fds_b[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_a));
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_b));
+  ASSERT_TRUE(server.AddConnection(fds_a[0]));
+  ASSERT_TRUE(server.AddConnection(fds_b[0]));
+
+  // Invocations of unknown methods fail to dispatch.
+  Serializer<VectorWriter> invalid;
+  ASSERT_TRUE(invalid.Write(std::uint64_t{1}));
+  ASSERT_TRUE(invalid.Write(std::make_tuple(1, 2)));
+  WriteAll(fds_a[1], invalid.writer().data(), invalid.writer().size());
+
+  // Invocations larger than the maximum are not buffered.
+  Serializer<VectorWriter> large;
+  AppendInvocation<ServerInterface::Length>(&large, std::string(128, 'x'));
+  WriteAll(fds_b[1], large.writer().data(), 96);
+
+  while (server.connections() > 0)
+    ASSERT_TRUE(server.Poll(1000));
+
+  EXPECT_TRUE(IsClosed(fds_a[1]));
+  EXPECT_TRUE(IsClosed(fds_b[1]));
+  close(fds_a[1]);
+  close(fds_b[1]);
+}
+
+TEST(EpollMethodServer, Listen) {
+  EpollMethodServer<Dispatcher> server{BindServer()};
+
+  // Use an abstract socket address to avoid touching the filesystem.
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  const std::string name = "nop-epoll-test-" + std::to_string(getpid());
+  std::memcpy(address.sun_path + 1, name.data(), name.size());
+  const socklen_t address_size =
+      static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + name.size());
+
+  const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_LE(0, listen_fd);
+  ASSERT_EQ(0, bind(listen_fd, reinterpret_cast<sockaddr*>(&address),
+                    address_size));
+  ASSERT_EQ(0, listen(listen_fd, 8));
+  ASSERT_TRUE(server.Listen(listen_fd));
+
+  const int client_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_LE(0, client_fd);
+  ASSERT_EQ(0, connect(client_fd, reinterpret_cast<sockaddr*>(&address),
+                       address_size));
+
+  while (server.connections() == 0)
+    ASSERT_TRUE(server.Poll(1000));
+
+  Serializer<VectorWriter> invocation;
+  AppendInvocation<ServerInterface::Sum>(&invocation, 2, 3);
+  WriteAll(client_fd, invocation.writer().data(), invocation.writer().size());
+  PollFor(&server, 1);
+
+  Deserializer<FdReader> client{client_fd};
+  int sum = 0;
+  ASSERT_TRUE(client.Read(&sum));
+  EXPECT_EQ(5, sum);
+}
+
+TEST(EpollMethodServer, Executor) {
+  // Sum sleeps for |a| milliseconds so that later invocations tend to complete
+  // before earlier ones.
+  auto dispatcher = BindInterface(ServerInterface::Sum::Bind([](int a, int b) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{a});
+    return a + b;
+  }));
+  EpollMethodServer<decltype(dispatcher)> server{dispatcher};
+  WorkStealingExecutor executor{4};
+  server.SetExecutor(&executor);
+
+  int fds_a[2];
+  int fds_b[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_a));
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_b));
+  ASSERT_TRUE(server.AddConnection(fds_a[0]));
+  ASSERT_TRUE(server.AddConnection(fds_b[0]));
+
+  Serializer<VectorWriter> invocations;
+  for (int i = 0; i < 8; i++)
+    AppendInvocation<ServerInterface::Sum>(&invocations, 8 - i, i * 10);
+  WriteAll(fds_a[1], invocations.writer().data(), invocations.writer().size());
+  WriteAll(fds_b[1], invocations.writer().data(), invocations.writer().size());
+
+  PollFor(&server, 16);
+
+  Deserializer<FdReader> client_a{fds_a[1]};
+  Deserializer<FdReader> client_b{fds_b[1]};
+  for (auto* client : {&client_a, &client_b}) {
+    for (int i = 0; i < 8; i++) {
+      int sum = 0;
+      ASSERT_TRUE(client->Read(&sum));
+      EXPECT_EQ(8 - i + i * 10, sum);
+    }
+  }
+
+  // Invocations that fail on the executor close their connection.
+  Serializer<VectorWriter> invalid;
+  ASSERT_TRUE(invalid.Write(std::uint64_t{1}));
+  ASSERT_TRUE(invalid.Write(std::make_tuple(1, 2)));
+  WriteAll(fds_b[1], invalid.writer().data(), invalid.writer().size());
+  PollFor(&server, 1);
+  EXPECT_EQ(1u, server.connections());
+  EXPECT_TRUE(IsClosed(fds_b[1]));
+}
@@ -0,0 +1,651 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/types/file_handle.h>
+#include <nop/types/view.h>
+#include <nop/utility/buffered_fd_reader.h>
+#include <nop/utility/buffered_fd_writer.h>
+#include <nop/utility/fd_reader.h>
+#include <nop/utility/fd_writer.h>
+#include <nop/utility/io_uring.h>
+#include <nop/utility/iovec_writer.h>
+#include <nop/utility/mmap_reader.h>
+#include <nop/utility/mmap_writer.h>
+#include <nop/utility/socket_reader.h>
+#include <nop/utility/socket_writer.h>
+#include <nop/utility/tcp_writer.h>
+
+using nop::BufferedFdReader;
+using nop::BufferedFdWriter;
+using nop::Deserializer;
+using nop::Entry;
+using nop::ErrorStatus;
+using nop::FdReader;
+using nop::FdWriter;
+using nop::FileHandle;
+using nop::IoUring;
+using nop::IoUringReader;
+using nop::IoUringWriter;
+using nop::IovecWriter;
+using nop::MmapReader;
+using nop::MmapWriter;
+using nop::Serializer;
+using nop::SocketReader;
+using nop::SocketWriter;
+using nop::StringView;
+using nop::TcpWriter;
+using nop::UniqueFileHandle;
+
+namespace {
+
+struct TestMessage {
+  std::uint32_t id;
+  std::string name;
+  std::vector<std::uint8_t> payload;
+  NOP_STRUCTURE(TestMessage, id, name, payload);
+};
+
+bool operator==(const TestMessage& a, const TestMessage& b) {
+  return a.id == b.id && a.name == b.name && a.payload == b.payload;
+}
+
+std::vector<TestMessage> MakeMessages() {
+  std::vector<TestMessage> messages;
+  for (std::uint32_t i = 0; i < 64; i++) {
+    messages.push_back(TestMessage{i * 1000, std::string(i, 'a' + i % 26),
+                                   std::vector<std::uint8_t>(i * 97, i)});
+  }
+  return messages;
+}
+
+struct TestTable {
+  Entry<std::string, 0> name;
+  Entry<std::vector<std::uint32_t>, 1> values;
+  NOP_TABLE(TestTable, name, values);
+};
+
+struct HandleMessage {
+  std::string name;
+  FileHandle handle;
+  std::vector<FileHandle> handles;
+  NOP_STRUCTURE(HandleMessage, name, handle, handles);
+};
+
+struct ViewMessage {
+  std::uint32_t id;
+  StringView name;
+  std::vector<std::uint8_t> payload;
+  NOP_STRUCTURE(ViewMessage, id, name, payload);
+};
+
+// Returns the fd of a new, empty temporary file.
+int MakeTemporaryFile() {
+  char path[] = "/tmp/nop_fd_tests_XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd >= 0)
+    unlink(path);
+  return fd;
+}
+
+// Writes each message to a pipe from another thread and reads them back with
+// the given reader type, exercising partial reads from the kernel.
+template <typename Reader, typename Writer = FdWriter, typename... Args>
+void RoundTrip(const std::vector<TestMessage>& messages, Args&&... args) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+
+  std::thread writer_thread{[&messages, fd = fds[1]] {
+    Serializer<Writer> serializer{fd};
+    for (const auto& message : messages)
+      ASSERT_TRUE(serializer.Write(message));
+  }};
+
+  Deserializer<Reader> deserializer{fds[0], std::forward<Args>(args)...};
+  for (const auto& expected : messages) {
+    TestMessage message;
+    auto status = deserializer.Read(&message);
+    ASSERT_TRUE(status) << status.GetErrorMessage();
+    EXPECT_EQ(expected, message);
+  }
+
+  writer_thread.join();
+
+  TestMessage message;
+  auto status = deserializer.Read(&message);
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, status.error());
+}
+
+// Connects a pair of TCP sockets over loopback. Returns false if TCP is not
+// available.
+bool MakeTcpPair(int fds[2]) {
+  const int listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0)
+    return false;
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  const bool listening =
+      bind(listener, reinterpret_cast<sockaddr*>(&address), length) == 0 &&
+      listen(listener, 1) == 0 &&
+      getsockname(listener, reinterpret_cast<sockaddr*>(&address),
+                  &length) == 0;
+
+  fds[0] = fds[1] = -1;
+  if (listening) {
+    fds[1] = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fds[1], reinterpret_cast<sockaddr*>(&address), length) == 0)
+      fds[0] = accept(listener, nullptr, nullptr);
+  }
+  close(listener);
+
+  if (fds[0] < 0) {
+    close(fds[1]);
+    return false;
+  }
+  return true;
+}
+
+}  // anonymous namespace
+
+TEST(FdReader, RoundTrip) { RoundTrip<FdReader>(MakeMessages()); }
+
+TEST(BufferedFdReader, RoundTrip) {
+  const auto messages = MakeMessages();
+  RoundTrip<BufferedFdReader>(messages);
+  RoundTrip<BufferedFdReader>(messages, std::size_t{1});
+  RoundTrip<BufferedFdReader>(messages, std::size_t{7});
+  RoundTrip<BufferedFdReader>(messages, std::size_t{1 << 16});
+}
+
+TEST(BufferedFdReader, Skip) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+
+  FdWriter writer{fds[1]};
+  const std::vector<std::uint8_t> data{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  ASSERT_TRUE(writer.Write(&*data.begin(), &*data.end()));
+  writer.Clear();
+
+  BufferedFdReader reader{fds[0], 4};
+  std::uint8_t byte = 0;
+  ASSERT_TRUE(reader.Read(&byte));
+  EXPECT_EQ(0u, byte);
+  EXPECT_EQ(3u, reader.buffered());
+
+  ASSERT_TRUE(reader.Skip(5));
+  ASSERT_TRUE(reader.Read(&byte));
+  EXPECT_EQ(6u, byte);
+
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, reader.Skip(4).error());
+}
+
+TEST(BufferedFdReader, Release) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+
+  BufferedFdReader reader{fds[0]};
+  EXPECT_EQ(fds[0], reader.Release());
+  EXPECT_EQ(0u, reader.buffered());
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(BufferedFdWriter, RoundTrip) {
+  const auto messages = MakeMessages();
+  RoundTrip<FdReader, BufferedFdWriter>(messages);
+  RoundTrip<BufferedFdReader, BufferedFdWriter>(messages);
+}
+
+TEST(BufferedFdWriter, Flush) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+
+  Serializer<BufferedFdWriter> serializer{fds[1], std::size_t{16},
+                                          std::size_t{64}};
+  Deserializer<FdReader> deserializer{fds[0]};
+
+  // Small values accumulate in the buffer until flushed.
+  ASSERT_TRUE(serializer.Write(std::string{"abc"}));
+  ASSERT_TRUE(serializer.Write(std::uint32_t{1u << 20}));
+  EXPECT_EQ(10u, serializer.writer().buffered());
+
+  ASSERT_TRUE(serializer.writer().Flush());
+  EXPECT_EQ(0u, serializer.writer().buffered());
+
+  std::string string_value;
+  std::uint32_t integer_value = 0;
+  ASSERT_TRUE(deserializer.Read(&string_value));
+  ASSERT_TRUE(deserializer.Read(&integer_value));
+  EXPECT_EQ("abc", string_value);
+  EXPECT_EQ(1u << 20, integer_value);
+
+  // Prepare() grows the buffer up to the maximum size.
+  ASSERT_TRUE(serializer.Write(std::string(30, 'x')));
+  EXPECT_EQ(32u, serializer.writer().capacity());
+  EXPECT_EQ(32u, serializer.writer().buffered());
+
+  // Values larger than the maximum buffer size are written through.
+  ASSERT_TRUE(serializer.Write(std::string(100, 'y')));
+  EXPECT_EQ(64u, serializer.writer().capacity());
+  EXPECT_EQ(0u, serializer.writer().buffered());
+
+  ASSERT_TRUE(deserializer.Read(&string_value));
+  EXPECT_EQ(std::string(30, 'x'), string_value);
+  ASSERT_TRUE(deserializer.Read(&string_value));
+  EXPECT_EQ(std::string(100, 'y'), string_value);
+
+  // Destroying the writer flushes any buffered data.
+  TestTable table;
+  table.name = "table";
+  table.values = std::vector<std::uint32_t>{1, 2, 3};
+  ASSERT_TRUE(serializer.Write(table));
+  EXPECT_NE(0u, serializer.writer().buffered());
+  serializer.writer().Clear();
+
+  TestTable read_table;
+  ASSERT_TRUE(deserializer.Read(&read_table));
+  EXPECT_EQ("table", read_table.name.get());
+  EXPECT_EQ((std::vector<std::uint32_t>{1, 2, 3}), read_table.values.get());
+  EXPECT_EQ(ErrorStatus::ReadLimitReached,
+            deserializer.Read(&read_table).error());
+}
+
+TEST(IovecWriter, Write) {
+  const auto messages = MakeMessages();
+
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+
+  // Payloads of at least 1000 bytes are referenced instead of copied.
+  Serializer<IovecWriter> serializer{std::size_t{1000}};
+  std::size_t referenced_bytes = 0;
+  for (const auto& message : messages) {
+    ASSERT_TRUE(serializer.Write(message));
+    if (message.payload.size() >= 1000)
+      referenced_bytes += message.payload.size();
+  }
+
+  const std::size_t total_bytes = serializer.writer().size();
+  EXPECT_NE(0u, referenced_bytes);
+  EXPECT_EQ(total_bytes - referenced_bytes, serializer.writer().scratch_size());
+
+  std::size_t iovec_bytes = 0;
+  bool found_payload = false;
+  for (const iovec& vec : serializer.writer().iovecs()) {
+    iovec_bytes += vec.iov_len;
+    found_payload |= vec.iov_base == messages.back().payload.data();
+  }
+  EXPECT_EQ(total_bytes, iovec_bytes);
+  EXPECT_TRUE(found_payload);
+
+  std::thread writer_thread{[&serializer, fd = fds[1]] {
+    ASSERT_TRUE(serializer.writer().WriteTo(fd));
+    close(fd);
+  }};
+
+  Deserializer<FdReader> deserializer{fds[0]};
+  for (const auto& expected : messages) {
+    TestMessage message;
+    auto status = deserializer.Read(&message);
+    ASSERT_TRUE(status) << status.GetErrorMessage();
+    EXPECT_EQ(expected, message);
+  }
+
+  writer_thread.join();
+
+  TestMessage message;
+  EXPECT_EQ(ErrorStatus::ReadLimitReached,
+            deserializer.Read(&message).error());
+
+  serializer.writer().clear();
+  EXPECT_EQ(0u, serializer.writer().size());
+  EXPECT_TRUE(serializer.writer().iovecs().empty());
+}
+
+TEST(SocketWriter, Handles) {
+  int sockets[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+
+  int pipe_fds[2];
+  ASSERT_EQ(0, pipe(pipe_fds));
+  UniqueFileHandle pipe_reader{pipe_fds[0]};
+  UniqueFileHandle pipe_writer{pipe_fds[1]};
+
+  Serializer<SocketWriter> serializer{sockets[0]};
+  Deserializer<SocketReader> deserializer{sockets[1], std::size_t{64}};
+
+  // Send more handles than fit in a single call to sendmsg().
+  HandleMessage message{"pipe", FileHandle{pipe_fds[1]},
+                        std::vector<FileHandle>(300, FileHandle{pipe_fds[0]})};
+  message.handles.push_back(FileHandle{});
+  ASSERT_TRUE(serializer.Write(message));
+  EXPECT_EQ(301u, serializer.writer().buffered_handles());
+  ASSERT_TRUE(serializer.writer().Flush());
+  EXPECT_EQ(0u, serializer.writer().buffered());
+  EXPECT_EQ(0u, serializer.writer().buffered_handles());
+
+  // A second message continues the handle numbering.
+  ASSERT_TRUE(serializer.Write(FileHandle{pipe_fds[1]}));
+  ASSERT_TRUE(serializer.writer().Flush());
+
+  HandleMessage read_message;
+  auto status = deserializer.Read(&read_message);
+  ASSERT_TRUE(status) << status.GetErrorMessage();
+  EXPECT_EQ("pipe", read_message.name);
+  ASSERT_EQ(301u, read_message.handles.size());
+  EXPECT_FALSE(read_message.handles.back());
+  read_message.handles.pop_back();
+
+  // The received handles refer to the same pipe.
+  UniqueFileHandle writer{read_message.handle.get()};
+  ASSERT_TRUE(writer);
+  EXPECT_NE(pipe_fds[1], writer.get());
+  std::vector<UniqueFileHandle> readers;
+  for (const FileHandle& handle : read_message.handles) {
+    ASSERT_TRUE(handle);
+    readers.emplace_back(handle.get());
+  }
+
+  const char data[] = "abc";
+  ASSERT_EQ(3, write(writer.get(), data, 3));
+  char buffer[3];
+  ASSERT_EQ(3, read(readers.back().get(), buffer, 3));
+  EXPECT_EQ(std::string(data), std::string(buffer, 3));
+
+  FileHandle handle;
+  ASSERT_TRUE(deserializer.Read(&handle));
+  UniqueFileHandle second_writer{handle.get()};
+  EXPECT_TRUE(second_writer);
+  EXPECT_EQ(0u, deserializer.reader().pending_handles());
+
+  // Handles may only be claimed once.
+  EXPECT_EQ(ErrorStatus::InvalidHandleReference,
+            deserializer.reader().GetHandle<FileHandle>(0).error());
+
+  serializer.writer().Clear();
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, deserializer.Read(&handle).error());
+}
+
+TEST(SocketWriter, CachedHandles) {
+  int sockets[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+
+  int pipe_fds[2];
+  ASSERT_EQ(0, pipe(pipe_fds));
+  UniqueFileHandle pipe_reader{pipe_fds[0]};
+  UniqueFileHandle pipe_writer{pipe_fds[1]};
+
+  Serializer<SocketWriter> serializer{sockets[0]};
+  Deserializer<SocketReader> deserializer{sockets[1]};
+
+  ASSERT_TRUE(serializer.writer().CacheHandle(FileHandle{pipe_fds[1]}));
+  EXPECT_EQ(1u, serializer.writer().cached_handles());
+
+  // Only the first push of a cached handle transfers it.
+  ASSERT_TRUE(serializer.Write(FileHandle{pipe_fds[0]}));
+  ASSERT_TRUE(serializer.Write(FileHandle{pipe_fds[1]}));
+  EXPECT_EQ(2u, serializer.writer().buffered_handles());
+  ASSERT_TRUE(serializer.writer().Flush());
+  ASSERT_TRUE(serializer.Write(FileHandle{pipe_fds[1]}));
+  EXPECT_EQ(0u, serializer.writer().buffered_handles());
+  ASSERT_TRUE(serializer.writer().Flush());
+
+  FileHandle handle;
+  ASSERT_TRUE(deserializer.Read(&handle));
+  UniqueFileHandle reader{handle.get()};
+  EXPECT_TRUE(reader);
+
+  FileHandle cached;
+  ASSERT_TRUE(deserializer.Read(&cached));
+  ASSERT_TRUE(cached);
+  EXPECT_EQ(1u, deserializer.reader().cached_handles());
+  EXPECT_EQ(0u, deserializer.reader().pending_handles());
+
+  // Later references resolve to the same handle owned by the reader.
+  FileHandle cached_again;
+  ASSERT_TRUE(deserializer.Read(&cached_again));
+  EXPECT_EQ(cached.get(), cached_again.get());
+
+  const char data[] = "abc";
+  ASSERT_EQ(3, write(cached.get(), data, 3));
+  char buffer[3];
+  ASSERT_EQ(3, read(pipe_fds[0], buffer, 3));
+  EXPECT_EQ(std::string(data), std::string(buffer, 3));
+
+  // Evicting the handle on both ends closes the reader's copy.
+  auto eviction = serializer.writer().EvictHandle(FileHandle{pipe_fds[1]});
+  ASSERT_TRUE(eviction);
+  EXPECT_EQ(0u, serializer.writer().cached_handles());
+  EXPECT_EQ(ErrorStatus::InvalidHandleValue,
+            serializer.writer().EvictHandle(FileHandle{pipe_fds[1]}).error());
+
+  ASSERT_TRUE(deserializer.reader().EvictHandle(eviction.get()));
+  EXPECT_EQ(0u, deserializer.reader().cached_handles());
+  EXPECT_EQ(-1, fcntl(cached.get(), F_GETFD));
+  EXPECT_EQ(ErrorStatus::InvalidHandleReference,
+            deserializer.reader().EvictHandle(eviction.get()).error());
+
+  // Once evicted the handle is transferred again.
+  ASSERT_TRUE(serializer.Write(FileHandle{pipe_fds[1]}));
+  EXPECT_EQ(1u, serializer.writer().buffered_handles());
+}
+
+TEST(MmapWriter, RoundTrip) {
+  const auto messages = MakeMessages();
+  const int fd = MakeTemporaryFile();
+  ASSERT_LE(0, fd);
+
+  Serializer<MmapWriter> serializer;
+  ASSERT_TRUE(serializer.writer().Open(fd));
+  for (const auto& message : messages)
+    ASSERT_TRUE(serializer.Write(message));
+
+  TestTable table;
+  table.name = std::string(100, 'x');
+  table.values = std::vector<std::uint32_t>(100000, 0xabcd);
+  ASSERT_TRUE(serializer.Write(table));
+
+  // The file grows ahead of the data and is truncated when finished.
+  const std::size_t size = serializer.writer().size();
+  EXPECT_LE(size, serializer.writer().capacity());
+  ASSERT_TRUE(serializer.writer().Finish());
+  EXPECT_EQ(static_cast<off_t>(size), lseek(fd, 0, SEEK_END));
+
+  Deserializer<MmapReader> deserializer;
+  ASSERT_TRUE(deserializer.reader().Open(serializer.writer().Release()));
+  EXPECT_EQ(size, deserializer.reader().size());
+
+  for (const auto& expected : messages) {
+    // Views point directly into the mapping.
+    ViewMessage message;
+    auto status = deserializer.Read(&message);
+    ASSERT_TRUE(status) << status.GetErrorMessage();
+    EXPECT_EQ(expected.id, message.id);
+    EXPECT_EQ(expected.name, message.name.ToString());
+    EXPECT_EQ(expected.payload, message.payload);
+    if (!message.name.empty()) {
+      EXPECT_LE(deserializer.reader().data(),
+                reinterpret_cast<const std::uint8_t*>(message.name.data()));
+    }
+  }
+
+  TestTable read_table;
+  ASSERT_TRUE(deserializer.Read(&read_table));
+  EXPECT_EQ(table.name, read_table.name);
+  EXPECT_EQ(table.values, read_table.values);
+  EXPECT_TRUE(deserializer.reader().empty());
+
+  EXPECT_EQ(ErrorStatus::ReadLimitReached,
+            deserializer.Read(&read_table).error());
+}
+
+TEST(MmapReader, Empty) {
+  Deserializer<MmapReader> deserializer;
+  EXPECT_EQ(ErrorStatus::IOError, deserializer.reader().Open(-1).error());
+
+  ASSERT_TRUE(deserializer.reader().Open(MakeTemporaryFile()));
+  EXPECT_TRUE(deserializer.reader().empty());
+
+  std::uint32_t value;
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, deserializer.Read(&value).error());
+}
+
+TEST(IoUring, RoundTrip) {
+  IoUring probe;
+  if (!probe.Setup(8))
+    GTEST_SKIP() << "io_uring is not available.";
+
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  const auto messages = MakeMessages();
+
+  // The writer uses registered buffers and the reader small unregistered ones,
+  // exercising short writes, read ahead, and values split across buffers.
+  std::thread writer_thread{[&messages, fd = fds[1]] {
+    IoUring ring;
+    ASSERT_TRUE(ring.Setup(16));
+    ASSERT_TRUE(ring.RegisterBuffers(2, 4096));
+    {
+      Serializer<IoUringWriter> serializer{&ring, fd};
+      for (const auto& message : messages)
+        ASSERT_TRUE(serializer.Write(message));
+      ASSERT_TRUE(serializer.writer().Finish());
+    }
+    close(fd);
+  }};
+
+  IoUring ring;
+  ASSERT_TRUE(ring.Setup(16));
+  Deserializer<IoUringReader> deserializer{&ring, fds[0], false,
+                                           std::size_t{7}};
+  for (const auto& expected : messages) {
+    TestMessage message;
+    auto status = deserializer.Read(&message);
+    ASSERT_TRUE(status) << status.GetErrorMessage();
+    EXPECT_EQ(expected, message);
+  }
+
+  writer_thread.join();
+
+  TestMessage message;
+  auto status = deserializer.Read(&message);
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, status.error());
+  close(fds[0]);
+}
+
+TEST(IoUring, Batch) {
+  IoUring ring;
+  if (!ring.Setup(16))
+    GTEST_SKIP() << "io_uring is not available.";
+
+  int first[2];
+  int second[2];
+  ASSERT_EQ(0, pipe(first));
+  ASSERT_EQ(0, pipe(second));
+
+  // The second connection refers to its pipe through the registered files.
+  const int files[] = {second[0], second[1]};
+  ASSERT_TRUE(ring.RegisterFiles(files, 2));
+
+  {
+    Serializer<IoUringWriter> a{&ring, first[1]};
+    Serializer<IoUringWriter> b{&ring, 1, true};
+    ASSERT_TRUE(a.Write(std::string{"first"}));
+    ASSERT_TRUE(b.Write(std::string{"second"}));
+
+    // Flushing queues the writes, which are submitted together.
+    ASSERT_TRUE(a.writer().Flush());
+    ASSERT_TRUE(b.writer().Flush());
+    EXPECT_EQ(2u, ring.queued());
+    ASSERT_TRUE(ring.Submit());
+    EXPECT_EQ(0u, ring.queued());
+    ASSERT_TRUE(a.writer().Finish());
+    ASSERT_TRUE(b.writer().Finish());
+  }
+
+  Deserializer<IoUringReader> a{&ring, first[0]};
+  Deserializer<IoUringReader> b{&ring, 0, true};
+  ASSERT_TRUE(a.reader().Start());
+  ASSERT_TRUE(b.reader().Start());
+  ASSERT_TRUE(ring.Wait());
+  while (a.reader().buffered() == 0 || b.reader().buffered() == 0)
+    ASSERT_TRUE(ring.Wait());
+
+  std::string value;
+  ASSERT_TRUE(a.Read(&value));
+  EXPECT_EQ("first", value);
+  ASSERT_TRUE(b.Read(&value));
+  EXPECT_EQ("second", value);
+
+  for (int fd : {first[0], first[1], second[0], second[1]})
+    close(fd);
+}
+
+TEST(TcpWriter, RoundTrip) {
+  int fds[2];
+  if (!MakeTcpPair(fds))
+    GTEST_SKIP() << "TCP is not available.";
+
+  // Payloads at least the threshold long are sent with MSG_ZEROCOPY and the
+  // rest is copied, all with the socket corked.
+  auto messages = MakeMessages();
+  messages.push_back(
+      TestMessage{1, "large", std::vector<std::uint8_t>(256 * 1024, 0x5a)});
+
+  std::thread reader_thread{[&messages, fd = fds[0]] {
+    Deserializer<FdReader> deserializer{fd};
+    for (const auto& expected : messages) {
+      TestMessage message;
+      ASSERT_TRUE(deserializer.Read(&message));
+      EXPECT_EQ(expected, message);
+    }
+  }};
+
+  Serializer<TcpWriter> serializer{fds[1], std::size_t{64 * 1024}};
+  for (const auto& message : messages) {
+    ASSERT_TRUE(serializer.Write(message));
+    EXPECT_EQ(nop::Encoding<TestMessage>::Size(message),
+              serializer.writer().buffered());
+    ASSERT_TRUE(serializer.writer().Flush());
+    EXPECT_EQ(0u, serializer.writer().buffered());
+  }
+  reader_thread.join();
+
+  // The payloads may be reused once every zero-copy send completes.
+  ASSERT_TRUE(serializer.writer().WaitForCompletions(1000));
+  EXPECT_EQ(0u, serializer.writer().pending_zero_copy());
+  if (serializer.writer().zero_copy_enabled())
+    EXPECT_LE(1u, serializer.writer().zero_copy_sends());
+  else
+    EXPECT_EQ(0u, serializer.writer().zero_copy_sends());
+}
@@ -0,0 +1,147 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/buffer_writer.h>
+#include <nop/utility/fixed_width_writer.h>
+#include <nop/utility/vector_writer.h>
+
+#include "test_utilities.h"
+
+using nop::BufferReader;
+using nop::BufferWriter;
+using nop::Compose;
+using nop::Deserializer;
+using nop::EncodingByte;
+using nop::Entry;
+using nop::FixedWidthWriter;
+using nop::Integer;
+using nop::Serializer;
+using nop::VectorWriter;
+
+namespace {
+
+enum class Kind : std::uint16_t { Small = 1, Large = 1000 };
+
+struct Sample {
+  std::uint8_t u8;
+  std::int8_t i8;
+  std::uint16_t u16;
+  std::int32_t i32;
+  std::uint64_t u64;
+  Kind kind;
+  bool flag;
+  NOP_STRUCTURE(Sample, u8, i8, u16, i32, u64, kind, flag);
+};
+
+struct Record {
+  Entry<std::uint32_t, 0> id;
+  Entry<Sample, 1> sample;
+  NOP_TABLE(Record, id, sample);
+};
+
+std::vector<std::uint8_t> Data(const VectorWriter& writer) {
+  return {writer.data(), writer.data() + writer.size()};
+}
+
+}  // anonymous namespace
+
+TEST(FixedWidthWriter, Integers) {
+  VectorWriter vector_writer;
+  FixedWidthWriter<VectorWriter> writer{&vector_writer};
+  Serializer<decltype(writer)*> serializer{&writer};
+
+  const Sample sample{1, -1, 2, -3, 4, Kind::Small, true};
+  ASSERT_TRUE(serializer.Write(sample));
+
+  // Every integer has the prefix of its type, regardless of its value. The
+  // member count is a 64-bit integer.
+  const std::vector<std::uint8_t> expected = Compose(
+      EncodingByte::Structure, EncodingByte::U64, Integer<std::uint64_t>(7),
+      EncodingByte::U8, 1, EncodingByte::I8, Integer<std::int8_t>(-1),
+      EncodingByte::U16, Integer<std::uint16_t>(2), EncodingByte::I32,
+      Integer<std::int32_t>(-3), EncodingByte::U64, Integer<std::uint64_t>(4),
+      EncodingByte::U16, Integer<std::uint16_t>(1), EncodingByte::True);
+  EXPECT_EQ(expected, Data(vector_writer));
+
+  // The output decodes as usual.
+  BufferReader reader{vector_writer.data(), vector_writer.size()};
+  Deserializer<BufferReader*> deserializer{&reader};
+  Sample decoded;
+  ASSERT_TRUE(deserializer.Read(&decoded));
+  EXPECT_EQ(1u, decoded.u8);
+  EXPECT_EQ(-1, decoded.i8);
+  EXPECT_EQ(2u, decoded.u16);
+  EXPECT_EQ(-3, decoded.i32);
+  EXPECT_EQ(4u, decoded.u64);
+  EXPECT_EQ(Kind::Small, decoded.kind);
+  EXPECT_TRUE(decoded.flag);
+}
+
+TEST(FixedWidthWriter, Containers) {
+  Record record;
+  record.id = 5u;
+  record.sample = Sample{200, 100, 60000, 1 << 20, 1ull << 40, Kind::Large,
+                         false};
+  const std::vector<std::string> strings = {"a", "bc"};
+
+  // Tables are written in a single pass over writers that support Patch().
+  VectorWriter vector_writer;
+  FixedWidthWriter<VectorWriter> writer{&vector_writer};
+  Serializer<decltype(writer)*> serializer{&writer};
+  ASSERT_TRUE(serializer.Write(record));
+  ASSERT_TRUE(serializer.Write(strings));
+  EXPECT_LT(serializer.GetSize(record) + serializer.GetSize(strings),
+            vector_writer.size());
+
+  // Entries written in two passes fall back to the smallest prefixes, so that
+  // they fit their computed sizes.
+  std::vector<std::uint8_t> buffer(256);
+  BufferWriter buffer_writer{buffer.data(), buffer.size()};
+  FixedWidthWriter<BufferWriter> bounded{&buffer_writer};
+  Serializer<decltype(bounded)*> bounded_serializer{&bounded};
+  ASSERT_TRUE(bounded_serializer.Write(record));
+
+  for (const auto& data :
+       {Data(vector_writer),
+        std::vector<std::uint8_t>(buffer.data(),
+                                  buffer.data() + buffer_writer.size())}) {
+    BufferReader reader{data.data(), data.size()};
+    Deserializer<BufferReader*> deserializer{&reader};
+    Record decoded;
+    ASSERT_TRUE(deserializer.Read(&decoded));
+    ASSERT_TRUE(decoded.id && decoded.sample);
+    EXPECT_EQ(5u, decoded.id.get());
+    EXPECT_EQ(60000u, decoded.sample.get().u16);
+    EXPECT_EQ(1ull << 40, decoded.sample.get().u64);
+    EXPECT_EQ(Kind::Large, decoded.sample.get().kind);
+  }
+
+  BufferReader reader{vector_writer.data(), vector_writer.size()};
+  Deserializer<BufferReader*> deserializer{&reader};
+  Record decoded_record;
+  std::vector<std::string> decoded_strings;
+  ASSERT_TRUE(deserializer.Read(&decoded_record));
+  ASSERT_TRUE(deserializer.Read(&decoded_strings));
+  EXPECT_EQ(strings, decoded_strings);
+}
@@ -0,0 +1,229 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/traits/is_fungible.h>
+#include <nop/types/flat_map.h>
+#include <nop/types/hash_map.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::BufferReader;
+using nop::Deserializer;
+using nop::ErrorStatus;
+using nop::FlatMap;
+using nop::FlatSet;
+using nop::HashMap;
+using nop::IsFungible;
+using nop::Serializer;
+using nop::VectorWriter;
+
+namespace {
+
+// Returns the encoding of |value|.
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  return serializer.writer().take();
+}
+
+// Decodes |encoding| into |value|.
+template <typename T>
+nop::Status<void> Decode(const std::vector<std::uint8_t>& encoding, T* value) {
+  Deserializer<BufferReader> deserializer{encoding.data(), encoding.size()};
+  return deserializer.Read(value);
+}
+
+}  // anonymous namespace
+
+TEST(FlatMap, Basic) {
+  FlatMap<int, std::string> map{{3, "c"}, {1, "a"}, {2, "b"}, {1, "x"}};
+  ASSERT_EQ(3u, map.size());
+  EXPECT_EQ(1, map.begin()->first);
+  EXPECT_EQ("a", map.find(1)->second);
+  EXPECT_EQ(map.end(), map.find(4));
+  EXPECT_EQ(1u, map.count(2));
+
+  EXPECT_FALSE(map.insert({2, "y"}).second);
+  EXPECT_TRUE(map.insert({0, "z"}).second);
+  map[5] = "e";
+  EXPECT_EQ((std::vector<std::pair<int, std::string>>{
+                {0, "z"}, {1, "a"}, {2, "b"}, {3, "c"}, {5, "e"}}),
+            map.container());
+
+  EXPECT_EQ(1u, map.erase(0));
+  EXPECT_EQ(0u, map.erase(0));
+  EXPECT_EQ(4u, map.size());
+}
+
+TEST(FlatMap, Serialize) {
+  EXPECT_TRUE((IsFungible<FlatMap<int, std::string>,
+                          std::map<int, std::string>>::value));
+  EXPECT_TRUE((IsFungible<std::unordered_map<int, std::string>,
+                          FlatMap<int, std::string>>::value));
+  EXPECT_TRUE((IsFungible<FlatMap<int, std::string>,
+                          HashMap<int, std::string>>::value));
+  EXPECT_FALSE((IsFungible<FlatMap<int, std::string>,
+                           std::map<int, std::vector<int>>>::value));
+
+  std::map<int, std::string> ordered;
+  for (int i = 0; i < 64; i++)
+    ordered[i * 7 % 97] = std::to_string(i);
+
+  FlatMap<int, std::string> map;
+  ASSERT_TRUE(Decode(Encode(ordered), &map));
+  using Container = FlatMap<int, std::string>::container_type;
+  EXPECT_EQ(Container(ordered.begin(), ordered.end()), map.container());
+  EXPECT_EQ(Encode(ordered), Encode(map));
+
+  // Decoding again reuses the storage of the map and its elements.
+  const auto* data = map.container().data();
+  ASSERT_TRUE(Decode(Encode(ordered), &map));
+  EXPECT_EQ(data, map.container().data());
+
+  // Input that is not in key order, or has duplicate keys, is sorted.
+  std::unordered_map<int, std::string> unordered(ordered.begin(),
+                                                 ordered.end());
+  FlatMap<int, std::string> unordered_map;
+  ASSERT_TRUE(Decode(Encode(unordered), &unordered_map));
+  EXPECT_EQ(map, unordered_map);
+
+  const std::uint8_t duplicates[] = {0xbb, 3, 2, 20, 1, 10, 2, 30};
+  FlatMap<int, int> duplicate_map;
+  Deserializer<BufferReader> deserializer{duplicates, sizeof(duplicates)};
+  ASSERT_TRUE(deserializer.Read(&duplicate_map));
+  EXPECT_EQ((std::vector<std::pair<int, int>>{{1, 10}, {2, 20}}),
+            duplicate_map.container());
+
+  // Errors leave the map empty.
+  auto encoding = Encode(ordered);
+  encoding.resize(encoding.size() - 1);
+  auto status = Decode(encoding, &map);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, status.error());
+  EXPECT_TRUE(map.empty());
+}
+
+TEST(FlatSet, Serialize) {
+  EXPECT_TRUE((IsFungible<FlatSet<int>, std::set<int>>::value));
+  EXPECT_TRUE((IsFungible<std::unordered_set<std::string>,
+                          FlatSet<std::string>>::value));
+  EXPECT_FALSE((IsFungible<FlatSet<int>, std::set<std::string>>::value));
+
+  const std::set<std::uint32_t> integers{5, 1, 9, 300, 70000};
+  FlatSet<std::uint32_t> integer_set;
+  ASSERT_TRUE(Decode(Encode(integers), &integer_set));
+  EXPECT_EQ(std::vector<std::uint32_t>(integers.begin(), integers.end()),
+            integer_set.container());
+  EXPECT_EQ(Encode(integers), Encode(integer_set));
+  EXPECT_EQ(1u, integer_set.count(300));
+
+  const std::unordered_set<std::uint32_t> unordered{5, 1, 9, 300, 70000};
+  ASSERT_TRUE(Decode(Encode(unordered), &integer_set));
+  EXPECT_EQ(std::vector<std::uint32_t>(integers.begin(), integers.end()),
+            integer_set.container());
+
+  const std::set<std::string> strings{"b", "a", "c"};
+  FlatSet<std::string> string_set;
+  ASSERT_TRUE(Decode(Encode(strings), &string_set));
+  EXPECT_EQ((FlatSet<std::string>{"a", "b", "c"}), string_set);
+  EXPECT_EQ(Encode(strings), Encode(string_set));
+
+  EXPECT_TRUE(string_set.insert(std::string{"d"}).second);
+  EXPECT_FALSE(string_set.insert(std::string{"a"}).second);
+  EXPECT_EQ(1u, string_set.erase("b"));
+  EXPECT_EQ((FlatSet<std::string>{"a", "c", "d"}), string_set);
+}
+
+TEST(HashMap, Basic) {
+  HashMap<int, std::string> map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.end(), map.find(1));
+  EXPECT_EQ(0u, map.erase(1));
+
+  for (int i = 0; i < 1000; i++)
+    EXPECT_TRUE(map.try_emplace(i * 1024, std::to_string(i)).second);
+  EXPECT_EQ(1000u, map.size());
+  EXPECT_GE(map.bucket_count() * 3 / 4, map.size());
+  EXPECT_FALSE(map.insert({0, "x"}).second);
+
+  for (int i = 0; i < 1000; i++) {
+    auto it = map.find(i * 1024);
+    ASSERT_NE(map.end(), it);
+    EXPECT_EQ(std::to_string(i), it->second);
+  }
+
+  // Erasing shifts the following elements back so they remain reachable.
+  for (int i = 0; i < 1000; i += 2)
+    EXPECT_EQ(1u, map.erase(i * 1024));
+  EXPECT_EQ(500u, map.size());
+  for (int i = 0; i < 1000; i++)
+    EXPECT_EQ(i % 2 != 0, map.count(i * 1024) == 1) << i;
+
+  std::size_t count = 0;
+  for (const auto& element : map) {
+    EXPECT_EQ(1, element.first / 1024 % 2);
+    count++;
+  }
+  EXPECT_EQ(500u, count);
+
+  const std::size_t bucket_count = map.bucket_count();
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(bucket_count, map.bucket_count());
+  EXPECT_EQ(map.end(), map.begin());
+
+  map[7] = "seven";
+  EXPECT_EQ((HashMap<int, std::string>{{7, "seven"}}), map);
+}
+
+TEST(HashMap, Serialize) {
+  EXPECT_TRUE((IsFungible<HashMap<int, std::string>,
+                          std::unordered_map<int, std::string>>::value));
+  EXPECT_TRUE((IsFungible<std::map<int, std::string>,
+                          HashMap<int, std::string>>::value));
+
+  std::unordered_map<std::string, std::uint64_t> routes;
+  for (std::uint64_t i = 0; i < 256; i++)
+    routes["10.0.0." + std::to_string(i)] = i;
+
+  HashMap<std::string, std::uint64_t> map;
+  ASSERT_TRUE(Decode(Encode(routes), &map));
+  ASSERT_EQ(routes.size(), map.size());
+  for (const auto& element : routes)
+    EXPECT_EQ(element.second, map.find(element.first)->second);
+
+  // The slots are sized from the encoded count.
+  const std::size_t bucket_count = map.bucket_count();
+  EXPECT_GE(bucket_count * 3 / 4, routes.size());
+  EXPECT_LT(bucket_count / 2 * 3 / 4, routes.size());
+
+  std::unordered_map<std::string, std::uint64_t> read_routes;
+  ASSERT_TRUE(Decode(Encode(map), &read_routes));
+  EXPECT_EQ(routes, read_routes);
+
+  ASSERT_TRUE(Decode(Encode(routes), &map));
+  EXPECT_EQ(bucket_count, map.bucket_count());
+}
@@ -0,0 +1,142 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/utility/frame_queue.h>
+
+using nop::Deserializer;
+using nop::ErrorStatus;
+using nop::FrameQueue;
+using nop::Serializer;
+using nop::Status;
+
+TEST(FrameQueueTests, PushPop) {
+  FrameQueue queue{3, 16};
+  EXPECT_EQ(4u, queue.slot_count());
+  EXPECT_EQ(16u, queue.slot_size());
+
+  std::string value;
+  auto status = queue.TryPop(&value);
+  ASSERT_TRUE(status);
+  EXPECT_FALSE(status.get());
+
+  for (int i = 0; i < 4; i++) {
+    status = queue.TryPush(std::to_string(i));
+    ASSERT_TRUE(status);
+    EXPECT_TRUE(status.get());
+  }
+
+  // The queue is full until a frame is popped.
+  status = queue.TryPush(std::string{"full"});
+  ASSERT_TRUE(status);
+  EXPECT_FALSE(status.get());
+
+  for (int i = 0; i < 4; i++) {
+    status = queue.TryPop(&value);
+    ASSERT_TRUE(status);
+    EXPECT_TRUE(status.get());
+    EXPECT_EQ(std::to_string(i), value);
+  }
+
+  status = queue.TryPop(&value);
+  ASSERT_TRUE(status);
+  EXPECT_FALSE(status.get());
+}
+
+TEST(FrameQueueTests, Slots) {
+  FrameQueue queue{2, 16};
+
+  // Several values may be serialized into one frame in place.
+  Serializer<FrameQueue::SlotWriter> serializer;
+  ASSERT_TRUE(queue.BeginPush(&serializer.writer()));
+  ASSERT_TRUE(serializer.Write(1));
+  ASSERT_TRUE(serializer.Write(std::string{"two"}));
+  EXPECT_EQ(6u, serializer.writer().size());
+  serializer.writer().Commit();
+
+  // Values that do not fit fail and abandon their slot, which consumers skip.
+  auto status = queue.TryPush(std::string(32, 'x'));
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::WriteLimitReached, status.error());
+
+  Deserializer<FrameQueue::SlotReader> deserializer;
+  ASSERT_TRUE(queue.BeginPop(&deserializer.reader()));
+  int first;
+  std::string second;
+  ASSERT_TRUE(deserializer.Read(&first));
+  ASSERT_TRUE(deserializer.Read(&second));
+  EXPECT_EQ(1, first);
+  EXPECT_EQ("two", second);
+  EXPECT_TRUE(deserializer.reader().empty());
+  deserializer.reader().Release();
+
+  EXPECT_FALSE(queue.BeginPop(&deserializer.reader()));
+
+  // Both slots are free again.
+  EXPECT_TRUE(queue.TryPush(1).get());
+  EXPECT_TRUE(queue.TryPush(2).get());
+  EXPECT_FALSE(queue.TryPush(3).get());
+}
+
+TEST(FrameQueueTests, Threads) {
+  FrameQueue queue{64, 32};
+  const int kProducers = 4;
+  const int kConsumers = 4;
+  const std::uint64_t kCount = 20000;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kProducers; i++) {
+    threads.emplace_back([&] {
+      for (std::uint64_t value = 1; value <= kCount;) {
+        auto status = queue.TryPush(value);
+        ASSERT_TRUE(status);
+        if (status.get())
+          value++;
+        else
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  std::atomic<std::uint64_t> sum{0};
+  std::atomic<std::uint64_t> popped{0};
+  for (int i = 0; i < kConsumers; i++) {
+    threads.emplace_back([&] {
+      while (popped.load() < kProducers * kCount) {
+        std::uint64_t value;
+        auto status = queue.TryPop(&value);
+        ASSERT_TRUE(status);
+        if (status.get()) {
+          sum += value;
+          popped++;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(kProducers * kCount, popped.load());
+  EXPECT_EQ(kProducers * kCount * (kCount + 1) / 2, sum.load());
+}
@@ -0,0 +1,235 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/types/result.h>
+#include <nop/types/variant.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/frame_scanner.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::Deserializer;
+using nop::EncodingByte;
+using nop::Entry;
+using nop::ErrorStatus;
+using nop::FrameScanner;
+using nop::Result;
+using nop::Serializer;
+using nop::Variant;
+using nop::VectorWriter;
+
+namespace {
+
+struct Point {
+  float x;
+  double y;
+  std::int64_t z;
+  NOP_STRUCTURE(Point, x, y, z);
+};
+
+using MessageVariant = Variant<int, std::string, Point>;
+
+struct Message {
+  std::uint32_t id;
+  std::string name;
+  std::vector<Point> points;
+  std::map<std::string, std::vector<std::uint8_t>> attributes;
+  MessageVariant variant;
+  NOP_STRUCTURE(Message, id, name, points, attributes, variant);
+};
+
+struct Record {
+  Entry<std::string, 0> name;
+  Entry<Message, 1> message;
+  Entry<std::vector<std::int32_t>, 2, nop::DeletedEntry> deleted;
+  Entry<Variant<int, std::string>, 3> empty;
+  NOP_TABLE(Record, name, message, deleted, empty);
+};
+
+enum class TestError { None, Failed };
+
+Message MakeMessage() {
+  return {0xdeadbeef,
+          "message",
+          std::vector<Point>(10, Point{1.0f, -2.0, -(1ll << 40)}),
+          {{"a", {1, 2, 3}}, {"b", std::vector<std::uint8_t>(300, 7)}},
+          MessageVariant{std::string(200, 'x')}};
+}
+
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  return serializer.writer().take();
+}
+
+// Scans |encoding| in chunks of |chunk_size| bytes and returns the length of
+// the first value, expecting it to be complete within the encoding.
+std::size_t ScanLength(const std::vector<std::uint8_t>& encoding,
+                       std::size_t chunk_size) {
+  FrameScanner scanner;
+  std::size_t index = 0;
+  while (index < encoding.size() && !scanner.complete()) {
+    const std::size_t count = std::min(chunk_size, encoding.size() - index);
+    auto status = scanner.Scan(&encoding[index], count);
+    EXPECT_TRUE(status) << status.GetErrorMessage();
+    if (!status)
+      return 0;
+
+    index += status.get();
+  }
+
+  EXPECT_TRUE(scanner.complete());
+  EXPECT_EQ(index, scanner.length());
+  return scanner.length();
+}
+
+template <typename T>
+void ExpectLength(const T& value) {
+  const auto encoding = Encode(value);
+  for (std::size_t chunk_size : {1, 2, 3, 7, 64, 1 << 20}) {
+    EXPECT_EQ(encoding.size(), ScanLength(encoding, chunk_size))
+        << "chunk_size=" << chunk_size;
+  }
+}
+
+}  // anonymous namespace
+
+TEST(FrameScanner, Values) {
+  ExpectLength(true);
+  ExpectLength(0);
+  ExpectLength(-1);
+  ExpectLength(std::uint8_t{200});
+  ExpectLength(std::int16_t{-1000});
+  ExpectLength(std::uint32_t{1u << 30});
+  ExpectLength(std::int64_t{-(1ll << 40)});
+  ExpectLength(1.0f);
+  ExpectLength(1.0);
+  ExpectLength(std::string{});
+  ExpectLength(std::string(1000, 'a'));
+  ExpectLength(std::vector<std::uint64_t>(100, 1ull << 50));
+  ExpectLength(std::vector<std::string>{"a", "", "bc"});
+  ExpectLength(std::vector<std::vector<int>>{{}, {1}, {}, {2, 3}});
+  ExpectLength(std::map<int, std::string>{{1, "a"}, {-2, "b"}});
+  ExpectLength(Variant<int, std::string>{});
+  ExpectLength(MakeMessage());
+  ExpectLength(Result<TestError, int>{TestError::Failed});
+
+  Record record;
+  record.name = "record";
+  record.message = MakeMessage();
+  ExpectLength(record);
+}
+
+TEST(FrameScanner, Handle) {
+  // Handle type 1 with reference 2.
+  const std::vector<std::uint8_t> encoding = {
+      static_cast<std::uint8_t>(EncodingByte::Handle), 1,
+      static_cast<std::uint8_t>(EncodingByte::I64), 2, 0, 0, 0, 0, 0, 0, 0};
+  EXPECT_EQ(encoding.size(), ScanLength(encoding, 1));
+}
+
+TEST(FrameScanner, Stream) {
+  const auto first = Encode(MakeMessage());
+  const auto second = Encode(std::string(50, 'b'));
+  std::vector<std::uint8_t> stream = first;
+  stream.insert(stream.end(), second.begin(), second.end());
+
+  FrameScanner scanner;
+  auto status = scanner.Scan(stream.data(), stream.size());
+  ASSERT_TRUE(status);
+  EXPECT_TRUE(scanner.complete());
+  EXPECT_EQ(first.size(), status.get());
+  EXPECT_EQ(0u, scanner.needed());
+
+  // The scanner consumes nothing more until it is reset.
+  status = scanner.Scan(&stream[first.size()], second.size());
+  ASSERT_TRUE(status);
+  EXPECT_EQ(0u, status.get());
+
+  Deserializer<nop::BufferReader> deserializer{stream.data(), first.size()};
+  Message message;
+  EXPECT_TRUE(deserializer.Read(&message));
+
+  scanner.Reset();
+  status = scanner.Scan(&stream[first.size()], second.size());
+  ASSERT_TRUE(status);
+  EXPECT_TRUE(scanner.complete());
+  EXPECT_EQ(second.size(), scanner.length());
+}
+
+TEST(FrameScanner, Needed) {
+  const auto encoding = Encode(std::vector<std::string>{std::string(100, 'a')});
+
+  FrameScanner scanner;
+  EXPECT_EQ(1u, scanner.needed());
+
+  // Array prefix and count, then the string prefix and length.
+  auto status = scanner.Scan(encoding.data(), 4);
+  ASSERT_TRUE(status);
+  EXPECT_EQ(4u, status.get());
+  EXPECT_FALSE(scanner.complete());
+  EXPECT_EQ(100u, scanner.needed());
+
+  status = scanner.Scan(&encoding[4], 60);
+  ASSERT_TRUE(status);
+  EXPECT_EQ(40u, scanner.needed());
+
+  status = scanner.Scan(&encoding[64], encoding.size() - 64);
+  ASSERT_TRUE(status);
+  EXPECT_TRUE(scanner.complete());
+  EXPECT_EQ(encoding.size(), scanner.length());
+}
+
+TEST(FrameScanner, Errors) {
+  FrameScanner scanner;
+
+  // Reserved prefix.
+  std::uint8_t reserved[] = {
+      static_cast<std::uint8_t>(EncodingByte::ReservedMin)};
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            scanner.Scan(reserved, sizeof(reserved)).error());
+
+  // Errors are sticky until reset.
+  std::uint8_t integer[] = {1};
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            scanner.Scan(integer, sizeof(integer)).error());
+  scanner.Reset();
+  EXPECT_TRUE(scanner.Scan(integer, sizeof(integer)));
+  EXPECT_TRUE(scanner.complete());
+
+  // Signed container length.
+  std::uint8_t negative[] = {static_cast<std::uint8_t>(EncodingByte::Array),
+                             static_cast<std::uint8_t>(EncodingByte::I8), 1};
+  scanner.Reset();
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            scanner.Scan(negative, sizeof(negative)).error());
+
+  // Non-integer container length.
+  std::uint8_t length[] = {static_cast<std::uint8_t>(EncodingByte::String),
+                           static_cast<std::uint8_t>(EncodingByte::Nil)};
+  scanner.Reset();
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            scanner.Scan(length, sizeof(length)).error());
+}
@@ -0,0 +1,142 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/framing.h>
+#include <nop/utility/stream_reader.h>
+#include <nop/utility/stream_writer.h>
+#include <nop/utility/vector_writer.h>
+
+#include "test_utilities.h"
+
+using nop::BufferReader;
+using nop::Compose;
+using nop::Deserializer;
+using nop::EncodingByte;
+using nop::ErrorStatus;
+using nop::FramedReader;
+using nop::FramedWriter;
+using nop::Integer;
+using nop::Serializer;
+using nop::Status;
+using nop::StreamReader;
+using nop::StreamWriter;
+using nop::VectorWriter;
+
+TEST(FramingTests, Header) {
+  Serializer<FramedWriter<VectorWriter>> serializer;
+  serializer.writer().set_flags(0x12345678);
+  ASSERT_TRUE(serializer.Write(std::string{"abc"}));
+  EXPECT_EQ(0u, serializer.writer().remaining());
+
+  std::vector<std::uint8_t> expected =
+      Compose(Integer<std::uint32_t>(5), Integer<std::uint32_t>(0x12345678),
+              EncodingByte::String, 3, 'a', 'b', 'c');
+  EXPECT_EQ(expected, serializer.writer().writer().buffer());
+}
+
+TEST(FramingTests, Stream) {
+  using Writer = StreamWriter<std::stringstream>;
+  Serializer<FramedWriter<Writer>> serializer;
+  for (std::uint32_t i = 0; i < 10; i++) {
+    serializer.writer().set_flags(i);
+    ASSERT_TRUE(serializer.Write(std::vector<std::uint32_t>(i, i)));
+  }
+
+  using Reader = StreamReader<std::stringstream>;
+  Deserializer<FramedReader<Reader>> deserializer{
+      serializer.writer().writer().stream().str()};
+  for (std::uint32_t i = 0; i < 10; i++) {
+    ASSERT_TRUE(deserializer.reader().NextFrame());
+    EXPECT_EQ(i, deserializer.reader().flags());
+
+    std::vector<std::uint32_t> value;
+    ASSERT_TRUE(deserializer.Read(&value));
+    EXPECT_EQ(std::vector<std::uint32_t>(i, i), value);
+    EXPECT_TRUE(deserializer.reader().empty());
+
+    // Reads do not run past the end of the frame.
+    std::uint8_t byte;
+    EXPECT_EQ(ErrorStatus::ReadLimitReached,
+              deserializer.reader().Read(&byte).error());
+  }
+  EXPECT_FALSE(deserializer.reader().NextFrame());
+}
+
+TEST(FramingTests, ReadFrame) {
+  Serializer<FramedWriter<StreamWriter<std::stringstream>>> serializer;
+  serializer.writer().set_flags(7);
+  ASSERT_TRUE(serializer.Write(std::string{"frame"}));
+  ASSERT_TRUE(serializer.Write(std::string(100, 'x')));
+
+  FramedReader<StreamReader<std::stringstream>> reader{
+      serializer.writer().writer().stream().str()};
+  std::vector<std::uint8_t> payload;
+  Status<std::uint32_t> flags = reader.ReadFrame(&payload);
+  ASSERT_TRUE(flags);
+  EXPECT_EQ(7u, flags.get());
+
+  // The frame is decoded independently of the stream.
+  Deserializer<BufferReader> deserializer{payload.data(), payload.size()};
+  std::string value;
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ("frame", value);
+
+  // Frames larger than the limit are rejected.
+  reader.set_max_frame_size(64);
+  EXPECT_EQ(ErrorStatus::ProtocolError, reader.ReadFrame(&payload).error());
+}
+
+TEST(FramingTests, EndFrame) {
+  // Writers that support patching backfill the exact length.
+  {
+    FramedWriter<VectorWriter> writer;
+    ASSERT_TRUE(writer.Prepare(4));
+    ASSERT_TRUE(writer.Write(std::uint8_t{1}));
+    EXPECT_EQ(3u, writer.remaining());
+    ASSERT_TRUE(writer.EndFrame());
+
+    std::vector<std::uint8_t> expected = Compose(
+        Integer<std::uint32_t>(1), Integer<std::uint32_t>(0), 1);
+    EXPECT_EQ(expected, writer.writer().buffer());
+  }
+
+  // Other writers pad the frame out to the length in the header.
+  {
+    FramedWriter<StreamWriter<std::stringstream>> writer;
+    ASSERT_TRUE(writer.Prepare(4));
+    ASSERT_TRUE(writer.Write(std::uint8_t{1}));
+    ASSERT_TRUE(writer.Prepare(1));
+    ASSERT_TRUE(writer.Write(std::uint8_t{2}));
+
+    const std::string data = writer.writer().stream().str();
+    std::vector<std::uint8_t> expected =
+        Compose(Integer<std::uint32_t>(4), Integer<std::uint32_t>(0), 1, 0, 0,
+                0, Integer<std::uint32_t>(1), Integer<std::uint32_t>(0), 2);
+    EXPECT_EQ(expected, std::vector<std::uint8_t>(data.begin(), data.end()));
+  }
+
+  // Writing outside of a frame fails.
+  FramedWriter<VectorWriter> writer;
+  EXPECT_EQ(ErrorStatus::WriteLimitReached,
+            writer.Write(std::uint8_t{1}).error());
+}
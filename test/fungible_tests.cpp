@@ -15,6 +15,8 @@
 #include <gtest/gtest.h>
 
 #include <array>
+#include <cstdint>
+#include <deque>
 #include <functional> /* hash */
 
 #include <nop/base/logical_buffer.h>
@@ -256,6 +258,20 @@ TEST(FungibleTests, ArrayVector) {
   EXPECT_FALSE((IsFungible<IntList, FloatArray1>::value));
   EXPECT_FALSE((IsFungible<IntList, FloatArray2>::value));
 
+  using IntDeque = std::deque<int>;
+  using FloatDeque = std::deque<float>;
+
+  // Test combinations of std::deque and the other sequence containers.
+  EXPECT_TRUE((IsFungible<IntDeque, IntDeque>::value));
+  EXPECT_FALSE((IsFungible<IntDeque, FloatDeque>::value));
+  EXPECT_TRUE((IsFungible<IntDeque, IntVector>::value));
+  EXPECT_TRUE((IsFungible<FloatVector, FloatDeque>::value));
+  EXPECT_FALSE((IsFungible<IntDeque, FloatVector>::value));
+  EXPECT_TRUE((IsFungible<IntDeque, IntList>::value));
+  EXPECT_FALSE((IsFungible<FloatList, IntDeque>::value));
+  EXPECT_TRUE((IsFungible<IntDeque, IntArray2>::value));
+  EXPECT_FALSE((IsFungible<FloatArray1, IntDeque>::value));
+
   using IntCArray1 = int[1];
   using IntCArray2 = int[2];
   using FloatCArray1 = float[1];
@@ -878,6 +894,20 @@ struct ArrayWrapper {
 
 }  // anonymous namespace
 
+TEST(FungibleTests, Enum) {
+  enum class Status : std::uint16_t { Ok, Failed };
+  enum class Color : std::uint16_t { Red, Green };
+
+  // Enums encode as their underlying type.
+  EXPECT_TRUE((IsFungible<Status, std::uint16_t>::value));
+  EXPECT_TRUE((IsFungible<std::uint16_t, Status>::value));
+  EXPECT_FALSE((IsFungible<Status, std::uint32_t>::value));
+  EXPECT_FALSE((IsFungible<Status, Color>::value));
+  EXPECT_TRUE(
+      (IsFungible<std::vector<Status>, std::vector<std::uint16_t>>::value));
+  EXPECT_FALSE((IsFungible<std::vector<Status>, std::vector<Color>>::value));
+}
+
 TEST(FungibleTests, Value) {
   using IntWrapper = ValueWrapper<int>;
   using FloatWrapper = ValueWrapper<float>;
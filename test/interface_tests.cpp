@@ -19,9 +19,15 @@
 #include <type_traits>
 #include <vector>
 
+#include <nop/rpc/instrumented_bindings.h>
 #include <nop/rpc/interface.h>
+#include <nop/rpc/interface_router.h>
+#include <nop/rpc/method_batch.h>
+#include <nop/rpc/pipelined_method_receiver.h>
+#include <nop/rpc/pipelined_method_sender.h>
 #include <nop/rpc/simple_method_receiver.h>
 #include <nop/rpc/simple_method_sender.h>
+#include <nop/rpc/stream_method.h>
 #include <nop/serializer.h>
 #include <nop/structure.h>
 
@@ -30,8 +36,10 @@
 #include "test_writer.h"
 
 using nop::BindInterface;
+using nop::BindRoutes;
 using nop::Compose;
 using nop::Deserializer;
+using nop::DispatchBatch;
 using nop::EncodingByte;
 using nop::ErrorStatus;
 using nop::Float;
@@ -39,10 +47,21 @@ using nop::Integer;
 using nop::Interface;
 using nop::InterfaceDispatcher;
 using nop::InterfaceType;
+using nop::Instrument;
+using nop::MethodStats;
+using nop::MakeBatchMethodSender;
+using nop::MakePipelinedMethodReceiver;
+using nop::MakePipelinedMethodSender;
+using nop::MakeRoutedMethodSender;
+using nop::Route;
 using nop::Serializer;
+using nop::SelectorHash;
 using nop::SimpleMethodReceiver;
 using nop::SimpleMethodSender;
 using nop::Status;
+using nop::StreamReader;
+using nop::StreamWriter;
+using nop::ThreadLocalArgs;
 using nop::TestReader;
 using nop::TestWriter;
 using nop::Variant;
@@ -120,10 +139,73 @@ struct ConcreteClass : AbstractClass {
   }
 };
 
+// Interface with small, manually assigned method selectors.
+struct ManualInterface : Interface<ManualInterface> {
+  NOP_INTERFACE32("io.github.eieio.ManualInterface");
+
+  NOP_METHOD_SEL(0, Zero, int(int a));
+  NOP_METHOD_SEL(1, One, int(int a));
+  NOP_METHOD_SEL(2, Two, int(int a));
+  NOP_METHOD_SEL(5, Five, int(int a));
+
+  NOP_INTERFACE_API(Zero, One, Two, Five);
+};
+
+// Interface with a mix of request/response and one-way methods.
+struct NotifyInterface : Interface<NotifyInterface> {
+  NOP_INTERFACE("io.github.eieio.NotifyInterface");
+
+  NOP_METHOD(Sum, int(int a, int b));
+  NOP_ONEWAY_METHOD(Notify, void(int value));
+  NOP_ONEWAY_METHOD(Log, void(const std::string& message));
+
+  NOP_INTERFACE_API(Sum, Notify, Log);
+};
+
+// Interface with server and client streaming methods.
+struct StreamInterface : Interface<StreamInterface> {
+  NOP_INTERFACE("io.github.eieio.StreamInterface");
+
+  NOP_SERVER_STREAM_METHOD(Range, int(int begin, int end));
+  NOP_CLIENT_STREAM_METHOD(Total, int, int(int initial));
+  NOP_METHOD(Sum, int(int a, int b));
+
+  NOP_INTERFACE_API(Range, Total, Sum);
+};
+
+// Generates a large set of hash-like selectors for testing SelectorHash.
+constexpr std::uint64_t kSelectorStep = 0x9e3779b97f4a7c15;
+template <std::size_t... Is>
+SelectorHash<std::uint64_t, (Is + 1) * kSelectorStep...> MakeSelectorHash(
+    std::index_sequence<Is...>);
+
 }  // anonymous namespace
 
+TEST(InterfaceTests, SelectorHash) {
+  using Hash = decltype(MakeSelectorHash(std::make_index_sequence<64>{}));
+  static_assert(Hash::IsValid::value, "");
+  EXPECT_EQ(64u, Hash::Count);
+
+  for (std::uint64_t i = 0; i < 64; i++)
+    EXPECT_EQ(i, Hash::Find((i + 1) * kSelectorStep));
+
+  EXPECT_EQ(64u, Hash::Find(0));
+  EXPECT_EQ(64u, Hash::Find(65 * kSelectorStep));
+
+  // Dense selectors map directly to slots in the table.
+  using DenseHash = SelectorHash<std::uint32_t, 0, 1, 2, 3, 4, 5, 6, 7>;
+  static_assert(DenseHash::IsValid::value, "");
+  EXPECT_EQ(0u, DenseHash::Shift);
+  EXPECT_EQ(16u, DenseHash::Size);
+  for (std::uint32_t i = 0; i < 8; i++)
+    EXPECT_EQ(i, DenseHash::Find(i));
+  EXPECT_EQ(8u, DenseHash::Find(8));
+  EXPECT_EQ(8u, DenseHash::Find(16));
+}
+
 TEST(InterfaceTests, Interface) {
   EXPECT_EQ(kTestInterfaceName, TestInterface::GetInterfaceName());
+  EXPECT_EQ(kTestInterfaceName, TestInterface::GetInterfaceNameCString());
   EXPECT_EQ(TestInterface::Sum::Selector,
             TestInterface::GetMethodSelector<0>());
   EXPECT_EQ(TestInterface::Product::Selector,
@@ -267,3 +349,691 @@ TEST(InterfaceTests, Invoke) {
     writer.clear();
   }
 }
+
+TEST(InterfaceTests, PipelinedInvoke) {
+  std::vector<std::uint8_t> expected;
+  TestReader reader;
+  TestWriter writer;
+  Deserializer<TestReader*> deserializer{&reader};
+  Serializer<TestWriter*> serializer{&writer};
+  auto sender = MakePipelinedMethodSender(&serializer, &deserializer);
+
+  std::vector<int> completed;
+  int sum = 0;
+  int product = 0;
+  std::size_t length = 0;
+
+  ASSERT_TRUE((TestInterface::Sum::InvokeAsync(
+      &sender,
+      [&](Status<int> status) {
+        ASSERT_TRUE(status);
+        sum = status.get();
+        completed.push_back(0);
+      },
+      10, 20)));
+  ASSERT_TRUE((TestInterface::Product::InvokeAsync(
+      &sender,
+      [&](Status<int> status) {
+        ASSERT_TRUE(status);
+        product = status.get();
+        completed.push_back(1);
+      },
+      10, 20)));
+  ASSERT_TRUE((TestInterface::Length::InvokeAsync(
+      &sender,
+      [&](Status<std::size_t> status) {
+        ASSERT_TRUE(status);
+        length = status.get();
+        completed.push_back(2);
+      },
+      "foo")));
+
+  // Every invocation is written before any return value is read, each one
+  // preceded by its request id.
+  expected =
+      Compose(0, MethodSelectorEncoding,
+              Integer<MethodSelectorType>(TestInterface::Sum::Selector),
+              EncodingByte::Array, 2, 10, 20, 1, MethodSelectorEncoding,
+              Integer<MethodSelectorType>(TestInterface::Product::Selector),
+              EncodingByte::Array, 2, 10, 20, 2, MethodSelectorEncoding,
+              Integer<MethodSelectorType>(TestInterface::Length::Selector),
+              EncodingByte::Array, 1, EncodingByte::String, 3, "foo");
+  EXPECT_EQ(expected, writer.data());
+  EXPECT_EQ(3u, sender.pending());
+  EXPECT_TRUE(completed.empty());
+
+  // Return values are matched to invocations by request id, in any order.
+  reader.Set(Compose(2, 3, 0, 30, 1, 100));
+  ASSERT_TRUE(sender.ReceiveAll());
+  EXPECT_EQ(0u, sender.pending());
+  EXPECT_EQ((std::vector<int>{2, 0, 1}), completed);
+  EXPECT_EQ(30, sum);
+  EXPECT_EQ(100, product);
+  EXPECT_EQ(3u, length);
+  writer.clear();
+
+  // Blocking invocations complete other pending invocations whose return
+  // values arrive first.
+  completed.clear();
+  ASSERT_TRUE((TestInterface::Sum::InvokeAsync(
+      &sender,
+      [&](Status<int> status) {
+        ASSERT_TRUE(status);
+        sum = status.get();
+        completed.push_back(3);
+      },
+      1, 2)));
+  reader.Set(Compose(3, 3, 4, 12));
+  auto status = TestInterface::Product::Invoke(&sender, 3, 4);
+  ASSERT_TRUE(status);
+  EXPECT_EQ(12, status.get());
+  EXPECT_EQ((std::vector<int>{3}), completed);
+  EXPECT_EQ(3, sum);
+  EXPECT_EQ(0u, sender.pending());
+  writer.clear();
+
+  // Return values for unknown request ids cancel the pending invocations.
+  Status<int> canceled;
+  ASSERT_TRUE((TestInterface::Sum::InvokeAsync(
+      &sender, [&](Status<int> status) { canceled = status; }, 1, 2)));
+  reader.Set(Compose(4, 3));
+  EXPECT_EQ(ErrorStatus::ProtocolError, sender.ReceiveReturn().error());
+  EXPECT_EQ(ErrorStatus::ProtocolError, canceled.error());
+  EXPECT_EQ(0u, sender.pending());
+
+  // So do failures to read the return value.
+  ASSERT_TRUE((TestInterface::Sum::InvokeAsync(
+      &sender, [&](Status<int> status) { canceled = status; }, 1, 2)));
+  reader.Set(Compose(6));
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, sender.ReceiveAll().error());
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, canceled.error());
+  EXPECT_EQ(0u, sender.pending());
+}
+
+TEST(InterfaceTests, PipelinedDispatch) {
+  TestReader sender_reader;
+  TestWriter sender_writer;
+  Deserializer<TestReader*> sender_deserializer{&sender_reader};
+  Serializer<TestWriter*> sender_serializer{&sender_writer};
+  auto sender =
+      MakePipelinedMethodSender(&sender_serializer, &sender_deserializer);
+
+  TestReader receiver_reader;
+  TestWriter receiver_writer;
+  Deserializer<TestReader*> receiver_deserializer{&receiver_reader};
+  Serializer<TestWriter*> receiver_serializer{&receiver_writer};
+  auto receiver = MakePipelinedMethodReceiver(&receiver_serializer,
+                                              &receiver_deserializer);
+
+  auto dispatcher = BindInterface(
+      TestInterface::Sum::Bind([](int a, int b) { return a + b; }),
+      TestInterface::Length::Bind(
+          [](const std::string& string) { return string.size(); }));
+
+  std::vector<int> sums;
+  std::size_t length = 0;
+  auto on_sum = [&](Status<int> status) {
+    ASSERT_TRUE(status);
+    sums.push_back(status.get());
+  };
+
+  ASSERT_TRUE((TestInterface::Sum::InvokeAsync(&sender, on_sum, 1, 2)));
+  ASSERT_TRUE((TestInterface::Length::InvokeAsync(
+      &sender,
+      [&](Status<std::size_t> status) {
+        ASSERT_TRUE(status);
+        length = status.get();
+      },
+      "foobar")));
+  ASSERT_TRUE((TestInterface::Sum::InvokeAsync(&sender, on_sum, 3, 4)));
+
+  receiver_reader.Set(sender_writer.data());
+  for (int i = 0; i < 3; i++)
+    ASSERT_TRUE(dispatcher(&receiver));
+  EXPECT_EQ(2u, receiver.request_id());
+
+  sender_reader.Set(receiver_writer.data());
+  ASSERT_TRUE(sender.ReceiveAll());
+  EXPECT_EQ((std::vector<int>{3, 7}), sums);
+  EXPECT_EQ(6u, length);
+}
+
+TEST(InterfaceTests, OneWay) {
+  static_assert(!NotifyInterface::Sum::IsOneWay::value, "");
+  static_assert(NotifyInterface::Notify::IsOneWay::value, "");
+  static_assert(NotifyInterface::Log::IsOneWay::value, "");
+
+  std::vector<std::uint8_t> expected;
+  TestReader reader;
+  TestWriter writer;
+  Deserializer<TestReader*> deserializer{&reader};
+  Serializer<TestWriter*> serializer{&writer};
+  auto sender = MakeSimpleMethodSender(&serializer, &deserializer);
+  auto receiver = MakeSimpleMethodReceiver(&serializer, &deserializer);
+
+  // One-way invocations return without reading anything.
+  reader.Set({});
+  ASSERT_TRUE((NotifyInterface::Notify::Invoke(&sender, 5)));
+  ASSERT_TRUE((NotifyInterface::Log::Invoke(&sender, "foo")));
+
+  expected = Compose(
+      EncodingByte::U64,
+      Integer<std::uint64_t>(NotifyInterface::Notify::Selector),
+      EncodingByte::Array, 1, 5, EncodingByte::U64,
+      Integer<std::uint64_t>(NotifyInterface::Log::Selector),
+      EncodingByte::Array, 1, EncodingByte::String, 3, "foo");
+  EXPECT_EQ(expected, writer.data());
+  writer.clear();
+
+  std::vector<int> notifications;
+  std::vector<std::string> messages;
+  auto dispatcher = BindInterface(
+      NotifyInterface::Sum::Bind([](int a, int b) { return a + b; }),
+      NotifyInterface::Notify::Bind(
+          [&](int value) { notifications.push_back(value); }),
+      NotifyInterface::Log::Bind(
+          [&](const std::string& message) { messages.push_back(message); }));
+
+  // Only the request/response method sends a return value.
+  reader.Set(Compose(
+      EncodingByte::U64,
+      Integer<std::uint64_t>(NotifyInterface::Notify::Selector),
+      EncodingByte::Array, 1, 5, EncodingByte::U64,
+      Integer<std::uint64_t>(NotifyInterface::Sum::Selector),
+      EncodingByte::Array, 2, 1, 2, EncodingByte::U64,
+      Integer<std::uint64_t>(NotifyInterface::Log::Selector),
+      EncodingByte::Array, 1, EncodingByte::String, 3, "foo"));
+  for (int i = 0; i < 3; i++)
+    ASSERT_TRUE(dispatcher(&receiver));
+
+  EXPECT_EQ(Compose(3), writer.data());
+  EXPECT_EQ((std::vector<int>{5}), notifications);
+  EXPECT_EQ((std::vector<std::string>{"foo"}), messages);
+  writer.clear();
+
+  // One-way invocations through a pipelined sender carry a request id that is
+  // reused by the next invocation with a return value.
+  auto pipelined_sender = MakePipelinedMethodSender(&serializer, &deserializer);
+  int sum = 0;
+  ASSERT_TRUE((NotifyInterface::Notify::Invoke(&pipelined_sender, 7)));
+  ASSERT_TRUE((NotifyInterface::Sum::InvokeAsync(
+      &pipelined_sender, [&](Status<int> status) { sum = status.get(); }, 3,
+      4)));
+
+  expected = Compose(
+      0, EncodingByte::U64,
+      Integer<std::uint64_t>(NotifyInterface::Notify::Selector),
+      EncodingByte::Array, 1, 7, 0, EncodingByte::U64,
+      Integer<std::uint64_t>(NotifyInterface::Sum::Selector),
+      EncodingByte::Array, 2, 3, 4);
+  EXPECT_EQ(expected, writer.data());
+  EXPECT_EQ(1u, pipelined_sender.pending());
+
+  reader.Set(Compose(0, 7));
+  ASSERT_TRUE(pipelined_sender.ReceiveAll());
+  EXPECT_EQ(7, sum);
+}
+
+TEST(InterfaceTests, Batch) {
+  std::vector<std::uint8_t> expected;
+  TestReader sender_reader;
+  TestWriter sender_writer;
+  Deserializer<TestReader*> sender_deserializer{&sender_reader};
+  Serializer<TestWriter*> sender_serializer{&sender_writer};
+  auto batch = MakeBatchMethodSender(&sender_serializer, &sender_deserializer);
+
+  TestReader receiver_reader;
+  TestWriter receiver_writer;
+  Deserializer<TestReader*> receiver_deserializer{&receiver_reader};
+  Serializer<TestWriter*> receiver_serializer{&receiver_writer};
+  auto receiver =
+      MakeSimpleMethodReceiver(&receiver_serializer, &receiver_deserializer);
+
+  std::vector<std::string> messages;
+  auto dispatcher = BindInterface(
+      NotifyInterface::Sum::Bind([](int a, int b) { return a + b; }),
+      NotifyInterface::Log::Bind(
+          [&](const std::string& message) { messages.push_back(message); }));
+
+  std::vector<int> sums;
+  auto on_sum = [&](Status<int> status) {
+    ASSERT_TRUE(status);
+    sums.push_back(status.get());
+  };
+
+  // Invocations are buffered until the batch is sent.
+  ASSERT_TRUE((NotifyInterface::Sum::InvokeAsync(&batch, on_sum, 1, 2)));
+  ASSERT_TRUE((NotifyInterface::Log::Invoke(&batch, "foo")));
+  ASSERT_TRUE((NotifyInterface::Sum::InvokeAsync(&batch, on_sum, 3, 4)));
+  EXPECT_EQ(3u, batch.size());
+  EXPECT_TRUE(sender_writer.data().empty());
+
+  // Dispatch the batch ahead of time, so that the return values are ready to
+  // be read when the sender sends the batch.
+  expected = Compose(
+      3, EncodingByte::U64,
+      Integer<std::uint64_t>(NotifyInterface::Sum::Selector),
+      EncodingByte::Array, 2, 1, 2, EncodingByte::U64,
+      Integer<std::uint64_t>(NotifyInterface::Log::Selector),
+      EncodingByte::Array, 1, EncodingByte::String, 3, "foo",
+      EncodingByte::U64,
+      Integer<std::uint64_t>(NotifyInterface::Sum::Selector),
+      EncodingByte::Array, 2, 3, 4);
+  receiver_reader.Set(expected);
+  ASSERT_TRUE(DispatchBatch(&receiver, dispatcher));
+  EXPECT_EQ(Compose(3, 7), receiver_writer.data());
+  EXPECT_EQ((std::vector<std::string>{"foo"}), messages);
+
+  sender_reader.Set(receiver_writer.data());
+  ASSERT_TRUE(batch.Send());
+  EXPECT_EQ(expected, sender_writer.data());
+  EXPECT_EQ((std::vector<int>{3, 7}), sums);
+  EXPECT_TRUE(batch.empty());
+  sender_writer.clear();
+
+  // Return values that fail to arrive complete the remaining invocations with
+  // the error.
+  std::vector<Status<int>> statuses;
+  auto on_status = [&](Status<int> status) { statuses.push_back(status); };
+  ASSERT_TRUE((NotifyInterface::Sum::InvokeAsync(&batch, on_status, 1, 2)));
+  ASSERT_TRUE((NotifyInterface::Sum::InvokeAsync(&batch, on_status, 3, 4)));
+
+  sender_reader.Set(Compose(3));
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, batch.Send().error());
+  ASSERT_EQ(2u, statuses.size());
+  ASSERT_TRUE(statuses[0]);
+  EXPECT_EQ(3, statuses[0].get());
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, statuses[1].error());
+  EXPECT_TRUE(batch.empty());
+
+  // Empty batches only carry the invocation count.
+  sender_writer.clear();
+  ASSERT_TRUE(batch.Send());
+  EXPECT_EQ(Compose(0), sender_writer.data());
+}
+
+TEST(InterfaceTests, ManualSelectors) {
+  TestReader reader;
+  TestWriter writer;
+  Deserializer<TestReader*> deserializer{&reader};
+  Serializer<TestWriter*> serializer{&writer};
+  auto receiver = MakeSimpleMethodReceiver(&serializer, &deserializer);
+
+  auto dispatcher =
+      BindInterface(ManualInterface::Zero::Bind([](int a) { return a; }),
+                    ManualInterface::One::Bind([](int a) { return a + 1; }),
+                    ManualInterface::Two::Bind([](int a) { return a + 2; }),
+                    ManualInterface::Five::Bind([](int a) { return a + 5; }));
+
+  EXPECT_TRUE(dispatcher.Match(0));
+  EXPECT_TRUE(dispatcher.Match(5));
+  EXPECT_FALSE(dispatcher.Match(3));
+  EXPECT_FALSE(dispatcher.Match(8));
+
+  for (std::uint8_t selector : {0, 1, 2, 5}) {
+    reader.Set(Compose(selector, EncodingByte::Array, 1, 10));
+    auto status = dispatcher(&receiver);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(Compose(static_cast<std::uint8_t>(10 + selector)),
+              writer.data());
+    writer.clear();
+  }
+
+  // Selectors that map to an occupied slot but do not match any binding.
+  reader.Set(Compose(EncodingByte::U32, Integer<std::uint32_t>(1u << 16),
+                     EncodingByte::Array, 1, 10));
+  auto status = dispatcher(&receiver);
+  EXPECT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::InvalidInterfaceMethod, status.error());
+}
+
+TEST(InterfaceTests, Router) {
+  std::vector<std::uint8_t> expected;
+  TestReader reader;
+  TestWriter writer;
+  Deserializer<TestReader*> deserializer{&reader};
+  Serializer<TestWriter*> serializer{&writer};
+  auto sender = MakeSimpleMethodSender(&serializer, &deserializer);
+  auto receiver = MakeSimpleMethodReceiver(&serializer, &deserializer);
+
+  // Invocations are prefixed with the hash of their interface.
+  auto test_sender = MakeRoutedMethodSender<TestInterface>(&sender);
+  auto notify_sender = MakeRoutedMethodSender<NotifyInterface>(&sender);
+
+  reader.Set(Compose(30));
+  auto sum = TestInterface::Sum::Invoke(&test_sender, 10, 20);
+  ASSERT_TRUE(sum);
+  EXPECT_EQ(30, sum.get());
+  ASSERT_TRUE(NotifyInterface::Notify::Invoke(&notify_sender, 5));
+
+  expected = Compose(
+      EncodingByte::U64,
+      Integer<std::uint64_t>(TestInterface::GetInterfaceHash()),
+      MethodSelectorEncoding,
+      Integer<MethodSelectorType>(TestInterface::Sum::Selector),
+      EncodingByte::Array, 2, 10, 20, EncodingByte::U64,
+      Integer<std::uint64_t>(NotifyInterface::GetInterfaceHash()),
+      EncodingByte::U64,
+      Integer<std::uint64_t>(NotifyInterface::Notify::Selector),
+      EncodingByte::Array, 1, 5);
+  EXPECT_EQ(expected, writer.data());
+  writer.clear();
+
+  // Each invocation is dispatched by the bindings of its interface, even when
+  // the interfaces share method names.
+  std::vector<int> notifications;
+  auto router = BindRoutes(
+      Route<TestInterface>(BindInterface(
+          TestInterface::Sum::Bind([](int a, int b) { return a + b; }))),
+      Route<NotifyInterface>(BindInterface(
+          NotifyInterface::Sum::Bind([](int a, int b) { return a * b; }),
+          NotifyInterface::Notify::Bind(
+              [&](int value) { notifications.push_back(value); }))));
+  EXPECT_TRUE(router.Match(TestInterface::GetInterfaceHash()));
+  EXPECT_FALSE(router.Match(ManualInterface::GetInterfaceHash()));
+
+  reader.Set(expected);
+  ASSERT_TRUE(router(&receiver));
+  ASSERT_TRUE(router(&receiver));
+  EXPECT_EQ(Compose(30), writer.data());
+  EXPECT_EQ((std::vector<int>{5}), notifications);
+  writer.clear();
+
+  // Interfaces without a route fail to dispatch.
+  reader.Set(Compose(
+      EncodingByte::U64,
+      Integer<std::uint64_t>(ManualInterface::GetInterfaceHash()),
+      EncodingByte::U64, Integer<std::uint64_t>(0), EncodingByte::Array, 0));
+  auto status = router(&receiver);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::InvalidInterfaceMethod, status.error());
+}
+
+TEST(InterfaceTests, ThreadLocalArgs) {
+  TestReader reader;
+  TestWriter writer;
+  Deserializer<TestReader*> deserializer{&reader};
+  Serializer<TestWriter*> serializer{&writer};
+  auto receiver = MakeSimpleMethodReceiver(&serializer, &deserializer);
+
+  // Handlers taking arguments by reference see them decoded in place, in
+  // storage that keeps its capacity across invocations.
+  std::vector<const char*> buffers;
+  auto dispatcher = BindInterface(TestInterface::Length::Bind(
+      [&](const std::string& string) {
+        buffers.push_back(string.data());
+        return string.size();
+      },
+      ThreadLocalArgs{}));
+
+  const std::string long_string(64, 'x');
+  const std::string short_string(32, 'y');
+  for (const std::string* string : {&long_string, &short_string}) {
+    reader.Set(Compose(
+        MethodSelectorEncoding,
+        Integer<MethodSelectorType>(TestInterface::Length::Selector),
+        EncodingByte::Array, 1, EncodingByte::String, string->size(),
+        *string));
+    ASSERT_TRUE(dispatcher(&receiver));
+  }
+
+  EXPECT_EQ(Compose(64, 32), writer.data());
+  ASSERT_EQ(2u, buffers.size());
+  EXPECT_EQ(buffers[0], buffers[1]);
+
+  // Method handlers accept the policy too.
+  struct Handler {
+    int OnSum(int a, int b) { return a + b; }
+  };
+  Handler handler;
+  auto method_dispatcher = BindInterface<Handler*>(
+      TestInterface::Sum::Bind(&Handler::OnSum, ThreadLocalArgs{}));
+
+  writer.clear();
+  reader.Set(Compose(MethodSelectorEncoding,
+                     Integer<MethodSelectorType>(TestInterface::Sum::Selector),
+                     EncodingByte::Array, 2, 1, 2));
+  ASSERT_TRUE(method_dispatcher(&receiver, &handler));
+  EXPECT_EQ(Compose(3), writer.data());
+}
+
+TEST(InterfaceTests, ServerStream) {
+  TestReader reader;
+  TestWriter writer;
+  Deserializer<TestReader*> deserializer{&reader};
+  Serializer<TestWriter*> serializer{&writer};
+  auto sender = MakeSimpleMethodSender(&serializer, &deserializer);
+  auto receiver = MakeSimpleMethodReceiver(&serializer, &deserializer);
+
+  auto dispatcher = BindInterface(
+      StreamInterface::Range::Bind(
+          [](int begin, int end, StreamWriter<int>& values) -> Status<void> {
+            if (begin > end)
+              return ErrorStatus::InvalidContainerLength;
+            for (int i = begin; i < end; i++) {
+              auto status = values.Write(i);
+              if (!status)
+                return status;
+            }
+            return {};
+          }),
+      StreamInterface::Sum::Bind([](int a, int b) { return a + b; }));
+
+  // Each value is preceded by a flag and the stream ends with the error code.
+  const auto invocation =
+      Compose(MethodSelectorEncoding,
+              Integer<MethodSelectorType>(StreamInterface::Range::Selector),
+              EncodingByte::Array, 2, 1, 4);
+  const auto stream =
+      Compose(EncodingByte::True, 1, EncodingByte::True, 2, EncodingByte::True,
+              3, EncodingByte::False, 0);
+
+  reader.Set(invocation);
+  ASSERT_TRUE(dispatcher(&receiver));
+  EXPECT_EQ(stream, writer.data());
+  writer.clear();
+
+  std::vector<int> values;
+  reader.Set(stream);
+  ASSERT_TRUE(StreamInterface::Range::Invoke(
+      &sender, [&](int value) { values.push_back(value); }, 1, 4));
+  EXPECT_EQ((std::vector<int>{1, 2, 3}), values);
+  EXPECT_EQ(invocation, writer.data());
+  writer.clear();
+
+  // Handler errors end the stream and are returned to the caller.
+  reader.Set(Compose(
+      MethodSelectorEncoding,
+      Integer<MethodSelectorType>(StreamInterface::Range::Selector),
+      EncodingByte::Array, 2, 4, 1));
+  ASSERT_TRUE(dispatcher(&receiver));
+  EXPECT_EQ(Compose(EncodingByte::False,
+                    static_cast<std::uint8_t>(
+                        ErrorStatus::InvalidContainerLength)),
+            writer.data());
+
+  values.clear();
+  reader.Set(writer.data());
+  writer.clear();
+  auto status = StreamInterface::Range::Invoke(
+      &sender, [&](int value) { values.push_back(value); }, 4, 1);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength, status.error());
+  EXPECT_TRUE(values.empty());
+}
+
+TEST(InterfaceTests, ClientStream) {
+  TestReader reader;
+  TestWriter writer;
+  Deserializer<TestReader*> deserializer{&reader};
+  Serializer<TestWriter*> serializer{&writer};
+  auto sender = MakeSimpleMethodSender(&serializer, &deserializer);
+  auto receiver = MakeSimpleMethodReceiver(&serializer, &deserializer);
+
+  // Reads at most |limit| values, leaving the rest for dispatch to discard.
+  int limit = 10;
+  Status<bool> last_read;
+  auto dispatcher = BindInterface(
+      StreamInterface::Total::Bind([&](int initial, StreamReader<int>& values) {
+        int total = initial;
+        int value;
+        for (int i = 0; i < limit; i++) {
+          last_read = values.Read(&value);
+          if (!last_read || !last_read.get())
+            break;
+          total += value;
+        }
+        return total;
+      }),
+      StreamInterface::Sum::Bind([](int a, int b) { return a + b; }));
+
+  const auto invocation =
+      Compose(MethodSelectorEncoding,
+              Integer<MethodSelectorType>(StreamInterface::Total::Selector),
+              EncodingByte::Array, 1, 10, EncodingByte::True, 1,
+              EncodingByte::True, 2, EncodingByte::True, 3,
+              EncodingByte::False, 0);
+
+  reader.Set(Compose(16));
+  auto total = StreamInterface::Total::Invoke(
+      &sender,
+      [](StreamWriter<int>& values) -> Status<void> {
+        for (int i = 1; i <= 3; i++) {
+          auto status = values.Write(i);
+          if (!status)
+            return status;
+        }
+        return {};
+      },
+      10);
+  ASSERT_TRUE(total);
+  EXPECT_EQ(16, total.get());
+  EXPECT_EQ(invocation, writer.data());
+  writer.clear();
+
+  reader.Set(invocation);
+  ASSERT_TRUE(dispatcher(&receiver));
+  EXPECT_EQ(Compose(16), writer.data());
+  ASSERT_TRUE(last_read);
+  EXPECT_FALSE(last_read.get());
+  writer.clear();
+
+  // Values the handler leaves unread are discarded, keeping the next
+  // invocation in sync.
+  limit = 1;
+  auto input = invocation;
+  const auto sum =
+      Compose(MethodSelectorEncoding,
+              Integer<MethodSelectorType>(StreamInterface::Sum::Selector),
+              EncodingByte::Array, 2, 1, 2);
+  input.insert(input.end(), sum.begin(), sum.end());
+  reader.Set(input);
+  ASSERT_TRUE(dispatcher(&receiver));
+  ASSERT_TRUE(dispatcher(&receiver));
+  EXPECT_EQ(Compose(11, 3), writer.data());
+  writer.clear();
+
+  // Producer errors end the stream and are reported to the handler; the caller
+  // receives the error after the return value is read.
+  reader.Set(Compose(11));
+  total = StreamInterface::Total::Invoke(
+      &sender,
+      [](StreamWriter<int>& values) -> Status<void> {
+        auto status = values.Write(1);
+        if (!status)
+          return status;
+        return ErrorStatus::IOError;
+      },
+      10);
+  ASSERT_FALSE(total);
+  EXPECT_EQ(ErrorStatus::IOError, total.error());
+
+  limit = 10;
+  reader.Set(writer.data());
+  writer.clear();
+  ASSERT_TRUE(dispatcher(&receiver));
+  EXPECT_EQ(Compose(11), writer.data());
+  ASSERT_FALSE(last_read);
+  EXPECT_EQ(ErrorStatus::IOError, last_read.error());
+}
+
+TEST(InterfaceTests, Instrumented) {
+  TestReader reader;
+  TestWriter writer;
+  Deserializer<TestReader*> deserializer{&reader};
+  Serializer<TestWriter*> serializer{&writer};
+  auto receiver = MakeSimpleMethodReceiver(&serializer, &deserializer);
+
+  std::vector<std::string> log;
+  auto dispatcher = Instrument(BindInterface(
+      NotifyInterface::Sum::Bind([](int a, int b) { return a + b; }),
+      NotifyInterface::Log::Bind(
+          [&](const std::string& message) { log.push_back(message); })));
+
+  reader.Set(Compose(
+      MethodSelectorEncoding,
+      Integer<MethodSelectorType>(NotifyInterface::Sum::Selector),
+      EncodingByte::Array, 2, 1, 2, MethodSelectorEncoding,
+      Integer<MethodSelectorType>(NotifyInterface::Sum::Selector),
+      EncodingByte::Array, 2, 3, 4, MethodSelectorEncoding,
+      Integer<MethodSelectorType>(NotifyInterface::Log::Selector),
+      EncodingByte::Array, 1, EncodingByte::String, 3, "foo",
+      MethodSelectorEncoding,
+      Integer<MethodSelectorType>(NotifyInterface::Notify::Selector),
+      EncodingByte::Array, 1, 5));
+  ASSERT_TRUE(dispatcher(&receiver));
+  ASSERT_TRUE(dispatcher(&receiver));
+  ASSERT_TRUE(dispatcher(&receiver));
+  EXPECT_FALSE(dispatcher(&receiver));
+  EXPECT_EQ(Compose(3, 7), writer.data());
+  EXPECT_EQ((std::vector<std::string>{"foo"}), log);
+
+  // Sizes count the encoded argument tuples and return values.
+  MethodStats sum = dispatcher.stats(NotifyInterface::Sum::Selector);
+  EXPECT_EQ(2u, sum.calls);
+  EXPECT_EQ(0u, sum.errors);
+  EXPECT_EQ(8u, sum.request_bytes);
+  EXPECT_EQ(2u, sum.response_bytes);
+  EXPECT_EQ(2u, sum.decode.count);
+  EXPECT_EQ(2u, sum.handler.count);
+  EXPECT_EQ(2u, sum.encode.count);
+
+  // One-way methods have no encode step.
+  MethodStats log_stats = dispatcher.stats(NotifyInterface::Log::Selector);
+  EXPECT_EQ(1u, log_stats.calls);
+  EXPECT_EQ(7u, log_stats.request_bytes);
+  EXPECT_EQ(0u, log_stats.response_bytes);
+  EXPECT_EQ(1u, log_stats.handler.count);
+  EXPECT_EQ(0u, log_stats.encode.count);
+
+  // Selectors without a binding are counted as unmatched errors.
+  MethodStats unmatched = dispatcher.unmatched();
+  EXPECT_EQ(1u, unmatched.calls);
+  EXPECT_EQ(1u, unmatched.errors);
+  EXPECT_EQ(0u, unmatched.decode.count);
+
+  dispatcher.Reset();
+  EXPECT_EQ(0u, dispatcher.stats(NotifyInterface::Sum::Selector).calls);
+}
+
+TEST(InterfaceTests, LatencyHistogram) {
+  using nop::LatencyHistogram;
+
+  EXPECT_EQ(0u, LatencyHistogram::Bucket(0));
+  EXPECT_EQ(1u, LatencyHistogram::Bucket(1));
+  EXPECT_EQ(2u, LatencyHistogram::Bucket(2));
+  EXPECT_EQ(2u, LatencyHistogram::Bucket(3));
+  EXPECT_EQ(11u, LatencyHistogram::Bucket(1024));
+  EXPECT_EQ(LatencyHistogram::BucketCount - 1,
+            LatencyHistogram::Bucket(~std::uint64_t{0}));
+
+  LatencyHistogram histogram;
+  for (std::uint64_t ns : {1, 2, 3, 100}) {
+    histogram.buckets[LatencyHistogram::Bucket(ns)]++;
+    histogram.count++;
+    histogram.total_ns += ns;
+  }
+  EXPECT_EQ(26u, histogram.mean());
+  EXPECT_EQ(4u, histogram.Percentile(0.5));
+  EXPECT_EQ(128u, histogram.Percentile(0.99));
+}
@@ -0,0 +1,226 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nop/base/skip.h>
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/types/view.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/interning_reader.h>
+#include <nop/utility/interning_writer.h>
+#include <nop/utility/vector_writer.h>
+
+#include "test_utilities.h"
+
+using nop::BufferReader;
+using nop::Compose;
+using nop::Deserializer;
+using nop::EncodingByte;
+using nop::Entry;
+using nop::ErrorStatus;
+using nop::InterningReader;
+using nop::InterningWriter;
+using nop::Serializer;
+using nop::SkipValue;
+using nop::StringView;
+using nop::VectorWriter;
+
+namespace {
+
+struct Attributes {
+  Entry<std::string, 0> region;
+  Entry<std::string, 1> zone;
+  NOP_TABLE(Attributes, region, zone);
+};
+
+struct LogEvent {
+  std::string host;
+  std::string service;
+  std::string message;
+  Attributes attributes;
+  NOP_STRUCTURE(LogEvent, host, service, message, attributes);
+};
+
+bool operator==(const LogEvent& a, const LogEvent& b) {
+  return a.host == b.host && a.service == b.service &&
+         a.message == b.message && a.attributes.region == b.attributes.region &&
+         a.attributes.zone == b.attributes.zone;
+}
+
+std::vector<LogEvent> MakeBatch() {
+  std::vector<LogEvent> batch;
+  for (int i = 0; i < 1000; i++) {
+    LogEvent event;
+    event.host = "frontend-host-" + std::to_string(i % 8) + ".example.com";
+    event.service = "request-router";
+    event.message = "request " + std::to_string(i);
+    event.attributes.region = std::string{"us-central"};
+    event.attributes.zone = "us-central-" + std::to_string(i % 3);
+    batch.push_back(event);
+  }
+  return batch;
+}
+
+}  // anonymous namespace
+
+TEST(Interning, RoundTrip) {
+  const std::vector<LogEvent> batch = MakeBatch();
+
+  VectorWriter plain_writer;
+  Serializer<VectorWriter*> plain_serializer{&plain_writer};
+  ASSERT_TRUE(plain_serializer.Write(batch));
+
+  VectorWriter vector_writer;
+  InterningWriter<VectorWriter> writer{&vector_writer};
+  Serializer<decltype(writer)*> serializer{&writer};
+  ASSERT_TRUE(serializer.Write(batch));
+  EXPECT_EQ(8u + 1u + 1000u + 1u + 3u, writer.string_count());
+  EXPECT_GT(plain_writer.size() / 2, vector_writer.size());
+
+  BufferReader buffer_reader{vector_writer.data(), vector_writer.size()};
+  InterningReader<BufferReader> reader{&buffer_reader};
+  Deserializer<decltype(reader)*> deserializer{&reader};
+  std::vector<LogEvent> decoded;
+  auto status = deserializer.Read(&decoded);
+  ASSERT_TRUE(status) << status.GetErrorMessage();
+  EXPECT_EQ(batch, decoded);
+  EXPECT_TRUE(buffer_reader.empty());
+
+  // The table is scoped to a message.
+  writer.Reset();
+  EXPECT_EQ(0u, writer.string_count());
+}
+
+TEST(Interning, Format) {
+  const std::vector<std::string> value = {"hostname", "short", "hostname",
+                                          "short"};
+  VectorWriter vector_writer;
+  InterningWriter<VectorWriter> writer{&vector_writer};
+  Serializer<decltype(writer)*> serializer{&writer};
+  ASSERT_TRUE(serializer.Write(value));
+
+  // Strings shorter than the minimum size are written in full.
+  const std::vector<std::uint8_t> expected = Compose(
+      EncodingByte::Array, 4, EncodingByte::Extension, 3, 9, 0, "hostname",
+      EncodingByte::String, 5, "short", EncodingByte::Extension, 4, 1, 0,
+      EncodingByte::String, 5, "short");
+  EXPECT_EQ(expected, std::vector<std::uint8_t>(
+                          vector_writer.data(),
+                          vector_writer.data() + vector_writer.size()));
+
+  // Readers without a table do not understand interned strings.
+  BufferReader buffer_reader{vector_writer.data(), vector_writer.size()};
+  Deserializer<BufferReader*> deserializer{&buffer_reader};
+  std::vector<std::string> decoded;
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            deserializer.Read(&decoded).error());
+}
+
+TEST(Interning, Views) {
+  const std::vector<std::string> value(10, "repeated string");
+  VectorWriter vector_writer;
+  InterningWriter<VectorWriter> writer{&vector_writer};
+  Serializer<decltype(writer)*> serializer{&writer};
+  ASSERT_TRUE(serializer.Write(value));
+
+  // Views of interned strings share the copy in the table.
+  BufferReader buffer_reader{vector_writer.data(), vector_writer.size()};
+  InterningReader<BufferReader> reader{&buffer_reader};
+  Deserializer<decltype(reader)*> deserializer{&reader};
+  std::vector<StringView> views;
+  ASSERT_TRUE(deserializer.Read(&views));
+  ASSERT_EQ(10u, views.size());
+  for (const StringView& view : views) {
+    EXPECT_EQ("repeated string", std::string(view.begin(), view.end()));
+    EXPECT_EQ(views[0].data(), view.data());
+  }
+
+  // Views are interned when writing as well.
+  const std::vector<StringView> input(3, StringView{"another string"});
+  vector_writer.reset();
+  writer.Reset();
+  ASSERT_TRUE(serializer.Write(input));
+  buffer_reader = BufferReader{vector_writer.data(), vector_writer.size()};
+  reader.Reset();
+  std::vector<std::string> strings;
+  ASSERT_TRUE(deserializer.Read(&strings));
+  EXPECT_EQ(std::vector<std::string>(3, "another string"), strings);
+}
+
+TEST(Interning, Skip) {
+  VectorWriter vector_writer;
+  InterningWriter<VectorWriter> writer{&vector_writer};
+  Serializer<decltype(writer)*> serializer{&writer};
+  ASSERT_TRUE(serializer.Write(std::string{"skipped hostname"}));
+  ASSERT_TRUE(serializer.Write(std::string{"skipped hostname"}));
+
+  // Skipping a definition still adds it to the table.
+  BufferReader buffer_reader{vector_writer.data(), vector_writer.size()};
+  InterningReader<BufferReader> reader{&buffer_reader};
+  ASSERT_TRUE(SkipValue(&reader));
+
+  Deserializer<decltype(reader)*> deserializer{&reader};
+  std::string value;
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ("skipped hostname", value);
+}
+
+TEST(Interning, Errors) {
+  std::string value;
+
+  // Reference to an undefined string.
+  auto data = Compose(EncodingByte::Extension, 4, 1, 0);
+  BufferReader buffer_reader{data.data(), data.size()};
+  InterningReader<BufferReader> reader{&buffer_reader};
+  Deserializer<decltype(reader)*> deserializer{&reader};
+  EXPECT_EQ(ErrorStatus::ProtocolError, deserializer.Read(&value).error());
+
+  // Duplicate definition.
+  data = Compose(EncodingByte::Extension, 3, 2, 0, "a",
+                 EncodingByte::Extension, 3, 2, 0, "b");
+  buffer_reader = BufferReader{data.data(), data.size()};
+  reader.Reset();
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ("a", value);
+  EXPECT_EQ(ErrorStatus::ProtocolError, deserializer.Read(&value).error());
+
+  // Index out of range of the table.
+  data = Compose(EncodingByte::Extension, 3, 4, EncodingByte::U16,
+                 nop::Integer<std::uint16_t>(4096), "a");
+  buffer_reader = BufferReader{data.data(), data.size()};
+  InterningReader<BufferReader> small_reader{&buffer_reader, 1024};
+  Deserializer<decltype(small_reader)*> small_deserializer{&small_reader};
+  EXPECT_EQ(ErrorStatus::ProtocolError,
+            small_deserializer.Read(&value).error());
+
+  // Inconsistent sizes.
+  data = Compose(EncodingByte::Extension, 4, 2, 0, 0);
+  buffer_reader = BufferReader{data.data(), data.size()};
+  reader.Reset();
+  EXPECT_EQ(ErrorStatus::InvalidStringLength,
+            deserializer.Read(&value).error());
+
+  // Unknown extension codes.
+  data = Compose(EncodingByte::Extension, 1, 1, 0);
+  buffer_reader = BufferReader{data.data(), data.size()};
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            deserializer.Read(&value).error());
+}
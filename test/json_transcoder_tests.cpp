@@ -0,0 +1,191 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/types/variant.h>
+#include <nop/utility/json_transcoder.h>
+#include <nop/utility/pedantic_buffer_reader.h>
+#include <nop/utility/stream_reader.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::Entry;
+using nop::PedanticBufferReader;
+using nop::ErrorStatus;
+using nop::Serializer;
+using nop::Status;
+using nop::StreamReader;
+using nop::TranscodeToJson;
+using nop::Variant;
+using nop::VectorWriter;
+
+namespace {
+
+struct Point {
+  std::int32_t x;
+  std::int32_t y;
+  NOP_STRUCTURE(Point, x, y);
+};
+
+struct Message {
+  std::string name;
+  std::vector<Point> points;
+  std::map<std::uint32_t, std::string> labels;
+  Variant<int, std::string> tag;
+  float scale;
+  NOP_STRUCTURE(Message, name, points, labels, tag, scale);
+};
+
+struct Record {
+  Entry<std::string, 0> name;
+  Entry<Point, 3> origin;
+  NOP_TABLE_NS("test.Record", Record, name, origin);
+};
+
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  return serializer.writer().take();
+}
+
+// Transcodes |data| to JSON.
+Status<std::string> JsonOf(const std::vector<std::uint8_t>& data,
+                           std::size_t max_depth = 64) {
+  PedanticBufferReader reader{data.data(), data.size()};
+  VectorWriter writer;
+  auto status = TranscodeToJson(&reader, &writer, max_depth);
+  if (!status)
+    return status.error();
+
+  return std::string(writer.data(), writer.data() + writer.size());
+}
+
+// Transcodes the encoding of |value| to JSON.
+template <typename T>
+std::string ToJson(const T& value) {
+  auto json = JsonOf(Encode(value));
+  EXPECT_TRUE(json);
+  return json ? json.get() : std::string{};
+}
+
+}  // anonymous namespace
+
+TEST(JsonTranscoder, Scalars) {
+  EXPECT_EQ("0", ToJson(0));
+  EXPECT_EQ("127", ToJson(127));
+  EXPECT_EQ("-32", ToJson(-32));
+  EXPECT_EQ("-33", ToJson(-33));
+  EXPECT_EQ("200", ToJson(std::uint8_t{200}));
+  EXPECT_EQ("18446744073709551615",
+            ToJson(std::numeric_limits<std::uint64_t>::max()));
+  EXPECT_EQ("-9223372036854775808",
+            ToJson(std::numeric_limits<std::int64_t>::min()));
+  EXPECT_EQ("1", ToJson(true));
+  EXPECT_EQ("1.5", ToJson(1.5f));
+  EXPECT_EQ("0.10000000000000001", ToJson(0.1));
+  EXPECT_EQ("null", ToJson(std::numeric_limits<double>::infinity()));
+}
+
+TEST(JsonTranscoder, Strings) {
+  EXPECT_EQ("\"\"", ToJson(std::string{}));
+  EXPECT_EQ("\"plain text that is longer than one word\"",
+            ToJson(std::string{"plain text that is longer than one word"}));
+  EXPECT_EQ("\"quote\\\" backslash\\\\ newline\\n tab\\t bell\\u0007\"",
+            ToJson(std::string{"quote\" backslash\\ newline\n tab\t bell\a"}));
+  EXPECT_EQ("\"caf\xc3\xa9\"", ToJson(std::string{"caf\xc3\xa9"}));
+
+  // Escapes are found at every position within a word.
+  for (std::size_t i = 0; i < 20; i++) {
+    std::string value(20, 'a');
+    value[i] = '"';
+    std::string expected = "\"" + value + "\"";
+    expected.insert(i + 1, "\\");
+    EXPECT_EQ(expected, ToJson(value)) << "i=" << i;
+  }
+}
+
+TEST(JsonTranscoder, Binary) {
+  EXPECT_EQ("\"\"", ToJson(std::vector<std::uint8_t>{}));
+  EXPECT_EQ("\"Zg==\"", ToJson(std::vector<std::uint8_t>{'f'}));
+  EXPECT_EQ("\"Zm8=\"", ToJson(std::vector<std::uint8_t>{'f', 'o'}));
+  EXPECT_EQ("\"Zm9v\"", ToJson(std::vector<std::uint8_t>{'f', 'o', 'o'}));
+  EXPECT_EQ("\"Zm9vYmFy\"",
+            ToJson(std::vector<std::uint8_t>{'f', 'o', 'o', 'b', 'a', 'r'}));
+}
+
+TEST(JsonTranscoder, Composites) {
+  Message message{"shape",
+                  {{1, 2}, {-3, 400}},
+                  {{1, "one"}, {2, "two"}},
+                  Variant<int, std::string>{std::string{"tag"}},
+                  0.5f};
+  EXPECT_EQ(
+      "[\"shape\",[[1,2],[-3,400]],{\"1\":\"one\",\"2\":\"two\"},"
+      "{\"index\":1,\"value\":\"tag\"},0.5]",
+      ToJson(message));
+
+  EXPECT_EQ("{\"index\":-1,\"value\":null}",
+            ToJson(Variant<int, std::string>{}));
+
+  Record record;
+  record.name = "record";
+  record.origin = Point{5, 6};
+  EXPECT_EQ("{\"0\":\"record\",\"3\":[5,6]}", ToJson(record));
+  record.name.clear();
+  EXPECT_EQ("{\"3\":[5,6]}", ToJson(record));
+
+  std::map<std::vector<int>, int> composite_keys{{{1, 2}, 3}};
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            JsonOf(Encode(composite_keys)).error());
+}
+
+TEST(JsonTranscoder, Stream) {
+  // Readers that do not expose their input are read in chunks.
+  const std::string value(1000, 'x');
+  const std::vector<std::uint8_t> data = Encode(value);
+  StreamReader<std::stringstream> reader{
+      std::string(data.begin(), data.end())};
+  VectorWriter writer;
+  ASSERT_TRUE(TranscodeToJson(&reader, &writer));
+  EXPECT_EQ("\"" + value + "\"",
+            std::string(writer.data(), writer.data() + writer.size()));
+}
+
+TEST(JsonTranscoder, Errors) {
+  std::vector<std::uint8_t> data = Encode(std::vector<std::string>{"a", "b"});
+  for (std::size_t size = 0; size < data.size(); size++) {
+    EXPECT_EQ(ErrorStatus::ReadLimitReached,
+              JsonOf({data.begin(), data.begin() + size}).error())
+        << "size=" << size;
+  }
+
+  // Reserved prefixes are rejected.
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType, JsonOf({0x8a}).error());
+
+  // Nesting is limited.
+  std::vector<std::vector<std::vector<int>>> nested{{{1}}};
+  EXPECT_TRUE(JsonOf(Encode(nested), 2));
+  EXPECT_EQ(ErrorStatus::ProtocolError, JsonOf(Encode(nested), 1).error());
+}
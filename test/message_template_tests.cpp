@@ -0,0 +1,177 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/message_template.h>
+#include <nop/utility/vector_writer.h>
+
+#include "test_utilities.h"
+
+using nop::BufferReader;
+using nop::Compose;
+using nop::Deserializer;
+using nop::Encoding;
+using nop::EncodingByte;
+using nop::Entry;
+using nop::ErrorStatus;
+using nop::Integer;
+using nop::MessageTemplate;
+using nop::Serializer;
+using nop::Slot;
+using nop::VectorWriter;
+
+namespace {
+
+enum class Kind : std::uint16_t { Heartbeat, Ack };
+
+struct Heartbeat {
+  Slot<std::uint64_t> sequence;
+  Kind kind;
+  std::uint32_t node;
+  Slot<std::int32_t> delay;
+  NOP_STRUCTURE(Heartbeat, sequence, kind, node, delay);
+};
+
+struct PlainHeartbeat {
+  std::uint64_t sequence;
+  Kind kind;
+  std::uint32_t node;
+  std::int32_t delay;
+  NOP_STRUCTURE(PlainHeartbeat, sequence, kind, node, delay);
+};
+
+struct Ack {
+  nop::Entry<std::uint32_t, 0> node;
+  nop::Entry<Slot<Kind>, 1> kind;
+  nop::Entry<Slot<std::uint8_t>, 2> window;
+  NOP_TABLE_NS("Ack", Ack, node, kind, window);
+};
+
+constexpr Heartbeat kHeartbeat{0, Kind::Heartbeat, 7, 0};
+constexpr MessageTemplate<Encoding<Heartbeat>::Size(kHeartbeat)>
+    kHeartbeatTemplate{kHeartbeat};
+
+template <typename T>
+std::vector<std::uint8_t> Serialize(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  return serializer.writer().take();
+}
+
+template <typename T>
+std::vector<std::uint8_t> Bytes(const T& message) {
+  return {message.data(), message.data() + message.size()};
+}
+
+}  // anonymous namespace
+
+TEST(Slot, Encoding) {
+  // Slots are always encoded at full width.
+  EXPECT_EQ(Compose(EncodingByte::U32, Integer<std::uint32_t>(1)),
+            Serialize(Slot<std::uint32_t>{1}));
+  EXPECT_EQ(Compose(EncodingByte::I16, Integer<std::int16_t>(-1)),
+            Serialize(Slot<std::int16_t>{-1}));
+  EXPECT_EQ(5u, Encoding<Slot<std::uint32_t>>::Size(0));
+
+  // Slots and their integer types are fungible.
+  std::vector<std::uint8_t> data = Serialize(Slot<std::uint32_t>{0x1234});
+  BufferReader reader{data.data(), data.size()};
+  Deserializer<BufferReader*> deserializer{&reader};
+  std::uint32_t value = 0;
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ(0x1234u, value);
+
+  data = Serialize(std::uint32_t{5});
+  reader = BufferReader{data.data(), data.size()};
+  Slot<std::uint32_t> slot;
+  ASSERT_TRUE(deserializer.Read(&slot));
+  EXPECT_EQ(5u, slot.get());
+}
+
+TEST(MessageTemplate, Constexpr) {
+  static_assert(kHeartbeatTemplate.status(), "");
+  static_assert(kHeartbeatTemplate.slot_count() == 2, "");
+  static_assert(kHeartbeatTemplate.slot_prefix(0) == EncodingByte::U64, "");
+  static_assert(kHeartbeatTemplate.slot_offset(0) == 3, "");
+  static_assert(kHeartbeatTemplate.slot_prefix(1) == EncodingByte::I32, "");
+  static_assert(kHeartbeatTemplate.data()[0] ==
+                    static_cast<std::uint8_t>(EncodingByte::Structure),
+                "");
+
+  EXPECT_EQ(Serialize(kHeartbeat), Bytes(kHeartbeatTemplate));
+}
+
+TEST(MessageTemplate, Patch) {
+  auto message = kHeartbeatTemplate;
+  for (std::uint64_t sequence = 1; sequence < (1ull << 40); sequence <<= 3) {
+    const std::int32_t delay = -static_cast<std::int32_t>(sequence % 1000);
+    ASSERT_TRUE(message.Patch<std::uint64_t>(0, sequence));
+    ASSERT_TRUE(message.Patch(1, delay));
+    EXPECT_EQ(Serialize(Heartbeat{sequence, Kind::Heartbeat, 7, delay}),
+              Bytes(message));
+
+    // The patched message decodes as the plain structure.
+    BufferReader reader{message.data(), message.size()};
+    Deserializer<BufferReader*> deserializer{&reader};
+    PlainHeartbeat heartbeat;
+    ASSERT_TRUE(deserializer.Read(&heartbeat));
+    EXPECT_EQ(sequence, heartbeat.sequence);
+    EXPECT_EQ(Kind::Heartbeat, heartbeat.kind);
+    EXPECT_EQ(7u, heartbeat.node);
+    EXPECT_EQ(delay, heartbeat.delay);
+  }
+
+  // Patches must match the slot type.
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            message.Patch<std::uint32_t>(0, 1).error());
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            message.Patch<std::int32_t>(2, 1).error());
+}
+
+TEST(MessageTemplate, Table) {
+  Ack ack;
+  ack.node = 3;
+  ack.kind = Slot<Kind>{Kind::Ack};
+  ack.window = Slot<std::uint8_t>{0};
+
+  MessageTemplate<64> message{ack};
+  ASSERT_TRUE(message.status());
+  ASSERT_EQ(2u, message.slot_count());
+  ASSERT_TRUE(message.Patch<std::uint8_t>(1, 16));
+
+  // Entry sizes may be encoded differently by other writers, so compare the
+  // decoded table instead of the bytes.
+  BufferReader reader{message.data(), message.size()};
+  Deserializer<BufferReader*> deserializer{&reader};
+  Ack decoded;
+  ASSERT_TRUE(deserializer.Read(&decoded));
+  EXPECT_EQ(3u, decoded.node.get());
+  EXPECT_EQ(Kind::Ack, decoded.kind.get().get());
+  EXPECT_EQ(16u, decoded.window.get().get());
+  EXPECT_TRUE(reader.empty());
+
+  // Too many slots or too small a template fails.
+  EXPECT_EQ(ErrorStatus::WriteLimitReached,
+            (MessageTemplate<64, 1>{ack}.status().error()));
+  EXPECT_EQ(ErrorStatus::WriteLimitReached,
+            (MessageTemplate<8>{ack}.status().error()));
+}
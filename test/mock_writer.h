@@ -27,6 +27,9 @@ namespace nop {
 namespace testing {
 
 struct MockWriter {
+  // Expectations are set on each value written, so staged writes are disabled.
+  using SkipStaging = void;
+
   MOCK_METHOD1(Prepare, Status<void>(std::size_t size));
   MOCK_METHOD1(Write, Status<void>(std::uint8_t byte));
   MOCK_METHOD2(Write, Status<void>(const void* begin, const void* end));
@@ -0,0 +1,125 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/utility/arena.h>
+#include <nop/utility/buffer_pool.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/page_allocator.h>
+
+using nop::AllocatePages;
+using nop::Arena;
+using nop::BasicBufferPool;
+using nop::BasicPooledSerializer;
+using nop::CurrentNumaNode;
+using nop::Deserializer;
+using nop::FreePages;
+using nop::kHugePageSize;
+using nop::PageAllocator;
+using nop::PageOptions;
+
+namespace {
+
+using LocalHugePageAllocator =
+    PageAllocator<std::uint8_t,
+                  PageOptions::HugePages | PageOptions::LocalNode>;
+
+}  // anonymous namespace
+
+TEST(PageAllocator, AllocatePages) {
+  EXPECT_LE(-1, CurrentNumaNode());
+
+  // Small mappings are page aligned.
+  const unsigned options = PageOptions::HugePages | PageOptions::LocalNode;
+  void* pointer = AllocatePages(100, options);
+  ASSERT_NE(nullptr, pointer);
+  EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(pointer) % ::getpagesize());
+  static_cast<std::uint8_t*>(pointer)[99] = 1;
+  FreePages(pointer, 100, options);
+
+  // Huge page mappings are aligned to the huge page size.
+  const std::size_t size = kHugePageSize + 1;
+  pointer = AllocatePages(size, options);
+  ASSERT_NE(nullptr, pointer);
+  EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(pointer) % kHugePageSize);
+  EXPECT_EQ(0u, static_cast<std::uint8_t*>(pointer)[size - 1]);
+  static_cast<std::uint8_t*>(pointer)[size - 1] = 1;
+  FreePages(pointer, size, options);
+}
+
+TEST(PageAllocator, Vector) {
+  // Grows from heap allocations to page mappings.
+  std::vector<std::uint32_t, PageAllocator<std::uint32_t>> values;
+  for (std::uint32_t i = 0; i < 100000; i++)
+    values.push_back(i);
+  EXPECT_EQ(std::uint64_t{100000} * 99999 / 2,
+            std::accumulate(values.begin(), values.end(), std::uint64_t{0}));
+
+  std::vector<std::uint8_t, LocalHugePageAllocator> buffer(3 * kHugePageSize,
+                                                           0xff);
+  EXPECT_EQ(0u,
+            reinterpret_cast<std::uintptr_t>(buffer.data()) % kHugePageSize);
+  EXPECT_EQ(0xff, buffer.back());
+}
+
+TEST(PageAllocator, BufferPool) {
+  BasicBufferPool<LocalHugePageAllocator> pool{2, 1 << 20};
+  {
+    BasicPooledSerializer<LocalHugePageAllocator> serializer{&pool};
+    ASSERT_TRUE(serializer.Write(std::vector<std::uint32_t>(50000, 7)));
+
+    Deserializer<nop::BufferReader> deserializer{serializer.writer().data(),
+                                                 serializer.writer().size()};
+    std::vector<std::uint32_t> value;
+    ASSERT_TRUE(deserializer.Read(&value));
+    EXPECT_EQ(std::vector<std::uint32_t>(50000, 7), value);
+  }
+  EXPECT_EQ(1u, pool.size());
+
+  // Buffers from the thread-local pool for the allocator are returned to it.
+  {
+    BasicPooledSerializer<LocalHugePageAllocator> serializer;
+    ASSERT_TRUE(serializer.Write(std::uint32_t{1}));
+    EXPECT_EQ(&nop::ThreadLocalBasicBufferPool<LocalHugePageAllocator>(),
+              serializer.pool());
+  }
+}
+
+TEST(PageAllocator, Arena) {
+  Arena arena{kHugePageSize, PageOptions::HugePages | PageOptions::LocalNode};
+
+  auto* small = static_cast<std::uint8_t*>(arena.Allocate(100, 8));
+  ASSERT_NE(nullptr, small);
+  EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(small) % kHugePageSize);
+  EXPECT_EQ(kHugePageSize, arena.capacity());
+
+  // Larger allocations get their own block.
+  auto* large =
+      static_cast<std::uint8_t*>(arena.Allocate(3 * kHugePageSize, 64));
+  ASSERT_NE(nullptr, large);
+  large[3 * kHugePageSize - 1] = 1;
+  EXPECT_LT(3 * kHugePageSize, arena.capacity());
+
+  arena.Reset();
+  EXPECT_EQ(small, arena.Allocate(100, 8));
+  arena.Clear();
+  EXPECT_EQ(0u, arena.capacity());
+}
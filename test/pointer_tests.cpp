@@ -0,0 +1,320 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/interning_reader.h>
+#include <nop/utility/interning_writer.h>
+#include <nop/utility/vector_writer.h>
+
+#include "test_utilities.h"
+
+using nop::BufferReader;
+using nop::Compose;
+using nop::Deserializer;
+using nop::EncodingByte;
+using nop::ErrorStatus;
+using nop::InterningReader;
+using nop::InterningWriter;
+using nop::Serializer;
+using nop::VectorWriter;
+
+namespace {
+
+struct Mesh {
+  std::string name;
+  std::vector<float> vertices;
+  NOP_STRUCTURE(Mesh, name, vertices);
+};
+
+struct Instance {
+  std::uint32_t id;
+  std::shared_ptr<const Mesh> mesh;
+  NOP_STRUCTURE(Instance, id, mesh);
+};
+
+struct Node {
+  std::int32_t value;
+  std::vector<std::shared_ptr<Node>> children;
+  NOP_STRUCTURE(Node, value, children);
+};
+
+// Type that is only constructible for decoding.
+class Label {
+ public:
+  explicit Label(std::string text) : text_{std::move(text)} {}
+  explicit Label(nop::DecodeTag) {}
+
+  const std::string& text() const { return text_; }
+
+ private:
+  std::string text_;
+  NOP_STRUCTURE(Label, text_);
+};
+
+std::vector<std::uint8_t> Data(const VectorWriter& writer) {
+  return {writer.data(), writer.data() + writer.size()};
+}
+
+}  // anonymous namespace
+
+TEST(Pointer, Plain) {
+  VectorWriter writer;
+  Serializer<VectorWriter*> serializer{&writer};
+
+  // Pointers use the same formats as optional values.
+  std::unique_ptr<std::int32_t> unique;
+  ASSERT_TRUE(serializer.Write(unique));
+  unique.reset(new std::int32_t{200});
+  ASSERT_TRUE(serializer.Write(unique));
+  std::shared_ptr<const std::string> shared = std::make_shared<std::string>();
+  ASSERT_TRUE(serializer.Write(shared));
+
+  const std::vector<std::uint8_t> expected =
+      Compose(EncodingByte::Nil, EncodingByte::I16, 200, 0,
+              EncodingByte::String, 0);
+  EXPECT_EQ(expected, Data(writer));
+  EXPECT_EQ(1u, serializer.GetSize(std::unique_ptr<std::int32_t>{}));
+  EXPECT_EQ(3u, serializer.GetSize(unique));
+
+  BufferReader reader{writer.data(), writer.size()};
+  Deserializer<BufferReader*> deserializer{&reader};
+  std::unique_ptr<std::int32_t> unique_value{new std::int32_t{1}};
+  ASSERT_TRUE(deserializer.Read(&unique_value));
+  EXPECT_EQ(nullptr, unique_value);
+  ASSERT_TRUE(deserializer.Read(&unique_value));
+  ASSERT_NE(nullptr, unique_value);
+  EXPECT_EQ(200, *unique_value);
+  std::shared_ptr<const std::string> shared_value;
+  ASSERT_TRUE(deserializer.Read(&shared_value));
+  ASSERT_NE(nullptr, shared_value);
+  EXPECT_EQ("", *shared_value);
+
+  // Without a table, each occurrence of a shared object is written in full.
+  const auto mesh = std::make_shared<const Mesh>(Mesh{"cube", {1.f, 2.f}});
+  const std::vector<Instance> instances = {{1, mesh}, {2, mesh}};
+  writer.reset();
+  ASSERT_TRUE(serializer.Write(instances));
+  reader = BufferReader{writer.data(), writer.size()};
+  std::vector<Instance> decoded;
+  ASSERT_TRUE(deserializer.Read(&decoded));
+  ASSERT_EQ(2u, decoded.size());
+  EXPECT_EQ("cube", decoded[0].mesh->name);
+  EXPECT_NE(decoded[0].mesh, decoded[1].mesh);
+}
+
+TEST(Pointer, Shared) {
+  const auto mesh = std::make_shared<const Mesh>(
+      Mesh{"terrain", std::vector<float>(1000, 0.5f)});
+  const auto other = std::make_shared<const Mesh>(Mesh{"tree", {1.f}});
+  std::vector<Instance> instances;
+  for (std::uint32_t i = 0; i < 100; i++)
+    instances.push_back({i, i % 10 == 0 ? other : mesh});
+  instances.push_back({100, nullptr});
+
+  VectorWriter plain_writer;
+  Serializer<VectorWriter*> plain_serializer{&plain_writer};
+  ASSERT_TRUE(plain_serializer.Write(instances));
+
+  VectorWriter vector_writer;
+  InterningWriter<VectorWriter> writer{&vector_writer};
+  Serializer<decltype(writer)*> serializer{&writer};
+  ASSERT_TRUE(serializer.Write(instances));
+  EXPECT_EQ(2u, writer.object_count());
+  EXPECT_GT(plain_writer.size() / 50, vector_writer.size());
+
+  // Each object is decoded once and shared by the pointers that referred to
+  // it.
+  BufferReader buffer_reader{vector_writer.data(), vector_writer.size()};
+  InterningReader<BufferReader> reader{&buffer_reader};
+  Deserializer<decltype(reader)*> deserializer{&reader};
+  std::vector<Instance> decoded;
+  auto status = deserializer.Read(&decoded);
+  ASSERT_TRUE(status) << status.GetErrorMessage();
+  ASSERT_EQ(101u, decoded.size());
+  EXPECT_EQ(mesh->vertices, decoded[1].mesh->vertices);
+  EXPECT_EQ("tree", decoded[0].mesh->name);
+  for (std::uint32_t i = 0; i < 100; i++) {
+    EXPECT_EQ(i, decoded[i].id);
+    EXPECT_EQ(decoded[i % 10 == 0 ? 0 : 1].mesh, decoded[i].mesh);
+  }
+  EXPECT_EQ(nullptr, decoded[100].mesh);
+  EXPECT_TRUE(buffer_reader.empty());
+
+  // Objects outlive the tables.
+  reader.Reset();
+  EXPECT_EQ(90, decoded[1].mesh.use_count());
+
+  // The table is scoped to a message.
+  writer.Reset();
+  EXPECT_EQ(0u, writer.object_count());
+}
+
+TEST(Pointer, Format) {
+  const auto value = std::make_shared<std::int32_t>(200);
+  const std::vector<std::shared_ptr<std::int32_t>> values = {value, value};
+  VectorWriter vector_writer;
+  InterningWriter<VectorWriter> writer{&vector_writer};
+  Serializer<decltype(writer)*> serializer{&writer};
+  ASSERT_TRUE(serializer.Write(values));
+
+  const std::vector<std::uint8_t> expected = Compose(
+      EncodingByte::Array, 2, EncodingByte::Extension, 5, EncodingByte::U32,
+      4, 0, 0, 0, 0, EncodingByte::I16, 200, 0, EncodingByte::Extension, 6, 1,
+      0);
+  EXPECT_EQ(expected, Data(vector_writer));
+
+  // Readers without a table do not understand shared objects.
+  BufferReader buffer_reader{vector_writer.data(), vector_writer.size()};
+  Deserializer<BufferReader*> deserializer{&buffer_reader};
+  std::vector<std::shared_ptr<std::int32_t>> decoded;
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            deserializer.Read(&decoded).error());
+}
+
+TEST(Pointer, Graph) {
+  // A diamond: both children of the root share the same grandchild.
+  auto leaf = std::make_shared<Node>(Node{3, {}});
+  auto left = std::make_shared<Node>(Node{1, {leaf}});
+  auto right = std::make_shared<Node>(Node{2, {leaf}});
+  const Node root{0, {left, right, left}};
+
+  VectorWriter vector_writer;
+  InterningWriter<VectorWriter> writer{&vector_writer};
+  Serializer<decltype(writer)*> serializer{&writer};
+  ASSERT_TRUE(serializer.Write(root));
+  EXPECT_EQ(3u, writer.object_count());
+
+  BufferReader buffer_reader{vector_writer.data(), vector_writer.size()};
+  InterningReader<BufferReader> reader{&buffer_reader};
+  Deserializer<decltype(reader)*> deserializer{&reader};
+  Node decoded;
+  auto status = deserializer.Read(&decoded);
+  ASSERT_TRUE(status) << status.GetErrorMessage();
+  ASSERT_EQ(3u, decoded.children.size());
+  EXPECT_EQ(decoded.children[0], decoded.children[2]);
+  EXPECT_EQ(1, decoded.children[0]->value);
+  EXPECT_EQ(2, decoded.children[1]->value);
+  ASSERT_EQ(1u, decoded.children[0]->children.size());
+  ASSERT_EQ(1u, decoded.children[1]->children.size());
+  EXPECT_EQ(decoded.children[0]->children[0],
+            decoded.children[1]->children[0]);
+  EXPECT_EQ(3, decoded.children[0]->children[0]->value);
+}
+
+TEST(Pointer, DecodeConstruct) {
+  static_assert(!std::is_default_constructible<Label>::value, "");
+
+  VectorWriter vector_writer;
+  InterningWriter<VectorWriter> writer{&vector_writer};
+  Serializer<decltype(writer)*> serializer{&writer};
+  const auto shared = std::make_shared<const Label>("shared");
+  ASSERT_TRUE(serializer.Write(std::unique_ptr<Label>{new Label{"unique"}}));
+  ASSERT_TRUE(serializer.Write(std::vector<std::shared_ptr<const Label>>{
+      shared, shared}));
+
+  // Pointed-to objects are constructed through their decode constructors,
+  // with or without a table.
+  BufferReader buffer_reader{vector_writer.data(), vector_writer.size()};
+  InterningReader<BufferReader> reader{&buffer_reader};
+  Deserializer<decltype(reader)*> deserializer{&reader};
+  std::unique_ptr<Label> unique;
+  ASSERT_TRUE(deserializer.Read(&unique));
+  ASSERT_NE(nullptr, unique);
+  EXPECT_EQ("unique", unique->text());
+  std::vector<std::shared_ptr<const Label>> decoded;
+  ASSERT_TRUE(deserializer.Read(&decoded));
+  ASSERT_EQ(2u, decoded.size());
+  EXPECT_EQ("shared", decoded[0]->text());
+  EXPECT_EQ(decoded[0], decoded[1]);
+
+  VectorWriter plain_writer;
+  Serializer<VectorWriter*> plain_serializer{&plain_writer};
+  ASSERT_TRUE(plain_serializer.Write(shared));
+  BufferReader plain_reader{plain_writer.data(), plain_writer.size()};
+  Deserializer<BufferReader*> plain_deserializer{&plain_reader};
+  std::shared_ptr<const Label> plain;
+  ASSERT_TRUE(plain_deserializer.Read(&plain));
+  ASSERT_NE(nullptr, plain);
+  EXPECT_EQ("shared", plain->text());
+}
+
+TEST(Pointer, Errors) {
+  std::shared_ptr<std::int32_t> value;
+
+  // Reference to an undefined object.
+  auto data = Compose(EncodingByte::Extension, 6, 1, 0);
+  BufferReader buffer_reader{data.data(), data.size()};
+  InterningReader<BufferReader> reader{&buffer_reader};
+  Deserializer<decltype(reader)*> deserializer{&reader};
+  EXPECT_EQ(ErrorStatus::ProtocolError, deserializer.Read(&value).error());
+
+  // Reference to an object of another type.
+  data = Compose(EncodingByte::Extension, 5, EncodingByte::U32, 3, 0, 0, 0, 0,
+                 EncodingByte::String, 0, EncodingByte::Extension, 6, 1, 0);
+  buffer_reader = BufferReader{data.data(), data.size()};
+  reader.Reset();
+  std::shared_ptr<std::string> string;
+  ASSERT_TRUE(deserializer.Read(&string));
+  EXPECT_EQ(ErrorStatus::ProtocolError, deserializer.Read(&value).error());
+
+  // Duplicate definition.
+  data = Compose(EncodingByte::Extension, 5, EncodingByte::U32, 2, 0, 0, 0, 0,
+                 1, EncodingByte::Extension, 5, EncodingByte::U32, 2, 0, 0, 0,
+                 0, 2);
+  buffer_reader = BufferReader{data.data(), data.size()};
+  reader.Reset();
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ(ErrorStatus::ProtocolError, deserializer.Read(&value).error());
+
+  // Unknown extension code.
+  data = Compose(EncodingByte::Extension, 3, 1, 0);
+  buffer_reader = BufferReader{data.data(), data.size()};
+  reader.Reset();
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            deserializer.Read(&value).error());
+
+  // Reference with an inconsistent size.
+  data = Compose(EncodingByte::Extension, 6, 2, 0);
+  buffer_reader = BufferReader{data.data(), data.size()};
+  reader.Reset();
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+            deserializer.Read(&value).error());
+
+  // Definitions whose size does not match the object they hold. Readers that
+  // skip the definition by its size would otherwise parse the bytes after it
+  // differently.
+  data = Compose(EncodingByte::Extension, 5, EncodingByte::U32, 3, 0, 0, 0, 0,
+                 1, 2);
+  buffer_reader = BufferReader{data.data(), data.size()};
+  reader.Reset();
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+            deserializer.Read(&value).error());
+
+  data = Compose(EncodingByte::Extension, 5, EncodingByte::U32, 2, 0, 0, 0, 0,
+                 EncodingByte::I16, 200, 0);
+  buffer_reader = BufferReader{data.data(), data.size()};
+  reader.Reset();
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, deserializer.Read(&value).error());
+}
@@ -0,0 +1,217 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/types/pre_encoded.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/vector_writer.h>
+
+#include "test_utilities.h"
+
+using nop::BufferReader;
+using nop::Cached;
+using nop::Compose;
+using nop::Deserializer;
+using nop::EncodingByte;
+using nop::Entry;
+using nop::ErrorStatus;
+using nop::FillCache;
+using nop::PreEncode;
+using nop::PreEncoded;
+using nop::Serializer;
+using nop::VectorWriter;
+
+namespace {
+
+struct Catalog {
+  std::string name;
+  std::map<std::uint32_t, std::string> items;
+  NOP_STRUCTURE(Catalog, name, items);
+};
+
+bool operator==(const Catalog& a, const Catalog& b) {
+  return a.name == b.name && a.items == b.items;
+}
+
+struct Response {
+  std::uint64_t id;
+  Cached<Catalog> catalog;
+  NOP_STRUCTURE(Response, id, catalog);
+};
+
+struct Envelope {
+  Entry<std::uint32_t, 0> route;
+  Entry<Cached<Catalog>, 1> catalog;
+  NOP_TABLE(Envelope, route, catalog);
+};
+
+Catalog MakeCatalog() {
+  Catalog catalog{"catalog", {}};
+  for (std::uint32_t i = 0; i < 100; i++)
+    catalog.items[i] = "item-" + std::to_string(i);
+  return catalog;
+}
+
+std::vector<std::uint8_t> Data(const VectorWriter& writer) {
+  return {writer.data(), writer.data() + writer.size()};
+}
+
+}  // anonymous namespace
+
+TEST(Cached, Write) {
+  VectorWriter plain_writer;
+  Serializer<VectorWriter*> plain_serializer{&plain_writer};
+  ASSERT_TRUE(plain_serializer.Write(std::uint64_t{1}));
+  ASSERT_TRUE(plain_serializer.Write(MakeCatalog()));
+
+  // The first write fills the cache; later writes copy it.
+  Response response{1, MakeCatalog()};
+  EXPECT_FALSE(response.catalog.cached());
+  VectorWriter writer;
+  Serializer<VectorWriter*> serializer{&writer};
+  for (int i = 0; i < 3; i++) {
+    writer.reset();
+    ASSERT_TRUE(serializer.Write(response));
+    EXPECT_TRUE(response.catalog.cached());
+    EXPECT_EQ(Compose(EncodingByte::Structure, 2), std::vector<std::uint8_t>(
+                                                       writer.data(),
+                                                       writer.data() + 2));
+    EXPECT_EQ(plain_writer.buffer(),
+              std::vector<std::uint8_t>(writer.data() + 2,
+                                        writer.data() + writer.size()));
+  }
+  EXPECT_EQ(writer.size(), serializer.GetSize(response));
+
+  // Modifying the value discards the cache.
+  response.catalog->items[1000] = "added";
+  EXPECT_FALSE(response.catalog.cached());
+  writer.reset();
+  ASSERT_TRUE(serializer.Write(response));
+
+  BufferReader reader{writer.data(), writer.size()};
+  Deserializer<BufferReader*> deserializer{&reader};
+  Response decoded;
+  ASSERT_TRUE(deserializer.Read(&decoded));
+  EXPECT_EQ(1u, decoded.id);
+  EXPECT_EQ(response.catalog, decoded.catalog);
+  EXPECT_FALSE(decoded.catalog.cached());
+
+  // The cache may be filled ahead of time.
+  const Cached<Catalog> catalog{MakeCatalog()};
+  ASSERT_TRUE(FillCache(catalog));
+  EXPECT_TRUE(catalog.cached());
+  EXPECT_EQ(plain_writer.size() - 1, catalog.encoded().size());
+}
+
+TEST(Cached, Table) {
+  Envelope envelope;
+  envelope.route = 7u;
+  envelope.catalog = Cached<Catalog>{MakeCatalog()};
+
+  VectorWriter writer;
+  Serializer<VectorWriter*> serializer{&writer};
+  ASSERT_TRUE(serializer.Write(envelope));
+  ASSERT_TRUE(serializer.Write(envelope));
+
+  BufferReader reader{writer.data(), writer.size()};
+  Deserializer<BufferReader*> deserializer{&reader};
+  for (int i = 0; i < 2; i++) {
+    Envelope decoded;
+    ASSERT_TRUE(deserializer.Read(&decoded));
+    ASSERT_TRUE(decoded.catalog);
+    EXPECT_EQ(MakeCatalog(), decoded.catalog.get().get());
+  }
+}
+
+TEST(PreEncoded, Write) {
+  auto status = PreEncode(MakeCatalog());
+  ASSERT_TRUE(status);
+  const PreEncoded pre_encoded = status.take();
+
+  VectorWriter plain_writer;
+  Serializer<VectorWriter*> plain_serializer{&plain_writer};
+  ASSERT_TRUE(plain_serializer.Write(MakeCatalog()));
+  EXPECT_EQ(plain_writer.buffer(), pre_encoded.buffer());
+
+  // Pre-encoded values are written verbatim and read back as the original.
+  VectorWriter writer;
+  Serializer<VectorWriter*> serializer{&writer};
+  const std::vector<PreEncoded> values = {pre_encoded, PreEncoded{}};
+  ASSERT_TRUE(serializer.Write(values));
+  EXPECT_EQ(writer.size(), serializer.GetSize(values));
+
+  BufferReader reader{writer.data(), writer.size()};
+  Deserializer<BufferReader*> deserializer{&reader};
+  std::vector<Catalog> decoded;
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            deserializer.Read(&decoded).error());
+
+  reader = BufferReader{writer.data(), writer.size()};
+  std::uint8_t prefix;
+  std::uint64_t count;
+  ASSERT_TRUE(reader.Read(&prefix));
+  ASSERT_TRUE(deserializer.Read(&count));
+  EXPECT_EQ(2u, count);
+  Catalog catalog;
+  ASSERT_TRUE(deserializer.Read(&catalog));
+  EXPECT_EQ(MakeCatalog(), catalog);
+  nop::Optional<std::uint32_t> nil;
+  ASSERT_TRUE(deserializer.Read(&nil));
+  EXPECT_FALSE(nil);
+}
+
+TEST(PreEncoded, Read) {
+  VectorWriter writer;
+  Serializer<VectorWriter*> serializer{&writer};
+  ASSERT_TRUE(serializer.Write(std::string{"first"}));
+  ASSERT_TRUE(serializer.Write(MakeCatalog()));
+  ASSERT_TRUE(serializer.Write(std::int8_t{-3}));
+
+  // Each value is captured in full without decoding it.
+  BufferReader reader{writer.data(), writer.size()};
+  Deserializer<BufferReader*> deserializer{&reader};
+  std::vector<PreEncoded> values(3);
+  for (PreEncoded& value : values)
+    ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_TRUE(reader.empty());
+  EXPECT_EQ(Compose(EncodingByte::String, 5, "first"), values[0].buffer());
+  EXPECT_EQ(PreEncode(MakeCatalog()).get(), values[1]);
+  EXPECT_EQ(Compose(-3), values[2].buffer());
+
+  // Forwarding the values reproduces the input.
+  VectorWriter forward_writer;
+  Serializer<VectorWriter*> forward_serializer{&forward_writer};
+  for (const PreEncoded& value : values)
+    ASSERT_TRUE(forward_serializer.Write(value));
+  EXPECT_EQ(Data(writer), Data(forward_writer));
+
+  // Truncated and invalid values are rejected.
+  reader = BufferReader{writer.data(), 4};
+  PreEncoded value;
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, deserializer.Read(&value).error());
+
+  const auto reserved = Compose(EncodingByte::ReservedMin);
+  reader = BufferReader{reserved.data(), reserved.size()};
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            deserializer.Read(&value).error());
+}
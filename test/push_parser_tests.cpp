@@ -0,0 +1,256 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/types/variant.h>
+#include <nop/utility/pedantic_buffer_reader.h>
+#include <nop/utility/push_parser.h>
+#include <nop/utility/stream_reader.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::Encoding;
+using nop::Entry;
+using nop::ErrorStatus;
+using nop::ParseAction;
+using nop::PedanticBufferReader;
+using nop::PushHandler;
+using nop::PushParse;
+using nop::Serializer;
+using nop::Status;
+using nop::StreamReader;
+using nop::Variant;
+using nop::VectorWriter;
+
+namespace {
+
+struct Point {
+  std::int32_t x;
+  std::int32_t y;
+  NOP_STRUCTURE(Point, x, y);
+};
+
+struct Message {
+  std::string name;
+  std::vector<Point> points;
+  std::map<std::uint32_t, std::string> labels;
+  Variant<int, std::string> tag;
+  float scale;
+  NOP_STRUCTURE(Message, name, points, labels, tag, scale);
+};
+
+struct Record {
+  Entry<std::string, 0> name;
+  Entry<Point, 3> origin;
+  NOP_TABLE_NS("test.Record", Record, name, origin);
+};
+
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  return serializer.writer().take();
+}
+
+// Records every event as text.
+struct RecordingHandler : PushHandler {
+  Status<void> Nil() { return Put("nil"); }
+  Status<void> Unsigned(std::uint64_t value) {
+    return Put("u" + std::to_string(value));
+  }
+  Status<void> Signed(std::int64_t value) {
+    return Put("i" + std::to_string(value));
+  }
+  Status<void> Float(double value) {
+    return Put("f" + std::to_string(value));
+  }
+
+  Status<void> BeginString(std::size_t size) {
+    return Put("str" + std::to_string(size));
+  }
+  Status<void> StringChunk(const std::uint8_t* data, std::size_t size) {
+    chunks++;
+    return Put("\"" + std::string(data, data + size) + "\"");
+  }
+  Status<void> EndString() { return Put("/str"); }
+
+  Status<void> BeginArray(std::size_t count) {
+    return Put("[" + std::to_string(count));
+  }
+  Status<void> EndArray() { return Put("]"); }
+  Status<void> BeginStructure(std::size_t count) {
+    return Put("{" + std::to_string(count));
+  }
+  Status<void> EndStructure() { return Put("}"); }
+  Status<void> BeginMap(std::size_t count) {
+    return Put("map" + std::to_string(count));
+  }
+  Status<void> EndMap() { return Put("/map"); }
+  Status<void> BeginTable(std::uint64_t /*hash*/, std::size_t count) {
+    return Put("tab" + std::to_string(count));
+  }
+  template <typename Reader>
+  Status<ParseAction> Entry(std::uint64_t id, std::size_t /*size*/,
+                            Reader* /*reader*/) {
+    Put("#" + std::to_string(id));
+    return ParseAction::Parse;
+  }
+  Status<void> EndTable() { return Put("/tab"); }
+  Status<void> BeginVariant(std::int32_t index) {
+    return Put("var" + std::to_string(index));
+  }
+  Status<void> EndVariant() { return Put("/var"); }
+
+  Status<void> Put(const std::string& event) {
+    if (!events.empty())
+      events += ' ';
+    events += event;
+    return {};
+  }
+
+  std::string events;
+  std::size_t chunks = 0;
+};
+
+// Reads the points of a message as typed values and skips everything else.
+struct PointHandler : PushHandler {
+  template <typename Reader>
+  Status<ParseAction> Element(std::size_t index, Reader* reader) {
+    // Descend into the points member only.
+    if (!in_points)
+      return index == 1 ? ParseAction::Parse : ParseAction::Skip;
+
+    Point point;
+    auto status = Encoding<Point>::Read(&point, reader);
+    if (!status)
+      return status.error();
+
+    points.push_back(point);
+    return ParseAction::Consumed;
+  }
+
+  Status<void> BeginArray(std::size_t /*count*/) {
+    in_points = true;
+    return {};
+  }
+  Status<void> EndArray() {
+    in_points = false;
+    return {};
+  }
+
+  bool in_points = false;
+  std::vector<Point> points;
+};
+
+}  // anonymous namespace
+
+TEST(PushParser, Events) {
+  const Message message{"abc",
+                        {{1, -2}},
+                        {{7, "seven"}},
+                        Variant<int, std::string>{std::string{"x"}},
+                        0.5f};
+  const auto data = Encode(message);
+  PedanticBufferReader reader{data.data(), data.size()};
+  RecordingHandler handler;
+  ASSERT_TRUE(PushParse(&reader, &handler));
+  EXPECT_TRUE(reader.empty());
+  EXPECT_EQ(
+      "{5 str3 \"abc\" /str [1 {2 u1 i-2 } ] map1 u7 str5 \"seven\" /str "
+      "/map var1 str1 \"x\" /str /var f0.500000 }",
+      handler.events);
+
+  Record record;
+  record.name = "r";
+  record.origin = Point{3, 4};
+  const auto table_data = Encode(record);
+  PedanticBufferReader table_reader{table_data.data(), table_data.size()};
+  RecordingHandler table_handler;
+  ASSERT_TRUE(PushParse(&table_reader, &table_handler));
+  EXPECT_EQ("tab2 #0 str1 \"r\" /str #3 {2 u3 u4 } /tab",
+            table_handler.events);
+}
+
+TEST(PushParser, TypedSubValues) {
+  const Message message{"abc",
+                        {{1, 2}, {3, 4}, {5, 6}},
+                        {{7, "seven"}},
+                        Variant<int, std::string>{1},
+                        1.0f};
+  const auto data = Encode(message);
+  PedanticBufferReader reader{data.data(), data.size()};
+  PointHandler handler;
+  ASSERT_TRUE(PushParse(&reader, &handler));
+  EXPECT_TRUE(reader.empty());
+  ASSERT_EQ(3u, handler.points.size());
+  EXPECT_EQ(5, handler.points[2].x);
+  EXPECT_EQ(6, handler.points[2].y);
+}
+
+TEST(PushParser, Chunks) {
+  const std::string value(10000, 'x');
+  const auto data = Encode(value);
+
+  // Contiguous readers pass the payload in place.
+  PedanticBufferReader buffer_reader{data.data(), data.size()};
+  RecordingHandler buffer_handler;
+  ASSERT_TRUE(PushParse(&buffer_reader, &buffer_handler));
+  EXPECT_EQ(1u, buffer_handler.chunks);
+  EXPECT_EQ("str10000 \"" + value + "\" /str", buffer_handler.events);
+
+  // Other readers pass it in bounded chunks.
+  StreamReader<std::stringstream> stream_reader{
+      std::string(data.begin(), data.end())};
+  RecordingHandler stream_handler;
+  ASSERT_TRUE(PushParse(&stream_reader, &stream_handler));
+  EXPECT_EQ(3u, stream_handler.chunks);
+  EXPECT_EQ("str10000 \"" + value.substr(0, 4096) + "\" \"" +
+                value.substr(4096, 4096) + "\" \"" + value.substr(8192) +
+                "\" /str",
+            stream_handler.events);
+}
+
+TEST(PushParser, Errors) {
+  // Nesting beyond the maximum depth is rejected.
+  std::vector<std::vector<std::vector<int>>> nested{{{1}}};
+  const auto data = Encode(nested);
+  PedanticBufferReader reader{data.data(), data.size()};
+  RecordingHandler handler;
+  EXPECT_EQ(ErrorStatus::ProtocolError,
+            PushParse(&reader, &handler, 1).error());
+
+  // Truncated input fails.
+  PedanticBufferReader truncated{data.data(), data.size() - 1};
+  EXPECT_EQ(ErrorStatus::ReadLimitReached,
+            PushParse(&truncated, &handler).error());
+
+  // Handlers stop parsing by returning an error.
+  struct StoppingHandler : PushHandler {
+    Status<void> BeginArray(std::size_t /*count*/) {
+      return ErrorStatus::DebugError;
+    }
+  } stopping;
+  PedanticBufferReader stopped{data.data(), data.size()};
+  EXPECT_EQ(ErrorStatus::DebugError, PushParse(&stopped, &stopping).error());
+}
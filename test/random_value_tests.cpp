@@ -0,0 +1,201 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/types/optional.h>
+#include <nop/types/variant.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/random_value.h>
+#include <nop/utility/vector_writer.h>
+#include <nop/value.h>
+
+using nop::BufferReader;
+using nop::Deserializer;
+using nop::Entry;
+using nop::GenerateCorpus;
+using nop::Optional;
+using nop::RandomValueGenerator;
+using nop::RandomValueOptions;
+using nop::Serializer;
+using nop::Variant;
+using nop::VectorWriter;
+
+namespace {
+
+enum class Kind : std::uint8_t { Circle, Square, Triangle };
+
+struct Point {
+  std::int32_t x;
+  std::int32_t y;
+  NOP_STRUCTURE(Point, x, y);
+};
+
+struct Weight {
+  float value;
+  NOP_VALUE(Weight, value);
+};
+
+struct Shape {
+  Kind kind;
+  std::string name;
+  std::vector<Point> points;
+  std::map<std::string, std::int64_t> attributes;
+  Optional<Weight> weight;
+  Variant<std::uint32_t, std::string> tag;
+  std::array<std::uint16_t, 3> color;
+  std::uint8_t flags[4];
+  std::size_t flag_count;
+  NOP_STRUCTURE(Shape, kind, name, points, attributes, weight, tag, color,
+                (flags, flag_count));
+};
+
+struct Scene {
+  Entry<std::string, 0> title;
+  Entry<std::vector<Shape>, 1> shapes;
+  Entry<std::list<std::set<std::uint64_t>>, 2> layers;
+  Entry<bool, 3, nop::DeletedEntry> legacy;
+  NOP_TABLE_NS("Scene", Scene, title, shapes, layers, legacy);
+};
+
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  return serializer.writer().take();
+}
+
+}  // anonymous namespace
+
+TEST(RandomValueTests, Deterministic) {
+  RandomValueGenerator a{42};
+  RandomValueGenerator b{42};
+  RandomValueGenerator c{43};
+
+  const auto first = Encode(a.Generate<Scene>());
+  EXPECT_EQ(first, Encode(b.Generate<Scene>()));
+  EXPECT_NE(first, Encode(c.Generate<Scene>()));
+}
+
+TEST(RandomValueTests, RoundTrip) {
+  RandomValueGenerator generator{1};
+  const std::vector<Scene> corpus = GenerateCorpus<Scene>(50, &generator);
+  ASSERT_EQ(50u, corpus.size());
+
+  for (const Scene& scene : corpus) {
+    const auto encoded = Encode(scene);
+    Deserializer<BufferReader> deserializer{encoded.data(), encoded.size()};
+    Scene decoded;
+    ASSERT_TRUE(deserializer.Read(&decoded));
+    EXPECT_EQ(encoded, Encode(decoded));
+    EXPECT_FALSE(scene.legacy);
+  }
+}
+
+TEST(RandomValueTests, Sizes) {
+  RandomValueOptions options;
+  options.string_length = {3, 5, 0.0};
+  options.container_size = {2, 2, 0.0};
+  options.integer_bits = {4, 4, 0.0};
+  options.enum_values = 3;
+  RandomValueGenerator generator{7, options};
+
+  for (int i = 0; i < 100; i++) {
+    const Shape shape = generator.Generate<Shape>();
+    EXPECT_LE(3u, shape.name.size());
+    EXPECT_GE(5u, shape.name.size());
+    EXPECT_EQ(2u, shape.points.size());
+    EXPECT_GE(2u, shape.attributes.size());
+    EXPECT_EQ(2u, shape.flag_count);
+    EXPECT_GE(Kind::Triangle, shape.kind);
+    for (const Point& point : shape.points) {
+      EXPECT_GT(16, point.x);
+      EXPECT_LT(-16, point.x);
+    }
+    for (const std::uint16_t component : shape.color)
+      EXPECT_GT(16u, component);
+  }
+
+  // Geometric sizes favor small values but stay within the bounds.
+  options.string_length = {0, 64, 2.0};
+  generator = RandomValueGenerator{7, options};
+  std::size_t total = 0;
+  for (int i = 0; i < 1000; i++) {
+    const std::string name = generator.Generate<std::string>();
+    EXPECT_GE(64u, name.size());
+    total += name.size();
+  }
+  EXPECT_GT(4000u, total);
+}
+
+TEST(RandomValueTests, Occupancy) {
+  RandomValueOptions options;
+  options.entry_occupancy = 0.0;
+  RandomValueGenerator generator{3, options};
+  Scene scene = generator.Generate<Scene>();
+  EXPECT_FALSE(scene.title);
+  EXPECT_FALSE(scene.shapes);
+  EXPECT_FALSE(scene.layers);
+
+  options.entry_occupancy = 1.0;
+  options.optional_occupancy = 1.0;
+  options.container_size = {1, 4, 0.0};
+  generator = RandomValueGenerator{3, options};
+  scene = generator.Generate<Scene>();
+  EXPECT_TRUE(scene.title);
+  ASSERT_TRUE(scene.shapes);
+  ASSERT_FALSE(scene.shapes.get().empty());
+  EXPECT_TRUE(scene.shapes.get().front().weight);
+  EXPECT_TRUE(scene.layers);
+}
+
+TEST(RandomValueTests, VariantMix) {
+  RandomValueOptions options;
+  options.variant_weights = {0.0, 1.0};
+  RandomValueGenerator generator{5, options};
+  for (int i = 0; i < 20; i++)
+    EXPECT_TRUE((generator.Generate<Variant<int, std::string>>().is<
+                 std::string>()));
+
+  options.empty_variant = 1.0;
+  generator = RandomValueGenerator{5, options};
+  EXPECT_TRUE((generator.Generate<Variant<int, std::string>>().empty()));
+}
+
+TEST(RandomValueTests, MaxDepth) {
+  RandomValueOptions options;
+  options.container_size = {2, 2, 0.0};
+  options.max_depth = 2;
+  RandomValueGenerator generator{9, options};
+
+  using Nested = std::vector<std::vector<std::vector<int>>>;
+  const Nested nested = generator.Generate<Nested>();
+  ASSERT_EQ(2u, nested.size());
+  for (const auto& inner : nested) {
+    ASSERT_EQ(2u, inner.size());
+    for (const auto& innermost : inner)
+      EXPECT_TRUE(innermost.empty());
+  }
+}
@@ -0,0 +1,186 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/utility/crc32c.h>
+#include <nop/utility/record_log.h>
+
+using nop::Crc32c;
+using nop::ErrorStatus;
+using nop::RecordLogReader;
+using nop::RecordLogWriter;
+using nop::Status;
+
+namespace {
+
+struct Event {
+  std::uint64_t sequence;
+  std::string name;
+  NOP_STRUCTURE(Event, sequence, name);
+};
+
+Event MakeEvent(std::uint64_t sequence) {
+  return {sequence, std::string(sequence % 50, 'a' + sequence % 26)};
+}
+
+// Temporary file removed when the test ends.
+class TemporaryFile {
+ public:
+  TemporaryFile() {
+    const int fd = mkstemp(path_);
+    if (fd >= 0)
+      close(fd);
+  }
+  ~TemporaryFile() { unlink(path_); }
+
+  int Open(int flags = O_RDWR) const { return open(path_, flags); }
+
+ private:
+  char path_[32] = "/tmp/nop_record_log_XXXXXX";
+};
+
+}  // anonymous namespace
+
+TEST(Crc32c, Checksum) {
+  const std::string digits = "123456789";
+  EXPECT_EQ(0xe3069283u, Crc32c(digits.data(), digits.size()));
+  EXPECT_EQ(0u, Crc32c(nullptr, 0));
+
+  const std::vector<std::uint8_t> zeros(32, 0);
+  EXPECT_EQ(0x8a9136aau, Crc32c(zeros.data(), zeros.size()));
+
+  // Checksums continue across parts, and the table method agrees with the
+  // hardware instruction at every length and alignment.
+  std::vector<std::uint8_t> data(300);
+  for (std::size_t i = 0; i < data.size(); i++)
+    data[i] = static_cast<std::uint8_t>(i * 37 + 11);
+  const std::uint32_t expected = Crc32c(data.data(), data.size());
+  for (std::size_t split = 0; split <= data.size(); split += 7) {
+    EXPECT_EQ(expected, Crc32c(data.data() + split, data.size() - split,
+                               Crc32c(data.data(), split)));
+    EXPECT_EQ(Crc32c(data.data() + split, data.size() - split),
+              ~nop::detail::Crc32cSoftware(data.data() + split,
+                                           data.size() - split, ~0u));
+  }
+}
+
+TEST(RecordLog, RoundTrip) {
+  TemporaryFile file;
+  {
+    RecordLogWriter writer;
+    ASSERT_TRUE(writer.Open(file.Open(), 256));
+    for (std::uint64_t i = 0; i < 1000; i++)
+      ASSERT_TRUE(writer.Write(MakeEvent(i)));
+    EXPECT_EQ(1000u, writer.record_count());
+    ASSERT_TRUE(writer.Close());
+  }
+
+  RecordLogReader reader;
+  ASSERT_TRUE(reader.Open(file.Open(O_RDONLY)));
+  EXPECT_FALSE(reader.recovered());
+  EXPECT_EQ(1000u, reader.record_count());
+  EXPECT_LT(1u, reader.block_count());
+
+  Event event;
+  for (std::uint64_t i = 0; i < 1000; i++) {
+    ASSERT_TRUE(reader.Read(&event));
+    EXPECT_EQ(MakeEvent(i).sequence, event.sequence);
+    EXPECT_EQ(MakeEvent(i).name, event.name);
+  }
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, reader.Read(&event).error());
+
+  // Seek to records at the start, middle, and end of blocks.
+  for (std::uint64_t record : {0u, 1u, 537u, 999u, 500u}) {
+    ASSERT_TRUE(reader.Seek(record));
+    EXPECT_EQ(record, reader.position());
+    ASSERT_TRUE(reader.Read(&event));
+    EXPECT_EQ(record, event.sequence);
+  }
+
+  ASSERT_TRUE(reader.Seek(1000));
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, reader.Read(&event).error());
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, reader.Seek(1001).error());
+}
+
+TEST(RecordLog, Recovery) {
+  TemporaryFile file;
+  RecordLogWriter writer;
+  ASSERT_TRUE(writer.Open(file.Open(), 128));
+  for (std::uint64_t i = 0; i < 100; i++)
+    ASSERT_TRUE(writer.Write(MakeEvent(i)));
+
+  // Stop without writing the index, leaving a torn block at the end.
+  const int fd = writer.Release();
+  const std::uint8_t torn[] = {0x4e, 0x42, 0x4c, 0x4b, 1, 2, 3};
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(torn)), write(fd, torn, sizeof(torn)));
+
+  RecordLogReader reader;
+  ASSERT_TRUE(reader.Open(file.Open(O_RDONLY)));
+  EXPECT_TRUE(reader.recovered());
+  EXPECT_EQ(100u, reader.record_count());
+  ASSERT_TRUE(reader.Seek(99));
+  Event event;
+  ASSERT_TRUE(reader.Read(&event));
+  EXPECT_EQ(99u, event.sequence);
+
+  // Writing continues after the last valid block.
+  ASSERT_TRUE(writer.Open(fd, 128));
+  EXPECT_EQ(100u, writer.record_count());
+  for (std::uint64_t i = 100; i < 200; i++)
+    ASSERT_TRUE(writer.Write(MakeEvent(i)));
+  ASSERT_TRUE(writer.Close());
+
+  ASSERT_TRUE(reader.Open(file.Open(O_RDONLY)));
+  EXPECT_FALSE(reader.recovered());
+  EXPECT_EQ(200u, reader.record_count());
+  for (std::uint64_t i = 0; i < 200; i++) {
+    ASSERT_TRUE(reader.Read(&event));
+    EXPECT_EQ(i, event.sequence);
+  }
+}
+
+TEST(RecordLog, Checksum) {
+  TemporaryFile file;
+  {
+    RecordLogWriter writer;
+    ASSERT_TRUE(writer.Open(file.Open(), 128));
+    for (std::uint64_t i = 0; i < 100; i++)
+      ASSERT_TRUE(writer.Write(MakeEvent(i)));
+  }
+
+  // Corrupt a byte in the payload of the first block.
+  const int fd = file.Open();
+  const std::uint8_t byte = 0xff;
+  ASSERT_EQ(1, pwrite(fd, &byte, 1, 40));
+  close(fd);
+
+  RecordLogReader reader;
+  ASSERT_TRUE(reader.Open(file.Open(O_RDONLY)));
+  Event event;
+  EXPECT_EQ(ErrorStatus::ProtocolError, reader.Read(&event).error());
+
+  // Other blocks remain readable.
+  ASSERT_TRUE(reader.Seek(99));
+  ASSERT_TRUE(reader.Read(&event));
+  EXPECT_EQ(99u, event.sequence);
+}
@@ -0,0 +1,274 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/traits/schema_fingerprint.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/pedantic_buffer_reader.h>
+#include <nop/utility/schema_handshake.h>
+#include <nop/utility/trusted_reader.h>
+#include <nop/utility/vector_writer.h>
+#include <nop/value.h>
+
+using nop::BufferReader;
+using nop::CombinedSchemaFingerprint;
+using nop::DeletedEntry;
+using nop::Deserializer;
+using nop::Entry;
+using nop::ErrorStatus;
+using nop::NegotiatedDeserializer;
+using nop::NegotiatedSerializer;
+using nop::PedanticBufferReader;
+using nop::SchemaFingerprint;
+using nop::SchemaHandshake;
+using nop::SchemaMode;
+using nop::Serializer;
+using nop::TrustedReader;
+using nop::VectorWriter;
+
+namespace {
+
+struct Point {
+  std::int32_t x;
+  std::int32_t y;
+  NOP_STRUCTURE(Point, x, y);
+};
+
+// Same shape as Point under different names.
+struct Coordinate {
+  std::int32_t row;
+  std::int32_t column;
+  NOP_STRUCTURE(Coordinate, row, column);
+};
+
+struct WidePoint {
+  std::int64_t x;
+  std::int64_t y;
+  NOP_STRUCTURE(WidePoint, x, y);
+};
+
+struct Message {
+  std::string name;
+  std::vector<Point> points;
+  NOP_STRUCTURE(Message, name, points);
+};
+
+struct MessageV2 {
+  std::string name;
+  std::vector<Point> points;
+  std::uint32_t flags;
+  NOP_STRUCTURE(MessageV2, name, points, flags);
+};
+
+struct Record {
+  Entry<std::string, 0> name;
+  Entry<Point, 1> origin;
+  NOP_TABLE_NS("test.Record", Record, name, origin);
+};
+
+struct RecordRenumbered {
+  Entry<std::string, 0> name;
+  Entry<Point, 2> origin;
+  NOP_TABLE_NS("test.Record", RecordRenumbered, name, origin);
+};
+
+struct RecordDeleted {
+  Entry<std::string, 0> name;
+  Entry<Point, 1, DeletedEntry> origin;
+  NOP_TABLE_NS("test.Record", RecordDeleted, name, origin);
+};
+
+enum class Color : std::uint8_t { Red, Green };
+
+class Id {
+ public:
+  Id() = default;
+  Id(std::uint32_t value) : value_{value} {}
+
+ private:
+  std::uint32_t value_{0};
+  NOP_VALUE(Id, value_);
+};
+
+template <typename T>
+constexpr std::uint64_t Fingerprint() {
+  return SchemaFingerprint<T>::Value;
+}
+
+}  // anonymous namespace
+
+TEST(SchemaFingerprint, Structural) {
+  static_assert(Fingerprint<Point>() == Fingerprint<Coordinate>(),
+                "Names must not contribute to the fingerprint.");
+  static_assert(Fingerprint<Point>() != Fingerprint<WidePoint>(),
+                "Member types must contribute to the fingerprint.");
+
+  EXPECT_EQ(Fingerprint<std::vector<Point>>(),
+            Fingerprint<std::vector<Coordinate>>());
+  EXPECT_NE(Fingerprint<std::vector<Point>>(),
+            Fingerprint<std::vector<WidePoint>>());
+  EXPECT_NE(Fingerprint<std::vector<Point>>(), Fingerprint<Point>());
+  EXPECT_EQ((Fingerprint<std::array<Point, 3>>()),
+            (Fingerprint<std::array<Coordinate, 3>>()));
+  EXPECT_NE((Fingerprint<std::array<Point, 3>>()),
+            (Fingerprint<std::array<Point, 4>>()));
+  EXPECT_EQ(Fingerprint<Point[3]>(), Fingerprint<Coordinate[3]>());
+  EXPECT_NE(Fingerprint<Message>(), Fingerprint<MessageV2>());
+
+  EXPECT_EQ(Fingerprint<std::uint8_t>(), Fingerprint<Color>());
+  EXPECT_EQ(Fingerprint<std::uint32_t>(), Fingerprint<Id>());
+  EXPECT_NE(Fingerprint<std::uint32_t>(), Fingerprint<std::int32_t>());
+  EXPECT_NE(Fingerprint<std::uint32_t>(), Fingerprint<float>());
+  EXPECT_NE(Fingerprint<std::uint8_t>(), Fingerprint<bool>());
+
+  EXPECT_NE(Fingerprint<Record>(), Fingerprint<RecordRenumbered>());
+  EXPECT_NE(Fingerprint<Record>(), Fingerprint<RecordDeleted>());
+
+  EXPECT_EQ((CombinedSchemaFingerprint<Point, Message>::Value),
+            (CombinedSchemaFingerprint<Coordinate, Message>::Value));
+  EXPECT_NE((CombinedSchemaFingerprint<Point, Message>::Value),
+            (CombinedSchemaFingerprint<Message, Point>::Value));
+  EXPECT_NE((CombinedSchemaFingerprint<Point, Message>::Value),
+            (CombinedSchemaFingerprint<Point>::Value));
+}
+
+TEST(SchemaHandshake, Negotiate) {
+  using Local = SchemaHandshake<Message, Record>;
+  using Identical = SchemaHandshake<Message, Record>;
+  using Newer = SchemaHandshake<MessageV2, Record>;
+
+  // Identical schemas agree on the preferred mode.
+  {
+    VectorWriter peer_writer;
+    ASSERT_TRUE(Identical::WriteFingerprint(&peer_writer));
+    const auto data = peer_writer.take();
+
+    VectorWriter writer;
+    BufferReader reader{data.data(), data.size()};
+    auto mode = Local::Negotiate(&writer, &reader);
+    ASSERT_TRUE(mode);
+    EXPECT_EQ(SchemaMode::Trusted, mode.get());
+    EXPECT_EQ(data, writer.take());
+
+    BufferReader fixed_width_reader{data.data(), data.size()};
+    mode = Local::ReadFingerprint(&fixed_width_reader,
+                                  SchemaMode::TrustedFixedWidth);
+    ASSERT_TRUE(mode);
+    EXPECT_EQ(SchemaMode::TrustedFixedWidth, mode.get());
+  }
+
+  // Mixed versions fall back to the standard encoding.
+  {
+    VectorWriter peer_writer;
+    ASSERT_TRUE(Newer::WriteFingerprint(&peer_writer));
+    const auto data = peer_writer.take();
+
+    VectorWriter writer;
+    BufferReader reader{data.data(), data.size()};
+    auto mode = Local::Negotiate(&writer, &reader,
+                                 SchemaMode::TrustedFixedWidth);
+    ASSERT_TRUE(mode);
+    EXPECT_EQ(SchemaMode::Standard, mode.get());
+  }
+
+  // A missing fingerprint is an error.
+  {
+    VectorWriter writer;
+    PedanticBufferReader reader;
+    auto mode = Local::Negotiate(&writer, &reader);
+    ASSERT_FALSE(mode);
+    EXPECT_EQ(ErrorStatus::ReadLimitReached, mode.error());
+  }
+}
+
+TEST(SchemaHandshake, NegotiatedModes) {
+  const Message message{"abc", {{1, -2}, {300, 40000}}};
+  Record record;
+  record.name = "r";
+  record.origin = Point{3, 4};
+
+  for (auto mode : {SchemaMode::Standard, SchemaMode::Trusted,
+                    SchemaMode::TrustedFixedWidth}) {
+    VectorWriter writer;
+    NegotiatedSerializer<VectorWriter> serializer{&writer, mode};
+    EXPECT_EQ(mode, serializer.mode());
+    ASSERT_TRUE(serializer.Write(message, record));
+    const auto data = writer.take();
+
+    BufferReader reader{data.data(), data.size()};
+    NegotiatedDeserializer<BufferReader> deserializer{&reader, mode};
+    Message message_out;
+    Record record_out;
+    ASSERT_TRUE(deserializer.Read(&message_out, &record_out));
+    EXPECT_TRUE(reader.empty());
+    EXPECT_EQ("abc", message_out.name);
+    ASSERT_EQ(2u, message_out.points.size());
+    EXPECT_EQ(40000, message_out.points[1].y);
+    ASSERT_TRUE(record_out.origin);
+    EXPECT_EQ(3, record_out.origin.get().x);
+  }
+
+  // Fixed-width output is larger, but decodes with the standard encoding.
+  VectorWriter standard_writer;
+  ASSERT_TRUE(NegotiatedSerializer<VectorWriter>(&standard_writer,
+                                                 SchemaMode::Standard)
+                  .Write(message));
+  VectorWriter fixed_width_writer;
+  ASSERT_TRUE(NegotiatedSerializer<VectorWriter>(
+                  &fixed_width_writer, SchemaMode::TrustedFixedWidth)
+                  .Write(message));
+  const auto standard_data = standard_writer.take();
+  const auto fixed_width_data = fixed_width_writer.take();
+  EXPECT_LT(standard_data.size(), fixed_width_data.size());
+
+  BufferReader reader{fixed_width_data.data(), fixed_width_data.size()};
+  Message message_out;
+  ASSERT_TRUE(Deserializer<BufferReader*>{&reader}.Read(&message_out));
+  EXPECT_EQ(300, message_out.points[1].x);
+}
+
+TEST(TrustedReader, ElidesShapeChecks) {
+  VectorWriter writer;
+  ASSERT_TRUE(Serializer<VectorWriter*>{&writer}.Write(
+      MessageV2{"abc", {{1, 2}}, 7}));
+  const auto data = writer.take();
+
+  // The standard encoding rejects the extra member.
+  BufferReader reader{data.data(), data.size()};
+  Message message;
+  EXPECT_EQ(ErrorStatus::InvalidMemberCount,
+            Deserializer<BufferReader*>{&reader}.Read(&message).error());
+
+  // A trusted reader does not check the member count, so it reads the members
+  // it expects and leaves the rest of the input.
+  BufferReader buffer_reader{data.data(), data.size()};
+  TrustedReader<BufferReader> trusted_reader{&buffer_reader};
+  ASSERT_TRUE(
+      Deserializer<TrustedReader<BufferReader>*>{&trusted_reader}.Read(
+          &message));
+  EXPECT_EQ("abc", message.name);
+  ASSERT_EQ(1u, message.points.size());
+  EXPECT_EQ(2, message.points[0].y);
+  EXPECT_FALSE(trusted_reader.empty());
+}
@@ -16,18 +16,27 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <bitset>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <functional>
+#include <iterator>
 #include <limits>
+#include <list>
+#include <map>
 #include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <nop/base/utility.h>
 #include <nop/serializer.h>
 #include <nop/structure.h>
 #include <nop/table.h>
+#include <nop/types/enum_flags.h>
 #include <nop/value.h>
 
 #include "mock_reader.h"
@@ -45,9 +54,12 @@ using nop::EnableIfIntegral;
 using nop::Encoding;
 using nop::EncodingByte;
 using nop::Entry;
+using nop::EntryIdIndex;
 using nop::ErrorStatus;
 using nop::Float;
+using nop::FixedEncodingSize;
 using nop::Handle;
+using nop::IsPackable;
 using nop::Integer;
 using nop::Serializer;
 using nop::Status;
@@ -191,6 +203,12 @@ struct TestJ {
 NOP_EXTERNAL_STRUCTURE(TestJ, (data, size));
 NOP_EXTERNAL_UNBOUNDED_BUFFER(TestJ);
 
+struct TestK {
+  float data[4];
+  std::size_t size;
+};
+NOP_EXTERNAL_STRUCTURE(TestK, (data, size));
+
 template <typename T>
 std::unique_ptr<TestJ<T>, decltype(&std::free)> MakeTestJ(
     std::size_t capacity) {
@@ -242,6 +260,31 @@ struct TableA2 {
   NOP_TABLE_HASH(15, TableA2, name, attributes, address);
 };
 
+struct RawPoint {
+  float x;
+  float y;
+  float z;
+
+  bool operator==(const RawPoint& other) const {
+    return x == other.x && y == other.y && z == other.z;
+  }
+
+  NOP_RAW_STRUCTURE(RawPoint, x, y, z);
+};
+
+struct RawTriangle {
+  RawPoint vertices[3];
+  std::uint32_t color;
+
+  bool operator==(const RawTriangle& other) const {
+    return std::equal(std::begin(vertices), std::end(vertices),
+                      std::begin(other.vertices)) &&
+           color == other.color;
+  }
+
+  NOP_RAW_STRUCTURE(RawTriangle, vertices, color);
+};
+
 template <typename T>
 struct ValueWrapper {
   T value;
@@ -280,8 +323,126 @@ auto MakeCDynamicArray(const T (&data)[Size]) {
   return value;
 }
 
+struct TestL {
+  float x;
+  float y;
+  bool valid;
+  NOP_STRUCTURE(TestL, x, y, valid);
+};
+
+// Writer that opts out of preparing for each value and counts the calls to
+// Prepare() it receives regardless.
+class SkipPrepareWriter : public TestWriter {
+ public:
+  using SkipPrepare = void;
+
+  Status<void> Prepare(std::size_t size) {
+    prepare_count_++;
+    return TestWriter::Prepare(size);
+  }
+
+  std::size_t prepare_count() const { return prepare_count_; }
+
+ private:
+  std::size_t prepare_count_{0};
+};
+
+// Writer that counts the calls to Write() it receives, optionally opting out of
+// staged writes.
+template <bool SkipStaging>
+class WriteCountingWriter : public TestWriter {
+ public:
+  Status<void> Write(std::uint8_t byte) {
+    write_count_++;
+    return TestWriter::Write(byte);
+  }
+
+  Status<void> Write(const void* begin, const void* end) {
+    write_count_++;
+    return TestWriter::Write(begin, end);
+  }
+
+  std::size_t write_count() const { return write_count_; }
+
+ private:
+  std::size_t write_count_{0};
+};
+
+template <>
+class WriteCountingWriter<true> : public WriteCountingWriter<false> {
+ public:
+  using SkipStaging = void;
+};
+
+// Table with ids that are too sparse for a dense lookup table.
+struct TableB {
+  Entry<int, 1000> a;
+  Entry<std::string, 7> b;
+  Entry<int, (1ull << 40), DeletedEntry> c;
+  Entry<int, 3> d;
+  NOP_TABLE_HASH(16, TableB, a, b, c, d);
+};
+
+enum class PackedFlags : std::uint16_t {
+  None = 0,
+  A = 1,
+  B = 0x100,
+};
+NOP_ENUM_FLAGS(PackedFlags);
+
+// Move-only structure without a default constructor, which containers decode
+// through its decode constructor. Counts the moves of its instances.
+class Account {
+ public:
+  Account(std::string owner, std::uint32_t balance)
+      : owner_{std::move(owner)}, balance_{balance} {}
+  explicit Account(nop::DecodeTag) {}
+
+  Account(Account&& other)
+      : owner_{std::move(other.owner_)}, balance_{other.balance_} {
+    moves++;
+  }
+  Account& operator=(Account&&) = default;
+
+  Account(const Account&) = delete;
+  void operator=(const Account&) = delete;
+
+  const std::string& owner() const { return owner_; }
+  std::uint32_t balance() const { return balance_; }
+
+  bool operator<(const Account& other) const { return owner_ < other.owner_; }
+
+  static int moves;
+
+ private:
+  std::string owner_;
+  std::uint32_t balance_{0};
+  NOP_STRUCTURE(Account, owner_, balance_);
+};
+
+int Account::moves = 0;
+
+struct Outlined {
+  std::string name;
+  std::vector<int> values;
+  NOP_STRUCTURE(Outlined, name, values);
+};
+
+struct HasOutlined {
+  int id;
+  std::vector<Outlined> outlined;
+  NOP_STRUCTURE(HasOutlined, id, outlined);
+};
+
 }  // anonymous namespace
 
+namespace nop {
+
+template <>
+struct IsOutlined<Outlined> : std::true_type {};
+
+}  // namespace nop
+
 #if 0
 // This test verifies that the compiler outputs a custom error message when an
 // unsupported type is pass to the serializer.
@@ -376,6 +537,54 @@ TEST(Deserializer, bool) {
   EXPECT_EQ(false, value);
 }
 
+TEST(Serializer, MultipleValues) {
+  const std::string name = "abc";
+  const std::vector<std::uint16_t> values = {1, 1000, 10000};
+
+  // Writing several values at once is the same as writing them separately.
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+  ASSERT_TRUE(serializer.Write(true));
+  ASSERT_TRUE(serializer.Write(name));
+  ASSERT_TRUE(serializer.Write(values));
+  const std::vector<std::uint8_t> expected = writer.data();
+  EXPECT_EQ(expected.size(), serializer.GetSize(true, name, values));
+  writer.clear();
+
+  ASSERT_TRUE(serializer.Write(true, name, values));
+  EXPECT_EQ(expected, writer.data());
+
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+  reader.Set(expected);
+  bool flag = false;
+  std::string read_name;
+  std::vector<std::uint16_t> read_values;
+  ASSERT_TRUE(deserializer.Read(&flag, &read_name, &read_values));
+  EXPECT_TRUE(flag);
+  EXPECT_EQ(name, read_name);
+  EXPECT_EQ(values, read_values);
+
+  // Reading stops at the first error.
+  reader.Set(Compose(EncodingByte::True, EncodingByte::Nil, 1));
+  std::uint8_t last = 0;
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            deserializer.Read(&flag, &read_name, &last).error());
+  EXPECT_EQ(0u, last);
+
+  // The writer is prepared once for all of the values.
+  MockWriter mock_writer;
+  Serializer<MockWriter*> mock_serializer{&mock_writer};
+  EXPECT_CALL(mock_writer, Prepare(Eq(expected.size())))
+      .Times(1)
+      .WillOnce(Return(ErrorStatus::WriteLimitReached));
+  EXPECT_CALL(mock_writer, Write(_)).Times(0);
+  EXPECT_CALL(mock_writer, Write(_, _)).Times(0);
+  EXPECT_CALL(mock_writer, Skip(_, _)).Times(0);
+  EXPECT_EQ(ErrorStatus::WriteLimitReached,
+            mock_serializer.Write(true, name, values).error());
+}
+
 /* Vector */
 TEST(Serializer, IntegerVectorFailOnPrepare) {
   MockWriter writer;
@@ -836,6 +1045,268 @@ TEST(Deserializer, Vector) {
   }
 }
 
+TEST(Serializer, BitVector) {
+  std::vector<std::uint8_t> expected;
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+  Status<void> status;
+
+  {
+    std::vector<bool> value;
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+
+    expected = Compose(EncodingByte::Binary, 1, 0);
+    EXPECT_EQ(expected, writer.data());
+    writer.clear();
+  }
+
+  {
+    std::vector<bool> value = {true, false, true, true, false, false, false,
+                               false, false, true};
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+
+    expected = Compose(EncodingByte::Binary, 3, 6, 0x0d, 0x02);
+    EXPECT_EQ(expected, writer.data());
+    EXPECT_EQ(serializer.GetSize(value), writer.data().size());
+    writer.clear();
+  }
+
+  {
+    std::vector<bool> value(1000);
+    for (std::size_t i = 0; i < value.size(); i += 3)
+      value[i] = true;
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+
+    std::vector<std::uint8_t> bits(125);
+    for (std::size_t i = 0; i < value.size(); i += 3)
+      bits[i / 8] |= 1 << (i % 8);
+    expected = Compose(EncodingByte::Binary, 126, 0, bits);
+    EXPECT_EQ(expected, writer.data());
+    writer.clear();
+  }
+}
+
+TEST(Deserializer, BitVector) {
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+  Status<void> status;
+
+  {
+    reader.Set(Compose(EncodingByte::Binary, 3, 6, 0x0d, 0x02));
+
+    std::vector<bool> value = {false, false, false};
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    std::vector<bool> expected = {true,  false, true,  true,  false,
+                                  false, false, false, false, true};
+    EXPECT_EQ(expected, value);
+  }
+
+  {
+    // Larger than a conversion chunk.
+    std::vector<bool> expected(10000);
+    for (std::size_t i = 0; i < expected.size(); i += 7)
+      expected[i] = true;
+
+    TestWriter writer;
+    Serializer<TestWriter*> serializer{&writer};
+    ASSERT_TRUE(serializer.Write(expected));
+    reader.Set(writer.data());
+
+    std::vector<bool> value;
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(expected, value);
+  }
+
+  {
+    // Padding bits must be zero.
+    reader.Set(Compose(EncodingByte::Binary, 3, 6, 0x0d, 0x06));
+
+    std::vector<bool> value;
+    status = deserializer.Read(&value);
+    EXPECT_EQ(ErrorStatus::InvalidContainerLength, status.error());
+  }
+
+  {
+    reader.Set(Compose(EncodingByte::Binary, 2, 8, 0x00));
+
+    std::vector<bool> value;
+    status = deserializer.Read(&value);
+    EXPECT_EQ(ErrorStatus::InvalidContainerLength, status.error());
+  }
+}
+
+TEST(Serializer, Bitset) {
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+
+  std::bitset<12> value{0x821};
+  ASSERT_TRUE(serializer.Write(value));
+
+  auto expected = Compose(EncodingByte::Binary, 3, 4, 0x21, 0x08);
+  EXPECT_EQ(expected, writer.data());
+  EXPECT_TRUE(FixedEncodingSize<std::bitset<12>>::value);
+  EXPECT_EQ(expected.size(), FixedEncodingSize<std::bitset<12>>::Size);
+
+  // Bitsets and bit vectors share the same format.
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+  reader.Set(writer.data());
+  std::vector<bool> bits;
+  ASSERT_TRUE(deserializer.Read(&bits));
+  ASSERT_EQ(12u, bits.size());
+  EXPECT_TRUE(bits[0] && bits[5] && bits[11] && !bits[1]);
+}
+
+TEST(Deserializer, Bitset) {
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+
+  reader.Set(Compose(EncodingByte::Binary, 3, 4, 0x21, 0x08));
+  std::bitset<12> value;
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ(0x821u, value.to_ulong());
+
+  // The number of bits must match.
+  reader.Set(Compose(EncodingByte::Binary, 3, 5, 0x21, 0x08));
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+            deserializer.Read(&value).error());
+
+  std::bitset<200> large;
+  for (std::size_t i = 0; i < large.size(); i += 5)
+    large.set(i);
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+  ASSERT_TRUE(serializer.Write(large));
+  reader.Set(writer.data());
+  std::bitset<200> decoded;
+  ASSERT_TRUE(deserializer.Read(&decoded));
+  EXPECT_EQ(large, decoded);
+}
+
+TEST(Serializer, EnumFlagsVector) {
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+
+  // Enum flags are packed as their underlying type.
+  EXPECT_TRUE(IsPackable<PackedFlags>::value);
+  std::vector<PackedFlags> value = {PackedFlags::A, PackedFlags::B,
+                                    PackedFlags::A | PackedFlags::B};
+  ASSERT_TRUE(serializer.Write(value));
+
+  auto expected =
+      Compose(EncodingByte::Binary, 3 * sizeof(PackedFlags),
+              Integer<std::uint16_t>(0x001), Integer<std::uint16_t>(0x100),
+              Integer<std::uint16_t>(0x101));
+  EXPECT_EQ(expected, writer.data());
+}
+
+TEST(Deserializer, EnumFlagsVector) {
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+  const std::vector<PackedFlags> expected = {PackedFlags::A, PackedFlags::B};
+
+  reader.Set(Compose(EncodingByte::Binary, 2 * sizeof(PackedFlags),
+                     Integer<std::uint16_t>(0x001),
+                     Integer<std::uint16_t>(0x100)));
+  std::vector<PackedFlags> value;
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ(expected, value);
+
+  // The ARY format of older versions is also accepted.
+  reader.Set(Compose(EncodingByte::Array, 2, 1, EncodingByte::U16,
+                     Integer<std::uint16_t>(0x100)));
+  std::array<PackedFlags, 2> array;
+  ASSERT_TRUE(deserializer.Read(&array));
+  EXPECT_EQ(PackedFlags::B, array[1]);
+
+  reader.Set(Compose(EncodingByte::Array, 2, 1, EncodingByte::U16,
+                     Integer<std::uint16_t>(0x100)));
+  value.clear();
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ(expected, value);
+}
+
+TEST(Serializer, PackedEnumAndValueVector) {
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+
+  // Enums are packed as their underlying type.
+  EXPECT_TRUE(IsPackable<EnumA>::value);
+  std::vector<EnumA> enums = {EnumA::A, EnumA::D, EnumA::C};
+  ASSERT_TRUE(serializer.Write(enums));
+  EXPECT_EQ(Compose(EncodingByte::Binary, 3, 1, 255, 128), writer.data());
+  writer.clear();
+
+  // Value wrappers stored like their arithmetic member are packed too.
+  EXPECT_TRUE(IsPackable<ValueWrapper<std::int32_t>>::value);
+  EXPECT_TRUE(IsPackable<ValueWrapper<EnumA>>::value);
+  EXPECT_FALSE(IsPackable<ValueWrapper<std::string>>::value);
+  EXPECT_FALSE((IsPackable<ArrayWrapper<int, 2>>::value));
+  std::vector<ValueWrapper<std::int32_t>> values = {{-1}, {1000}};
+  ASSERT_TRUE(serializer.Write(values));
+  EXPECT_EQ(Compose(EncodingByte::Binary, 2 * sizeof(std::int32_t),
+                    Integer<std::int32_t>(-1), Integer<std::int32_t>(1000)),
+            writer.data());
+  writer.clear();
+
+  std::array<ValueWrapper<float>, 2> floats = {{{1.0f}, {-2.5f}}};
+  ASSERT_TRUE(serializer.Write(floats));
+  EXPECT_EQ(Compose(EncodingByte::Binary, 2 * sizeof(float), Float(1.0f),
+                    Float(-2.5f)),
+            writer.data());
+}
+
+TEST(Deserializer, PackedEnumAndValueVector) {
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+
+  const std::vector<EnumA> expected_enums = {EnumA::B, EnumA::C};
+  reader.Set(Compose(EncodingByte::Binary, 2, 127, 128));
+  std::vector<EnumA> enums;
+  ASSERT_TRUE(deserializer.Read(&enums));
+  EXPECT_EQ(expected_enums, enums);
+
+  // The ARY format of older versions is also accepted.
+  reader.Set(Compose(EncodingByte::Array, 2, 127, EncodingByte::U8, 128));
+  enums.clear();
+  ASSERT_TRUE(deserializer.Read(&enums));
+  EXPECT_EQ(expected_enums, enums);
+
+  reader.Set(Compose(EncodingByte::Binary, 2 * sizeof(std::int32_t),
+                     Integer<std::int32_t>(-1), Integer<std::int32_t>(1000)));
+  std::vector<ValueWrapper<std::int32_t>> values;
+  ASSERT_TRUE(deserializer.Read(&values));
+  ASSERT_EQ(2u, values.size());
+  EXPECT_EQ(-1, values[0].value);
+  EXPECT_EQ(1000, values[1].value);
+
+  reader.Set(Compose(EncodingByte::Array, 2, EncodingByte::I8, -1,
+                     EncodingByte::I16, Integer<std::int16_t>(1000)));
+  values.clear();
+  ASSERT_TRUE(deserializer.Read(&values));
+  ASSERT_EQ(2u, values.size());
+  EXPECT_EQ(-1, values[0].value);
+  EXPECT_EQ(1000, values[1].value);
+
+  // Packed wrappers read from vectors of the wrapped type.
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+  ASSERT_TRUE(serializer.Write(std::vector<std::int32_t>{5, -5}));
+  reader.Set(writer.data());
+  ASSERT_TRUE(deserializer.Read(&values));
+  ASSERT_EQ(2u, values.size());
+  EXPECT_EQ(-5, values[1].value);
+}
+
 /* List */
 TEST(Serializer, IntegerListFailOnPrepare) {
   MockWriter writer;
@@ -1215,6 +1686,31 @@ TEST(Serializer, List) {
     EXPECT_EQ(expected, writer.data());
     writer.clear();
   }
+
+  // Lists longer than a write batch encode the same as vectors.
+  {
+    std::vector<std::uint16_t> elements(1500);
+    for (std::size_t i = 0; i < elements.size(); i++)
+      elements[i] = static_cast<std::uint16_t>(i * 7);
+
+    status = serializer.Write(elements);
+    ASSERT_TRUE(status);
+    expected = writer.data();
+    writer.clear();
+
+    std::list<std::uint16_t> value{elements.begin(), elements.end()};
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(expected, writer.data());
+
+    TestReader reader;
+    reader.Set(writer.data());
+    Deserializer<TestReader*> deserializer{&reader};
+    std::list<std::uint16_t> read_value;
+    ASSERT_TRUE(deserializer.Read(&read_value));
+    EXPECT_EQ(value, read_value);
+    writer.clear();
+  }
 }
 
 TEST(Deserializer, List) {
@@ -1272,6 +1768,113 @@ TEST(Deserializer, List) {
   }
 }
 
+TEST(Serializer, Deque) {
+  std::vector<std::uint8_t> expected;
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+  Status<void> status;
+
+  {
+    std::deque<int> value = {1, 2, 3, 4};
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+
+    expected = Compose(EncodingByte::Binary, 4 * sizeof(int), Integer<int>(1),
+                       Integer<int>(2), Integer<int>(3), Integer<int>(4));
+    EXPECT_EQ(expected, writer.data());
+    writer.clear();
+  }
+
+  {
+    std::deque<std::string> value = {"abc", "def"};
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+
+    expected = Compose(EncodingByte::Array, 2, EncodingByte::String, 3, "abc",
+                       EncodingByte::String, 3, "def");
+    EXPECT_EQ(expected, writer.data());
+    writer.clear();
+  }
+
+  // Deques spanning many blocks encode the same as vectors, including after
+  // elements are removed from the front.
+  {
+    std::deque<std::uint32_t> value;
+    for (std::uint32_t i = 0; i < 10000; i++)
+      value.push_back(i);
+    value.erase(value.begin(), value.begin() + 77);
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+    const std::vector<std::uint8_t> deque_data = writer.data();
+    writer.clear();
+
+    status = serializer.Write(
+        std::vector<std::uint32_t>{value.begin(), value.end()});
+    ASSERT_TRUE(status);
+    EXPECT_EQ(writer.data(), deque_data);
+    writer.clear();
+  }
+}
+
+TEST(Deserializer, Deque) {
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+  Status<void> status;
+
+  {
+    reader.Set(Compose(EncodingByte::Binary, 4 * sizeof(int), Integer<int>(1),
+                       Integer<int>(2), Integer<int>(3), Integer<int>(4)));
+
+    std::deque<int> value = {9, 9};
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    std::deque<int> expected = {1, 2, 3, 4};
+    EXPECT_EQ(expected, value);
+  }
+
+  {
+    reader.Set(Compose(EncodingByte::Array, 2, EncodingByte::String, 3, "abc",
+                       EncodingByte::String, 3, "def"));
+
+    std::deque<std::string> value;
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    std::deque<std::string> expected = {"abc", "def"};
+    EXPECT_EQ(expected, value);
+  }
+
+  {
+    std::vector<std::uint64_t> elements(5000);
+    for (std::size_t i = 0; i < elements.size(); i++)
+      elements[i] = i * 3;
+
+    TestWriter writer;
+    Serializer<TestWriter*> serializer{&writer};
+    ASSERT_TRUE(serializer.Write(elements));
+    reader.Set(writer.data());
+
+    std::deque<std::uint64_t> value;
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+    EXPECT_TRUE(std::equal(elements.begin(), elements.end(), value.begin(),
+                           value.end()));
+  }
+
+  {
+    reader.Set(Compose(EncodingByte::Binary, 3, 1, 2, 3));
+
+    std::deque<std::uint16_t> value;
+    status = deserializer.Read(&value);
+    ASSERT_FALSE(status);
+    EXPECT_EQ(ErrorStatus::InvalidContainerLength, status.error());
+  }
+}
+
 /* Set */
 TEST(Serializer, IntegerSetFailOnPrepare) {
   MockWriter writer;
@@ -1706,6 +2309,42 @@ TEST(Deserializer, Set) {
     std::set<std::string> expected = {"abc", "def", "123", "456"};
     EXPECT_EQ(expected, value);
   }
+
+  // Decoding into a set keeps the nodes of elements that appear again, erases
+  // the others, and handles elements that are not in order.
+  {
+    std::set<int> value = {1, 2, 3, 5};
+    const int* node = &*value.find(2);
+
+    reader.Set(Compose(EncodingByte::Binary, 4 * sizeof(int), Integer<int>(0),
+                       Integer<int>(2), Integer<int>(4), Integer<int>(6)));
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    std::set<int> expected = {0, 2, 4, 6};
+    EXPECT_EQ(expected, value);
+    EXPECT_EQ(node, &*value.find(2));
+
+    reader.Set(Compose(EncodingByte::Binary, 4 * sizeof(int), Integer<int>(6),
+                       Integer<int>(1), Integer<int>(6), Integer<int>(0)));
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    expected = {0, 1, 6};
+    EXPECT_EQ(expected, value);
+  }
+
+  {
+    std::set<std::string> value = {"abc", "zzz"};
+
+    reader.Set(Compose(EncodingByte::Array, 2, EncodingByte::String, 3, "abc",
+                       EncodingByte::String, 3, "def"));
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    std::set<std::string> expected = {"abc", "def"};
+    EXPECT_EQ(expected, value);
+  }
 }
 
 /* UnorderedSet */
@@ -3049,6 +3688,235 @@ TEST(Deserializer, Array) {
   }
 }
 
+TEST(Serializer, FloatArray) {
+  std::vector<std::uint8_t> expected;
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+  Status<void> status;
+
+  {
+    std::vector<float> value = {1.0f, -2.5f, 3.25f, 0.0f};
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+
+    expected = Compose(EncodingByte::Binary, 4 * sizeof(float), Float(1.0f),
+                       Float(-2.5f), Float(3.25f), Float(0.0f));
+    EXPECT_EQ(expected, writer.data());
+    writer.clear();
+  }
+
+  {
+    std::list<double> value = {1.0, -2.5};
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+
+    expected = Compose(EncodingByte::Binary, 2 * sizeof(double), Float(1.0),
+                       Float(-2.5));
+    EXPECT_EQ(expected, writer.data());
+    writer.clear();
+  }
+
+  {
+    std::array<double, 3> value = {{1.0, -2.5, 3.25}};
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+
+    expected = Compose(EncodingByte::Binary, 3 * sizeof(double), Float(1.0),
+                       Float(-2.5), Float(3.25));
+    EXPECT_EQ(expected, writer.data());
+    writer.clear();
+  }
+
+  {
+    float value[] = {1.0f, -2.5f};
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+
+    expected = Compose(EncodingByte::Binary, 2 * sizeof(float), Float(1.0f),
+                       Float(-2.5f));
+    EXPECT_EQ(expected, writer.data());
+    writer.clear();
+  }
+
+  {
+    TestK value{{1.0f, -2.5f, 3.25f, 0.0f}, 2};
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+
+    expected = Compose(EncodingByte::Structure, 1, EncodingByte::Binary,
+                       2 * sizeof(float), Float(1.0f), Float(-2.5f));
+    EXPECT_EQ(expected, writer.data());
+    writer.clear();
+  }
+}
+
+TEST(Deserializer, FloatArray) {
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+  Status<void> status;
+
+  {
+    reader.Set(Compose(EncodingByte::Binary, 4 * sizeof(float), Float(1.0f),
+                       Float(-2.5f), Float(3.25f), Float(0.0f)));
+
+    std::vector<float> value;
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    std::vector<float> expected = {1.0f, -2.5f, 3.25f, 0.0f};
+    EXPECT_EQ(expected, value);
+  }
+
+  {
+    reader.Set(Compose(EncodingByte::Binary, 3, 0, 0, 0));
+
+    std::vector<float> value;
+    status = deserializer.Read(&value);
+    ASSERT_FALSE(status);
+    EXPECT_EQ(ErrorStatus::InvalidContainerLength, status.error());
+  }
+
+  {
+    reader.Set(Compose(EncodingByte::Binary, 2 * sizeof(double), Float(1.0),
+                       Float(-2.5)));
+
+    std::list<double> value;
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    std::list<double> expected = {1.0, -2.5};
+    EXPECT_EQ(expected, value);
+  }
+
+  {
+    reader.Set(Compose(EncodingByte::Binary, 3 * sizeof(double), Float(1.0),
+                       Float(-2.5), Float(3.25)));
+
+    std::array<double, 3> value;
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    std::array<double, 3> expected = {{1.0, -2.5, 3.25}};
+    EXPECT_EQ(expected, value);
+  }
+
+  {
+    reader.Set(Compose(EncodingByte::Binary, 2 * sizeof(float), Float(1.0f),
+                       Float(-2.5f)));
+
+    float value[2];
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(1.0f, value[0]);
+    EXPECT_EQ(-2.5f, value[1]);
+  }
+
+  {
+    reader.Set(Compose(EncodingByte::Structure, 1, EncodingByte::Binary,
+                       2 * sizeof(float), Float(1.0f), Float(-2.5f)));
+
+    TestK value;
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(2u, value.size);
+    EXPECT_EQ(1.0f, value.data[0]);
+    EXPECT_EQ(-2.5f, value.data[1]);
+  }
+}
+
+// Floating point containers were encoded as arrays of individual elements by
+// older versions of the library. Make sure this encoding is still accepted.
+TEST(Deserializer, FloatArrayLegacy) {
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+  Status<void> status;
+
+  {
+    reader.Set(Compose(EncodingByte::Array, 2, EncodingByte::F32, Float(1.0f),
+                       EncodingByte::F32, Float(-2.5f)));
+
+    std::vector<float> value;
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    std::vector<float> expected = {1.0f, -2.5f};
+    EXPECT_EQ(expected, value);
+  }
+
+  {
+    reader.Set(Compose(EncodingByte::Array, 2, EncodingByte::F64, Float(1.0),
+                       EncodingByte::F64, Float(-2.5)));
+
+    std::list<double> value;
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    std::list<double> expected = {1.0, -2.5};
+    EXPECT_EQ(expected, value);
+  }
+
+  {
+    reader.Set(Compose(EncodingByte::Array, 2, EncodingByte::F64, Float(1.0),
+                       EncodingByte::F64, Float(-2.5)));
+
+    std::array<double, 2> value;
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    std::array<double, 2> expected = {{1.0, -2.5}};
+    EXPECT_EQ(expected, value);
+
+    reader.Set(Compose(EncodingByte::Array, 1, EncodingByte::F64, Float(1.0)));
+    status = deserializer.Read(&value);
+    ASSERT_FALSE(status);
+    EXPECT_EQ(ErrorStatus::InvalidContainerLength, status.error());
+  }
+
+  {
+    reader.Set(Compose(EncodingByte::Array, 2, EncodingByte::F32, Float(1.0f),
+                       EncodingByte::F32, Float(-2.5f)));
+
+    float value[2];
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(1.0f, value[0]);
+    EXPECT_EQ(-2.5f, value[1]);
+  }
+
+  {
+    reader.Set(Compose(EncodingByte::Structure, 1, EncodingByte::Array, 2,
+                       EncodingByte::F32, Float(1.0f), EncodingByte::F32,
+                       Float(-2.5f)));
+
+    TestK value;
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(2u, value.size);
+    EXPECT_EQ(1.0f, value.data[0]);
+    EXPECT_EQ(-2.5f, value.data[1]);
+
+    reader.Set(Compose(EncodingByte::Structure, 1, EncodingByte::Array, 5));
+    status = deserializer.Read(&value);
+    ASSERT_FALSE(status);
+    EXPECT_EQ(ErrorStatus::InvalidContainerLength, status.error());
+  }
+
+  {
+    // Integral containers never used the array encoding.
+    reader.Set(Compose(EncodingByte::Array, 1, 1));
+
+    std::vector<int> value;
+    status = deserializer.Read(&value);
+    ASSERT_FALSE(status);
+    EXPECT_EQ(ErrorStatus::UnexpectedEncodingType, status.error());
+  }
+}
+
 TEST(Serializer, char) {
   std::vector<std::uint8_t> expected;
   TestWriter writer;
@@ -5838,6 +6706,34 @@ TEST(Deserializer, Map) {
     std::map<int, std::string> expected = {{{0, "abc"}, {1, "123"}}};
     EXPECT_EQ(expected, value);
   }
+
+  // Decoding into a map decodes the values of keys that appear again in
+  // place, erases the others, and handles entries that are not in order.
+  {
+    std::map<int, std::string> value = {
+        {{0, std::string(64, 'x')}, {1, "a"}, {2, "b"}, {5, "c"}}};
+    const char* data = value[0].data();
+
+    reader.Set(Compose(EncodingByte::Map, 3, 0, EncodingByte::String, 3, "abc",
+                       3, EncodingByte::String, 3, "def", 5,
+                       EncodingByte::String, 3, "ghi"));
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    std::map<int, std::string> expected = {{{0, "abc"}, {3, "def"},
+                                            {5, "ghi"}}};
+    EXPECT_EQ(expected, value);
+    EXPECT_EQ(data, value[0].data());
+
+    reader.Set(Compose(EncodingByte::Map, 3, 5, EncodingByte::String, 1, "x",
+                       1, EncodingByte::String, 1, "y", 5,
+                       EncodingByte::String, 1, "z"));
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    expected = {{{1, "y"}, {5, "x"}}};
+    EXPECT_EQ(expected, value);
+  }
 }
 
 TEST(Serializer, UnorderedMapFailOnPrepare) {
@@ -7682,6 +8578,107 @@ TEST(Deserializer, Structure) {
   }
 }
 
+TEST(Serializer, RawStructure) {
+  std::vector<std::uint8_t> expected;
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+  Status<void> status;
+
+  {
+    RawPoint value{1.0f, 2.0f, 3.0f};
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+
+    expected = Compose(EncodingByte::Binary, 12, Float(1.0f), Float(2.0f),
+                       Float(3.0f));
+    EXPECT_EQ(expected, writer.data());
+    EXPECT_EQ(expected.size(), Encoding<RawPoint>::Size(value));
+    writer.clear();
+  }
+
+  {
+    RawTriangle value{{{1.0f, 2.0f, 3.0f}, {4.0f, 5.0f, 6.0f}, {}}, 0xff};
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+
+    expected = Compose(EncodingByte::Binary, 40, Float(1.0f), Float(2.0f),
+                       Float(3.0f), Float(4.0f), Float(5.0f), Float(6.0f),
+                       Float(0.0f), Float(0.0f), Float(0.0f),
+                       Integer<std::uint32_t>(0xff));
+    EXPECT_EQ(expected, writer.data());
+    writer.clear();
+  }
+
+  // Containers of raw structures are packed into one binary container.
+  {
+    std::vector<RawPoint> value{{1.0f, 2.0f, 3.0f}, {4.0f, 5.0f, 6.0f}};
+
+    status = serializer.Write(value);
+    ASSERT_TRUE(status);
+
+    expected = Compose(EncodingByte::Binary, 24, Float(1.0f), Float(2.0f),
+                       Float(3.0f), Float(4.0f), Float(5.0f), Float(6.0f));
+    EXPECT_EQ(expected, writer.data());
+    writer.clear();
+  }
+
+  EXPECT_TRUE(FixedEncodingSize<RawPoint>::value);
+  EXPECT_EQ(14u, FixedEncodingSize<RawPoint>::Size);
+  EXPECT_TRUE((IsPackable<RawTriangle>::value));
+}
+
+TEST(Deserializer, RawStructure) {
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+  Status<void> status;
+
+  {
+    RawPoint value;
+
+    reader.Set(Compose(EncodingByte::Binary, 12, Float(1.0f), Float(2.0f),
+                       Float(3.0f)));
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    RawPoint expected{1.0f, 2.0f, 3.0f};
+    EXPECT_EQ(expected, value);
+  }
+
+  {
+    std::vector<RawPoint> value;
+
+    reader.Set(Compose(EncodingByte::Binary, 24, Float(1.0f), Float(2.0f),
+                       Float(3.0f), Float(4.0f), Float(5.0f), Float(6.0f)));
+    status = deserializer.Read(&value);
+    ASSERT_TRUE(status);
+
+    std::vector<RawPoint> expected{{1.0f, 2.0f, 3.0f}, {4.0f, 5.0f, 6.0f}};
+    EXPECT_EQ(expected, value);
+  }
+
+  {
+    RawPoint value;
+
+    reader.Set(Compose(EncodingByte::Binary, 8, Float(1.0f), Float(2.0f)));
+    status = deserializer.Read(&value);
+    ASSERT_FALSE(status);
+    EXPECT_EQ(ErrorStatus::InvalidContainerLength, status.error());
+  }
+
+  {
+    RawPoint value;
+
+    reader.Set(Compose(EncodingByte::Structure, 3, EncodingByte::F32,
+                       Float(1.0f), EncodingByte::F32, Float(2.0f),
+                       EncodingByte::F32, Float(3.0f)));
+    status = deserializer.Read(&value);
+    ASSERT_FALSE(status);
+    EXPECT_EQ(ErrorStatus::UnexpectedEncodingType, status.error());
+  }
+}
+
 TEST(Serializer, TableFailOnPrepare) {
   MockWriter writer;
   Serializer<MockWriter*> serializer{&writer};
@@ -8378,6 +9375,43 @@ TEST(Deserializer, Table) {
   }
 }
 
+TEST(Deserializer, TableReuse) {
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+  Status<void> status;
+
+  // Entries present in the encoding are decoded over the existing values, and
+  // entries absent from the encoding are cleared.
+  TableA1 value{std::string(64, 'x'), {{"snarky", "male", "attitude"}}};
+  const char* name_data = value.name.get().data();
+
+  reader.Set(Compose(EncodingByte::Table, 15, 1, 0, 13, EncodingByte::String,
+                     11, "Ron Swanson"));
+  status = deserializer.Read(&value);
+  ASSERT_TRUE(status);
+
+  EXPECT_EQ(TableA1{"Ron Swanson"}, value);
+  EXPECT_EQ(name_data, value.name.get().data());
+  EXPECT_TRUE(value.attributes.empty());
+
+  reader.Set(Compose(EncodingByte::Table, 15, 1, 1, 10, EncodingByte::Array,
+                     1, EncodingByte::String, 6, "snarky"));
+  status = deserializer.Read(&value);
+  ASSERT_TRUE(status);
+
+  EXPECT_EQ(TableA1{std::vector<std::string>{"snarky"}}, value);
+  EXPECT_TRUE(value.name.empty());
+
+  // Duplicate entries are still detected when the entry was already present.
+  reader.Set(Compose(EncodingByte::Table, 15, 2, 1, 10, EncodingByte::Array,
+                     1, EncodingByte::String, 6, "snarky", 1, 10,
+                     EncodingByte::Array, 1, EncodingByte::String, 6,
+                     "snarky"));
+  status = deserializer.Read(&value);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::DuplicateTableEntry, status.error());
+}
+
 TEST(Serializer, VariantFailOnPrepare) {
   MockWriter writer;
   Serializer<MockWriter*> serializer{&writer};
@@ -8664,6 +9698,27 @@ TEST(Deserializer, Variant) {
     EXPECT_EQ("foo", std::get<std::string>(value_b));
     EXPECT_TRUE(value_c.empty());
   }
+
+  // The active element is decoded in place when the type matches.
+  {
+    Variant<int, std::string> value{std::string(64, 'x')};
+    const char* data = std::get<std::string>(value).data();
+
+    reader.Set(Compose(EncodingByte::Variant, 1, EncodingByte::String, 3,
+                       "foo"));
+
+    ASSERT_TRUE(deserializer.Read(&value));
+    ASSERT_TRUE(value.is<std::string>());
+    EXPECT_EQ("foo", std::get<std::string>(value));
+    EXPECT_EQ(data, std::get<std::string>(value).data());
+    EXPECT_LE(64u, std::get<std::string>(value).capacity());
+
+    reader.Set(Compose(EncodingByte::Variant, 0, 10));
+
+    ASSERT_TRUE(deserializer.Read(&value));
+    ASSERT_TRUE(value.is<int>());
+    EXPECT_EQ(10, std::get<int>(value));
+  }
 }
 
 TEST(Serializer, Value) {
@@ -9121,3 +10176,455 @@ TEST(Deserializer, reference_wrapper) {
     EXPECT_EQ(expected, value);
   }
 }
+
+/* Fixed encoding size */
+TEST(Serializer, FixedEncodingSize) {
+  using nop::FixedEncodingSize;
+
+  EXPECT_TRUE(FixedEncodingSize<bool>::value);
+  EXPECT_TRUE(FixedEncodingSize<float>::value);
+  EXPECT_TRUE(FixedEncodingSize<double>::value);
+  EXPECT_FALSE(FixedEncodingSize<int>::value);
+  EXPECT_FALSE(FixedEncodingSize<EnumA>::value);
+  EXPECT_FALSE(FixedEncodingSize<std::string>::value);
+  EXPECT_FALSE(FixedEncodingSize<std::vector<float>>::value);
+  EXPECT_FALSE(FixedEncodingSize<TestA>::value);
+  EXPECT_FALSE((FixedEncodingSize<std::pair<float, int>>::value));
+
+  EXPECT_EQ(1u, FixedEncodingSize<bool>::Size);
+  EXPECT_EQ(5u, FixedEncodingSize<float>::Size);
+  EXPECT_EQ(9u, FixedEncodingSize<double>::Size);
+
+  // Prefix, count, and three members.
+  EXPECT_TRUE(FixedEncodingSize<TestL>::value);
+  EXPECT_EQ(13u, FixedEncodingSize<TestL>::Size);
+  EXPECT_TRUE(FixedEncodingSize<ValueWrapper<TestL>>::value);
+  EXPECT_EQ(13u, FixedEncodingSize<ValueWrapper<TestL>>::Size);
+
+  EXPECT_TRUE((FixedEncodingSize<std::pair<float, bool>>::value));
+  EXPECT_EQ(8u, (FixedEncodingSize<std::pair<float, bool>>::Size));
+  EXPECT_TRUE((FixedEncodingSize<std::tuple<double, TestL>>::value));
+  EXPECT_EQ(24u, (FixedEncodingSize<std::tuple<double, TestL>>::Size));
+
+  // Packable arrays are fixed size regardless of the element type.
+  EXPECT_TRUE((FixedEncodingSize<std::array<int, 4>>::value));
+  EXPECT_EQ(18u, (FixedEncodingSize<std::array<int, 4>>::Size));
+  EXPECT_TRUE((FixedEncodingSize<std::uint8_t[200]>::value));
+  EXPECT_EQ(203u, (FixedEncodingSize<std::uint8_t[200]>::Size));
+  EXPECT_TRUE((FixedEncodingSize<std::array<TestL, 2>>::value));
+  EXPECT_EQ(28u, (FixedEncodingSize<std::array<TestL, 2>>::Size));
+  EXPECT_TRUE((FixedEncodingSize<TestL[2]>::value));
+  EXPECT_EQ(28u, (FixedEncodingSize<TestL[2]>::Size));
+  EXPECT_FALSE((FixedEncodingSize<std::array<std::string, 2>>::value));
+
+  // Container sizes computed from the fixed element size must match the
+  // encoded data exactly.
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+
+  {
+    std::vector<TestL> value(1000, TestL{1.0f, 2.0f, true});
+    ASSERT_TRUE(serializer.Write(value));
+    EXPECT_EQ(writer.data().size(), serializer.GetSize(value));
+    EXPECT_EQ(4u + 1000u * 13u, writer.data().size());
+    writer.clear();
+  }
+
+  {
+    std::map<bool, double> value = {{false, 1.0}, {true, 2.0}};
+    ASSERT_TRUE(serializer.Write(value));
+    EXPECT_EQ(writer.data().size(), serializer.GetSize(value));
+    writer.clear();
+  }
+
+  {
+    std::list<std::pair<float, bool>> value(10);
+    ASSERT_TRUE(serializer.Write(value));
+    EXPECT_EQ(writer.data().size(), serializer.GetSize(value));
+    writer.clear();
+  }
+
+  {
+    std::array<TestL, 3> value{};
+    ASSERT_TRUE(serializer.Write(value));
+    EXPECT_EQ(writer.data().size(), serializer.GetSize(value));
+    writer.clear();
+  }
+}
+
+TEST(Serializer, SkipPrepare) {
+  SkipPrepareWriter writer;
+  Serializer<SkipPrepareWriter*> serializer{&writer};
+
+  std::vector<std::string> value = {"abc", "def"};
+  ASSERT_TRUE(serializer.Write(value));
+  EXPECT_EQ(0u, writer.prepare_count());
+
+  std::vector<std::uint8_t> expected = Compose(
+      EncodingByte::Array, 2, EncodingByte::String, 3, "abc",
+      EncodingByte::String, 3, "def");
+  EXPECT_EQ(expected, writer.data());
+}
+
+TEST(Serializer, StagedWrites) {
+  const TestL value{1.0f, 2.0f, true};
+  const std::vector<std::uint8_t> expected =
+      Compose(EncodingByte::Structure, 3, EncodingByte::F32, Float(1.0f),
+              EncodingByte::F32, Float(2.0f), EncodingByte::True);
+
+  // Small bounded structures are written in a single call.
+  {
+    WriteCountingWriter<false> writer;
+    Serializer<decltype(writer)*> serializer{&writer};
+    ASSERT_TRUE(serializer.Write(value));
+    EXPECT_EQ(expected, writer.data());
+    EXPECT_EQ(1u, writer.write_count());
+
+    writer.clear();
+    std::array<TestL, 3> values{{value, value, value}};
+    ASSERT_TRUE(serializer.Write(values));
+    EXPECT_EQ(serializer.GetSize(values), writer.data().size());
+  }
+
+  // Writers may opt out.
+  {
+    WriteCountingWriter<true> writer;
+    Serializer<decltype(writer)*> serializer{&writer};
+    ASSERT_TRUE(serializer.Write(value));
+    EXPECT_EQ(expected, writer.data());
+    EXPECT_LT(1u, writer.write_count());
+  }
+
+  // Staged writes are still bounded by the underlying writer.
+  {
+    TestWriter writer;
+    nop::BoundedWriter<TestWriter> bounded_writer{&writer, 8};
+    Serializer<decltype(bounded_writer)*> serializer{&bounded_writer};
+    EXPECT_EQ(ErrorStatus::WriteLimitReached,
+              serializer.Write(value).error());
+    EXPECT_TRUE(writer.data().empty());
+  }
+}
+
+TEST(Deserializer, TableEntryIdIndex) {
+  using Dense = EntryIdIndex<0, 1, 3, 2, 6>;
+  EXPECT_TRUE(Dense::IsDense::value);
+  EXPECT_EQ(0u, Dense::Find(0));
+  EXPECT_EQ(1u, Dense::Find(1));
+  EXPECT_EQ(3u, Dense::Find(2));
+  EXPECT_EQ(2u, Dense::Find(3));
+  EXPECT_EQ(4u, Dense::Find(6));
+  EXPECT_EQ(5u, Dense::Find(4));
+  EXPECT_EQ(5u, Dense::Find(7));
+  EXPECT_EQ(5u, Dense::Find(1u << 20));
+
+  using Sparse = EntryIdIndex<1000, 7, 1ull << 40, 3>;
+  EXPECT_FALSE(Sparse::IsDense::value);
+  EXPECT_EQ(0u, Sparse::Find(1000));
+  EXPECT_EQ(1u, Sparse::Find(7));
+  EXPECT_EQ(2u, Sparse::Find(1ull << 40));
+  EXPECT_EQ(3u, Sparse::Find(3));
+  EXPECT_EQ(4u, Sparse::Find(0));
+  EXPECT_EQ(4u, Sparse::Find(8));
+  EXPECT_EQ(4u, Sparse::Find(~0ull));
+
+  using Empty = EntryIdIndex<>;
+  EXPECT_EQ(0u, Empty::Find(0));
+  EXPECT_EQ(0u, Empty::Find(10));
+}
+
+TEST(Deserializer, SparseTable) {
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+
+  // Entries in any order, including a deleted entry and an unknown entry.
+  reader.Set(Compose(EncodingByte::Table, 16, 5, 3, 1, 4, EncodingByte::U64,
+                     Integer<std::uint64_t>(1ull << 40), 2, 1, 5, 7, 4,
+                     EncodingByte::String, 2, "ab", 9, 2, 0, 0,
+                     EncodingByte::U16, Integer<std::uint16_t>(1000), 3,
+                     EncodingByte::I16, Integer<std::int16_t>(-300)));
+
+  TableB value;
+  auto status = deserializer.Read(&value);
+  ASSERT_TRUE(status) << status.GetErrorMessage();
+  ASSERT_TRUE(value.a);
+  EXPECT_EQ(-300, value.a.get());
+  ASSERT_TRUE(value.b);
+  EXPECT_EQ("ab", value.b.get());
+  ASSERT_TRUE(value.d);
+  EXPECT_EQ(4, value.d.get());
+}
+
+TEST(Deserializer, DecodeConstruct) {
+  static_assert(!std::is_default_constructible<Account>::value, "");
+  static_assert(nop::IsDecodeConstructible<Account>::value, "");
+
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+
+  const auto account = [](std::uint32_t id) {
+    return Account{"owner" + std::to_string(id), id * 100};
+  };
+
+  {
+    std::vector<Account> value;
+    for (std::uint32_t i = 0; i < 3; i++)
+      value.push_back(account(i));
+    ASSERT_TRUE(serializer.Write(value));
+    reader.Set(writer.data());
+    writer.clear();
+
+    // Elements are decoded in place, without moving them into the vector.
+    std::vector<Account> result;
+    result.reserve(3);
+    Account::moves = 0;
+    ASSERT_TRUE(deserializer.Read(&result));
+    EXPECT_EQ(0, Account::moves);
+    ASSERT_EQ(3u, result.size());
+    EXPECT_EQ("owner2", result[2].owner());
+    EXPECT_EQ(200u, result[2].balance());
+
+    // Elements that fail to decode are not left in the vector.
+    reader.Set(Compose(EncodingByte::Array, 2, EncodingByte::Structure, 2,
+                       EncodingByte::String, 1, "a", 1, EncodingByte::Nil));
+    EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+              deserializer.Read(&result).error());
+    ASSERT_EQ(1u, result.size());
+    EXPECT_EQ("a", result[0].owner());
+  }
+
+  {
+    std::list<Account> value;
+    value.push_back(account(1));
+    value.push_back(account(2));
+    ASSERT_TRUE(serializer.Write(value));
+    reader.Set(writer.data());
+    writer.clear();
+
+    std::list<Account> result;
+    Account::moves = 0;
+    ASSERT_TRUE(deserializer.Read(&result));
+    EXPECT_EQ(0, Account::moves);
+    ASSERT_EQ(2u, result.size());
+    EXPECT_EQ("owner2", result.back().owner());
+  }
+
+  {
+    std::map<std::string, Account> value;
+    value.emplace("b", account(2));
+    value.emplace("a", account(1));
+    ASSERT_TRUE(serializer.Write(value));
+    reader.Set(writer.data());
+    writer.clear();
+
+    std::map<std::string, Account> result;
+    Account::moves = 0;
+    ASSERT_TRUE(deserializer.Read(&result));
+    EXPECT_EQ(0, Account::moves);
+    ASSERT_EQ(2u, result.size());
+    EXPECT_EQ(200u, result.at("b").balance());
+
+    // The first value of a duplicate key is kept.
+    reader.Set(Compose(EncodingByte::Map, 2, EncodingByte::String, 1, "a",
+                       EncodingByte::Structure, 2, EncodingByte::String, 1,
+                       "x", 1, EncodingByte::String, 1, "a",
+                       EncodingByte::Structure, 2, EncodingByte::String, 1,
+                       "y", 2));
+    ASSERT_TRUE(deserializer.Read(&result));
+    ASSERT_EQ(1u, result.size());
+    EXPECT_EQ("x", result.at("a").owner());
+  }
+
+  {
+    std::unordered_map<int, Account> value;
+    value.emplace(1, account(1));
+    value.emplace(2, account(2));
+    ASSERT_TRUE(serializer.Write(value));
+    reader.Set(writer.data());
+    writer.clear();
+
+    std::unordered_map<int, Account> result;
+    Account::moves = 0;
+    ASSERT_TRUE(deserializer.Read(&result));
+    EXPECT_EQ(0, Account::moves);
+    ASSERT_EQ(2u, result.size());
+    EXPECT_EQ("owner1", result.at(1).owner());
+
+    // Entries that fail to decode are not left in the map.
+    reader.Set(Compose(EncodingByte::Map, 1, 3, EncodingByte::Structure, 2,
+                       EncodingByte::String, 1, "a", EncodingByte::Nil));
+    EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+              deserializer.Read(&result).error());
+    EXPECT_TRUE(result.empty());
+  }
+
+  {
+    std::set<Account> value;
+    value.insert(account(1));
+    value.insert(account(2));
+    ASSERT_TRUE(serializer.Write(value));
+    reader.Set(writer.data());
+    writer.clear();
+
+    std::set<Account> result;
+    ASSERT_TRUE(deserializer.Read(&result));
+    ASSERT_EQ(2u, result.size());
+    EXPECT_EQ("owner1", result.begin()->owner());
+  }
+}
+
+// Decoding into existing containers reuses their elements and nodes, along
+// with any storage they own.
+TEST(Deserializer, DecodeIntoExisting) {
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+
+  const std::string long_a(32, 'a');
+  const std::string long_b(32, 'b');
+
+  {
+    std::vector<std::string> result{long_b, long_b, long_b};
+    const char* const data = result[1].data();
+
+    ASSERT_TRUE(serializer.Write(std::vector<std::string>{long_a, long_a}));
+    reader.Set(writer.data());
+    writer.clear();
+    ASSERT_TRUE(deserializer.Read(&result));
+    EXPECT_EQ((std::vector<std::string>{long_a, long_a}), result);
+    EXPECT_EQ(data, result[1].data());
+
+    ASSERT_TRUE(serializer.Write(
+        std::vector<std::string>{long_b, long_b, long_b, long_b}));
+    reader.Set(writer.data());
+    writer.clear();
+    ASSERT_TRUE(deserializer.Read(&result));
+    EXPECT_EQ((std::vector<std::string>{long_b, long_b, long_b, long_b}),
+              result);
+  }
+
+  {
+    std::list<Account> value;
+    value.emplace_back("owner1", 100);
+    value.emplace_back("owner2", 200);
+    ASSERT_TRUE(serializer.Write(value));
+    reader.Set(writer.data());
+    writer.clear();
+
+    std::list<Account> result;
+    result.emplace_back("x", 1);
+    result.emplace_back("y", 2);
+    result.emplace_back("z", 3);
+    const Account* const front = &result.front();
+    Account::moves = 0;
+    ASSERT_TRUE(deserializer.Read(&result));
+    EXPECT_EQ(0, Account::moves);
+    ASSERT_EQ(2u, result.size());
+    EXPECT_EQ(front, &result.front());
+    EXPECT_EQ("owner1", result.front().owner());
+    EXPECT_EQ(200u, result.back().balance());
+  }
+
+  {
+    std::unordered_map<int, std::string> result{{1, long_b}, {2, long_b}};
+    const std::string* const node = &result.at(1);
+    const char* const data = result.at(1).data();
+
+    ASSERT_TRUE(serializer.Write(
+        std::unordered_map<int, std::string>{{1, long_a}, {3, long_a}}));
+    reader.Set(writer.data());
+    writer.clear();
+    ASSERT_TRUE(deserializer.Read(&result));
+    EXPECT_EQ((std::unordered_map<int, std::string>{{1, long_a}, {3, long_a}}),
+              result);
+    EXPECT_EQ(node, &result.at(1));
+    EXPECT_EQ(data, result.at(1).data());
+
+    // Nodes whose keys do not appear are erased when decoding fails.
+    reader.Set(Compose(EncodingByte::Map, 2, 3, EncodingByte::String, 1, "c",
+                       4, EncodingByte::Nil));
+    EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+              deserializer.Read(&result).error());
+    EXPECT_EQ((std::unordered_map<int, std::string>{{3, "c"}}), result);
+  }
+
+  {
+    // A duplicate key keeps its first value whether the map is empty or its
+    // nodes are reused, including a key inserted while merging.
+    const std::vector<std::uint8_t> duplicates =
+        Compose(EncodingByte::Map, 4, 1, EncodingByte::String, 1, "a", 2,
+                EncodingByte::String, 1, "b", 1, EncodingByte::String, 1, "c",
+                2, EncodingByte::String, 1, "d");
+    const std::unordered_map<int, std::string> expected{{1, "a"}, {2, "b"}};
+
+    std::unordered_map<int, std::string> empty;
+    reader.Set(duplicates);
+    ASSERT_TRUE(deserializer.Read(&empty));
+    EXPECT_EQ(expected, empty);
+
+    std::unordered_map<int, std::string> populated{{1, "x"}, {3, "y"}};
+    reader.Set(duplicates);
+    ASSERT_TRUE(deserializer.Read(&populated));
+    EXPECT_EQ(expected, populated);
+  }
+
+  {
+    // Keys are decoded into a scratch key, which is moved into new nodes.
+    const std::map<std::string, int> value{{long_a, 1}, {long_b, 2}};
+    ASSERT_TRUE(serializer.Write(value));
+    reader.Set(writer.data());
+    writer.clear();
+
+    std::map<std::string, int> result{{long_a, 0}};
+    const int* const node = &result.at(long_a);
+    ASSERT_TRUE(deserializer.Read(&result));
+    EXPECT_EQ(value, result);
+    EXPECT_EQ(node, &result.at(long_a));
+  }
+
+  {
+    nop::Optional<std::string> result{long_b};
+    const char* const data = result.get().data();
+
+    ASSERT_TRUE(serializer.Write(nop::Optional<std::string>{long_a}));
+    reader.Set(writer.data());
+    writer.clear();
+    ASSERT_TRUE(deserializer.Read(&result));
+    ASSERT_TRUE(result);
+    EXPECT_EQ(long_a, result.get());
+    EXPECT_EQ(data, result.get().data());
+  }
+}
+
+// Outlined types encode the same as other types.
+TEST(Serializer, Outlined) {
+  std::vector<std::uint8_t> expected;
+  TestWriter writer;
+  Serializer<TestWriter*> serializer{&writer};
+  Status<void> status;
+
+  HasOutlined value{1, {{"foo", {1, 2}}}};
+  status = serializer.Write(value);
+  ASSERT_TRUE(status);
+
+  expected = Compose(EncodingByte::Structure, 2, 1, EncodingByte::Array, 1,
+                     EncodingByte::Structure, 2, EncodingByte::String, 3,
+                     "foo", EncodingByte::Binary, 2 * sizeof(int), 1, 0, 0, 0,
+                     2, 0, 0, 0);
+  EXPECT_EQ(expected, writer.data());
+
+  TestReader reader;
+  Deserializer<TestReader*> deserializer{&reader};
+  reader.Set(writer.data());
+
+  HasOutlined result;
+  status = deserializer.Read(&result);
+  ASSERT_TRUE(status);
+  EXPECT_EQ(1, result.id);
+  ASSERT_EQ(1u, result.outlined.size());
+  EXPECT_EQ("foo", result.outlined[0].name);
+  EXPECT_EQ((std::vector<int>{1, 2}), result.outlined[0].values);
+}
@@ -0,0 +1,172 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/socket_reader.h>
+#include <nop/utility/socket_writer.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::BufferReader;
+using nop::Deserializer;
+using nop::ErrorStatus;
+using nop::FileHandle;
+using nop::Serializer;
+using nop::SharedBlob;
+using nop::SharedBlobPool;
+using nop::SocketReader;
+using nop::SocketWriter;
+using nop::UniqueFileHandle;
+using nop::VectorWriter;
+
+namespace {
+
+struct Frame {
+  std::uint32_t id;
+  SharedBlob data;
+  NOP_STRUCTURE(Frame, id, data);
+};
+
+std::vector<std::uint8_t> MakeBytes(std::size_t size) {
+  std::vector<std::uint8_t> bytes(size);
+  std::iota(bytes.begin(), bytes.end(), std::uint8_t{0});
+  return bytes;
+}
+
+}  // anonymous namespace
+
+TEST(SharedBlobPool, Allocate) {
+  SharedBlobPool pool{1024 * 1024, 1024};
+  const auto bytes = MakeBytes(4096);
+
+  // Payloads under the threshold are stored inline.
+  auto small = pool.Create(bytes.data(), 100);
+  ASSERT_TRUE(small);
+  EXPECT_FALSE(small.get().shared());
+  EXPECT_EQ(100u, small.get().size());
+  EXPECT_FALSE(small.get().handle());
+
+  auto first = pool.Create(bytes.data(), bytes.size());
+  ASSERT_TRUE(first);
+  EXPECT_TRUE(first.get().shared());
+  EXPECT_TRUE(first.get().handle());
+  EXPECT_EQ(0u, first.get().offset());
+  EXPECT_TRUE(std::equal(bytes.begin(), bytes.end(), first.get().begin()));
+
+  // Blobs share a segment until it is full.
+  auto second = pool.Create(bytes.data(), 2000);
+  ASSERT_TRUE(second);
+  EXPECT_EQ(first.get().handle().get(), second.get().handle().get());
+  EXPECT_EQ(4096u, second.get().offset());
+
+  // Payloads larger than a segment get one of their own.
+  auto large = pool.Allocate(2 * 1024 * 1024);
+  ASSERT_TRUE(large);
+  EXPECT_NE(first.get().handle().get(), large.get().handle().get());
+  EXPECT_EQ(0u, large.get().offset());
+  ASSERT_NE(nullptr, large.get().mutable_data());
+  large.get().mutable_data()[large.get().size() - 1] = 0xff;
+}
+
+TEST(SharedBlob, Inline) {
+  const auto bytes = MakeBytes(100);
+  Serializer<VectorWriter> serializer;
+  ASSERT_TRUE(serializer.Write(Frame{1, SharedBlob{bytes}}));
+  const auto data = serializer.writer().take();
+
+  Deserializer<BufferReader> deserializer{data.data(), data.size()};
+  Frame frame;
+  ASSERT_TRUE(deserializer.Read(&frame));
+  EXPECT_EQ(1u, frame.id);
+  EXPECT_FALSE(frame.data.shared());
+  EXPECT_EQ(SharedBlob{bytes}, frame.data);
+
+  // The inline format is compatible with byte vectors.
+  std::vector<std::uint8_t> vector;
+  Deserializer<BufferReader> vector_deserializer{data.data() + 3,
+                                                 data.size() - 3};
+  ASSERT_TRUE(vector_deserializer.Read(&vector));
+  EXPECT_EQ(bytes, vector);
+}
+
+TEST(SharedBlob, Shared) {
+  int sockets[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+  Serializer<SocketWriter> serializer{sockets[0]};
+  Deserializer<SocketReader> deserializer{sockets[1]};
+
+  SharedBlobPool pool;
+  const auto bytes = MakeBytes(1024 * 1024);
+  auto blob = pool.Create(bytes.data(), bytes.size());
+  ASSERT_TRUE(blob);
+
+  // Only the handle, offset and length go on the wire.
+  ASSERT_TRUE(serializer.Write(Frame{2, blob.get()}));
+  EXPECT_GT(32u, serializer.writer().buffered());
+  EXPECT_EQ(1u, serializer.writer().buffered_handles());
+  ASSERT_TRUE(serializer.writer().Flush());
+
+  Frame frame;
+  auto status = deserializer.Read(&frame);
+  ASSERT_TRUE(status) << status.GetErrorMessage();
+  EXPECT_EQ(2u, frame.id);
+  EXPECT_TRUE(frame.data.shared());
+  EXPECT_EQ(blob.get(), frame.data);
+  EXPECT_EQ(nullptr, frame.data.mutable_data());
+  EXPECT_FALSE(frame.data.handle());
+
+  // The receiver views the sender's memory in place.
+  blob.get().mutable_data()[10] = 0xaa;
+  EXPECT_EQ(0xaa, frame.data.data()[10]);
+
+  // Mapped blobs are forwarded inline.
+  Serializer<VectorWriter> forwarder;
+  ASSERT_TRUE(forwarder.Write(frame.data));
+  EXPECT_LT(bytes.size(), forwarder.writer().size());
+
+  // Shared blobs need a writer that supports handles.
+  Serializer<VectorWriter> plain;
+  EXPECT_EQ(ErrorStatus::UnexpectedHandleType,
+            plain.Write(blob.get()).error());
+}
+
+TEST(SharedBlob, Map) {
+  SharedBlobPool pool{4096, 0};
+  auto blob = pool.Allocate(1000);
+  ASSERT_TRUE(blob);
+
+  auto mapped = SharedBlob::Map(
+      UniqueFileHandle::AsDuplicate(blob.get().handle()), 3000, 1000);
+  ASSERT_TRUE(mapped);
+  EXPECT_EQ(1000u, mapped.get().size());
+
+  // Regions must lie within the segment.
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+            SharedBlob::Map(UniqueFileHandle::AsDuplicate(blob.get().handle()),
+                            3000, 2000)
+                .error());
+  EXPECT_EQ(ErrorStatus::InvalidHandleValue,
+            SharedBlob::Map(UniqueFileHandle{}, 0, 0).error());
+}
@@ -0,0 +1,220 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/types/shared_frame.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/framing.h>
+#include <nop/utility/iovec_writer.h>
+#include <nop/utility/socket_reader.h>
+#include <nop/utility/socket_writer.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::BufferReader;
+using nop::Deserializer;
+using nop::EncodeFrame;
+using nop::EncodingByte;
+using nop::ErrorStatus;
+using nop::FramedReader;
+using nop::FramedWriter;
+using nop::IovecWriter;
+using nop::Serializer;
+using nop::SharedFrame;
+using nop::SocketReader;
+using nop::SocketWriter;
+using nop::VectorWriter;
+
+namespace {
+
+struct Update {
+  std::uint64_t sequence;
+  std::string topic;
+  std::vector<std::uint8_t> payload;
+  NOP_STRUCTURE(Update, sequence, topic, payload);
+};
+
+bool operator==(const Update& a, const Update& b) {
+  return a.sequence == b.sequence && a.topic == b.topic &&
+         a.payload == b.payload;
+}
+
+struct Envelope {
+  std::uint32_t channel;
+  SharedFrame update;
+  NOP_STRUCTURE(Envelope, channel, update);
+};
+
+Update MakeUpdate(std::size_t payload_size) {
+  return {42, "prices", std::vector<std::uint8_t>(payload_size, 0x5a)};
+}
+
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  return serializer.writer().take();
+}
+
+}  // anonymous namespace
+
+TEST(SharedFrame, Basic) {
+  SharedFrame empty;
+  ASSERT_EQ(1u, empty.size());
+  EXPECT_EQ(static_cast<std::uint8_t>(EncodingByte::Nil), empty.data()[0]);
+
+  const Update update = MakeUpdate(16);
+  auto frame = EncodeFrame(update);
+  ASSERT_TRUE(frame);
+  EXPECT_EQ(Encode(update), frame.get().buffer());
+  EXPECT_EQ(1, frame.get().use_count());
+
+  // Copies share the encoded bytes.
+  SharedFrame copy = frame.get();
+  EXPECT_EQ(2, frame.get().use_count());
+  EXPECT_EQ(frame.get().data(), copy.data());
+  EXPECT_EQ(frame.get(), copy);
+  EXPECT_NE(empty, copy);
+}
+
+TEST(SharedFrame, Write) {
+  const Update update = MakeUpdate(16);
+  auto frame = EncodeFrame(update);
+  ASSERT_TRUE(frame);
+
+  // A frame writes the same as the value it holds, alone or as a member.
+  for (int i = 0; i < 3; i++)
+    EXPECT_EQ(Encode(update), Encode(frame.get()));
+
+  const std::vector<std::uint8_t> envelope = Encode(Envelope{7, frame.get()});
+  EXPECT_EQ(Encode(update), std::vector<std::uint8_t>(envelope.end() -
+                                                          frame.get().size(),
+                                                      envelope.end()));
+
+  // Framing writers frame the value as usual.
+  Serializer<FramedWriter<VectorWriter>> serializer;
+  ASSERT_TRUE(serializer.Write(frame.get()));
+  ASSERT_TRUE(serializer.writer().EndFrame());
+  const std::vector<std::uint8_t> framed = serializer.writer().writer().take();
+
+  Deserializer<FramedReader<BufferReader>> deserializer{framed.data(),
+                                                        framed.size()};
+  ASSERT_TRUE(deserializer.reader().NextFrame());
+  Update result;
+  ASSERT_TRUE(deserializer.Read(&result));
+  EXPECT_EQ(update, result);
+}
+
+TEST(SharedFrame, Read) {
+  const std::vector<std::uint8_t> encoded = Encode(MakeUpdate(16));
+
+  // Reading a frame captures the encoding of the value.
+  SharedFrame frame;
+  const SharedFrame copy = frame;
+  {
+    Deserializer<BufferReader> deserializer{encoded.data(), encoded.size()};
+    ASSERT_TRUE(deserializer.Read(&frame));
+    EXPECT_EQ(encoded, frame.buffer());
+  }
+
+  // Frames that shared the bytes read over are left alone.
+  EXPECT_EQ(SharedFrame{}, copy);
+  EXPECT_EQ(1, frame.use_count());
+
+  {
+    Deserializer<BufferReader> deserializer{encoded.data(),
+                                            encoded.size() - 1};
+    EXPECT_EQ(ErrorStatus::ReadLimitReached,
+              deserializer.Read(&frame).error());
+  }
+}
+
+TEST(SharedFrame, IovecWriter) {
+  const std::vector<std::uint8_t> expected = Encode(MakeUpdate(4096));
+
+  // Large frames are referenced in place and kept alive by the writer.
+  Serializer<IovecWriter> serializer{std::size_t{1024}};
+  const std::uint8_t* data;
+  {
+    auto frame = EncodeFrame(MakeUpdate(4096));
+    ASSERT_TRUE(frame);
+    data = frame.get().data();
+    ASSERT_TRUE(serializer.Write(frame.get()));
+    ASSERT_TRUE(serializer.Write(frame.get()));
+    EXPECT_EQ(3, frame.get().use_count());
+  }
+  EXPECT_EQ(0u, serializer.writer().scratch_size());
+
+  std::vector<std::uint8_t> output;
+  for (const iovec& vec : serializer.writer().iovecs()) {
+    EXPECT_EQ(data, vec.iov_base);
+    const std::uint8_t* base = static_cast<const std::uint8_t*>(vec.iov_base);
+    output.insert(output.end(), base, base + vec.iov_len);
+  }
+  std::vector<std::uint8_t> twice = expected;
+  twice.insert(twice.end(), expected.begin(), expected.end());
+  EXPECT_EQ(twice, output);
+  serializer.writer().clear();
+
+  // Small frames are copied like other small writes.
+  auto frame = EncodeFrame(MakeUpdate(16));
+  ASSERT_TRUE(frame);
+  ASSERT_TRUE(serializer.Write(frame.get()));
+  EXPECT_EQ(frame.get().size(), serializer.writer().scratch_size());
+  EXPECT_EQ(1, frame.get().use_count());
+}
+
+TEST(SharedFrame, SocketWriter) {
+  const Update update = MakeUpdate(1024);
+  auto frame = EncodeFrame(update);
+  ASSERT_TRUE(frame);
+
+  // One encoded frame fans out to several sockets, following any data that
+  // is buffered on each of them.
+  for (int i = 0; i < 3; i++) {
+    int sockets[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+
+    Serializer<SocketWriter> serializer{sockets[0]};
+    Deserializer<SocketReader> deserializer{sockets[1]};
+
+    ASSERT_TRUE(serializer.Write(std::string{"header"}));
+    ASSERT_TRUE(serializer.Write(frame.get()));
+    EXPECT_EQ(0u, serializer.writer().buffered());
+    ASSERT_TRUE(serializer.Write(frame.get()));
+    ASSERT_TRUE(serializer.writer().Flush());
+
+    std::string header;
+    ASSERT_TRUE(deserializer.Read(&header));
+    EXPECT_EQ("header", header);
+    for (int j = 0; j < 2; j++) {
+      Update result;
+      auto status = deserializer.Read(&result);
+      ASSERT_TRUE(status) << status.GetErrorMessage();
+      EXPECT_EQ(update, result);
+    }
+  }
+  EXPECT_EQ(1, frame.get().use_count());
+}
@@ -0,0 +1,255 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/types/result.h>
+#include <nop/types/variant.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/frame_scanner.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::BufferReader;
+using nop::Deserializer;
+using nop::EncodedLength;
+using nop::EncodingByte;
+using nop::Entry;
+using nop::ErrorStatus;
+using nop::ReadEntry;
+using nop::ReadMember;
+using nop::FrameScanner;
+using nop::Result;
+using nop::SeekEntry;
+using nop::SeekMember;
+using nop::Serializer;
+using nop::SizeType;
+using nop::SkipValue;
+using nop::Variant;
+using nop::VectorWriter;
+
+namespace {
+
+struct Shape {
+  std::string name;
+  std::vector<float> points;
+  Variant<int, std::string> tag;
+  std::map<std::uint32_t, std::vector<std::string>> labels;
+  NOP_STRUCTURE(Shape, name, points, tag, labels);
+};
+
+struct Document {
+  Entry<std::string, 0> title;
+  Entry<std::vector<Shape>, 1> shapes;
+  Entry<int, 2, nop::DeletedEntry> deleted;
+  NOP_TABLE(Document, title, shapes, deleted);
+};
+
+enum class TestError { None, Failed };
+
+Shape MakeShape() {
+  return {"shape",
+          std::vector<float>(100, 1.5f),
+          Variant<int, std::string>{std::string("tag")},
+          {{1, {"a", "b"}}, {1u << 20, {}}}};
+}
+
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  return serializer.writer().take();
+}
+
+// Expects EncodedLength() to match the size of the encoding and the length
+// found by FrameScanner, and to fail on every truncation of the encoding.
+template <typename T>
+void ExpectLength(const T& value) {
+  const auto encoding = Encode(value);
+
+  auto status = EncodedLength(encoding.data(), encoding.size());
+  ASSERT_TRUE(status) << status.GetErrorMessage();
+  EXPECT_EQ(encoding.size(), status.get());
+
+  FrameScanner scanner;
+  ASSERT_TRUE(scanner.Scan(encoding.data(), encoding.size()));
+  EXPECT_EQ(encoding.size(), scanner.length());
+
+  for (std::size_t size = 0; size < encoding.size(); size++) {
+    EXPECT_EQ(ErrorStatus::ReadLimitReached,
+              EncodedLength(encoding.data(), size).error())
+        << "size=" << size;
+  }
+}
+
+}  // anonymous namespace
+
+TEST(SkipValue, EncodedLength) {
+  ExpectLength(false);
+  ExpectLength(-20);
+  ExpectLength(std::uint16_t{60000});
+  ExpectLength(std::int64_t{-(1ll << 50)});
+  ExpectLength(2.5f);
+  ExpectLength(2.5);
+  ExpectLength(std::string(300, 's'));
+  ExpectLength(std::vector<std::uint8_t>(300, 1));
+  ExpectLength(std::vector<std::string>{"a", "bb", ""});
+  ExpectLength(std::map<std::string, int>{{"a", 1}, {"b", -1}});
+  ExpectLength(Variant<int, std::string>{});
+  ExpectLength(MakeShape());
+  ExpectLength(Result<TestError, std::string>{TestError::Failed});
+
+  Document document;
+  document.title = "document";
+  document.shapes = std::vector<Shape>(3, MakeShape());
+  ExpectLength(document);
+}
+
+TEST(SkipValue, Stream) {
+  Serializer<VectorWriter> serializer;
+  ASSERT_TRUE(serializer.Write(MakeShape()));
+  ASSERT_TRUE(serializer.Write(std::string(1000, 'x')));
+  ASSERT_TRUE(serializer.Write(std::uint32_t{12345}));
+  const auto& buffer = serializer.writer().buffer();
+
+  Deserializer<BufferReader> deserializer{buffer.data(), buffer.size()};
+  ASSERT_TRUE(SkipValue(&deserializer.reader()));
+  ASSERT_TRUE(SkipValue(&deserializer.reader()));
+
+  std::uint32_t value = 0;
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ(12345u, value);
+  EXPECT_TRUE(deserializer.reader().empty());
+}
+
+TEST(SkipValue, Nesting) {
+  // Deeply nested arrays are skipped without recursion.
+  const std::size_t depth = 100000;
+  std::vector<std::uint8_t> encoding;
+  for (std::size_t i = 0; i < depth; i++) {
+    encoding.push_back(static_cast<std::uint8_t>(EncodingByte::Array));
+    encoding.push_back(1);
+  }
+  encoding.push_back(static_cast<std::uint8_t>(EncodingByte::Nil));
+
+  auto status = EncodedLength(encoding.data(), encoding.size());
+  ASSERT_TRUE(status) << status.GetErrorMessage();
+  EXPECT_EQ(encoding.size(), status.get());
+}
+
+TEST(SkipValue, Errors) {
+  const std::uint8_t reserved[] = {
+      static_cast<std::uint8_t>(EncodingByte::ReservedMax)};
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            EncodedLength(reserved, sizeof(reserved)).error());
+
+  // Container lengths must be unsigned.
+  const std::uint8_t negative[] = {
+      static_cast<std::uint8_t>(EncodingByte::Map),
+      static_cast<std::uint8_t>(EncodingByte::NegativeFixIntMin)};
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            EncodedLength(negative, sizeof(negative)).error());
+
+  // Containers may not claim more elements than the input has bytes.
+  const std::uint8_t abusive[] = {
+      static_cast<std::uint8_t>(EncodingByte::Array),
+      static_cast<std::uint8_t>(EncodingByte::U64),
+      0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f};
+  EXPECT_EQ(ErrorStatus::ReadLimitReached,
+            EncodedLength(abusive, sizeof(abusive)).error());
+}
+
+TEST(ReadMember, Structure) {
+  const Shape shape = MakeShape();
+  const auto encoding = Encode(shape);
+
+  BufferReader reader{encoding.data(), encoding.size()};
+  Variant<int, std::string> tag;
+  ASSERT_TRUE((ReadMember<Shape, 2>(&tag, &reader)));
+  ASSERT_TRUE(tag.is<std::string>());
+  EXPECT_EQ("tag", *tag.get<std::string>());
+
+  reader = BufferReader{encoding.data(), encoding.size()};
+  std::string name;
+  ASSERT_TRUE((ReadMember<Shape, 0>(&name, &reader)));
+  EXPECT_EQ("shape", name);
+
+  // Other types are rejected.
+  const auto document = Encode(Document{});
+  reader = BufferReader{document.data(), document.size()};
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            (ReadMember<Shape, 0>(&name, &reader)).error());
+}
+
+TEST(ReadEntry, Table) {
+  Document document;
+  document.title = "document";
+  document.shapes = std::vector<Shape>(3, MakeShape());
+  const auto encoding = Encode(document);
+
+  BufferReader reader{encoding.data(), encoding.size()};
+  Entry<std::string, 0> title;
+  ASSERT_TRUE((ReadEntry<Document, 0>(&title, &reader)));
+  EXPECT_EQ(document.title, title);
+
+  reader = BufferReader{encoding.data(), encoding.size()};
+  Entry<std::vector<Shape>, 1> shapes;
+  ASSERT_TRUE((ReadEntry<Document, 1>(&shapes, &reader)));
+  ASSERT_TRUE(shapes);
+  EXPECT_EQ(3u, shapes.get().size());
+
+  // Entries that are not present are left empty.
+  const auto empty = Encode(Document{});
+  reader = BufferReader{empty.data(), empty.size()};
+  ASSERT_TRUE((ReadEntry<Document, 0>(&title, &reader)));
+  EXPECT_TRUE(title.empty());
+}
+
+TEST(SeekMember, Path) {
+  Document document;
+  document.shapes = std::vector<Shape>{MakeShape()};
+  const auto encoding = Encode(document);
+
+  // Select document.shapes[0].labels without decoding the rest.
+  BufferReader reader{encoding.data(), encoding.size()};
+  auto status = SeekEntry<Document, 1>(&reader);
+  ASSERT_TRUE(status);
+  ASSERT_TRUE(status.get());
+
+  SizeType count = 0;
+  std::uint8_t prefix = 0;
+  ASSERT_TRUE(reader.Read(&prefix));
+  EXPECT_EQ(EncodingByte::Array, static_cast<EncodingByte>(prefix));
+  ASSERT_TRUE(nop::Encoding<SizeType>::Read(&count, &reader));
+  EXPECT_EQ(1u, count);
+
+  std::map<std::uint32_t, std::vector<std::string>> labels;
+  ASSERT_TRUE((ReadMember<Shape, 3>(&labels, &reader)));
+  EXPECT_EQ(document.shapes.get()[0].labels, labels);
+
+  // Missing entries are reported without error.
+  const auto empty = Encode(Document{});
+  reader = BufferReader{empty.data(), empty.size()};
+  status = SeekEntry<Document, 1>(&reader);
+  ASSERT_TRUE(status);
+  EXPECT_FALSE(status.get());
+}
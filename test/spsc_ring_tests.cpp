@@ -0,0 +1,172 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/utility/spsc_ring.h>
+
+using nop::Deserializer;
+using nop::ErrorStatus;
+using nop::Serializer;
+using nop::SpscRing;
+using nop::SpscRingReader;
+using nop::SpscRingWriter;
+
+namespace {
+
+struct Quote {
+  std::uint64_t sequence;
+  std::string symbol;
+  double price;
+  NOP_STRUCTURE(Quote, sequence, symbol, price);
+};
+
+}  // anonymous namespace
+
+TEST(SpscRingTests, Create) {
+  SpscRing ring;
+  ASSERT_TRUE(ring.Create(100));
+  EXPECT_TRUE(ring.is_open());
+  EXPECT_FALSE(ring.is_closed());
+  EXPECT_EQ(128u, ring.capacity());
+  EXPECT_EQ(60u, ring.max_record());
+
+  // A second mapping of the same file shares the ring.
+  SpscRing peer;
+  ASSERT_TRUE(peer.Open(::dup(ring.fd())));
+  EXPECT_EQ(128u, peer.capacity());
+
+  Serializer<SpscRingWriter> serializer{&ring};
+  Deserializer<SpscRingReader> deserializer{&peer};
+  ASSERT_TRUE(serializer.Write(std::string{"hello"}));
+
+  std::string value;
+  ASSERT_TRUE(deserializer.Read(&value));
+  EXPECT_EQ("hello", value);
+  EXPECT_TRUE(deserializer.reader().empty());
+
+  // Files that are not rings are rejected.
+  int pipe_fds[2];
+  ASSERT_EQ(0, ::pipe(pipe_fds));
+  ::close(pipe_fds[1]);
+  SpscRing invalid;
+  auto status = invalid.Open(pipe_fds[0]);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::IOError, status.error());
+}
+
+TEST(SpscRingTests, Wrap) {
+  SpscRing ring;
+  ASSERT_TRUE(ring.Create(128));
+  Serializer<SpscRingWriter> serializer{&ring};
+  Deserializer<SpscRingReader> deserializer{&ring};
+
+  // Records that do not fit before the end of the ring start over at the
+  // beginning, so values of varying size wrap around many times.
+  for (std::uint64_t i = 0; i < 200; i++) {
+    const Quote quote{i, std::string(i % 40, 'x'), 1.5 * i};
+    ASSERT_TRUE(serializer.Write(quote));
+
+    Quote read;
+    ASSERT_TRUE(deserializer.Read(&read));
+    EXPECT_EQ(quote.sequence, read.sequence);
+    EXPECT_EQ(quote.symbol, read.symbol);
+    EXPECT_EQ(quote.price, read.price);
+    EXPECT_TRUE(deserializer.reader().empty());
+  }
+}
+
+TEST(SpscRingTests, Threads) {
+  SpscRing ring;
+  ASSERT_TRUE(ring.Create(1024));
+
+  // Values larger than the ring are split across records as the reader makes
+  // room, and both sides block while the other catches up.
+  const std::vector<std::uint8_t> large(10000, 0x5a);
+  const std::uint64_t kCount = 20000;
+
+  std::thread producer{[&] {
+    Serializer<SpscRingWriter> serializer{&ring};
+    for (std::uint64_t i = 0; i < kCount; i++) {
+      ASSERT_TRUE(serializer.Write(Quote{i, "NOP", 0.25 * i}));
+      if (i % 1000 == 0) {
+        ASSERT_TRUE(serializer.Write(large));
+      }
+    }
+    ring.Close();
+  }};
+
+  Deserializer<SpscRingReader> deserializer{&ring};
+  for (std::uint64_t i = 0; i < kCount; i++) {
+    Quote quote;
+    ASSERT_TRUE(deserializer.Read(&quote));
+    ASSERT_EQ(i, quote.sequence);
+    ASSERT_EQ(0.25 * i, quote.price);
+    if (i % 1000 == 0) {
+      std::vector<std::uint8_t> value;
+      ASSERT_TRUE(deserializer.Read(&value));
+      ASSERT_EQ(large, value);
+    }
+  }
+
+  // Reading past the end of a closed ring fails.
+  Quote quote;
+  auto status = deserializer.Read(&quote);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, status.error());
+  producer.join();
+
+  Serializer<SpscRingWriter> serializer{&ring};
+  status = serializer.Write(Quote{});
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::WriteLimitReached, status.error());
+}
+
+TEST(SpscRingTests, CorruptRecord) {
+  SpscRing ring;
+  ASSERT_TRUE(ring.Create(128));
+  Serializer<SpscRingWriter> serializer{&ring};
+  Deserializer<SpscRingReader> deserializer{&ring};
+  ASSERT_TRUE(serializer.Write(std::string{"hello"}));
+
+  // Overwrite the length of the published record through a separate mapping,
+  // as a hostile peer would, so that it runs past the end of the ring.
+  struct stat file_stat;
+  ASSERT_EQ(0, ::fstat(ring.fd(), &file_stat));
+  const std::size_t size = static_cast<std::size_t>(file_stat.st_size);
+  void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         ring.fd(), 0);
+  ASSERT_NE(MAP_FAILED, address);
+  const std::uint32_t length = 0x10000;
+  std::memcpy(static_cast<std::uint8_t*>(address) + size - ring.capacity(),
+              &length, sizeof(length));
+  ::munmap(address, size);
+
+  std::string value;
+  auto status = deserializer.Read(&value);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::ProtocolError, status.error());
+}
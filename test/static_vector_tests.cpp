@@ -0,0 +1,267 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/traits/is_fungible.h>
+#include <nop/types/static_string.h>
+#include <nop/types/static_vector.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/buffer_writer.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::BufferReader;
+using nop::BufferWriter;
+using nop::Deserializer;
+using nop::ErrorStatus;
+using nop::IsFungible;
+using nop::MaxEncodedSize;
+using nop::Serializer;
+using nop::SmallVector;
+using nop::StaticString;
+using nop::StaticVector;
+using nop::VectorWriter;
+
+namespace {
+
+struct Telemetry {
+  std::uint32_t sequence;
+  StaticString<8> name;
+  StaticVector<float, 4> samples;
+  NOP_STRUCTURE(Telemetry, sequence, name, samples);
+};
+
+struct HeapTelemetry {
+  std::uint32_t sequence;
+  std::string name;
+  std::vector<float> samples;
+  NOP_STRUCTURE(HeapTelemetry, sequence, name, samples);
+};
+
+// Returns the encoding of |value|.
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  return serializer.writer().take();
+}
+
+// Decodes |encoding| into |value|.
+template <typename T>
+nop::Status<void> Decode(const std::vector<std::uint8_t>& encoding, T* value) {
+  Deserializer<BufferReader> deserializer{encoding.data(), encoding.size()};
+  return deserializer.Read(value);
+}
+
+}  // anonymous namespace
+
+TEST(StaticVector, Basic) {
+  StaticVector<std::string, 3> vector;
+  EXPECT_TRUE(vector.empty());
+  EXPECT_EQ(3u, vector.capacity());
+
+  EXPECT_TRUE(vector.push_back("a"));
+  EXPECT_TRUE(vector.emplace_back(2, 'b'));
+  EXPECT_TRUE(vector.push_back("c"));
+  EXPECT_TRUE(vector.full());
+  EXPECT_FALSE(vector.push_back("d"));
+  ASSERT_EQ(3u, vector.size());
+  EXPECT_EQ("a", vector.front());
+  EXPECT_EQ("bb", vector[1]);
+  EXPECT_EQ("c", vector.back());
+
+  StaticVector<std::string, 3> copy{vector};
+  EXPECT_EQ(vector, copy);
+
+  StaticVector<std::string, 3> moved{std::move(copy)};
+  EXPECT_EQ(vector, moved);
+  EXPECT_TRUE(copy.empty());
+
+  EXPECT_FALSE(vector.resize(4));
+  EXPECT_EQ(3u, vector.size());
+  EXPECT_TRUE(vector.resize(1));
+  EXPECT_EQ((StaticVector<std::string, 3>{"a"}), vector);
+  EXPECT_TRUE(vector.resize(2, "z"));
+  EXPECT_EQ((StaticVector<std::string, 3>{"a", "z"}), vector);
+
+  vector.pop_back();
+  EXPECT_EQ(1u, vector.size());
+  vector.clear();
+  EXPECT_TRUE(vector.empty());
+
+  EXPECT_TRUE(vector.assign(moved.begin(), moved.end()));
+  EXPECT_EQ(moved, vector);
+  const std::vector<std::string> too_long(4, "x");
+  EXPECT_FALSE(vector.assign(too_long.begin(), too_long.end()));
+  EXPECT_EQ(moved, vector);
+}
+
+TEST(StaticVector, Destruction) {
+  auto counter = std::make_shared<int>(0);
+  {
+    StaticVector<std::shared_ptr<int>, 4> vector;
+    vector.push_back(counter);
+    vector.push_back(counter);
+    EXPECT_EQ(3, counter.use_count());
+    vector.pop_back();
+    EXPECT_EQ(2, counter.use_count());
+  }
+  EXPECT_EQ(1, counter.use_count());
+}
+
+TEST(SmallVector, Spill) {
+  SmallVector<std::string, 2> vector{"a", "b"};
+  EXPECT_TRUE(vector.is_inline());
+  EXPECT_EQ(2u, vector.capacity());
+
+  vector.push_back(vector[0]);
+  EXPECT_FALSE(vector.is_inline());
+  ASSERT_EQ(3u, vector.size());
+  EXPECT_EQ("a", vector[0]);
+  EXPECT_EQ("b", vector[1]);
+  EXPECT_EQ("a", vector[2]);
+
+  // Once on the heap the vector keeps its storage.
+  const std::size_t capacity = vector.capacity();
+  vector.clear();
+  EXPECT_FALSE(vector.is_inline());
+  EXPECT_EQ(capacity, vector.capacity());
+
+  SmallVector<std::string, 2> other{"x"};
+  vector = other;
+  EXPECT_EQ(other, vector);
+  EXPECT_FALSE(vector.is_inline());
+
+  SmallVector<std::string, 2> moved{std::move(vector)};
+  EXPECT_EQ(other, moved);
+  EXPECT_FALSE(moved.is_inline());
+
+  SmallVector<int, 4> small;
+  small.resize(4, 7);
+  EXPECT_TRUE(small.is_inline());
+  small.reserve(8);
+  EXPECT_FALSE(small.is_inline());
+  EXPECT_EQ((SmallVector<int, 4>{7, 7, 7, 7}), small);
+}
+
+TEST(StaticString, Basic) {
+  StaticString<4> string{"abc"};
+  EXPECT_EQ(3u, string.size());
+  EXPECT_EQ(4u, string.capacity());
+  EXPECT_EQ("abc", string);
+  EXPECT_STREQ("abc", string.c_str());
+
+  EXPECT_TRUE(string.push_back('d'));
+  EXPECT_TRUE(string.full());
+  EXPECT_FALSE(string.push_back('e'));
+  EXPECT_FALSE(string.append("e"));
+  EXPECT_FALSE(string.assign("abcde"));
+  EXPECT_EQ("abcd", string);
+
+  // Constructors truncate.
+  EXPECT_EQ("abcd", StaticString<4>{std::string{"abcdef"}});
+
+  EXPECT_TRUE(string.resize(2));
+  EXPECT_EQ("ab", string);
+  EXPECT_TRUE(string.resize(3, 'x'));
+  EXPECT_EQ("abx", string);
+  EXPECT_EQ(std::string{"abx"}, string.ToString());
+  EXPECT_EQ(StaticString<8>{"abx"}, string);
+
+  string.clear();
+  EXPECT_TRUE(string.empty());
+  EXPECT_STREQ("", string.c_str());
+}
+
+TEST(StaticVector, Serialize) {
+  const Telemetry telemetry{7, "probe", {1.0f, 2.0f, 3.0f}};
+  const HeapTelemetry heap_telemetry{7, "probe", {1.0f, 2.0f, 3.0f}};
+  EXPECT_TRUE((IsFungible<Telemetry, HeapTelemetry>::value));
+  EXPECT_EQ(Encode(heap_telemetry), Encode(telemetry));
+
+  Telemetry read_telemetry;
+  ASSERT_TRUE(Decode(Encode(heap_telemetry), &read_telemetry));
+  EXPECT_EQ(7u, read_telemetry.sequence);
+  EXPECT_EQ("probe", read_telemetry.name);
+  EXPECT_EQ((StaticVector<float, 4>{1.0f, 2.0f, 3.0f}),
+            read_telemetry.samples);
+
+  // Static containers are bounded and fit in a stack buffer.
+  std::uint8_t buffer[MaxEncodedSize<Telemetry>::value];
+  Serializer<BufferWriter> serializer{buffer, sizeof(buffer)};
+  EXPECT_TRUE(serializer.Write(Telemetry{1, "12345678", {1, 2, 3, 4}}));
+
+  // Encodings that exceed the capacity are rejected.
+  HeapTelemetry long_name{7, "long probe", {}};
+  auto status = Decode(Encode(long_name), &read_telemetry);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::InvalidStringLength, status.error());
+
+  HeapTelemetry many_samples{7, "probe", std::vector<float>(5)};
+  status = Decode(Encode(many_samples), &read_telemetry);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength, status.error());
+}
+
+TEST(StaticVector, SerializeElements) {
+  const std::vector<std::string> strings{"a", "b", std::string(64, 'c')};
+
+  StaticVector<std::string, 4> vector;
+  ASSERT_TRUE(Decode(Encode(strings), &vector));
+  EXPECT_EQ((StaticVector<std::string, 4>{"a", "b", std::string(64, 'c')}),
+            vector);
+  EXPECT_EQ(Encode(strings), Encode(vector));
+
+  // Elements already in the vector are decoded in place.
+  const char* data = vector[2].data();
+  const std::vector<std::string> other{"x", "y", std::string(32, 'z')};
+  ASSERT_TRUE(Decode(Encode(other), &vector));
+  EXPECT_EQ(std::string(32, 'z'), vector[2]);
+  EXPECT_EQ(data, vector[2].data());
+
+  ASSERT_TRUE(Decode(Encode(std::vector<std::string>{"q"}), &vector));
+  EXPECT_EQ((StaticVector<std::string, 4>{"q"}), vector);
+
+  auto status =
+      Decode(Encode(std::vector<std::string>(5, "x")), &vector);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength, status.error());
+}
+
+TEST(SmallVector, Serialize) {
+  EXPECT_TRUE((IsFungible<SmallVector<int, 2>, std::vector<int>>::value));
+  EXPECT_TRUE(
+      (IsFungible<SmallVector<int, 2>, StaticVector<int, 8>>::value));
+  EXPECT_FALSE((IsFungible<SmallVector<int, 2>, std::vector<long>>::value));
+
+  const std::vector<int> values{1, 2, 3, 4, 5};
+  SmallVector<int, 2> vector;
+  ASSERT_TRUE(Decode(Encode(std::vector<int>{1}), &vector));
+  EXPECT_TRUE(vector.is_inline());
+  ASSERT_TRUE(Decode(Encode(values), &vector));
+  EXPECT_FALSE(vector.is_inline());
+  EXPECT_EQ((SmallVector<int, 2>{1, 2, 3, 4, 5}), vector);
+  EXPECT_EQ(Encode(values), Encode(vector));
+
+  SmallVector<std::string, 1> strings;
+  ASSERT_TRUE(Decode(Encode(std::vector<std::string>{"a", "b"}), &strings));
+  EXPECT_EQ((SmallVector<std::string, 1>{"a", "b"}), strings);
+}
@@ -0,0 +1,243 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/utility/buffer_writer.h>
+#include <nop/utility/pedantic_buffer_reader.h>
+#include <nop/utility/stream_reader.h>
+#include <nop/utility/stream_writer.h>
+#include <nop/utility/vector_writer.h>
+
+using nop::Deserializer;
+using nop::ErrorStatus;
+using nop::PedanticBufferReader;
+using nop::Serializer;
+using nop::Status;
+using nop::StreamingBinary;
+using nop::StreamingString;
+using nop::StreamReader;
+using nop::StreamWriter;
+using nop::VectorWriter;
+
+namespace {
+
+struct Upload {
+  std::uint32_t id;
+  StreamingBinary contents;
+  std::uint32_t checksum;
+  NOP_STRUCTURE(Upload, id, contents, checksum);
+};
+
+struct StoredUpload {
+  std::uint32_t id;
+  std::vector<std::uint8_t> contents;
+  std::uint32_t checksum;
+  NOP_STRUCTURE(StoredUpload, id, contents, checksum);
+};
+
+std::uint8_t ByteAt(std::uint64_t offset) {
+  return static_cast<std::uint8_t>(offset * 31 + 7);
+}
+
+std::vector<std::uint8_t> MakeBytes(std::size_t size) {
+  std::vector<std::uint8_t> bytes(size);
+  for (std::size_t i = 0; i < size; i++)
+    bytes[i] = ByteAt(i);
+  return bytes;
+}
+
+// Source producing the bytes of MakeBytes() and recording the largest chunk.
+class Generator {
+ public:
+  StreamingBinary::Source source() {
+    return [this](std::uint8_t* data, std::size_t size) {
+      for (std::size_t i = 0; i < size; i++)
+        data[i] = ByteAt(offset_++);
+      max_chunk_ = std::max(max_chunk_, size);
+      return Status<void>{};
+    };
+  }
+
+  std::uint64_t offset() const { return offset_; }
+  std::size_t max_chunk() const { return max_chunk_; }
+
+ private:
+  std::uint64_t offset_{0};
+  std::size_t max_chunk_{0};
+};
+
+// Sink collecting the bytes it receives and recording the largest chunk.
+class Collector {
+ public:
+  StreamingBinary::Sink sink() {
+    return [this](const std::uint8_t* data, std::size_t size) {
+      bytes_.insert(bytes_.end(), data, data + size);
+      max_chunk_ = std::max(max_chunk_, size);
+      return Status<void>{};
+    };
+  }
+
+  const std::vector<std::uint8_t>& bytes() const { return bytes_; }
+  std::size_t max_chunk() const { return max_chunk_; }
+
+ private:
+  std::vector<std::uint8_t> bytes_;
+  std::size_t max_chunk_{0};
+};
+
+}  // anonymous namespace
+
+TEST(StreamingPayload, WriteReserved) {
+  const std::size_t kSize = 10000;
+  Generator generator;
+  Serializer<VectorWriter> serializer;
+  ASSERT_TRUE(serializer.Write(
+      Upload{1, StreamingBinary{kSize, generator.source(), 1024}, 2}));
+  EXPECT_EQ(kSize, generator.offset());
+  EXPECT_EQ(1024u, generator.max_chunk());
+
+  // The payload reads back as a byte vector.
+  const auto data = serializer.writer().take();
+  Deserializer<PedanticBufferReader> deserializer{data.data(), data.size()};
+  StoredUpload stored;
+  ASSERT_TRUE(deserializer.Read(&stored));
+  EXPECT_EQ(1u, stored.id);
+  EXPECT_EQ(MakeBytes(kSize), stored.contents);
+  EXPECT_EQ(2u, stored.checksum);
+}
+
+TEST(StreamingPayload, WriteBuffered) {
+  const std::size_t kSize = 5000;
+  Generator generator;
+  Serializer<StreamWriter<std::stringstream>> serializer;
+  ASSERT_TRUE(
+      serializer.Write(StreamingBinary{kSize, generator.source(), 512}));
+  EXPECT_EQ(512u, generator.max_chunk());
+
+  Serializer<VectorWriter> expected;
+  ASSERT_TRUE(expected.Write(MakeBytes(kSize)));
+  const auto data = expected.writer().take();
+  EXPECT_EQ(std::string(data.begin(), data.end()),
+            serializer.writer().stream().str());
+}
+
+TEST(StreamingPayload, Read) {
+  const std::size_t kSize = 7000;
+  Serializer<VectorWriter> serializer;
+  ASSERT_TRUE(serializer.Write(StoredUpload{3, MakeBytes(kSize), 4}));
+  const auto data = serializer.writer().take();
+
+  // Contiguous readers pass chunks directly from the input.
+  {
+    Collector collector;
+    Upload upload{0, StreamingBinary{collector.sink(), 1000}, 0};
+    Deserializer<PedanticBufferReader> deserializer{data.data(), data.size()};
+    ASSERT_TRUE(deserializer.Read(&upload));
+    EXPECT_EQ(3u, upload.id);
+    EXPECT_EQ(kSize, upload.contents.size());
+    EXPECT_EQ(MakeBytes(kSize), collector.bytes());
+    EXPECT_EQ(1000u, collector.max_chunk());
+    EXPECT_EQ(4u, upload.checksum);
+  }
+
+  // Other readers read chunks into a buffer.
+  {
+    Collector collector;
+    Upload upload{0, StreamingBinary{collector.sink(), 4096}, 0};
+    Deserializer<StreamReader<std::stringstream>> deserializer{
+        std::string(data.begin(), data.end())};
+    ASSERT_TRUE(deserializer.Read(&upload));
+    EXPECT_EQ(MakeBytes(kSize), collector.bytes());
+    EXPECT_EQ(4096u, collector.max_chunk());
+    EXPECT_EQ(4u, upload.checksum);
+  }
+
+  // Payloads without a sink are skipped.
+  {
+    Upload upload;
+    Deserializer<PedanticBufferReader> deserializer{data.data(), data.size()};
+    ASSERT_TRUE(deserializer.Read(&upload));
+    EXPECT_EQ(kSize, upload.contents.size());
+    EXPECT_EQ(4u, upload.checksum);
+  }
+}
+
+TEST(StreamingPayload, String) {
+  const std::string text(3000, 's');
+  std::size_t offset = 0;
+  StreamingString streaming{
+      text.size(), [&text, &offset](std::uint8_t* data, std::size_t size) {
+        std::copy(text.begin() + offset, text.begin() + offset + size, data);
+        offset += size;
+        return Status<void>{};
+      }};
+
+  Serializer<VectorWriter> serializer;
+  ASSERT_TRUE(serializer.Write(streaming));
+  const auto data = serializer.writer().take();
+
+  std::string result;
+  Deserializer<PedanticBufferReader> deserializer{data.data(), data.size()};
+  ASSERT_TRUE(deserializer.Read(&result));
+  EXPECT_EQ(text, result);
+
+  // Strings and binary payloads do not match.
+  StreamingBinary binary;
+  Deserializer<PedanticBufferReader> mismatch{data.data(), data.size()};
+  auto status = mismatch.Read(&binary);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType, status.error());
+}
+
+TEST(StreamingPayload, Errors) {
+  Serializer<VectorWriter> serializer;
+
+  // Payloads must have a source for their bytes.
+  auto status = serializer.Write(StreamingBinary{10, nullptr});
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength, status.error());
+  EXPECT_TRUE(serializer.Write(StreamingBinary{}));
+
+  // Source errors stop the write.
+  status = serializer.Write(StreamingBinary{
+      10, [](std::uint8_t*, std::size_t) -> Status<void> {
+        return ErrorStatus::IOError;
+      }});
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::IOError, status.error());
+
+  // Truncated payloads fail without calling the sink.
+  Serializer<VectorWriter> complete;
+  ASSERT_TRUE(complete.Write(MakeBytes(100)));
+  const auto data = complete.writer().take();
+
+  Collector collector;
+  StreamingBinary payload{collector.sink()};
+  Deserializer<PedanticBufferReader> deserializer{data.data(),
+                                                  data.size() - 1};
+  status = deserializer.Read(&payload);
+  ASSERT_FALSE(status);
+  EXPECT_EQ(ErrorStatus::ReadLimitReached, status.error());
+  EXPECT_TRUE(collector.bytes().empty());
+}
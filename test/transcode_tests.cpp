@@ -0,0 +1,256 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/types/flat_map.h>
+#include <nop/types/optional.h>
+#include <nop/types/static_string.h>
+#include <nop/types/static_vector.h>
+#include <nop/types/variant.h>
+#include <nop/types/view.h>
+#include <nop/utility/buffer_reader.h>
+#include <nop/utility/transcode.h>
+#include <nop/utility/vector_writer.h>
+#include <nop/value.h>
+
+using nop::ArrayView;
+using nop::BufferReader;
+using nop::Deserializer;
+using nop::Entry;
+using nop::ErrorStatus;
+using nop::FlatMap;
+using nop::Optional;
+using nop::Serializer;
+using nop::StaticString;
+using nop::StaticVector;
+using nop::StringView;
+using nop::Transcode;
+using nop::Variant;
+using nop::VectorWriter;
+
+namespace {
+
+struct Vec3 {
+  float x;
+  float y;
+  float z;
+  NOP_STRUCTURE(Vec3, x, y, z);
+};
+
+struct Triangle {
+  Vec3 a;
+  Vec3 b;
+  Vec3 c;
+  NOP_STRUCTURE(Triangle, a, b, c);
+};
+
+struct Polyhedron {
+  std::vector<Triangle> triangles;
+  NOP_VALUE(Polyhedron, triangles);
+};
+
+// C layout of Polyhedron, allocated with room for the triangles.
+struct CPolyhedron {
+  std::size_t size;
+  Triangle triangles[1];
+  NOP_VALUE(CPolyhedron, (triangles, size));
+  NOP_UNBOUNDED_BUFFER(CPolyhedron);
+};
+
+// Bounded C layout of a labeled list of points.
+struct CShape {
+  StaticString<16> label;
+  Vec3 points[4];
+  std::uint32_t point_count;
+  NOP_STRUCTURE(CShape, label, (points, point_count));
+};
+
+struct Shape {
+  std::string label;
+  std::vector<Vec3> points;
+  NOP_STRUCTURE(Shape, label, points);
+};
+
+struct InnerTable {
+  Entry<std::string, 0> name;
+  Entry<std::vector<int>, 1> values;
+  NOP_TABLE_HASH(1, InnerTable, name, values);
+};
+
+struct StaticInnerTable {
+  Entry<StaticString<8>, 0> name;
+  Entry<std::array<int, 3>, 1> values;
+  NOP_TABLE_HASH(1, StaticInnerTable, name, values);
+};
+
+struct Record {
+  std::map<std::string, std::vector<int>> index;
+  std::tuple<int, std::string> pair;
+  Optional<std::vector<int>> optional;
+  Variant<int, std::vector<int>> variant;
+  InnerTable table;
+  NOP_STRUCTURE(Record, index, pair, optional, variant, table);
+};
+
+struct StaticRecord {
+  FlatMap<std::string, StaticVector<int, 4>> index;
+  std::pair<int, StaticString<8>> pair;
+  Optional<std::array<int, 2>> optional;
+  Variant<int, std::list<int>> variant;
+  StaticInnerTable table;
+  NOP_STRUCTURE(StaticRecord, index, pair, optional, variant, table);
+};
+
+Triangle MakeTriangle(float base) {
+  return {{base, base + 1, base + 2},
+          {base + 3, base + 4, base + 5},
+          {base + 6, base + 7, base + 8}};
+}
+
+bool operator==(const Vec3& a, const Vec3& b) {
+  return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+bool operator==(const Triangle& a, const Triangle& b) {
+  return a.a == b.a && a.b == b.b && a.c == b.c;
+}
+
+// Returns the encoding of |value|.
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  return serializer.writer().take();
+}
+
+}  // anonymous namespace
+
+TEST(Transcode, LogicalBuffer) {
+  Polyhedron polyhedron{{MakeTriangle(0), MakeTriangle(9), MakeTriangle(18)}};
+
+  // The C structure is allocated with room for the triangles, as for
+  // decoding into it.
+  std::vector<std::uint8_t> storage(sizeof(CPolyhedron) +
+                                    2 * sizeof(Triangle));
+  CPolyhedron* c_polyhedron = reinterpret_cast<CPolyhedron*>(storage.data());
+  ASSERT_TRUE(Transcode(polyhedron, c_polyhedron));
+  ASSERT_EQ(3u, c_polyhedron->size);
+  for (std::size_t i = 0; i < 3; i++)
+    EXPECT_TRUE(polyhedron.triangles[i] == c_polyhedron->triangles[i]);
+
+  Polyhedron copy;
+  ASSERT_TRUE(Transcode(*c_polyhedron, &copy));
+  ASSERT_EQ(3u, copy.triangles.size());
+  for (std::size_t i = 0; i < 3; i++)
+    EXPECT_TRUE(polyhedron.triangles[i] == copy.triangles[i]);
+}
+
+TEST(Transcode, BoundedLogicalBuffer) {
+  Shape shape{"square", {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}}};
+  CShape c_shape;
+  ASSERT_TRUE(Transcode(shape, &c_shape));
+  EXPECT_EQ("square", std::string(c_shape.label.data(), c_shape.label.size()));
+  EXPECT_EQ(4u, c_shape.point_count);
+
+  // The result has the same encoding as the source.
+  EXPECT_EQ(Encode(shape), Encode(c_shape));
+
+  Shape copy;
+  ASSERT_TRUE(Transcode(c_shape, &copy));
+  EXPECT_EQ(shape.label, copy.label);
+  EXPECT_EQ(4u, copy.points.size());
+
+  // Sources that do not fit the bounded buffers are rejected, as they are
+  // when decoding.
+  shape.points.push_back({2, 2, 2});
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+            Transcode(shape, &c_shape).error());
+  std::vector<std::uint8_t> encoding = Encode(shape);
+  Deserializer<BufferReader> deserializer{encoding.data(), encoding.size()};
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+            deserializer.Read(&c_shape).error());
+}
+
+TEST(Transcode, Containers) {
+  Record record;
+  record.index = {{"a", {1, 2}}, {"b", {3}}};
+  record.pair = std::make_tuple(7, "seven");
+  record.optional = std::vector<int>{4, 5};
+  record.variant = std::vector<int>{6, 7, 8};
+  record.table.name = "inner";
+  record.table.values = std::vector<int>{9, 10, 11};
+
+  StaticRecord static_record;
+  ASSERT_TRUE(Transcode(record, &static_record));
+  EXPECT_EQ(Encode(record), Encode(static_record));
+
+  Record copy;
+  ASSERT_TRUE(Transcode(static_record, &copy));
+  EXPECT_EQ(record.index, copy.index);
+  EXPECT_EQ(record.pair, copy.pair);
+  EXPECT_EQ(record.optional.get(), copy.optional.get());
+  ASSERT_TRUE(copy.variant.is<std::vector<int>>());
+  EXPECT_EQ(*record.variant.get<std::vector<int>>(),
+            *copy.variant.get<std::vector<int>>());
+  EXPECT_EQ(record.table.name.get(), copy.table.name.get());
+  EXPECT_EQ(record.table.values.get(), copy.table.values.get());
+
+  // Empty values clear the destination.
+  record.optional.clear();
+  record.table.name.clear();
+  record.variant = Variant<int, std::vector<int>>{};
+  ASSERT_TRUE(Transcode(record, &static_record));
+  EXPECT_TRUE(static_record.optional.empty());
+  EXPECT_TRUE(static_record.table.name.empty());
+  EXPECT_TRUE(static_record.variant.empty());
+
+  // Fixed-size containers must match the source.
+  record.optional = std::vector<int>{1, 2, 3};
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+            Transcode(record, &static_record).error());
+  record.optional.clear();
+  std::get<1>(record.pair) = "long string";
+  EXPECT_EQ(ErrorStatus::InvalidStringLength,
+            Transcode(record, &static_record).error());
+}
+
+TEST(Transcode, Views) {
+  const std::string string = "view";
+  StringView string_view;
+  ASSERT_TRUE(Transcode(string, &string_view));
+  EXPECT_EQ(string.data(), string_view.data());
+  EXPECT_EQ(string.size(), string_view.size());
+
+  const std::vector<std::uint8_t> vector = {1, 2, 3};
+  ArrayView<std::uint8_t> array_view;
+  ASSERT_TRUE(Transcode(vector, &array_view));
+  EXPECT_EQ(vector.data(), array_view.data());
+  EXPECT_EQ(vector.size(), array_view.size());
+
+  std::vector<std::uint8_t> copy;
+  ASSERT_TRUE(Transcode(array_view, &copy));
+  EXPECT_EQ(vector, copy);
+}
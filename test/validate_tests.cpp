@@ -0,0 +1,224 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/table.h>
+#include <nop/types/optional.h>
+#include <nop/types/variant.h>
+#include <nop/utility/pedantic_buffer_reader.h>
+#include <nop/utility/vector_writer.h>
+
+#include "test_utilities.h"
+
+using nop::PedanticBufferReader;
+using nop::Compose;
+using nop::Deserializer;
+using nop::EncodingByte;
+using nop::Entry;
+using nop::ErrorStatus;
+using nop::Optional;
+using nop::Serializer;
+using nop::UncheckedReader;
+using nop::Validate;
+using nop::Variant;
+using nop::VectorWriter;
+
+namespace {
+
+struct Point {
+  std::int32_t x;
+  std::int32_t y;
+  NOP_STRUCTURE(Point, x, y);
+};
+
+struct Shape {
+  std::string name;
+  std::vector<Point> points;
+  std::vector<float> weights;
+  Variant<std::uint8_t, std::string> tag;
+  Optional<std::array<std::uint16_t, 3>> color;
+  std::map<std::uint32_t, std::pair<std::string, bool>> labels;
+  std::tuple<std::int64_t, Point> origin;
+  NOP_STRUCTURE(Shape, name, points, weights, tag, color, labels, origin);
+};
+
+struct Document {
+  Entry<std::string, 0> title;
+  Entry<std::vector<Shape>, 1> shapes;
+  Entry<int, 2, nop::DeletedEntry> deleted;
+  NOP_TABLE_HASH(15, Document, title, shapes, deleted);
+};
+
+struct OtherDocument {
+  Entry<std::string, 0> title;
+  NOP_TABLE_HASH(16, OtherDocument, title);
+};
+
+struct Triple {
+  std::int32_t x;
+  std::int32_t y;
+  std::int32_t z;
+  NOP_STRUCTURE(Triple, x, y, z);
+};
+
+Shape MakeShape(std::uint32_t seed) {
+  Shape shape{"shape-" + std::to_string(seed),
+              {{1, -2}, {static_cast<std::int32_t>(seed), 1 << 20}},
+              std::vector<float>(seed % 5, 0.5f),
+              {},
+              {},
+              {{seed, {"label", true}}, {seed + 1, {"", false}}},
+              {-1, {3, 4}}};
+  if (seed % 2)
+    shape.tag = std::string("tag");
+  else
+    shape.tag = std::uint8_t{200};
+  if (seed % 3)
+    shape.color = std::array<std::uint16_t, 3>{{1, 2, 0xffff}};
+  return shape;
+}
+
+Document MakeDocument() {
+  Document document;
+  document.title = "document";
+  document.shapes =
+      std::vector<Shape>{MakeShape(1), MakeShape(2), MakeShape(3)};
+  return document;
+}
+
+template <typename T>
+std::vector<std::uint8_t> Encode(const T& value) {
+  Serializer<VectorWriter> serializer;
+  EXPECT_TRUE(serializer.Write(value));
+  return serializer.writer().take();
+}
+
+template <typename T>
+ErrorStatus ValidateBytes(const std::vector<std::uint8_t>& data) {
+  PedanticBufferReader reader{data.data(), data.size()};
+  return Validate<T>(&reader).error();
+}
+
+template <typename T>
+ErrorStatus DecodeBytes(const std::vector<std::uint8_t>& data) {
+  PedanticBufferReader reader{data.data(), data.size()};
+  Deserializer<PedanticBufferReader*> deserializer{&reader};
+  T value;
+  return deserializer.Read(&value).error();
+}
+
+}  // anonymous namespace
+
+TEST(Validate, Valid) {
+  const Document document = MakeDocument();
+  const std::vector<std::uint8_t> data = Encode(document);
+
+  PedanticBufferReader reader{data.data(), data.size()};
+  ASSERT_TRUE(Validate<Document>(&reader));
+  EXPECT_TRUE(reader.empty());
+
+  // Validated input may be decoded without bounds checks.
+  UncheckedReader unchecked_reader{data.data()};
+  Deserializer<UncheckedReader*> deserializer{&unchecked_reader};
+  Document decoded;
+  ASSERT_TRUE(deserializer.Read(&decoded));
+  EXPECT_EQ(data.size(), unchecked_reader.size());
+  EXPECT_EQ(document.title, decoded.title);
+  ASSERT_EQ(3u, decoded.shapes.get().size());
+  EXPECT_EQ(document.shapes.get()[2].labels, decoded.shapes.get()[2].labels);
+
+  // Every truncation of the input is rejected.
+  for (std::size_t size = 0; size < data.size(); size++) {
+    reader = PedanticBufferReader{data.data(), size};
+    EXPECT_EQ(ErrorStatus::ReadLimitReached,
+              Validate<Document>(&reader).error())
+        << "size=" << size;
+  }
+}
+
+TEST(Validate, Errors) {
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            ValidateBytes<Point>(Encode(std::string("point"))));
+  EXPECT_EQ(ErrorStatus::InvalidMemberCount,
+            ValidateBytes<Point>(Encode(Triple{1, 2, 3})));
+  // Members must match their types.
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            ValidateBytes<Point>(
+                Compose(EncodingByte::Structure, 2, EncodingByte::String, 0,
+                        1)));
+  EXPECT_EQ(ErrorStatus::InvalidTableHash,
+            ValidateBytes<OtherDocument>(Encode(MakeDocument())));
+  using Points = std::array<Point, 3>;
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+            ValidateBytes<Points>(Encode(std::vector<Point>(2))));
+  EXPECT_EQ(ErrorStatus::InvalidContainerLength,
+            ValidateBytes<std::vector<std::uint32_t>>(
+                Compose(EncodingByte::Binary, 3, 1, 2, 3)));
+  using Tag = Variant<int, std::string>;
+  EXPECT_EQ(ErrorStatus::UnexpectedVariantType,
+            ValidateBytes<Tag>(Compose(EncodingByte::Variant, 2, 0)));
+
+  // Entries may not repeat, but unknown entries are skipped.
+  EXPECT_EQ(ErrorStatus::DuplicateTableEntry,
+            ValidateBytes<OtherDocument>(
+                Compose(EncodingByte::Table, 16, 2, 0, 2, EncodingByte::String,
+                        0, 0, 2, EncodingByte::String, 0)));
+  EXPECT_EQ(ErrorStatus::None,
+            ValidateBytes<OtherDocument>(
+                Compose(EncodingByte::Table, 16, 2, 5, 1, 0xff, 0, 2,
+                        EncodingByte::String, 0)));
+
+  // Entry values must fit within their entries.
+  EXPECT_EQ(ErrorStatus::ReadLimitReached,
+            ValidateBytes<OtherDocument>(
+                Compose(EncodingByte::Table, 16, 1, 0, 2, EncodingByte::String,
+                        1, 'a')));
+
+  // Containers may not claim more elements than the input has bytes.
+  EXPECT_EQ(ErrorStatus::ReadLimitReached,
+            ValidateBytes<std::vector<Point>>(
+                Compose(EncodingByte::Array, EncodingByte::U32,
+                        nop::Integer<std::uint32_t>(1u << 30))));
+}
+
+// Validation accepts exactly the inputs that decoding accepts, for every
+// single byte corruption of a valid encoding.
+TEST(Validate, MatchesDecode) {
+  const std::vector<std::uint8_t> data = Encode(MakeDocument());
+  const std::uint8_t replacements[] = {
+      0x00, 0x01, 0x7f, 0x80, 0xff,
+      static_cast<std::uint8_t>(EncodingByte::U64),
+      static_cast<std::uint8_t>(EncodingByte::Nil),
+      static_cast<std::uint8_t>(EncodingByte::Array)};
+
+  for (std::size_t i = 0; i < data.size(); i++) {
+    for (std::uint8_t replacement : replacements) {
+      std::vector<std::uint8_t> corrupt = data;
+      corrupt[i] = replacement;
+      EXPECT_EQ(DecodeBytes<Document>(corrupt) == ErrorStatus::None,
+                ValidateBytes<Document>(corrupt) == ErrorStatus::None)
+          << "index=" << i << " replacement=" << int{replacement};
+    }
+  }
+}
@@ -18,6 +18,7 @@
 #include <memory>
 #include <string>
 #include <type_traits>
+#include <utility>
 
 #include <gtest/gtest.h>
 #include <nop/types/variant.h>
@@ -874,6 +875,80 @@ TEST(Variant, Visit) {
   }
 }
 
+// Distinct element types for exercising variants with many elements.
+namespace {
+
+template <std::size_t I>
+struct Element {
+  Element() = default;
+  Element(std::string value) : value{std::move(value)} {}
+
+  std::string value;
+};
+
+template <std::size_t I>
+std::string GetValue(const Element<I>& element) {
+  return element.value;
+}
+std::string GetValue(EmptyVariant) { return {}; }
+
+template <std::size_t I>
+std::int32_t GetIndex(const Element<I>&) {
+  return I;
+}
+std::int32_t GetIndex(EmptyVariant) { return -1; }
+
+template <std::size_t... Is>
+Variant<Element<Is>...> MakeLargeVariant(std::index_sequence<Is...>);
+
+}  // anonymous namespace
+
+using LargeVariant =
+    decltype(MakeLargeVariant(std::make_index_sequence<24>{}));
+
+TEST(Variant, LargeVisit) {
+  LargeVariant v;
+  EXPECT_TRUE(v.empty());
+  EXPECT_EQ(-1, v.Visit([](const auto& value) { return GetIndex(value); }));
+
+  for (std::int32_t index = 0; index < 24; index++) {
+    v.Become(index, std::string(32, static_cast<char>('a' + index)));
+    EXPECT_EQ(index, v.index());
+
+    std::string visited;
+    v.Visit([&visited](const auto& value) { visited = GetValue(value); });
+    EXPECT_EQ(std::string(32, static_cast<char>('a' + index)), visited);
+  }
+
+  const LargeVariant& c = v;
+  EXPECT_EQ(23, c.Visit([](const auto& value) { return GetIndex(value); }));
+
+  v = Element<7>{"seven"};
+  EXPECT_TRUE(v.is<Element<7>>());
+  EXPECT_EQ("seven", v.get<Element<7>>()->value);
+
+  v.Become(24);
+  EXPECT_TRUE(v.empty());
+  v.Become(-2);
+  EXPECT_TRUE(v.empty());
+}
+
+TEST(Variant, DuplicateVisit) {
+  Variant<int, bool, int> v;
+  v.Become(2, 10);
+  EXPECT_EQ(2, v.index());
+
+  Visitor visitor;
+  v.Visit([&visitor](const auto& value) { visitor.Visit(value); });
+  EXPECT_EQ(10, visitor.int_value);
+
+  v = Variant<int, bool, int>{};
+  v.Become(0, 20);
+  EXPECT_EQ(0, v.index());
+  v.Visit([&visitor](const auto& value) { visitor.Visit(value); });
+  EXPECT_EQ(20, visitor.int_value);
+}
+
 TEST(Variant, Become) {
   {
     Variant<int, bool, float> v;
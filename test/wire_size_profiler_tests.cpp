@@ -0,0 +1,160 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <nop/serializer.h>
+#include <nop/structure.h>
+#include <nop/types/variant.h>
+#include <nop/utility/vector_writer.h>
+#include <nop/utility/wire_size_profiler.h>
+
+using nop::ErrorStatus;
+using nop::Serializer;
+using nop::VectorWriter;
+using nop::WireSizeProfiler;
+
+namespace {
+
+struct Sample {
+  std::uint32_t id;
+  std::string name;
+  // Tuples encode as arrays of individually prefixed numbers, like the
+  // containers written by older versions of the library.
+  std::tuple<std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t> ids;
+  std::tuple<float, float> weights;
+  std::vector<std::string> tags;
+  NOP_STRUCTURE(Sample, id, name, ids, weights, tags);
+};
+
+// Returns the entry at |path|, or an empty entry if there is none.
+WireSizeProfiler::Entry Find(const WireSizeProfiler& profiler,
+                             const std::string& path) {
+  for (const auto& entry : profiler.entries()) {
+    if (entry.path == path)
+      return entry;
+  }
+  return WireSizeProfiler::Entry{};
+}
+
+}  // anonymous namespace
+
+TEST(WireSizeProfiler, Paths) {
+  const Sample sample{1000,
+                      "abc",
+                      std::make_tuple(100000u, 100001u, 100003u, 100010u),
+                      std::make_tuple(0.5f, 1.5f),
+                      {"repeated-tag", "repeated-tag"}};
+  Serializer<VectorWriter> serializer;
+  ASSERT_TRUE(serializer.Write(sample));
+  const auto& buffer = serializer.writer().buffer();
+
+  WireSizeProfiler profiler;
+  auto size = profiler.Add(buffer.data(), buffer.size());
+  ASSERT_TRUE(size);
+  EXPECT_EQ(buffer.size(), size.get());
+  EXPECT_EQ(1u, profiler.messages());
+
+  const auto root = Find(profiler, "$");
+  EXPECT_EQ(1u, root.count);
+  EXPECT_EQ(1u, root.prefix_bytes);
+  EXPECT_EQ(1u, root.length_bytes);
+  EXPECT_EQ(0u, root.payload_bytes);
+
+  const auto id = Find(profiler, "$.0");
+  EXPECT_EQ(1u, id.prefix_bytes);
+  EXPECT_EQ(2u, id.payload_bytes);
+  EXPECT_EQ(0, id.fixed_width_savings);
+
+  const auto name = Find(profiler, "$.1");
+  EXPECT_EQ(1u, name.length_bytes);
+  EXPECT_EQ(3u, name.payload_bytes);
+
+  // Four U32 elements: packed saves their prefixes, and the small
+  // differences of the delta encoding save more.
+  const auto ids = Find(profiler, "$.2");
+  EXPECT_EQ(22u, ids.total_bytes() + Find(profiler, "$.2[]").total_bytes());
+  EXPECT_EQ(4, ids.packed_savings);
+  EXPECT_EQ(12, ids.delta_savings);
+  EXPECT_EQ(4u, Find(profiler, "$.2[]").count);
+
+  const auto weights = Find(profiler, "$.3");
+  EXPECT_EQ(2, weights.packed_savings);
+  EXPECT_EQ(0, weights.delta_savings);
+
+  // The first string becomes a definition and the second a reference.
+  const auto tags = Find(profiler, "$.4[]");
+  EXPECT_EQ(2u, tags.count);
+  EXPECT_EQ(8, tags.interning_savings);
+  EXPECT_EQ(0, Find(profiler, "$.4").packed_savings);
+
+  // The totals add up to the size of the sample.
+  ASSERT_TRUE(profiler.AddValue(sample));
+  EXPECT_EQ(2u, profiler.messages());
+  std::uint64_t total = 0;
+  for (const auto& entry : profiler.entries())
+    total += entry.total_bytes();
+  EXPECT_EQ(2 * buffer.size(), total);
+
+  const std::string report = profiler.Report();
+  EXPECT_NE(std::string::npos, report.find("interning"));
+  EXPECT_NE(std::string::npos, report.find("$.4[]"));
+
+  profiler.Clear();
+  EXPECT_TRUE(profiler.entries().empty());
+}
+
+TEST(WireSizeProfiler, TableAndVariant) {
+  // A table with one entry holding a fixint followed by two bytes of padding.
+  const std::uint8_t table[] = {0xb5, 0x00, 0x01, 0x00, 0x03, 0x05,
+                                0x00, 0x00, 0xff};
+  WireSizeProfiler profiler;
+  auto size = profiler.Add(table, sizeof(table));
+  ASSERT_TRUE(size);
+  EXPECT_EQ(8u, size.get());
+
+  const auto root = Find(profiler, "$");
+  EXPECT_EQ(1u, root.prefix_bytes);
+  EXPECT_EQ(4u, root.table_bytes);
+  const auto entry = Find(profiler, "$#0");
+  EXPECT_EQ(1u, entry.prefix_bytes);
+  EXPECT_EQ(2u, entry.padding_bytes);
+
+  ASSERT_TRUE(profiler.AddValue(nop::Variant<int, std::string>{"abc"}));
+  EXPECT_EQ(3u, Find(profiler, "$<1>").payload_bytes);
+}
+
+TEST(WireSizeProfiler, Errors) {
+  WireSizeProfiler profiler{2};
+
+  // Truncated string.
+  const std::uint8_t truncated[] = {0xbd, 0x05, 'a', 'b'};
+  EXPECT_EQ(ErrorStatus::ReadLimitReached,
+            profiler.Add(truncated, sizeof(truncated)).error());
+
+  // Nesting deeper than the limit.
+  const std::uint8_t nested[] = {0xba, 0x01, 0xba, 0x01, 0xba, 0x01, 0x00};
+  EXPECT_EQ(ErrorStatus::ProtocolError,
+            profiler.Add(nested, sizeof(nested)).error());
+
+  // Reserved prefix.
+  const std::uint8_t reserved[] = {0x8a};
+  EXPECT_EQ(ErrorStatus::UnexpectedEncodingType,
+            profiler.Add(reserved, sizeof(reserved)).error());
+}
@@ -0,0 +1,90 @@
+// Copyright 2018 The Native Object Protocols Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include <nop/utility/work_stealing_executor.h>
+
+using nop::WorkStealingExecutor;
+
+TEST(WorkStealingExecutor, RunsAll) {
+  std::atomic<int> count{0};
+  {
+    WorkStealingExecutor executor{4};
+    EXPECT_EQ(4u, executor.worker_count());
+    for (int i = 0; i < 1000; i++)
+      executor.Submit([&count] { count++; });
+  }
+  EXPECT_EQ(1000, count.load());
+}
+
+TEST(WorkStealingExecutor, Steal) {
+  WorkStealingExecutor executor{2};
+  std::atomic<bool> release{false};
+  std::atomic<int> count{0};
+
+  // Block one worker with the first task submitted to worker 0. The rest of
+  // the tasks submitted to worker 0 can only finish before the first task does
+  // if they are stolen, or if worker 0 runs them after the other worker steals
+  // the blocking task.
+  executor.Submit(
+      [&] {
+        while (!release)
+          std::this_thread::yield();
+        count++;
+      },
+      0);
+  for (int i = 0; i < 10; i++)
+    executor.Submit([&count] { count++; }, 0);
+
+  while (count < 10)
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  release = true;
+  while (executor.executed(0) + executor.executed(1) < 11)
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+
+  EXPECT_EQ(11, count.load());
+  EXPECT_EQ(0u, executor.queue_depth(0));
+  EXPECT_EQ(0u, executor.queue_depth(1));
+  EXPECT_LE(1u, executor.stolen(0) + executor.stolen(1));
+  EXPECT_EQ(0u, executor.stolen(0));
+}
+
+TEST(WorkStealingExecutor, QueueDepth) {
+  std::atomic<bool> release{false};
+  std::atomic<bool> started{false};
+  {
+    WorkStealingExecutor executor{1};
+    executor.Submit(
+        [&] {
+          started = true;
+          while (!release)
+            std::this_thread::yield();
+        },
+        0);
+    while (!started)
+      std::this_thread::yield();
+
+    for (int i = 0; i < 3; i++)
+      executor.Submit([] {}, 7);
+    EXPECT_EQ(3u, executor.queue_depth(0));
+    release = true;
+  }
+}